@@ -0,0 +1,136 @@
+#include "BlurPyramid.hpp"
+
+#include "PresetValues.hpp"
+
+namespace {
+
+const char* kBoundsHelpers = R"___(
+// BlurTexture::GetSafeBlurMinMaxValues(): each level stays inside the range of the level before
+// it and its bounds stay at least 0.1 apart. Close bounds are split around their midpoint as in
+// MilkDrop; libprojectM's copy sets both to the lower value.
+void blur_safe_bounds(inout vec3 blurMin, inout vec3 blurMax) {
+    for (int level = 0; level < 3; ++level) {
+        if (level > 0) {
+            blurMax[level] = min(blurMax[level - 1], blurMax[level]);
+            blurMin[level] = max(blurMin[level - 1], blurMin[level]);
+        }
+        if (blurMax[level] - blurMin[level] < 0.1) {
+            float average = 0.5 * (blurMin[level] + blurMax[level]);
+            blurMin[level] = average - 0.05;
+            blurMax[level] = average + 0.05;
+        }
+    }
+}
+
+// Scale and bias taking the input of blur level (level + 1) to [0, 1]: the screen range for
+// blur1, the previous level's range otherwise (BlurTexture::Update()).
+vec2 blur_scale_bias(int level, vec3 blurMin, vec3 blurMax) {
+    float low = blurMin[0];
+    float high = blurMax[0];
+    if (level > 0) {
+        float range = blurMax[level - 1] - blurMin[level - 1];
+        low = (blurMin[level] - blurMin[level - 1]) / range;
+        high = (blurMax[level] - blurMin[level - 1]) / range;
+    }
+    float scale = 1.0 / (high - low);
+    return vec2(scale, -low * scale);
+}
+)___";
+
+std::string tap(const std::string& source, const std::string& offset)
+{
+    return "(texture(" + source + ", blur_uv + " + offset + ").rgb + texture(" + source + ", blur_uv - " + offset + ").rgb)";
+}
+
+} // namespace
+
+int BlurPyramid::divisor(int index)
+{
+    static constexpr int kDivisors[2 * kMaxLevel] = {2, 4, 8, 8, 16, 16};
+    return kDivisors[index];
+}
+
+std::string BlurPyramid::passName(int index)
+{
+    return "blur" + std::to_string(index / 2 + 1) + (index % 2 == 0 ? "_h" : "");
+}
+
+std::string BlurPyramid::sampler(int index)
+{
+    return "iBlur" + std::to_string(index / 2 + 1) + (index % 2 == 0 ? "H" : "");
+}
+
+std::string BlurPyramid::generateBoundsHelpers()
+{
+    return kBoundsHelpers;
+}
+
+std::string BlurPyramid::generatePassHelpers(int index, const std::string& source)
+{
+    const std::string input = index == 0 ? source : sampler(index - 1);
+    std::string glsl = kBoundsHelpers;
+    if (input.compare(0, 8, "iChannel") != 0)
+    {
+        glsl += "\nuniform sampler2D " + input + ";\n";
+    }
+    return glsl;
+}
+
+std::string BlurPyramid::generatePassBody(int index, const std::string& source, const std::array<std::string, 6>& bounds,
+                                          const std::string& edgeDarken)
+{
+    const int level = index / 2;
+    const std::string input = index == 0 ? source : sampler(index - 1);
+    const auto& w = kWeights;
+
+    std::string glsl = "\n    // " + passName(index) + ": " + (index % 2 == 0 ? "horizontal" : "vertical") +
+                       " Gaussian pass at 1/" + std::to_string(divisor(index)) + " of the screen.\n";
+    glsl += "    vec2 blur_uv = gl_FragCoord.xy / ceil(iResolution / " + std::to_string(divisor(index)) + ".0);\n";
+    glsl += "    vec2 blur_texel = 1.0 / vec2(textureSize(" + input + ", 0));\n";
+    if (index % 2 == 0)
+    {
+        // Pairs of weights become one bilinear tap between their texels.
+        const float w1 = w[0] + w[1];
+        const float w2 = w[2] + w[3];
+        const float w3 = w[4] + w[5];
+        const float w4 = w[6] + w[7];
+        const float d1 = 0.0f + 2.0f * w[1] / w1;
+        const float d2 = 2.0f + 2.0f * w[3] / w2;
+        const float d3 = 4.0f + 2.0f * w[5] / w3;
+        const float d4 = 6.0f + 2.0f * w[7] / w4;
+        const float weightDivisor = 0.5f / (w1 + w2 + w3 + w4);
+        auto horizontal = [&](float distance) { return "vec2(" + glslFloat(distance) + " * blur_texel.x, 0.0)"; };
+        glsl += "    vec3 blur = " + tap(input, horizontal(d1)) + " * " + glslFloat(w1) + " +\n";
+        glsl += "                " + tap(input, horizontal(d2)) + " * " + glslFloat(w2) + " +\n";
+        glsl += "                " + tap(input, horizontal(d3)) + " * " + glslFloat(w3) + " +\n";
+        glsl += "                " + tap(input, horizontal(d4)) + " * " + glslFloat(w4) + ";\n";
+        glsl += "    blur *= " + glslFloat(weightDivisor) + ";\n";
+        glsl += "    vec3 blur_min = vec3(" + bounds[0] + ", " + bounds[2] + ", " + bounds[4] + ");\n";
+        glsl += "    vec3 blur_max = vec3(" + bounds[1] + ", " + bounds[3] + ", " + bounds[5] + ");\n";
+        glsl += "    blur_safe_bounds(blur_min, blur_max);\n";
+        glsl += "    vec2 blur_range = blur_scale_bias(" + std::to_string(level) + ", blur_min, blur_max);\n";
+        glsl += "    blur = blur * blur_range.x + blur_range.y;\n";
+    }
+    else
+    {
+        const float w1 = w[0] + w[1] + w[2] + w[3];
+        const float w2 = w[4] + w[5] + w[6] + w[7];
+        const float d1 = 0.0f + 2.0f * ((w[2] + w[3]) / w1);
+        const float d2 = 2.0f + 2.0f * ((w[6] + w[7]) / w2);
+        const float weightDivisor = 1.0f / ((w1 + w2) * 2.0f);
+        auto vertical = [&](float distance) { return "vec2(0.0, " + glslFloat(distance) + " * blur_texel.y)"; };
+        glsl += "    vec3 blur = " + tap(input, vertical(d1)) + " * " + glslFloat(w1) + " +\n";
+        glsl += "                " + tap(input, vertical(d2)) + " * " + glslFloat(w2) + ";\n";
+        glsl += "    blur *= " + glslFloat(weightDivisor) + ";\n";
+        if (index == 1)
+        {
+            // Only the first level darkens the edges; repeating it would draw dark borders
+            // into the wider levels.
+            glsl += "    float blur_edge = sqrt(min(min(blur_uv.x, blur_uv.y), 1.0 - max(blur_uv.x, blur_uv.y)));\n";
+            glsl += "    float blur_edge_darken = " + edgeDarken + ";\n";
+            glsl += "    blur *= 1.0 - blur_edge_darken + blur_edge_darken * clamp(blur_edge * 5.0, 0.0, 1.0);\n";
+        }
+    }
+    glsl += "    FragColor = vec4(clamp(blur, 0.0, 1.0), 1.0);\n";
+    return glsl;
+}
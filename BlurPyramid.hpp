@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+/**
+ * @brief GLSL for the blur1-3 textures preset shaders sample (libprojectM's BlurTexture).
+ *
+ * Each level is a separable Gaussian: a long horizontal pass of eight bilinear taps and a short
+ * vertical pass of four, both at reduced resolution and each reading the pass before it, so the
+ * pyramid costs a fraction of a full-screen pass however wide the blur. Only the levels up to the
+ * highest one a preset references are emitted. Every level stores its input remapped from the
+ * preset's blurN_min..blurN_max range to [0, 1], clamped like libprojectM's 8-bit textures, and
+ * GetBlurN() maps it back.
+ */
+class BlurPyramid {
+public:
+    /// Passes for blur levels 1 to @p level: a horizontal and a vertical pass per level.
+    static int passCount(int level) { return 2 * level; }
+
+    /// Screen resolution divisor of pass @p index (0: blur1 horizontal, 1: blur1, 2: blur2
+    /// horizontal, ...). As in BlurTexture::AllocateTextures(), blur1 is a quarter of the screen
+    /// on each axis, blur2 an eighth and blur3 a sixteenth; only blur1's horizontal pass also
+    /// halves the resolution.
+    static int divisor(int index);
+
+    /// "blur1_h", "blur1", "blur2_h", ...
+    static std::string passName(int index);
+
+    /// "iBlur1H", "iBlur1", "iBlur2H", ...; the vertical passes are the blurN textures.
+    static std::string sampler(int index);
+
+    /// blur_safe_bounds() and blur_scale_bias(), shared with the preset shader inputs.
+    static std::string generateBoundsHelpers();
+
+    /// Globals of pass @p index: the bounds helpers and the sampler it reads unless that is a RaymarchVibe channel.
+    static std::string generatePassHelpers(int index, const std::string& source);
+
+    /// Statements for main() writing FragColor of pass @p index. Pass 0 reads @p source, later
+    /// passes the pass before them. @p bounds are GLSL expressions for blur1_min, blur1_max, ...
+    /// blur3_max and @p edgeDarken one for blur1_edge_darken.
+    static std::string generatePassBody(int index, const std::string& source, const std::array<std::string, 6>& bounds,
+                                        const std::string& edgeDarken);
+
+    static constexpr int kMaxLevel = 3;
+    /// Gaussian weights of BlurTexture::Update(), centre outwards.
+    static constexpr std::array<float, 8> kWeights = {4.0f, 3.8f, 3.5f, 2.9f, 1.9f, 1.2f, 0.7f, 0.3f};
+};
@@ -0,0 +1,269 @@
+#include "CustomShapeRenderer.hpp"
+
+#include "PresetValues.hpp"
+
+#include <algorithm>
+
+std::vector<CustomShape> CustomShapeRenderer::parse(const std::map<std::string, std::string>& presetValues)
+{
+    std::vector<CustomShape> shapes;
+    for (int index = 0; index < kMaxShapes; ++index)
+    {
+        const std::string settings = "shapecode_" + std::to_string(index) + "_";
+        if (presetFloat(presetValues, settings + "enabled", 0.0f) == 0.0f)
+        {
+            continue;
+        }
+
+        CustomShape shape;
+        shape.index = index;
+        shape.instances = std::min(kMaxInstances, static_cast<int>(presetFloat(presetValues, settings + "num_inst", 1.0f)));
+        shape.sides = static_cast<int>(presetFloat(presetValues, settings + "sides", 4.0f));
+        shape.additive = presetFloat(presetValues, settings + "additive", 0.0f) != 0.0f;
+        shape.thickOutline = presetFloat(presetValues, settings + "thickoutline", 0.0f) != 0.0f;
+        shape.textured = presetFloat(presetValues, settings + "textured", 0.0f) != 0.0f;
+        shape.x = presetFloat(presetValues, settings + "x", shape.x);
+        shape.y = presetFloat(presetValues, settings + "y", shape.y);
+        shape.rad = presetFloat(presetValues, settings + "rad", shape.rad);
+        shape.ang = presetFloat(presetValues, settings + "ang", shape.ang);
+        shape.texAng = presetFloat(presetValues, settings + "tex_ang", shape.texAng);
+        shape.texZoom = presetFloat(presetValues, settings + "tex_zoom", shape.texZoom);
+        shape.r = presetFloat(presetValues, settings + "r", shape.r);
+        shape.g = presetFloat(presetValues, settings + "g", shape.g);
+        shape.b = presetFloat(presetValues, settings + "b", shape.b);
+        shape.a = presetFloat(presetValues, settings + "a", shape.a);
+        shape.r2 = presetFloat(presetValues, settings + "r2", shape.r2);
+        shape.g2 = presetFloat(presetValues, settings + "g2", shape.g2);
+        shape.b2 = presetFloat(presetValues, settings + "b2", shape.b2);
+        shape.a2 = presetFloat(presetValues, settings + "a2", shape.a2);
+        shape.borderR = presetFloat(presetValues, settings + "border_r", shape.borderR);
+        shape.borderG = presetFloat(presetValues, settings + "border_g", shape.borderG);
+        shape.borderB = presetFloat(presetValues, settings + "border_b", shape.borderB);
+        shape.borderA = presetFloat(presetValues, settings + "border_a", shape.borderA);
+
+        const std::string code = "shape_" + std::to_string(index) + "_";
+        shape.initCode = presetCode(presetValues, code + "init");
+        shape.perFrameCode = presetCode(presetValues, code + "per_frame");
+        if (shape.instances > 0)
+        {
+            shapes.push_back(std::move(shape));
+        }
+    }
+    return shapes;
+}
+
+std::string CustomShapeRenderer::generateInstanceHelpers()
+{
+    return R"___(
+// Renderer::color_modulo(): colours wrap at 256/255 instead of saturating.
+vec4 custom_shape_color(vec4 color)
+{
+    return clamp(mod(color, 256.0 / 255.0), 0.0, 1.0);
+}
+
+// One texel of the instances texture. Sides are truncated and clamped to 3..100 as in
+// CustomShape::Draw(); flags pack additive (1), textured (2) and the thick outline (4).
+// The centre and edge colours wrap, the border colour saturates like glVertexAttrib4f.
+vec4 custom_shape_field(int field, vec4 geometry, float ang, float sides, float additive, float textured,
+                        float tex_ang, bool thick, vec4 color, vec4 color2, vec4 border)
+{
+    if (field == 0)
+    {
+        return geometry;
+    }
+    if (field == 1)
+    {
+        float flags = (int(additive) != 0 ? 1.0 : 0.0) + (int(textured) != 0 ? 2.0 : 0.0) + (thick ? 4.0 : 0.0);
+        return vec4(ang, float(clamp(int(sides), 3, 100)), flags, tex_ang);
+    }
+    if (field == 2)
+    {
+        return custom_shape_color(color);
+    }
+    if (field == 3)
+    {
+        return custom_shape_color(color2);
+    }
+    return clamp(border, 0.0, 1.0);
+}
+)___";
+}
+
+std::string CustomShapeRenderer::generateInstanceStore(const CustomShape& shape)
+{
+    return "FragColor = custom_shape_field(cs_row - " + std::to_string(shape.index * kInstanceRows) +
+           ", vec4(cs_x, 1.0 - cs_y, cs_rad, cs_tex_zoom), cs_ang, cs_sides, cs_additive, cs_textured, cs_tex_ang, " +
+           (shape.thickOutline ? "true" : "false") +
+           ", vec4(cs_r, cs_g, cs_b, cs_a), vec4(cs_r2, cs_g2, cs_b2, cs_a2), vec4(cs_border_r, cs_border_g, cs_border_b, cs_border_a));\n";
+}
+
+std::string CustomShapeRenderer::generateBinPass(const std::vector<CustomShape>& shapes)
+{
+    std::string glsl = "#version 330 core\n\nout vec4 FragColor;\n\nuniform vec2 iResolution;\nuniform sampler2D iCustomShapeInstances;\n\n";
+    glsl += "const int CUSTOM_SHAPE_MAX_INSTANCES = " + std::to_string(kMaxInstances) + ";\n";
+    glsl += "const int CUSTOM_SHAPE_ROWS = " + std::to_string(kInstanceRows) + ";\n";
+    glsl += "const int CUSTOM_SHAPE_TILES = " + std::to_string(kBinTiles) + ";\n";
+    glsl += "const int CUSTOM_SHAPE_BIN_SLOTS = " + std::to_string(kBinSlots) + ";\n";
+    glsl += "const int CUSTOM_SHAPE_BIN_STRIDE = " + std::to_string(kBinStride) + ";\n";
+    glsl += R"___(
+// Pixels beyond the corner radius an instance can still touch: the thick border and the
+// antialiased fill edge.
+const float CUSTOM_SHAPE_EDGE_PX = 2.0;
+
+// Counts the instance towards the tile when its box (the circle through its corners,
+// stretched by the shape aspect) touches it. Entries go into a ring of
+// CUSTOM_SHAPE_BIN_SLOTS, so an overflowing tile keeps the last, topmost instances.
+void custom_shape_bin(int shape, int instance, vec2 tileMin, vec2 tileMax, int column, inout int found, inout vec4 entries)
+{
+    int row = shape * CUSTOM_SHAPE_ROWS;
+    vec4 geometry = texelFetch(iCustomShapeInstances, ivec2(instance, row), 0);
+    vec4 params = texelFetch(iCustomShapeInstances, ivec2(instance, row + 1), 0);
+    if (params.y < 3.0 || geometry.z == 0.0)
+    {
+        return;
+    }
+    vec2 reach = 0.5 * abs(geometry.z) * vec2(min(1.0, iResolution.y / iResolution.x), 1.0) + CUSTOM_SHAPE_EDGE_PX / iResolution;
+    if (any(greaterThan(geometry.xy - reach, tileMax)) || any(lessThan(geometry.xy + reach, tileMin)))
+    {
+        return;
+    }
+    int slot = found % CUSTOM_SHAPE_BIN_SLOTS - (column - 1) * 4;
+    if (slot >= 0 && slot < 4)
+    {
+        entries[slot] = float(shape * CUSTOM_SHAPE_MAX_INSTANCES + instance);
+    }
+    ++found;
+}
+
+// One row per tile row, CUSTOM_SHAPE_BIN_STRIDE texels per tile: texel 0 holds (count,
+// overflow, first slot), the others four instance references each, in draw order.
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    int tileX = texel.x / CUSTOM_SHAPE_BIN_STRIDE;
+    int column = texel.x - tileX * CUSTOM_SHAPE_BIN_STRIDE;
+    vec2 tileMin = vec2(float(tileX), float(texel.y)) / float(CUSTOM_SHAPE_TILES);
+    vec2 tileMax = tileMin + vec2(1.0 / float(CUSTOM_SHAPE_TILES));
+
+    int found = 0;
+    vec4 entries = vec4(-1.0);
+)___";
+    for (const auto& shape : shapes)
+    {
+        glsl += "    for (int instance = 0; instance < " + std::to_string(shape.instances) + "; ++instance)\n    {\n";
+        glsl += "        custom_shape_bin(" + std::to_string(shape.index) + ", instance, tileMin, tileMax, column, found, entries);\n    }\n";
+    }
+    glsl += R"___(
+    if (column == 0)
+    {
+        bool overflow = found > CUSTOM_SHAPE_BIN_SLOTS;
+        FragColor = vec4(float(min(found, CUSTOM_SHAPE_BIN_SLOTS)), overflow ? 1.0 : 0.0, overflow ? float(found % CUSTOM_SHAPE_BIN_SLOTS) : 0.0, 0.0);
+    }
+    else
+    {
+        FragColor = entries;
+    }
+}
+)___";
+    return glsl;
+}
+
+std::string CustomShapeRenderer::generateDrawGLSL()
+{
+    std::string glsl = R"___(
+// Custom shapes, evaluated once per instance by the custom_shape_instances pass and
+// binned into screen tiles by the custom_shape_bins pass.
+uniform sampler2D iCustomShapeInstances;
+uniform sampler2D iCustomShapeBins;
+
+)___";
+    glsl += "const int CUSTOM_SHAPE_MAX_INSTANCES = " + std::to_string(kMaxInstances) + ";\n";
+    glsl += "const int CUSTOM_SHAPE_ROWS = " + std::to_string(kInstanceRows) + ";\n";
+    glsl += "const int CUSTOM_SHAPE_TILES = " + std::to_string(kBinTiles) + ";\n";
+    glsl += "const int CUSTOM_SHAPE_BIN_SLOTS = " + std::to_string(kBinSlots) + ";\n";
+    glsl += "const int CUSTOM_SHAPE_BIN_STRIDE = " + std::to_string(kBinStride) + ";\n";
+    glsl += R"___(
+// Signed distance from p to the regular polygon with unit circumradius and a corner at
+// angle corner (negative inside), and the triangle fan parameter: 0 at the centre, 1 on
+// the edge. Folding p into the sector of the nearest edge replaces the loop over sides.
+vec2 custom_shape_polygon(vec2 p, int sides, float corner)
+{
+    float half_angle = 3.14159265 / float(sides);
+    float angle = mod(atan(p.y, p.x) - corner, 2.0 * half_angle) - half_angle;
+    vec2 q = length(p) * vec2(cos(angle), abs(sin(angle)));
+    float fan = q.x / cos(half_angle);
+    q -= vec2(cos(half_angle), sin(half_angle));
+    q.y += clamp(-q.y, 0.0, sin(half_angle));
+    return vec2(length(q) * sign(q.x), fan);
+}
+
+// Blends the instances binned for the pixel's tile over color in draw order, like the
+// GL_TRIANGLE_FAN fill and GL_LINE_LOOP border of CustomShape::Draw(): the fill runs from
+// the centre colour to the edge colour (times the feedback buffer when textured), the
+// border is one pixel wide or two with thickOutline, and both are added or alpha blended.
+vec3 custom_shape_draw(vec3 color, vec2 uv)
+{
+    ivec2 tile = clamp(ivec2(uv * float(CUSTOM_SHAPE_TILES)), ivec2(0), ivec2(CUSTOM_SHAPE_TILES - 1));
+    int base = tile.x * CUSTOM_SHAPE_BIN_STRIDE;
+    vec4 header = texelFetch(iCustomShapeBins, ivec2(base, tile.y), 0);
+    int count = int(header.x);
+    int first = int(header.z);
+    vec2 pixel = uv * iResolution;
+    float aspect_y = min(1.0, iResolution.y / iResolution.x);
+    for (int i = 0; i < CUSTOM_SHAPE_BIN_SLOTS; ++i)
+    {
+        if (i >= count)
+        {
+            break;
+        }
+        int slot = (first + i) % CUSTOM_SHAPE_BIN_SLOTS;
+        int entry = int(texelFetch(iCustomShapeBins, ivec2(base + 1 + slot / 4, tile.y), 0)[slot % 4]);
+        int row = (entry / CUSTOM_SHAPE_MAX_INSTANCES) * CUSTOM_SHAPE_ROWS;
+        int instance = entry % CUSTOM_SHAPE_MAX_INSTANCES;
+        vec4 geometry = texelFetch(iCustomShapeInstances, ivec2(instance, row), 0);
+        vec4 params = texelFetch(iCustomShapeInstances, ivec2(instance, row + 1), 0);
+
+        // Corners sit at rad * (cos, sin) * (aspect_y, 1) from the centre in clip space,
+        // half that in uv; a negative rad turns the polygon by half a turn.
+        vec2 radius_px = 0.5 * geometry.z * vec2(aspect_y, 1.0) * iResolution;
+        vec2 local = (pixel - geometry.xy * iResolution) / radius_px;
+        vec2 polygon = custom_shape_polygon(local, int(params.y), params.x + 0.78539816);
+        float distance_px = polygon.x * min(abs(radius_px.x), abs(radius_px.y));
+        int flags = int(params.z);
+        bool additive = (flags & 1) != 0;
+
+        float fill_coverage = clamp(0.5 - distance_px, 0.0, 1.0);
+        if (fill_coverage > 0.0)
+        {
+            vec4 fill = mix(texelFetch(iCustomShapeInstances, ivec2(instance, row + 2), 0),
+                            texelFetch(iCustomShapeInstances, ivec2(instance, row + 3), 0), clamp(polygon.y, 0.0, 1.0));
+            if ((flags & 2) != 0)
+            {
+                // The texture corners use tex_ang instead of ang and 1 / tex_zoom instead of rad.
+                float turn = params.w - params.x;
+                vec2 turned = mat2(cos(turn), sin(turn), -sin(turn), cos(turn)) * local;
+                vec2 tex = vec2(0.5) + 0.5 / geometry.w * vec2(aspect_y, 1.0) * turned;
+                fill *= texture(iChannel0, fract(tex));
+            }
+            float alpha = fill.a * fill_coverage;
+            color = additive ? color + fill.rgb * alpha : mix(color, fill.rgb, alpha);
+        }
+
+        vec4 border = texelFetch(iCustomShapeInstances, ivec2(instance, row + 4), 0);
+        if (border.a > 0.0001)
+        {
+            float half_width = (flags & 4) != 0 ? 1.0 : 0.5;
+            float alpha = border.a * clamp(half_width + 0.5 - abs(distance_px), 0.0, 1.0);
+            color = additive ? color + border.rgb * alpha : mix(color, border.rgb, alpha);
+        }
+    }
+    return color;
+}
+)___";
+    return glsl;
+}
+
+std::string CustomShapeRenderer::generateDrawCall()
+{
+    return "    composedColor.rgb = custom_shape_draw(composedColor.rgb, gl_FragCoord.xy / iResolution.xy);\n";
+}
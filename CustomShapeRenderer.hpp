@@ -0,0 +1,85 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One enabled custom shape (shapecode_N_* settings and shape_N_* code blocks).
+ *
+ * The fields are the values libprojectM's CustomShape loads before running the per-frame
+ * code for each instance; only @c instances and @c thickOutline stay fixed for the frame.
+ */
+struct CustomShape {
+    int index = 0;
+    int instances = 1;
+    int sides = 4;
+    bool additive = false;
+    bool thickOutline = false;
+    bool textured = false;
+    float x = 0.5f;
+    float y = 0.5f;
+    float rad = 0.1f;
+    float ang = 0.0f;
+    float texAng = 0.0f;
+    float texZoom = 1.0f;
+    float r = 1.0f;
+    float g = 0.0f;
+    float b = 0.0f;
+    float a = 1.0f;
+    float r2 = 0.0f;
+    float g2 = 1.0f;
+    float b2 = 0.0f;
+    float a2 = 0.0f;
+    float borderR = 1.0f;
+    float borderG = 1.0f;
+    float borderB = 1.0f;
+    float borderA = 0.0f;
+    std::string initCode;
+    std::string perFrameCode;
+};
+
+/**
+ * @brief GLSL generation for custom shapes.
+ *
+ * The instances pass runs each shape's per-frame code once per instance and stores the
+ * resulting parameters in a small float texture. The bins pass sorts the instances into
+ * screen tiles by their bounding boxes, keeping at most kBinSlots per tile, so the main
+ * shader evaluates a bounded number of polygon distance functions per pixel however many
+ * instances the preset draws.
+ */
+class CustomShapeRenderer {
+public:
+    /// Enabled shapes with at least one instance, in index order.
+    static std::vector<CustomShape> parse(const std::map<std::string, std::string>& presetValues);
+
+    /// custom_shape_color() and custom_shape_field() for the instances pass.
+    static std::string generateInstanceHelpers();
+
+    /// Statement writing instance cs_instance of @p shape for texel row cs_row, using the
+    /// cs_* locals its per-frame code left behind.
+    static std::string generateInstanceStore(const CustomShape& shape);
+
+    /// Complete fragment shader binning the instances of @p shapes into screen tiles.
+    static std::string generateBinPass(const std::vector<CustomShape>& shapes);
+
+    /// Samplers and custom_shape_draw() for the main shader.
+    static std::string generateDrawGLSL();
+
+    /// Statement blending every binned instance over composedColor.rgb in the main shader.
+    static std::string generateDrawCall();
+
+    /// libprojectM evaluates at most four custom shapes of up to 1024 instances each.
+    static constexpr int kMaxShapes = 4;
+    static constexpr int kMaxInstances = 1024;
+    /// Instances texture: one column per instance and kInstanceRows rows per shape, holding
+    /// (x, y, rad, tex_zoom), (ang, sides, flags, tex_ang), the centre colour, the edge
+    /// colour and the border colour.
+    static constexpr int kInstanceRows = 5;
+    static constexpr int kInstancesWidth = kMaxInstances;
+    static constexpr int kInstancesHeight = kMaxShapes * kInstanceRows;
+    /// Bins texture: kBinTiles x kBinTiles screen tiles, kBinStride texels per tile.
+    static constexpr int kBinTiles = 16;
+    static constexpr int kBinSlots = 32;
+    static constexpr int kBinStride = 1 + kBinSlots / 4;
+};
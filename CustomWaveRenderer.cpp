@@ -0,0 +1,262 @@
+#include "CustomWaveRenderer.hpp"
+
+#include "PresetValues.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr int kWaveformSamples = 480; // libprojectM::Audio::WaveformSamples
+constexpr int kSpectrumSamples = 512; // libprojectM::Audio::SpectrumSamples
+
+const char* glslBool(bool value)
+{
+    return value ? "true" : "false";
+}
+
+} // namespace
+
+int CustomWave::pointCount() const
+{
+    const int maxSamples = spectrum ? kSpectrumSamples : kWaveformSamples;
+    const int count = std::min(maxSamples, samples) - sep;
+    return (useDots ? count < 1 : count < 2) ? 0 : count;
+}
+
+std::vector<CustomWave> CustomWaveRenderer::parse(const std::map<std::string, std::string>& presetValues)
+{
+    std::vector<CustomWave> waves;
+    for (int index = 0; index < kMaxWaves; ++index)
+    {
+        const std::string settings = "wavecode_" + std::to_string(index) + "_";
+        if (presetFloat(presetValues, settings + "enabled", 0.0f) == 0.0f)
+        {
+            continue;
+        }
+
+        CustomWave wave;
+        wave.index = index;
+        wave.samples = static_cast<int>(presetFloat(presetValues, settings + "samples", 512.0f));
+        wave.sep = static_cast<int>(presetFloat(presetValues, settings + "sep", 0.0f));
+        wave.spectrum = presetFloat(presetValues, settings + "bspectrum", 0.0f) != 0.0f;
+        wave.useDots = presetFloat(presetValues, settings + "busedots", 0.0f) != 0.0f;
+        wave.drawThick = presetFloat(presetValues, settings + "bdrawthick", 0.0f) != 0.0f;
+        wave.additive = presetFloat(presetValues, settings + "badditive", 0.0f) != 0.0f;
+        wave.scaling = presetFloat(presetValues, settings + "scaling", 1.0f);
+        wave.smoothing = presetFloat(presetValues, settings + "smoothing", 0.5f);
+        wave.r = presetFloat(presetValues, settings + "r", 1.0f);
+        wave.g = presetFloat(presetValues, settings + "g", 1.0f);
+        wave.b = presetFloat(presetValues, settings + "b", 1.0f);
+        wave.a = presetFloat(presetValues, settings + "a", 1.0f);
+
+        const std::string code = "wave_" + std::to_string(index) + "_";
+        wave.initCode = presetCode(presetValues, code + "init");
+        wave.perFrameCode = presetCode(presetValues, code + "per_frame");
+        wave.perPointCode = presetCode(presetValues, code + "per_point");
+        if (wave.pointCount() > 0)
+        {
+            waves.push_back(std::move(wave));
+        }
+    }
+    return waves;
+}
+
+std::string CustomWaveRenderer::generatePointHelpers(bool audioTexture)
+{
+    std::string glsl;
+    if (audioTexture)
+    {
+        glsl += R"___(
+// Packed audio (AudioTexturePacker): row 0 holds the aligned waveform, row 1 the spectrum.
+uniform sampler2D iAudioTexture;
+
+vec2 custom_wave_audio(int index, bool spectrum)
+{
+    return texelFetch(iAudioTexture, ivec2(index, spectrum ? 1 : 0), 0).rg;
+}
+)___";
+    }
+    else
+    {
+        glsl += R"___(
+// Stand-in samples while no audio texture is bound: a sine scaled by the bass (left) and
+// mid (right) levels, and a spectrum stepping through the three band levels.
+vec2 custom_wave_audio(int index, bool spectrum)
+{
+    if (spectrum)
+    {
+        return vec2(index < 171 ? iAudioBands.x : (index < 342 ? iAudioBands.y : iAudioBands.z));
+    }
+    return 0.25 * iAudioBands.xy * sin(float(index) * 0.19634954);
+}
+)___";
+    }
+    glsl += R"___(
+// CustomWaveform.cpp smooths the samples forward and then backward with the same one-pole
+// filter; together they form the symmetric kernel mix1^|d|, applied here directly and
+// truncated at taps points. Indices past either end clamp to the first or last point.
+vec2 custom_wave_value(int point, int count, ivec2 offset, int stride, bool spectrum, float mix1, int taps, float mult)
+{
+    vec2 sum = vec2(0.0);
+    float weight_sum = 0.0;
+    for (int d = -taps; d <= taps; ++d)
+    {
+        int source = clamp(point + d, 0, count - 1) * stride;
+        float weight = d == 0 ? 1.0 : pow(mix1, float(abs(d)));
+        sum += weight * vec2(custom_wave_audio(source + offset.x, spectrum).x, custom_wave_audio(source + offset.y, spectrum).y);
+        weight_sum += weight;
+    }
+    return sum / weight_sum * mult;
+}
+
+// MilkDrop wave space (x right, y down) to screen uv, with CustomWaveform.cpp's aspect correction.
+vec2 custom_wave_screen(vec2 point)
+{
+    vec2 inv_aspect = vec2(min(1.0, iResolution.y / iResolution.x), min(1.0, iResolution.x / iResolution.y));
+    return vec2(0.5) + (vec2(point.x, 1.0 - point.y) - vec2(0.5)) * inv_aspect;
+}
+
+// Renderer::color_modulo(): colours wrap at 256/255 instead of saturating.
+vec4 custom_wave_color(vec4 color)
+{
+    return clamp(mod(color, 256.0 / 255.0), 0.0, 1.0);
+}
+)___";
+    return glsl;
+}
+
+std::string CustomWaveRenderer::generateValueCall(const CustomWave& wave, const std::string& point, float waveScale)
+{
+    const int count = wave.pointCount();
+    const int maxSamples = wave.spectrum ? kSpectrumSamples : kWaveformSamples;
+    const int offset1 = wave.spectrum ? 0 : (maxSamples - count) / 2 - wave.sep / 2;
+    const int offset2 = wave.spectrum ? 0 : (maxSamples - count) / 2 + wave.sep / 2;
+    const int stride = wave.spectrum ? static_cast<int>(static_cast<float>(maxSamples - wave.sep) / static_cast<float>(count)) : 1;
+    const float mix1 = std::pow(std::max(0.0f, wave.smoothing * 0.98f), 0.5f);
+
+    // Taps until the weight falls below 1e-3 of the centre sample.
+    int taps = 0;
+    if (mix1 >= 1.0f)
+    {
+        taps = kMaxSmoothingTaps;
+    }
+    else if (mix1 > 0.0f)
+    {
+        taps = std::min(kMaxSmoothingTaps, static_cast<int>(std::ceil(std::log(1e-3f) / std::log(mix1))));
+    }
+
+    // The texture holds the waveform normalized to [-1, 1]; libprojectM's 0.004 factor
+    // expects it scaled to [-128, 128].
+    const float mult = wave.scaling * waveScale * (wave.spectrum ? 0.15f : 0.004f * 128.0f);
+    return "custom_wave_value(" + point + ", " + std::to_string(count) + ", ivec2(" + std::to_string(offset1) + ", " +
+           std::to_string(offset2) + "), " + std::to_string(stride) + ", " + glslBool(wave.spectrum) + ", " +
+           glslFloat(mix1) + ", " + std::to_string(taps) + ", " + glslFloat(mult) + ")";
+}
+
+std::string CustomWaveRenderer::generateBoundsPass()
+{
+    std::string glsl = "#version 330 core\n\nout vec4 FragColor;\n\nuniform sampler2D iCustomWavePoints;\n\n";
+    glsl += "const int CUSTOM_WAVE_CHUNK_POINTS = " + std::to_string(kChunkPoints) + ";\n";
+    glsl += "const int CUSTOM_WAVE_MAX_POINTS = " + std::to_string(kPointsWidth) + ";\n";
+    glsl += R"___(
+// One texel per chunk and wave: (min.x, min.y, max.x, max.y) of the chunk's valid points
+// and the first point of the next chunk, which its last segment ends on. Chunks without
+// points get an empty (inverted) box.
+void main()
+{
+    int chunk = int(gl_FragCoord.x);
+    int wave = int(gl_FragCoord.y);
+    vec4 box = vec4(1e6, 1e6, -1e6, -1e6);
+    for (int i = 0; i <= CUSTOM_WAVE_CHUNK_POINTS; ++i)
+    {
+        int point = min(chunk * CUSTOM_WAVE_CHUNK_POINTS + i, CUSTOM_WAVE_MAX_POINTS - 1);
+        vec4 position = texelFetch(iCustomWavePoints, ivec2(point, 2 * wave), 0);
+        if (position.z > 0.5)
+        {
+            box = vec4(min(box.xy, position.xy), max(box.zw, position.xy));
+        }
+    }
+    FragColor = box;
+}
+)___";
+    return glsl;
+}
+
+std::string CustomWaveRenderer::generateDrawGLSL()
+{
+    std::string glsl = R"___(
+// Custom waves, evaluated once per frame by the custom_wave_points pass and boxed per
+// chunk by the custom_wave_bounds pass.
+uniform sampler2D iCustomWavePoints;
+uniform sampler2D iCustomWaveBounds;
+
+)___";
+    glsl += "const int CUSTOM_WAVE_CHUNK_POINTS = " + std::to_string(kChunkPoints) + ";\n";
+    glsl += "const int CUSTOM_WAVE_MAX_CHUNKS = " + std::to_string(kBoundsWidth) + ";\n";
+    glsl += R"___(
+// Blends the wave's lines (or dots) over color like the GL_LINE_STRIP/GL_POINTS draw in
+// CustomWaveform.cpp: one pixel wide, two for bDrawThick (four one-pixel offset copies),
+// additive or alpha blended. A strip rasterizes each pixel once, so the pixel takes the
+// strongest primitive rather than one blend per segment.
+vec3 custom_wave_draw(vec3 color, vec2 uv, int wave, int count, bool dots, bool thick, bool additive)
+{
+    vec2 pixel = uv * iResolution;
+    float half_width = thick ? 1.0 : 0.5;
+    float best_alpha = 0.0;
+    vec3 best_color = vec3(0.0);
+    int primitives = dots ? count : count - 1;
+    for (int chunk = 0; chunk < CUSTOM_WAVE_MAX_CHUNKS; ++chunk)
+    {
+        int first = chunk * CUSTOM_WAVE_CHUNK_POINTS;
+        if (first >= primitives)
+        {
+            break;
+        }
+        vec4 box = texelFetch(iCustomWaveBounds, ivec2(chunk, wave), 0) * iResolution.xyxy;
+        if (any(lessThan(pixel, box.xy - half_width - 0.5)) || any(greaterThan(pixel, box.zw + half_width + 0.5)))
+        {
+            continue;
+        }
+        // Each point is fetched once; colours only for the primitives that reach the pixel.
+        vec2 start = texelFetch(iCustomWavePoints, ivec2(first, 2 * wave), 0).xy * iResolution;
+        for (int i = 0; i < CUSTOM_WAVE_CHUNK_POINTS; ++i)
+        {
+            int point = first + i;
+            if (point >= primitives)
+            {
+                break;
+            }
+            vec2 end = dots ? start : texelFetch(iCustomWavePoints, ivec2(point + 1, 2 * wave), 0).xy * iResolution;
+            vec2 segment = end - start;
+            float h = dots ? 0.0 : clamp(dot(pixel - start, segment) / max(dot(segment, segment), 1e-6), 0.0, 1.0);
+            float distance_px = length(pixel - start - segment * h);
+            if (distance_px < half_width + 0.5)
+            {
+                vec4 point_color = texelFetch(iCustomWavePoints, ivec2(point, 2 * wave + 1), 0);
+                if (!dots)
+                {
+                    point_color = mix(point_color, texelFetch(iCustomWavePoints, ivec2(point + 1, 2 * wave + 1), 0), h);
+                }
+                float alpha = point_color.a * clamp(half_width + 0.5 - distance_px, 0.0, 1.0);
+                if (alpha > best_alpha)
+                {
+                    best_alpha = alpha;
+                    best_color = point_color.rgb;
+                }
+            }
+            start = dots ? texelFetch(iCustomWavePoints, ivec2(point + 1, 2 * wave), 0).xy * iResolution : end;
+        }
+    }
+    return additive ? color + best_color * best_alpha : mix(color, best_color, best_alpha);
+}
+)___";
+    return glsl;
+}
+
+std::string CustomWaveRenderer::generateDrawCall(const CustomWave& wave)
+{
+    return "    composedColor.rgb = custom_wave_draw(composedColor.rgb, gl_FragCoord.xy / iResolution.xy, " +
+           std::to_string(wave.index) + ", " + std::to_string(wave.pointCount()) + ", " + glslBool(wave.useDots) + ", " +
+           glslBool(wave.drawThick) + ", " + glslBool(wave.additive) + ");\n";
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One enabled custom waveform (wavecode_N_* settings and wave_N_* code blocks).
+ *
+ * Values follow libprojectM's CustomWaveform: the preset's sample count is clamped to
+ * the waveform (480) or spectrum (512) length and reduced by the channel separation.
+ */
+struct CustomWave {
+    int index = 0;
+    int samples = 512;
+    int sep = 0;
+    bool spectrum = false;
+    bool useDots = false;
+    bool drawThick = false;
+    bool additive = false;
+    float scaling = 1.0f;
+    float smoothing = 0.5f;
+    float r = 1.0f;
+    float g = 1.0f;
+    float b = 1.0f;
+    float a = 1.0f;
+    std::string initCode;
+    std::string perFrameCode;
+    std::string perPointCode;
+
+    /// Points evaluated and drawn each frame.
+    int pointCount() const;
+};
+
+/**
+ * @brief GLSL generation for custom waveforms.
+ *
+ * Per-point code cannot run per fragment, so the waves are evaluated in two prepasses:
+ * the points pass runs each wave's per-frame code once and its per-point code for one
+ * point per texel, and the bounds pass reduces every run of kChunkPoints points to a
+ * bounding box. The main shader only tests the segments of chunks whose box holds the
+ * fragment.
+ */
+class CustomWaveRenderer {
+public:
+    /// Enabled waves that draw at least one primitive, in index order.
+    static std::vector<CustomWave> parse(const std::map<std::string, std::string>& presetValues);
+
+    /// custom_wave_value(), custom_wave_screen() and custom_wave_color() for the points pass;
+    /// samples come from iAudioTexture when @p audioTexture is set and from the band levels otherwise.
+    static std::string generatePointHelpers(bool audioTexture);
+
+    /// Expression for the smoothed, scaled (value1, value2) pair of @p wave at point @p point.
+    static std::string generateValueCall(const CustomWave& wave, const std::string& point, float waveScale);
+
+    /// Complete fragment shader reducing iCustomWavePoints to per-chunk bounding boxes.
+    static std::string generateBoundsPass();
+
+    /// Samplers and custom_wave_draw() for the main shader.
+    static std::string generateDrawGLSL();
+
+    /// Statement blending @p wave over composedColor.rgb in the main shader.
+    static std::string generateDrawCall(const CustomWave& wave);
+
+    /// libprojectM evaluates at most four custom waves.
+    static constexpr int kMaxWaves = 4;
+    /// Points texture: two rows per wave, (x, y, valid, 0) in uv space, then (r, g, b, a).
+    static constexpr int kPointsWidth = 512;
+    static constexpr int kPointsHeight = 2 * kMaxWaves;
+    /// Points per bounding box; a box also covers the first point of the next chunk.
+    static constexpr int kChunkPoints = 16;
+    static constexpr int kBoundsWidth = kPointsWidth / kChunkPoints;
+    static constexpr int kBoundsHeight = kMaxWaves;
+    /// Upper bound for the smoothing kernel radius in points.
+    static constexpr int kMaxSmoothingTaps = 32;
+};
@@ -0,0 +1,19 @@
+// Mutex functions required by the projectm-eval library. They guard its megabuf and gmegabuf
+// allocations; the converter evaluates on one thread, but the reference renderer runs eval
+// contexts sharing one gmegabuf on several.
+#include <mutex>
+
+namespace {
+
+std::mutex& evalMemoryMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+} // namespace
+
+extern "C" {
+void projectm_eval_memory_host_lock_mutex() { evalMemoryMutex().lock(); }
+void projectm_eval_memory_host_unlock_mutex() { evalMemoryMutex().unlock(); }
+}
@@ -0,0 +1,86 @@
+#include "GLSLTokenizer.hpp"
+
+#include <cctype>
+
+std::vector<GLSLToken> tokenizeGLSL(const std::string& source)
+{
+    std::vector<GLSLToken> tokens;
+    tokens.reserve(source.size() / 4);
+    const size_t size = source.size();
+    bool lineStart = true;
+    for (size_t i = 0; i < size;)
+    {
+        char c = source[i];
+        if (c == '\n')
+        {
+            lineStart = true;
+            ++i;
+            continue;
+        }
+        if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            ++i;
+            continue;
+        }
+        // Preprocessor lines are skipped, so code in both #ifdef branches is seen.
+        if (c == '#' && lineStart)
+        {
+            while (i < size && source[i] != '\n') ++i;
+            continue;
+        }
+        lineStart = false;
+        if (c == '/' && i + 1 < size && source[i + 1] == '/')
+        {
+            while (i < size && source[i] != '\n') ++i;
+            continue;
+        }
+        if (c == '/' && i + 1 < size && source[i + 1] == '*')
+        {
+            size_t end = source.find("*/", i + 2);
+            i = (end == std::string::npos) ? size : end + 2;
+            continue;
+        }
+        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+        {
+            size_t start = i;
+            while (i < size && (std::isalnum(static_cast<unsigned char>(source[i])) || source[i] == '_')) ++i;
+            tokens.push_back({GLSLToken::Kind::Identifier, source.substr(start, i - start), start});
+            continue;
+        }
+        if (std::isdigit(static_cast<unsigned char>(c)) || (c == '.' && i + 1 < size && std::isdigit(static_cast<unsigned char>(source[i + 1]))))
+        {
+            size_t start = i;
+            while (i < size)
+            {
+                char d = source[i];
+                if ((d == '+' || d == '-') && (source[i - 1] == 'e' || source[i - 1] == 'E'))
+                {
+                    ++i;
+                    continue;
+                }
+                if (!std::isalnum(static_cast<unsigned char>(d)) && d != '.') break;
+                ++i;
+            }
+            tokens.push_back({GLSLToken::Kind::Number, source.substr(start, i - start), start});
+            continue;
+        }
+
+        static const char kTwoCharOperators[][3] = {"++", "--", "+=", "-=", "*=", "/=", "%=", "<=", ">=", "==", "!=", "&&", "||"};
+        size_t length = 1;
+        if (i + 1 < size)
+        {
+            for (const char* candidate : kTwoCharOperators)
+            {
+                if (c == candidate[0] && source[i + 1] == candidate[1])
+                {
+                    length = 2;
+                    break;
+                }
+            }
+        }
+        std::string op = source.substr(i, length);
+        tokens.push_back({GLSLToken::Kind::Punctuation, op, i});
+        i += op.size();
+    }
+    return tokens;
+}
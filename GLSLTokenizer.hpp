@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One lexical token of generated GLSL.
+ *
+ * @c offset is the position of the first character in the source, so passes that
+ * rewrite the shader can splice text without re-printing it.
+ */
+struct GLSLToken {
+    enum class Kind { Identifier, Number, Punctuation };
+    Kind kind;
+    std::string text;
+    size_t offset;
+
+    size_t end() const { return offset + text.size(); }
+};
+
+/// Splits @p source into tokens. Comments and preprocessor lines are skipped.
+std::vector<GLSLToken> tokenizeGLSL(const std::string& source);
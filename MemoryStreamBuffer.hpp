@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <streambuf>
+
+/**
+ * @brief Read-only, seekable stream buffer over memory the caller owns.
+ *
+ * Lets PresetFileParser::Read(std::istream&) parse a preset held in memory (an inflated
+ * archive entry, a buffer passed through the C API) without copying it into a string
+ * stream first. The parser seeks to the end to size the preset, so seeking is supported.
+ */
+class MemoryStreamBuffer : public std::streambuf {
+public:
+    MemoryStreamBuffer(const char* data, size_t size) {
+        char* begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override {
+        if (!(which & std::ios_base::in)) {
+            return pos_type(off_type(-1));
+        }
+        const off_type base = direction == std::ios_base::beg ? 0
+                            : direction == std::ios_base::cur ? gptr() - eback()
+                                                              : egptr() - eback();
+        const off_type position = base + offset;
+        if (position < 0 || position > egptr() - eback()) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), eback() + position, egptr());
+        return pos_type(position);
+    }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode which) override {
+        return seekoff(off_type(position), std::ios_base::beg, which);
+    }
+};
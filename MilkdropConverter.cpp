@@ -1,37 +1,24 @@
-// Dummy implementations for mutex functions required by the projectm-eval library.
-// This is a single-threaded application, so no actual locking is needed.
-extern "C" {
-void projectm_eval_memory_host_lock_mutex() {}
-void projectm_eval_memory_host_unlock_mutex() {}
-}
+#include "MilkdropConverter.hpp"
 
 #include <iostream>
 #include <fstream>
-#include <string>
-#include <vector>
-#include <set>
 #include <sstream>
-#include <unordered_map>
 #include <regex>
 #include <algorithm>
+#include <array>
 #include <cctype>
-#include <clocale>
 #include <cmath>
-
-#include "PresetFileParser.hpp"
-
-// Include internal headers from projectm-eval to access AST and context structures
-extern "C" {
-#include "projectm-eval.h"
-#include "projectm-eval/CompilerTypes.h"
-#include "projectm-eval/CompileContext.h"
-#include "projectm-eval/TreeFunctions.h"
-#include "projectm-eval/ExpressionTree.h"
-}
-
-// The public API uses an opaque pointer, so we must cast it to the internal type.
-#define internal_context(ctx) (reinterpret_cast<prjm_eval_compiler_context_t*>(ctx))
-
+#include <functional>
+
+#include "BlurPyramid.hpp"
+#include "MotionVectorRenderer.hpp"
+#include "PostEffects.hpp"
+#include "PresetShaderTranslator.hpp"
+#include "PresetValues.hpp"
+#include "Profiler.hpp"
+#include "RenderGraph.hpp"
+#include "ShaderSpecializer.hpp"
+#include "TranslationCache.hpp"
 #include "WaveModeRenderer.hpp"
 
 // A map of MilkDrop built-in variables to their GLSL equivalents.
@@ -54,15 +41,6 @@ const std::unordered_map<std::string, std::string> milkToGLSLVars = {
     {"aspecty", "(iResolution.x / iResolution.y)"},
 };
 
-// Metadata for generating UI controls for writable variables.
-struct UniformControl {
-    std::string defaultValue;
-    std::string widget;
-    std::string min;
-    std::string max;
-    std::string step;
-};
-
 const std::unordered_map<std::string, UniformControl> uniformControls = {
     {"zoom", {"1.0", "slider", "0.5", "1.5", "0.01"}},
     {"zoomexp", {"1.0", "slider", "0.5", "2.0", "0.01"}},
@@ -128,30 +106,74 @@ const std::unordered_map<std::string, std::string>& perPixelVariableRewrites() {
     return rewrites;
 }
 
-class GLSLGenerator {
-public:
-    GLSLGenerator(projectm_eval_context* context);
-    std::string generate(const prjm_eval_exptreenode* tree);
-    std::string generate(const prjm_eval_exptreenode* tree, const std::unordered_map<std::string, std::string>& variableOverrides);
-
-private:
-    std::string generateWithOverrides(const prjm_eval_exptreenode* tree, const std::unordered_map<std::string, std::string>* overrides);
-    std::string traverseNode(const prjm_eval_exptreenode* node);
-    bool isOperator(const prjm_eval_exptreenode* node);
-    bool isComparison(const prjm_eval_exptreenode* node);
-    bool isFunction(const prjm_eval_exptreenode* node);
-    bool isAssignment(const prjm_eval_exptreenode* node);
-    bool isConstant(const prjm_eval_exptreenode* node);
-    bool isVariable(const prjm_eval_exptreenode* node);
-    std::string getFunctionName(const prjm_eval_exptreenode* node);
-    std::string getVariableName(const prjm_eval_exptreenode* node);
-    std::string getOperator(const prjm_eval_exptreenode* node);
-
-    std::unordered_map<void*, std::string> m_func_map;
-    std::set<void*> m_comparison_funcs;
-    projectm_eval_context* m_context;
-    const std::unordered_map<std::string, std::string>* m_variableOverrides;
-};
+namespace {
+
+thread_local ConversionReport* g_diagnostics = nullptr;
+
+void addDiagnostic(std::vector<std::string> ConversionReport::*list, const std::string& message) {
+    if (!g_diagnostics) return;
+    std::vector<std::string>& messages = g_diagnostics->*list;
+    if (std::find(messages.begin(), messages.end(), message) == messages.end()) {
+        messages.push_back(message);
+    }
+}
+
+} // namespace
+
+DiagnosticScope::DiagnosticScope(ConversionReport& report)
+    : m_previous(g_diagnostics) {
+    g_diagnostics = &report;
+}
+
+DiagnosticScope::~DiagnosticScope() {
+    g_diagnostics = m_previous;
+}
+
+void DiagnosticScope::error(const std::string& message) {
+    addDiagnostic(&ConversionReport::errors, message);
+}
+
+void DiagnosticScope::warning(const std::string& message) {
+    addDiagnostic(&ConversionReport::warnings, message);
+}
+
+namespace {
+
+// projectm-eval looks variables up case-insensitively and keeps the spelling of their first
+// use, so "MyVar" and "myvar" are one variable. Emitting them lower-cased keeps the GLSL
+// independent of which spelling a preset (or a cached statement of another preset) used first.
+// A name that is a GLSL 3.30 keyword or reserved word once lower-cased ("Float", "Out"), or
+// that GLSL reserves by prefix ("gl_") or by a double underscore, gets a "_var" suffix.
+std::string canonical_variable_name(const char* name) {
+    static const std::set<std::string> glslReserved = {
+        // Keywords
+        "attribute", "const", "uniform", "varying", "layout", "centroid", "flat", "smooth",
+        "noperspective", "break", "continue", "do", "for", "while", "switch", "case", "default",
+        "if", "else", "in", "out", "inout", "float", "int", "void", "bool", "true", "false",
+        "invariant", "discard", "return", "mat2", "mat3", "mat4", "mat2x2", "mat2x3", "mat2x4",
+        "mat3x2", "mat3x3", "mat3x4", "mat4x2", "mat4x3", "mat4x4", "vec2", "vec3", "vec4",
+        "ivec2", "ivec3", "ivec4", "bvec2", "bvec3", "bvec4", "uint", "uvec2", "uvec3", "uvec4",
+        "lowp", "mediump", "highp", "precision", "sampler1d", "sampler2d", "sampler3d",
+        "samplercube", "struct",
+        // Reserved for future use
+        "common", "partition", "active", "asm", "class", "union", "enum", "typedef", "template",
+        "this", "packed", "goto", "inline", "noinline", "volatile", "public", "static", "extern",
+        "external", "interface", "long", "short", "double", "half", "fixed", "unsigned", "superp",
+        "input", "output", "hvec2", "hvec3", "hvec4", "dvec2", "dvec3", "dvec4", "fvec2", "fvec3",
+        "fvec4", "sampler3drect", "filter", "image1d", "image2d", "image3d", "imagecube",
+        "sizeof", "cast", "namespace", "using", "row_major",
+    };
+    std::string canonical = name;
+    std::transform(canonical.begin(), canonical.end(), canonical.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (glslReserved.count(canonical) || canonical.compare(0, 3, "gl_") == 0 ||
+        canonical.find("__") != std::string::npos) {
+        canonical += "_var";
+    }
+    return canonical;
+}
+
+} // namespace
 
 GLSLGenerator::GLSLGenerator(projectm_eval_context* context)
     : m_context(context)
@@ -221,6 +243,43 @@ std::string GLSLGenerator::generate(const prjm_eval_exptreenode* tree, const std
     return generateWithOverrides(tree, &variableOverrides);
 }
 
+std::string GLSLGenerator::generateStatement(const prjm_eval_exptreenode* statement, const std::unordered_map<std::string, std::string>* variableOverrides) {
+    const auto* previousOverrides = m_variableOverrides;
+    m_variableOverrides = variableOverrides;
+    std::string result = "    " + traverseNode(statement) + ";\n";
+    m_variableOverrides = previousOverrides;
+    return result;
+}
+
+void GLSLGenerator::collectVariables(const prjm_eval_exptreenode* node, std::vector<std::string>& names) {
+    if (!node) return;
+    if (isVariable(node)) {
+        std::string name = getVariableName(node);
+        if (std::find(names.begin(), names.end(), name) == names.end()) names.push_back(name);
+        return;
+    }
+    if (node->args) {
+        for (int i = 0; node->args[i] != nullptr; ++i) collectVariables(node->args[i], names);
+    }
+    for (auto* item = node->list; item != nullptr; item = item->next) collectVariables(item->expr, names);
+}
+
+void GLSLGenerator::collectAssignedVariables(const prjm_eval_exptreenode* node, std::vector<std::string>& names) {
+    if (!node) return;
+    const bool compound = node->func == prjm_eval_func_add_op || node->func == prjm_eval_func_sub_op ||
+                          node->func == prjm_eval_func_mul_op || node->func == prjm_eval_func_div_op ||
+                          node->func == prjm_eval_func_mod_op || node->func == prjm_eval_func_bitwise_and_op ||
+                          node->func == prjm_eval_func_bitwise_or_op || node->func == prjm_eval_func_pow_op;
+    if ((isAssignment(node) || compound) && isVariable(node->args[0])) {
+        std::string name = getVariableName(node->args[0]);
+        if (std::find(names.begin(), names.end(), name) == names.end()) names.push_back(name);
+    }
+    if (node->args) {
+        for (int i = 0; node->args[i] != nullptr; ++i) collectAssignedVariables(node->args[i], names);
+    }
+    for (auto* item = node->list; item != nullptr; item = item->next) collectAssignedVariables(item->expr, names);
+}
+
 std::string GLSLGenerator::generateWithOverrides(const prjm_eval_exptreenode* tree, const std::unordered_map<std::string, std::string>* overrides) {
     if (!tree) return "";
     const auto* previousOverrides = m_variableOverrides;
@@ -228,10 +287,8 @@ std::string GLSLGenerator::generateWithOverrides(const prjm_eval_exptreenode* tr
 
     std::string result;
     if (tree->func == prjm_eval_func_execute_list) {
-        if (tree->args) {
-            for (int i = 0; tree->args[i] != nullptr; ++i) {
-                result += "    " + traverseNode(tree->args[i]) + ";\n";
-            }
+        for (auto* item = tree->list; item != nullptr; item = item->next) {
+            result += "    " + traverseNode(item->expr) + ";\n";
         }
     } else {
         result += "    " + traverseNode(tree) + ";\n";
@@ -266,6 +323,15 @@ std::string GLSLGenerator::traverseNode(const prjm_eval_exptreenode* node) {
     if (isAssignment(node)) {
         return traverseNode(node->args[0]) + " = " + traverseNode(node->args[1]);
     }
+    if (node->func == prjm_eval_func_execute_list) {
+        // Nested instruction lists, e.g. "(a = 1; b = 2)", map to the GLSL comma operator.
+        std::string sequence;
+        for (auto* item = node->list; item != nullptr; item = item->next) {
+            if (!sequence.empty()) sequence += ", ";
+            sequence += traverseNode(item->expr);
+        }
+        return "(" + sequence + ")";
+    }
     if (node->func == prjm_eval_func_neg) {
         return "(-" + traverseNode(node->args[0]) + ")";
     }
@@ -307,7 +373,9 @@ std::string GLSLGenerator::traverseNode(const prjm_eval_exptreenode* node) {
         if (funcName == "atan2") {
             return "atan(" + traverseNode(node->args[0]) + ", " + traverseNode(node->args[1]) + ")";
         }
-        if (funcName == "sqr") return "((" + traverseNode(node->args[0]) + ")*(" + traverseNode(node->args[0]) + "))";
+        // A helper call rather than "(x)*(x)", which would write the operand twice and double the
+        // size of the shader with every nested sqr().
+        if (funcName == "sqr") return "sqr_eel(" + traverseNode(node->args[0]) + ")";
         if (funcName == "rand") return "(rand(uv) * " + traverseNode(node->args[0]) + ")";
         if (funcName == "bnot") return "float_from_bool(" + traverseNode(node->args[0]) + " == 0.0)";
         if (funcName == "band") return "float_from_bool((" + traverseNode(node->args[0]) + " != 0.0) && (" + traverseNode(node->args[1]) + " != 0.0))";
@@ -353,115 +421,206 @@ std::string GLSLGenerator::getVariableName(const prjm_eval_exptreenode* n) {
     if (!m_context) return "/* no_ctx */";
     prjm_eval_variable_entry_t* current = internal_context(m_context)->variables.first;
     while (current) {
-        if (&current->variable->value == n->var) return current->variable->name;
+        if (&current->variable->value == n->var) return canonical_variable_name(current->variable->name);
         current = current->next;
     }
     return "/* var_not_found */";
 }
 std::string GLSLGenerator::getOperator(const prjm_eval_exptreenode* n) { return getFunctionName(n); }
 
-std::string clean_code(const std::string& code) {
-    std::string cleaned = code;
-
-    // Remove comments
-    size_t pos = 0;
-    while ((pos = cleaned.find("//", pos)) != std::string::npos) {
-        size_t end = cleaned.find('\n', pos);
-        if (end == std::string::npos) end = cleaned.size();
-        cleaned.erase(pos, end - pos);
+namespace {
+
+// Characters that leave an expression open at the end of a physical line, so the
+// statement continues on the next line instead of being terminated.
+bool continues_statement(char c) {
+    switch (c) {
+        case ',': case '(': case '[': case '+': case '-': case '*': case '/':
+        case '%': case '^': case '&': case '|': case '=': case '<': case '>':
+        case '!': case '?': case ':':
+            return true;
+        default:
+            return false;
     }
+}
 
-    // Handle line continuations: replace tokens, \n with , (space)
-    pos = 0;
-    while ((pos = cleaned.find(",\n", pos)) != std::string::npos) {
-        cleaned.replace(pos, 2, ", ");
-    }
-
-    // Now split into individual statements and ensure ; termination
-    std::stringstream ss(cleaned);
-    std::string line;
-    cleaned.clear();
-    while (std::getline(ss, line, '\n')) {
-        // Trim whitespace
-        line.erase(0, line.find_first_not_of(" \t"));
-        line.erase(line.find_last_not_of(" \t") + 1);
-
-        if (line.empty()) continue;
-
-        // Ensure ; at end if not present
-        if (line.back() != ';') {
-            line += ';';
+} // namespace
+
+// Prepares a MilkDrop code block for the projectm-eval compiler in a single pass:
+// strips // and /* */ comments, terminates each top-level statement with ';' and
+// records statement boundaries. Newlines are preserved so compiler error lines map
+// straight back to the source block. Line breaks inside parentheses or after an
+// operator continue the current statement (e.g. multi-line loop() bodies), so a bracket
+// that is never closed would swallow the rest of the block: that statement is dropped
+// and scanning resumes on the line after the bracket.
+PreparedCode clean_code(const std::string& code) {
+    ProfileScope profile("clean");
+    PreparedCode prepared;
+    std::string& out = prepared.text;
+    out.reserve(code.size() + code.size() / 16 + 2);
+
+    int depth = 0;
+    int line = 1;
+    char lastSignificant = ';';
+    bool inStatement = false;
+    size_t statementStart = 0;
+    int statementLine = 1;
+
+    // The outermost bracket still open in the current statement, and the first line break
+    // after it: where scanning resumes if the bracket is never closed.
+    char openBracket = 0;
+    int openLine = 0;
+    int openColumn = 0;
+    size_t lineStart = 0;
+    size_t resumeAt = std::string::npos;
+    size_t resumeOut = 0;
+    int resumeLine = 0;
+
+    auto closeStatement = [&](bool appendTerminator) {
+        if (!inStatement) return;
+        size_t end = out.find_last_not_of(" \t\r\n");
+        if (appendTerminator) {
+            out.insert(end + 1, 1, ';');
         }
+        prepared.statements.push_back({statementStart, end + 1 - statementStart, statementLine});
+        inStatement = false;
+        lastSignificant = ';';
+    };
 
-        cleaned += line + "\n";
-    }
-
-    return cleaned;
-}
+    const size_t size = code.size();
+    for (size_t i = 0;; ++i) {
+        if (i >= size) {
+            if (depth <= 0 || !inStatement) break;
+            const bool resume = resumeAt != std::string::npos;
+            std::string statement = out.substr(statementStart, (resume ? resumeOut : out.size()) - statementStart);
+            std::replace(statement.begin(), statement.end(), '\n', ' ');
+            statement.erase(statement.find_last_not_of(" \t\r") + 1);
+            prepared.dropped.push_back("statement '" + statement + "' left out, '" + openBracket +
+                                       "' opened at line " + std::to_string(openLine) + ", col " +
+                                       std::to_string(openColumn) + " is never closed");
+            out.resize(statementStart);
+            inStatement = false;
+            if (!resume) break;
+            out.append(resumeLine - statementLine, '\n');
+            line = resumeLine;
+            i = resumeAt;
+            depth = 0;
+            lastSignificant = ';';
+            resumeAt = std::string::npos;
+        }
+        char c = code[i];
 
-// Helper function to compile a block of statements into a single AST
-prjm_eval_exptreenode* compile_statements(projectm_eval_context* ctx, std::string code) {
-    code = clean_code(code);
-    std::vector<prjm_eval_program_t*> programs;
-    std::stringstream ss(code);
-    std::string statement;
-
-    while (std::getline(ss, statement, ';')) {
-        // Trim leading/trailing whitespace
-        statement.erase(0, statement.find_first_not_of(" \t\n\r"));
-        statement.erase(statement.find_last_not_of(" \t\n\r") + 1);
-
-        if (statement.empty()) {
+        if (c == '/' && i + 1 < size && code[i + 1] == '/') {
+            while (i + 1 < size && code[i + 1] != '\n') ++i;
+            continue;
+        }
+        if (c == '/' && i + 1 < size && code[i + 1] == '*') {
+            i += 2;
+            while (i < size && !(code[i] == '*' && i + 1 < size && code[i + 1] == '/')) {
+                if (code[i] == '\n') {
+                    out += '\n';
+                    ++line;
+                    lineStart = i + 1;
+                }
+                ++i;
+            }
+            ++i;
             continue;
         }
 
-        prjm_eval_program_t* program = prjm_eval_compile_code(internal_context(ctx), statement.c_str());
-        if (program && program->program) {
-            programs.push_back(program);
-        } else {
-            int line, col;
-            const char* error = projectm_eval_get_error(ctx, &line, &col);
-            std::cerr << "Error parsing statement '" << statement << "': " << (error ? error : "Unknown error") << " at line " << line << ", col " << col << std::endl;
-            if(program) {
-                prjm_eval_destroy_code(program);
+        if (c == '\n') {
+            if (depth <= 0 && !continues_statement(lastSignificant)) {
+                closeStatement(true);
             }
-            // Clean up already compiled programs
-            for(auto p : programs) {
-                prjm_eval_destroy_code(p);
+            if (depth > 0 && resumeAt == std::string::npos) {
+                resumeAt = i;
+                resumeOut = out.size();
+                resumeLine = line;
             }
-            return nullptr;
+            out += '\n';
+            ++line;
+            lineStart = i + 1;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r') {
+            if (inStatement) out += c;
+            continue;
         }
-    }
 
-    if (programs.empty()) {
-        return nullptr;
+        if (c == ';' && depth <= 0) {
+            closeStatement(false);
+            out += ';';
+            continue;
+        }
+
+        if (!inStatement) {
+            inStatement = true;
+            statementStart = out.size();
+            statementLine = line;
+        }
+        if ((c == '(' || c == '[') && ++depth == 1) {
+            openBracket = c;
+            openLine = line;
+            openColumn = static_cast<int>(i - lineStart) + 1;
+            resumeAt = std::string::npos;
+        }
+        if (c == ')' || c == ']') --depth;
+        lastSignificant = c;
+        out += c;
     }
+    closeStatement(true);
 
-    // Manually create an execute_list node to combine all statements
-    prjm_eval_exptreenode* combined_ast = (prjm_eval_exptreenode*) calloc(1, sizeof(prjm_eval_exptreenode));
-    combined_ast->func = prjm_eval_func_execute_list;
-    combined_ast->args = (prjm_eval_exptreenode**) calloc(programs.size() + 1, sizeof(prjm_eval_exptreenode*));
+    profile.setOutputBytes(out.size());
+    return prepared;
+}
 
-    for (size_t i = 0; i < programs.size(); ++i) {
-        combined_ast->args[i] = programs[i]->program;
-        programs[i]->program = nullptr; // Avoid double-free by nulling the pointer
+// Compiles an already prepared block into a single AST. The whole block is handed
+// to the compiler at once; statement spans are only used to report which statement
+// a compile error belongs to.
+prjm_eval_exptreenode* compile_prepared(projectm_eval_context* ctx, const PreparedCode& prepared, std::string* error) {
+    if (prepared.statements.empty()) {
+        return nullptr;
     }
-    combined_ast->args[programs.size()] = nullptr; // Null-terminate the list
 
-    // Cleanup the now-empty program containers
-    for(auto p : programs) {
-        prjm_eval_destroy_code(p);
+    ProfileScope profile("compile");
+    prjm_eval_program_t* program = prjm_eval_compile_code(internal_context(ctx), prepared.text.c_str());
+    if (!program) {
+        if (!error) return nullptr;
+        int line = 0, col = 0;
+        const char* message = projectm_eval_get_error(ctx, &line, &col);
+        const StatementSpan* failing = &prepared.statements.front();
+        for (const auto& span : prepared.statements) {
+            if (span.line > line) break;
+            failing = &span;
+        }
+        std::string statement = prepared.text.substr(failing->offset, failing->length);
+        std::replace(statement.begin(), statement.end(), '\n', ' ');
+        *error = "error parsing statement '" + statement + "': " + (message ? message : "Unknown error") + " at line " +
+                 std::to_string(line) + ", col " + std::to_string(col);
+        return nullptr;
     }
 
-    return combined_ast;
+    prjm_eval_exptreenode* ast = program->program;
+    program->program = nullptr; // The caller owns the tree from here on
+    prjm_eval_destroy_code(program);
+    return ast;
+}
+
+// Helper function to compile a block of statements into a single AST
+prjm_eval_exptreenode* compile_statements(projectm_eval_context* ctx, const std::string& code) {
+    return compile_prepared(ctx, clean_code(code));
+}
+
+bool isUserVar(const std::string& varName) {
+    static const std::regex stateVarPattern("q[1-9][0-9]?|t[1-8]");
+    return milkToGLSLVars.count(varName) == 0 && uniformControls.count(varName) == 0 && !std::regex_match(varName, stateVarPattern);
 }
 
 std::set<std::string> findUserVars(prjm_eval_compiler_context_t* ctx) {
     std::set<std::string> userVars;
     prjm_eval_variable_entry_t* current = ctx->variables.first;
     while(current) {
-        std::string varName = current->variable->name;
-        if (milkToGLSLVars.count(varName) == 0 && uniformControls.count(varName) == 0 && !std::regex_match(varName, std::regex("q[1-9][0-9]?|t[1-8]"))) {
+        std::string varName = canonical_variable_name(current->variable->name);
+        if (isUserVar(varName)) {
             userVars.insert(varName);
         }
         current = current->next;
@@ -469,12 +628,98 @@ std::set<std::string> findUserVars(prjm_eval_compiler_context_t* ctx) {
     return userVars;
 }
 
-struct WaveformComponents {
-    std::string glsl;
-    std::string callPattern;
-};
+// Translates a code block statement by statement through the shared TranslationCache.
+// Cached statements are emitted without compiling; the remaining ones are compiled
+// together in one call and stored. If the compiler folds statements away so results
+// can no longer be matched to their source, the block is emitted uncached.
+TranslatedBlock translate_block(projectm_eval_context* ctx, GLSLGenerator& generator, const std::string& code,
+                                const std::string& scope, const std::unordered_map<std::string, std::string>* overrides) {
+    TranslatedBlock block;
+    PreparedCode prepared = clean_code(code);
+    for (const auto& message : prepared.dropped) {
+        DiagnosticScope::error(scope + " " + message);
+    }
+    const size_t count = prepared.statements.size();
+    if (count == 0) {
+        return block;
+    }
 
-WaveformComponents generateWaveformComponents(const libprojectM::PresetFileParser::ValueMap& presetValues) {
+    auto& cache = TranslationCache::instance();
+    std::vector<std::string> keys(count);
+    std::vector<TranslationCache::Entry> entries(count);
+    std::vector<size_t> misses;
+    {
+        ProfileScope profile("cache_lookup");
+        for (size_t i = 0; i < count; ++i) {
+            const auto& span = prepared.statements[i];
+            keys[i] = TranslationCache::makeKey(scope, prepared.text.data() + span.offset, span.length);
+            if (!cache.lookup(keys[i], entries[i])) {
+                misses.push_back(i);
+            }
+        }
+    }
+
+    if (!misses.empty()) {
+        PreparedCode missBlock;
+        if (misses.size() == count) {
+            missBlock = std::move(prepared);
+        } else {
+            std::string missText;
+            for (size_t index : misses) {
+                const auto& span = prepared.statements[index];
+                missText.append(prepared.text, span.offset, span.length);
+                missText += ";\n";
+            }
+            missBlock = clean_code(missText);
+        }
+
+        std::string error;
+        prjm_eval_exptreenode* ast = compile_prepared(ctx, missBlock, &error);
+        if (!ast) {
+            DiagnosticScope::error(scope + " code left out, " + error);
+            return block;
+        }
+
+        std::vector<const prjm_eval_exptreenode*> statements;
+        if (ast->func == prjm_eval_func_execute_list) {
+            for (auto* item = ast->list; item != nullptr; item = item->next) statements.push_back(item->expr);
+        } else {
+            statements.push_back(ast);
+        }
+
+        if (statements.size() != misses.size()) {
+            if (misses.size() != count) {
+                prjm_eval_destroy_exptreenode(ast);
+                ast = compile_statements(ctx, code);
+            }
+            ProfileScope profile("generate");
+            block.glsl = overrides ? generator.generate(ast, *overrides) : generator.generate(ast);
+            if (ast) prjm_eval_destroy_exptreenode(ast);
+            profile.setOutputBytes(block.glsl.size());
+            return block;
+        }
+
+        ProfileScope profile("generate");
+        size_t generatedBytes = 0;
+        for (size_t k = 0; k < misses.size(); ++k) {
+            auto& entry = entries[misses[k]];
+            entry.glsl = generator.generateStatement(statements[k], overrides);
+            generator.collectVariables(statements[k], entry.variables);
+            cache.store(keys[misses[k]], entry);
+            generatedBytes += entry.glsl.size();
+        }
+        prjm_eval_destroy_exptreenode(ast);
+        profile.setOutputBytes(generatedBytes);
+    }
+
+    for (const auto& entry : entries) {
+        block.glsl += entry.glsl;
+        block.variables.insert(block.variables.end(), entry.variables.begin(), entry.variables.end());
+    }
+    return block;
+}
+
+int presetWaveMode(const libprojectM::PresetFileParser::ValueMap& presetValues) {
     // Extract nWaveMode from preset values, default to 6
     // PresetFileParser lowercases all keys, so we need to look for "nwavemode"
     int nWaveMode = 6;
@@ -486,38 +731,302 @@ WaveformComponents generateWaveformComponents(const libprojectM::PresetFileParse
             // ignore and use default
         }
     }
+    return nWaveMode;
+}
+
+void presetShaderVersions(const libprojectM::PresetFileParser::ValueMap& presetValues, int& warpVersion, int& compositeVersion) {
+    // Same shader model selection as libprojectM's PresetState: MilkDrop 1 presets have no
+    // shaders and 2.0 presets share one version for both.
+    const int presetVersion = static_cast<int>(presetFloat(presetValues, "milkdrop_preset_version", 100.0f));
+    warpVersion = 0;
+    compositeVersion = 0;
+    if (presetVersion == 200) {
+        warpVersion = compositeVersion = static_cast<int>(presetFloat(presetValues, "psversion", 2.0f));
+    } else if (presetVersion > 200) {
+        warpVersion = static_cast<int>(presetFloat(presetValues, "psversion_warp", 2.0f));
+        compositeVersion = static_cast<int>(presetFloat(presetValues, "psversion_comp", 2.0f));
+    }
+}
+
+WaveformComponents generateWaveformComponents(const libprojectM::PresetFileParser::ValueMap& presetValues, const WaveBudget& budget) {
+    ProfileScope profile("wave");
+    int nWaveMode = presetWaveMode(presetValues);
 
     WaveformComponents components;
-    components.glsl = WaveModeRenderer::generateWaveformGLSL(nWaveMode, presetValues);
-    components.callPattern = WaveModeRenderer::generateCallPattern(nWaveMode, presetValues);
+    components.glsl = WaveModeRenderer::generateWaveformGLSL(nWaveMode, presetValues, budget);
+    components.callPattern = WaveModeRenderer::generateCallPattern(nWaveMode, presetValues, budget);
+    profile.setOutputBytes(components.glsl.size() + components.callPattern.size());
     return components;
 }
 
+namespace {
+
+// customWaveComponents.glsl declares custom_wave_draw(); its callPattern holds one draw statement per wave.
+// customShapeComponents likewise declares and calls custom_shape_draw(), and
+// motionVectorComponents motion_vector_draw(). postEffectCall draws the darken-centre diamond
+// and the borders last.
+// With presetWarp set, the feedback comes from the preset_warp pass instead of iChannel0.
+std::string assembleShader(const std::string& perFrameGLSL, const std::string& perPixelGLSL, const std::set<std::string>& userVars,
+                           const WaveformComponents& waveformComponents, const WaveformComponents& customWaveComponents,
+                           const WaveformComponents& customShapeComponents, const WaveformComponents& motionVectorComponents,
+                           const std::string& postEffectCall, const libprojectM::PresetFileParser::ValueMap& presetValues,
+                           bool presetWarp);
+
+// Lowers the wave loop cap until the shader fits options.maxCost, down to the
+// WaveModeRenderer::kMinWarmupIterations cap. The loop cost is linear in the cap, so the search keeps
+// the largest cap that fits.
+std::vector<ShaderPass> assembleWavePasses(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                                           const libprojectM::PresetFileParser::ValueMap& presetValues, const WaveBudget& budget);
+ShaderPass assembleFieldPass(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                             const libprojectM::PresetFileParser::ValueMap& presetValues, const WaveBudget& budget);
+std::vector<ShaderPass> assembleCustomWavePasses(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                                                 const libprojectM::PresetFileParser::ValueMap& presetValues,
+                                                 const std::vector<CustomWave>& waves, bool audioTexture);
+std::vector<ShaderPass> assembleCustomShapePasses(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                                                  const libprojectM::PresetFileParser::ValueMap& presetValues,
+                                                  const std::vector<CustomShape>& shapes);
+ShaderPass assembleMotionVectorPass(const std::string& perFrameGLSL, const std::string& perPixelGLSL, const std::set<std::string>& userVars,
+                                    const libprojectM::PresetFileParser::ValueMap& presetValues);
+ShaderPass assemblePostCompositePass(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                                     const libprojectM::PresetFileParser::ValueMap& presetValues, const PostEffectFlags& flags,
+                                     uint64_t seed);
+
+struct PresetShaders {
+    PresetShader warp;
+    PresetShader composite;
+};
+
+// The preset's warp_N and comp_N shaders, for the shader model its version enables; a shader
+// that does not translate is dropped with a warning, as libprojectM falls back to its defaults.
+PresetShaders translatePresetShaders(const libprojectM::PresetFileParser::ValueMap& presetValues);
+ShaderPass assemblePresetWarpPass(const std::string& perFrameGLSL, const std::string& perPixelGLSL, const std::set<std::string>& userVars,
+                                  const libprojectM::PresetFileParser::ValueMap& presetValues, const PresetShader& warp);
+ShaderPass assemblePresetCompositePass(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                                       const libprojectM::PresetFileParser::ValueMap& presetValues, const PresetShader& composite);
+// Blur levels 1 to @p level of the pyramid the preset shaders sample, blurring @p source.
+std::vector<ShaderPass> assembleBlurPasses(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                                           const libprojectM::PresetFileParser::ValueMap& presetValues, int level,
+                                           const std::string& source);
+
+using CostFunction = std::function<ShaderCost(const std::string&, const WaveBudget&)>;
+
+std::string enforceCostBudget(std::string glsl, const std::function<std::string(const WaveBudget&)>& assemble,
+                              const CostFunction& measure, int nWaveMode, double maxCost, ConversionReport& report) {
+    ProfileScope profile("cost");
+    report.cost = measure(glsl, WaveBudget{});
+    report.withinBudget = maxCost <= 0.0 || report.cost.weighted() <= maxCost;
+    if (report.withinBudget || WaveModeRenderer::defaultIterationCap(nWaveMode) == 0) {
+        return glsl;
+    }
+
+    int low = WaveModeRenderer::kMinWarmupIterations;
+    int high = WaveModeRenderer::defaultIterationCap(nWaveMode) - 1;
+    std::string best;
+    ShaderCost bestCost;
+    while (low <= high) {
+        WaveBudget budget;
+        budget.iterationCap = (low + high) / 2;
+        std::string candidate = assemble(budget);
+        ShaderCost cost = measure(candidate, budget);
+        if (cost.weighted() <= maxCost) {
+            best = std::move(candidate);
+            bestCost = cost;
+            report.wave = budget;
+            low = budget.iterationCap + 1;
+        } else {
+            high = budget.iterationCap - 1;
+        }
+    }
+
+    // Nothing fits: keep the coarsest wave, which still spans the full line, and report the overrun.
+    if (best.empty()) {
+        WaveBudget budget;
+        budget.iterationCap = WaveModeRenderer::kMinWarmupIterations;
+        best = assemble(budget);
+        bestCost = measure(best, budget);
+        report.wave = budget;
+    }
+    report.cost = bestCost;
+    report.withinBudget = bestCost.weighted() <= maxCost;
+    return best;
+}
+
+} // namespace
+
 std::string translateToGLSL(const std::string& perFrame, const std::string& perPixel, const libprojectM::PresetFileParser::ValueMap& presetValues) {
+    return translateToGLSL(perFrame, perPixel, presetValues, ConversionOptions{}, nullptr);
+}
+
+std::string translateToGLSL(const std::string& perFrame, const std::string& perPixel, const libprojectM::PresetFileParser::ValueMap& presetValues,
+                            const ConversionOptions& options, ConversionReport* report) {
+    ConversionReport localReport;
+    ConversionReport& result = report ? *report : localReport;
+    result = ConversionReport{};
+    DiagnosticScope diagnostics(result);
+
     projectm_eval_context* context = projectm_eval_context_create(nullptr, nullptr);
     if (!context) {
-        std::cerr << "Failed to create projectm-eval context." << std::endl;
+        DiagnosticScope::error("could not create a projectm-eval context");
         return "";
     }
 
-    prjm_eval_exptreenode* perFrameAST = compile_statements(context, perFrame);
-    prjm_eval_exptreenode* perPixelAST = compile_statements(context, perPixel);
-
-    auto userVars = findUserVars(internal_context(context));
     GLSLGenerator generator(context);
-    std::string perFrameGLSL = generator.generate(perFrameAST);
-    std::string perPixelGLSL = generator.generate(perPixelAST, perPixelVariableRewrites());
+    TranslatedBlock perFrameBlock = translate_block(context, generator, perFrame, "per_frame", nullptr);
+    TranslatedBlock perPixelBlock = translate_block(context, generator, perPixel, "per_pixel", &perPixelVariableRewrites());
+    const std::string& perFrameGLSL = perFrameBlock.glsl;
+    const std::string& perPixelGLSL = perPixelBlock.glsl;
 
-    // Cleanup the combined ASTs
-    if(perFrameAST) prjm_eval_destroy_exptreenode(perFrameAST);
-    if(perPixelAST) prjm_eval_destroy_exptreenode(perPixelAST);
+    std::set<std::string> userVars;
+    {
+        ProfileScope profile("user_vars");
+        userVars = findUserVars(internal_context(context));
+        for (const auto* block : {&perFrameBlock, &perPixelBlock}) {
+            for (const auto& var : block->variables) {
+                if (isUserVar(var)) userVars.insert(var);
+            }
+        }
+    }
 
     projectm_eval_context_destroy(context);
 
-    auto waveformComponents = generateWaveformComponents(presetValues);
+    const std::vector<CustomWave> customWaves = CustomWaveRenderer::parse(presetValues);
+    WaveformComponents customWaveComponents;
+    if (!customWaves.empty()) {
+        customWaveComponents.glsl = CustomWaveRenderer::generateDrawGLSL();
+        for (const auto& wave : customWaves) customWaveComponents.callPattern += CustomWaveRenderer::generateDrawCall(wave);
+    }
+    const std::vector<CustomShape> customShapes = CustomShapeRenderer::parse(presetValues);
+    WaveformComponents customShapeComponents;
+    if (!customShapes.empty()) {
+        customShapeComponents.glsl = CustomShapeRenderer::generateDrawGLSL();
+        customShapeComponents.callPattern = CustomShapeRenderer::generateDrawCall();
+    }
+    const bool motionVectors = MotionVectorRenderer::enabled(presetValues, perFrame);
+    WaveformComponents motionVectorComponents;
+    if (motionVectors) {
+        motionVectorComponents.glsl = MotionVectorRenderer::generateDrawGLSL();
+        motionVectorComponents.callPattern = MotionVectorRenderer::generateDrawCall();
+    }
+    const PostEffectFlags postEffects = PostEffects::parse(presetValues, perFrame);
+    const std::string postEffectCall = PostEffects::generateFrameCall(postEffects);
+
+    const PresetShaders presetShaders = translatePresetShaders(presetValues);
+    const bool presetWarp = !presetShaders.warp.glsl.empty();
+    const bool presetComposite = !presetShaders.composite.glsl.empty();
+
+    const int nWaveMode = presetWaveMode(presetValues);
+    const bool binned = options.waveGeometry && WaveModeRenderer::defaultIterationCap(nWaveMode) > 0;
+    const bool lowResolution = options.waveLowRes;
+    auto variant = [&](WaveBudget budget) {
+        budget.binned = binned;
+        budget.audioTexture = options.audioTexture;
+        return budget;
+    };
+    auto assemble = [&](WaveBudget budget) {
+        budget = variant(budget);
+        budget.lowResolution = lowResolution;
+        return assembleShader(perFrameGLSL, perPixelGLSL, userVars, generateWaveformComponents(presetValues, budget), customWaveComponents,
+                              customShapeComponents, motionVectorComponents, postEffectCall, presetValues, presetWarp);
+    };
+    // The preset shader passes shade every pixel whatever the wave budget.
+    ShaderPass warpPass;
+    ShaderPass compositePass;
+    ShaderCost presetShaderCost;
+    if (presetWarp) {
+        warpPass = assemblePresetWarpPass(perFrameGLSL, perPixelGLSL, userVars, presetValues, presetShaders.warp);
+        presetShaderCost += ShaderCostModel::analyze(warpPass.glsl);
+    }
+    if (presetComposite) {
+        compositePass = assemblePresetCompositePass(perFrameGLSL, userVars, presetValues, presetShaders.composite);
+        presetShaderCost += ShaderCostModel::analyze(compositePass.glsl);
+    } else if (postEffects.composite()) {
+        // Echo, gamma and the filters, which libprojectM only applies without a composite shader.
+        compositePass = assemblePostCompositePass(perFrameGLSL, userVars, presetValues, postEffects,
+                                                  TranslationCache::contentHash(perFrame + perPixel));
+        presetShaderCost += ShaderCostModel::analyze(compositePass.glsl);
+    }
+    // The blur pyramid blurs the warped frame, or the previous frame without a warp shader; each
+    // pass shades 1/divisor^2 of the pixels.
+    std::vector<ShaderPass> blurPasses;
+    const int blurLevel = std::max(presetWarp ? presetShaders.warp.blurLevel : 0,
+                                   presetComposite ? presetShaders.composite.blurLevel : 0);
+    if (blurLevel > 0) {
+        blurPasses = assembleBlurPasses(perFrameGLSL, userVars, presetValues, blurLevel, presetWarp ? "iPresetWarp" : "iChannel0");
+        for (const auto& pass : blurPasses) {
+            const uint64_t divisor = static_cast<uint64_t>(pass.resolutionDivisor);
+            presetShaderCost += ShaderCostModel::analyze(pass.glsl).divided(divisor * divisor);
+        }
+    }
+    // The field pass shades 1/divisor^2 of the pixels, so only that share counts per output pixel.
+    auto measure = [&](const std::string& shader, const WaveBudget& budget) {
+        ShaderCost cost = ShaderCostModel::analyze(shader);
+        cost += presetShaderCost;
+        if (lowResolution) {
+            const uint64_t divisor = WaveModeRenderer::kFieldDivisor;
+            ShaderPass field = assembleFieldPass(perFrameGLSL, userVars, presetValues, variant(budget));
+            cost += ShaderCostModel::analyze(field.glsl).divided(divisor * divisor);
+        }
+        return cost;
+    };
+    std::string glsl = assemble(WaveBudget{});
+    if (options.maxCost <= 0.0 && !report) {
+        return glsl;
+    }
 
+    glsl = enforceCostBudget(std::move(glsl), assemble, measure, nWaveMode, options.maxCost, result);
+    result.wave = variant(result.wave);
+    if (motionVectors) {
+        result.passes.push_back(assembleMotionVectorPass(perFrameGLSL, perPixelGLSL, userVars, presetValues));
+    }
+    if (presetWarp) {
+        result.passes.push_back(std::move(warpPass));
+    }
+    for (auto& pass : blurPasses) {
+        result.passes.push_back(std::move(pass));
+    }
+    if (result.wave.binned) {
+        for (auto& pass : assembleWavePasses(perFrameGLSL, userVars, presetValues, result.wave)) {
+            result.passes.push_back(std::move(pass));
+        }
+    }
+    if (lowResolution) {
+        result.passes.push_back(assembleFieldPass(perFrameGLSL, userVars, presetValues, result.wave));
+        result.wave.lowResolution = true;
+    }
+    if (!customWaves.empty()) {
+        for (auto& pass : assembleCustomWavePasses(perFrameGLSL, userVars, presetValues, customWaves, options.audioTexture)) {
+            result.passes.push_back(std::move(pass));
+        }
+    }
+    if (!customShapes.empty()) {
+        for (auto& pass : assembleCustomShapePasses(perFrameGLSL, userVars, presetValues, customShapes)) {
+            result.passes.push_back(std::move(pass));
+        }
+    }
+    if (!compositePass.glsl.empty()) {
+        result.composite = std::move(compositePass);
+    }
+    return glsl;
+}
+
+namespace {
+
+// Everything above main(): preamble, helpers, wave code and the annotated preset uniforms.
+std::string shaderPrelude(const std::string& waveformGLSL, const libprojectM::PresetFileParser::ValueMap& presetValues) {
     std::string glsl = "#version 330 core\n\n";
-    glsl += "out vec4 FragColor;\n\n";
+    glsl += "out vec4 FragColor;\n";
+    glsl += "\n// Standard RaymarchVibe uniforms\n";
+    glsl += "uniform float iTime;\n";
+    glsl += "uniform vec2 iResolution;\n";
+    glsl += "uniform float iFps;\n";
+    glsl += "uniform float iFrame;\n";
+    glsl += "uniform float iProgress;\n";
+    glsl += "uniform vec4 iAudioBands;\n";
+    glsl += "uniform vec4 iAudioBandsAtt;\n";
+    glsl += "uniform sampler2D iChannel0; // Feedback buffer\n";
+    glsl += "uniform sampler2D iChannel1;\n";
+    glsl += "uniform sampler2D iChannel2;\n";
+    glsl += "uniform sampler2D iChannel3;\n\n";
     glsl += "float float_from_bool(bool b) { return b ? 1.0 : 0.0; }\n\n";
     glsl += R"___(
 float rand(vec2 co){
@@ -525,6 +1034,9 @@ float rand(vec2 co){
 }
 )___";
     glsl += "const float EPSILON_EEL = 0.00001;\n";
+    glsl += "float sqr_eel(float value) {\n";
+    glsl += "    return value * value;\n";
+    glsl += "}\n";
     glsl += "float sigmoid_eel(float value, float response) {\n";
     glsl += "    float t = 1.0 + exp(-(value) * response);\n";
     glsl += "    return (abs(t) > EPSILON_EEL) ? (1.0 / t) : 0.0;\n";
@@ -541,19 +1053,8 @@ float rand(vec2 co){
     glsl += "float exec3_helper(float first, float second, float third) {\n";
     glsl += "    return third;\n";
     glsl += "}\n";
-    glsl += waveformComponents.glsl;
-    glsl += "\n// Standard RaymarchVibe uniforms\n";
-    glsl += "uniform float iTime;\n";
-    glsl += "uniform vec2 iResolution;\n";
-    glsl += "uniform float iFps;\n";
-    glsl += "uniform float iFrame;\n";
-    glsl += "uniform float iProgress;\n";
-    glsl += "uniform vec4 iAudioBands;\n";
-    glsl += "uniform vec4 iAudioBandsAtt;\n";
-    glsl += "uniform sampler2D iChannel0; // Feedback buffer\n";
-    glsl += "uniform sampler2D iChannel1;\n";
-    glsl += "uniform sampler2D iChannel2;\n";
-    glsl += "uniform sampler2D iChannel3;\n\n";
+    glsl += waveformGLSL;
+    glsl += "\n";
     glsl += "// Preset-specific uniforms with UI annotations\n";
     for (const auto& pair : uniformControls) {
         std::string defaultValue = pair.second.defaultValue;
@@ -563,7 +1064,12 @@ float rand(vec2 co){
         float numericDefault = 0.0f;
         bool hasNumericDefault = false;
 
-        if (auto it = presetValues.find(pair.first); it != presetValues.end()) {
+        // Settings such as echo_alpha are stored under their MilkDrop file name (fVideoEchoAlpha).
+        auto it = presetValues.find(pair.first);
+        if (it == presetValues.end()) {
+            it = presetValues.find(PostEffects::settingKey(pair.first));
+        }
+        if (it != presetValues.end()) {
             try {
                 numericDefault = std::stof(it->second);
                 defaultValue = it->second;
@@ -599,9 +1105,15 @@ float rand(vec2 co){
 
         glsl += "uniform float u_" + pair.first + " = " + defaultValue + "; // {\"widget\":\"" + pair.second.widget + "\",\"default\":" + defaultValue + ",\"min\":" + sliderMin + ",\"max\":" + sliderMax + ",\"step\":" + pair.second.step + "}\n";
     }
-    glsl += "\nvoid main() {\n";
+    return glsl;
+}
+
+// Opens main() and runs the per-frame code, leaving every preset variable in scope.
+std::string frameState(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                       const std::string& uvExpression = "gl_FragCoord.xy / iResolution.xy") {
+    std::string glsl = "\nvoid main() {\n";
     glsl += "    // Calculate UV coordinates from screen position\n";
-    glsl += "    vec2 uv = gl_FragCoord.xy / iResolution.xy;\n\n";
+    glsl += "    vec2 uv = " + uvExpression + ";\n\n";
     glsl += "    // Initialize local variables from uniforms\n";
     for(const auto& pair : uniformControls) {
         glsl += "    float " + pair.first + " = u_" + pair.first + ";\n";
@@ -615,9 +1127,11 @@ float rand(vec2 co){
     glsl += "    vec4 pixelColor = vec4(0.0, 0.0, 0.0, 0.0);\n";
     glsl += "\n    // Per-frame logic\n";
     glsl += perFrameGLSL;
-    glsl += "\n    // Per-pixel logic\n";
-    glsl += perPixelGLSL;
-    glsl += R"___(
+    return glsl;
+}
+
+// Turns the per-pixel motion into sampleUV, the feedback coordinate of this pixel.
+const char* kPixelTransform = R"___(
     // Apply coordinate transformations using per-pixel state.
     vec2 pixelCenter = vec2(cx, cy);
     vec2 pixelTranslate = vec2(dx, dy);
@@ -644,36 +1158,627 @@ float rand(vec2 co){
 
     vec2 sampleUV = pixelCenter + scaledUV + pixelTranslate;
     sampleUV = clamp(sampleUV, vec2(0.001), vec2(0.999));
+)___";
 
+std::string assembleShader(const std::string& perFrameGLSL, const std::string& perPixelGLSL, const std::set<std::string>& userVars,
+                           const WaveformComponents& waveformComponents, const WaveformComponents& customWaveComponents,
+                           const WaveformComponents& customShapeComponents, const WaveformComponents& motionVectorComponents,
+                           const std::string& postEffectCall, const libprojectM::PresetFileParser::ValueMap& presetValues,
+                           bool presetWarp) {
+    ProfileScope profile("assembly");
+    std::string helpers = waveformComponents.glsl + motionVectorComponents.glsl + customShapeComponents.glsl + customWaveComponents.glsl;
+    if (presetWarp) {
+        helpers += "\nuniform sampler2D iPresetWarp; // Output of the preset_warp pass\n";
+    }
+    std::string glsl = shaderPrelude(helpers, presetValues);
+    glsl += frameState(perFrameGLSL, userVars);
+    glsl += "\n    // Per-pixel logic\n";
+    glsl += perPixelGLSL;
+    glsl += kPixelTransform;
+    if (presetWarp) {
+        glsl += R"___(
+    // The preset warp shader already sampled and decayed the previous frame (preset_warp pass).
+    vec4 feedback = vec4(texture(iPresetWarp, uv).rgb, 1.0);
+)___";
+        glsl += motionVectorComponents.callPattern;
+    } else {
+        glsl += R"___(
     // Fetch feedback using the transformed UV and apply decay.
     vec4 feedback = texture(iChannel0, sampleUV);
-    float decayFactor = clamp(pixelDecay, 0.0, 1.0);
+)___";
+        glsl += motionVectorComponents.callPattern;
+        glsl += R"___(    float decayFactor = clamp(pixelDecay, 0.0, 1.0);
     feedback.rgb *= decayFactor;
-
+)___";
+    }
+    glsl += R"___(
     // Blend feedback with per-pixel color output.
     vec4 perPixelColor = clamp(pixelColor, 0.0, 1.0);
     float perPixelAlpha = clamp(perPixelColor.a, 0.0, 1.0);
     vec4 composedColor = mix(feedback, perPixelColor, perPixelAlpha);
-
-    // Preserve existing border tint.
-    vec4 border_color = clamp(vec4(ob_r, ob_g, ob_b, ob_a), 0.0, 1.0);
-    composedColor = mix(composedColor, border_color, border_color.a);
-
+)___";
+    if (!customShapeComponents.callPattern.empty()) {
+        glsl += "\n    // Custom shapes, drawn before the waves as in libprojectM.\n";
+        glsl += customShapeComponents.callPattern;
+    }
+    glsl += R"___(
     // Overlay waveforms.
     vec4 wave_color = clamp(vec4(wave_r, wave_g, wave_b, wave_a), 0.0, 1.0);
     float wave_intensity = )___";
     glsl += waveformComponents.callPattern;
     glsl += R"___(;
     composedColor.rgb = mix(composedColor.rgb, wave_color.rgb, clamp(wave_intensity * wave_color.a, 0.0, 1.0));
-
+)___";
+    if (!customWaveComponents.callPattern.empty()) {
+        glsl += "\n    // Custom waves, in wavecode order.\n";
+        glsl += customWaveComponents.callPattern;
+    }
+    glsl += postEffectCall;
+    glsl += R"___(
     FragColor = vec4(clamp(composedColor.rgb, 0.0, 1.0), clamp(composedColor.a, 0.0, 1.0));
 }
 )___";
+    profile.setOutputBytes(glsl.size());
     return glsl;
 }
 
+// The geometry pass repeats the per-frame code so the wave parameters match the main
+// shader, then evaluates one primitive per texel; the bin pass only reads its output.
+std::vector<ShaderPass> assembleWavePasses(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                                           const libprojectM::PresetFileParser::ValueMap& presetValues, const WaveBudget& budget) {
+    ProfileScope profile("wave_passes");
+    const int nWaveMode = presetWaveMode(presetValues);
+
+    ShaderPass geometry;
+    geometry.name = "wave_geometry";
+    geometry.sampler = "iWaveGeometry";
+    geometry.width = WaveModeRenderer::kGeometryWidth;
+    geometry.height = WaveModeRenderer::kGeometryHeight;
+    geometry.glsl = shaderPrelude(WaveModeRenderer::generateGeometryGLSL(nWaveMode, presetValues, budget), presetValues);
+    geometry.glsl += frameState(perFrameGLSL, userVars);
+    geometry.glsl += "\n    FragColor = " + WaveModeRenderer::generateGeometryCall(nWaveMode, presetValues) + ";\n}\n";
+
+    ShaderPass bins;
+    bins.name = "wave_bins";
+    bins.sampler = "iWaveBins";
+    bins.width = WaveModeRenderer::kBinTiles * WaveModeRenderer::kBinStride;
+    bins.height = WaveModeRenderer::kBinTiles;
+    bins.glsl = WaveModeRenderer::generateBinPass(nWaveMode, presetValues);
+
+    profile.setOutputBytes(geometry.glsl.size() + bins.glsl.size());
+    return {geometry, bins};
+}
+
+// The field pass runs the full wave evaluation on a target 1/kFieldDivisor the screen size
+// per axis. iResolution stays the screen size, so its uv comes from the scaled fragment
+// position and texel centres land on the same screen uv the main shader samples.
+ShaderPass assembleFieldPass(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                             const libprojectM::PresetFileParser::ValueMap& presetValues, const WaveBudget& budget) {
+    ProfileScope profile("wave_field");
+    WaveBudget fieldBudget = budget;
+    fieldBudget.lowResolution = false;
+    WaveformComponents components = generateWaveformComponents(presetValues, fieldBudget);
+
+    ShaderPass field;
+    field.name = "wave_field";
+    field.sampler = "iWaveField";
+    field.resolutionDivisor = WaveModeRenderer::kFieldDivisor;
+    field.glsl = shaderPrelude(components.glsl, presetValues);
+    field.glsl += frameState(perFrameGLSL, userVars,
+                             "gl_FragCoord.xy * " + std::to_string(WaveModeRenderer::kFieldDivisor) + ".0 / iResolution.xy");
+    field.glsl += "\n    vec2 pixelUV = uv;\n";
+    field.glsl += "    FragColor = vec4(" + components.callPattern + ", 0.0, 0.0, 1.0);\n}\n";
+    profile.setOutputBytes(field.glsl.size());
+    return field;
+}
 
-bool runSelfTests() {
+// The motion vector pass moves uv to one grid point per texel before the per-pixel code, so
+// its displacement is the warp of that point, the one libprojectM reads from the warp mesh.
+ShaderPass assembleMotionVectorPass(const std::string& perFrameGLSL, const std::string& perPixelGLSL, const std::set<std::string>& userVars,
+                                    const libprojectM::PresetFileParser::ValueMap& presetValues) {
+    ProfileScope profile("motion_vectors");
+    ShaderPass pass;
+    pass.name = "motion_vectors";
+    pass.sampler = "iMotionVectors";
+    pass.width = MotionVectorRenderer::kMaxColumns;
+    pass.height = MotionVectorRenderer::kMaxRows;
+    pass.glsl = shaderPrelude(MotionVectorRenderer::generateGridGLSL(), presetValues);
+    pass.glsl += frameState(perFrameGLSL, userVars);
+    pass.glsl += MotionVectorRenderer::generatePointStatement();
+    pass.glsl += "\n    // Per-pixel logic\n";
+    pass.glsl += perPixelGLSL;
+    pass.glsl += kPixelTransform;
+    pass.glsl += "\n    FragColor = vec4(sampleUV - uv, 0.0, 1.0);\n}\n";
+    profile.setOutputBytes(pass.glsl.size());
+    return pass;
+}
+
+PresetShaders translatePresetShaders(const libprojectM::PresetFileParser::ValueMap& presetValues) {
+    int warpVersion = 0;
+    int compositeVersion = 0;
+    presetShaderVersions(presetValues, warpVersion, compositeVersion);
+
+    PresetShaders shaders;
+    auto translate = [&](PresetShaderTranslator::Type type, int version, const char* prefix, PresetShader& shader) {
+        const std::string code = presetCode(presetValues, prefix);
+        if (version <= 0 || code.empty()) {
+            return;
+        }
+        shader = PresetShaderTranslator::translate(type, code);
+        if (shader.glsl.empty()) {
+            DiagnosticScope::warning(std::string(type == PresetShaderTranslator::Type::Warp ? "warp" : "composite") +
+                                     " shader not converted (" + shader.error + "); using the default path");
+        }
+    };
+    translate(PresetShaderTranslator::Type::Warp, warpVersion, "warp_", shaders.warp);
+    translate(PresetShaderTranslator::Type::Composite, compositeVersion, "comp_", shaders.composite);
+    return shaders;
+}
+
+// blur1_min ... blur3_max: the per-frame variables when the preset assigns them, the b1n ... b3x
+// settings otherwise.
+std::array<std::string, 6> presetBlurBounds(const std::set<std::string>& userVars,
+                                            const libprojectM::PresetFileParser::ValueMap& presetValues) {
+    const char* variables[6] = {"blur1_min", "blur1_max", "blur2_min", "blur2_max", "blur3_min", "blur3_max"};
+    const char* settings[6] = {"b1n", "b1x", "b2n", "b2x", "b3n", "b3x"};
+    std::array<std::string, 6> bounds;
+    for (int i = 0; i < 6; ++i) {
+        bounds[i] = userVars.count(variables[i]) ? variables[i] : glslFloat(presetFloat(presetValues, settings[i], i % 2 ? 1.0f : 0.0f));
+    }
+    return bounds;
+}
+
+// The warp pass repeats the per-frame and per-pixel code for the feedback coordinate, then runs
+// the preset's warp shader there in place of the main shader's feedback fetch and decay.
+ShaderPass assemblePresetWarpPass(const std::string& perFrameGLSL, const std::string& perPixelGLSL, const std::set<std::string>& userVars,
+                                  const libprojectM::PresetFileParser::ValueMap& presetValues, const PresetShader& warp) {
+    ProfileScope profile("warp_pass");
+    ShaderPass pass;
+    pass.name = "preset_warp";
+    pass.sampler = "iPresetWarp";
+    pass.resolutionDivisor = 1;
+    pass.glsl = shaderPrelude(warp.glsl, presetValues);
+    pass.glsl += frameState(perFrameGLSL, userVars);
+    pass.glsl += "\n    // Per-pixel logic\n";
+    pass.glsl += perPixelGLSL;
+    pass.glsl += kPixelTransform;
+    pass.glsl += PresetShaderTranslator::generateInputs(warp, presetBlurBounds(userVars, presetValues));
+    pass.glsl += R"___(
+    // uv is the warped feedback coordinate and uv_orig the pixel; _vDiffuse carries the decay.
+    vec4 warpColor;
+    vec4 motionVector;
+    float decayFactor = clamp(pixelDecay, 0.0, 1.0);
+    PS(vec4(vec3(decayFactor), 1.0), vec4(sampleUV, uv), vec2(length(uv - vec2(0.5)), atan(uv.y - 0.5, uv.x - 0.5)),
+       warpColor, motionVector);
+    FragColor = vec4(clamp(warpColor.rgb, 0.0, 1.0), 1.0);
+}
+)___";
+    profile.setOutputBytes(pass.glsl.size());
+    return pass;
+}
+
+// The composite pass only needs the per-frame q variables; it reads the finished frame as iChannel0.
+ShaderPass assemblePresetCompositePass(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                                       const libprojectM::PresetFileParser::ValueMap& presetValues, const PresetShader& composite) {
+    ProfileScope profile("composite_pass");
+    ShaderPass pass;
+    pass.name = "preset_comp";
+    pass.resolutionDivisor = 1;
+    pass.glsl = shaderPrelude(composite.glsl, presetValues);
+    pass.glsl += frameState(perFrameGLSL, userVars);
+    pass.glsl += PresetShaderTranslator::generateInputs(composite, presetBlurBounds(userVars, presetValues));
+    pass.glsl += R"___(
+    vec4 compositeColor;
+    PS(vec4(preset_shader_hue(uv), 1.0), uv, vec2(length(uv - vec2(0.5)), atan(uv.y - 0.5, uv.x - 0.5)), compositeColor);
+    FragColor = vec4(clamp(compositeColor.rgb, 0.0, 1.0), 1.0);
+}
+)___";
+    profile.setOutputBytes(pass.glsl.size());
+    return pass;
+}
+
+// The post composite pass reads the finished frame as iChannel0, like a preset composite shader.
+// It only carries the preset uniforms and per-frame code when the per-frame code changes gamma or
+// the echo; otherwise their file values are baked in, as for the blur passes.
+ShaderPass assemblePostCompositePass(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                                     const libprojectM::PresetFileParser::ValueMap& presetValues, const PostEffectFlags& flags,
+                                     uint64_t seed) {
+    ProfileScope profile("composite_pass");
+    ShaderPass pass;
+    pass.name = "post_composite";
+    pass.resolutionDivisor = 1;
+    if (flags.perFrame) {
+        pass.glsl = shaderPrelude(PostEffects::generateCompositeGLSL(seed), presetValues);
+        pass.glsl += frameState(perFrameGLSL, userVars);
+    } else {
+        pass.glsl = "#version 330 core\n\nout vec4 FragColor;\n\nuniform float iTime;\nuniform vec2 iResolution;\n";
+        pass.glsl += "uniform sampler2D iChannel0; // Finished frame\n";
+        pass.glsl += PostEffects::generateCompositeGLSL(seed);
+        pass.glsl += "\nvoid main() {\n    vec2 uv = gl_FragCoord.xy / iResolution.xy;\n";
+        pass.glsl += PostEffects::generateCompositeSettings(presetValues);
+    }
+    pass.glsl += PostEffects::generateCompositeBody(flags);
+    profile.setOutputBytes(pass.glsl.size());
+    return pass;
+}
+
+// The blur passes only carry the preset uniforms and per-frame code when a blur bound or the edge
+// darkening comes from it; otherwise they are a handful of texture fetches.
+std::vector<ShaderPass> assembleBlurPasses(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                                           const libprojectM::PresetFileParser::ValueMap& presetValues, int level,
+                                           const std::string& source) {
+    ProfileScope profile("blur_passes");
+    const std::array<std::string, 6> bounds = presetBlurBounds(userVars, presetValues);
+    const bool edgeVariable = userVars.count("blur1_edge_darken") > 0;
+    const std::string edgeDarken = edgeVariable ? "blur1_edge_darken" : glslFloat(presetFloat(presetValues, "b1ed", 0.25f));
+    const bool perFrame = edgeVariable || std::any_of(bounds.begin(), bounds.end(), [&](const std::string& bound) {
+        return userVars.count(bound) > 0;
+    });
+
+    std::vector<ShaderPass> passes;
+    size_t outputBytes = 0;
+    for (int index = 0; index < BlurPyramid::passCount(level); ++index) {
+        ShaderPass pass;
+        pass.name = BlurPyramid::passName(index);
+        pass.sampler = BlurPyramid::sampler(index);
+        pass.resolutionDivisor = BlurPyramid::divisor(index);
+        if (perFrame) {
+            pass.glsl = shaderPrelude(BlurPyramid::generatePassHelpers(index, source), presetValues);
+            pass.glsl += frameState(perFrameGLSL, userVars);
+        } else {
+            pass.glsl = "#version 330 core\n\nout vec4 FragColor;\n\nuniform vec2 iResolution;\n";
+            pass.glsl += "uniform sampler2D iChannel0; // Feedback buffer\n";
+            pass.glsl += BlurPyramid::generatePassHelpers(index, source);
+            pass.glsl += "\nvoid main() {\n";
+        }
+        pass.glsl += BlurPyramid::generatePassBody(index, source, bounds, edgeDarken);
+        pass.glsl += "}\n";
+        outputBytes += pass.glsl.size();
+        passes.push_back(std::move(pass));
+    }
+    profile.setOutputBytes(outputBytes);
+    return passes;
+}
+
+// Per-point inputs CustomWaveform.cpp loads before every point. "sample" is a keyword in
+// later GLSL versions, so they live in prefixed locals.
+const std::unordered_map<std::string, std::string>& customWavePointRewrites() {
+    static const std::unordered_map<std::string, std::string> rewrites = {
+        {"sample", "cw_sample"},
+        {"value1", "cw_value.x"},
+        {"value2", "cw_value.y"}
+    };
+    return rewrites;
+}
+
+// User variables a wave block declares: those its context compiled plus those of cached statements.
+std::set<std::string> blockUserVars(projectm_eval_context* context, std::initializer_list<const TranslatedBlock*> blocks,
+                                    const std::unordered_map<std::string, std::string>* rewrites) {
+    std::set<std::string> vars = findUserVars(internal_context(context));
+    for (const auto* block : blocks) {
+        for (const auto& var : block->variables) {
+            if (isUserVar(var)) vars.insert(var);
+        }
+    }
+    if (rewrites) {
+        for (const auto& rewrite : *rewrites) vars.erase(rewrite.first);
+    }
+    return vars;
+}
+
+// The statements an element (a custom wave point or shape instance) needs from the ones
+// before it: statements writing a variable that some statement reads before it is
+// assigned (eos.milk's flip = flip + 1), closed over everything they read. Built-ins and
+// @p rewrites are reloaded for every element; q and t variables carry over only when
+// @p carriesStateVars is set.
+struct CarriedReplay {
+    std::string glsl;                 // Empty when every element can be evaluated on its own
+    std::set<std::string> needed;     // Variables the replayed statements read or write
+    std::set<std::string> assigned;   // Variables any statement writes
+};
+
+CarriedReplay carriedReplay(projectm_eval_context* context, GLSLGenerator& generator, const std::string& code,
+                            const std::unordered_map<std::string, std::string>& rewrites, bool carriesStateVars) {
+    CarriedReplay replay;
+    prjm_eval_exptreenode* ast = compile_statements(context, code);
+    if (!ast) return replay;
+    std::vector<const prjm_eval_exptreenode*> statements;
+    if (ast->func == prjm_eval_func_execute_list) {
+        for (auto* item = ast->list; item != nullptr; item = item->next) statements.push_back(item->expr);
+    } else {
+        statements.push_back(ast);
+    }
+
+    const size_t count = statements.size();
+    std::vector<std::vector<std::string>> reads(count);
+    std::vector<std::vector<std::string>> writes(count);
+    std::set<std::string>& assigned = replay.assigned;
+    for (size_t i = 0; i < count; ++i) {
+        generator.collectVariables(statements[i], reads[i]);
+        generator.collectAssignedVariables(statements[i], writes[i]);
+        assigned.insert(writes[i].begin(), writes[i].end());
+    }
+
+    std::set<std::string> carried;
+    std::set<std::string> written;
+    for (size_t i = 0; i < count; ++i) {
+        const auto* statement = statements[i];
+        const bool plain = statement->func == prjm_eval_func_set && statement->args[0]->func == prjm_eval_func_var;
+        std::vector<std::string> used;
+        generator.collectVariables(plain ? statement->args[1] : statement, used);
+        for (const auto& var : used) {
+            if (milkToGLSLVars.count(var) == 0 && uniformControls.count(var) == 0 && rewrites.count(var) == 0 &&
+                (carriesStateVars || isUserVar(var)) && assigned.count(var) > 0 && written.count(var) == 0) {
+                carried.insert(var);
+            }
+        }
+        if (plain) written.insert(writes[i].front());
+    }
+
+    if (!carried.empty()) {
+        std::set<std::string>& needed = replay.needed;
+        needed = carried;
+        std::vector<bool> replayed(count, false);
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (size_t i = 0; i < count; ++i) {
+                if (replayed[i]) continue;
+                if (std::any_of(writes[i].begin(), writes[i].end(), [&](const std::string& var) { return needed.count(var) > 0; })) {
+                    replayed[i] = true;
+                    needed.insert(reads[i].begin(), reads[i].end());
+                    changed = true;
+                }
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (replayed[i]) replay.glsl += generator.generateStatement(statements[i], &rewrites);
+        }
+    }
+    prjm_eval_destroy_exptreenode(ast);
+    return replay;
+}
+
+// Prefixes every line of @p lines, for nesting translated statements in blocks.
+std::string indent(const std::string& lines, const std::string& prefix) {
+    std::string result;
+    std::istringstream in(lines);
+    for (std::string line; std::getline(in, line);) result += prefix + line + "\n";
+    return result;
+}
+
+// One wave's share of the points pass. Its per-frame and per-point code get separate
+// contexts, as in libprojectM, so their variables are declared (and shadow the preset's)
+// only inside the wave's block.
+std::string customWavePoints(const CustomWave& wave, float waveScale) {
+    const auto& rewrites = customWavePointRewrites();
+    projectm_eval_context* frameContext = projectm_eval_context_create(nullptr, nullptr);
+    projectm_eval_context* pointContext = projectm_eval_context_create(nullptr, nullptr);
+    if (!frameContext || !pointContext) {
+        DiagnosticScope::error("could not create a projectm-eval context for custom wave " + std::to_string(wave.index));
+        if (frameContext) projectm_eval_context_destroy(frameContext);
+        if (pointContext) projectm_eval_context_destroy(pointContext);
+        return "";
+    }
+
+    GLSLGenerator frameGenerator(frameContext);
+    TranslatedBlock init = translate_block(frameContext, frameGenerator, wave.initCode, "per_frame", nullptr);
+    TranslatedBlock frame = translate_block(frameContext, frameGenerator, wave.perFrameCode, "per_frame", nullptr);
+    std::set<std::string> frameVars = blockUserVars(frameContext, {&init, &frame}, nullptr);
+    projectm_eval_context_destroy(frameContext);
+
+    GLSLGenerator pointGenerator(pointContext);
+    TranslatedBlock point = translate_block(pointContext, pointGenerator, wave.perPointCode, "custom_wave_point", &rewrites);
+    CarriedReplay replay = carriedReplay(pointContext, pointGenerator, wave.perPointCode, rewrites, true);
+    bool readsSamples = false;
+    for (const char* input : {"value1", "value2", "x", "y", "rad", "ang"}) {
+        readsSamples = readsSamples || replay.needed.count(input) > 0;
+    }
+    std::set<std::string> pointVars = blockUserVars(pointContext, {&point}, &rewrites);
+    projectm_eval_context_destroy(pointContext);
+
+    const int count = wave.pointCount();
+    const std::string step = count > 1 ? "(1.0 / " + std::to_string(count - 1) + ".0)" : "0.0";
+    const std::string inputs = "    uv = vec2(0.5) + cw_value;\n"
+                               "    r = cw_frame_color.r;\n    g = cw_frame_color.g;\n"
+                               "    b = cw_frame_color.b;\n    a = cw_frame_color.a;\n";
+    std::string glsl = "\n    if (cw_row / 2 == " + std::to_string(wave.index) + " && cw_index < " + std::to_string(count) + ") {\n";
+    glsl += "        // wave_" + std::to_string(wave.index) + ": per-frame code, then the per-point code for point cw_index.\n";
+    glsl += "        r = " + std::to_string(wave.r) + ";\n        g = " + std::to_string(wave.g) + ";\n";
+    glsl += "        b = " + std::to_string(wave.b) + ";\n        a = " + std::to_string(wave.a) + ";\n";
+    for (const auto& var : frameVars) glsl += "        float " + var + " = 0.0;\n";
+    glsl += indent(init.glsl + frame.glsl, "    ");
+    glsl += "        vec4 cw_frame_color = vec4(r, g, b, a);\n";
+    glsl += "        {\n";
+    glsl += "        float cw_sample = 0.0;\n        vec2 cw_value = vec2(0.0);\n";
+    for (const auto& var : pointVars) glsl += "        float " + var + " = 0.0;\n";
+    if (!replay.glsl.empty()) {
+        // Point i replays the carrying statements for points 0..i-1: O(n^2) per frame, but
+        // only over the statements the carried variables depend on.
+        glsl += "        for (int cw_point = 0; cw_point < cw_index; ++cw_point) {\n";
+        glsl += "            cw_sample = float(cw_point) * " + step + ";\n";
+        if (readsSamples) {
+            glsl += "            cw_value = " + CustomWaveRenderer::generateValueCall(wave, "cw_point", waveScale) + ";\n";
+        }
+        glsl += indent(inputs, "        ");
+        glsl += indent(replay.glsl, "        ");
+        glsl += "        }\n";
+    }
+    glsl += "        cw_sample = float(cw_index) * " + step + ";\n";
+    glsl += "        cw_value = " + CustomWaveRenderer::generateValueCall(wave, "cw_index", waveScale) + ";\n";
+    glsl += indent(inputs, "    ");
+    glsl += indent(point.glsl, "    ");
+    glsl += "        FragColor = (cw_row % 2 == 0) ? vec4(custom_wave_screen(uv), 1.0, 0.0) : custom_wave_color(vec4(r, g, b, a));\n";
+    glsl += "        }\n    }\n";
+    return glsl;
+}
+
+// The points pass repeats the preset's per-frame code (its q values feed the waves) and
+// evaluates one point per texel; the bounds pass only reads its output.
+std::vector<ShaderPass> assembleCustomWavePasses(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                                                 const libprojectM::PresetFileParser::ValueMap& presetValues,
+                                                 const std::vector<CustomWave>& waves, bool audioTexture) {
+    ProfileScope profile("custom_waves");
+    float waveScale = 1.0f;
+    if (auto it = presetValues.find("fwavescale"); it != presetValues.end()) {
+        try {
+            waveScale = std::stof(it->second);
+        } catch (const std::logic_error&) {
+            // Keep libprojectM's default scale
+        }
+    }
+
+    ShaderPass points;
+    points.name = "custom_wave_points";
+    points.sampler = "iCustomWavePoints";
+    points.width = CustomWaveRenderer::kPointsWidth;
+    points.height = CustomWaveRenderer::kPointsHeight;
+    points.glsl = shaderPrelude(CustomWaveRenderer::generatePointHelpers(audioTexture), presetValues);
+    points.glsl += frameState(perFrameGLSL, userVars);
+    points.glsl += "\n    int cw_index = int(gl_FragCoord.x);\n    int cw_row = int(gl_FragCoord.y);\n    FragColor = vec4(0.0);\n";
+    for (const auto& wave : waves) points.glsl += customWavePoints(wave, waveScale);
+    points.glsl += "}\n";
+
+    ShaderPass bounds;
+    bounds.name = "custom_wave_bounds";
+    bounds.sampler = "iCustomWaveBounds";
+    bounds.width = CustomWaveRenderer::kBoundsWidth;
+    bounds.height = CustomWaveRenderer::kBoundsHeight;
+    bounds.glsl = CustomWaveRenderer::generateBoundsPass();
+
+    profile.setOutputBytes(points.glsl.size() + bounds.glsl.size());
+    return {points, bounds};
+}
+
+// Variables libprojectM's ShapePerFrameContext reloads before every instance, renamed to
+// cs_* locals so they do not collide with the preset's x, y, rad, ang and colours.
+const std::unordered_map<std::string, std::string>& customShapeRewrites() {
+    static const std::unordered_map<std::string, std::string> rewrites = [] {
+        std::unordered_map<std::string, std::string> map;
+        for (const char* name : {"x", "y", "rad", "ang", "tex_ang", "tex_zoom", "sides", "textured", "instance", "num_inst",
+                                 "additive", "thick", "r", "g", "b", "a", "r2", "g2", "b2", "a2",
+                                 "border_r", "border_g", "border_b", "border_a"}) {
+            map[name] = std::string("cs_") + name;
+        }
+        return map;
+    }();
+    return rewrites;
+}
+
+// Assignments reloading the cs_* locals for instance @p instance, as LoadStateVariables()
+// does; with @p declare they also declare the locals.
+std::string customShapeLoads(const CustomShape& shape, const std::string& instance, bool declare) {
+    const std::pair<const char*, float> values[] = {
+        {"x", shape.x}, {"y", shape.y}, {"rad", shape.rad}, {"ang", shape.ang},
+        {"tex_ang", shape.texAng}, {"tex_zoom", shape.texZoom}, {"sides", static_cast<float>(shape.sides)},
+        {"textured", shape.textured ? 1.0f : 0.0f}, {"num_inst", static_cast<float>(shape.instances)},
+        {"additive", shape.additive ? 1.0f : 0.0f}, {"thick", shape.thickOutline ? 1.0f : 0.0f},
+        {"r", shape.r}, {"g", shape.g}, {"b", shape.b}, {"a", shape.a},
+        {"r2", shape.r2}, {"g2", shape.g2}, {"b2", shape.b2}, {"a2", shape.a2},
+        {"border_r", shape.borderR}, {"border_g", shape.borderG}, {"border_b", shape.borderB}, {"border_a", shape.borderA}
+    };
+    const std::string type = declare ? "float " : "";
+    std::string glsl;
+    for (const auto& value : values) glsl += type + "cs_" + value.first + " = " + glslFloat(value.second) + ";\n";
+    glsl += type + "cs_instance = " + instance + ";\n";
+    return glsl;
+}
+
+// Redeclarations giving a block its own copy of the q (and optionally t) variables in
+// @p assigned: ShapePerFrameContext reloads them before every instance.
+std::string customShapeStateCopies(const std::set<std::string>& assigned, bool includeT) {
+    static const std::regex qVar("q[1-9][0-9]?");
+    static const std::regex tVar("t[1-8]");
+    std::string glsl;
+    for (const auto& var : assigned) {
+        if (std::regex_match(var, qVar) || (includeT && std::regex_match(var, tVar))) glsl += "float " + var + " = " + var + ";\n";
+    }
+    return glsl;
+}
+
+// One shape's share of the instances pass. Its init and per-frame code share a context,
+// as in libprojectM, separate from the preset's.
+std::string customShapeInstances(const CustomShape& shape) {
+    const auto& rewrites = customShapeRewrites();
+    projectm_eval_context* context = projectm_eval_context_create(nullptr, nullptr);
+    if (!context) {
+        DiagnosticScope::error("could not create a projectm-eval context for custom shape " + std::to_string(shape.index));
+        return "";
+    }
+
+    GLSLGenerator generator(context);
+    TranslatedBlock init = translate_block(context, generator, shape.initCode, "custom_shape", &rewrites);
+    TranslatedBlock frame = translate_block(context, generator, shape.perFrameCode, "custom_shape", &rewrites);
+    CarriedReplay replay = carriedReplay(context, generator, shape.perFrameCode, rewrites, false);
+    CarriedReplay initWrites = carriedReplay(context, generator, shape.initCode, rewrites, false);
+    std::set<std::string> shapeVars = blockUserVars(context, {&init, &frame}, &rewrites);
+    projectm_eval_context_destroy(context);
+
+    const std::string index = std::to_string(shape.index);
+    std::string glsl = "\n    if (cs_row / " + std::to_string(CustomShapeRenderer::kInstanceRows) + " == " + index +
+                       " && cs_index < " + std::to_string(shape.instances) + ") {\n";
+    glsl += "        // shape_" + index + ": init code, then the per-frame code for instance cs_index.\n";
+    // Init code runs for instance 0; without init or carried state the first load is final.
+    const bool reload = !init.glsl.empty() || !replay.glsl.empty();
+    glsl += indent(customShapeLoads(shape, reload ? "0.0" : "float(cs_index)", true), "        ");
+    for (const auto& var : shapeVars) glsl += "        float " + var + " = 0.0;\n";
+    if (!init.glsl.empty()) {
+        glsl += "        {\n";
+        glsl += indent(customShapeStateCopies(initWrites.assigned, false), "        ");
+        glsl += indent(init.glsl, "    ");
+        glsl += "        }\n";
+    }
+    if (!replay.glsl.empty()) {
+        // Instance i replays the carrying statements for instances 0..i-1: O(n^2) per frame,
+        // but only over the statements the carried variables depend on.
+        glsl += "        for (int cs_previous = 0; cs_previous < cs_index; ++cs_previous) {\n";
+        glsl += indent(customShapeLoads(shape, "float(cs_previous)", false), "            ");
+        glsl += indent(customShapeStateCopies(replay.assigned, true), "            ");
+        glsl += indent(replay.glsl, "        ");
+        glsl += "        }\n";
+    }
+    if (reload) glsl += indent(customShapeLoads(shape, "float(cs_index)", false), "        ");
+    glsl += indent(frame.glsl, "    ");
+    glsl += "        " + CustomShapeRenderer::generateInstanceStore(shape);
+    glsl += "    }\n";
+    return glsl;
+}
+
+// The instances pass repeats the preset's per-frame code (its q values feed the shapes)
+// and evaluates one instance per texel; the bins pass only reads its output.
+std::vector<ShaderPass> assembleCustomShapePasses(const std::string& perFrameGLSL, const std::set<std::string>& userVars,
+                                                  const libprojectM::PresetFileParser::ValueMap& presetValues,
+                                                  const std::vector<CustomShape>& shapes) {
+    ProfileScope profile("custom_shapes");
+    ShaderPass instances;
+    instances.name = "custom_shape_instances";
+    instances.sampler = "iCustomShapeInstances";
+    instances.width = CustomShapeRenderer::kInstancesWidth;
+    instances.height = CustomShapeRenderer::kInstancesHeight;
+    instances.glsl = shaderPrelude(CustomShapeRenderer::generateInstanceHelpers(), presetValues);
+    instances.glsl += frameState(perFrameGLSL, userVars);
+    instances.glsl += "\n    int cs_index = int(gl_FragCoord.x);\n    int cs_row = int(gl_FragCoord.y);\n    FragColor = vec4(0.0);\n";
+    for (const auto& shape : shapes) instances.glsl += customShapeInstances(shape);
+    instances.glsl += "}\n";
+
+    ShaderPass bins;
+    bins.name = "custom_shape_bins";
+    bins.sampler = "iCustomShapeBins";
+    bins.width = CustomShapeRenderer::kBinTiles * CustomShapeRenderer::kBinStride;
+    bins.height = CustomShapeRenderer::kBinTiles;
+    bins.glsl = CustomShapeRenderer::generateBinPass(shapes);
+
+    profile.setOutputBytes(instances.glsl.size() + bins.glsl.size());
+    return {instances, bins};
+}
+
+} // namespace
+
+
+namespace {
+
+// Each self-test checks one feature on synthetic input or baked.milk and prints why it failed.
+
+bool selfTestPerPixelRewrite() {
     projectm_eval_context* context = projectm_eval_context_create(nullptr, nullptr);
     if (!context) {
         std::cerr << "Self-test: failed to create evaluation context." << std::endl;
@@ -698,56 +1803,195 @@ bool runSelfTests() {
         std::cerr << "Self-test: per-pixel variable rewrite failed." << std::endl;
         return false;
     }
+    return true;
+}
 
-    libprojectM::PresetFileParser parser;
-    if (!parser.Read("baked.milk")) {
-        std::cerr << "Self-test: unable to read baked.milk preset." << std::endl;
+bool selfTestStatementPreprocessing() {
+    // Multi-line loop() bodies must survive preprocessing as a single statement.
+    projectm_eval_context* context = projectm_eval_context_create(nullptr, nullptr);
+    prjm_eval_exptreenode* loopAst = compile_statements(context, "loop(2, q1 = q1 + 1;\n  q2 = q1 * 2);\nq3 = q2 +\n  1\n");
+    bool loopOk = loopAst && loopAst->func == prjm_eval_func_execute_list;
+    if (loopAst) prjm_eval_destroy_exptreenode(loopAst);
+    projectm_eval_context_destroy(context);
+
+    if (!loopOk) {
+        std::cerr << "Self-test: multi-line statement preprocessing failed." << std::endl;
+        return false;
+    }
+
+    // An unclosed bracket drops its own statement only; the following lines keep their line numbers.
+    PreparedCode unclosed = clean_code("q1 = min(bass, 2;\n\nq2 = treb;\n");
+    if (unclosed.dropped.size() != 1 || unclosed.dropped.front().find("line 1, col 9") == std::string::npos ||
+        unclosed.statements.size() != 1 || unclosed.statements.front().line != 3 ||
+        unclosed.text.compare(unclosed.statements.front().offset, unclosed.statements.front().length, "q2 = treb") != 0) {
+        std::cerr << "Self-test: a statement with an unclosed bracket was not dropped on its own." << std::endl;
         return false;
     }
+    return true;
+}
 
+bool selfTestTranslationCache(const libprojectM::PresetFileParser& parser) {
     std::string bakedGLSL = translateToGLSL(parser.GetCode("per_frame_"), parser.GetCode("per_pixel_"), parser.PresetValues());
     if (bakedGLSL.find("warp = 1.42") == std::string::npos || bakedGLSL.find("/* unknown node */") != std::string::npos) {
         std::cerr << "Self-test: baked.milk translation missing expected per-pixel output." << std::endl;
         return false;
     }
 
+    // A second translation is served from the statement cache and must match exactly.
+    size_t hitsBefore = TranslationCache::instance().stats().hits;
+    std::string cachedGLSL = translateToGLSL(parser.GetCode("per_frame_"), parser.GetCode("per_pixel_"), parser.PresetValues());
+    if (cachedGLSL != bakedGLSL || TranslationCache::instance().stats().hits == hitsBefore) {
+        std::cerr << "Self-test: cached translation differs from the uncached output." << std::endl;
+        return false;
+    }
     return true;
 }
 
-int main(int argc, char* argv[]) {
-    std::setlocale(LC_NUMERIC, "C");
-    if (argc == 2 && std::string(argv[1]) == "--self-test") {
-        bool success = runSelfTests();
-        if (success) {
-            std::cout << "Self-tests passed" << std::endl;
-            return 0;
-        }
-        std::cerr << "Self-tests failed" << std::endl;
-        return 1;
+bool selfTestVariableNames() {
+    // MilkDrop variables are case-insensitive: a statement cached from a preset spelling "MyVar"
+    // must not leak that spelling into one spelling it "myvar".
+    const libprojectM::PresetFileParser::ValueMap noValues;
+    TranslationCache::instance().clear();
+    const std::string lowerUncached = translateToGLSL("myvar = treb*2;\nq1 = myvar;\n", "", noValues);
+    translateToGLSL("MyVar = bass;\nq1 = MyVar;\n", "", noValues);
+    const std::string lowerCached = translateToGLSL("myvar = treb*2;\nq1 = myvar;\n", "", noValues);
+    if (lowerCached != lowerUncached || lowerCached.find("MyVar") != std::string::npos ||
+        lowerCached.find("q1 = myvar") == std::string::npos) {
+        std::cerr << "Self-test: mixed-case variables differ between cached and uncached translations." << std::endl;
+        return false;
     }
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <input.milk> <output.frag>\n";
-        return 1;
+
+    // Lower-casing must not turn a user variable into a GLSL keyword.
+    const std::string keywordGLSL = translateToGLSL("Float = bass;\nq1 = Float;\n", "", noValues);
+    if (keywordGLSL.find("float_var") == std::string::npos || keywordGLSL.find("float =") != std::string::npos ||
+        keywordGLSL.find("q1 = float;") != std::string::npos) {
+        std::cerr << "Self-test: a user variable lower-cased to a GLSL keyword was not renamed." << std::endl;
+        return false;
     }
-    std::string inputFile = argv[1];
-    std::string outputFile = argv[2];
-    libprojectM::PresetFileParser parser;
-    if (!parser.Read(inputFile)) {
-        std::cerr << "Error: Could not read or parse input file: " << inputFile << "\n";
-        return 1;
+    return true;
+}
+
+bool selfTestPresetShaderCache() {
+    // Preset shaders are cached by content hash; a repeat must hit and match the first output.
+    const std::string warpCode = "shader_body { ret = tex2D(sampler_main, uv).xyz * 0.9 + GetBlur1(uv) * 0.1; }";
+    PresetShader warp = PresetShaderTranslator::translate(PresetShaderTranslator::Type::Warp, warpCode);
+    size_t hitsBefore = PresetShaderTranslator::cache().stats().hits;
+    PresetShader cachedWarp = PresetShaderTranslator::translate(PresetShaderTranslator::Type::Warp, warpCode);
+    if (warp.glsl.empty() || warp.blurLevel != 1 || cachedWarp.glsl != warp.glsl || cachedWarp.samplers != warp.samplers ||
+        PresetShaderTranslator::cache().stats().hits == hitsBefore) {
+        std::cerr << "Self-test: preset warp shader translation or its cache failed." << std::endl;
+        return false;
     }
+    return true;
+}
 
-    std::string perFrameCode = parser.GetCode("per_frame_");
-    std::string perPixelCode = parser.GetCode("per_pixel_");
+bool selfTestCostBudget(const libprojectM::PresetFileParser& parser) {
+    // The cost model must bound the wave loop by its cap, and --max-cost must lower it.
+    ConversionReport fullReport;
+    translateToGLSL(parser.GetCode("per_frame_"), parser.GetCode("per_pixel_"), parser.PresetValues(), ConversionOptions{}, &fullReport);
+    ConversionOptions halfBudget;
+    halfBudget.maxCost = fullReport.cost.weighted() / 2.0;
+    ConversionReport budgetReport;
+    translateToGLSL(parser.GetCode("per_frame_"), parser.GetCode("per_pixel_"), parser.PresetValues(), halfBudget, &budgetReport);
+    if (fullReport.cost.waveIterationCap != WaveModeRenderer::defaultIterationCap(presetWaveMode(parser.PresetValues())) ||
+        !budgetReport.withinBudget || budgetReport.cost.weighted() > halfBudget.maxCost ||
+        budgetReport.wave.iterationCap <= 0 || budgetReport.wave.iterationCap >= fullReport.cost.waveIterationCap) {
+        std::cerr << "Self-test: cost budget did not lower the wave iteration cap." << std::endl;
+        return false;
+    }
+    return true;
+}
 
+bool selfTestSpecializer() {
+    // The specializer folds resolved selector calls, keeps what the roots reach (also through
+    // another kept helper) and drops the rest, including constants only dropped code used.
+    const std::string snippet =
+        "const float UNUSED_SCALE = 2.0;\n"
+        "const float KEPT_SCALE = 3.0;\n"
+        "float select_gain(float modeId) { return modeId < 1.5 ? 0.5 : 2.0; }\n"
+        "float leaf(float x) { return x * KEPT_SCALE; }\n"
+        "float middle(float x) { return leaf(x) + 1.0; }\n"
+        "float orphan(float x) { return x * UNUSED_SCALE; }\n"
+        "float root(float x) { return middle(x) * select_gain(2.0); }\n";
+    const std::string specializedSnippet = ShaderSpecializer::specialize(snippet, {"root"}, [](const std::string& function, double argument) {
+        return function == "select_gain" ? std::string(argument < 1.5 ? "0.5" : "2.0") : std::string();
+    });
+    const std::string strippedSnippet = ShaderSpecializer::stripUnreferenced(snippet, {"middle"});
+    if (specializedSnippet.find("float root(float x) { return middle(x) * 2.0; }") == std::string::npos ||
+        specializedSnippet.find("float leaf(") == std::string::npos || specializedSnippet.find("KEPT_SCALE = 3.0") == std::string::npos ||
+        specializedSnippet.find("select_gain") != std::string::npos || specializedSnippet.find("orphan") != std::string::npos ||
+        specializedSnippet.find("UNUSED_SCALE") != std::string::npos || strippedSnippet.find("float leaf(") == std::string::npos ||
+        strippedSnippet.find("float root(") != std::string::npos || strippedSnippet.find("select_gain") != std::string::npos) {
+        std::cerr << "Self-test: GLSL specialization of a known snippet failed." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool selfTestWaveSpecialization() {
+    // The wave mode 2 helpers keep its vertex function and the overload and clamp helpers
+    // reached only through other helpers, and lose the mode selectors and other modes' code.
+    const std::string wave2 = WaveModeRenderer::generateWaveformGLSL(2, {});
+    bool wave2Ok = wave2.find("float draw_wave(") != std::string::npos && wave2.find("vec2 wave_mode2_vertex(") != std::string::npos &&
+                   wave2.find("float wave_fast_tanh(float x)") != std::string::npos &&
+                   wave2.find("vec2 wave_smoothstep_clamp(") != std::string::npos && wave2.find("wave_select_") == std::string::npos &&
+                   wave2.find("wave_polar_vertex") == std::string::npos && wave2.find("wave_fallback_bars") == std::string::npos &&
+                   wave2.find("draw_wave_binned") == std::string::npos &&
+                   std::count(wave2.begin(), wave2.end(), '{') == std::count(wave2.begin(), wave2.end(), '}');
+    // Every helper the specialized code still calls is defined in it.
+    static const std::regex helperCall(R"(\b(wave_[A-Za-z0-9_]+)\s*\()");
+    for (auto it = std::sregex_iterator(wave2.begin(), wave2.end(), helperCall); wave2Ok && it != std::sregex_iterator(); ++it) {
+        const std::regex definition("(float|vec2|vec3|vec4|void|bool|int) " + (*it)[1].str() + "\\(");
+        wave2Ok = std::regex_search(wave2, definition);
+    }
+    if (!wave2Ok) {
+        std::cerr << "Self-test: wave mode 2 specialization kept or removed the wrong functions." << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    std::string glsl = translateToGLSL(perFrameCode, perPixelCode, parser.PresetValues());
-    std::ofstream out(outputFile);
-    if (!out) {
-        std::cerr << "Error: Could not open output file for writing: " << outputFile << "\n";
-        return 1;
+bool selfTestRenderGraph(const libprojectM::PresetFileParser& parser) {
+    // The pass graph of a real preset validates; reordering it, closing a cycle or aliasing two
+    // live resources must not.
+    ConversionReport report;
+    const std::string glsl = translateToGLSL(parser.GetCode("per_frame_"), parser.GetCode("per_pixel_"), parser.PresetValues(),
+                                             ConversionOptions{}, &report);
+    RenderGraph graph = buildRenderGraph(report, glsl, [](const std::string& name) { return name + ".frag"; });
+    const size_t expectedPasses = report.passes.size() + (report.composite.glsl.empty() ? 1 : 2);
+    bool graphOk = graph.passes.size() == expectedPasses && validateRenderGraph(graph).empty();
+    if (graphOk && graph.passes.size() >= 3) {
+        RenderGraph reordered = graph;
+        std::swap(reordered.passes.front(), reordered.passes.back());
+        allocateRenderTargets(reordered);
+        RenderGraph cyclic = graph;
+        cyclic.passes[0].inputs.push_back({cyclic.passes[1].output, false});
+        cyclic.passes[1].inputs.push_back({cyclic.passes[0].output, false});
+        RenderGraph aliased = graph;
+        aliased.resources[1].target = aliased.resources[0].target;
+        aliased.resources[1].width = aliased.resources[0].width;
+        aliased.resources[1].height = aliased.resources[0].height;
+        aliased.resources[1].resolutionDivisor = aliased.resources[0].resolutionDivisor;
+        aliased.resources[1].firstUse = aliased.resources[0].firstUse;
+        graphOk = !validateRenderGraph(reordered).empty() && !validateRenderGraph(cyclic).empty() && !validateRenderGraph(aliased).empty();
+    }
+    if (!graphOk) {
+        std::cerr << "Self-test: pass graph validation failed." << std::endl;
+        return false;
     }
-    out << glsl;
-    std::cout << "Successfully converted " << inputFile << " to " << outputFile << "\n";
-    return 0;
+    return true;
+}
+
+} // namespace
+
+bool runSelfTests() {
+    libprojectM::PresetFileParser parser;
+    if (!parser.Read("baked.milk")) {
+        std::cerr << "Self-test: unable to read baked.milk preset." << std::endl;
+        return false;
+    }
+
+    return selfTestPerPixelRewrite() && selfTestStatementPreprocessing() && selfTestTranslationCache(parser) &&
+           selfTestVariableNames() && selfTestPresetShaderCache() && selfTestCostBudget(parser) &&
+           selfTestSpecializer() && selfTestWaveSpecialization() && selfTestRenderGraph(parser);
 }
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PresetFileParser.hpp"
+#include "CustomShapeRenderer.hpp"
+#include "CustomWaveRenderer.hpp"
+#include "ShaderCostModel.hpp"
+#include "WaveModeRenderer.hpp"
+
+// Include internal headers from projectm-eval to access AST and context structures
+extern "C" {
+#include "projectm-eval.h"
+#include "projectm-eval/CompilerTypes.h"
+#include "projectm-eval/CompileContext.h"
+#include "projectm-eval/TreeFunctions.h"
+#include "projectm-eval/ExpressionTree.h"
+}
+
+// The public API uses an opaque pointer, so we must cast it to the internal type.
+#define internal_context(ctx) (reinterpret_cast<prjm_eval_compiler_context_t*>(ctx))
+
+// Conversion pipeline shared by the MilkdropConverter executable and the benchmark suite.
+
+// A map of MilkDrop built-in variables to their GLSL equivalents.
+extern const std::unordered_map<std::string, std::string> milkToGLSLVars;
+
+// Metadata for generating UI controls for writable variables.
+struct UniformControl {
+    std::string defaultValue;
+    std::string widget;
+    std::string min;
+    std::string max;
+    std::string step;
+};
+
+extern const std::unordered_map<std::string, UniformControl> uniformControls;
+
+const std::unordered_map<std::string, std::string>& perPixelVariableRewrites();
+
+class GLSLGenerator {
+public:
+    GLSLGenerator(projectm_eval_context* context);
+    std::string generate(const prjm_eval_exptreenode* tree);
+    std::string generate(const prjm_eval_exptreenode* tree, const std::unordered_map<std::string, std::string>& variableOverrides);
+    std::string generateStatement(const prjm_eval_exptreenode* statement, const std::unordered_map<std::string, std::string>* variableOverrides);
+    void collectVariables(const prjm_eval_exptreenode* node, std::vector<std::string>& names);
+    // Variables written by plain or compound assignments anywhere in the tree.
+    void collectAssignedVariables(const prjm_eval_exptreenode* node, std::vector<std::string>& names);
+
+private:
+    std::string generateWithOverrides(const prjm_eval_exptreenode* tree, const std::unordered_map<std::string, std::string>* overrides);
+    std::string traverseNode(const prjm_eval_exptreenode* node);
+    bool isOperator(const prjm_eval_exptreenode* node);
+    bool isComparison(const prjm_eval_exptreenode* node);
+    bool isFunction(const prjm_eval_exptreenode* node);
+    bool isAssignment(const prjm_eval_exptreenode* node);
+    bool isConstant(const prjm_eval_exptreenode* node);
+    bool isVariable(const prjm_eval_exptreenode* node);
+    std::string getFunctionName(const prjm_eval_exptreenode* node);
+    std::string getVariableName(const prjm_eval_exptreenode* node);
+    std::string getOperator(const prjm_eval_exptreenode* node);
+
+    std::unordered_map<void*, std::string> m_func_map;
+    std::set<void*> m_comparison_funcs;
+    projectm_eval_context* m_context;
+    const std::unordered_map<std::string, std::string>* m_variableOverrides;
+};
+
+// A single top-level statement inside a preprocessed code block. Offsets index
+// into PreparedCode::text; line numbers match the original source block.
+struct StatementSpan {
+    size_t offset;
+    size_t length;
+    int line;
+};
+
+struct PreparedCode {
+    std::string text;
+    std::vector<StatementSpan> statements;
+    std::vector<std::string> dropped; // Why statements with an unclosed '(' or '[' were left out
+};
+
+// Prepares a MilkDrop code block for the projectm-eval compiler. A statement whose '(' or
+// '[' is still open at the end of the block is left out and described in PreparedCode::dropped;
+// the lines after the one holding the bracket are prepared again as statements of their own.
+PreparedCode clean_code(const std::string& code);
+
+// Compiles an already prepared block; returns nullptr on errors or empty blocks. On a compile
+// error, @p error (when given) receives the failing statement and the compiler's message.
+prjm_eval_exptreenode* compile_prepared(projectm_eval_context* ctx, const PreparedCode& prepared, std::string* error = nullptr);
+
+// Helper function to compile a block of statements into a single AST
+prjm_eval_exptreenode* compile_statements(projectm_eval_context* ctx, const std::string& code);
+
+bool isUserVar(const std::string& varName);
+std::set<std::string> findUserVars(prjm_eval_compiler_context_t* ctx);
+
+struct TranslatedBlock {
+    std::string glsl;
+    std::vector<std::string> variables; // Variables referenced by statements served from the cache
+};
+
+// A block that does not compile is left out (its glsl is empty) and reported through
+// DiagnosticScope::error().
+TranslatedBlock translate_block(projectm_eval_context* ctx, GLSLGenerator& generator, const std::string& code,
+                                const std::string& scope, const std::unordered_map<std::string, std::string>* overrides);
+
+struct WaveformComponents {
+    std::string glsl;
+    std::string callPattern;
+};
+
+// nWaveMode from the preset, defaulting to 6.
+int presetWaveMode(const libprojectM::PresetFileParser::ValueMap& presetValues);
+
+// Shader model of the preset's warp and composite shaders as libprojectM selects it; 0 when
+// the preset (MilkDrop 1) has none. The shader is only used when its code is not empty.
+void presetShaderVersions(const libprojectM::PresetFileParser::ValueMap& presetValues, int& warpVersion, int& compositeVersion);
+
+WaveformComponents generateWaveformComponents(const libprojectM::PresetFileParser::ValueMap& presetValues, const WaveBudget& budget = {});
+
+struct ConversionOptions {
+    double maxCost = 0.0;      // Weighted per-pixel budget (ShaderCost::weighted); 0 disables enforcement
+    bool waveGeometry = false; // Compute wave vertices once per frame and bin them into screen tiles
+    bool waveLowRes = false;   // Render wave intensity in a reduced-resolution pass and upsample it
+    bool audioTexture = false; // Sample waveform and spectrum from the packed iAudioTexture
+};
+
+// An extra full-screen pass rendered before the main shader each frame. The main shader
+// (and later passes) read its output through the sampler uniform of the same name.
+struct ShaderPass {
+    std::string name;    // Output file suffix, e.g. "wave_geometry"
+    std::string sampler; // Sampler uniform bound to the pass output
+    int width = 0;       // Fixed render target size in texels (RGBA32F), or 0 when screen-relative
+    int height = 0;
+    int resolutionDivisor = 0; // > 0: the target is iResolution / resolutionDivisor on each axis
+    std::string glsl;
+};
+
+// Static cost of the returned shader (screen-relative passes included per output pixel), any wave
+// limits applied to meet ConversionOptions::maxCost, and the prepasses the shader depends on, in
+// render order. Every pass sees the same uniforms as the main shader, iResolution included.
+// Enabled custom waves and shapes and preset warp shaders always add their passes, so callers
+// that render must request a report.
+//
+// A preset composite shader becomes the composite pass: it runs after the main shader on a
+// screen-sized target, sees the frame just rendered as iChannel0 (and every prepass output),
+// and its output is displayed but not fed back. Its glsl is empty when the main output is
+// displayed as is.
+//
+// errors lists the code blocks that did not compile and were left out of the shaders; warnings
+// lists features that fell back to their default (a preset shader hlslparser rejects). The
+// conversion never prints them.
+struct ConversionReport {
+    ShaderCost cost;
+    WaveBudget wave;
+    bool withinBudget = true;
+    std::vector<ShaderPass> passes;
+    ShaderPass composite;
+    std::vector<std::string> errors;
+    std::vector<std::string> warnings;
+};
+
+// Routes the conversion messages of the calling thread into a report while in scope; without
+// one they are discarded. Repeated messages are kept once.
+class DiagnosticScope {
+public:
+    explicit DiagnosticScope(ConversionReport& report);
+    ~DiagnosticScope();
+    DiagnosticScope(const DiagnosticScope&) = delete;
+    DiagnosticScope& operator=(const DiagnosticScope&) = delete;
+
+    static void error(const std::string& message);
+    static void warning(const std::string& message);
+
+private:
+    ConversionReport* m_previous;
+};
+
+std::string translateToGLSL(const std::string& perFrame, const std::string& perPixel, const libprojectM::PresetFileParser::ValueMap& presetValues);
+std::string translateToGLSL(const std::string& perFrame, const std::string& perPixel, const libprojectM::PresetFileParser::ValueMap& presetValues,
+                            const ConversionOptions& options, ConversionReport* report);
+
+bool runSelfTests();
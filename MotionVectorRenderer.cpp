@@ -0,0 +1,94 @@
+#include "MotionVectorRenderer.hpp"
+
+#include "PresetValues.hpp"
+
+bool MotionVectorRenderer::enabled(const std::map<std::string, std::string>& presetValues, const std::string& perFrameCode)
+{
+    // MotionVectors::Draw() skips the grid below this alpha.
+    return presetFloat(presetValues, "mv_a", 0.0f) >= 0.0001f || presetCodeMentions(perFrameCode, "mv_a");
+}
+
+std::string MotionVectorRenderer::generateGridGLSL()
+{
+    std::string glsl = R"___(
+// Motion vector grid as MotionVectors::Draw() lays it out: (columns, rows, column spacing,
+// row spacing). The fractional part of mv_x / mv_y stretches the spacing unless the count
+// was clamped.
+)___";
+    glsl += "const float MOTION_VECTOR_MAX_COLUMNS = " + std::to_string(kMaxColumns) + ".0;\n";
+    glsl += "const float MOTION_VECTOR_MAX_ROWS = " + std::to_string(kMaxRows) + ".0;\n";
+    glsl += R"___(
+vec4 motion_vector_grid(float mvX, float mvY) {
+    vec2 count = floor(max(vec2(mvX, mvY), vec2(0.0)));
+    vec2 limit = vec2(MOTION_VECTOR_MAX_COLUMNS, MOTION_VECTOR_MAX_ROWS);
+    vec2 divert = mix(clamp(vec2(mvX, mvY) - count, 0.0, 1.0), vec2(0.0), greaterThan(count, limit));
+    count = min(count, limit);
+    return vec4(count, 1.0 / (count + divert - 0.75));
+}
+
+// Start of the vector of grid point @cell (column, row from the top), in uv with y up.
+vec2 motion_vector_point(vec2 cell, vec4 grid, float mvDx, float mvDy) {
+    vec2 position = (cell + 0.25) * grid.zw + vec2(mvDx, -mvDy);
+    return vec2(position.x, 1.0 - position.y);
+}
+)___";
+    return glsl;
+}
+
+std::string MotionVectorRenderer::generatePointStatement()
+{
+    return "\n    // Grid point of this texel; the per-pixel code below computes where the warp samples it.\n"
+           "    vec2 mvCell = floor(gl_FragCoord.xy);\n"
+           "    uv = motion_vector_point(mvCell, motion_vector_grid(mv_x, mv_y), mv_dx, mv_dy);\n";
+}
+
+std::string MotionVectorRenderer::generateDrawGLSL()
+{
+    std::string glsl = R"___(
+// Motion vectors: per grid point displacement from the motion_vectors pass.
+uniform sampler2D iMotionVectors;
+)___";
+    glsl += generateGridGLSL();
+    glsl += R"___(
+// Coverage of the 1 px line from grid point @cell through @p. Vectors are capped at one grid
+// cell per axis, so every vector crossing a cell starts at one of its corners.
+float motion_vector_coverage(vec2 p, vec2 cell, vec4 grid, float mvDx, float mvDy, float mvL) {
+    if (any(lessThan(cell, vec2(0.0))) || any(greaterThanEqual(cell, grid.xy))) return 0.0;
+    vec2 start = motion_vector_point(cell, grid, mvDx, mvDy);
+    if (any(lessThan(start, vec2(0.0001))) || any(greaterThan(start, vec2(0.9999)))) return 0.0;
+
+    vec2 trail = texelFetch(iMotionVectors, ivec2(cell), 0).xy * mvL;
+    float minimumLength = length(vec2(1.25) / iResolution);
+    float trailLength = length(trail);
+    if (trailLength < minimumLength) {
+        trail = trailLength > 1e-8 ? trail * (minimumLength / trailLength) : vec2(minimumLength);
+    }
+    vec2 reach = abs(trail) / grid.zw;
+    trail /= max(1.0, max(reach.x, reach.y));
+
+    vec2 toPixel = (p - start) * iResolution;
+    vec2 segment = trail * iResolution;
+    float t = clamp(dot(toPixel, segment) / max(dot(segment, segment), 1e-8), 0.0, 1.0);
+    return clamp(1.0 - length(toPixel - segment * t), 0.0, 1.0);
+}
+
+float motion_vector_draw(vec2 p, float mvX, float mvY, float mvDx, float mvDy, float mvL) {
+    vec4 grid = motion_vector_grid(mvX, mvY);
+    // Grid cell holding p, counting rows from the top like the grid.
+    vec2 cell = floor((vec2(p.x - mvDx, 1.0 - p.y + mvDy)) / grid.zw - 0.25);
+    float coverage = motion_vector_coverage(p, cell, grid, mvDx, mvDy, mvL);
+    coverage = max(coverage, motion_vector_coverage(p, cell + vec2(1.0, 0.0), grid, mvDx, mvDy, mvL));
+    coverage = max(coverage, motion_vector_coverage(p, cell + vec2(0.0, 1.0), grid, mvDx, mvDy, mvL));
+    coverage = max(coverage, motion_vector_coverage(p, cell + vec2(1.0, 1.0), grid, mvDx, mvDy, mvL));
+    return coverage;
+}
+)___";
+    return glsl;
+}
+
+std::string MotionVectorRenderer::generateDrawCall()
+{
+    return "\n    // Motion vectors, drawn onto the previous frame before the warp as in libprojectM.\n"
+           "    float motionVectorAlpha = clamp(mv_a, 0.0, 1.0) * motion_vector_draw(sampleUV, mv_x, mv_y, mv_dx, mv_dy, mv_l);\n"
+           "    feedback.rgb = mix(feedback.rgb, clamp(vec3(mv_r, mv_g, mv_b), 0.0, 1.0), motionVectorAlpha);\n";
+}
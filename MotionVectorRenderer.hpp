@@ -0,0 +1,38 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+/**
+ * @brief GLSL generation for the motion vector grid (mv_* settings).
+ *
+ * libprojectM's MotionVectors draws one line per grid point onto the previous frame, from the
+ * point towards where the warp mesh samples it. The motion_vectors pass runs the per-pixel
+ * code once per grid point and stores the resulting displacement in a kMaxColumns x kMaxRows
+ * texture. The main shader finds the grid cell of its feedback coordinate analytically and
+ * tests only the vectors starting at the cell's four corners, so the per-pixel cost does not
+ * depend on mv_x and mv_y.
+ */
+class MotionVectorRenderer {
+public:
+    /// True when the preset can draw motion vectors: mv_a is positive, or @p perFrameCode
+    /// assigns it.
+    static bool enabled(const std::map<std::string, std::string>& presetValues, const std::string& perFrameCode);
+
+    /// motion_vector_grid() and motion_vector_point(), shared by the pass and the main shader.
+    static std::string generateGridGLSL();
+
+    /// Statement moving uv to the grid point of this texel in the motion_vectors pass, ahead
+    /// of the per-pixel code.
+    static std::string generatePointStatement();
+
+    /// Sampler and motion_vector_draw() for the main shader.
+    static std::string generateDrawGLSL();
+
+    /// Statement blending the vectors over the previous frame in feedback.rgb, at sampleUV.
+    static std::string generateDrawCall();
+
+    /// libprojectM clamps the grid to 64 x 48 points.
+    static constexpr int kMaxColumns = 64;
+    static constexpr int kMaxRows = 48;
+};
@@ -0,0 +1,177 @@
+#include "PostEffects.hpp"
+
+#include "PresetShaderTranslator.hpp"
+#include "PresetValues.hpp"
+
+#include <cmath>
+
+namespace {
+
+// Value of uniform @p variable the preset file starts with.
+float setting(const std::map<std::string, std::string>& presetValues, const std::string& variable, float fallback)
+{
+    const std::string key = PostEffects::settingKey(variable);
+    return presetFloat(presetValues, key.empty() ? variable : key, presetFloat(presetValues, variable, fallback));
+}
+
+// Same corner weights as VideoEcho::Draw(); the random offsets are baked in. Vertex 0 is the
+// top-left corner, 1 top-right, 2 bottom-left and 3 bottom-right, and the quad is drawn as
+// the triangles 0-1-2 and 2-1-3.
+const char* kHueHelper = R"___(
+vec3 post_hue_corner(float corner) {
+    vec3 shade = 0.6 + 0.3 * sin(iTime * 30.0 * vec3(0.0143, 0.0107, 0.0129) + vec3(3.0, 1.0, 6.0) +
+                                 corner * vec3(21.0, 13.0, 9.0) + POST_HUE_OFFSETS);
+    return 0.5 + 0.5 * shade / max(shade.x, max(shade.y, shade.z));
+}
+
+vec3 post_hue(vec2 uv) {
+    vec3 topRight = post_hue_corner(1.0);
+    vec3 bottomLeft = post_hue_corner(2.0);
+    if (uv.x <= uv.y) {
+        vec3 topLeft = post_hue_corner(0.0);
+        return bottomLeft + uv.x * (topRight - topLeft) + uv.y * (topLeft - bottomLeft);
+    }
+    vec3 bottomRight = post_hue_corner(3.0);
+    return bottomLeft + uv.x * (bottomRight - bottomLeft) + uv.y * (topRight - bottomRight);
+}
+)___";
+
+} // namespace
+
+PostEffectFlags PostEffects::parse(const std::map<std::string, std::string>& presetValues, const std::string& perFrameCode)
+{
+    auto perFrame = [&](const char* variable) { return presetCodeMentions(perFrameCode, variable); };
+
+    PostEffectFlags flags;
+    flags.echo = setting(presetValues, "echo_alpha", 0.0f) > 0.001f || perFrame("echo_alpha");
+    flags.gamma = std::fabs(setting(presetValues, "gamma", 1.0f) - 1.0f) > 0.0001f || perFrame("gamma");
+    flags.brighten = setting(presetValues, "brighten", 0.0f) != 0.0f;
+    flags.darken = setting(presetValues, "darken", 0.0f) != 0.0f;
+    flags.solarize = setting(presetValues, "solarize", 0.0f) != 0.0f;
+    flags.invert = setting(presetValues, "invert", 0.0f) != 0.0f;
+    flags.darkenCenter = setting(presetValues, "darken_center", 0.0f) != 0.0f || perFrame("darken_center");
+    // Border::Draw() skips a border at this alpha or below.
+    flags.outerBorder = setting(presetValues, "ob_a", 0.0f) > 0.001f || perFrame("ob_a");
+    flags.innerBorder = setting(presetValues, "ib_a", 0.0f) > 0.001f || perFrame("ib_a");
+    flags.perFrame = perFrame("gamma") || perFrame("echo_alpha") || perFrame("echo_zoom") || perFrame("echo_orient");
+    return flags;
+}
+
+std::string PostEffects::settingKey(const std::string& variable)
+{
+    static const std::map<std::string, std::string> keys = {
+        {"echo_zoom", "fvideoechozoom"},
+        {"echo_alpha", "fvideoechoalpha"},
+        {"echo_orient", "nvideoechoorientation"},
+        {"gamma", "fgammaadj"},
+        {"brighten", "bbrighten"},
+        {"darken", "bdarken"},
+        {"solarize", "bsolarize"},
+        {"invert", "binvert"},
+        {"darken_center", "bdarkencenter"},
+    };
+    auto it = keys.find(variable);
+    return it == keys.end() ? std::string() : it->second;
+}
+
+std::string PostEffects::generateFrameCall(const PostEffectFlags& flags)
+{
+    std::string glsl;
+    if (flags.darkenCenter)
+    {
+        glsl += R"___(
+    // Darken centre: a black diamond 0.05 tall in clip space, 3/32 opaque in the middle and
+    // clear at its corners, narrowed by the aspect ratio on wide screens.
+    if (darken_center > 0.0) {
+        vec2 diamondSize = vec2(0.025 * min(1.0, iResolution.y / iResolution.x), 0.025);
+        vec2 diamondOffset = abs(gl_FragCoord.xy / iResolution.xy - 0.5) / diamondSize;
+        composedColor.rgb *= 1.0 - 3.0 / 32.0 * max(0.0, 1.0 - diamondOffset.x - diamondOffset.y);
+    }
+)___";
+    }
+    if (flags.outerBorder || flags.innerBorder)
+    {
+        glsl += R"___(
+    // Borders: rings along the screen edge, ob_size and then ib_size wide in clip space. The
+    // box distance of the pixel centre picks the ring, as rasterizing libprojectM's quads would.
+    vec2 borderClip = abs(gl_FragCoord.xy / iResolution.xy * 2.0 - 1.0);
+    float borderRadius = max(borderClip.x, borderClip.y);
+)___";
+    }
+    if (flags.outerBorder)
+    {
+        glsl += R"___(    if (ob_a > 0.001 && borderRadius >= 1.0 - ob_size) {
+        composedColor.rgb = mix(composedColor.rgb, clamp(vec3(ob_r, ob_g, ob_b), 0.0, 1.0), clamp(ob_a, 0.0, 1.0));
+    }
+)___";
+    }
+    if (flags.innerBorder)
+    {
+        glsl += R"___(    if (ib_a > 0.001 && borderRadius >= 1.0 - ob_size - ib_size && borderRadius < 1.0 - ob_size) {
+        composedColor.rgb = mix(composedColor.rgb, clamp(vec3(ib_r, ib_g, ib_b), 0.0, 1.0), clamp(ib_a, 0.0, 1.0));
+    }
+)___";
+    }
+    return glsl;
+}
+
+std::string PostEffects::generateCompositeGLSL(uint64_t seed)
+{
+    std::string hue = kHueHelper;
+    hue.replace(hue.find("POST_HUE_OFFSETS"), 16, PresetShaderTranslator::generateHueOffsets(seed));
+    return hue;
+}
+
+std::string PostEffects::generateCompositeSettings(const std::map<std::string, std::string>& presetValues)
+{
+    std::string glsl;
+    glsl += "    float gamma = " + glslFloat(setting(presetValues, "gamma", 1.0f)) + ";\n";
+    glsl += "    float echo_alpha = " + glslFloat(setting(presetValues, "echo_alpha", 0.0f)) + ";\n";
+    glsl += "    float echo_zoom = " + glslFloat(setting(presetValues, "echo_zoom", 1.0f)) + ";\n";
+    glsl += "    float echo_orient = " + glslFloat(setting(presetValues, "echo_orient", 0.0f)) + ";\n";
+    return glsl;
+}
+
+std::string PostEffects::generateCompositeBody(const PostEffectFlags& flags)
+{
+    std::string glsl = R"___(
+    // Final composite without a composite shader: libprojectM's VideoEcho, then Filters. The
+    // additive redraws of VideoEcho amount to scaling by the gamma and clamping once.
+    vec3 postColor = texture(iChannel0, uv).rgb;
+    float postGain = max(gamma, 0.0);
+)___";
+    if (flags.echo)
+    {
+        glsl += R"___(    if (echo_alpha > 0.001) {
+        // The echo is the frame zoomed by echo_zoom about the centre and flipped by echo_orient;
+        // with it, gamma only ever brightens.
+        vec2 echoUV = 0.5 + (uv - 0.5) / echo_zoom;
+        int echoOrientation = int(mod(floor(echo_orient), 4.0));
+        if (echoOrientation == 1 || echoOrientation == 3) echoUV.x = 1.0 - echoUV.x;
+        if (echoOrientation >= 2) echoUV.y = 1.0 - echoUV.y;
+        postColor = mix(postColor, texture(iChannel0, echoUV).rgb, echo_alpha);
+        postGain = gamma > 0.001 ? max(gamma, 1.0) : 1.0;
+    }
+)___";
+    }
+    glsl += "    postColor = min(postColor * post_hue(uv) * postGain, vec3(1.0));\n";
+    // Filters::Draw() blends a white quad over the frame with these blend functions.
+    if (flags.brighten)
+    {
+        glsl += "    postColor = 1.0 - (1.0 - postColor) * (1.0 - postColor); // brighten\n";
+    }
+    if (flags.darken)
+    {
+        glsl += "    postColor = postColor * postColor; // darken\n";
+    }
+    if (flags.solarize)
+    {
+        glsl += "    postColor = 2.0 * postColor * (1.0 - postColor); // solarize\n";
+    }
+    if (flags.invert)
+    {
+        glsl += "    postColor = 1.0 - postColor; // invert\n";
+    }
+    glsl += "    FragColor = vec4(postColor, 1.0);\n}\n";
+    return glsl;
+}
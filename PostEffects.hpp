@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+/**
+ * @brief Which of libprojectM's fixed-function post effects a preset can use.
+ *
+ * Each flag is decided at conversion time, so the shaders carry no code for effects the preset
+ * never turns on. Settings the per-frame code can change count as on when the code mentions
+ * them; brighten, darken, solarize and invert are read once from the preset file, as
+ * libprojectM's FinalComposite does.
+ */
+struct PostEffectFlags {
+    bool echo = false;         ///< fVideoEchoAlpha > 0.001, or echo_alpha set per frame
+    bool gamma = false;        ///< fGammaAdj other than 1, or gamma set per frame
+    bool brighten = false;
+    bool darken = false;
+    bool solarize = false;
+    bool invert = false;
+    bool darkenCenter = false; ///< bDarkenCenter, or darken_center set per frame
+    bool outerBorder = false;  ///< ob_a > 0.001, or ob_a set per frame
+    bool innerBorder = false;  ///< ib_a > 0.001, or ib_a set per frame
+    bool perFrame = false;     ///< The per-frame code sets gamma or an echo_* setting
+
+    /// The echo, gamma and filters need a composite pass of their own.
+    bool composite() const { return echo || gamma || brighten || darken || solarize || invert; }
+};
+
+/**
+ * @brief GLSL generation for the post effects of presets without a composite shader.
+ *
+ * The darken-centre diamond and the borders are drawn into the frame before it feeds back, as
+ * libprojectM's DarkenCenter and Border do, with the ring of each border found from an analytic
+ * box distance instead of four quads. Video echo, gamma, the hue shading of VideoEcho and the
+ * Filters blend modes only change what is displayed, so they go into a post_composite pass that
+ * reads the finished frame.
+ */
+class PostEffects {
+public:
+    static PostEffectFlags parse(const std::map<std::string, std::string>& presetValues, const std::string& perFrameCode);
+
+    /// Preset file key (lowercased) holding the initial value of uniform @p variable when the
+    /// names differ, e.g. "fvideoechoalpha" for echo_alpha; empty otherwise.
+    static std::string settingKey(const std::string& variable);
+
+    /// Statements for the end of the main shader: darken centre, then the outer and inner
+    /// border over composedColor.rgb.
+    static std::string generateFrameCall(const PostEffectFlags& flags);
+
+    /// post_hue() for the composite pass, with the hue drift seeded by @p seed.
+    static std::string generateCompositeGLSL(uint64_t seed);
+
+    /// Declarations of gamma and the echo_* settings at their preset file values, for a
+    /// composite pass that does not run the per-frame code.
+    static std::string generateCompositeSettings(const std::map<std::string, std::string>& presetValues);
+
+    /// Body of the composite pass after the per-frame code: echo, gamma and hue shading of
+    /// iChannel0, then the filters, into FragColor.
+    static std::string generateCompositeBody(const PostEffectFlags& flags);
+};
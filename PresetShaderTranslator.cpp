@@ -0,0 +1,774 @@
+#include "PresetShaderTranslator.hpp"
+
+#include "BlurPyramid.hpp"
+#include "PresetShaderHeader.hpp"
+#include "PresetValues.hpp"
+#include "Profiler.hpp"
+#include "TranslationCache.hpp"
+
+#include <GLSLGenerator.h>
+#include <HLSLParser.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+bool isIdentifierChar(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+std::string toLower(std::string text)
+{
+    for (auto& c : text)
+    {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return text;
+}
+
+// "randXX" with two digits, optionally followed by a "_suffix".
+bool isRandomTextureName(const std::string& lowerCaseName)
+{
+    return lowerCaseName.length() >= 6 && lowerCaseName.compare(0, 4, "rand") == 0 &&
+           std::isdigit(static_cast<unsigned char>(lowerCaseName[4])) &&
+           std::isdigit(static_cast<unsigned char>(lowerCaseName[5]));
+}
+
+// Sampler names may carry a filtering/wrap prefix such as "fw_" or "pc_".
+std::string baseSamplerName(const std::string& name)
+{
+    if (name.length() > 3 && name[2] == '_')
+    {
+        return name.substr(3);
+    }
+    return name;
+}
+
+// Port of MilkdropShader::GetReferencedSamplers() and UpdateMaxBlurLevel().
+void referencedSamplers(const std::string& program, std::set<std::string>& samplerNames, int& blurLevel)
+{
+    samplerNames.clear();
+    samplerNames.insert("main");
+
+    auto found = program.find("sampler_", 0);
+    while (found != std::string::npos)
+    {
+        found += 8;
+        const size_t end = program.find_first_of(" ;,\n\r)", found);
+        if (end != std::string::npos)
+        {
+            const std::string sampler = program.substr(found, end - found);
+            // "sampler_state" is a reserved word, not a sampler.
+            if (sampler != "state")
+            {
+                samplerNames.insert(sampler);
+            }
+        }
+        found = program.find("sampler_", found);
+    }
+
+    // Some presets read texsize_X without referencing the sampler.
+    found = program.find("texsize_", 0);
+    while (found != std::string::npos)
+    {
+        found += 8;
+        const size_t end = program.find_first_of(" ;,.\n\r)", found);
+        if (end != std::string::npos)
+        {
+            samplerNames.insert(program.substr(found, end - found));
+        }
+        found = program.find("texsize_", found);
+    }
+
+    // Keep only the long form when both "randXX" and "randXX_suffix" appear.
+    for (auto name = samplerNames.begin(); name != samplerNames.end();)
+    {
+        const std::string lowerCaseName = toLower(*name);
+        auto next = std::next(name);
+        if (lowerCaseName.length() == 6 && isRandomTextureName(lowerCaseName) && next != samplerNames.end())
+        {
+            const std::string nextLowerCaseName = toLower(*next);
+            if (nextLowerCaseName.length() > 7 && nextLowerCaseName.compare(0, 6, lowerCaseName) == 0 &&
+                nextLowerCaseName[6] == '_')
+            {
+                name = samplerNames.erase(name);
+                continue;
+            }
+        }
+        name = next;
+    }
+
+    blurLevel = 0;
+    if (program.find("GetBlur3") != std::string::npos)
+    {
+        blurLevel = 3;
+    }
+    else if (program.find("GetBlur2") != std::string::npos)
+    {
+        blurLevel = 2;
+    }
+    else if (program.find("GetBlur1") != std::string::npos)
+    {
+        blurLevel = 1;
+    }
+    // A few presets use the sampler names directly.
+    for (const auto& name : samplerNames)
+    {
+        const std::string lowerCaseName = toLower(name);
+        if (lowerCaseName.length() == 5 && lowerCaseName.compare(0, 4, "blur") == 0 && lowerCaseName[4] >= '1' &&
+            lowerCaseName[4] <= '3')
+        {
+            blurLevel = std::max(blurLevel, lowerCaseName[4] - '0');
+        }
+    }
+    for (int level = 1; level <= blurLevel; ++level)
+    {
+        samplerNames.insert("blur" + std::to_string(level));
+    }
+}
+
+bool referencesWord(const std::string& glsl, const std::string& word, int minimumCount)
+{
+    int count = 0;
+    for (size_t found = glsl.find(word); found != std::string::npos; found = glsl.find(word, found + word.size()))
+    {
+        const size_t end = found + word.size();
+        if ((found == 0 || !isIdentifierChar(glsl[found - 1])) && (end >= glsl.size() || !isIdentifierChar(glsl[end])) &&
+            ++count >= minimumCount)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The lines of @p header that @p code can reach: #defines whose name it references and uniform
+// declarations of names it or a kept #define references. hlslparser's preprocessor compares
+// every identifier with every macro and its generator emits every uniform, so the full header
+// would dominate the translation of a typical shader that reads a handful of them.
+std::string reachableHeader(const std::string& header, const std::string& code)
+{
+    struct Line {
+        std::string text;
+        std::vector<std::string> names;
+        bool kept = false;
+    };
+    std::vector<Line> lines;
+    size_t position = 0;
+    while (position < header.size())
+    {
+        size_t end = header.find('\n', position);
+        end = end == std::string::npos ? header.size() : end + 1;
+        Line line;
+        line.text = header.substr(position, end - position);
+        position = end;
+
+        std::istringstream words(line.text);
+        std::string keyword;
+        std::string type;
+        words >> keyword;
+        if (keyword == "#define")
+        {
+            std::string name;
+            words >> name;
+            line.names.push_back(name.substr(0, name.find('(')));
+        }
+        else if (keyword == "uniform" && words >> type)
+        {
+            std::string names = line.text.substr(static_cast<size_t>(words.tellg()));
+            names = names.substr(0, names.find(';'));
+            std::istringstream list(names);
+            std::string name;
+            while (std::getline(list, name, ','))
+            {
+                name.erase(std::remove_if(name.begin(), name.end(), [](char c) { return std::isspace(static_cast<unsigned char>(c)); }),
+                           name.end());
+                line.names.push_back(name);
+            }
+        }
+        if (!line.names.empty())
+        {
+            lines.push_back(std::move(line));
+        }
+    }
+
+    // Kept #define values can reach further lines, so repeat until nothing changes.
+    std::string reachable = code;
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (auto& line : lines)
+        {
+            if (line.kept)
+            {
+                continue;
+            }
+            for (const auto& name : line.names)
+            {
+                if (referencesWord(reachable, name, 1))
+                {
+                    line.kept = changed = true;
+                    reachable += line.text;
+                    break;
+                }
+            }
+        }
+    }
+
+    std::string result;
+    for (const auto& line : lines)
+    {
+        if (line.kept)
+        {
+            result += line.text;
+        }
+    }
+    return result;
+}
+
+// Port of MilkdropShader::PreprocessPresetShader(): wraps the body into PS() behind the parts of
+// the preset header it reaches.
+bool preprocessPresetShader(PresetShaderTranslator::Type type, std::string& program, std::string& error)
+{
+    const bool warp = type == PresetShaderTranslator::Type::Warp;
+
+    // "sampler_state" overrides are not supported by GLSL; drop the assignment up to its "};".
+    size_t found = program.find("sampler_state");
+    while (found != std::string::npos)
+    {
+        const size_t start = program.rfind('=', found);
+        size_t end = program.find('}', found);
+        end = end == std::string::npos ? end : program.find(';', end);
+        if (start == std::string::npos || end == std::string::npos)
+        {
+            break;
+        }
+        program.erase(start, end - start);
+        found = program.find("sampler_state");
+    }
+
+    found = program.find("shader_body");
+    if (found == std::string::npos)
+    {
+        error = "missing \"shader_body\" entry point";
+        return false;
+    }
+    program.replace(found, 11, warp
+        ? "void PS(float4 _vDiffuse : COLOR, float4 _uv : TEXCOORD0, float2 _rad_ang : TEXCOORD1, out float4 _return_value : COLOR0, out float4 _mv_tex_coords : COLOR1)\n"
+        : "void PS(float4 _vDiffuse : COLOR, float2 _uv : TEXCOORD0, float2 _rad_ang : TEXCOORD1, out float4 _return_value : COLOR)\n");
+
+    found = program.find('{', found);
+    if (found == std::string::npos)
+    {
+        error = "no opening brace after shader_body";
+        return false;
+    }
+    program.replace(found, 1, warp ? "{\nfloat3 ret = 0;\n_mv_tex_coords.xy = _uv.xy;\n" : "{\nfloat3 ret = 0;\n");
+
+    found = program.rfind('}');
+    if (found == std::string::npos)
+    {
+        error = "no closing brace";
+        return false;
+    }
+    program.replace(found, 1, "_return_value = float4(ret.xyz, 1.0);\n}\n");
+
+    std::string header = kPresetShaderHeader;
+    header += warp ? "#define rad _rad_ang.x\n"
+                     "#define ang _rad_ang.y\n"
+                     "#define uv _uv.xy\n"
+                     "#define uv_orig _uv.zw\n"
+                   : "#define rad _rad_ang.x\n"
+                     "#define ang _rad_ang.y\n"
+                     "#define uv _uv.xy\n"
+                     "#define uv_orig _uv.xy\n"
+                     "#define hue_shader _vDiffuse.xyz\n";
+    program.insert(0, reachableHeader(header, program));
+    return true;
+}
+
+// Removes each line remainder starting at a word that begins with @p prefix and is followed by
+// whitespace or "(" (the regex_search loops of MilkdropShader::TranspileHLSLShader(), in one pass).
+void eraseDeclarations(std::string& source, const std::string& prefix, bool (*matches)(const std::string&, size_t))
+{
+    std::string result;
+    result.reserve(source.size());
+    size_t position = 0;
+    while (position < source.size())
+    {
+        size_t found = source.find(prefix, position);
+        while (found != std::string::npos && ((found > 0 && isIdentifierChar(source[found - 1])) ||
+                                              !matches(source, found + prefix.size())))
+        {
+            found = source.find(prefix, found + 1);
+        }
+        if (found == std::string::npos)
+        {
+            break;
+        }
+        result.append(source, position, found - position);
+        position = source.find('\n', found);
+        if (position == std::string::npos)
+        {
+            position = source.size();
+        }
+    }
+    result.append(source, position, std::string::npos);
+    source = std::move(result);
+}
+
+// "sampler", "sampler2D" or "sampler3D" followed by whitespace or "(".
+bool samplerDeclaration(const std::string& source, size_t position)
+{
+    if (position + 1 < source.size() && (source[position] == '2' || source[position] == '3') && source[position + 1] == 'D')
+    {
+        position += 2;
+    }
+    return position < source.size() && (std::isspace(static_cast<unsigned char>(source[position])) || source[position] == '(');
+}
+
+// "float4" followed by whitespace and "texsize_".
+bool texsizeDeclaration(const std::string& source, size_t position)
+{
+    const size_t start = position;
+    while (position < source.size() && std::isspace(static_cast<unsigned char>(source[position])))
+    {
+        ++position;
+    }
+    return position > start && source.compare(position, 8, "texsize_") == 0;
+}
+
+struct SamplerBinding {
+    std::string name;    // As referenced, without "sampler_"
+    std::string channel; // RaymarchVibe sampler, or empty to keep a sampler uniform of its own
+    bool volume = false; // sampler3D
+    std::string sizeName;
+};
+
+// The feedback frame backs "main" and the blur levels read the pyramid passes (iBlur1-3). The
+// preset's own textures take iChannel1-3 in name order; volume textures and any further textures
+// keep a sampler uniform of their own for the host to bind.
+std::vector<SamplerBinding> samplerBindings(const std::set<std::string>& samplers)
+{
+    std::vector<SamplerBinding> bindings;
+    std::map<std::string, int> textureChannels;
+    for (const auto& name : samplers)
+    {
+        SamplerBinding binding;
+        binding.name = name;
+        const std::string lowerCaseBase = toLower(baseSamplerName(name));
+        if (lowerCaseBase == "main")
+        {
+            binding.channel = "iChannel0";
+            binding.sizeName = "main";
+        }
+        else if (lowerCaseBase == "blur1" || lowerCaseBase == "blur2" || lowerCaseBase == "blur3")
+        {
+            binding.channel = BlurPyramid::sampler(2 * (lowerCaseBase[4] - '1') + 1);
+        }
+        else
+        {
+            binding.sizeName = baseSamplerName(name);
+            binding.volume = lowerCaseBase.compare(0, 8, "noisevol") == 0;
+            if (!binding.volume)
+            {
+                auto it = textureChannels.find(lowerCaseBase);
+                if (it == textureChannels.end() && static_cast<int>(textureChannels.size()) < PresetShaderTranslator::kTextureChannels)
+                {
+                    it = textureChannels.emplace(lowerCaseBase, static_cast<int>(textureChannels.size()) + 1).first;
+                }
+                if (it != textureChannels.end())
+                {
+                    binding.channel = "iChannel" + std::to_string(it->second);
+                }
+            }
+        }
+        bindings.push_back(std::move(binding));
+    }
+    return bindings;
+}
+
+// Declarations inserted on top of the preprocessed source, as LoadTexturesAndCompile() does
+// with the texture descriptors; blur levels have no texsize.
+std::string samplerDeclarations(const std::vector<SamplerBinding>& bindings)
+{
+    std::set<std::string> samplerDeclarations;
+    std::set<std::string> texSizeDeclarations;
+    for (const auto& binding : bindings)
+    {
+        samplerDeclarations.insert(std::string("uniform ") + (binding.volume ? "sampler3D" : "sampler2D") + " sampler_" + binding.name + ";\n");
+        if (!binding.sizeName.empty())
+        {
+            texSizeDeclarations.insert("uniform float4 texsize_" + binding.sizeName + ";\n");
+        }
+        // "sampler_rand00_smalltiled" is also reachable as "sampler_rand00".
+        const std::string lowerCaseName = toLower(binding.name);
+        if (isRandomTextureName(lowerCaseName) && lowerCaseName.length() > 7 && lowerCaseName[6] == '_')
+        {
+            samplerDeclarations.insert("uniform sampler2D sampler_" + binding.name.substr(0, 6) + ";\n");
+            texSizeDeclarations.insert("uniform float4 texsize_" + binding.name.substr(0, 6) + ";\n");
+        }
+    }
+    std::string declarations;
+    for (const auto& declaration : samplerDeclarations)
+    {
+        declarations += declaration;
+    }
+    for (const auto& declaration : texSizeDeclarations)
+    {
+        declarations += declaration;
+    }
+    return declarations;
+}
+
+// Matrices libprojectM fills in MilkdropShader::LoadVariables(), in its order.
+const char* const kRotationNames[24] = {
+    "rot_s1", "rot_s2", "rot_s3", "rot_s4", "rot_d1", "rot_d2", "rot_d3", "rot_d4",
+    "rot_f1", "rot_f2", "rot_f3", "rot_f4", "rot_vf1", "rot_vf2", "rot_vf3", "rot_vf4",
+    "rot_uf1", "rot_uf2", "rot_uf3", "rot_uf4", "rot_rand1", "rot_rand2", "rot_rand3", "rot_rand4"};
+
+const char* kRotationHelper = R"___(
+// glm::rotate() about Y, Z and X around a translation, as MilkdropShader::LoadVariables() builds rot_*.
+mat3x4 preset_shader_rotation(vec3 angles, vec3 translation) {
+    vec3 c = cos(angles);
+    vec3 s = sin(angles);
+    mat4 rotationX = mat4(1.0, 0.0, 0.0, 0.0, 0.0, c.x, s.x, 0.0, 0.0, -s.x, c.x, 0.0, 0.0, 0.0, 0.0, 1.0);
+    mat4 rotationY = mat4(c.y, 0.0, -s.y, 0.0, 0.0, 1.0, 0.0, 0.0, s.y, 0.0, c.y, 0.0, 0.0, 0.0, 0.0, 1.0);
+    mat4 rotationZ = mat4(c.z, s.z, 0.0, 0.0, -s.z, c.z, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0);
+    mat4 move = mat4(1.0);
+    move[3] = vec4(translation, 1.0);
+    return mat3x4(rotationY * (rotationZ * (move * rotationX)));
+}
+)___";
+
+// Same weights as FinalComposite::ApplyHueShaderColors(); the random offsets are baked in.
+const char* kHueHelper = R"___(
+vec3 preset_shader_hue_corner(float corner) {
+    vec3 shade = 0.6 + 0.3 * sin(iTime * 30.0 * vec3(0.0143, 0.0107, 0.0129) + vec3(3.0, 1.0, 6.0) +
+                                 corner * vec3(21.0, 13.0, 9.0) + PRESET_SHADER_HUE_OFFSETS);
+    return 0.5 + 0.5 * shade / max(shade.x, max(shade.y, shade.z));
+}
+
+vec3 preset_shader_hue(vec2 uv) {
+    return preset_shader_hue_corner(0.0) * uv.x * uv.y + preset_shader_hue_corner(1.0) * (1.0 - uv.x) * uv.y +
+           preset_shader_hue_corner(2.0) * uv.x * (1.0 - uv.y) + preset_shader_hue_corner(3.0) * (1.0 - uv.x) * (1.0 - uv.y);
+}
+)___";
+
+// Deterministic stand-in for libprojectM's load-time rand() values, seeded by the shader hash
+// so a preset converts to the same GLSL every time.
+class PresetRandom {
+public:
+    explicit PresetRandom(uint64_t seed)
+        : m_state(seed ? seed : 1)
+    {
+    }
+
+    float next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 7;
+        m_state ^= m_state << 17;
+        return static_cast<float>(m_state % 7381) / 7380.0f;
+    }
+
+private:
+    uint64_t m_state;
+};
+
+// hlslparser's output as a block for the RaymarchVibe prelude: the version, varyings, outputs
+// and main() go, sampler uniforms bound to a channel become #defines and other uniforms become
+// globals that generateInputs() assigns.
+std::string adaptGeneratedGLSL(const std::string& generated, const std::vector<SamplerBinding>& bindings)
+{
+    std::map<std::string, std::string> channels;
+    for (const auto& binding : bindings)
+    {
+        if (!binding.channel.empty())
+        {
+            channels.emplace("sampler_" + binding.name, binding.channel);
+            const std::string lowerCaseName = toLower(binding.name);
+            if (isRandomTextureName(lowerCaseName) && lowerCaseName.length() > 7 && lowerCaseName[6] == '_')
+            {
+                channels.emplace("sampler_" + binding.name.substr(0, 6), binding.channel);
+            }
+        }
+    }
+
+    std::string defines;
+    std::string body;
+    std::set<std::string> declaredChannels;
+    size_t position = 0;
+    while (position < generated.size())
+    {
+        size_t end = generated.find('\n', position);
+        end = end == std::string::npos ? generated.size() : end + 1;
+        const std::string line = generated.substr(position, end - position);
+        position = end;
+
+        if (line.compare(0, 12, "void main() ") == 0)
+        {
+            break;
+        }
+        if (line.compare(0, 8, "#version") == 0 || line.compare(0, 8, "in vec4 ") == 0 ||
+            line.compare(0, 8, "in vec2 ") == 0 || line.compare(0, 9, "out vec4 ") == 0)
+        {
+            continue;
+        }
+        if (line.compare(0, 18, "uniform sampler2D ") == 0)
+        {
+            const std::string name = line.substr(18, line.find(';') - 18);
+            auto it = channels.find(name);
+            if (it != channels.end())
+            {
+                // Pass samplers are not part of the RaymarchVibe prelude.
+                if (it->second.compare(0, 8, "iChannel") != 0 && declaredChannels.insert(it->second).second)
+                {
+                    defines += "uniform sampler2D " + it->second + ";\n";
+                }
+                defines += "#define " + name + " " + it->second + "\n";
+                continue;
+            }
+            body += line;
+            continue;
+        }
+        if (line.compare(0, 18, "uniform sampler3D ") == 0)
+        {
+            body += line;
+            continue;
+        }
+        body += line.compare(0, 8, "uniform ") == 0 ? line.substr(8) : line;
+    }
+    return defines + body;
+}
+
+} // namespace
+
+TranslationCache& PresetShaderTranslator::cache()
+{
+    static TranslationCache cache(kCacheCapacityBytes);
+    return cache;
+}
+
+PresetShader PresetShaderTranslator::translate(Type type, const std::string& code)
+{
+    ProfileScope profile(type == Type::Warp ? "warp_shader" : "comp_shader");
+    const char* scope = type == Type::Warp ? "warp" : "composite";
+
+    PresetShader shader;
+    shader.hash = TranslationCache::contentHash(code);
+    const std::string key = TranslationCache::makeHashKey(scope, code);
+    TranslationCache::Entry entry;
+    if (cache().lookup(key, entry))
+    {
+        shader.glsl = std::move(entry.glsl);
+        for (auto& name : entry.variables)
+        {
+            shader.samplers.insert(std::move(name));
+        }
+        for (int level = 1; level <= 3; ++level)
+        {
+            if (shader.samplers.count("blur" + std::to_string(level)))
+            {
+                shader.blurLevel = level;
+            }
+        }
+        profile.setOutputBytes(shader.glsl.size());
+        return shader;
+    }
+
+    if (code.find_first_not_of(" \t\r\n") == std::string::npos)
+    {
+        shader.error = "shader is declared, but empty";
+        return shader;
+    }
+
+    referencedSamplers(code, shader.samplers, shader.blurLevel);
+    std::string program = code;
+    if (!preprocessPresetShader(type, program, shader.error))
+    {
+        return shader;
+    }
+
+    M4::GLSLGenerator generator;
+    M4::Allocator allocator;
+    M4::HLSLTree tree(&allocator);
+    M4::HLSLParser parser(&allocator, &tree);
+
+    std::string source;
+    if (!parser.ApplyPreprocessor("", program.c_str(), program.size(), source))
+    {
+        shader.error = "HLSL preprocessing failed";
+        return shader;
+    }
+
+    // The preset's own sampler and texsize declarations are replaced by the referenced set.
+    eraseDeclarations(source, "sampler", samplerDeclaration);
+    eraseDeclarations(source, "float4", texsizeDeclaration);
+    const std::vector<SamplerBinding> bindings = samplerBindings(shader.samplers);
+    source.insert(0, samplerDeclarations(bindings));
+
+    if (!parser.Parse("", source.c_str(), source.size()))
+    {
+        shader.error = "HLSL parsing failed";
+        return shader;
+    }
+    if (!generator.Generate(&tree, M4::GLSLGenerator::Target_FragmentShader, M4::GLSLGenerator::Version_330, "PS",
+                            M4::GLSLGenerator::Options(M4::GLSLGenerator::Flag_AlternateNanPropagation)))
+    {
+        shader.error = "GLSL generation failed";
+        return shader;
+    }
+
+    shader.glsl = "\n// Preset " + std::string(scope) + " shader, translated from HLSL by hlslparser.\n";
+    shader.glsl += adaptGeneratedGLSL(generator.GetResult(), bindings);
+    for (const char* name : kRotationNames)
+    {
+        if (referencesWord(shader.glsl, name, 2))
+        {
+            shader.glsl += kRotationHelper;
+            break;
+        }
+    }
+    if (referencesWord(shader.glsl, "_c5", 2) || referencesWord(shader.glsl, "_c6", 2) || referencesWord(shader.glsl, "_c13", 2))
+    {
+        shader.glsl += BlurPyramid::generateBoundsHelpers();
+    }
+    if (type == Type::Composite)
+    {
+        std::string hue = kHueHelper;
+        hue.replace(hue.find("PRESET_SHADER_HUE_OFFSETS"), 25, generateHueOffsets(shader.hash));
+        shader.glsl += hue;
+    }
+
+    entry.glsl = shader.glsl;
+    entry.variables.assign(shader.samplers.begin(), shader.samplers.end());
+    cache().store(key, std::move(entry));
+    profile.setOutputBytes(shader.glsl.size());
+    return shader;
+}
+
+std::string PresetShaderTranslator::generateHueOffsets(uint64_t hash)
+{
+    PresetRandom random(hash ^ 0x9e3779b97f4a7c15ull);
+    std::string offsets = "vec3(";
+    // hueRandomOffsets[3], [1] and [2] feed red, green and blue.
+    const float moduli[3] = {315.71f, 537.51f, 426.61f};
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        offsets += glslFloat(random.next() * moduli[channel]) + (channel < 2 ? ", " : ")");
+    }
+    return offsets;
+}
+
+std::string PresetShaderTranslator::generateInputs(const PresetShader& shader, const std::array<std::string, 6>& blurBounds)
+{
+    const std::string& glsl = shader.glsl;
+    std::string inputs = "\n    // Preset shader inputs (libprojectM's MilkdropShader::LoadVariables()).\n";
+    auto set = [&](const std::string& name, const std::string& value) {
+        if (referencesWord(glsl, name, 2))
+        {
+            inputs += "    " + name + " = " + value + ";\n";
+        }
+    };
+
+    PresetRandom random(shader.hash);
+    const std::string presetRandom = "vec4(" + glslFloat(random.next()) + ", " + glslFloat(random.next()) + ", " +
+                                     glslFloat(random.next()) + ", " + glslFloat(random.next()) + ")";
+    set("rand_frame", "vec4(rand(vec2(iFrame, 0.13)), rand(vec2(iFrame, 0.29)), rand(vec2(iFrame, 0.47)), rand(vec2(iFrame, 0.61)))");
+    set("rand_preset", presetRandom);
+    set("_c0", "vec4(min(vec2(1.0), iResolution.yx / iResolution.xy), max(vec2(1.0), iResolution.xy / iResolution.yx))");
+    set("_c1", "vec4(0.0)");
+    set("_c2", "vec4(mod(iTime, 10000.0), iFps, iFrame, iProgress)");
+    set("_c3", "iAudioBands");
+    set("_c4", "iAudioBandsAtt");
+    // The blur ranges are the safe ones the pyramid passes were written with.
+    if (referencesWord(glsl, "_c5", 2) || referencesWord(glsl, "_c6", 2) || referencesWord(glsl, "_c13", 2))
+    {
+        inputs += "    vec3 preset_blur_min = vec3(" + blurBounds[0] + ", " + blurBounds[2] + ", " + blurBounds[4] + ");\n";
+        inputs += "    vec3 preset_blur_max = vec3(" + blurBounds[1] + ", " + blurBounds[3] + ", " + blurBounds[5] + ");\n";
+        inputs += "    blur_safe_bounds(preset_blur_min, preset_blur_max);\n";
+    }
+    set("_c5", "vec4(preset_blur_max.x - preset_blur_min.x, preset_blur_min.x, preset_blur_max.y - preset_blur_min.y, preset_blur_min.y)");
+    set("_c6", "vec4(preset_blur_max.z - preset_blur_min.z, preset_blur_min.z, preset_blur_min.x, preset_blur_max.x)");
+    set("_c7", "vec4(iResolution, 1.0 / iResolution)");
+    set("_c8", "0.5 + 0.5 * cos(iTime * vec4(0.329, 1.293, 5.070, 20.051) + vec4(1.2, 3.9, 2.5, 5.4))");
+    set("_c9", "0.5 + 0.5 * sin(iTime * vec4(0.329, 1.293, 5.070, 20.051) + vec4(1.2, 3.9, 2.5, 5.4))");
+    set("_c10", "0.5 + 0.5 * cos(iTime * vec4(0.0050, 0.0085, 0.0133, 0.0217) + vec4(2.7, 5.3, 4.5, 3.8))");
+    set("_c11", "0.5 + 0.5 * sin(iTime * vec4(0.0050, 0.0085, 0.0133, 0.0217) + vec4(2.7, 5.3, 4.5, 3.8))");
+    set("_c12", "vec4(log2(iResolution), 0.5 * (log2(iResolution.x) + log2(iResolution.y)), 0.0)");
+    set("_c13", "vec4(preset_blur_min.y, preset_blur_max.y, preset_blur_min.z, preset_blur_max.z)");
+    for (int bank = 0; bank < 8; ++bank)
+    {
+        const int first = bank * 4 + 1;
+        set(std::string("_q") + static_cast<char>('a' + bank),
+            "vec4(q" + std::to_string(first) + ", q" + std::to_string(first + 1) + ", q" + std::to_string(first + 2) +
+            ", q" + std::to_string(first + 3) + ")");
+    }
+
+    // Twenty matrices turn at fixed random speeds around random centres; the last four are
+    // random every frame. The random draws follow the MilkdropShader constructor's order.
+    PresetRandom rotations(shader.hash ^ 0x5851f42d4c957f2dull);
+    for (int index = 0; index < 20; ++index)
+    {
+        const float rotationScale = 0.9f * std::pow(static_cast<float>(index) / 8.0f, 3.2f);
+        float values[9];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            values[axis] = rotations.next() * 2.0f - 1.0f;
+        }
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            values[3 + axis] = rotations.next() * 6.28f;
+        }
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            values[6 + axis] = (rotations.next() * 2.0f - 1.0f) * rotationScale;
+        }
+        auto vec3 = [&](int offset) {
+            return "vec3(" + glslFloat(values[offset]) + ", " + glslFloat(values[offset + 1]) + ", " + glslFloat(values[offset + 2]) + ")";
+        };
+        set(kRotationNames[index], "preset_shader_rotation(" + vec3(3) + " + " + vec3(6) + " * iTime, " + vec3(0) + ")");
+    }
+    for (int index = 20; index < 24; ++index)
+    {
+        const std::string seed = std::to_string(index) + ".0";
+        set(kRotationNames[index], "preset_shader_rotation(6.28 * vec3(rand(vec2(iFrame, " + seed + ")), rand(vec2(" + seed +
+                                       ", iFrame)), rand(vec2(iFrame, -" + seed + "))), vec3(rand(vec2(-" + seed +
+                                       ", iFrame)), rand(vec2(iFrame + 0.5, " + seed + ")), rand(vec2(" + seed + ", iFrame + 0.5))))");
+    }
+
+    // Filter prefixes (fw_, pw_, ...) share the texture and so its size.
+    std::set<std::string> assignedSizes;
+    for (const auto& binding : samplerBindings(shader.samplers))
+    {
+        if (binding.sizeName.empty() || !assignedSizes.insert(binding.sizeName).second)
+        {
+            continue;
+        }
+        std::string size = "vec4(iResolution, 1.0 / iResolution)";
+        if (binding.sizeName != "main" && !binding.channel.empty())
+        {
+            const std::string texels = "vec2(textureSize(" + binding.channel + ", 0))";
+            size = "vec4(" + texels + ", 1.0 / max(" + texels + ", vec2(1.0)))";
+        }
+        else if (binding.sizeName != "main")
+        {
+            continue;
+        }
+        set("texsize_" + binding.sizeName, size);
+        const std::string lowerCaseName = toLower(binding.sizeName);
+        if (isRandomTextureName(lowerCaseName) && lowerCaseName.length() > 7 && lowerCaseName[6] == '_' &&
+            assignedSizes.insert(binding.sizeName.substr(0, 6)).second)
+        {
+            set("texsize_" + binding.sizeName.substr(0, 6), size);
+        }
+    }
+    return inputs;
+}
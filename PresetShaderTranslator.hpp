@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <set>
+#include <string>
+
+class TranslationCache;
+
+/**
+ * @brief A preset warp or composite shader translated from HLSL.
+ *
+ * @c glsl holds hlslparser's helpers, the shader's globals and its PS() entry point, ready to
+ * follow the RaymarchVibe prelude: libprojectM's uniforms (_c0-_c13, _qa-_qh, rand_*, rot_*,
+ * texsize_*) become globals that generateInputs() sets in main(), and the samplers are bound to
+ * RaymarchVibe channels or to the BlurPyramid passes with #defines. Composite shaders also get preset_shader_hue(uv), the
+ * hue_shader input libprojectM interpolates from four time-varying corner colours.
+ */
+struct PresetShader {
+    std::string glsl;               ///< Empty when translation failed
+    std::set<std::string> samplers; ///< Referenced sampler names without "sampler_", as GetReferencedSamplers() finds them
+    int blurLevel = 0;              ///< Highest blur level the code reads (GetBlur1-3 or sampler_blurN), 0 for none
+    uint64_t hash = 0;              ///< Content hash of the preset code; seeds the per-preset random values
+    std::string error;
+};
+
+/**
+ * @brief HLSL to GLSL translation of preset shaders through the vendored hlslparser.
+ *
+ * Follows libprojectM's MilkdropShader: the preset code is wrapped into a PS() function behind
+ * the preset shader header, only the samplers it references are declared, and hlslparser
+ * generates GLSL 3.30 with the same NaN-propagation option. Results are cached by content hash
+ * in a cache of their own, since the same shader bodies recur across packs.
+ */
+class PresetShaderTranslator {
+public:
+    enum class Type {
+        Warp,     ///< warp_N lines; PS() outputs the next feedback frame
+        Composite ///< comp_N lines; PS() outputs the displayed frame
+    };
+
+    /// Translates the joined warp_N or comp_N code of a preset.
+    static PresetShader translate(Type type, const std::string& code);
+
+    /// Statements for main() that set the globals standing in for libprojectM's uniforms, from
+    /// the RaymarchVibe uniforms and the q1-q32 locals. @p blurBounds are GLSL expressions for
+    /// blur1_min, blur1_max, blur2_min, blur2_max, blur3_min and blur3_max.
+    static std::string generateInputs(const PresetShader& shader, const std::array<std::string, 6>& blurBounds);
+
+    /// GLSL vec3 standing in for libprojectM's random hueRandomOffsets of red, green and blue,
+    /// drawn from @p hash so a preset always gets the same hue drift.
+    static std::string generateHueOffsets(uint64_t hash);
+
+    /// Translations shared by every conversion in the process.
+    static TranslationCache& cache();
+
+    /// Preset shaders are a few kilobytes each; this holds a few hundred translations.
+    static constexpr size_t kCacheCapacityBytes = 4 * 1024 * 1024;
+    /// RaymarchVibe channels available to the preset's own textures (iChannel1-3).
+    static constexpr int kTextureChannels = 3;
+};
@@ -0,0 +1,68 @@
+#include "PresetValues.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+float presetFloat(const std::map<std::string, std::string>& presetValues, const std::string& key, float fallback)
+{
+    auto it = presetValues.find(key);
+    if (it == presetValues.end())
+    {
+        return fallback;
+    }
+    try
+    {
+        return std::stof(it->second);
+    }
+    catch (const std::exception&)
+    {
+        return fallback;
+    }
+}
+
+std::string presetCode(const std::map<std::string, std::string>& presetValues, const std::string& prefix)
+{
+    std::string code;
+    for (int line = 1;; ++line)
+    {
+        auto it = presetValues.find(prefix + std::to_string(line));
+        if (it == presetValues.end())
+        {
+            break;
+        }
+        code += (!it->second.empty() && it->second[0] == '`') ? it->second.substr(1) : it->second;
+        code += "\n";
+    }
+    return code;
+}
+
+bool presetCodeMentions(const std::string& code, const std::string& variable)
+{
+    std::string lowerCase = code;
+    std::transform(lowerCase.begin(), lowerCase.end(), lowerCase.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    auto isIdentifierChar = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+    for (size_t at = lowerCase.find(variable); at != std::string::npos; at = lowerCase.find(variable, at + 1))
+    {
+        const bool startsWord = at == 0 || !isIdentifierChar(lowerCase[at - 1]);
+        const bool endsWord = at + variable.size() == lowerCase.size() || !isIdentifierChar(lowerCase[at + variable.size()]);
+        if (startsWord && endsWord)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string glslFloat(float value)
+{
+    std::ostringstream out;
+    out.precision(9);
+    out << value;
+    std::string text = out.str();
+    if (text.find_first_of(".e") == std::string::npos)
+    {
+        text += ".0";
+    }
+    return text;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+/// Numeric preset value for @p key (lowercased, as PresetFileParser stores it), or @p fallback
+/// when the key is missing or not a number.
+float presetFloat(const std::map<std::string, std::string>& presetValues, const std::string& key, float fallback);
+
+/// Numbered code lines "<prefix>1", "<prefix>2", ... joined until the first gap, the same
+/// concatenation as PresetFileParser::GetCode().
+std::string presetCode(const std::map<std::string, std::string>& presetValues, const std::string& prefix);
+
+/// Whether the EEL @p code mentions @p variable (lowercase) as a whole identifier; EEL
+/// identifiers are case-insensitive.
+bool presetCodeMentions(const std::string& code, const std::string& variable);
+
+/// GLSL float literal for @p value, always with a decimal point or exponent.
+std::string glslFloat(float value);
@@ -0,0 +1,201 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <map>
+#include <thread>
+
+namespace {
+
+thread_local Profiler* g_currentProfiler = nullptr;
+
+void writeJsonString(std::ostream& out, const std::string& value)
+{
+    out << '"';
+    for (char c : value)
+    {
+        switch (c)
+        {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    out << ' ';
+                }
+                else
+                {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+}
+
+} // namespace
+
+#if MILKDROP_ENABLE_PROFILING
+
+// Defined by ProfilerAllocationHooks.cpp in the executables that count allocations; null
+// elsewhere. Other compilers have no weak references, so they never count.
+#if defined(__GNUC__)
+extern "C" {
+__attribute__((weak)) uint64_t milkdrop_profiler_allocation_count();
+__attribute__((weak)) uint64_t milkdrop_profiler_allocated_bytes();
+}
+#define MILKDROP_ALLOCATION_COUNTER(name) (name ? name() : 0)
+#else
+#define MILKDROP_ALLOCATION_COUNTER(name) 0
+#endif
+
+ProfileScope::~ProfileScope()
+{
+    if (!m_profiler)
+    {
+        return;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    Profiler::Event event;
+    event.stage = m_stage;
+    event.durationMicros = std::chrono::duration_cast<std::chrono::microseconds>(end - m_start).count();
+    event.startMicros = m_profiler->elapsedMicros() - event.durationMicros;
+    event.allocations = Profiler::allocationCount() - m_allocations;
+    event.allocatedBytes = Profiler::allocatedBytes() - m_allocatedBytes;
+    event.outputBytes = m_outputBytes;
+    m_profiler->record(std::move(event));
+}
+
+uint64_t Profiler::allocationCount()
+{
+    return MILKDROP_ALLOCATION_COUNTER(milkdrop_profiler_allocation_count);
+}
+
+uint64_t Profiler::allocatedBytes()
+{
+    return MILKDROP_ALLOCATION_COUNTER(milkdrop_profiler_allocated_bytes);
+}
+
+#else
+
+uint64_t Profiler::allocationCount()
+{
+    return 0;
+}
+
+uint64_t Profiler::allocatedBytes()
+{
+    return 0;
+}
+
+#endif
+
+Profiler::Session::Session(Profiler& profiler)
+    : m_previous(g_currentProfiler)
+{
+    g_currentProfiler = &profiler;
+}
+
+Profiler::Session::~Session()
+{
+    g_currentProfiler = m_previous;
+}
+
+Profiler::Profiler()
+    : m_origin(std::chrono::steady_clock::now())
+{
+}
+
+Profiler* Profiler::current()
+{
+    return g_currentProfiler;
+}
+
+void Profiler::record(Event event)
+{
+    event.label = m_label;
+    const std::thread::id thread = std::this_thread::get_id();
+    auto it = std::find(m_threads.begin(), m_threads.end(), thread);
+    if (it == m_threads.end())
+    {
+        it = m_threads.insert(it, thread);
+    }
+    event.threadId = static_cast<int>(it - m_threads.begin()) + 1;
+    m_events.push_back(std::move(event));
+}
+
+int64_t Profiler::elapsedMicros() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_origin).count();
+}
+
+void Profiler::writeJson(std::ostream& out) const
+{
+    struct Totals {
+        size_t calls = 0;
+        int64_t micros = 0;
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+        uint64_t outputBytes = 0;
+        size_t firstSeen = 0;
+    };
+
+    std::map<std::string, Totals> totals;
+    for (size_t i = 0; i < m_events.size(); ++i)
+    {
+        const auto& event = m_events[i];
+        auto inserted = totals.emplace(event.stage, Totals{});
+        auto& stage = inserted.first->second;
+        if (inserted.second)
+        {
+            stage.firstSeen = i;
+        }
+        ++stage.calls;
+        stage.micros += event.durationMicros;
+        stage.allocations += event.allocations;
+        stage.allocatedBytes += event.allocatedBytes;
+        stage.outputBytes += event.outputBytes;
+    }
+
+    // Keep stages in pipeline order (first occurrence) rather than alphabetical.
+    std::vector<std::pair<std::string, Totals>> ordered(totals.begin(), totals.end());
+    std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) {
+        return a.second.firstSeen < b.second.firstSeen;
+    });
+
+    out << "{\n  \"profiling_enabled\": " << (enabled() ? "true" : "false") << ",\n";
+    out << "  \"stages\": [";
+    for (size_t i = 0; i < ordered.size(); ++i)
+    {
+        const auto& stage = ordered[i].second;
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": ";
+        writeJsonString(out, ordered[i].first);
+        out << ", \"calls\": " << stage.calls
+            << ", \"wall_ms\": " << static_cast<double>(stage.micros) / 1000.0
+            << ", \"allocations\": " << stage.allocations
+            << ", \"allocated_bytes\": " << stage.allocatedBytes
+            << ", \"output_bytes\": " << stage.outputBytes << "}";
+    }
+    out << (ordered.empty() ? "]\n" : "\n  ]\n") << "}\n";
+}
+
+void Profiler::writeChromeTrace(std::ostream& out) const
+{
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (size_t i = 0; i < m_events.size(); ++i)
+    {
+        const auto& event = m_events[i];
+        out << (i == 0 ? "\n" : ",\n") << "  {\"name\": ";
+        writeJsonString(out, event.stage);
+        out << ", \"cat\": \"converter\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.threadId
+            << ", \"ts\": " << event.startMicros
+            << ", \"dur\": " << event.durationMicros
+            << ", \"args\": {\"preset\": ";
+        writeJsonString(out, event.label);
+        out << ", \"allocations\": " << event.allocations
+            << ", \"allocated_bytes\": " << event.allocatedBytes
+            << ", \"output_bytes\": " << event.outputBytes << "}}";
+    }
+    out << "\n]}\n";
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef MILKDROP_ENABLE_PROFILING
+#define MILKDROP_ENABLE_PROFILING 1
+#endif
+
+/**
+ * @brief Collects per-stage timings for one or more conversions.
+ *
+ * A profiler is attached to the calling thread with Profiler::Session; while it is
+ * attached, every ProfileScope on that thread records wall time, the number and size
+ * of C++ heap allocations made inside the scope, and the size of the scope's output.
+ * Results can be written as an aggregated JSON report or as Chrome trace events
+ * (chrome://tracing, Perfetto).
+ *
+ * Allocations are only counted in executables that compile ProfilerAllocationHooks.cpp
+ * (the command-line tool); elsewhere they are reported as 0. Building with
+ * MILKDROP_ENABLE_PROFILING=0 turns ProfileScope into an empty inline object; the
+ * Profiler API stays available but records nothing.
+ */
+class Profiler {
+public:
+    struct Event {
+        std::string stage;
+        std::string label;          //!< Preset or batch item the event belongs to.
+        int64_t startMicros = 0;    //!< Relative to the profiler's creation.
+        int64_t durationMicros = 0;
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+        uint64_t outputBytes = 0;
+        int threadId = 0;           //!< 1 for the first thread that recorded, 2 for the next, ...
+    };
+
+    /// Attaches a profiler to the current thread for the lifetime of the session.
+    class Session {
+    public:
+        explicit Session(Profiler& profiler);
+        ~Session();
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+
+    private:
+        Profiler* m_previous;
+    };
+
+    Profiler();
+
+    /// The profiler attached to the calling thread, or nullptr.
+    static Profiler* current();
+
+    /// Label attached to subsequent events, usually the preset file name.
+    void setLabel(const std::string& label) { m_label = label; }
+
+    void record(Event event);
+    const std::vector<Event>& events() const { return m_events; }
+    int64_t elapsedMicros() const;
+
+    /// Writes stage totals (calls, wall time, allocations, output size) as JSON.
+    void writeJson(std::ostream& out) const;
+
+    /// Writes every event in Chrome trace-event format.
+    void writeChromeTrace(std::ostream& out) const;
+
+    /// True when profiling support was compiled in.
+    static constexpr bool enabled() { return MILKDROP_ENABLE_PROFILING != 0; }
+
+    /// Thread-local C++ allocation counters maintained by the operator new replacement in
+    /// ProfilerAllocationHooks.cpp; always 0 in executables that do not compile it in.
+    static uint64_t allocationCount();
+    static uint64_t allocatedBytes();
+
+private:
+    std::chrono::steady_clock::time_point m_origin;
+    std::string m_label;
+    std::vector<Event> m_events;
+    std::vector<std::thread::id> m_threads;
+};
+
+#if MILKDROP_ENABLE_PROFILING
+
+/**
+ * @brief Records one stage on the thread's active profiler; a no-op when none is attached.
+ */
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* stage)
+        : m_profiler(Profiler::current())
+        , m_stage(stage)
+    {
+        if (m_profiler) {
+            m_allocations = Profiler::allocationCount();
+            m_allocatedBytes = Profiler::allocatedBytes();
+            m_start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    void setOutputBytes(size_t bytes) { m_outputBytes = bytes; }
+
+private:
+    Profiler* m_profiler;
+    const char* m_stage;
+    uint64_t m_allocations = 0;
+    uint64_t m_allocatedBytes = 0;
+    uint64_t m_outputBytes = 0;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#else
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char*) {}
+    void setOutputBytes(size_t) {}
+};
+
+#endif
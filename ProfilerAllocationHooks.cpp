@@ -0,0 +1,68 @@
+// Replacement global allocation functions feeding the profiler's per-thread allocation
+// counters. Replacing operator new changes every allocation in the process, so only the
+// executables that report allocations compile this file; Profiler finds the counters
+// through weak symbols and reports 0 without them. Memory allocated by the C projectm-eval
+// library (malloc) is not included.
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local uint64_t g_allocationCount = 0;
+thread_local uint64_t g_allocatedBytes = 0;
+
+} // namespace
+
+extern "C" {
+uint64_t milkdrop_profiler_allocation_count() { return g_allocationCount; }
+uint64_t milkdrop_profiler_allocated_bytes() { return g_allocatedBytes; }
+}
+
+void* operator new(std::size_t size)
+{
+    ++g_allocationCount;
+    g_allocatedBytes += size;
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    ++g_allocationCount;
+    g_allocatedBytes += size;
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return ::operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
@@ -0,0 +1,495 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <queue>
+
+namespace {
+
+void writeJsonString(std::ostream& out, const std::string& value)
+{
+    out << '"';
+    for (char c : value)
+    {
+        switch (c)
+        {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    out << ' ';
+                }
+                else
+                {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+}
+
+bool isIdentifierChar(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+size_t countWord(const std::string& text, const std::string& word)
+{
+    size_t count = 0;
+    for (size_t at = text.find(word); at != std::string::npos; at = text.find(word, at + word.size()))
+    {
+        const bool startsWord = at == 0 || !isIdentifierChar(text[at - 1]);
+        const bool endsWord = at + word.size() == text.size() || !isIdentifierChar(text[at + word.size()]);
+        if (startsWord && endsWord)
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+// Sampler uniforms the shader declares and mentions again (in code or in a #define that binds
+// a preset sampler to it), in declaration order.
+std::vector<std::string> usedSamplers(const std::string& glsl)
+{
+    std::vector<std::string> samplers;
+    for (const char* type : {"uniform sampler2D ", "uniform sampler3D "})
+    {
+        const std::string declaration = type;
+        for (size_t at = glsl.find(declaration); at != std::string::npos; at = glsl.find(declaration, at + 1))
+        {
+            size_t begin = at + declaration.size();
+            size_t end = begin;
+            while (end < glsl.size() && isIdentifierChar(glsl[end]))
+            {
+                ++end;
+            }
+            std::string name = glsl.substr(begin, end - begin);
+            if (!name.empty() && countWord(glsl, name) > 1 && std::find(samplers.begin(), samplers.end(), name) == samplers.end())
+            {
+                samplers.push_back(name);
+            }
+        }
+    }
+    return samplers;
+}
+
+bool sameSize(const RenderGraphResource& resource, const RenderGraphTarget& target)
+{
+    return resource.width == target.width && resource.height == target.height &&
+           resource.resolutionDivisor == target.resolutionDivisor && resource.format == target.format;
+}
+
+void writeSize(std::ostream& out, int width, int height, int resolutionDivisor)
+{
+    if (resolutionDivisor > 0)
+    {
+        out << "{\"divisor\": " << resolutionDivisor << "}";
+    }
+    else
+    {
+        out << "{\"width\": " << width << ", \"height\": " << height << "}";
+    }
+}
+
+} // namespace
+
+int RenderGraph::textureCount() const
+{
+    int count = 0;
+    for (const auto& target : targets)
+    {
+        count += target.buffers;
+    }
+    return count;
+}
+
+RenderGraph buildRenderGraph(const ConversionReport& report, const std::string& mainGLSL,
+                             const std::function<std::string(const std::string&)>& shaderPath)
+{
+    ShaderPass mainPass;
+    mainPass.name = "main";
+    mainPass.sampler = "iChannel0";
+    mainPass.resolutionDivisor = 1;
+    mainPass.glsl = mainGLSL;
+
+    std::vector<const ShaderPass*> order;
+    for (const auto& pass : report.passes)
+    {
+        order.push_back(&pass);
+    }
+    order.push_back(&mainPass);
+    const bool composite = !report.composite.glsl.empty();
+    if (composite)
+    {
+        order.push_back(&report.composite);
+    }
+
+    RenderGraph graph;
+    std::map<std::string, size_t> producers;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const ShaderPass& pass = *order[i];
+        // The composite output is only displayed, so it has no sampler of its own.
+        const std::string output = pass.sampler.empty() ? pass.name : pass.sampler;
+        producers[output] = i;
+
+        RenderGraphResource resource;
+        resource.name = output;
+        resource.producer = pass.name;
+        resource.width = pass.width;
+        resource.height = pass.height;
+        resource.resolutionDivisor = pass.resolutionDivisor;
+        graph.resources.push_back(resource);
+    }
+    graph.display = graph.resources.back().name;
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        const ShaderPass& pass = *order[i];
+        RenderGraphPass node;
+        node.name = pass.name;
+        node.shader = shaderPath(pass.name);
+        node.output = graph.resources[i].name;
+        const bool isComposite = composite && i + 1 == order.size();
+        for (const auto& sampler : usedSamplers(pass.glsl))
+        {
+            auto producer = producers.find(sampler);
+            if (producer == producers.end())
+            {
+                if (std::find(graph.externalInputs.begin(), graph.externalInputs.end(), sampler) == graph.externalInputs.end())
+                {
+                    graph.externalInputs.push_back(sampler);
+                }
+                node.inputs.push_back({sampler, false});
+                continue;
+            }
+            // The composite pass reads the frame just rendered; every other reader of iChannel0,
+            // and of any pass not yet drawn, gets last frame's output.
+            const bool previousFrame = sampler == "iChannel0" ? !isComposite : producer->second >= i;
+            node.inputs.push_back({sampler, previousFrame});
+        }
+        graph.passes.push_back(std::move(node));
+    }
+
+    allocateRenderTargets(graph);
+    return graph;
+}
+
+void allocateRenderTargets(RenderGraph& graph)
+{
+    std::map<std::string, size_t> index;
+    for (size_t i = 0; i < graph.resources.size(); ++i)
+    {
+        index[graph.resources[i].name] = i;
+    }
+    const int end = static_cast<int>(graph.passes.size());
+    for (int i = 0; i < end; ++i)
+    {
+        auto producer = index.find(graph.passes[i].output);
+        if (producer != index.end())
+        {
+            auto& resource = graph.resources[producer->second];
+            resource.firstUse = resource.lastUse = i;
+            resource.persistent = false;
+            resource.buffers = 1;
+        }
+    }
+    for (int i = 0; i < end; ++i)
+    {
+        for (const auto& input : graph.passes[i].inputs)
+        {
+            auto found = index.find(input.resource);
+            if (found == index.end())
+            {
+                continue;
+            }
+            auto& resource = graph.resources[found->second];
+            if (input.previousFrame)
+            {
+                resource.persistent = true;
+                // Reading last frame's contents after this frame's were written needs a second buffer.
+                if (i >= resource.firstUse)
+                {
+                    resource.buffers = 2;
+                }
+            }
+            else
+            {
+                resource.lastUse = std::max(resource.lastUse, i);
+            }
+        }
+    }
+    if (auto displayed = index.find(graph.display); displayed != index.end())
+    {
+        graph.resources[displayed->second].lastUse = end;
+    }
+
+    std::vector<size_t> byStart(graph.resources.size());
+    for (size_t i = 0; i < byStart.size(); ++i)
+    {
+        byStart[i] = i;
+    }
+    std::stable_sort(byStart.begin(), byStart.end(), [&](size_t a, size_t b) {
+        return graph.resources[a].firstUse < graph.resources[b].firstUse;
+    });
+
+    graph.targets.clear();
+    std::vector<int> busyUntil;
+    for (size_t i : byStart)
+    {
+        auto& resource = graph.resources[i];
+        if (resource.persistent)
+        {
+            // Persistent contents span frames, so the target is never handed to another resource.
+            resource.firstUse = 0;
+            resource.lastUse = end;
+        }
+        resource.target = -1;
+        for (size_t t = 0; t < graph.targets.size() && !resource.persistent; ++t)
+        {
+            if (busyUntil[t] < resource.firstUse && sameSize(resource, graph.targets[t]))
+            {
+                resource.target = static_cast<int>(t);
+                break;
+            }
+        }
+        if (resource.target < 0)
+        {
+            RenderGraphTarget target;
+            target.width = resource.width;
+            target.height = resource.height;
+            target.resolutionDivisor = resource.resolutionDivisor;
+            target.format = resource.format;
+            target.buffers = resource.buffers;
+            graph.targets.push_back(target);
+            busyUntil.push_back(0);
+            resource.target = static_cast<int>(graph.targets.size()) - 1;
+        }
+        graph.targets[resource.target].resources.push_back(resource.name);
+        // A persistent target is taken for good.
+        busyUntil[resource.target] = resource.persistent ? end + 1 : resource.lastUse;
+    }
+}
+
+std::vector<std::string> validateRenderGraph(const RenderGraph& graph)
+{
+    std::vector<std::string> errors;
+    std::map<std::string, size_t> resources;
+    for (size_t i = 0; i < graph.resources.size(); ++i)
+    {
+        if (!resources.emplace(graph.resources[i].name, i).second)
+        {
+            errors.push_back("resource " + graph.resources[i].name + " is declared twice");
+        }
+    }
+    std::map<std::string, size_t> producers;
+    for (size_t i = 0; i < graph.passes.size(); ++i)
+    {
+        const auto& pass = graph.passes[i];
+        if (!producers.emplace(pass.output, i).second)
+        {
+            errors.push_back("resource " + pass.output + " is written by more than one pass");
+        }
+        if (!resources.count(pass.output))
+        {
+            errors.push_back("pass " + pass.name + " writes the undeclared resource " + pass.output);
+        }
+    }
+    if (!resources.count(graph.display))
+    {
+        errors.push_back("the displayed resource " + graph.display + " is not declared");
+    }
+
+    // Same-frame inputs are the edges of the graph; Kahn's algorithm leaves the passes of any
+    // cycle unvisited.
+    std::vector<std::vector<size_t>> consumers(graph.passes.size());
+    std::vector<int> pending(graph.passes.size(), 0);
+    for (size_t i = 0; i < graph.passes.size(); ++i)
+    {
+        const auto& pass = graph.passes[i];
+        for (const auto& input : pass.inputs)
+        {
+            auto producer = producers.find(input.resource);
+            const bool external = std::find(graph.externalInputs.begin(), graph.externalInputs.end(), input.resource) !=
+                                  graph.externalInputs.end();
+            if (producer == producers.end())
+            {
+                if (!external)
+                {
+                    errors.push_back("pass " + pass.name + " reads " + input.resource + ", which no pass produces");
+                }
+                continue;
+            }
+            if (input.previousFrame)
+            {
+                auto resource = resources.find(input.resource);
+                if (resource != resources.end())
+                {
+                    const auto& state = graph.resources[resource->second];
+                    if (!state.persistent)
+                    {
+                        errors.push_back("pass " + pass.name + " reads last frame's " + input.resource + ", which does not persist");
+                    }
+                    else if (producer->second <= i && state.buffers < 2)
+                    {
+                        errors.push_back("pass " + pass.name + " reads last frame's " + input.resource +
+                                         " after it is overwritten; it needs two buffers");
+                    }
+                }
+                continue;
+            }
+            if (producer->second >= i)
+            {
+                errors.push_back("pass " + pass.name + " reads " + input.resource + " before " +
+                                 graph.passes[producer->second].name + " produces it");
+            }
+            consumers[producer->second].push_back(i);
+            ++pending[i];
+        }
+    }
+    std::queue<size_t> ready;
+    for (size_t i = 0; i < pending.size(); ++i)
+    {
+        if (pending[i] == 0)
+        {
+            ready.push(i);
+        }
+    }
+    size_t visited = 0;
+    while (!ready.empty())
+    {
+        size_t pass = ready.front();
+        ready.pop();
+        ++visited;
+        for (size_t consumer : consumers[pass])
+        {
+            if (--pending[consumer] == 0)
+            {
+                ready.push(consumer);
+            }
+        }
+    }
+    if (visited != graph.passes.size())
+    {
+        std::string cycle;
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            if (pending[i] > 0)
+            {
+                cycle += (cycle.empty() ? "" : ", ") + graph.passes[i].name;
+            }
+        }
+        errors.push_back("same-frame inputs form a cycle through " + cycle);
+    }
+
+    // Every same-frame read must fall inside the resource's lifetime, and resources sharing a
+    // target must never be alive at once.
+    for (size_t i = 0; i < graph.passes.size(); ++i)
+    {
+        for (const auto& input : graph.passes[i].inputs)
+        {
+            auto resource = resources.find(input.resource);
+            if (resource != resources.end() && !input.previousFrame)
+            {
+                const auto& state = graph.resources[resource->second];
+                if (static_cast<int>(i) < state.firstUse || static_cast<int>(i) > state.lastUse)
+                {
+                    errors.push_back("pass " + graph.passes[i].name + " reads " + input.resource + " outside its lifetime");
+                }
+            }
+        }
+    }
+    std::vector<std::vector<const RenderGraphResource*>> shared(graph.targets.size());
+    for (const auto& resource : graph.resources)
+    {
+        if (resource.target < 0 || resource.target >= static_cast<int>(graph.targets.size()))
+        {
+            errors.push_back("resource " + resource.name + " has no target");
+            continue;
+        }
+        const auto& target = graph.targets[resource.target];
+        if (!sameSize(resource, target) || target.buffers < resource.buffers)
+        {
+            errors.push_back("resource " + resource.name + " does not fit target " + std::to_string(resource.target));
+        }
+        for (const auto* other : shared[resource.target])
+        {
+            if (resource.persistent || other->persistent ||
+                (resource.firstUse <= other->lastUse && other->firstUse <= resource.lastUse))
+            {
+                errors.push_back("resources " + other->name + " and " + resource.name + " share target " +
+                                 std::to_string(resource.target) + " while both are alive");
+            }
+        }
+        shared[resource.target].push_back(&resource);
+    }
+    return errors;
+}
+
+void writeRenderGraphJson(std::ostream& out, const RenderGraph& graph)
+{
+    out << "{\n  \"version\": 1,\n  \"display\": ";
+    writeJsonString(out, graph.display);
+    out << ",\n  \"textures\": " << graph.textureCount() << ",\n  \"passes\": [";
+    for (size_t i = 0; i < graph.passes.size(); ++i)
+    {
+        const auto& pass = graph.passes[i];
+        out << (i ? "," : "") << "\n    {\"name\": ";
+        writeJsonString(out, pass.name);
+        out << ", \"shader\": ";
+        writeJsonString(out, pass.shader);
+        out << ", \"output\": ";
+        writeJsonString(out, pass.output);
+        out << ", \"inputs\": [";
+        for (size_t j = 0; j < pass.inputs.size(); ++j)
+        {
+            out << (j ? ", " : "") << "{\"resource\": ";
+            writeJsonString(out, pass.inputs[j].resource);
+            out << ", \"frame\": \"" << (pass.inputs[j].previousFrame ? "previous" : "current") << "\"}";
+        }
+        out << "]}";
+    }
+    out << "\n  ],\n  \"resources\": [";
+    for (size_t i = 0; i < graph.resources.size(); ++i)
+    {
+        const auto& resource = graph.resources[i];
+        out << (i ? "," : "") << "\n    {\"name\": ";
+        writeJsonString(out, resource.name);
+        out << ", \"producer\": ";
+        writeJsonString(out, resource.producer);
+        out << ", \"size\": ";
+        writeSize(out, resource.width, resource.height, resource.resolutionDivisor);
+        out << ", \"format\": ";
+        writeJsonString(out, resource.format);
+        out << ", \"persistent\": " << (resource.persistent ? "true" : "false") << ", \"lifetime\": [" << resource.firstUse
+            << ", " << resource.lastUse << "], \"target\": " << resource.target << "}";
+    }
+    out << "\n  ],\n  \"targets\": [";
+    for (size_t i = 0; i < graph.targets.size(); ++i)
+    {
+        const auto& target = graph.targets[i];
+        out << (i ? "," : "") << "\n    {\"id\": " << i << ", \"size\": ";
+        writeSize(out, target.width, target.height, target.resolutionDivisor);
+        out << ", \"format\": ";
+        writeJsonString(out, target.format);
+        out << ", \"buffers\": " << target.buffers << ", \"resources\": [";
+        for (size_t j = 0; j < target.resources.size(); ++j)
+        {
+            out << (j ? ", " : "");
+            writeJsonString(out, target.resources[j]);
+        }
+        out << "]}";
+    }
+    out << "\n  ],\n  \"external_inputs\": [";
+    for (size_t i = 0; i < graph.externalInputs.size(); ++i)
+    {
+        out << (i ? ", " : "");
+        writeJsonString(out, graph.externalInputs[i]);
+    }
+    out << "]\n}\n";
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "MilkdropConverter.hpp"
+
+/**
+ * @brief A texture read by a render graph pass.
+ *
+ * @c previousFrame inputs read what the producer wrote in the frame before, as the main
+ * shader reads its own last output through iChannel0 or a warp shader reads last frame's blur.
+ */
+struct RenderGraphInput {
+    std::string resource;
+    bool previousFrame = false;
+};
+
+/**
+ * @brief One draw of the frame: a full-screen shader writing one resource.
+ */
+struct RenderGraphPass {
+    std::string name;   ///< ShaderPass::name, "main" for the main shader
+    std::string shader; ///< Path of the fragment shader file
+    std::vector<RenderGraphInput> inputs;
+    std::string output; ///< Resource written
+};
+
+/**
+ * @brief A pass output, named after the sampler uniform it is bound to.
+ *
+ * Lifetimes are pass indices. Persistent resources are read in a later frame and keep their
+ * contents for the whole frame; they need two buffers when a pass reads last frame's contents
+ * after the producer has already written this frame's.
+ */
+struct RenderGraphResource {
+    std::string name;
+    std::string producer;
+    int width = 0;             ///< Fixed size in texels, or 0 when screen-relative
+    int height = 0;
+    int resolutionDivisor = 0; ///< > 0: the screen size divided on each axis
+    std::string format = "rgba32f";
+    bool persistent = false;
+    int buffers = 1;
+    int firstUse = 0;
+    int lastUse = 0;
+    int target = -1;           ///< Index into RenderGraph::targets
+};
+
+/**
+ * @brief A texture (or ping-pong pair) the host allocates; transient resources whose
+ * lifetimes do not overlap share one.
+ */
+struct RenderGraphTarget {
+    int width = 0;
+    int height = 0;
+    int resolutionDivisor = 0;
+    std::string format;
+    int buffers = 1;
+    std::vector<std::string> resources;
+};
+
+/**
+ * @brief Every pass of a converted preset in render order, with the textures they exchange.
+ *
+ * The passes are the ConversionReport prepasses, the main shader and the composite shader.
+ * Inputs come from the samplers each shader declares and uses; iChannel0 is the main output,
+ * the previous frame's everywhere but in the composite pass. Samplers no pass writes (iChannel1-3,
+ * iAudioTexture, preset textures) are @c externalInputs the host supplies. @c display names the
+ * resource presented on screen.
+ */
+struct RenderGraph {
+    std::vector<RenderGraphPass> passes;
+    std::vector<RenderGraphResource> resources;
+    std::vector<RenderGraphTarget> targets;
+    std::vector<std::string> externalInputs;
+    std::string display;
+
+    /// Textures the host allocates: the targets, counting ping-pong pairs twice.
+    int textureCount() const;
+};
+
+/// Builds the graph of a conversion, with lifetimes and aliased targets. @p shaderPath maps a
+/// pass name to the file its shader is written to.
+RenderGraph buildRenderGraph(const ConversionReport& report, const std::string& mainGLSL,
+                             const std::function<std::string(const std::string&)>& shaderPath);
+
+/// Computes lifetimes, persistence and buffer counts from the passes and assigns the targets:
+/// each persistent resource gets its own, transient ones reuse a target of the same size and
+/// format once its last resource has been read.
+void allocateRenderTargets(RenderGraph& graph);
+
+/// Problems that make the graph unrenderable: a cycle among same-frame inputs, an input no
+/// earlier pass produces, a previous-frame read of a resource that does not persist, or
+/// resources sharing a target while alive. Empty when the graph is valid.
+std::vector<std::string> validateRenderGraph(const RenderGraph& graph);
+
+/// Writes the --pass-graph manifest hosts read (format in the README).
+void writeRenderGraphJson(std::ostream& out, const RenderGraph& graph);
@@ -0,0 +1,418 @@
+#include "ShaderCostModel.hpp"
+
+#include "GLSLTokenizer.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Token = GLSLToken;
+
+const std::set<std::string> kTranscendentals = {
+    "sin", "cos", "tan", "asin", "acos", "atan", "sinh", "cosh", "tanh",
+    "exp", "exp2", "log", "log2", "pow", "sqrt", "inversesqrt"};
+
+const std::set<std::string> kTextureFunctions = {
+    "texture", "texture2D", "textureLod", "textureGrad", "texelFetch", "textureOffset"};
+
+// Constructors and conversions are free on every GPU we target.
+const std::set<std::string> kConstructors = {
+    "float", "int", "uint", "bool", "vec2", "vec3", "vec4", "ivec2", "ivec3", "ivec4",
+    "bvec2", "bvec3", "bvec4", "mat2", "mat3", "mat4"};
+
+const std::set<std::string> kKeywords = {"return", "if", "else", "for", "while", "do", "break", "continue"};
+
+bool isWaveCap(const std::string& name)
+{
+    static const std::string prefix = "MODE";
+    static const std::string suffix = "_MAX_WAVE_ITERATIONS";
+    return name.size() > prefix.size() + suffix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+           name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+class Analyzer
+{
+public:
+    explicit Analyzer(const std::string& glsl)
+        : m_tokens(tokenizeGLSL(glsl))
+    {
+        indexGlobals();
+    }
+
+    ShaderCost function(const std::string& name)
+    {
+        auto memo = m_memo.find(name);
+        if (memo != m_memo.end())
+        {
+            return memo->second;
+        }
+        auto it = m_functions.find(name);
+        if (it == m_functions.end() || m_active.count(name))
+        {
+            return {};
+        }
+
+        m_active.insert(name);
+        ShaderCost worst;
+        for (const auto& body : it->second)
+        {
+            ShaderCost cost = range(body.first, body.second, capReferencedIn(body.first, body.second));
+            if (cost.weighted() > worst.weighted())
+            {
+                worst = cost;
+            }
+        }
+        m_active.erase(name);
+        m_memo[name] = worst;
+        return worst;
+    }
+
+private:
+    using Range = std::pair<size_t, size_t>;
+
+    bool is(size_t index, const char* text) const
+    {
+        return index < m_tokens.size() && m_tokens[index].text == text;
+    }
+
+    // Index of the token closing the bracket opened at @p open.
+    size_t matching(size_t open) const
+    {
+        const std::string& opener = m_tokens[open].text;
+        const std::string closer = opener == "(" ? ")" : opener == "{" ? "}" : "]";
+        int depth = 0;
+        for (size_t i = open; i < m_tokens.size(); ++i)
+        {
+            if (m_tokens[i].text == opener) ++depth;
+            if (m_tokens[i].text == closer && --depth == 0) return i;
+        }
+        return m_tokens.size();
+    }
+
+    void indexGlobals()
+    {
+        int depth = 0;
+        for (size_t i = 0; i < m_tokens.size(); ++i)
+        {
+            const auto& token = m_tokens[i];
+            if (token.text == "{") ++depth;
+            if (token.text == "}") --depth;
+            if (depth != 0) continue;
+
+            if (token.text == "const" && is(i + 1, "int") && i + 4 < m_tokens.size() && is(i + 3, "=") &&
+                m_tokens[i + 4].kind == Token::Kind::Number)
+            {
+                m_constants[m_tokens[i + 2].text] = std::atoi(m_tokens[i + 4].text.c_str());
+                continue;
+            }
+
+            // <type> <name> ( ... ) { ... }
+            if (token.kind == Token::Kind::Identifier && i + 2 < m_tokens.size() &&
+                m_tokens[i + 1].kind == Token::Kind::Identifier && is(i + 2, "("))
+            {
+                size_t close = matching(i + 2);
+                if (is(close + 1, "{"))
+                {
+                    size_t end = matching(close + 1);
+                    m_functions[m_tokens[i + 1].text].push_back({close + 2, end});
+                    i = end;
+                }
+            }
+        }
+    }
+
+    int capReferencedIn(size_t begin, size_t end) const
+    {
+        int cap = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (isWaveCap(m_tokens[i].text))
+            {
+                auto it = m_constants.find(m_tokens[i].text);
+                if (it != m_constants.end()) cap = std::max(cap, it->second);
+            }
+        }
+        return cap;
+    }
+
+    // Body of a for/while statement starting at @p start: a braced block or one statement.
+    Range statementAt(size_t start) const
+    {
+        if (is(start, "{"))
+        {
+            return {start + 1, matching(start)};
+        }
+        size_t i = start;
+        int depth = 0;
+        for (; i < m_tokens.size(); ++i)
+        {
+            const auto& text = m_tokens[i].text;
+            if (text == "(" || text == "[" || text == "{") ++depth;
+            if (text == ")" || text == "]" || text == "}") --depth;
+            if (text == ";" && depth == 0) break;
+        }
+        return {start, i};
+    }
+
+    // Trip count from the loop condition; returns 0 when the bound is unknown.
+    uint64_t tripCount(Range condition, int cap, bool& capBounded) const
+    {
+        capBounded = false;
+        for (size_t i = condition.first; i < condition.second; ++i)
+        {
+            const auto& text = m_tokens[i].text;
+            if (text != "<" && text != "<=") continue;
+
+            int extra = text == "<=" ? 1 : 0;
+            if (i + 2 == condition.second)
+            {
+                const auto& bound = m_tokens[i + 1];
+                if (bound.kind == Token::Kind::Number)
+                {
+                    return static_cast<uint64_t>(std::max(0, std::atoi(bound.text.c_str()) + extra));
+                }
+                auto it = m_constants.find(bound.text);
+                if (it != m_constants.end())
+                {
+                    capBounded = isWaveCap(bound.text);
+                    return static_cast<uint64_t>(std::max(0, it->second + extra));
+                }
+            }
+            break;
+        }
+        if (cap > 0)
+        {
+            capBounded = true;
+            return static_cast<uint64_t>(cap);
+        }
+        return 0;
+    }
+
+    ShaderCost loop(size_t headerOpen, bool isFor, int cap, size_t& next)
+    {
+        size_t headerClose = matching(headerOpen);
+        Range init{headerOpen + 1, headerOpen + 1};
+        Range condition{headerOpen + 1, headerClose};
+        Range increment{headerClose, headerClose};
+        if (isFor)
+        {
+            size_t first = headerOpen + 1;
+            while (first < headerClose && !is(first, ";")) ++first;
+            size_t second = first + 1;
+            while (second < headerClose && !is(second, ";")) ++second;
+            init = {headerOpen + 1, first};
+            condition = {first + 1, second};
+            increment = {std::min(second + 1, headerClose), headerClose};
+        }
+
+        Range body = statementAt(headerClose + 1);
+        next = body.second;
+
+        bool capBounded = false;
+        uint64_t trips = isFor ? tripCount(condition, cap, capBounded) : 0;
+
+        ShaderCost perTrip = range(condition.first, condition.second, cap);
+        perTrip += range(increment.first, increment.second, cap);
+        perTrip += range(body.first, body.second, cap);
+
+        ShaderCost cost = range(init.first, init.second, cap);
+        if (trips == 0)
+        {
+            ++cost.unboundedLoops;
+            trips = 1;
+        }
+        cost += perTrip.scaled(trips);
+        cost.loopIterations += trips;
+        if (capBounded)
+        {
+            cost.waveIterationCap = std::max(cost.waveIterationCap, static_cast<int>(trips));
+        }
+        return cost;
+    }
+
+    ShaderCost range(size_t begin, size_t end, int cap)
+    {
+        ShaderCost cost;
+        for (size_t i = begin; i < end && i < m_tokens.size(); ++i)
+        {
+            const Token& token = m_tokens[i];
+            const std::string& text = token.text;
+
+            if (token.kind == Token::Kind::Identifier)
+            {
+                if ((text == "for" || text == "while") && is(i + 1, "("))
+                {
+                    size_t next = i;
+                    cost += loop(i + 1, text == "for", cap, next);
+                    i = next;
+                    continue;
+                }
+                if (!is(i + 1, "(") || kKeywords.count(text) || kConstructors.count(text))
+                {
+                    continue;
+                }
+                if (m_functions.count(text))
+                {
+                    cost += function(text);
+                }
+                else if (kTranscendentals.count(text))
+                {
+                    ++cost.transcendentals;
+                }
+                else if (kTextureFunctions.count(text))
+                {
+                    ++cost.textureFetches;
+                }
+                else
+                {
+                    ++cost.builtins;
+                }
+                continue;
+            }
+            if (token.kind != Token::Kind::Punctuation)
+            {
+                continue;
+            }
+
+            if (text == "+" || text == "-")
+            {
+                // Unary signs are free source modifiers.
+                const Token* previous = i > 0 ? &m_tokens[i - 1] : nullptr;
+                bool binary = previous && (previous->kind == Token::Kind::Number || previous->text == ")" || previous->text == "]" ||
+                                           (previous->kind == Token::Kind::Identifier && !kKeywords.count(previous->text)));
+                if (binary) ++cost.addSub;
+            }
+            else if (text == "++" || text == "--" || text == "+=" || text == "-=")
+            {
+                ++cost.addSub;
+            }
+            else if (text == "*" || text == "*=")
+            {
+                ++cost.mul;
+            }
+            else if (text == "/" || text == "/=" || text == "%" || text == "%=")
+            {
+                ++cost.divMod;
+            }
+            else if (text == "<" || text == ">" || text == "<=" || text == ">=" || text == "==" || text == "!=" ||
+                     text == "&&" || text == "||" || text == "!" || text == "?")
+            {
+                ++cost.compare;
+            }
+        }
+        return cost;
+    }
+
+    std::vector<Token> m_tokens;
+    std::unordered_map<std::string, std::vector<Range>> m_functions;
+    std::unordered_map<std::string, int> m_constants;
+    std::unordered_map<std::string, ShaderCost> m_memo;
+    std::set<std::string> m_active;
+};
+
+} // namespace
+
+double ShaderCost::weighted() const
+{
+    return static_cast<double>(addSub + mul + compare) + kDivWeight * static_cast<double>(divMod) +
+           kBuiltinWeight * static_cast<double>(builtins) + kTranscendentalWeight * static_cast<double>(transcendentals) +
+           kTextureWeight * static_cast<double>(textureFetches);
+}
+
+double ShaderCost::frameMillis() const
+{
+    return (weighted() + kPixelOverheadOps) * kReferenceWidth * kReferenceHeight / kReferenceOpsPerSecond * 1000.0;
+}
+
+double ShaderCost::budgetForFrameMillis(double millis)
+{
+    const double ops = millis / 1000.0 * kReferenceOpsPerSecond / (static_cast<double>(kReferenceWidth) * kReferenceHeight);
+    // At least one op, so a frame time below the pixel overhead still sets a budget.
+    return std::max(1.0, ops - kPixelOverheadOps);
+}
+
+ShaderCost& ShaderCost::operator+=(const ShaderCost& other)
+{
+    addSub += other.addSub;
+    mul += other.mul;
+    divMod += other.divMod;
+    compare += other.compare;
+    builtins += other.builtins;
+    transcendentals += other.transcendentals;
+    textureFetches += other.textureFetches;
+    loopIterations += other.loopIterations;
+    waveIterationCap = std::max(waveIterationCap, other.waveIterationCap);
+    unboundedLoops += other.unboundedLoops;
+    return *this;
+}
+
+ShaderCost ShaderCost::scaled(uint64_t factor) const
+{
+    ShaderCost result = *this;
+    result.addSub *= factor;
+    result.mul *= factor;
+    result.divMod *= factor;
+    result.compare *= factor;
+    result.builtins *= factor;
+    result.transcendentals *= factor;
+    result.textureFetches *= factor;
+    result.loopIterations *= factor;
+    return result;
+}
+
+ShaderCost ShaderCost::divided(uint64_t divisor) const
+{
+    auto share = [divisor](uint64_t value) { return (value + divisor - 1) / divisor; };
+    ShaderCost result = *this;
+    result.addSub = share(addSub);
+    result.mul = share(mul);
+    result.divMod = share(divMod);
+    result.compare = share(compare);
+    result.builtins = share(builtins);
+    result.transcendentals = share(transcendentals);
+    result.textureFetches = share(textureFetches);
+    result.loopIterations = share(loopIterations);
+    return result;
+}
+
+ShaderCost ShaderCostModel::analyze(const std::string& glsl, const std::string& entryPoint)
+{
+    Analyzer analyzer(glsl);
+    return analyzer.function(entryPoint);
+}
+
+void ShaderCostModel::writeReport(std::ostream& out, const std::string& label, const ShaderCost& cost)
+{
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << "Cost report for " << label << " (worst case, per pixel)\n"
+        << "  add/sub:          " << cost.addSub << "\n"
+        << "  mul:              " << cost.mul << "\n"
+        << "  div/mod:          " << cost.divMod << "\n"
+        << "  compare/logic:    " << cost.compare << "\n"
+        << "  built-in calls:   " << cost.builtins << "\n"
+        << "  transcendentals:  " << cost.transcendentals << "\n"
+        << "  texture fetches:  " << cost.textureFetches << "\n"
+        << "  loop iterations:  " << cost.loopIterations;
+    if (cost.waveIterationCap > 0)
+    {
+        out << " (wave cap " << cost.waveIterationCap << ")";
+    }
+    if (cost.unboundedLoops > 0)
+    {
+        out << " (" << cost.unboundedLoops << " unbounded loop(s) charged once)";
+    }
+    out << "\n" << std::fixed << std::setprecision(1)
+        << "  weighted cost:    " << cost.weighted() << " ops\n"
+        << "  est. frame time:  " << std::setprecision(2) << cost.frameMillis() << " ms at "
+        << ShaderCost::kReferenceWidth << "x" << ShaderCost::kReferenceHeight << ", "
+        << std::setprecision(0) << ShaderCost::kReferenceOpsPerSecond / 1e9 << " Gop/s reference\n";
+    out.flags(flags);
+    out.precision(precision);
+}
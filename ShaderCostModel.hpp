@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * @brief Worst-case per-pixel operation counts for one generated shader.
+ *
+ * Counts are static: both sides of every branch are charged, called functions are
+ * inlined at their call sites (the most expensive overload wins), and loops are
+ * multiplied by their trip count. Loops bounded by a runtime value are charged the
+ * largest MODE*_MAX_WAVE_ITERATIONS cap referenced by the enclosing function.
+ */
+struct ShaderCost {
+    uint64_t addSub = 0;          //!< +, -, ++, --, += and -=
+    uint64_t mul = 0;             //!< * and *=
+    uint64_t divMod = 0;          //!< /, /= and %
+    uint64_t compare = 0;         //!< Comparisons, logical operators and ?:
+    uint64_t builtins = 0;        //!< Cheap built-ins (min, max, clamp, mix, dot, floor, ...)
+    uint64_t transcendentals = 0; //!< sin, cos, tan, exp, log, pow, sqrt, atan, ...
+    uint64_t textureFetches = 0;
+    uint64_t loopIterations = 0;  //!< Total worst-case loop trips, nested loops multiplied out
+    int waveIterationCap = 0;     //!< Largest MODE*_MAX_WAVE_ITERATIONS cap bounding a loop
+    int unboundedLoops = 0;       //!< Loops whose trip count could not be determined (charged once)
+
+    /// Single scalar in "ALU op" units using the weights below.
+    double weighted() const;
+
+    /// Estimated frame time at the reference resolution and throughput, pixel overhead included.
+    double frameMillis() const;
+
+    ShaderCost& operator+=(const ShaderCost& other);
+    ShaderCost scaled(uint64_t factor) const;
+    /// Per-screen-pixel share of a pass that runs on 1/@p divisor of the pixels (rounded up).
+    ShaderCost divided(uint64_t divisor) const;
+
+    // Least-squares fit to `regression_glsl_perf.py --json` over the fixtures (256x256,
+    // LP_NUM_THREADS=1, 20 frames): time per pixel = 24.97 ns + 0.005893 ns per weighted op,
+    // with a mean relative error of 16.2% (worst 52%, che.milk).
+    static constexpr double kDivWeight = 4.0;
+    static constexpr double kBuiltinWeight = 1.0;
+    static constexpr double kTranscendentalWeight = 4.0;
+    static constexpr double kTextureWeight = 32.0;
+    /// Fixed per-pixel cost of running any fragment shader (rasterization, setup, output), in ops:
+    /// the fitted intercept over the slope, 24.97 / 0.005893 = 4236, rounded.
+    static constexpr double kPixelOverheadOps = 4200.0;
+
+    /// Lowest-end target: 1080p on an entry-level integrated GPU. One llvmpipe thread runs
+    /// 1 / 0.005893 ns = 170 G weighted ops/s (the fitted slope); the target is taken as 24
+    /// such threads.
+    static constexpr int kReferenceWidth = 1920;
+    static constexpr int kReferenceHeight = 1080;
+    static constexpr double kReferenceOpsPerSecond = 24 * 170e9;
+
+    /// Weighted per-pixel cost that fits in @p millis on the reference target, beyond the pixel
+    /// overhead (at least 1).
+    static double budgetForFrameMillis(double millis);
+};
+
+/**
+ * @brief Static cost estimator for the GLSL emitted by translateToGLSL().
+ *
+ * The estimator tokenizes the shader, indexes its functions and global integer
+ * constants, and walks the entry point. It understands the subset of GLSL the
+ * converter generates; anything unrecognised is charged as a generic built-in call.
+ */
+class ShaderCostModel {
+public:
+    /// Estimates the cost of one invocation of @p entryPoint.
+    static ShaderCost analyze(const std::string& glsl, const std::string& entryPoint = "main");
+
+    /// Human-readable per-preset report.
+    static void writeReport(std::ostream& out, const std::string& label, const ShaderCost& cost);
+};
@@ -0,0 +1,620 @@
+#include "ShaderSpecializer.hpp"
+
+#include "GLSLTokenizer.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <set>
+#include <utility>
+
+namespace {
+
+using Range = std::pair<size_t, size_t>; //!< Token indices [first, second)
+
+struct Edit {
+    size_t begin;
+    size_t end;
+    std::string text;
+};
+
+using EditGroup = std::vector<Edit>; //!< Edits that are only valid together
+
+// Applies the groups in order, skipping any group that overlaps one already taken;
+// the skipped rewrite is found again in the next round.
+std::string applyEdits(const std::string& source, const std::vector<EditGroup>& groups)
+{
+    std::map<size_t, size_t> taken;
+    auto overlaps = [&](const Edit& edit) {
+        auto next = taken.lower_bound(edit.begin);
+        if (next != taken.end() && next->first < edit.end) return true;
+        return next != taken.begin() && std::prev(next)->second > edit.begin;
+    };
+    std::vector<Edit> edits;
+    for (const auto& group : groups)
+    {
+        if (std::any_of(group.begin(), group.end(), overlaps))
+        {
+            continue;
+        }
+        for (const auto& edit : group)
+        {
+            taken[edit.begin] = edit.end;
+            edits.push_back(edit);
+        }
+    }
+    std::sort(edits.begin(), edits.end(), [](const Edit& a, const Edit& b) { return a.begin > b.begin; });
+    std::string result = source;
+    for (const auto& edit : edits)
+    {
+        result.replace(edit.begin, edit.end - edit.begin, edit.text);
+    }
+    return result;
+}
+
+const std::set<std::string> kComparisons = {"<", ">", "<=", ">=", "==", "!="};
+const std::set<std::string> kAssignments = {"=", "+=", "-=", "*=", "/=", "%=", "++", "--"};
+
+// A top-level function definition or const declaration.
+struct Item {
+    bool function;
+    std::string name;
+    size_t nameToken;
+    size_t first; //!< First token (return type or `const`)
+    size_t last;  //!< Closing brace or semicolon
+    std::vector<Range> parameters;
+    size_t bodyOpen = 0;
+};
+
+class Snippet
+{
+public:
+    Snippet(const std::string& source, const std::vector<std::string>& roots)
+        : m_source(source)
+        , m_roots(roots)
+        , m_tokens(tokenizeGLSL(source))
+    {
+        index();
+        m_live = reachable();
+    }
+
+    void strip(std::vector<EditGroup>& groups) const
+    {
+        EditGroup removals;
+        for (const auto& item : m_items)
+        {
+            if (!m_live.contains(item))
+            {
+                removals.push_back(removal(item));
+            }
+        }
+        groups.push_back(std::move(removals));
+    }
+
+    // const float NAME = 1.0; inside a function body: drop the declaration, use the literal.
+    void inlineLocalConstants(std::vector<EditGroup>& groups) const
+    {
+        for (const auto& item : m_items)
+        {
+            if (!item.function)
+            {
+                continue;
+            }
+            EditGroup edits;
+            std::map<std::string, std::string> constants;
+            for (size_t i = item.bodyOpen + 1; i < item.last; ++i)
+            {
+                std::string literalText;
+                if (is(i, "const") && (is(i + 1, "float") || is(i + 1, "int")) && is(i + 3, "="))
+                {
+                    size_t end = literalEnd(i + 4, literalText);
+                    if (end != 0 && is(end, ";"))
+                    {
+                        constants[m_tokens[i + 2].text] = literalText;
+                        edits.push_back(lineRemoval(i, end));
+                        i = end;
+                        continue;
+                    }
+                }
+                auto constant = constants.find(m_tokens[i].text);
+                if (constant != constants.end() && !is(i - 1, "."))
+                {
+                    edits.push_back({m_tokens[i].offset, m_tokens[i].end(), parenthesized(constant->second)});
+                }
+            }
+            if (!edits.empty())
+            {
+                groups.push_back(std::move(edits));
+            }
+        }
+    }
+
+    void resolveCalls(const ShaderSpecializer::CallResolver& resolve, std::vector<EditGroup>& groups) const
+    {
+        for (size_t i = 0; i + 1 < m_tokens.size(); ++i)
+        {
+            if (m_tokens[i].kind != GLSLToken::Kind::Identifier || !is(i + 1, "("))
+            {
+                continue;
+            }
+            std::string literalText;
+            size_t end = literalEnd(i + 2, literalText);
+            if (end == 0 || !is(end, ")"))
+            {
+                continue;
+            }
+            std::string replacement = resolve(m_tokens[i].text, std::strtod(literalText.c_str(), nullptr));
+            if (!replacement.empty())
+            {
+                groups.push_back({{m_tokens[i].offset, m_tokens[end].end(), replacement}});
+                i = end;
+            }
+        }
+    }
+
+    // `= 6.0 < -0.5 ? A : B;` -> `= B;` when both branches are single tokens.
+    void foldLiteralTernaries(std::vector<EditGroup>& groups) const
+    {
+        for (size_t i = 1; i < m_tokens.size(); ++i)
+        {
+            const auto& start = m_tokens[i - 1].text;
+            if (start != "=" && start != "(" && start != "," && start != "return")
+            {
+                continue;
+            }
+            std::string lhsText;
+            std::string rhsText;
+            size_t op = literalEnd(i, lhsText);
+            if (op == 0 || !kComparisons.count(m_tokens[op].text))
+            {
+                continue;
+            }
+            size_t question = literalEnd(op + 1, rhsText);
+            if (question == 0 || !is(question, "?") || !is(question + 2, ":") || question + 4 >= m_tokens.size())
+            {
+                continue;
+            }
+            const auto& terminator = m_tokens[question + 4].text;
+            if (terminator != ";" && terminator != ")" && terminator != ",")
+            {
+                continue;
+            }
+            double lhs = std::strtod(lhsText.c_str(), nullptr);
+            double rhs = std::strtod(rhsText.c_str(), nullptr);
+            const auto& comparison = m_tokens[op].text;
+            bool condition = comparison == "<" ? lhs < rhs : comparison == ">" ? lhs > rhs
+                : comparison == "<=" ? lhs <= rhs : comparison == ">=" ? lhs >= rhs
+                : comparison == "==" ? lhs == rhs : lhs != rhs;
+            const auto& chosen = m_tokens[condition ? question + 1 : question + 3];
+            groups.push_back({{m_tokens[i].offset, m_tokens[question + 3].end(), chosen.text}});
+            i = question + 3;
+        }
+    }
+
+    // Folds, per function, the first parameter that every live call site passes the
+    // same literal.
+    void propagateArguments(std::vector<EditGroup>& groups) const
+    {
+        std::map<std::pair<std::string, size_t>, int> overloads;
+        for (const auto& item : m_items)
+        {
+            if (item.function) ++overloads[{item.name, item.parameters.size()}];
+        }
+
+        std::map<std::pair<std::string, size_t>, std::vector<std::vector<Range>>> calls;
+        for (size_t i = 0; i + 1 < m_tokens.size(); ++i)
+        {
+            if (m_tokens[i].kind != GLSLToken::Kind::Identifier || !is(i + 1, "(") || m_definitionName[i] ||
+                !m_functionNames.count(m_tokens[i].text) || (m_owner[i] >= 0 && !m_live.contains(m_items[m_owner[i]])))
+            {
+                continue;
+            }
+            std::vector<Range> arguments = split(i + 1);
+            calls[{m_tokens[i].text, arguments.size()}].push_back(std::move(arguments));
+        }
+
+        for (const auto& item : m_items)
+        {
+            const size_t arity = item.parameters.size();
+            if (!item.function || arity == 0 || !m_live.contains(item) || overloads[{item.name, arity}] != 1 ||
+                overloads.count({item.name, arity - 1}) || std::find(m_roots.begin(), m_roots.end(), item.name) != m_roots.end())
+            {
+                continue;
+            }
+            auto sites = calls.find({item.name, arity});
+            if (sites == calls.end())
+            {
+                continue;
+            }
+
+            for (size_t p = 0; p < arity; ++p)
+            {
+                std::string value;
+                if (!foldableParameter(item, p) || !sameLiteral(sites->second, p, value))
+                {
+                    continue;
+                }
+                // GLSL 3.30 has no implicit int -> float conversion for function arguments.
+                const bool floatParameter = m_tokens[item.parameters[p].second - 2].text == "float";
+                const bool floatLiteral = value.find_first_of(".eE") != std::string::npos;
+                if (!floatParameter && floatLiteral)
+                {
+                    continue;
+                }
+                if (floatParameter && !floatLiteral)
+                {
+                    value += ".0";
+                }
+                const std::string& parameterName = m_tokens[item.parameters[p].second - 1].text;
+                EditGroup edits;
+                edits.push_back(argumentRemoval(item.parameters, p));
+                for (const auto& call : sites->second)
+                {
+                    edits.push_back(argumentRemoval(call, p));
+                }
+                for (size_t i = item.bodyOpen + 1; i < item.last; ++i)
+                {
+                    if (m_tokens[i].text == parameterName && !is(i - 1, "."))
+                    {
+                        edits.push_back({m_tokens[i].offset, m_tokens[i].end(), parenthesized(value)});
+                    }
+                }
+                groups.push_back(std::move(edits));
+                break;
+            }
+        }
+    }
+
+private:
+    bool is(size_t index, const char* text) const
+    {
+        return index < m_tokens.size() && m_tokens[index].text == text;
+    }
+
+    size_t matching(size_t open) const
+    {
+        const std::string& opener = m_tokens[open].text;
+        const std::string closer = opener == "(" ? ")" : opener == "{" ? "}" : "]";
+        int depth = 0;
+        for (size_t i = open; i < m_tokens.size(); ++i)
+        {
+            if (m_tokens[i].text == opener) ++depth;
+            if (m_tokens[i].text == closer && --depth == 0) return i;
+        }
+        return m_tokens.size();
+    }
+
+    // Token ranges of the comma-separated list inside the parentheses opened at @p open.
+    std::vector<Range> split(size_t open) const
+    {
+        std::vector<Range> parts;
+        size_t close = matching(open);
+        if (close == open + 1 || (close == open + 2 && is(open + 1, "void")))
+        {
+            return parts;
+        }
+        size_t start = open + 1;
+        int depth = 0;
+        for (size_t i = open + 1; i < close; ++i)
+        {
+            const auto& text = m_tokens[i].text;
+            if (text == "(" || text == "[" || text == "{") ++depth;
+            if (text == ")" || text == "]" || text == "}") --depth;
+            if (text == "," && depth == 0)
+            {
+                parts.push_back({start, i});
+                start = i + 1;
+            }
+        }
+        parts.push_back({start, close});
+        return parts;
+    }
+
+    // A numeric literal, optionally negated, starting at @p index. Returns the index after
+    // it, or 0 when there is none.
+    size_t literalEnd(size_t index, std::string& text) const
+    {
+        bool negative = is(index, "-");
+        size_t number = negative ? index + 1 : index;
+        if (number >= m_tokens.size() || m_tokens[number].kind != GLSLToken::Kind::Number)
+        {
+            return 0;
+        }
+        text = (negative ? "-" : "") + m_tokens[number].text;
+        return number + 1;
+    }
+
+    static std::string parenthesized(const std::string& literal)
+    {
+        return literal[0] == '-' ? "(" + literal + ")" : literal;
+    }
+
+    // Scalar, input-only, and never written in the body.
+    bool foldableParameter(const Item& item, size_t p) const
+    {
+        Range range = item.parameters[p];
+        if (range.second - range.first < 2)
+        {
+            return false;
+        }
+        const auto& type = m_tokens[range.second - 2].text;
+        if (type != "float" && type != "int")
+        {
+            return false;
+        }
+        for (size_t i = range.first; i < range.second; ++i)
+        {
+            if (m_tokens[i].text == "out" || m_tokens[i].text == "inout") return false;
+        }
+        const std::string& name = m_tokens[range.second - 1].text;
+        for (size_t i = item.bodyOpen + 1; i < item.last; ++i)
+        {
+            if (m_tokens[i].text != name) continue;
+            if ((i + 1 < m_tokens.size() && kAssignments.count(m_tokens[i + 1].text)) || is(i - 1, "++") || is(i - 1, "--"))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool sameLiteral(const std::vector<std::vector<Range>>& calls, size_t p, std::string& value) const
+    {
+        for (size_t c = 0; c < calls.size(); ++c)
+        {
+            std::string text;
+            Range argument = calls[c][p];
+            if (literalEnd(argument.first, text) != argument.second)
+            {
+                return false;
+            }
+            if (c == 0)
+            {
+                value = text;
+            }
+            else if (std::strtod(text.c_str(), nullptr) != std::strtod(value.c_str(), nullptr))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Removes element @p p of a parameter or argument list together with one separating comma.
+    Edit argumentRemoval(const std::vector<Range>& list, size_t p) const
+    {
+        if (list.size() == 1)
+        {
+            return {m_tokens[list[p].first].offset, m_tokens[list[p].second - 1].end(), ""};
+        }
+        if (p + 1 < list.size())
+        {
+            return {m_tokens[list[p].first].offset, m_tokens[list[p + 1].first].offset, ""};
+        }
+        return {m_tokens[list[p - 1].second - 1].end(), m_tokens[list[p].second - 1].end(), ""};
+    }
+
+    size_t lineStart(size_t offset) const
+    {
+        size_t newline = offset == 0 ? std::string::npos : m_source.rfind('\n', offset - 1);
+        return newline == std::string::npos ? 0 : newline + 1;
+    }
+
+    size_t lineEnd(size_t offset) const
+    {
+        size_t newline = m_source.find('\n', offset);
+        return newline == std::string::npos ? m_source.size() : newline + 1;
+    }
+
+    bool blankBetween(size_t begin, size_t end) const
+    {
+        return m_source.find_first_not_of(" \t", begin) >= end;
+    }
+
+    // Whole lines when tokens [first, last] are alone on them, the tokens otherwise.
+    Edit lineRemoval(size_t first, size_t last) const
+    {
+        size_t begin = m_tokens[first].offset;
+        size_t end = m_tokens[last].end();
+        size_t start = lineStart(begin);
+        size_t stop = lineEnd(end);
+        if (blankBetween(start, begin) && blankBetween(end, stop - (m_source[stop - 1] == '\n' ? 1 : 0)))
+        {
+            return {start, stop, ""};
+        }
+        return {begin, end, ""};
+    }
+
+    // The item plus the comment lines directly above it.
+    Edit removal(const Item& item) const
+    {
+        Edit edit = lineRemoval(item.first, item.last);
+        if (edit.begin != lineStart(m_tokens[item.first].offset))
+        {
+            return edit;
+        }
+        while (edit.begin > 0)
+        {
+            size_t previous = lineStart(edit.begin - 1);
+            size_t text = m_source.find_first_not_of(" \t", previous);
+            if (text >= edit.begin || m_source.compare(text, 2, "//") != 0)
+            {
+                break;
+            }
+            edit.begin = previous;
+        }
+        return edit;
+    }
+
+    void index()
+    {
+        indexItems();
+        m_owner.assign(m_tokens.size(), -1);
+        m_definitionName.assign(m_tokens.size(), false);
+        for (size_t n = 0; n < m_items.size(); ++n)
+        {
+            const Item& item = m_items[n];
+            std::fill(m_owner.begin() + item.first, m_owner.begin() + std::min(item.last + 1, m_tokens.size()), static_cast<int>(n));
+            m_definitionName[item.nameToken] = true;
+            m_byName[item.name].push_back(n);
+            if (item.function) m_functionNames.insert(item.name);
+        }
+    }
+
+    void indexItems()
+    {
+        for (size_t i = 0; i < m_tokens.size(); ++i)
+        {
+            const auto& token = m_tokens[i];
+            if (token.text == "{")
+            {
+                // Top-level block that is not a function body (e.g. an interface block).
+                i = matching(i);
+                continue;
+            }
+            if (token.text == "const" && i + 3 < m_tokens.size() && m_tokens[i + 2].kind == GLSLToken::Kind::Identifier &&
+                is(i + 3, "="))
+            {
+                size_t end = i + 3;
+                while (end < m_tokens.size() && !is(end, ";")) ++end;
+                m_items.push_back({false, m_tokens[i + 2].text, i + 2, i, end, {}, 0});
+                i = end;
+                continue;
+            }
+            if (token.kind == GLSLToken::Kind::Identifier && i + 2 < m_tokens.size() &&
+                m_tokens[i + 1].kind == GLSLToken::Kind::Identifier && is(i + 2, "("))
+            {
+                size_t close = matching(i + 2);
+                if (is(close + 1, "{"))
+                {
+                    Item item{true, m_tokens[i + 1].text, i + 1, i, matching(close + 1), split(i + 2), close + 1};
+                    m_items.push_back(std::move(item));
+                    i = m_items.back().last;
+                    continue;
+                }
+            }
+            // Anything else (uniforms, prototypes) is kept; whatever it names stays live.
+            size_t end = i;
+            while (end < m_tokens.size() && !is(end, ";") && !is(end, "{")) ++end;
+            for (size_t j = i; j < end; ++j)
+            {
+                if (m_tokens[j].kind == GLSLToken::Kind::Identifier) m_pinned.insert(m_tokens[j].text);
+            }
+            i = is(end, "{") ? end - 1 : end;
+        }
+    }
+
+    // Live function overloads are tracked by (name, arity) so an unused shorthand
+    // overload does not keep its callees, or a literal argument, alive.
+    struct Liveness {
+        std::set<std::string> names;
+        std::set<std::pair<std::string, size_t>> overloads;
+
+        bool contains(const Item& item) const
+        {
+            return item.function ? overloads.count({item.name, item.parameters.size()}) > 0 : names.count(item.name) > 0;
+        }
+    };
+
+    Liveness reachable() const
+    {
+        Liveness live;
+        std::vector<const Item*> pending;
+        auto reference = [&](const std::string& name, size_t arity, bool call) {
+            auto named = m_byName.find(name);
+            if (named == m_byName.end())
+            {
+                return;
+            }
+            for (size_t n : named->second)
+            {
+                const Item& item = m_items[n];
+                if ((call && item.function && item.parameters.size() != arity) || live.contains(item))
+                {
+                    continue;
+                }
+                if (item.function)
+                {
+                    live.overloads.insert({item.name, item.parameters.size()});
+                }
+                else
+                {
+                    live.names.insert(item.name);
+                }
+                pending.push_back(&item);
+            }
+        };
+        for (const auto& root : m_roots)
+        {
+            reference(root, 0, false);
+        }
+        for (const auto& name : m_pinned)
+        {
+            reference(name, 0, false);
+        }
+        while (!pending.empty())
+        {
+            const Item* item = pending.back();
+            pending.pop_back();
+            for (size_t i = item->first; i <= item->last && i < m_tokens.size(); ++i)
+            {
+                if (m_tokens[i].kind != GLSLToken::Kind::Identifier || i == item->nameToken)
+                {
+                    continue;
+                }
+                const bool call = is(i + 1, "(");
+                reference(m_tokens[i].text, call ? split(i + 1).size() : 0, call);
+            }
+        }
+        return live;
+    }
+
+    const std::string& m_source;
+    std::vector<std::string> m_roots;
+    std::vector<GLSLToken> m_tokens;
+    std::vector<Item> m_items;
+    std::vector<int> m_owner;           //!< Item index per token, -1 outside items
+    std::vector<bool> m_definitionName; //!< Token names the item it belongs to
+    std::map<std::string, std::vector<size_t>> m_byName;
+    std::set<std::string> m_functionNames;
+    std::set<std::string> m_pinned; //!< Identifiers used outside functions and constants
+    Liveness m_live;
+};
+
+} // namespace
+
+std::string ShaderSpecializer::stripUnreferenced(const std::string& glsl, const std::vector<std::string>& roots)
+{
+    std::vector<EditGroup> groups;
+    Snippet(glsl, roots).strip(groups);
+    return applyEdits(glsl, groups);
+}
+
+std::string ShaderSpecializer::specialize(const std::string& glsl, const std::vector<std::string>& roots,
+                                          const CallResolver& resolve)
+{
+    // Every round rewrites at least one group, so the bound only guards against cycles.
+    const int kMaxRounds = 256;
+    std::string current = glsl;
+    for (int round = 0; round < kMaxRounds; ++round)
+    {
+        Snippet snippet(current, roots);
+        std::vector<EditGroup> groups;
+        snippet.strip(groups);
+        snippet.inlineLocalConstants(groups);
+        if (resolve)
+        {
+            snippet.resolveCalls(resolve, groups);
+        }
+        snippet.foldLiteralTernaries(groups);
+        snippet.propagateArguments(groups);
+        std::string next = applyEdits(current, groups);
+        if (next == current)
+        {
+            break;
+        }
+        current = std::move(next);
+    }
+    return current;
+}
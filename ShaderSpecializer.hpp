@@ -0,0 +1,29 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Conversion-time specialization of a generated GLSL helper library.
+ *
+ * Works on the top-level functions and const declarations of a snippet. Numeric
+ * constants local to a function are inlined, a parameter that every call site passes
+ * the same literal is folded into the function body, calls with one literal argument
+ * are resolved through a caller-supplied table, and functions or constants that the
+ * roots can no longer reach are removed. Other top-level declarations (uniforms) are
+ * always kept.
+ */
+class ShaderSpecializer {
+public:
+    /// Replacement text for @p function called with the literal @p argument, or empty to keep the call.
+    using CallResolver = std::function<std::string(const std::string& function, double argument)>;
+
+    /// Runs every pass until the snippet stops changing. @p roots are the entry points
+    /// the rest of the shader calls; their signatures are never changed.
+    static std::string specialize(const std::string& glsl, const std::vector<std::string>& roots,
+                                  const CallResolver& resolve = nullptr);
+
+    /// Removes the functions and constants not reachable from @p roots.
+    static std::string stripUnreferenced(const std::string& glsl, const std::vector<std::string>& roots);
+};
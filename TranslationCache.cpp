@@ -0,0 +1,157 @@
+#include "TranslationCache.hpp"
+
+#include <cctype>
+#include <cstdio>
+
+namespace {
+
+bool isWordChar(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '$';
+}
+
+} // namespace
+
+TranslationCache::TranslationCache(size_t capacityBytes)
+    : m_capacityBytes(capacityBytes)
+{
+}
+
+TranslationCache& TranslationCache::instance()
+{
+    static TranslationCache cache;
+    return cache;
+}
+
+std::string TranslationCache::makeKey(const std::string& scope, const char* statement, size_t length)
+{
+    std::string key;
+    key.reserve(scope.size() + length + 1);
+    key += scope;
+    key += '\n';
+
+    bool pendingSpace = false;
+    for (size_t i = 0; i < length; ++i)
+    {
+        char c = statement[i];
+        if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            pendingSpace = true;
+            continue;
+        }
+        // Whitespace only matters where it separates two word tokens.
+        if (pendingSpace && isWordChar(c) && isWordChar(key.back()))
+        {
+            key += ' ';
+        }
+        pendingSpace = false;
+        key += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return key;
+}
+
+std::string TranslationCache::makeHashKey(const std::string& scope, const std::string& content)
+{
+    char digest[40];
+    std::snprintf(digest, sizeof(digest), "%016llx:%zu", static_cast<unsigned long long>(contentHash(content)), content.size());
+    return scope + '\n' + digest;
+}
+
+uint64_t TranslationCache::contentHash(const std::string& content)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : content)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool TranslationCache::lookup(const std::string& key, Entry& out)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(key);
+    if (it == m_index.end())
+    {
+        ++m_stats.misses;
+        return false;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    out = it->second->second;
+    ++m_stats.hits;
+    return true;
+}
+
+void TranslationCache::store(const std::string& key, Entry entry)
+{
+    size_t size = entrySize(key, entry);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (size > m_capacityBytes)
+    {
+        return;
+    }
+
+    auto it = m_index.find(key);
+    if (it != m_index.end())
+    {
+        m_bytes -= entrySize(it->first, it->second->second);
+        m_lru.erase(it->second);
+        m_index.erase(it);
+    }
+
+    m_lru.emplace_front(key, std::move(entry));
+    m_index.emplace(key, m_lru.begin());
+    m_bytes += size;
+    evictToCapacity();
+}
+
+void TranslationCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lru.clear();
+    m_index.clear();
+    m_bytes = 0;
+    m_stats = Stats{};
+}
+
+void TranslationCache::setCapacity(size_t capacityBytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capacityBytes = capacityBytes;
+    evictToCapacity();
+}
+
+TranslationCache::Stats TranslationCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.entries = m_lru.size();
+    stats.bytes = m_bytes;
+    return stats;
+}
+
+size_t TranslationCache::entrySize(const std::string& key, const Entry& entry)
+{
+    // Keys are stored twice (index and list); the constant covers node overhead.
+    size_t size = key.size() * 2 + entry.glsl.size() + 96;
+    for (const auto& variable : entry.variables)
+    {
+        size += variable.size() + sizeof(std::string);
+    }
+    return size;
+}
+
+void TranslationCache::evictToCapacity()
+{
+    while (m_bytes > m_capacityBytes && !m_lru.empty())
+    {
+        auto& last = m_lru.back();
+        m_bytes -= entrySize(last.first, last.second);
+        m_index.erase(last.first);
+        m_lru.pop_back();
+        ++m_stats.evictions;
+    }
+}
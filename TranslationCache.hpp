@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Process-wide memo of translated MilkDrop statements.
+ *
+ * Preset packs repeat the same per-frame idioms (beat detection blocks, q-variable
+ * chains, colour oscillators) thousands of times. The cache maps a normalized
+ * statement, qualified by the block it appears in, to the GLSL line emitted for it
+ * and the variable names it references, so repeated statements skip both compilation
+ * and emission. Memory is bounded by a byte budget with least-recently-used eviction.
+ */
+class TranslationCache {
+public:
+    struct Entry {
+        std::string glsl;
+        std::vector<std::string> variables;
+    };
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    explicit TranslationCache(size_t capacityBytes = kDefaultCapacityBytes);
+
+    /// Shared instance used by translateToGLSL().
+    static TranslationCache& instance();
+
+    /// Builds the lookup key for a statement; whitespace is collapsed and letters lower-cased,
+    /// as MilkDrop code is case-insensitive and GLSLGenerator emits lower-case variable names.
+    static std::string makeKey(const std::string& scope, const char* statement, size_t length);
+
+    /// Builds the lookup key for a whole block from its length and 64-bit content hash, for
+    /// blocks such as preset shaders that are too long to key verbatim.
+    static std::string makeHashKey(const std::string& scope, const std::string& content);
+
+    /// FNV-1a hash of @p content.
+    static uint64_t contentHash(const std::string& content);
+
+    /// Copies the entry for @p key into @p out and marks it most recently used.
+    bool lookup(const std::string& key, Entry& out);
+
+    /// Inserts or replaces an entry, evicting old entries until the budget is met.
+    void store(const std::string& key, Entry entry);
+
+    void clear();
+    void setCapacity(size_t capacityBytes);
+    Stats stats() const;
+
+    static constexpr size_t kDefaultCapacityBytes = 8 * 1024 * 1024;
+
+private:
+    using LruList = std::list<std::pair<std::string, Entry>>;
+
+    static size_t entrySize(const std::string& key, const Entry& entry);
+    void evictToCapacity();
+
+    mutable std::mutex m_mutex;
+    LruList m_lru;
+    std::unordered_map<std::string, LruList::iterator> m_index;
+    size_t m_capacityBytes;
+    size_t m_bytes = 0;
+    Stats m_stats;
+};
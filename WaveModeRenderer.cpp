@@ -1,5 +1,13 @@
 #include "WaveModeRenderer.hpp"
 
+#include "ShaderSpecializer.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 namespace {
 
 class CircleWaveRenderer final : public WaveModeRenderer {
@@ -56,8 +64,8 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
 
     for (int i = 0; i < iterationBudget; ++i)
     {
-        float displacement1 = (i % 2 == 0) ? audio.x : audio.y;
-        float displacement2 = ((i + 1) % 2 == 0) ? audio.x : audio.y;
+        float displacement1 = wave_sample(audio, i, sample_count).x;
+        float displacement2 = wave_sample(audio, i + 1, sample_count).x;
         float radius1 = clamp(0.5 + 0.4 * displacement1 * wave_scale + mystery, -2.0, 2.0);
         float radius2 = clamp(0.5 + 0.4 * displacement2 * wave_scale + mystery, -2.0, 2.0);
         float angle1 = angle_base + angle_step * float(i);
@@ -82,6 +90,55 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
     std::string callPattern() const override {
         return R"___(
 draw_wave(pixelUV, iAudioBands.xy, 128, wave_x, wave_y, wave_mystery, wave_quality)
+)___";
+    }
+    std::string geometryFunction() const override {
+        return R"___(
+// Mode 0 geometry: one circle segment per texel
+vec4 wave_geometry_texel(int texel, vec2 audio_data, int samples, float wave_x, float wave_y, float wave_mystery, float wave_quality)
+{
+    const float WAVE_MODE_HINT = 0.0;
+    float angleLimit;
+    float distanceClamp;
+    float epsilon;
+    wave_resolve_mode(WAVE_MODE_HINT, angleLimit, distanceClamp, epsilon);
+
+    vec2 audio = wave_clamp_audio(audio_data);
+    vec2 center = vec2(wave_x, wave_y);
+    vec2 aspect = wave_aspect();
+    float wave_scale = 0.25;
+    float mystery = clamp(wave_mystery * 0.5 + 0.5, -1.0, 1.0);
+    mystery = abs(fract(mystery));
+    mystery = mystery * 2.0 - 1.0;
+
+    int raw_samples = max(samples / 2, 2);
+    int sample_count = min(raw_samples, MODE0_MAX_WAVE_ITERATIONS + 1);
+    int segment_count = max(sample_count - 1, 1);
+    float sample_count_f = float(sample_count);
+    float angle_base = iTime * 0.2;
+    float angle_step = min(WAVE_TWO_PI / max(sample_count_f, 1.0), angleLimit);
+
+    float load = wave_estimate_load(segment_count, 0.01);
+    float adjustedQuality = wave_adjust_quality(wave_quality, load);
+    int iterationBudget = wave_iteration_budget(segment_count, adjustedQuality);
+    if (texel == 0)
+    {
+        return wave_geometry_header(iterationBudget, load, adjustedQuality, wave_is_overloaded(adjustedQuality, load));
+    }
+
+    int i = texel - 1;
+    if (i >= iterationBudget)
+    {
+        return vec4(0.0);
+    }
+    float displacement1 = wave_sample(audio, i, sample_count).x;
+    float displacement2 = wave_sample(audio, i + 1, sample_count).x;
+    float radius1 = clamp(0.5 + 0.4 * displacement1 * wave_scale + mystery, -2.0, 2.0);
+    float radius2 = clamp(0.5 + 0.4 * displacement2 * wave_scale + mystery, -2.0, 2.0);
+    float angle1 = angle_base + angle_step * float(i);
+    float angle2 = angle1 + angle_step;
+    return vec4(wave_mode0_vertex(radius1, angle1, center, aspect), wave_mode0_vertex(radius2, angle2, center, aspect));
+}
 )___";
     }
 };
@@ -131,8 +188,8 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
 
     for (int i = 0; i < iterationBudget; ++i)
     {
-        float displacement_x = (i % 2 == 0) ? audio.x : audio.y;
-        float displacement_y = ((i + 32) % 2 == 0) ? audio.x : audio.y;
+        float displacement_x = wave_sample(audio, i, sample_count).x;
+        float displacement_y = wave_sample(audio, i + 32, sample_count).y;
         vec2 point = wave_mode2_vertex(displacement_x, displacement_y, center, aspect, wave_scale);
         float fade = 1.0 - float(i) / max(sample_count_f, 1.0);
         float dist = wave_safe_distance(uv, point, distanceClamp);
@@ -154,6 +211,47 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
     std::string callPattern() const override {
         return R"___(draw_wave(pixelUV, iAudioBands.xy, 128, wave_x, wave_y, wave_mystery, wave_quality))___";
     }
+    std::string geometryFunction() const override {
+        return R"___(
+// Mode 2 geometry: one dot per texel, softness in z
+vec4 wave_geometry_texel(int texel, vec2 audio_data, int samples, float wave_x, float wave_y, float wave_mystery, float wave_quality)
+{
+    const float WAVE_MODE_HINT = 2.0;
+    float epsilon = wave_select_epsilon(WAVE_MODE_HINT);
+
+    vec2 audio = wave_clamp_audio(audio_data);
+    vec2 center = vec2(wave_x, wave_y);
+    vec2 aspect = wave_aspect();
+    float wave_scale = 0.25;
+    int sample_count = max(min(samples, MODE2_MAX_WAVE_ITERATIONS), 1);
+    float sample_count_f = float(sample_count);
+
+    float load = wave_estimate_load(sample_count, 0.012);
+    float adjustedQuality = wave_adjust_quality(wave_quality, load);
+    int iterationBudget = wave_iteration_budget(sample_count, adjustedQuality);
+    if (texel == 0)
+    {
+        return wave_geometry_header(iterationBudget, load, adjustedQuality, wave_is_overloaded(adjustedQuality, load));
+    }
+
+    int i = texel - 1;
+    if (i >= iterationBudget)
+    {
+        return vec4(0.0);
+    }
+    float displacement_x = wave_sample(audio, i, sample_count).x;
+    float displacement_y = wave_sample(audio, i + 32, sample_count).y;
+    vec2 point = wave_mode2_vertex(displacement_x, displacement_y, center, aspect, wave_scale);
+    float fade = 1.0 - float(i) / max(sample_count_f, 1.0);
+    float softness = max(0.005 + 0.01 * fade, epsilon * 4.0);
+    return vec4(point, softness, 0.0);
+}
+)___";
+    }
+
+    bool pointPrimitives() const override {
+        return true;
+    }
 };
 
 class CenteredSpiroVolumeRenderer final : public WaveModeRenderer {
@@ -202,8 +300,8 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
 
     for (int i = 0; i < iterationBudget; ++i)
     {
-        float displacement_x = (i % 2 == 0) ? audio.x : audio.y;
-        float displacement_y = ((i + 32) % 2 == 0) ? audio.x : audio.y;
+        float displacement_x = wave_sample(audio, i, sample_count).x;
+        float displacement_y = wave_sample(audio, i + 32, sample_count).y;
         vec2 point = wave_mode3_vertex(displacement_x, displacement_y, center, aspect, wave_scale);
         float fade = 1.0 - float(i) / max(sample_count_f, 1.0);
         float dist = wave_safe_distance(uv, point, distanceClamp);
@@ -227,6 +325,52 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
 draw_wave(pixelUV, iAudioBands.xy, 128, wave_x, wave_y, wave_mystery, iAudioBands.z, wave_quality)
 )___";
     }
+    std::string geometryFunction() const override {
+        return R"___(
+// Mode 3 geometry: one volume-scaled dot per texel, softness in z
+vec4 wave_geometry_texel(int texel, vec2 audio_data, int samples, float wave_x, float wave_y, float wave_mystery, float volume_level, float wave_quality)
+{
+    const float WAVE_MODE_HINT = 3.0;
+    float epsilon = wave_select_epsilon(WAVE_MODE_HINT);
+
+    vec2 audio = wave_clamp_audio(audio_data);
+    vec2 center = vec2(wave_x, wave_y);
+    vec2 aspect = wave_aspect();
+    float base_scale = 0.25;
+    float wave_scale = base_scale * wave_volume_scale(volume_level);
+    int sample_count = max(min(samples, MODE3_MAX_WAVE_ITERATIONS), 1);
+    float sample_count_f = float(sample_count);
+
+    float load = wave_estimate_load(sample_count, 0.014);
+    float adjustedQuality = wave_adjust_quality(wave_quality, load);
+    int iterationBudget = wave_iteration_budget(sample_count, adjustedQuality);
+    if (texel == 0)
+    {
+        return wave_geometry_header(iterationBudget, load, adjustedQuality, wave_is_overloaded(adjustedQuality, load));
+    }
+
+    int i = texel - 1;
+    if (i >= iterationBudget)
+    {
+        return vec4(0.0);
+    }
+    float displacement_x = wave_sample(audio, i, sample_count).x;
+    float displacement_y = wave_sample(audio, i + 32, sample_count).y;
+    vec2 point = wave_mode3_vertex(displacement_x, displacement_y, center, aspect, wave_scale);
+    float fade = 1.0 - float(i) / max(sample_count_f, 1.0);
+    float softness = max(0.007 + 0.01 * fade, epsilon * 6.0);
+    return vec4(point, softness, 0.0);
+}
+)___";
+    }
+
+    bool pointPrimitives() const override {
+        return true;
+    }
+
+    bool usesVolumeLevel() const override {
+        return true;
+    }
 };
 
 class DerivativeLineRenderer final : public WaveModeRenderer {
@@ -286,8 +430,8 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
 
     for (int i = 0; i < iterationBudget; ++i)
     {
-        float displacement1 = (i % 2 == 0) ? audio.x : audio.y;
-        float displacement2 = ((i + 1) % 2 == 0) ? audio.x : audio.y;
+        float displacement1 = wave_sample(audio, i, sample_count).x;
+        float displacement2 = wave_sample(audio, i + 1, sample_count).x;
         vec2 p1 = wave_mode_line_vertex(edge_x, edge_y, distance_x, distance_y,
                                         perpendicular_dx, perpendicular_dy, float(i), displacement1, wave_scale);
         vec2 p2 = wave_mode_line_vertex(edge_x, edge_y, distance_x, distance_y,
@@ -310,6 +454,53 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
     std::string callPattern() const override {
         return R"___(draw_wave(pixelUV, iAudioBands.xy, 128, wave_x, wave_y, wave_mystery, wave_quality))___";
     }
+    std::string geometryFunction() const override {
+        return R"___(
+// Mode 4 geometry: one line segment per texel
+vec4 wave_geometry_texel(int texel, vec2 audio_data, int samples, float wave_x, float wave_y, float wave_mystery, float wave_quality)
+{
+    const float WAVE_MODE_HINT = 4.0;
+
+    vec2 audio = wave_clamp_audio(audio_data);
+    float wave_scale = 0.25;
+
+    int raw_samples = max(samples / 2, 2);
+    int sample_count = min(raw_samples, MODE4_MAX_WAVE_ITERATIONS + 1);
+    int segment_count = max(sample_count - 1, 1);
+
+    float load = wave_estimate_load(segment_count, 0.01);
+    float adjustedQuality = wave_adjust_quality(wave_quality, load);
+    int iterationBudget = wave_iteration_budget(segment_count, adjustedQuality);
+    if (texel == 0)
+    {
+        return wave_geometry_header(iterationBudget, load, adjustedQuality, wave_is_overloaded(adjustedQuality, load));
+    }
+
+    int i = texel - 1;
+    if (i >= iterationBudget)
+    {
+        return vec4(0.0);
+    }
+
+    float edge_x;
+    float edge_y;
+    float distance_x;
+    float distance_y;
+    float perpendicular_dx;
+    float perpendicular_dy;
+    clip_waveform_edges(0.0, wave_x, wave_y, float(sample_count), WAVE_MODE_HINT, edge_x, edge_y,
+                        distance_x, distance_y, perpendicular_dx, perpendicular_dy);
+
+    float displacement1 = wave_sample(audio, i, sample_count).x;
+    float displacement2 = wave_sample(audio, i + 1, sample_count).x;
+    vec2 p1 = wave_mode_line_vertex(edge_x, edge_y, distance_x, distance_y,
+                                    perpendicular_dx, perpendicular_dy, float(i), displacement1, wave_scale);
+    vec2 p2 = wave_mode_line_vertex(edge_x, edge_y, distance_x, distance_y,
+                                    perpendicular_dx, perpendicular_dy, float(i + 1), displacement2, wave_scale);
+    return vec4(p1, p2);
+}
+)___";
+    }
 };
 
 class ExplosiveHashRenderer final : public WaveModeRenderer {
@@ -358,7 +549,7 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
 
     for (int i = 0; i < iterationBudget; ++i)
     {
-        float displacement = (i % 2 == 0) ? audio.x : audio.y;
+        float displacement = wave_sample(audio, i, sample_count).x;
         float t = float(i) / max(sample_count_f, 1.0);
         float angle = wave_mystery + WAVE_TWO_PI * t;
         float radius = clamp(0.5 + 0.5 * displacement * wave_scale, 0.0, 2.0);
@@ -382,6 +573,48 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
     std::string callPattern() const override {
         return R"___(draw_wave(pixelUV, iAudioBands.xy, 128, wave_x, wave_y, wave_mystery, wave_quality))___";
     }
+    std::string geometryFunction() const override {
+        return R"___(
+// Mode 5 geometry: one radial dot per texel, softness in z
+vec4 wave_geometry_texel(int texel, vec2 audio_data, int samples, float wave_x, float wave_y, float wave_mystery, float wave_quality)
+{
+    const float WAVE_MODE_HINT = 5.0;
+    float epsilon = wave_select_epsilon(WAVE_MODE_HINT);
+
+    vec2 audio = wave_clamp_audio(audio_data);
+    vec2 center = vec2(wave_x, wave_y);
+    vec2 aspect = wave_aspect();
+    float wave_scale = 0.25;
+
+    int raw_samples = max(samples / 2, 1);
+    int sample_count = max(min(raw_samples, MODE5_MAX_WAVE_ITERATIONS), 1);
+    float sample_count_f = float(sample_count);
+
+    float load = wave_estimate_load(sample_count, 0.012);
+    float adjustedQuality = wave_adjust_quality(wave_quality, load);
+    int iterationBudget = wave_iteration_budget(sample_count, adjustedQuality);
+    if (texel == 0)
+    {
+        return wave_geometry_header(iterationBudget, load, adjustedQuality, wave_is_overloaded(adjustedQuality, load));
+    }
+
+    int i = texel - 1;
+    if (i >= iterationBudget)
+    {
+        return vec4(0.0);
+    }
+    float displacement = wave_sample(audio, i, sample_count).x;
+    float t = float(i) / max(sample_count_f, 1.0);
+    float angle = wave_mystery + WAVE_TWO_PI * t;
+    float radius = clamp(0.5 + 0.5 * displacement * wave_scale, 0.0, 2.0);
+    return vec4(wave_mode5_vertex(radius, angle, center, aspect), max(0.008, epsilon * 8.0), 0.0);
+}
+)___";
+    }
+
+    bool pointPrimitives() const override {
+        return true;
+    }
 };
 
 class LineWaveRenderer final : public WaveModeRenderer {
@@ -453,8 +686,8 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
 
     for (int i = 0; i < iterationBudget; ++i)
     {
-        float displacement1 = (i % 2 == 0) ? audio.x : audio.y;
-        float displacement2 = ((i + 1) % 2 == 0) ? audio.x : audio.y;
+        float displacement1 = wave_sample(audio, i, sample_count).x;
+        float displacement2 = wave_sample(audio, i + 1, sample_count).x;
         vec2 p1 = wave_mode6_vertex(edge_x, edge_y, distance_x, distance_y,
                                     perpendicular_dx, perpendicular_dy, float(i), displacement1, wave_scale);
         vec2 p2 = wave_mode6_vertex(edge_x, edge_y, distance_x, distance_y,
@@ -477,6 +710,59 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
     std::string callPattern() const override {
         return R"___(draw_wave(pixelUV, iAudioBands.xy, 128, wave_x, wave_y, wave_mystery, wave_quality))___";
     }
+    std::string geometryFunction() const override {
+        return R"___(
+// Mode 6 geometry: one line segment per texel
+vec4 wave_geometry_texel(int texel, vec2 audio_data, int samples, float wave_x, float wave_y, float wave_mystery, float wave_quality)
+{
+    const float WAVE_MODE_HINT = 6.0;
+    float angleLimit;
+    float distanceClamp;
+    float epsilon;
+    wave_resolve_mode(WAVE_MODE_HINT, angleLimit, distanceClamp, epsilon);
+
+    vec2 audio = wave_clamp_audio(audio_data);
+    float wave_scale = 0.25;
+
+    int raw_samples = max(samples / 2, 2);
+    int sample_count = min(raw_samples, MODE6_MAX_WAVE_ITERATIONS + 1);
+    int segment_count = max(sample_count - 1, 1);
+
+    float orientation = clamp(1.57 + clamp(wave_mystery, -1.0, 1.0), -angleLimit, angleLimit);
+
+    float load = wave_estimate_load(segment_count, 0.01);
+    float adjustedQuality = wave_adjust_quality(wave_quality, load);
+    int iterationBudget = wave_iteration_budget(segment_count, adjustedQuality);
+    if (texel == 0)
+    {
+        return wave_geometry_header(iterationBudget, load, adjustedQuality, wave_is_overloaded(adjustedQuality, load));
+    }
+
+    int i = texel - 1;
+    if (i >= iterationBudget)
+    {
+        return vec4(0.0);
+    }
+
+    float edge_x;
+    float edge_y;
+    float distance_x;
+    float distance_y;
+    float perpendicular_dx;
+    float perpendicular_dy;
+    clip_waveform_edges(orientation, wave_x, wave_y, float(sample_count), WAVE_MODE_HINT, edge_x, edge_y,
+                        distance_x, distance_y, perpendicular_dx, perpendicular_dy);
+
+    float displacement1 = wave_sample(audio, i, sample_count).x;
+    float displacement2 = wave_sample(audio, i + 1, sample_count).x;
+    vec2 p1 = wave_mode6_vertex(edge_x, edge_y, distance_x, distance_y,
+                                perpendicular_dx, perpendicular_dy, float(i), displacement1, wave_scale);
+    vec2 p2 = wave_mode6_vertex(edge_x, edge_y, distance_x, distance_y,
+                                perpendicular_dx, perpendicular_dy, float(i + 1), displacement2, wave_scale);
+    return vec4(p1, p2);
+}
+)___";
+    }
 };
 
 class DoubleLineWaveRenderer final : public WaveModeRenderer {
@@ -551,17 +837,17 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
     for (int i = 0; i < iterationBudget; ++i)
     {
         vec2 p1L = wave_mode7_vertex(edge_x, edge_y, distance_x, distance_y,
-                                     perpendicular_dx, perpendicular_dy, float(i), audio.x, wave_scale, separation);
+                                     perpendicular_dx, perpendicular_dy, float(i), wave_sample_stereo(audio, i, sample_count).x, wave_scale, separation);
         vec2 p2L = wave_mode7_vertex(edge_x, edge_y, distance_x, distance_y,
-                                     perpendicular_dx, perpendicular_dy, float(i + 1), audio.x, wave_scale, separation);
+                                     perpendicular_dx, perpendicular_dy, float(i + 1), wave_sample_stereo(audio, i + 1, sample_count).x, wave_scale, separation);
         float distL = wave_distance_to_segment(uv, p1L, p2L, distanceClamp, epsilon);
         float contributionL = wave_contribution(distL, 0.01);
         intensity += contributionL;
 
         vec2 p1R = wave_mode7_vertex(edge_x, edge_y, distance_x, distance_y,
-                                     perpendicular_dx, perpendicular_dy, float(i), audio.y, wave_scale, -separation);
+                                     perpendicular_dx, perpendicular_dy, float(i), wave_sample_stereo(audio, i, sample_count).y, wave_scale, -separation);
         vec2 p2R = wave_mode7_vertex(edge_x, edge_y, distance_x, distance_y,
-                                     perpendicular_dx, perpendicular_dy, float(i + 1), audio.y, wave_scale, -separation);
+                                     perpendicular_dx, perpendicular_dy, float(i + 1), wave_sample_stereo(audio, i + 1, sample_count).y, wave_scale, -separation);
         float distR = wave_distance_to_segment(uv, p1R, p2R, distanceClamp, epsilon);
         float contributionR = wave_contribution(distR, 0.01);
         intensity += contributionR;
@@ -581,6 +867,68 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
     std::string callPattern() const override {
         return R"___(draw_wave(pixelUV, iAudioBands.xy, 128, wave_x, wave_y, wave_mystery, wave_quality))___";
     }
+    std::string geometryFunction() const override {
+        return R"___(
+// Mode 7 geometry: texels alternate between the left and right line of each iteration
+vec4 wave_geometry_texel(int texel, vec2 audio_data, int samples, float wave_x, float wave_y, float wave_mystery, float wave_quality)
+{
+    const float WAVE_MODE_HINT = 7.0;
+    float angleLimit;
+    float distanceClamp;
+    float epsilon;
+    wave_resolve_mode(WAVE_MODE_HINT, angleLimit, distanceClamp, epsilon);
+
+    vec2 audio = wave_clamp_audio(audio_data);
+    float wave_scale = 0.25;
+
+    int raw_samples = max(samples / 2, 2);
+    int sample_count = min(raw_samples, MODE7_MAX_WAVE_ITERATIONS + 1);
+    int segment_count = max(sample_count - 1, 1);
+
+    float orientation = clamp(1.57 * max(wave_mystery, 0.1), -angleLimit, angleLimit);
+
+    float load = wave_estimate_load(segment_count, 0.01);
+    float adjustedQuality = wave_adjust_quality(wave_quality, load);
+    int iterationBudget = wave_iteration_budget(segment_count, adjustedQuality);
+    if (texel == 0)
+    {
+        return wave_geometry_header(iterationBudget * 2, load, adjustedQuality, wave_is_overloaded(adjustedQuality, load));
+    }
+
+    int i = (texel - 1) / 2;
+    if (i >= iterationBudget)
+    {
+        return vec4(0.0);
+    }
+
+    float edge_x;
+    float edge_y;
+    float distance_x;
+    float distance_y;
+    float perpendicular_dx;
+    float perpendicular_dy;
+    clip_waveform_edges(orientation, wave_x, wave_y, float(sample_count), WAVE_MODE_HINT, edge_x, edge_y,
+                        distance_x, distance_y, perpendicular_dx, perpendicular_dy);
+
+    float separation = pow(clamp(wave_y * 0.5 + 0.5, 0.0, 1.0), 2.0);
+    bool right = ((texel - 1) % 2) == 1;
+    vec2 sample1 = wave_sample_stereo(audio, i, sample_count);
+    vec2 sample2 = wave_sample_stereo(audio, i + 1, sample_count);
+    float displacement1 = right ? sample1.y : sample1.x;
+    float displacement2 = right ? sample2.y : sample2.x;
+    float offset = right ? -separation : separation;
+    vec2 p1 = wave_mode7_vertex(edge_x, edge_y, distance_x, distance_y,
+                                perpendicular_dx, perpendicular_dy, float(i), displacement1, wave_scale, offset);
+    vec2 p2 = wave_mode7_vertex(edge_x, edge_y, distance_x, distance_y,
+                                perpendicular_dx, perpendicular_dy, float(i + 1), displacement2, wave_scale, offset);
+    return vec4(p1, p2);
+}
+)___";
+    }
+
+    int primitivesPerIteration() const override {
+        return 2;
+    }
 };
 
 class SpectrumLineRenderer final : public WaveModeRenderer {
@@ -651,8 +999,8 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
 
     for (int i = 0; i < iterationBudget; ++i)
     {
-        float displacement1 = (i % 2 == 0) ? audio.x : audio.y;
-        float displacement2 = ((i + 1) % 2 == 0) ? audio.x : audio.y;
+        float displacement1 = wave_spectrum(audio, i, sample_count).x;
+        float displacement2 = wave_spectrum(audio, i + 1, sample_count).x;
         vec2 p1 = wave_mode8_vertex(edge_x, edge_y, distance_x, distance_y,
                                     perpendicular_dx, perpendicular_dy, float(i), displacement1);
         vec2 p2 = wave_mode8_vertex(edge_x, edge_y, distance_x, distance_y,
@@ -675,40 +1023,381 @@ float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_
     std::string callPattern() const override {
         return R"___(draw_wave(pixelUV, iAudioBands.xy, 128, wave_x, wave_y, wave_mystery, wave_quality))___";
     }
-};
+    std::string geometryFunction() const override {
+        return R"___(
+// Mode 8 geometry: one spectrum segment per texel
+vec4 wave_geometry_texel(int texel, vec2 audio_data, int samples, float wave_x, float wave_y, float wave_mystery, float wave_quality)
+{
+    const float WAVE_MODE_HINT = 8.0;
+    float angleLimit;
+    float distanceClamp;
+    float epsilon;
+    wave_resolve_mode(WAVE_MODE_HINT, angleLimit, distanceClamp, epsilon);
 
-} // namespace
+    vec2 audio = wave_clamp_audio(audio_data);
 
-std::string WaveModeRenderer::helperFunctions() const
-{
-    return generateCommonHelpers();
-}
+    int raw_samples = max(min(samples, 256), 2);
+    int sample_count = min(raw_samples, MODE8_MAX_WAVE_ITERATIONS + 1);
+    int segment_count = max(sample_count - 1, 1);
 
-std::string WaveModeRenderer::generateWaveformGLSL(int nWaveMode, const std::map<std::string, std::string>& presetValues)
-{
-    (void)presetValues;
+    float orientation = clamp(1.57 * max(wave_mystery, 0.1), -angleLimit, angleLimit);
 
-    auto renderer = create(nWaveMode, presetValues);
-    if (!renderer)
+    float load = wave_estimate_load(segment_count, 0.01);
+    float adjustedQuality = wave_adjust_quality(wave_quality, load);
+    int iterationBudget = wave_iteration_budget(segment_count, adjustedQuality);
+    if (texel == 0)
     {
-        return generateCommonHelpers() + generateFallback();
+        return wave_geometry_header(iterationBudget, load, adjustedQuality, wave_is_overloaded(adjustedQuality, load));
     }
 
-    std::string glsl = renderer->helperFunctions();
-    glsl += renderer->vertexFunction();
-    glsl += renderer->drawFunction();
-    return glsl;
-}
-
+    int i = texel - 1;
+    if (i >= iterationBudget)
+    {
+        return vec4(0.0);
+    }
+
+    float edge_x;
+    float edge_y;
+    float distance_x;
+    float distance_y;
+    float perpendicular_dx;
+    float perpendicular_dy;
+    clip_waveform_edges(orientation, wave_x, wave_y, float(sample_count), WAVE_MODE_HINT, edge_x, edge_y,
+                        distance_x, distance_y, perpendicular_dx, perpendicular_dy);
+
+    float displacement1 = wave_spectrum(audio, i, sample_count).x;
+    float displacement2 = wave_spectrum(audio, i + 1, sample_count).x;
+    vec2 p1 = wave_mode8_vertex(edge_x, edge_y, distance_x, distance_y,
+                                perpendicular_dx, perpendicular_dy, float(i), displacement1);
+    vec2 p2 = wave_mode8_vertex(edge_x, edge_y, distance_x, distance_y,
+                                perpendicular_dx, perpendicular_dy, float(i + 1), displacement2);
+    return vec4(p1, p2);
+}
+)___";
+    }
+};
+
+// Mode thresholds of the wave_select_* helpers: the first range whose bound the mode is below
+// picks the constant, otherwise the fallback does. Both the GLSL helpers in
+// generateCommonHelpers() and their conversion-time values come from this table.
+struct ModeSelector {
+    const char* function;
+    std::vector<std::pair<double, const char*>> ranges;
+    const char* fallback;
+};
+
+const std::vector<ModeSelector>& modeSelectors()
+{
+    static const std::vector<ModeSelector> selectors = {
+        {"wave_select_angle_limit", {{3.5, "WAVE_MAX_ANGLE_RADIAL"}, {6.5, "WAVE_MAX_ANGLE_LINE"}}, "WAVE_MAX_ANGLE_SPECTRUM"},
+        {"wave_select_distance_clamp", {{3.5, "WAVE_DISTANCE_CLAMP_RADIAL"}, {6.5, "WAVE_DISTANCE_CLAMP_LINE"}},
+         "WAVE_DISTANCE_CLAMP_BASE"},
+        {"wave_select_epsilon", {{6.5, "WAVE_EPSILON_FINE"}}, "WAVE_EPSILON_BASE"},
+    };
+    return selectors;
+}
+
+std::string resolveModeSelector(const std::string& function, double modeId)
+{
+    for (const ModeSelector& selector : modeSelectors())
+    {
+        if (function != selector.function)
+        {
+            continue;
+        }
+        for (const auto& range : selector.ranges)
+        {
+            if (modeId < range.first)
+            {
+                return range.second;
+            }
+        }
+        return selector.fallback;
+    }
+    return "";
+}
+
+std::string modeSelectorFunctions()
+{
+    std::string glsl;
+    for (const ModeSelector& selector : modeSelectors())
+    {
+        glsl += "float " + std::string(selector.function) + "(float modeId)\n{\n";
+        for (const auto& range : selector.ranges)
+        {
+            std::string bound = std::to_string(range.first);
+            bound.erase(bound.find_last_not_of('0') + 1);
+            glsl += "    if (modeId < " + bound + ") { return " + range.second + "; }\n";
+        }
+        glsl += "    return " + std::string(selector.fallback) + ";\n}\n\n";
+    }
+    return glsl;
+}
+
+// Lowers the MODE<n>_MAX_WAVE_ITERATIONS constants of a snippet generated with the default
+// caps, and WAVE_GEOMETRY_PRIMITIVES with them. The caps are only read through these
+// constants, so the result matches a snippet generated with @p iterationCap.
+std::string applyIterationCap(std::string glsl, int nWaveMode, int iterationCap)
+{
+    if (iterationCap <= 0)
+    {
+        return glsl;
+    }
+    auto lower = [&](const std::string& name, int limit) {
+        const std::string prefix = "const int " + name + " = ";
+        const size_t start = glsl.find(prefix);
+        if (start == std::string::npos)
+        {
+            return;
+        }
+        const size_t value = start + prefix.size();
+        const size_t end = glsl.find(';', value);
+        const int current = std::stoi(glsl.substr(value, end - value));
+        glsl.replace(value, end - value, std::to_string(std::min(current, limit)));
+    };
+    for (int mode : {0, 2, 3, 4, 5, 6, 7, 8})
+    {
+        lower("MODE" + std::to_string(mode) + "_MAX_WAVE_ITERATIONS", iterationCap);
+    }
+    const int defaultCap = WaveModeRenderer::defaultIterationCap(nWaveMode);
+    if (defaultCap > iterationCap)
+    {
+        // Primitives per iteration times the cap; lowering keeps the multiple.
+        const std::string prefix = "const int WAVE_GEOMETRY_PRIMITIVES = ";
+        const size_t start = glsl.find(prefix);
+        if (start != std::string::npos)
+        {
+            const size_t value = start + prefix.size();
+            const size_t end = glsl.find(';', value);
+            const int primitives = std::stoi(glsl.substr(value, end - value)) / defaultCap * iterationCap;
+            glsl.replace(value, end - value, std::to_string(primitives));
+        }
+    }
+    return glsl;
+}
+
+struct SpecializationCache {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::string> entries;
+};
+
+SpecializationCache& specializationCache()
+{
+    static SpecializationCache cache;
+    return cache;
+}
+
+// Specializes the snippet from @p generate for its mode and strips what @p roots do
+// not reach. Renderers do not read preset values, so the result depends only on the
+// mode and budget. It is memoized without the iteration cap, which is applied to the
+// cached snippet, so each --max-cost search step reuses the same specialization.
+std::string specialized(const char* kind, int nWaveMode, const WaveBudget& budget, const std::vector<std::string>& roots,
+                        const std::function<std::string(const WaveBudget&)>& generate)
+{
+    SpecializationCache& cache = specializationCache();
+    std::string key = std::string(kind) + ":" + std::to_string(nWaveMode) + (budget.binned ? ":binned" : "") +
+                      (budget.audioTexture ? ":audio" : "");
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        auto it = cache.entries.find(key);
+        if (it != cache.entries.end())
+        {
+            return applyIterationCap(it->second, nWaveMode, budget.iterationCap);
+        }
+    }
+
+    WaveBudget uncapped = budget;
+    uncapped.iterationCap = 0;
+    std::string glsl = ShaderSpecializer::specialize(generate(uncapped), roots, resolveModeSelector);
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    return applyIterationCap(cache.entries.emplace(std::move(key), std::move(glsl)).first->second, nWaveMode,
+                             budget.iterationCap);
+}
+
+} // namespace
+
+void WaveModeRenderer::clearSpecializations()
+{
+    SpecializationCache& cache = specializationCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.entries.clear();
+}
+
+std::string WaveModeRenderer::helperFunctions() const
+{
+    return generateCommonHelpers(m_budget.iterationCap) + generateAudioSampling(m_budget.audioTexture);
+}
+
+std::string WaveModeRenderer::generateWaveformGLSL(int nWaveMode, const std::map<std::string, std::string>& presetValues)
+{
+    return generateWaveformGLSL(nWaveMode, presetValues, WaveBudget{});
+}
+
+std::string WaveModeRenderer::generateWaveformGLSL(int nWaveMode, const std::map<std::string, std::string>& presetValues,
+                                                   const WaveBudget& budget)
+{
+    if (budget.lowResolution)
+    {
+        return generateFieldSampler();
+    }
+    auto renderer = create(nWaveMode, presetValues);
+    return specialized("wave", renderer ? nWaveMode : -1, budget, {"draw_wave", "draw_wave_binned"},
+                       [&](const WaveBudget& uncapped) {
+        if (!renderer)
+        {
+            return generateCommonHelpers() + generateFallback();
+        }
+        renderer->m_budget = uncapped;
+
+        std::string glsl = renderer->helperFunctions();
+        if (uncapped.binned)
+        {
+            return glsl + generateGeometryHelpers() + renderer->binnedDrawFunction(nWaveMode);
+        }
+        glsl += renderer->vertexFunction();
+        glsl += renderer->drawFunction();
+        return glsl;
+    });
+}
+
 std::string WaveModeRenderer::generateCallPattern(int nWaveMode, const std::map<std::string, std::string>& presetValues)
 {
+    return generateCallPattern(nWaveMode, presetValues, WaveBudget{});
+}
+
+std::string WaveModeRenderer::generateCallPattern(int nWaveMode, const std::map<std::string, std::string>& presetValues,
+                                                  const WaveBudget& budget)
+{
+    if (budget.lowResolution)
+    {
+        return "wave_sample_field(pixelUV)";
+    }
     auto renderer = create(nWaveMode, presetValues);
     if (!renderer)
     {
         return R"___(draw_wave(pixelUV, iAudioBands.xy, 128, wave_x, wave_y, wave_mystery, wave_quality))___";
     }
 
-    return renderer->callPattern();
+    std::string call = renderer->callPattern();
+    if (budget.binned)
+    {
+        call.replace(call.find("draw_wave("), 10, "draw_wave_binned(");
+    }
+    return call;
+}
+
+std::string WaveModeRenderer::generateGeometryGLSL(int nWaveMode, const std::map<std::string, std::string>& presetValues,
+                                                   const WaveBudget& budget)
+{
+    auto renderer = create(nWaveMode, presetValues);
+    if (!renderer)
+    {
+        return "";
+    }
+    return specialized("geometry", nWaveMode, budget, {"wave_geometry_texel"}, [&](const WaveBudget& uncapped) {
+        renderer->m_budget = uncapped;
+
+        std::string glsl = renderer->helperFunctions();
+        glsl += generateGeometryHelpers();
+        glsl += renderer->vertexFunction();
+        glsl += renderer->geometryFunction();
+        return glsl;
+    });
+}
+
+std::string WaveModeRenderer::generateGeometryCall(int nWaveMode, const std::map<std::string, std::string>& presetValues)
+{
+    auto renderer = create(nWaveMode, presetValues);
+    if (!renderer)
+    {
+        return "";
+    }
+
+    std::string call = renderer->callPattern();
+    call.replace(call.find("draw_wave(pixelUV"), 17, "wave_geometry_texel(int(gl_FragCoord.x)");
+    return call;
+}
+
+std::string WaveModeRenderer::generateBinPass(int nWaveMode, const std::map<std::string, std::string>& presetValues)
+{
+    auto renderer = create(nWaveMode, presetValues);
+    if (!renderer)
+    {
+        return "";
+    }
+
+    return specialized("bins", nWaveMode, WaveBudget{}, {"main"}, [&](const WaveBudget&) {
+        std::string glsl = "#version 330 core\n\n";
+        glsl += "out vec4 FragColor;\n\n";
+        glsl += "// Wave geometry from the previous pass\n";
+        glsl += "uniform sampler2D iWaveGeometry;\n";
+        glsl += generateCommonHelpers();
+        glsl += generateGeometryHelpers();
+
+        // Conservative bounds: wave_contribution() is exactly zero beyond reach, and
+        // wave_distance_to_segment() never looks past the clamped segment end.
+        glsl += "\nvec4 wave_primitive_bounds(vec4 primitive, float distanceClamp)\n{\n";
+        if (renderer->pointPrimitives())
+        {
+            glsl += "    float reach = wave_contribution_reach(primitive.z);\n";
+            glsl += "    return vec4(primitive.xy - reach, primitive.xy + reach);\n";
+        }
+        else
+        {
+            glsl += "    vec2 end = primitive.xy + wave_clamp_vec(primitive.zw - primitive.xy, distanceClamp);\n";
+            glsl += "    float reach = wave_contribution_reach(WAVE_SEGMENT_SOFTNESS);\n";
+            glsl += "    return vec4(min(primitive.xy, end) - reach, max(primitive.xy, end) + reach);\n";
+        }
+        glsl += "}\n";
+
+        glsl += R"___(
+// One row per tile row, WAVE_BIN_STRIDE texels per tile: texel 0 holds (count, overflow),
+// the others four primitive indices each, in loop order.
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    int tileX = texel.x / WAVE_BIN_STRIDE;
+    int column = texel.x - tileX * WAVE_BIN_STRIDE;
+    vec2 tileMin = vec2(float(tileX), float(texel.y)) / float(WAVE_BIN_TILES);
+    vec2 tileMax = tileMin + vec2(1.0 / float(WAVE_BIN_TILES));
+)___";
+        glsl += "    float distanceClamp = wave_select_distance_clamp(" + std::to_string(nWaveMode) + ".0);\n";
+        glsl += R"___(
+    vec4 header = texelFetch(iWaveGeometry, ivec2(0, 0), 0);
+    int primitiveCount = header.w > 0.5 ? 0 : int(header.x);
+    int found = 0;
+    vec4 entries = vec4(-1.0);
+    for (int primitive = 0; primitive < WAVE_GEOMETRY_CAPACITY; ++primitive)
+    {
+        if (primitive >= primitiveCount)
+        {
+            break;
+        }
+        vec4 bounds = wave_primitive_bounds(texelFetch(iWaveGeometry, ivec2(primitive + 1, 0), 0), distanceClamp);
+        if (any(greaterThan(bounds.xy, tileMax)) || any(lessThan(bounds.zw, tileMin)))
+        {
+            continue;
+        }
+        int slot = found - (column - 1) * 4;
+        if (slot >= 0 && slot < 4)
+        {
+            entries[slot] = float(primitive);
+        }
+        ++found;
+    }
+
+    if (column == 0)
+    {
+        FragColor = vec4(float(min(found, WAVE_BIN_SLOTS)), found > WAVE_BIN_SLOTS ? 1.0 : 0.0, 0.0, 0.0);
+    }
+    else
+    {
+        FragColor = entries;
+    }
+}
+)___";
+        return glsl;
+    });
 }
 
 std::unique_ptr<WaveModeRenderer> WaveModeRenderer::create(int nWaveMode, const std::map<std::string, std::string>& presetValues)
@@ -736,9 +1425,28 @@ std::unique_ptr<WaveModeRenderer> WaveModeRenderer::create(int nWaveMode, const
     }
 }
 
-std::string WaveModeRenderer::generateCommonHelpers()
+int WaveModeRenderer::defaultIterationCap(int nWaveMode)
 {
-    return R"___(
+    switch (nWaveMode)
+    {
+        case 0:
+        case 2:
+        case 3:
+        case 5:
+        case 7:
+            return 48;
+        case 4:
+        case 6:
+        case 8:
+            return 64;
+        default:
+            return 0;
+    }
+}
+
+std::string WaveModeRenderer::generateCommonHelpers(int iterationCap)
+{
+    std::string glsl = R"___(
 const float WAVE_EPSILON_BASE = 1e-5;
 const float WAVE_EPSILON_FINE = 2.5e-6;
 const float WAVE_INTENSITY_CUTOFF = 1e-4;
@@ -754,17 +1462,20 @@ const float WAVE_TWO_PI = 6.28318530718;
 const float WAVE_PI = 3.14159265359;
 const float WAVE_TRIG_TAYLOR_THRESHOLD = 0.78539816339;
 const float WAVE_TRIG_EXTREME_THRESHOLD = 1024.0;
-const int WAVE_MIN_WARMUP_ITERATIONS = 4;
+)___";
+    glsl += "const int WAVE_MIN_WARMUP_ITERATIONS = " + std::to_string(kMinWarmupIterations) + ";\n\n";
 
-const int MODE0_MAX_WAVE_ITERATIONS = 48;
-const int MODE2_MAX_WAVE_ITERATIONS = 48;
-const int MODE3_MAX_WAVE_ITERATIONS = 48;
-const int MODE4_MAX_WAVE_ITERATIONS = 64;
-const int MODE5_MAX_WAVE_ITERATIONS = 48;
-const int MODE6_MAX_WAVE_ITERATIONS = 64;
-const int MODE7_MAX_WAVE_ITERATIONS = 48;
-const int MODE8_MAX_WAVE_ITERATIONS = 64;
+    for (int mode : {0, 2, 3, 4, 5, 6, 7, 8})
+    {
+        int cap = defaultIterationCap(mode);
+        if (iterationCap > 0)
+        {
+            cap = std::min(cap, iterationCap);
+        }
+        glsl += "const int MODE" + std::to_string(mode) + "_MAX_WAVE_ITERATIONS = " + std::to_string(cap) + ";\n";
+    }
 
+    glsl += R"___(
 const int WAVE_SEGMENT_SCAN_LIMIT = 6;
 
 const float WAVE_AUDIO_SENSITIVITY = 1.35;
@@ -786,28 +1497,9 @@ vec2 wave_aspect()
     return vec2(1.0, 1.0);
 }
 
-float wave_select_angle_limit(float modeId)
-{
-    if (modeId < 0.5) { return WAVE_MAX_ANGLE_RADIAL; }
-    if (modeId < 3.5) { return WAVE_MAX_ANGLE_RADIAL; }
-    if (modeId < 6.5) { return WAVE_MAX_ANGLE_LINE; }
-    return WAVE_MAX_ANGLE_SPECTRUM;
-}
-
-float wave_select_distance_clamp(float modeId)
-{
-    if (modeId < 0.5) { return WAVE_DISTANCE_CLAMP_RADIAL; }
-    if (modeId < 3.5) { return WAVE_DISTANCE_CLAMP_RADIAL; }
-    if (modeId < 6.5) { return WAVE_DISTANCE_CLAMP_LINE; }
-    return WAVE_DISTANCE_CLAMP_BASE;
-}
-
-float wave_select_epsilon(float modeId)
-{
-    return modeId < 6.5 ? WAVE_EPSILON_FINE : WAVE_EPSILON_BASE;
-}
-
-void wave_resolve_mode(float modeId, out float angleLimit, out float distanceClamp, out float epsilon)
+)___";
+    glsl += modeSelectorFunctions();
+    glsl += R"___(void wave_resolve_mode(float modeId, out float angleLimit, out float distanceClamp, out float epsilon)
 {
     angleLimit = wave_select_angle_limit(modeId);
     distanceClamp = wave_select_distance_clamp(modeId);
@@ -828,11 +1520,6 @@ vec2 wave_sin_cos_poly(float angle)
     return vec2(sinPoly, cosPoly);
 }
 
-vec2 wave_sin_cos_safe(float angle)
-{
-    return wave_sin_cos_safe(angle, -1.0);
-}
-
 vec2 wave_sin_cos_safe(float angle, float modeId)
 {
     float limit = modeId < -0.5 ? WAVE_MAX_ANGLE_BASE : wave_select_angle_limit(modeId);
@@ -847,19 +1534,19 @@ vec2 wave_sin_cos_safe(float angle, float modeId)
     return result;
 }
 
-float wave_safe_sin(float angle)
+vec2 wave_sin_cos_safe(float angle)
 {
-    return wave_safe_sin(angle, -1.0);
+    return wave_sin_cos_safe(angle, -1.0);
 }
 
-float wave_safe_cos(float angle)
+float wave_safe_sin(float angle, float modeId)
 {
-    return wave_safe_cos(angle, -1.0);
+    return wave_sin_cos_safe(angle, modeId).x;
 }
 
-float wave_safe_sin(float angle, float modeId)
+float wave_safe_sin(float angle)
 {
-    return wave_sin_cos_safe(angle, modeId).x;
+    return wave_safe_sin(angle, -1.0);
 }
 
 float wave_safe_cos(float angle, float modeId)
@@ -867,6 +1554,11 @@ float wave_safe_cos(float angle, float modeId)
     return wave_sin_cos_safe(angle, modeId).y;
 }
 
+float wave_safe_cos(float angle)
+{
+    return wave_safe_cos(angle, -1.0);
+}
+
 vec2 wave_clamp_vec(vec2 value, float limit)
 {
     return clamp(value, vec2(-limit), vec2(limit));
@@ -927,11 +1619,6 @@ float wave_contribution(float distance, float softness)
     return 1.0 - smoothstep(0.0, safeSoftness, clampedDistance);
 }
 
-float wave_distance_to_segment(vec2 p, vec2 v, vec2 w)
-{
-    return wave_distance_to_segment(p, v, w, WAVE_DISTANCE_CLAMP_BASE, WAVE_EPSILON_BASE);
-}
-
 float wave_distance_to_segment(vec2 p, vec2 v, vec2 w, float clampLimit, float epsilon)
 {
     vec2 diff = wave_clamp_vec(w - v, clampLimit);
@@ -962,9 +1649,9 @@ float wave_distance_to_segment(vec2 p, vec2 v, vec2 w, float clampLimit, float e
     return min(minDistance, projectionDistance);
 }
 
-float wave_safe_divide(float numerator, float denominator)
+float wave_distance_to_segment(vec2 p, vec2 v, vec2 w)
 {
-    return wave_safe_divide(numerator, denominator, WAVE_EPSILON_BASE);
+    return wave_distance_to_segment(p, v, w, WAVE_DISTANCE_CLAMP_BASE, WAVE_EPSILON_BASE);
 }
 
 float wave_safe_divide(float numerator, float denominator, float epsilon)
@@ -975,6 +1662,11 @@ float wave_safe_divide(float numerator, float denominator, float epsilon)
     return numerator / denom;
 }
 
+float wave_safe_divide(float numerator, float denominator)
+{
+    return wave_safe_divide(numerator, denominator, WAVE_EPSILON_BASE);
+}
+
 float wave_fast_tanh(float x)
 {
     float e2x = exp(-2.0 * abs(x));
@@ -1184,6 +1876,7 @@ void clip_waveform_edges(float angle, float wave_x, float wave_y, float sample_c
     perpendicular_dy = wave_safe_sin(angle2 + 1.57, modeId);
 }
 )___";
+    return glsl;
 }
 
 std::string WaveModeRenderer::generateFallback()
@@ -1192,18 +1885,218 @@ std::string WaveModeRenderer::generateFallback()
 // Fallback waveform renderer when the mode is unsupported
 float draw_wave(vec2 uv, vec2 audio_data, int samples, float wave_x, float wave_y, float wave_mystery, float wave_quality)
 {
-    (void)uv;
-    (void)audio_data;
-    (void)samples;
-    (void)wave_x;
-    (void)wave_y;
-    (void)wave_mystery;
-    (void)wave_quality;
     return 0.0;
 }
 )___";
 }
 
+std::string WaveModeRenderer::generateAudioSampling(bool texture)
+{
+    if (!texture)
+    {
+        return R"___(
+// Stand-in samples while no audio texture is bound: sample i alternates between
+// the left and right band levels.
+vec2 wave_sample(vec2 audio, int i, int count)
+{
+    return vec2((i % 2 == 0) ? audio.x : audio.y);
+}
+
+// Stereo stand-in: the left and right band levels for every sample.
+vec2 wave_sample_stereo(vec2 audio, int i, int count)
+{
+    return audio;
+}
+
+vec2 wave_spectrum(vec2 audio, int i, int count)
+{
+    return wave_sample(audio, i, count);
+}
+)___";
+    }
+
+    std::string glsl = R"___(
+// Packed audio (AudioTexturePacker): row 0 holds the aligned waveform, row 1 the spectrum,
+// left channel in .r and right in .g. Sample i of count spans the whole row.
+uniform sampler2D iAudioTexture;
+
+)___";
+    glsl += "const float WAVE_AUDIO_TEXTURE_WIDTH = " + std::to_string(kAudioTextureWidth) + ".0;\n";
+    glsl += "const float WAVE_AUDIO_WAVEFORM_SAMPLES = " + std::to_string(kAudioWaveformSamples) + ".0;\n";
+    glsl += R"___(
+vec2 wave_audio_row(int i, int count, float samples, float row)
+{
+    float t = clamp(float(i) / float(max(count - 1, 1)), 0.0, 1.0);
+    return texture(iAudioTexture, vec2((t * (samples - 1.0) + 0.5) / WAVE_AUDIO_TEXTURE_WIDTH, row)).rg;
+}
+
+vec2 wave_sample(vec2 audio, int i, int count)
+{
+    return clamp(wave_audio_row(i, count, WAVE_AUDIO_WAVEFORM_SAMPLES, 0.25), -1.0, 1.0);
+}
+
+vec2 wave_sample_stereo(vec2 audio, int i, int count)
+{
+    return wave_sample(audio, i, count);
+}
+
+vec2 wave_spectrum(vec2 audio, int i, int count)
+{
+    return wave_audio_row(i, count, WAVE_AUDIO_TEXTURE_WIDTH, 0.75);
+}
+)___";
+    return glsl;
+}
+
+std::string WaveModeRenderer::generateFieldSampler()
+{
+    return R"___(
+// Wave intensity rendered at reduced resolution by the wave_field pass. The
+// contribution falloff spans several field texels, so linear filtering rebuilds it.
+uniform sampler2D iWaveField;
+
+float wave_sample_field(vec2 uv)
+{
+    return texture(iWaveField, uv).r;
+}
+)___";
+}
+
+std::string WaveModeRenderer::generateGeometryHelpers()
+{
+    std::string glsl = "\n";
+    glsl += "const int WAVE_GEOMETRY_CAPACITY = " + std::to_string(kGeometryWidth - 1) + ";\n";
+    glsl += "const int WAVE_BIN_TILES = " + std::to_string(kBinTiles) + ";\n";
+    glsl += "const int WAVE_BIN_SLOTS = " + std::to_string(kBinSlots) + ";\n";
+    glsl += "const int WAVE_BIN_STRIDE = " + std::to_string(kBinStride) + ";\n";
+    glsl += R"___(const float WAVE_SEGMENT_SOFTNESS = 0.01;
+const float WAVE_BIN_MARGIN = 1e-4;
+
+// Geometry texel 0: (primitive count, load, adjusted quality, overloaded)
+vec4 wave_geometry_header(int primitiveCount, float load, float adjustedQuality, bool overloaded)
+{
+    return vec4(float(primitiveCount), load, adjustedQuality, overloaded ? 1.0 : 0.0);
+}
+
+// Distance beyond which wave_contribution() returns exactly zero.
+float wave_contribution_reach(float softness)
+{
+    return max(max(softness, WAVE_EPSILON_BASE) * 5.0, WAVE_DISTANCE_TOLERANCE * 0.5) + WAVE_BIN_MARGIN;
+}
+
+ivec2 wave_bin_tile(vec2 uv)
+{
+    return clamp(ivec2(floor(uv * float(WAVE_BIN_TILES))), ivec2(0), ivec2(WAVE_BIN_TILES - 1));
+}
+)___";
+    return glsl;
+}
+
+std::string WaveModeRenderer::waveParameters() const
+{
+    std::string params = "vec2 audio_data, int samples, float wave_x, float wave_y, float wave_mystery, ";
+    if (usesVolumeLevel())
+    {
+        params += "float volume_level, ";
+    }
+    return params + "float wave_quality";
+}
+
+std::string WaveModeRenderer::binnedDrawFunction(int nWaveMode) const
+{
+    const std::string modeHint = std::to_string(nWaveMode) + ".0";
+    const std::string contribution = pointPrimitives()
+        ? "wave_contribution(wave_safe_distance(uv, primitive.xy, distanceClamp), primitive.z)"
+        : "wave_contribution(wave_distance_to_segment(uv, primitive.xy, primitive.zw, distanceClamp, epsilon), WAVE_SEGMENT_SOFTNESS)";
+    // The loop caps keep the load below WAVE_COMPLEXITY_CRITICAL, so draw_wave() only
+    // overloads for wave_quality <= 0, where every mode picks its lowest-quality fallback.
+    const std::string fallback = nWaveMode == 4 ? "wave_fallback_bars" : "wave_fallback_dots";
+
+    std::string glsl = R"___(
+// Wave geometry and tile bins, rendered once per frame before this shader
+uniform sampler2D iWaveGeometry;
+uniform sampler2D iWaveBins;
+)___";
+    int cap = defaultIterationCap(nWaveMode);
+    if (m_budget.iterationCap > 0)
+    {
+        cap = std::min(cap, m_budget.iterationCap);
+    }
+    glsl += "\nconst int WAVE_PRIMITIVES_PER_ITERATION = " + std::to_string(primitivesPerIteration()) + ";\n";
+    glsl += "const int WAVE_GEOMETRY_PRIMITIVES = " + std::to_string(cap * primitivesPerIteration()) + ";\n";
+    glsl += R"___(
+// Binned waveform: tests only the primitives listed for this pixel's screen tile
+float draw_wave_binned(vec2 uv, )___" + waveParameters() + R"___()
+{
+)___";
+    glsl += "    const float WAVE_MODE_HINT = " + modeHint + ";\n";
+    glsl += R"___(    float angleLimit;
+    float distanceClamp;
+    float epsilon;
+    wave_resolve_mode(WAVE_MODE_HINT, angleLimit, distanceClamp, epsilon);
+
+    vec4 header = texelFetch(iWaveGeometry, ivec2(0, 0), 0);
+    float load = header.y;
+    float adjustedQuality = header.z;
+    float notice = wave_quality_notice(adjustedQuality, wave_quality);
+    if (header.w > 0.5)
+    {
+)___";
+    glsl += "        float fallback = " + fallback + "(uv, vec2(wave_x, wave_y), distanceClamp);\n";
+    glsl += R"___(        return wave_finalize_fallback(fallback, adjustedQuality, notice, load);
+    }
+
+    // An overflowing tile scans every primitive instead of its bin list.
+    ivec2 tile = wave_bin_tile(uv);
+    int binBase = tile.x * WAVE_BIN_STRIDE;
+    vec4 bin = texelFetch(iWaveBins, ivec2(binBase, tile.y), 0);
+    bool overflow = bin.y > 0.5;
+    int count = overflow ? int(header.x) : int(bin.x);
+
+    // Primitives arrive in loop order, so replaying the warm-up and early exit of
+    // draw_wave() gives the same sum: an iteration missing from the bin contributed zero.
+    float intensity = 0.0;
+    float iterationContribution = 0.0;
+    int currentIteration = -1;
+    int expectedIteration = WAVE_MIN_WARMUP_ITERATIONS;
+    for (int slot = 0; slot < WAVE_GEOMETRY_PRIMITIVES; ++slot)
+    {
+        if (slot >= count)
+        {
+            break;
+        }
+        int index = overflow ? slot : int(texelFetch(iWaveBins, ivec2(binBase + 1 + slot / 4, tile.y), 0)[slot % 4]);
+        int iteration = index / WAVE_PRIMITIVES_PER_ITERATION;
+        if (iteration != currentIteration)
+        {
+            if (currentIteration >= WAVE_MIN_WARMUP_ITERATIONS)
+            {
+                if (iterationContribution <= WAVE_INTENSITY_CUTOFF)
+                {
+                    break;
+                }
+                ++expectedIteration;
+            }
+            if (iteration >= WAVE_MIN_WARMUP_ITERATIONS && iteration != expectedIteration)
+            {
+                break;
+            }
+            currentIteration = iteration;
+            iterationContribution = 0.0;
+        }
+        vec4 primitive = texelFetch(iWaveGeometry, ivec2(index + 1, 0), 0);
+)___";
+    glsl += "        float contribution = " + contribution + ";\n";
+    glsl += R"___(        intensity += contribution;
+        iterationContribution += contribution;
+    }
+
+    return wave_apply_progressive(intensity + notice, load) * (0.8 + 0.2 * adjustedQuality);
+}
+)___";
+    return glsl;
+}
+
 float WaveModeRenderer::presetFloat(const std::string& key, float fallback) const
 {
     auto it = m_presetValues.find(key);
@@ -4,6 +4,19 @@
 #include <memory>
 #include <string>
 
+/**
+ * @brief Conversion-time limits applied to the emitted wave code.
+ *
+ * Used by the cost budget (--max-cost) to trade wave detail for fragment cost
+ * without touching the runtime quality heuristics.
+ */
+struct WaveBudget {
+    int iterationCap = 0;      ///< Upper bound for every MODE*_MAX_WAVE_ITERATIONS; 0 keeps the defaults.
+    bool binned = false;       ///< Read vertices and tile bins from the wave geometry passes (--wave-geometry).
+    bool lowResolution = false; ///< Sample the wave intensity rendered by the reduced-resolution field pass (--wave-lowres).
+    bool audioTexture = false; ///< Read wave samples from the packed iAudioTexture instead of the band levels (--audio-texture).
+};
+
 /**
  * @brief Abstract strategy for generating GLSL waveform rendering code.
  *
@@ -29,25 +42,95 @@ public:
     /// Generate the calling code pattern for this mode's draw_wave function.
     virtual std::string callPattern() const = 0;
 
+    /// Once-per-frame vertex evaluation for the geometry pass. Must declare wave_geometry_texel().
+    virtual std::string geometryFunction() const = 0;
+
+    /// True when the mode draws soft points rather than segments.
+    virtual bool pointPrimitives() const { return false; }
+
+    /// Primitives emitted per loop iteration (mode 7 draws two lines).
+    virtual int primitivesPerIteration() const { return 1; }
+
+    /// True when draw_wave takes the extra volume_level argument (mode 3).
+    virtual bool usesVolumeLevel() const { return false; }
+
     /// Generate the GLSL snippet for the requested wave mode.
     static std::string generateWaveformGLSL(int nWaveMode, const std::map<std::string, std::string>& presetValues);
+    static std::string generateWaveformGLSL(int nWaveMode, const std::map<std::string, std::string>& presetValues,
+                                            const WaveBudget& budget);
 
     /// Generate the draw_wave call pattern for the requested wave mode.
     static std::string generateCallPattern(int nWaveMode, const std::map<std::string, std::string>& presetValues);
+    static std::string generateCallPattern(int nWaveMode, const std::map<std::string, std::string>& presetValues,
+                                           const WaveBudget& budget);
+
+    /// Default per-mode loop cap (MODE<n>_MAX_WAVE_ITERATIONS), or 0 for unsupported modes.
+    static int defaultIterationCap(int nWaveMode);
+
+    /// Iterations every wave loop runs before it may exit early (WAVE_MIN_WARMUP_ITERATIONS);
+    /// also the lowest loop cap the cost budget applies.
+    static constexpr int kMinWarmupIterations = 4;
+
+    /// Helpers and wave_geometry_texel() for the geometry pass; empty for unsupported modes.
+    static std::string generateGeometryGLSL(int nWaveMode, const std::map<std::string, std::string>& presetValues,
+                                            const WaveBudget& budget);
+
+    /// Expression writing one geometry texel, evaluated after the per-frame code.
+    static std::string generateGeometryCall(int nWaveMode, const std::map<std::string, std::string>& presetValues);
+
+    /// Complete fragment shader building the tile bin texture from iWaveGeometry.
+    static std::string generateBinPass(int nWaveMode, const std::map<std::string, std::string>& presetValues);
+
+    /// Drops the per-process cache of mode-specialized snippets (used by cold-start benchmarks).
+    static void clearSpecializations();
+
+    /// iAudioTexture layout (see audio/AudioTexturePacker.hpp): 512x2, waveform in row 0, spectrum in row 1.
+    static constexpr int kAudioTextureWidth = 512;
+    static constexpr int kAudioWaveformSamples = 480;
+
+    /// Wave geometry texture: texel 0 is the frame header, texels 1.. hold one primitive each.
+    static constexpr int kGeometryWidth = 128;
+    static constexpr int kGeometryHeight = 1;
+    /// Screen tiles per axis and primitive slots per tile in the bin texture.
+    static constexpr int kBinTiles = 16;
+    static constexpr int kBinSlots = 32;
+    /// Texels per tile: a count/overflow header followed by four indices per texel.
+    static constexpr int kBinStride = 1 + kBinSlots / 4;
+    /// The wave field pass renders at the screen size divided by this on each axis.
+    static constexpr int kFieldDivisor = 2;
 
 protected:
     /// Factory method returning the appropriate renderer implementation.
     static std::unique_ptr<WaveModeRenderer> create(int nWaveMode, const std::map<std::string, std::string>& presetValues);
 
-    /// Shared helper functions available to all strategies.
-    static std::string generateCommonHelpers();
+    /// Shared helper functions available to all strategies; @p iterationCap lowers the loop caps.
+    static std::string generateCommonHelpers(int iterationCap = 0);
 
     /// Fallback GLSL when a mode is unsupported.
     static std::string generateFallback();
 
+    /// wave_sample(), wave_sample_stereo() and wave_spectrum(): per-sample audio for the draw loops,
+    /// read from iAudioTexture when @p texture is set and faked from the band levels otherwise.
+    static std::string generateAudioSampling(bool texture);
+
+    /// wave_sample_field(): bilinear reconstruction of the wave field pass output.
+    static std::string generateFieldSampler();
+
+    /// Layout constants and header packing shared by the geometry, bin and main shaders.
+    static std::string generateGeometryHelpers();
+
+    /// draw_wave_binned(): the tile-bin lookup used instead of draw_wave when the budget is binned.
+    std::string binnedDrawFunction(int nWaveMode) const;
+
+    /// Parameter list shared by draw_wave, draw_wave_binned and wave_geometry_texel (after the first).
+    std::string waveParameters() const;
+
     float presetFloat(const std::string& key, float fallback) const;
     int presetInt(const std::string& key, int fallback) const;
 
     /// Preset values for tuning parameters
     const std::map<std::string, std::string>& m_presetValues;
+
+    /// Limits requested by the caller of generateWaveformGLSL().
+    WaveBudget m_budget;
 };
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed set of worker threads that share out the indices of one job at a time.
+ *
+ * run() hands indices 0..count-1 to the workers through an atomic counter and returns when
+ * all of them are done; the calling thread takes part as worker 0. Which worker runs which
+ * index is not fixed, so tasks must only depend on the index for their output, and use the
+ * worker number only to pick scratch state (an eval context, a buffer) owned by that worker.
+ */
+class WorkerPool
+{
+public:
+    using Task = std::function<void(int index, int worker)>;
+
+    /// Starts @p threads - 1 helper threads; 0 uses one per hardware thread.
+    explicit WorkerPool(int threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// Runs @p task for every index in [0, count) and blocks until all have finished.
+    void run(int count, const Task& task);
+
+    int size() const { return static_cast<int>(m_threads.size()) + 1; }
+
+private:
+    void work(int worker);
+    void drain(int worker);
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const Task* m_task{nullptr};
+    int m_count{0};
+    std::atomic<int> m_next{0};
+    int m_busy{0};
+    uint64_t m_generation{0};
+    bool m_stop{false};
+};
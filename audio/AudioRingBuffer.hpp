@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Single-producer, single-consumer lock-free queue of stereo sample frames.
+ *
+ * The audio thread calls push() and the render thread calls pop(); neither blocks or
+ * allocates. The indices grow monotonically and are reduced modulo the power-of-two
+ * capacity, so a full queue and an empty one are told apart without a spare slot.
+ * When the render thread falls behind, push() drops the newest frames rather than
+ * overwrite ones the consumer may be reading.
+ */
+class AudioRingBuffer
+{
+public:
+    /// @p capacityFrames is rounded up to a power of two.
+    explicit AudioRingBuffer(size_t capacityFrames = 8192)
+    {
+        size_t capacity = 1;
+        while (capacity < capacityFrames)
+        {
+            capacity <<= 1;
+        }
+        m_mask = capacity - 1;
+        m_left.resize(capacity);
+        m_right.resize(capacity);
+    }
+
+    size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    /// Producer: queues up to @p frames interleaved frames (channel 0 left, 1 right; mono is
+    /// duplicated, further channels ignored). Returns the number of frames accepted.
+    size_t push(const float* samples, unsigned channels, size_t frames)
+    {
+        if (channels == 0)
+        {
+            return 0;
+        }
+        const size_t write = m_write.load(std::memory_order_relaxed);
+        const size_t read = m_read.load(std::memory_order_acquire);
+        const size_t accepted = std::min(frames, capacity() - (write - read));
+        const size_t rightChannel = channels > 1 ? 1 : 0;
+        for (size_t i = 0; i < accepted; ++i)
+        {
+            const size_t slot = (write + i) & m_mask;
+            m_left[slot] = samples[i * channels];
+            m_right[slot] = samples[i * channels + rightChannel];
+        }
+        m_write.store(write + accepted, std::memory_order_release);
+        return accepted;
+    }
+
+    /// Frames queued and not yet popped. Exact on the consumer thread, a lower bound elsewhere.
+    size_t available() const
+    {
+        return m_write.load(std::memory_order_acquire) - m_read.load(std::memory_order_relaxed);
+    }
+
+    /// Consumer: drops the oldest frames until at most @p frames remain queued.
+    void discardAllBut(size_t frames)
+    {
+        const size_t queued = available();
+        if (queued > frames)
+        {
+            m_read.store(m_read.load(std::memory_order_relaxed) + queued - frames, std::memory_order_release);
+        }
+    }
+
+    /// Consumer: passes every queued frame to @p sink(left, right) in order, then frees the slots.
+    template<typename Sink>
+    size_t pop(Sink&& sink)
+    {
+        const size_t read = m_read.load(std::memory_order_relaxed);
+        const size_t write = m_write.load(std::memory_order_acquire);
+        for (size_t index = read; index != write; ++index)
+        {
+            sink(m_left[index & m_mask], m_right[index & m_mask]);
+        }
+        m_read.store(write, std::memory_order_release);
+        return write - read;
+    }
+
+private:
+    std::vector<float> m_left;
+    std::vector<float> m_right;
+    size_t m_mask{0};
+    // Separate cache lines so the two threads do not false-share the indices.
+    alignas(64) std::atomic<size_t> m_write{0}; //!< Frames pushed so far (producer-owned)
+    alignas(64) std::atomic<size_t> m_read{0};  //!< Frames popped so far (consumer-owned)
+};
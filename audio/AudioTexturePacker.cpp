@@ -0,0 +1,131 @@
+#include "AudioTexturePacker.hpp"
+
+#include <algorithm>
+
+namespace {
+
+using libprojectM::Audio::AudioBufferSamples;
+using libprojectM::Audio::SpectrumSamples;
+using libprojectM::Audio::WaveformSamples;
+
+// PCM::Add() stores float input scaled by this; the texture holds the unscaled waveform.
+constexpr float kPCMScale = 128.0f;
+
+} // namespace
+
+AudioTexturePacker::AudioTexturePacker(FFTPath path)
+    : m_path(path)
+{
+}
+
+size_t AudioTexturePacker::push(const float* samples, uint32_t channels, size_t frames)
+{
+    return m_queue.push(samples, channels, frames);
+}
+
+void AudioTexturePacker::update(double secondsSinceLastFrame)
+{
+    // Only the newest AudioBufferSamples frames survive in the analysis buffer, and the
+    // buffer is read oldest-first, so older frames can be dropped unseen.
+    m_queue.discardAllBut(AudioBufferSamples);
+
+    if (m_path == FFTPath::Reference)
+    {
+        std::array<float, AudioBufferSamples * 2> interleaved;
+        size_t frames = 0;
+        m_queue.pop([&](float left, float right) {
+            interleaved[frames * 2] = left;
+            interleaved[frames * 2 + 1] = right;
+            ++frames;
+        });
+        m_pcm.Add(interleaved.data(), 2, frames);
+        m_pcm.UpdateFrameAudioData(secondsSinceLastFrame, m_frame);
+
+        const libprojectM::Audio::FrameAudioData data = m_pcm.GetFrameAudioData();
+        m_bands = {data.bass, data.mid, data.treb, data.vol, data.bassAtt, data.midAtt, data.trebAtt, data.volAtt};
+        pack(data.waveformLeft.data(), data.waveformRight.data(), data.spectrumLeft.data(), data.spectrumRight.data());
+    }
+    else
+    {
+        m_queue.pop([&](float left, float right) {
+            m_inputLeft[m_start] = kPCMScale * left;
+            m_inputRight[m_start] = kPCMScale * right;
+            m_start = (m_start + 1) % AudioBufferSamples;
+        });
+        analyse(secondsSinceLastFrame);
+        pack(m_waveformLeft.data(), m_waveformRight.data(), m_spectrumLeft.data(), m_spectrumRight.data());
+    }
+    ++m_frame;
+}
+
+void AudioTexturePacker::analyse(double secondsSinceLastFrame)
+{
+    for (size_t i = 0; i < AudioBufferSamples; ++i)
+    {
+        const size_t source = (m_start + i) % AudioBufferSamples;
+        m_waveformLeft[i] = m_inputLeft[source];
+        m_waveformRight[i] = m_inputRight[source];
+    }
+
+    // PCM::UpdateSpectrum() damps each sample with its predecessor before the FFT.
+    auto spectrum = [&](const libprojectM::Audio::WaveformBuffer& waveform, libprojectM::Audio::SpectrumBuffer& output) {
+        m_damped[0] = waveform[0];
+        for (size_t i = 1; i < AudioBufferSamples; ++i)
+        {
+            m_damped[i] = 0.5f * (waveform[i] + waveform[i - 1]);
+        }
+        m_fft.timeToFrequencyDomain(m_damped.data(), output.data());
+    };
+    spectrum(m_waveformLeft, m_spectrumLeft);
+    spectrum(m_waveformRight, m_spectrumRight);
+
+    m_alignLeft.Align(m_waveformLeft);
+    m_alignRight.Align(m_waveformRight);
+
+    m_bass.Update(m_spectrumLeft, secondsSinceLastFrame, m_frame);
+    m_middles.Update(m_spectrumLeft, secondsSinceLastFrame, m_frame);
+    m_treble.Update(m_spectrumLeft, secondsSinceLastFrame, m_frame);
+
+    // Same derivation as PCM::GetFrameAudioData().
+    m_bands.bass = m_bass.CurrentRelative();
+    m_bands.mid = m_middles.CurrentRelative();
+    m_bands.treb = m_treble.CurrentRelative();
+    m_bands.bassAtt = m_bass.AverageRelative();
+    m_bands.midAtt = m_middles.AverageRelative();
+    m_bands.trebAtt = m_treble.AverageRelative();
+    m_bands.vol = (m_bands.bass + m_bands.mid + m_bands.treb) * 0.333f;
+    m_bands.volAtt = (m_bands.bassAtt + m_bands.midAtt + m_bands.trebAtt) * 0.333f;
+}
+
+void AudioTexturePacker::pack(const float* waveformLeft, const float* waveformRight, const float* spectrumLeft,
+                              const float* spectrumRight)
+{
+    float* waveformRow = m_texels.data();
+    float* spectrumRow = waveformRow + kWidth * 4;
+    std::fill(m_texels.begin(), m_texels.end(), 0.0f);
+    for (int i = 0; i < WaveformSamples; ++i)
+    {
+        waveformRow[i * 4] = waveformLeft[i] / kPCMScale;
+        waveformRow[i * 4 + 1] = waveformRight[i] / kPCMScale;
+    }
+    for (int i = 0; i < SpectrumSamples; ++i)
+    {
+        spectrumRow[i * 4] = spectrumLeft[i];
+        spectrumRow[i * 4 + 1] = spectrumRight[i];
+    }
+    packBands(m_bands, m_texels.data());
+}
+
+void AudioTexturePacker::packBands(const AudioBands& bands, float* texels)
+{
+    float* spectrumRow = texels + kWidth * 4;
+    const float levels[4][2] = {{bands.bass, bands.bassAtt},
+                                {bands.mid, bands.midAtt},
+                                {bands.treb, bands.trebAtt},
+                                {bands.vol, bands.volAtt}};
+    for (int band = 0; band < 4; ++band)
+    {
+        spectrumRow[band * 4 + 2] = levels[band][0];
+        spectrumRow[band * 4 + 3] = levels[band][1];
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "AudioRingBuffer.hpp"
+#include "SimdFFT.hpp"
+
+#include <Audio/AudioConstants.hpp>
+#include <Audio/Loudness.hpp>
+#include <Audio/PCM.hpp>
+#include <Audio/WaveformAligner.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Beat-detection levels for one frame, as libprojectM reports them (around 1.0).
+ */
+struct AudioBands {
+    float bass = 1.0f;
+    float mid = 1.0f;
+    float treb = 1.0f;
+    float vol = 1.0f;
+    float bassAtt = 1.0f;
+    float midAtt = 1.0f;
+    float trebAtt = 1.0f;
+    float volAtt = 1.0f;
+};
+
+/**
+ * @brief Turns streamed PCM into the per-frame iAudioTexture read by --audio-texture shaders.
+ *
+ * The audio thread hands samples to push(); the render thread calls update() once per
+ * frame, which drains the lock-free queue and runs libprojectM's analysis (spectrum,
+ * waveform alignment and bass/mid/treb loudness) before repacking the texture.
+ *
+ * Texture layout, kWidth x kHeight RGBA32F, row-major from texels():
+ * - Row 0: the aligned waveform, kWaveformSamples texels of (left, right) in .rg, scaled
+ *   to [-1, 1]; the remaining texels are zero.
+ * - Row 1: the spectrum, kWidth texels of (left, right) magnitudes in .rg.
+ * - Row 1, texels 0-3, .ba: (bass, bass_att), (mid, mid_att), (treb, treb_att), (vol, vol_att).
+ *
+ * FFTPath::Reference runs libprojectM::Audio::PCM unchanged. FFTPath::Simd runs the same
+ * steps with SimdFFT and reuses its buffers instead of allocating the FFT input and
+ * output every frame.
+ */
+class AudioTexturePacker
+{
+public:
+    enum class FFTPath
+    {
+        Reference,
+        Simd
+    };
+
+    static constexpr int kWidth = libprojectM::Audio::SpectrumSamples;
+    static constexpr int kHeight = 2;
+    static constexpr int kWaveformSamples = libprojectM::Audio::WaveformSamples;
+
+    explicit AudioTexturePacker(FFTPath path = FFTPath::Simd);
+
+    /// Audio thread: queues interleaved float samples (left at offset 0, right at 1).
+    /// Never blocks; returns the frames accepted.
+    size_t push(const float* samples, uint32_t channels, size_t frames);
+
+    /// Render thread: consumes the queued audio, analyses it and repacks the texture.
+    void update(double secondsSinceLastFrame);
+
+    const float* texels() const
+    {
+        return m_texels.data();
+    }
+
+    const AudioBands& bands() const
+    {
+        return m_bands;
+    }
+
+    FFTPath path() const
+    {
+        return m_path;
+    }
+
+    /// Writes the band levels into the .ba channels of row 1, texels 0-3, of @p texels.
+    static void packBands(const AudioBands& bands, float* texels);
+
+private:
+    void analyse(double secondsSinceLastFrame);
+    void pack(const float* waveformLeft, const float* waveformRight, const float* spectrumLeft, const float* spectrumRight);
+
+    FFTPath m_path;
+    AudioRingBuffer m_queue;
+    uint32_t m_frame{0};
+
+    // Reference path
+    libprojectM::Audio::PCM m_pcm;
+
+    // SIMD path: the same stages as PCM::UpdateFrameAudioData()
+    libprojectM::Audio::WaveformBuffer m_inputLeft{};
+    libprojectM::Audio::WaveformBuffer m_inputRight{};
+    size_t m_start{0};
+    libprojectM::Audio::WaveformBuffer m_waveformLeft{};
+    libprojectM::Audio::WaveformBuffer m_waveformRight{};
+    libprojectM::Audio::SpectrumBuffer m_spectrumLeft{};
+    libprojectM::Audio::SpectrumBuffer m_spectrumRight{};
+    libprojectM::Audio::WaveformBuffer m_damped{};
+    SimdFFT m_fft{libprojectM::Audio::WaveformSamples, libprojectM::Audio::SpectrumSamples, true};
+    libprojectM::Audio::WaveformAligner m_alignLeft;
+    libprojectM::Audio::WaveformAligner m_alignRight;
+    libprojectM::Audio::Loudness m_bass{libprojectM::Audio::Loudness::Band::Bass};
+    libprojectM::Audio::Loudness m_middles{libprojectM::Audio::Loudness::Band::Middles};
+    libprojectM::Audio::Loudness m_treble{libprojectM::Audio::Loudness::Band::Treble};
+
+    AudioBands m_bands;
+    std::array<float, kWidth * kHeight * 4> m_texels{};
+};
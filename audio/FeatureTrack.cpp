@@ -0,0 +1,229 @@
+#include "FeatureTrack.hpp"
+
+#include <cstring>
+
+namespace {
+
+constexpr char kMagic[4] = {'M', 'D', 'A', 'F'};
+constexpr size_t kHeaderSize = 32;
+constexpr size_t kBandValues = 9; // time plus eight band levels
+
+void putU32(unsigned char* bytes, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+uint32_t getU32(const unsigned char* bytes)
+{
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+uint32_t floatBits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float bitsFloat(uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void encodeHeader(const FeatureTrackHeader& header, unsigned char* bytes)
+{
+    std::memcpy(bytes, kMagic, sizeof(kMagic));
+    putU32(bytes + 4, FeatureTrackHeader::kVersion);
+    putU32(bytes + 8, floatBits(header.fps));
+    putU32(bytes + 12, header.sampleRate);
+    putU32(bytes + 16, header.flags);
+    putU32(bytes + 20, header.frameCount);
+    putU32(bytes + 24, header.waveformSamples);
+    putU32(bytes + 28, header.spectrumSamples);
+}
+
+size_t recordValues(const FeatureTrackHeader& header)
+{
+    size_t values = kBandValues;
+    if (header.flags & FeatureTrackHeader::kWaveform)
+    {
+        values += header.waveformSamples * 2;
+    }
+    if (header.flags & FeatureTrackHeader::kSpectrum)
+    {
+        values += header.spectrumSamples * 2;
+    }
+    return values;
+}
+
+} // namespace
+
+size_t FeatureTrackHeader::recordSize() const
+{
+    return recordValues(*this) * sizeof(uint32_t);
+}
+
+void FeatureFrame::toTexels(float* texels) const
+{
+    constexpr int width = AudioTexturePacker::kWidth;
+    std::memset(texels, 0, sizeof(float) * width * AudioTexturePacker::kHeight * 4);
+    for (size_t i = 0; i < waveform.size() / 2 && i < static_cast<size_t>(width); ++i)
+    {
+        texels[i * 4] = waveform[i * 2];
+        texels[i * 4 + 1] = waveform[i * 2 + 1];
+    }
+    float* spectrumRow = texels + width * 4;
+    for (size_t i = 0; i < spectrum.size() / 2 && i < static_cast<size_t>(width); ++i)
+    {
+        spectrumRow[i * 4] = spectrum[i * 2];
+        spectrumRow[i * 4 + 1] = spectrum[i * 2 + 1];
+    }
+    AudioTexturePacker::packBands(bands, texels);
+}
+
+bool FeatureTrackWriter::fail(const std::string& message)
+{
+    m_error = message;
+    return false;
+}
+
+bool FeatureTrackWriter::open(const std::string& path, const FeatureTrackHeader& header)
+{
+    m_header = header;
+    m_header.frameCount = 0;
+    m_header.waveformSamples = AudioTexturePacker::kWaveformSamples;
+    m_header.spectrumSamples = AudioTexturePacker::kWidth;
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file)
+    {
+        return fail("Could not open " + path + " for writing");
+    }
+    unsigned char bytes[kHeaderSize];
+    encodeHeader(m_header, bytes);
+    m_file.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    m_record.reserve(recordValues(m_header));
+    return static_cast<bool>(m_file) || fail("Could not write " + path);
+}
+
+bool FeatureTrackWriter::write(float time, const AudioTexturePacker& packer)
+{
+    const AudioBands& bands = packer.bands();
+    m_record.assign({time, bands.bass, bands.mid, bands.treb, bands.vol,
+                     bands.bassAtt, bands.midAtt, bands.trebAtt, bands.volAtt});
+    const float* texels = packer.texels();
+    if (m_header.flags & FeatureTrackHeader::kWaveform)
+    {
+        for (uint32_t i = 0; i < m_header.waveformSamples; ++i)
+        {
+            m_record.push_back(texels[i * 4]);
+            m_record.push_back(texels[i * 4 + 1]);
+        }
+    }
+    if (m_header.flags & FeatureTrackHeader::kSpectrum)
+    {
+        const float* spectrumRow = texels + AudioTexturePacker::kWidth * 4;
+        for (uint32_t i = 0; i < m_header.spectrumSamples; ++i)
+        {
+            m_record.push_back(spectrumRow[i * 4]);
+            m_record.push_back(spectrumRow[i * 4 + 1]);
+        }
+    }
+
+    m_bytes.resize(m_record.size() * sizeof(uint32_t));
+    for (size_t i = 0; i < m_record.size(); ++i)
+    {
+        putU32(m_bytes.data() + i * 4, floatBits(m_record[i]));
+    }
+    m_file.write(reinterpret_cast<const char*>(m_bytes.data()), static_cast<std::streamsize>(m_bytes.size()));
+    ++m_header.frameCount;
+    return static_cast<bool>(m_file) || fail("Could not write feature record");
+}
+
+bool FeatureTrackWriter::close()
+{
+    unsigned char bytes[kHeaderSize];
+    encodeHeader(m_header, bytes);
+    m_file.seekp(0);
+    m_file.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    m_file.close();
+    return static_cast<bool>(m_file) || fail("Could not finalize the feature track header");
+}
+
+bool FeatureTrackReader::fail(const std::string& message)
+{
+    m_error = message;
+    return false;
+}
+
+bool FeatureTrackReader::open(const std::string& path)
+{
+    m_file.open(path, std::ios::binary);
+    if (!m_file)
+    {
+        return fail("Could not open " + path);
+    }
+    unsigned char bytes[kHeaderSize];
+    if (!m_file.read(reinterpret_cast<char*>(bytes), sizeof(bytes)) || std::memcmp(bytes, kMagic, sizeof(kMagic)) != 0)
+    {
+        return fail(path + " is not a feature track");
+    }
+    if (getU32(bytes + 4) != FeatureTrackHeader::kVersion)
+    {
+        return fail(path + " has unsupported feature track version " + std::to_string(getU32(bytes + 4)));
+    }
+    m_header.fps = bitsFloat(getU32(bytes + 8));
+    m_header.sampleRate = getU32(bytes + 12);
+    m_header.flags = getU32(bytes + 16);
+    m_header.frameCount = getU32(bytes + 20);
+    m_header.waveformSamples = getU32(bytes + 24);
+    m_header.spectrumSamples = getU32(bytes + 28);
+    if (!(m_header.fps > 0.0f))
+    {
+        return fail(path + " has an invalid frame rate");
+    }
+    return true;
+}
+
+bool FeatureTrackReader::read(uint32_t index, FeatureFrame& frame)
+{
+    if (index >= m_header.frameCount)
+    {
+        return fail("Feature record " + std::to_string(index) + " is past the end of the track");
+    }
+    const size_t size = m_header.recordSize();
+    m_bytes.resize(size);
+    m_file.clear();
+    m_file.seekg(static_cast<std::streamoff>(kHeaderSize + size * index));
+    if (!m_file.read(reinterpret_cast<char*>(m_bytes.data()), static_cast<std::streamsize>(size)))
+    {
+        return fail("Feature track is truncated at record " + std::to_string(index));
+    }
+
+    m_record.resize(size / sizeof(uint32_t));
+    for (size_t i = 0; i < m_record.size(); ++i)
+    {
+        m_record[i] = bitsFloat(getU32(m_bytes.data() + i * 4));
+    }
+    const float* value = m_record.data();
+    frame.time = value[0];
+    frame.bands = {value[1], value[2], value[3], value[4], value[5], value[6], value[7], value[8]};
+    value += kBandValues;
+    frame.waveform.clear();
+    frame.spectrum.clear();
+    if (m_header.flags & FeatureTrackHeader::kWaveform)
+    {
+        frame.waveform.assign(value, value + m_header.waveformSamples * 2);
+        value += m_header.waveformSamples * 2;
+    }
+    if (m_header.flags & FeatureTrackHeader::kSpectrum)
+    {
+        frame.spectrum.assign(value, value + m_header.spectrumSamples * 2);
+    }
+    return true;
+}
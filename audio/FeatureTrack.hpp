@@ -0,0 +1,102 @@
+#pragma once
+
+#include "AudioTexturePacker.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Header of a per-frame audio feature track (.mdaf), written by MilkdropAudioFeatures.
+ *
+ * File layout, all values little-endian:
+ * - Header: "MDAF", then uint32 version, float fps, uint32 sampleRate, uint32 flags,
+ *   uint32 frameCount, uint32 waveformSamples, uint32 spectrumSamples (32 bytes).
+ * - frameCount fixed-size records: float time, bass, mid, treb, vol, bassAtt, midAtt,
+ *   trebAtt, volAtt; then, when the flag is set, waveformSamples (left, right) pairs in
+ *   [-1, 1]; then, when the flag is set, spectrumSamples (left, right) magnitude pairs.
+ *
+ * Record @c n covers the audio up to @c time = (n + 1) / fps, so a renderer at iTime t
+ * replays record round(t * fps) - 1. Records have a fixed size and can be read at random.
+ */
+struct FeatureTrackHeader
+{
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kWaveform = 1u << 0; //!< Records carry the waveform row
+    static constexpr uint32_t kSpectrum = 1u << 1; //!< Records carry the spectrum row
+
+    float fps{60.0f};
+    uint32_t sampleRate{0};
+    uint32_t flags{0};
+    uint32_t frameCount{0};
+    uint32_t waveformSamples{AudioTexturePacker::kWaveformSamples};
+    uint32_t spectrumSamples{AudioTexturePacker::kWidth};
+
+    /// Bytes per frame record.
+    size_t recordSize() const;
+};
+
+/**
+ * @brief One decoded feature track record.
+ */
+struct FeatureFrame
+{
+    float time{0.0f};
+    AudioBands bands;
+    std::vector<float> waveform; //!< Interleaved (left, right); empty without kWaveform
+    std::vector<float> spectrum; //!< Interleaved (left, right); empty without kSpectrum
+
+    /// Fills an iAudioTexture-layout buffer (see AudioTexturePacker); absent rows stay zero.
+    void toTexels(float* texels) const;
+};
+
+/**
+ * @brief Appends records to a feature track; close() patches the frame count into the header.
+ */
+class FeatureTrackWriter
+{
+public:
+    bool open(const std::string& path, const FeatureTrackHeader& header);
+
+    /// Writes one record from the packer's current bands and texture rows.
+    bool write(float time, const AudioTexturePacker& packer);
+
+    bool close();
+
+    const FeatureTrackHeader& header() const { return m_header; }
+    const std::string& error() const { return m_error; }
+
+private:
+    bool fail(const std::string& message);
+
+    std::ofstream m_file;
+    FeatureTrackHeader m_header;
+    std::vector<float> m_record;
+    std::vector<unsigned char> m_bytes;
+    std::string m_error;
+};
+
+/**
+ * @brief Random-access reader for feature tracks.
+ */
+class FeatureTrackReader
+{
+public:
+    bool open(const std::string& path);
+
+    /// Decodes record @p index into @p frame.
+    bool read(uint32_t index, FeatureFrame& frame);
+
+    const FeatureTrackHeader& header() const { return m_header; }
+    const std::string& error() const { return m_error; }
+
+private:
+    bool fail(const std::string& message);
+
+    std::ifstream m_file;
+    FeatureTrackHeader m_header;
+    std::vector<float> m_record;
+    std::vector<unsigned char> m_bytes;
+    std::string m_error;
+};
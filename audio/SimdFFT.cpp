@@ -0,0 +1,170 @@
+#include "SimdFFT.hpp"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define MILKDROP_FFT_SSE 1
+#else
+#define MILKDROP_FFT_SSE 0
+#endif
+
+namespace {
+
+constexpr double kPi = 3.141592653589793238462643383279502884;
+
+} // namespace
+
+SimdFFT::SimdFFT(size_t samplesIn, size_t samplesOut, bool equalize, float envelopePower)
+    : m_samplesIn(samplesIn)
+    , m_size(samplesOut * 2)
+    , m_bitReverse(m_size)
+    , m_envelope(samplesIn, 1.0f)
+    , m_equalize(samplesOut, 1.0f)
+    , m_twiddleReal(m_size - 1)
+    , m_twiddleImag(m_size - 1)
+    , m_real(m_size)
+    , m_imag(m_size)
+{
+    size_t bits = 0;
+    while ((size_t{1} << bits) < m_size)
+    {
+        ++bits;
+    }
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        size_t reversed = 0;
+        for (size_t bit = 0; bit < bits; ++bit)
+        {
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        m_bitReverse[i] = reversed;
+    }
+
+    // Same tables as MilkdropFFT::InitEnvelopeTable() and InitEqualizeTable().
+    if (envelopePower >= 0.0f)
+    {
+        const float pi = static_cast<float>(kPi);
+        const float multiplier = 1.0f / static_cast<float>(samplesIn) * 2.0f * pi;
+        for (size_t i = 0; i < samplesIn; ++i)
+        {
+            float envelope = 0.5f + 0.5f * std::sin(static_cast<float>(i) * multiplier - pi * 0.5f);
+            m_envelope[i] = envelopePower == 1.0f ? envelope : std::pow(envelope, envelopePower);
+        }
+    }
+    if (equalize)
+    {
+        const float inverseHalf = 1.0f / static_cast<float>(samplesOut);
+        for (size_t i = 0; i < samplesOut; ++i)
+        {
+            m_equalize[i] = -0.02f * std::log(static_cast<float>(samplesOut - i) * inverseHalf);
+        }
+    }
+
+    for (size_t half = 1; half < m_size; half <<= 1)
+    {
+        for (size_t m = 0; m < half; ++m)
+        {
+            const double angle = -kPi * static_cast<double>(m) / static_cast<double>(half);
+            m_twiddleReal[half - 1 + m] = static_cast<float>(std::cos(angle));
+            m_twiddleImag[half - 1 + m] = static_cast<float>(std::sin(angle));
+        }
+    }
+}
+
+bool SimdFFT::vectorized()
+{
+    return MILKDROP_FFT_SSE != 0;
+}
+
+void SimdFFT::timeToFrequencyDomain(const float* waveform, float* spectrum)
+{
+    float* re = m_real.data();
+    float* im = m_imag.data();
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        const size_t source = m_bitReverse[i];
+        re[i] = source < m_samplesIn ? waveform[source] * m_envelope[source] : 0.0f;
+        im[i] = 0.0f;
+    }
+
+    // Half-sizes 1 and 2 have fewer than four butterflies per block.
+    for (size_t i = 0; i < m_size; i += 2)
+    {
+        const float r = re[i + 1];
+        re[i + 1] = re[i] - r;
+        re[i] += r;
+    }
+    for (size_t i = 0; i + 3 < m_size; i += 4)
+    {
+        const float r2 = re[i + 2];
+        const float i2 = im[i + 2];
+        re[i + 2] = re[i] - r2;
+        im[i + 2] = im[i] - i2;
+        re[i] += r2;
+        im[i] += i2;
+        // Twiddle -i: (r + i*j) * -i = j - i*r
+        const float r3 = im[i + 3];
+        const float i3 = -re[i + 3];
+        re[i + 3] = re[i + 1] - r3;
+        im[i + 3] = im[i + 1] - i3;
+        re[i + 1] += r3;
+        im[i + 1] += i3;
+    }
+
+    for (size_t half = 4; half < m_size; half <<= 1)
+    {
+        const float* wr = m_twiddleReal.data() + half - 1;
+        const float* wi = m_twiddleImag.data() + half - 1;
+        for (size_t block = 0; block < m_size; block += 2 * half)
+        {
+            float* re0 = re + block;
+            float* im0 = im + block;
+            float* re1 = re0 + half;
+            float* im1 = im0 + half;
+#if MILKDROP_FFT_SSE
+            for (size_t m = 0; m < half; m += 4)
+            {
+                const __m128 twr = _mm_loadu_ps(wr + m);
+                const __m128 twi = _mm_loadu_ps(wi + m);
+                const __m128 xr = _mm_loadu_ps(re1 + m);
+                const __m128 xi = _mm_loadu_ps(im1 + m);
+                const __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, twr), _mm_mul_ps(xi, twi));
+                const __m128 ti = _mm_add_ps(_mm_mul_ps(xr, twi), _mm_mul_ps(xi, twr));
+                const __m128 ur = _mm_loadu_ps(re0 + m);
+                const __m128 ui = _mm_loadu_ps(im0 + m);
+                _mm_storeu_ps(re1 + m, _mm_sub_ps(ur, tr));
+                _mm_storeu_ps(im1 + m, _mm_sub_ps(ui, ti));
+                _mm_storeu_ps(re0 + m, _mm_add_ps(ur, tr));
+                _mm_storeu_ps(im0 + m, _mm_add_ps(ui, ti));
+            }
+#else
+            for (size_t m = 0; m < half; ++m)
+            {
+                const float tr = re1[m] * wr[m] - im1[m] * wi[m];
+                const float ti = re1[m] * wi[m] + im1[m] * wr[m];
+                re1[m] = re0[m] - tr;
+                im1[m] = im0[m] - ti;
+                re0[m] += tr;
+                im0[m] += ti;
+            }
+#endif
+        }
+    }
+
+    const size_t outputs = m_size / 2;
+    size_t i = 0;
+#if MILKDROP_FFT_SSE
+    for (; i + 3 < outputs; i += 4)
+    {
+        const __m128 r = _mm_loadu_ps(re + i);
+        const __m128 c = _mm_loadu_ps(im + i);
+        const __m128 magnitude = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(c, c)));
+        _mm_storeu_ps(spectrum + i, _mm_mul_ps(magnitude, _mm_loadu_ps(m_equalize.data() + i)));
+    }
+#endif
+    for (; i < outputs; ++i)
+    {
+        spectrum[i] = m_equalize[i] * std::sqrt(re[i] * re[i] + im[i] * im[i]);
+    }
+}
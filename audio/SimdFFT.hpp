@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Allocation-free, vectorised counterpart of libprojectM::Audio::MilkdropFFT.
+ *
+ * Produces the same equalised magnitude spectrum (same envelope, bit-reversed radix-2
+ * transform and log equaliser) but keeps the data split into real and imaginary arrays
+ * and uses exact per-stage twiddle tables, so every butterfly stage from a half-size of
+ * four upwards runs four lanes at a time with SSE. Without SSE the same loops run
+ * scalar. Results match MilkdropFFT to float rounding.
+ */
+class SimdFFT
+{
+public:
+    /// Same parameters as MilkdropFFT; @p samplesOut must be a power of two.
+    SimdFFT(size_t samplesIn, size_t samplesOut, bool equalize = true, float envelopePower = 1.0f);
+
+    /// Transforms the first samplesIn values of @p waveform into samplesOut magnitudes.
+    void timeToFrequencyDomain(const float* waveform, float* spectrum);
+
+    /// True when the build uses the SSE butterflies.
+    static bool vectorized();
+
+private:
+    size_t m_samplesIn;
+    size_t m_size; //!< Complex transform size (2 * samplesOut)
+
+    std::vector<size_t> m_bitReverse;
+    std::vector<float> m_envelope;
+    std::vector<float> m_equalize;
+    std::vector<float> m_twiddleReal; //!< Stage with half-size h uses entries [h - 1, 2h - 1)
+    std::vector<float> m_twiddleImag;
+    std::vector<float> m_real;
+    std::vector<float> m_imag;
+};
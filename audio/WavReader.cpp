@@ -0,0 +1,169 @@
+#include "WavReader.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint16_t kFormatPCM = 0x0001;
+constexpr uint16_t kFormatFloat = 0x0003;
+constexpr uint16_t kFormatExtensible = 0xFFFE;
+
+uint16_t readU16(const unsigned char* bytes)
+{
+    return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+uint32_t readU32(const unsigned char* bytes)
+{
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+float decodeSample(const unsigned char* bytes, uint32_t bits, bool isFloat)
+{
+    if (isFloat)
+    {
+        if (bits == 32)
+        {
+            const uint32_t word = readU32(bytes);
+            float value;
+            std::memcpy(&value, &word, sizeof(value));
+            return value;
+        }
+        const uint64_t word = static_cast<uint64_t>(readU32(bytes)) | (static_cast<uint64_t>(readU32(bytes + 4)) << 32);
+        double value;
+        std::memcpy(&value, &word, sizeof(value));
+        return static_cast<float>(value);
+    }
+    switch (bits)
+    {
+        case 8: // Unsigned with a 128 offset
+            return (static_cast<float>(bytes[0]) - 128.0f) / 128.0f;
+        case 16:
+            return static_cast<float>(static_cast<int16_t>(readU16(bytes))) / 32768.0f;
+        case 24:
+        {
+            // Shift into the top of an int32 so the sign extends.
+            const int32_t value = static_cast<int32_t>((static_cast<uint32_t>(bytes[0]) << 8) |
+                                                       (static_cast<uint32_t>(bytes[1]) << 16) |
+                                                       (static_cast<uint32_t>(bytes[2]) << 24));
+            return static_cast<float>(value / 256) / 8388608.0f;
+        }
+        default:
+            return static_cast<float>(static_cast<int32_t>(readU32(bytes)) / 2147483648.0);
+    }
+}
+
+} // namespace
+
+bool WavReader::fail(const std::string& message)
+{
+    m_error = message;
+    return false;
+}
+
+bool WavReader::open(const std::string& path)
+{
+    m_file.open(path, std::ios::binary);
+    if (!m_file)
+    {
+        return fail("Could not open " + path);
+    }
+
+    unsigned char riff[12];
+    if (!m_file.read(reinterpret_cast<char*>(riff), sizeof(riff)) || std::memcmp(riff, "RIFF", 4) != 0 ||
+        std::memcmp(riff + 8, "WAVE", 4) != 0)
+    {
+        return fail(path + " is not a RIFF/WAVE file");
+    }
+
+    bool haveFormat = false;
+    uint16_t blockAlign = 0;
+    unsigned char header[8];
+    while (m_file.read(reinterpret_cast<char*>(header), sizeof(header)))
+    {
+        const uint32_t size = readU32(header + 4);
+        if (std::memcmp(header, "fmt ", 4) == 0)
+        {
+            if (size < 16)
+            {
+                return fail(path + " has a truncated fmt chunk");
+            }
+            std::vector<unsigned char> format(size);
+            if (!m_file.read(reinterpret_cast<char*>(format.data()), size))
+            {
+                return fail(path + " has a truncated fmt chunk");
+            }
+            uint16_t tag = readU16(format.data());
+            m_channels = readU16(format.data() + 2);
+            m_sampleRate = readU32(format.data() + 4);
+            blockAlign = readU16(format.data() + 12);
+            m_bitsPerSample = readU16(format.data() + 14);
+            if (tag == kFormatExtensible && size >= 26)
+            {
+                tag = readU16(format.data() + 24); // First two bytes of the SubFormat GUID
+            }
+            m_float = tag == kFormatFloat;
+            const bool supportedBits = m_float ? (m_bitsPerSample == 32 || m_bitsPerSample == 64)
+                                               : (m_bitsPerSample == 8 || m_bitsPerSample == 16 ||
+                                                  m_bitsPerSample == 24 || m_bitsPerSample == 32);
+            if ((tag != kFormatPCM && tag != kFormatFloat) || !supportedBits)
+            {
+                return fail(path + ": only integer PCM and IEEE float samples are supported");
+            }
+            if (m_channels == 0 || m_sampleRate == 0 || blockAlign != m_channels * (m_bitsPerSample / 8))
+            {
+                return fail(path + " has an invalid fmt chunk");
+            }
+            haveFormat = true;
+            m_file.seekg(size & 1, std::ios::cur);
+        }
+        else if (std::memcmp(header, "data", 4) == 0)
+        {
+            if (!haveFormat)
+            {
+                return fail(path + ": data chunk precedes the fmt chunk");
+            }
+            m_frames = size / blockAlign;
+            m_remaining = m_frames;
+            return true;
+        }
+        else
+        {
+            // Chunks are padded to an even size.
+            m_file.seekg(static_cast<std::streamoff>(size) + (size & 1), std::ios::cur);
+        }
+    }
+    return fail(path + " has no data chunk");
+}
+
+size_t WavReader::read(float* samples, size_t maxFrames)
+{
+    const size_t frameBytes = m_channels * (m_bitsPerSample / 8);
+    const size_t frames = static_cast<size_t>(std::min<uint64_t>(maxFrames, m_remaining));
+    if (frames == 0)
+    {
+        return 0;
+    }
+    m_bytes.resize(frames * frameBytes);
+    m_file.read(m_bytes.data(), static_cast<std::streamsize>(m_bytes.size()));
+    const size_t framesRead = static_cast<size_t>(m_file.gcount()) / frameBytes;
+    if (framesRead < frames)
+    {
+        m_error = "Data chunk is shorter than its header claims";
+        m_remaining = 0;
+    }
+    else
+    {
+        m_remaining -= frames;
+    }
+
+    const auto* bytes = reinterpret_cast<const unsigned char*>(m_bytes.data());
+    const uint32_t sampleBytes = m_bitsPerSample / 8;
+    for (size_t i = 0; i < framesRead * m_channels; ++i)
+    {
+        samples[i] = decodeSample(bytes + i * sampleBytes, m_bitsPerSample, m_float);
+    }
+    return framesRead;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Streaming reader for RIFF/WAVE files.
+ *
+ * Handles integer PCM (8, 16, 24 and 32 bit) and IEEE float (32 and 64 bit), including
+ * WAVE_FORMAT_EXTENSIBLE headers. open() only parses the header; read() decodes the
+ * data chunk in caller-sized blocks through one reusable byte buffer, so memory use does
+ * not depend on the file length.
+ */
+class WavReader
+{
+public:
+    /// Parses the header and positions the stream at the first sample frame.
+    bool open(const std::string& path);
+
+    /// Decodes up to @p maxFrames frames into @p samples as interleaved floats in [-1, 1].
+    /// Returns the frames read; 0 at the end of the data chunk or on a read error.
+    size_t read(float* samples, size_t maxFrames);
+
+    uint32_t sampleRate() const { return m_sampleRate; }
+    uint32_t channels() const { return m_channels; }
+    uint64_t frames() const { return m_frames; } //!< Total sample frames in the data chunk
+    const std::string& error() const { return m_error; }
+
+private:
+    bool fail(const std::string& message);
+
+    std::ifstream m_file;
+    std::vector<char> m_bytes;
+    uint32_t m_sampleRate{0};
+    uint32_t m_channels{0};
+    uint32_t m_bitsPerSample{0};
+    bool m_float{false};
+    uint64_t m_frames{0};
+    uint64_t m_remaining{0};
+    std::string m_error;
+};
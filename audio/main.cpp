@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "AudioTexturePacker.hpp"
+#include "FeatureTrack.hpp"
+#include "WavReader.hpp"
+
+namespace {
+
+// Frames decoded per read; bounds memory regardless of the file length or frame rate.
+constexpr size_t kChunkFrames = 4096;
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <input.wav> <output.mdaf>\n\n"
+              << "Writes libprojectM's per-frame audio analysis of a WAV file as a feature track\n"
+              << "(see FeatureTrack.hpp) for replay without a sound card.\n\n"
+              << "Options:\n"
+              << "  --fps <n>     Analysis frames per second (default 60)\n"
+              << "  --waveform    Store the aligned waveform row (480 stereo samples) per frame\n"
+              << "  --spectrum    Store the spectrum row (512 stereo bins) per frame\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    FeatureTrackHeader header;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--fps" && i + 1 < argc) {
+            header.fps = std::strtof(argv[++i], nullptr);
+            if (!(header.fps > 0.0f)) {
+                std::cerr << "Error: Invalid --fps value: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--waveform") {
+            header.flags |= FeatureTrackHeader::kWaveform;
+        } else if (arg == "--spectrum") {
+            header.flags |= FeatureTrackHeader::kSpectrum;
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Error: Unknown or incomplete option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    WavReader wav;
+    if (!wav.open(positional[0])) {
+        std::cerr << "Error: " << wav.error() << "\n";
+        return 1;
+    }
+    header.sampleRate = wav.sampleRate();
+    FeatureTrackWriter writer;
+    if (!writer.open(positional[1], header)) {
+        std::cerr << "Error: " << writer.error() << "\n";
+        return 1;
+    }
+
+    // Only the newest AudioBufferSamples frames before each analysis reach the FFT, so
+    // each frame's audio is decoded in chunks and only that tail is handed to the packer.
+    const uint32_t channels = wav.channels();
+    const size_t tailFrames = libprojectM::Audio::AudioBufferSamples;
+    std::vector<float> chunk(kChunkFrames * channels);
+    std::vector<float> tail;
+    tail.reserve(tailFrames * channels);
+
+    AudioTexturePacker packer(AudioTexturePacker::FFTPath::Reference);
+    const double samplesPerFrame = static_cast<double>(wav.sampleRate()) / header.fps;
+    uint64_t consumed = 0;
+    for (uint64_t frame = 0;; ++frame) {
+        const auto end = static_cast<uint64_t>(static_cast<double>(frame + 1) * samplesPerFrame);
+        if (end > wav.frames()) {
+            break;
+        }
+        while (consumed < end) {
+            const size_t want = static_cast<size_t>(std::min<uint64_t>(kChunkFrames, end - consumed));
+            const size_t got = wav.read(chunk.data(), want);
+            if (got == 0) {
+                std::cerr << "Error: " << wav.error() << "\n";
+                return 1;
+            }
+            consumed += got;
+            const size_t keep = std::min(got, tailFrames);
+            const size_t drop = std::min(tail.size() / channels, tailFrames - keep);
+            tail.erase(tail.begin(), tail.end() - static_cast<std::ptrdiff_t>(drop * channels));
+            tail.insert(tail.end(), chunk.begin() + static_cast<std::ptrdiff_t>((got - keep) * channels),
+                        chunk.begin() + static_cast<std::ptrdiff_t>(got * channels));
+        }
+        packer.push(tail.data(), channels, tail.size() / channels);
+        tail.clear();
+        packer.update(1.0 / header.fps);
+        if (!writer.write(static_cast<float>(static_cast<double>(frame + 1) / header.fps), packer)) {
+            std::cerr << "Error: " << writer.error() << "\n";
+            return 1;
+        }
+    }
+    if (!writer.close()) {
+        std::cerr << "Error: " << writer.error() << "\n";
+        return 1;
+    }
+
+    const FeatureTrackHeader& written = writer.header();
+    std::cout << "Wrote " << written.frameCount << " frames (" << written.frameCount / written.fps << " s at "
+              << written.fps << " fps, " << written.recordSize() << " bytes each) to " << positional[1] << "\n";
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "AudioTexturePacker.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// One iteration is one rendered frame at 60 fps: the audio thread's 1/60 s of 44.1 kHz
+// stereo is queued, then the render thread analyses it and repacks iAudioTexture.
+
+namespace {
+
+constexpr int kSampleRate = 44100;
+constexpr int kFps = 60;
+constexpr size_t kFramesPerVideoFrame = kSampleRate / kFps;
+
+// Deterministic stereo test signal: a bass line, a mid tone and noise-like treble.
+std::vector<float> testSignal(size_t frames)
+{
+    const double pi = 3.141592653589793;
+    std::vector<float> samples(frames * 2);
+    unsigned noise = 12345;
+    for (size_t i = 0; i < frames; ++i)
+    {
+        const double t = static_cast<double>(i) / kSampleRate;
+        noise = noise * 1103515245u + 12345u;
+        const double treble = (static_cast<double>((noise >> 16) & 0x7fff) / 16384.0 - 1.0) * 0.1;
+        const double bass = 0.5 * std::sin(2.0 * pi * 80.0 * t) * (0.6 + 0.4 * std::sin(2.0 * pi * 2.0 * t));
+        samples[i * 2] = static_cast<float>(bass + 0.25 * std::sin(2.0 * pi * 660.0 * t) + treble);
+        samples[i * 2 + 1] = static_cast<float>(bass + 0.25 * std::sin(2.0 * pi * 440.0 * t) - treble);
+    }
+    return samples;
+}
+
+} // namespace
+
+class AudioBenchmarks : public benchmark::Fixture
+{
+protected:
+    void RunFrames(benchmark::State& st, AudioTexturePacker::FFTPath path)
+    {
+        const std::vector<float> signal = testSignal(kFramesPerVideoFrame * kFps);
+        AudioTexturePacker packer(path);
+        size_t offset = 0;
+        for (auto _ : st)
+        {
+            packer.push(signal.data() + offset * 2, 2, kFramesPerVideoFrame);
+            packer.update(1.0 / kFps);
+            benchmark::DoNotOptimize(packer.texels());
+            offset = (offset + kFramesPerVideoFrame) % (signal.size() / 2);
+        }
+        st.SetItemsProcessed(st.iterations());
+    }
+};
+
+BENCHMARK_F(AudioBenchmarks, FrameUpdateReference)(benchmark::State& st)
+{
+    RunFrames(st, AudioTexturePacker::FFTPath::Reference);
+}
+
+// Also checks that the SIMD path packs the same texture as libprojectM's PCM.
+BENCHMARK_F(AudioBenchmarks, FrameUpdateSimd)(benchmark::State& st)
+{
+    const std::vector<float> signal = testSignal(kFramesPerVideoFrame * 30);
+    AudioTexturePacker reference(AudioTexturePacker::FFTPath::Reference);
+    AudioTexturePacker simd(AudioTexturePacker::FFTPath::Simd);
+    float worst = 0.0f;
+    for (size_t frame = 0; frame < 30; ++frame)
+    {
+        const float* samples = signal.data() + frame * kFramesPerVideoFrame * 2;
+        reference.push(samples, 2, kFramesPerVideoFrame);
+        simd.push(samples, 2, kFramesPerVideoFrame);
+        reference.update(1.0 / kFps);
+        simd.update(1.0 / kFps);
+        // Relative to the largest value. The equaliser gain peaks in the top bins, where it
+        // amplifies float rounding (recurrence twiddles in MilkdropFFT, exact tables in
+        // SimdFFT) to a few 1e-4 of the peak; a wrong butterfly is off by order one.
+        const int count = AudioTexturePacker::kWidth * AudioTexturePacker::kHeight * 4;
+        float peak = 1.0f;
+        for (int i = 0; i < count; ++i)
+        {
+            peak = std::max(peak, std::fabs(reference.texels()[i]));
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            worst = std::max(worst, std::fabs(simd.texels()[i] - reference.texels()[i]) / peak);
+        }
+    }
+    if (worst > 1e-2f)
+    {
+        st.SkipWithError("SIMD audio texture differs from the libprojectM reference");
+        return;
+    }
+    st.counters["max_relative_error"] = worst;
+    st.counters["sse"] = SimdFFT::vectorized() ? 1.0 : 0.0;
+
+    RunFrames(st, AudioTexturePacker::FFTPath::Simd);
+}
@@ -0,0 +1,81 @@
+#include "BenchmarkFixture.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+void AddPreset(std::vector<CorpusPreset>& corpus, const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return;
+    }
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    CorpusPreset preset;
+    preset.name = path.filename().string();
+    preset.source = buffer.str();
+
+    std::istringstream stream(preset.source);
+    libprojectM::PresetFileParser parser;
+    if (!parser.Read(stream))
+    {
+        return;
+    }
+    preset.values = parser.PresetValues();
+    preset.perFrame = parser.GetCode("per_frame_");
+    preset.perPixel = parser.GetCode("per_pixel_");
+    corpus.push_back(std::move(preset));
+}
+
+} // namespace
+
+const std::vector<CorpusPreset>& ConverterBenchmark::Corpus()
+{
+    static const std::vector<CorpusPreset> corpus = [] {
+        std::vector<CorpusPreset> presets;
+        std::filesystem::path sourceDir(MILKDROP_SOURCE_DIR);
+
+        std::filesystem::path presetDir = sourceDir / "tests" / "presets";
+        if (const char* overrideDir = std::getenv("MILKDROP_BENCHMARK_CORPUS"))
+        {
+            presetDir = overrideDir;
+        }
+
+        std::vector<std::filesystem::path> files;
+        for (const auto& entry : std::filesystem::directory_iterator(presetDir))
+        {
+            if (entry.path().extension() == ".milk")
+            {
+                files.push_back(entry.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        files.push_back(sourceDir / "baked.milk");
+
+        for (const auto& file : files)
+        {
+            AddPreset(presets, file);
+        }
+        if (presets.empty())
+        {
+            std::cerr << "Benchmark corpus is empty: " << presetDir << std::endl;
+        }
+        return presets;
+    }();
+    return corpus;
+}
+
+void ConverterBenchmark::SetUp(const benchmark::State& state)
+{
+    (void)state;
+    m_corpus = &Corpus();
+}
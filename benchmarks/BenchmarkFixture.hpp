@@ -0,0 +1,37 @@
+#pragma once
+
+#include "MilkdropConverter.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief A preset from the benchmark corpus, read once and kept in memory.
+ */
+struct CorpusPreset
+{
+    std::string name;
+    std::string source; //!< Raw .milk file contents.
+    libprojectM::PresetFileParser::ValueMap values;
+    std::string perFrame;
+    std::string perPixel;
+};
+
+/**
+ * @brief Fixture exposing the converter corpus: every preset in tests/presets plus baked.milk.
+ *
+ * The corpus directory defaults to the source tree and can be overridden with the
+ * MILKDROP_BENCHMARK_CORPUS environment variable (a directory of .milk files).
+ */
+class ConverterBenchmark : public benchmark::Fixture
+{
+public:
+    static const std::vector<CorpusPreset>& Corpus();
+
+    void SetUp(const benchmark::State& state) override;
+
+protected:
+    const std::vector<CorpusPreset>* m_corpus{nullptr};
+};
@@ -0,0 +1,46 @@
+#include "BenchmarkFixture.hpp"
+
+#include "PresetShaderTranslator.hpp"
+#include "TranslationCache.hpp"
+
+#include <sstream>
+
+class PackBenchmarks : public ConverterBenchmark
+{};
+
+// Whole-pack throughput: parse and translate every corpus preset from its raw bytes,
+// starting each pass with an empty translation cache like a fresh batch run. The
+// per-process wave specializations are warmed first (StageBenchmarks/SpecializeWaveGLSL).
+BENCHMARK_F(PackBenchmarks, Throughput)(benchmark::State& st)
+{
+    for (const auto& preset : *m_corpus)
+    {
+        translateToGLSL(preset.perFrame, preset.perPixel, preset.values);
+    }
+    size_t inputBytes = 0;
+    size_t outputBytes = 0;
+    for (auto _ : st)
+    {
+        st.PauseTiming();
+        TranslationCache::instance().clear();
+        PresetShaderTranslator::cache().clear();
+        st.ResumeTiming();
+
+        for (const auto& preset : *m_corpus)
+        {
+            std::istringstream stream(preset.source);
+            libprojectM::PresetFileParser parser;
+            if (!parser.Read(stream))
+            {
+                continue;
+            }
+            std::string glsl = translateToGLSL(parser.GetCode("per_frame_"), parser.GetCode("per_pixel_"), parser.PresetValues());
+            inputBytes += preset.source.size();
+            outputBytes += glsl.size();
+        }
+    }
+    st.SetBytesProcessed(static_cast<int64_t>(inputBytes));
+    st.SetItemsProcessed(st.iterations() * static_cast<int64_t>(m_corpus->size()));
+    st.counters["output_bytes_per_pass"] = benchmark::Counter(
+        st.iterations() ? static_cast<double>(outputBytes) / static_cast<double>(st.iterations()) : 0.0);
+}
@@ -0,0 +1,78 @@
+#include "BenchmarkFixture.hpp"
+
+#include "PresetShaderTranslator.hpp"
+#include "PresetValues.hpp"
+#include "TranslationCache.hpp"
+
+// Every iteration translates the warp and composite shaders of the whole corpus once, so the
+// reported time is "per corpus pass" and items_processed counts shaders.
+
+class ShaderBenchmarks : public ConverterBenchmark
+{
+protected:
+    struct CorpusShader
+    {
+        PresetShaderTranslator::Type type;
+        std::string code;
+    };
+
+    void SetUp(const benchmark::State& state) override
+    {
+        ConverterBenchmark::SetUp(state);
+        m_shaders.clear();
+        for (const auto& preset : *m_corpus)
+        {
+            const std::string warp = presetCode(preset.values, "warp_");
+            const std::string composite = presetCode(preset.values, "comp_");
+            if (!warp.empty())
+            {
+                m_shaders.push_back({PresetShaderTranslator::Type::Warp, warp});
+            }
+            if (!composite.empty())
+            {
+                m_shaders.push_back({PresetShaderTranslator::Type::Composite, composite});
+            }
+        }
+    }
+
+    std::vector<CorpusShader> m_shaders;
+};
+
+// hlslparser preprocessing, parsing and GLSL generation for every shader.
+BENCHMARK_F(ShaderBenchmarks, TranspileHLSLCold)(benchmark::State& st)
+{
+    size_t bytes = 0;
+    for (auto _ : st)
+    {
+        for (const auto& shader : m_shaders)
+        {
+            st.PauseTiming();
+            PresetShaderTranslator::cache().clear();
+            st.ResumeTiming();
+            benchmark::DoNotOptimize(PresetShaderTranslator::translate(shader.type, shader.code));
+            bytes += shader.code.size();
+        }
+    }
+    st.SetBytesProcessed(static_cast<int64_t>(bytes));
+    st.SetItemsProcessed(st.iterations() * static_cast<int64_t>(m_shaders.size()));
+}
+
+// Repeat translations served from the content-hash cache.
+BENCHMARK_F(ShaderBenchmarks, TranspileHLSLWarm)(benchmark::State& st)
+{
+    for (const auto& shader : m_shaders)
+    {
+        PresetShaderTranslator::translate(shader.type, shader.code);
+    }
+    size_t bytes = 0;
+    for (auto _ : st)
+    {
+        for (const auto& shader : m_shaders)
+        {
+            benchmark::DoNotOptimize(PresetShaderTranslator::translate(shader.type, shader.code));
+            bytes += shader.code.size();
+        }
+    }
+    st.SetBytesProcessed(static_cast<int64_t>(bytes));
+    st.SetItemsProcessed(st.iterations() * static_cast<int64_t>(m_shaders.size()));
+}
@@ -0,0 +1,199 @@
+#include "BenchmarkFixture.hpp"
+
+#include "PresetShaderTranslator.hpp"
+#include "TranslationCache.hpp"
+#include "WaveModeRenderer.hpp"
+
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+// Every benchmark iteration processes the whole corpus once, so the reported time is
+// "per corpus pass" and items_processed counts presets.
+
+class StageBenchmarks : public ConverterBenchmark
+{
+protected:
+    struct CompiledPreset
+    {
+        projectm_eval_context* context{nullptr};
+        prjm_eval_exptreenode* perFrame{nullptr};
+        prjm_eval_exptreenode* perPixel{nullptr};
+    };
+
+    void CompileCorpus()
+    {
+        for (const auto& preset : *m_corpus)
+        {
+            CompiledPreset compiled;
+            compiled.context = projectm_eval_context_create(nullptr, nullptr);
+            compiled.perFrame = compile_statements(compiled.context, preset.perFrame);
+            compiled.perPixel = compile_statements(compiled.context, preset.perPixel);
+            m_compiled.push_back(compiled);
+        }
+    }
+
+    // Specialized wave snippets live for the whole process; see SpecializeWaveGLSL.
+    void WarmWaveSpecializations()
+    {
+        for (const auto& preset : *m_corpus)
+        {
+            translateToGLSL(preset.perFrame, preset.perPixel, preset.values);
+        }
+    }
+
+    void TearDown(const benchmark::State& state) override
+    {
+        (void)state;
+        for (auto& compiled : m_compiled)
+        {
+            if (compiled.perFrame) prjm_eval_destroy_exptreenode(compiled.perFrame);
+            if (compiled.perPixel) prjm_eval_destroy_exptreenode(compiled.perPixel);
+            projectm_eval_context_destroy(compiled.context);
+        }
+        m_compiled.clear();
+    }
+
+    std::vector<CompiledPreset> m_compiled;
+};
+
+BENCHMARK_F(StageBenchmarks, PresetFileParserRead)(benchmark::State& st)
+{
+    size_t bytes = 0;
+    for (auto _ : st)
+    {
+        for (const auto& preset : *m_corpus)
+        {
+            std::istringstream stream(preset.source);
+            libprojectM::PresetFileParser parser;
+            benchmark::DoNotOptimize(parser.Read(stream));
+            bytes += preset.source.size();
+        }
+    }
+    st.SetBytesProcessed(static_cast<int64_t>(bytes));
+    st.SetItemsProcessed(st.iterations() * static_cast<int64_t>(m_corpus->size()));
+}
+
+BENCHMARK_F(StageBenchmarks, CleanCode)(benchmark::State& st)
+{
+    for (auto _ : st)
+    {
+        for (const auto& preset : *m_corpus)
+        {
+            benchmark::DoNotOptimize(clean_code(preset.perFrame));
+            benchmark::DoNotOptimize(clean_code(preset.perPixel));
+        }
+    }
+    st.SetItemsProcessed(st.iterations() * static_cast<int64_t>(m_corpus->size()));
+}
+
+BENCHMARK_F(StageBenchmarks, CompileStatements)(benchmark::State& st)
+{
+    for (auto _ : st)
+    {
+        for (const auto& preset : *m_corpus)
+        {
+            projectm_eval_context* context = projectm_eval_context_create(nullptr, nullptr);
+            prjm_eval_exptreenode* perFrame = compile_statements(context, preset.perFrame);
+            prjm_eval_exptreenode* perPixel = compile_statements(context, preset.perPixel);
+            if (perFrame) prjm_eval_destroy_exptreenode(perFrame);
+            if (perPixel) prjm_eval_destroy_exptreenode(perPixel);
+            projectm_eval_context_destroy(context);
+        }
+    }
+    st.SetItemsProcessed(st.iterations() * static_cast<int64_t>(m_corpus->size()));
+}
+
+BENCHMARK_F(StageBenchmarks, FindUserVars)(benchmark::State& st)
+{
+    CompileCorpus();
+    for (auto _ : st)
+    {
+        for (const auto& compiled : m_compiled)
+        {
+            benchmark::DoNotOptimize(findUserVars(internal_context(compiled.context)));
+        }
+    }
+    st.SetItemsProcessed(st.iterations() * static_cast<int64_t>(m_corpus->size()));
+}
+
+BENCHMARK_F(StageBenchmarks, GLSLGeneratorGenerate)(benchmark::State& st)
+{
+    CompileCorpus();
+    for (auto _ : st)
+    {
+        for (const auto& compiled : m_compiled)
+        {
+            GLSLGenerator generator(compiled.context);
+            benchmark::DoNotOptimize(generator.generate(compiled.perFrame));
+            benchmark::DoNotOptimize(generator.generate(compiled.perPixel, perPixelVariableRewrites()));
+        }
+    }
+    st.SetItemsProcessed(st.iterations() * static_cast<int64_t>(m_corpus->size()));
+}
+
+BENCHMARK_F(StageBenchmarks, GenerateWaveformGLSL)(benchmark::State& st)
+{
+    for (auto _ : st)
+    {
+        for (const auto& preset : *m_corpus)
+        {
+            int mode = 6;
+            if (auto it = preset.values.find("nwavemode"); it != preset.values.end())
+            {
+                mode = std::atoi(it->second.c_str());
+            }
+            benchmark::DoNotOptimize(WaveModeRenderer::generateWaveformGLSL(mode, preset.values));
+        }
+    }
+    st.SetItemsProcessed(st.iterations() * static_cast<int64_t>(m_corpus->size()));
+}
+
+// One-time cost a fresh process pays per wave mode: specializing the helper library
+// and stripping dead helpers. The translate and pack benchmarks start warm.
+BENCHMARK_F(StageBenchmarks, SpecializeWaveGLSL)(benchmark::State& st)
+{
+    const std::map<std::string, std::string> noValues;
+    for (auto _ : st)
+    {
+        WaveModeRenderer::clearSpecializations();
+        for (int mode = 0; mode <= 8; ++mode)
+        {
+            benchmark::DoNotOptimize(WaveModeRenderer::generateWaveformGLSL(mode, noValues));
+        }
+    }
+    st.SetItemsProcessed(st.iterations() * 9);
+}
+
+BENCHMARK_F(StageBenchmarks, TranslateToGLSLCold)(benchmark::State& st)
+{
+    WarmWaveSpecializations();
+    for (auto _ : st)
+    {
+        for (const auto& preset : *m_corpus)
+        {
+            st.PauseTiming();
+            TranslationCache::instance().clear();
+            PresetShaderTranslator::cache().clear();
+            st.ResumeTiming();
+            benchmark::DoNotOptimize(translateToGLSL(preset.perFrame, preset.perPixel, preset.values));
+        }
+    }
+    st.SetItemsProcessed(st.iterations() * static_cast<int64_t>(m_corpus->size()));
+}
+
+BENCHMARK_F(StageBenchmarks, TranslateToGLSLWarm)(benchmark::State& st)
+{
+    for (const auto& preset : *m_corpus)
+    {
+        translateToGLSL(preset.perFrame, preset.perPixel, preset.values);
+    }
+    for (auto _ : st)
+    {
+        for (const auto& preset : *m_corpus)
+        {
+            benchmark::DoNotOptimize(translateToGLSL(preset.perFrame, preset.perPixel, preset.values));
+        }
+    }
+    st.SetItemsProcessed(st.iterations() * static_cast<int64_t>(m_corpus->size()));
+}
@@ -0,0 +1,552 @@
+#include "milkdrop-converter.h"
+
+#include "MemoryStreamBuffer.hpp"
+#include "MilkdropConverter.hpp"
+#include "Profiler.hpp"
+#include "RenderGraph.hpp"
+
+#include <locale.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <istream>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef MILKDROP_CONVERTER_VERSION
+#define MILKDROP_CONVERTER_VERSION "0.0.0"
+#endif
+
+struct milkdrop_converter
+{
+    ConversionOptions options;
+    bool profile{false};
+
+    bool converted{false};
+    std::string label;
+    std::string glsl;
+    ConversionReport report;
+    std::vector<char> input;    //!< File contents for convert_file(), reused between presets
+    std::string error;
+    std::string warnings;
+    std::string costReport;
+    std::string graphJson;
+    std::string passPathText;
+    std::string profileText;
+    Profiler profiler;
+};
+
+namespace {
+
+/// True when the caller's struct, @c struct_size bytes long, has room for @p field.
+#define MILKDROP_HAS_FIELD(object, type, field) ((object)->struct_size >= offsetof(type, field) + sizeof((object)->field))
+
+/// Formats numbers in the "C" locale on this thread only, so hosts keep their own locale.
+class NumericLocaleScope
+{
+public:
+    NumericLocaleScope()
+    {
+        static const locale_t cLocale = newlocale(LC_NUMERIC_MASK, "C", static_cast<locale_t>(nullptr));
+        m_previous = cLocale != static_cast<locale_t>(nullptr) ? uselocale(cLocale) : static_cast<locale_t>(nullptr);
+    }
+
+    ~NumericLocaleScope()
+    {
+        if (m_previous != static_cast<locale_t>(nullptr))
+        {
+            uselocale(m_previous);
+        }
+    }
+
+    NumericLocaleScope(const NumericLocaleScope&) = delete;
+    NumericLocaleScope& operator=(const NumericLocaleScope&) = delete;
+
+private:
+    locale_t m_previous;
+};
+
+milkdrop_converter_status fail(milkdrop_converter* converter, milkdrop_converter_status status, const std::string& message)
+{
+    converter->error = message;
+    return status;
+}
+
+/// Runs @p body, turning exceptions into a status and a message on the handle.
+template <typename Body>
+milkdrop_converter_status guarded(milkdrop_converter* converter, const Body& body)
+{
+    try
+    {
+        return body();
+    }
+    catch (const std::bad_alloc&)
+    {
+        return fail(converter, MILKDROP_CONVERTER_INTERNAL_ERROR, "Out of memory");
+    }
+    catch (const std::exception& exception)
+    {
+        return fail(converter, MILKDROP_CONVERTER_INTERNAL_ERROR, exception.what());
+    }
+    catch (...)
+    {
+        return fail(converter, MILKDROP_CONVERTER_INTERNAL_ERROR, "Unexpected exception");
+    }
+}
+
+void clearResult(milkdrop_converter* converter)
+{
+    converter->converted = false;
+    converter->glsl.clear();
+    converter->report = ConversionReport();
+    converter->warnings.clear();
+    converter->costReport.clear();
+    converter->graphJson.clear();
+    converter->profileText.clear();
+}
+
+// "out/preset.frag" + "wave_bins" -> "out/preset.wave_bins.frag"
+std::string passPath(const std::string& shaderPath, const std::string& passName)
+{
+    std::string stem = shaderPath;
+    const std::string extension = ".frag";
+    if (stem.size() > extension.size() && stem.compare(stem.size() - extension.size(), extension.size(), extension) == 0)
+    {
+        stem.erase(stem.size() - extension.size());
+    }
+    return stem + "." + passName + extension;
+}
+
+void fillPass(const ShaderPass& source, milkdrop_converter_pass* pass)
+{
+    if (MILKDROP_HAS_FIELD(pass, milkdrop_converter_pass, resolution_divisor))
+    {
+        pass->name = source.name.c_str();
+        pass->sampler = source.sampler.c_str();
+        pass->glsl = source.glsl.c_str();
+        pass->glsl_size = source.glsl.size();
+        pass->width = source.width;
+        pass->height = source.height;
+        pass->resolution_divisor = source.resolutionDivisor;
+    }
+}
+
+bool writeText(const std::string& path, const std::string& text)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    return out && out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+milkdrop_converter_status convertBuffer(milkdrop_converter* converter, const char* data, size_t size, const std::string& label)
+{
+    clearResult(converter);
+    converter->label = label;
+    converter->error.clear();
+    if (converter->profile)
+    {
+        converter->profiler = Profiler();
+        converter->profiler.setLabel(label);
+    }
+    NumericLocaleScope locale;
+    std::optional<Profiler::Session> session;
+    if (converter->profile)
+    {
+        session.emplace(converter->profiler);
+    }
+
+    libprojectM::PresetFileParser parser;
+    std::string perFrameCode;
+    std::string perPixelCode;
+    {
+        ProfileScope profile("parse");
+        MemoryStreamBuffer buffer(data, size);
+        std::istream stream(&buffer);
+        if (!parser.Read(stream))
+        {
+            return fail(converter, MILKDROP_CONVERTER_PARSE_ERROR, "Could not read or parse input file: " + label);
+        }
+        perFrameCode = parser.GetCode("per_frame_");
+        perPixelCode = parser.GetCode("per_pixel_");
+        profile.setOutputBytes(perFrameCode.size() + perPixelCode.size());
+    }
+
+    converter->glsl = translateToGLSL(perFrameCode, perPixelCode, parser.PresetValues(), converter->options, &converter->report);
+    std::string errors;
+    for (const auto& message : converter->report.errors)
+    {
+        errors += (errors.empty() ? "" : "\n") + label + ": " + message;
+    }
+    converter->warnings = errors;
+    for (const auto& message : converter->report.warnings)
+    {
+        converter->warnings += (converter->warnings.empty() ? "" : "\n") + label + ": " + message;
+    }
+    if (converter->glsl.empty())
+    {
+        return fail(converter, MILKDROP_CONVERTER_CONVERSION_ERROR, errors.empty() ? "Could not convert " + label : errors);
+    }
+    converter->converted = true;
+    if (!errors.empty())
+    {
+        return fail(converter, MILKDROP_CONVERTER_PARTIAL, errors);
+    }
+    return MILKDROP_CONVERTER_OK;
+}
+
+} // namespace
+
+extern "C" {
+
+int milkdrop_converter_api_version(void)
+{
+    return MILKDROP_CONVERTER_API_VERSION;
+}
+
+const char* milkdrop_converter_version(void)
+{
+    return MILKDROP_CONVERTER_VERSION;
+}
+
+void milkdrop_converter_options_init(milkdrop_converter_options* options)
+{
+    if (options == nullptr)
+    {
+        return;
+    }
+    *options = milkdrop_converter_options();
+    options->struct_size = sizeof(milkdrop_converter_options);
+}
+
+double milkdrop_converter_budget_for_frame_ms(double millis)
+{
+    return ShaderCost::budgetForFrameMillis(millis);
+}
+
+milkdrop_converter* milkdrop_converter_create(void)
+{
+    return new (std::nothrow) milkdrop_converter();
+}
+
+void milkdrop_converter_destroy(milkdrop_converter* converter)
+{
+    delete converter;
+}
+
+milkdrop_converter_status milkdrop_converter_set_options(milkdrop_converter* converter, const milkdrop_converter_options* options)
+{
+    if (converter == nullptr)
+    {
+        return MILKDROP_CONVERTER_INVALID_ARGUMENT;
+    }
+    if (options == nullptr || !MILKDROP_HAS_FIELD(options, milkdrop_converter_options, profile))
+    {
+        return fail(converter, MILKDROP_CONVERTER_INVALID_ARGUMENT, "Options are missing or too small");
+    }
+    if (!(options->max_cost >= 0.0))
+    {
+        return fail(converter, MILKDROP_CONVERTER_INVALID_ARGUMENT, "max_cost must not be negative");
+    }
+    clearResult(converter);
+    converter->error.clear();
+    converter->options.maxCost = options->max_cost;
+    converter->options.waveGeometry = options->wave_geometry != 0;
+    converter->options.waveLowRes = options->wave_lowres != 0;
+    converter->options.audioTexture = options->audio_texture != 0;
+    converter->profile = options->profile != 0;
+    return MILKDROP_CONVERTER_OK;
+}
+
+milkdrop_converter_status milkdrop_converter_convert(milkdrop_converter* converter, const char* data, size_t size, const char* label)
+{
+    if (converter == nullptr)
+    {
+        return MILKDROP_CONVERTER_INVALID_ARGUMENT;
+    }
+    if (data == nullptr && size > 0)
+    {
+        return fail(converter, MILKDROP_CONVERTER_INVALID_ARGUMENT, "No preset data");
+    }
+    return guarded(converter, [&]() {
+        return convertBuffer(converter, data != nullptr ? data : "", size, label != nullptr ? label : "preset");
+    });
+}
+
+milkdrop_converter_status milkdrop_converter_convert_file(milkdrop_converter* converter, const char* path)
+{
+    if (converter == nullptr)
+    {
+        return MILKDROP_CONVERTER_INVALID_ARGUMENT;
+    }
+    if (path == nullptr)
+    {
+        return fail(converter, MILKDROP_CONVERTER_INVALID_ARGUMENT, "No input path");
+    }
+    return guarded(converter, [&]() {
+        clearResult(converter);
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        const std::streamoff size = in ? static_cast<std::streamoff>(in.tellg()) : -1;
+        // Larger files are not presets; the parser rejects them without reading them.
+        const size_t read = size < 0 ? 0 : static_cast<size_t>(std::min<std::streamoff>(size, libprojectM::PresetFileParser::maxFileSize + 1));
+        converter->input.resize(read);
+        if (size < 0 || !in.seekg(0) || !in.read(converter->input.data(), static_cast<std::streamsize>(read)))
+        {
+            return fail(converter, MILKDROP_CONVERTER_IO_ERROR, std::string("Could not read or parse input file: ") + path);
+        }
+        return convertBuffer(converter, converter->input.data(), converter->input.size(), path);
+    });
+}
+
+const char* milkdrop_converter_error(const milkdrop_converter* converter)
+{
+    return converter != nullptr ? converter->error.c_str() : "No converter handle";
+}
+
+const char* milkdrop_converter_warnings(const milkdrop_converter* converter)
+{
+    return converter != nullptr ? converter->warnings.c_str() : "";
+}
+
+const char* milkdrop_converter_shader(const milkdrop_converter* converter, size_t* size)
+{
+    if (converter == nullptr || !converter->converted)
+    {
+        if (size != nullptr)
+        {
+            *size = 0;
+        }
+        return nullptr;
+    }
+    if (size != nullptr)
+    {
+        *size = converter->glsl.size();
+    }
+    return converter->glsl.c_str();
+}
+
+size_t milkdrop_converter_pass_count(const milkdrop_converter* converter)
+{
+    return converter != nullptr && converter->converted ? converter->report.passes.size() : 0;
+}
+
+milkdrop_converter_status milkdrop_converter_get_pass(const milkdrop_converter* converter, size_t index, milkdrop_converter_pass* pass)
+{
+    if (converter == nullptr || pass == nullptr || index >= milkdrop_converter_pass_count(converter) ||
+        !MILKDROP_HAS_FIELD(pass, milkdrop_converter_pass, resolution_divisor))
+    {
+        return MILKDROP_CONVERTER_INVALID_ARGUMENT;
+    }
+    fillPass(converter->report.passes[index], pass);
+    return MILKDROP_CONVERTER_OK;
+}
+
+int milkdrop_converter_get_composite(const milkdrop_converter* converter, milkdrop_converter_pass* pass)
+{
+    if (converter == nullptr || pass == nullptr || !converter->converted || converter->report.composite.glsl.empty())
+    {
+        return 0;
+    }
+    fillPass(converter->report.composite, pass);
+    return 1;
+}
+
+milkdrop_converter_status milkdrop_converter_get_info(const milkdrop_converter* converter, milkdrop_converter_info* info)
+{
+    if (converter == nullptr || info == nullptr || !MILKDROP_HAS_FIELD(info, milkdrop_converter_info, wave_iteration_cap))
+    {
+        return MILKDROP_CONVERTER_INVALID_ARGUMENT;
+    }
+    if (!converter->converted)
+    {
+        return MILKDROP_CONVERTER_NO_RESULT;
+    }
+    const ConversionReport& report = converter->report;
+    info->cost = report.cost.weighted();
+    info->within_budget = report.withinBudget ? 1 : 0;
+    info->wave_binned = report.wave.binned ? 1 : 0;
+    info->wave_iteration_cap = report.wave.iterationCap;
+    return MILKDROP_CONVERTER_OK;
+}
+
+const char* milkdrop_converter_pass_path(milkdrop_converter* converter, const char* shader_path, const char* pass_name)
+{
+    if (converter == nullptr || shader_path == nullptr || pass_name == nullptr)
+    {
+        return nullptr;
+    }
+    try
+    {
+        converter->passPathText = passPath(shader_path, pass_name);
+        return converter->passPathText.c_str();
+    }
+    catch (...)
+    {
+        converter->error = "Out of memory";
+        return nullptr;
+    }
+}
+
+const char* milkdrop_converter_cost_report(milkdrop_converter* converter)
+{
+    if (converter == nullptr || !converter->converted)
+    {
+        return nullptr;
+    }
+    try
+    {
+        NumericLocaleScope locale;
+        std::ostringstream out;
+        ShaderCostModel::writeReport(out, converter->label, converter->report.cost);
+        converter->costReport = out.str();
+        return converter->costReport.c_str();
+    }
+    catch (...)
+    {
+        converter->error = "Could not format the cost report";
+        return nullptr;
+    }
+}
+
+milkdrop_converter_status milkdrop_converter_write(milkdrop_converter* converter, const char* shader_path)
+{
+    if (converter == nullptr)
+    {
+        return MILKDROP_CONVERTER_INVALID_ARGUMENT;
+    }
+    if (shader_path == nullptr)
+    {
+        return fail(converter, MILKDROP_CONVERTER_INVALID_ARGUMENT, "No output path");
+    }
+    if (!converter->converted)
+    {
+        return fail(converter, MILKDROP_CONVERTER_NO_RESULT, "Nothing has been converted");
+    }
+    return guarded(converter, [&]() {
+        converter->error.clear();
+        std::optional<Profiler::Session> session;
+        if (converter->profile)
+        {
+            session.emplace(converter->profiler);
+        }
+        {
+            ProfileScope profile("write");
+            if (!writeText(shader_path, converter->glsl))
+            {
+                return fail(converter, MILKDROP_CONVERTER_IO_ERROR, std::string("Could not open output file for writing: ") + shader_path);
+            }
+            profile.setOutputBytes(converter->glsl.size());
+        }
+        for (const auto& pass : converter->report.passes)
+        {
+            const std::string path = passPath(shader_path, pass.name);
+            if (!writeText(path, pass.glsl))
+            {
+                return fail(converter, MILKDROP_CONVERTER_IO_ERROR, "Could not open pass output for writing: " + path);
+            }
+        }
+        const ShaderPass& composite = converter->report.composite;
+        if (!composite.glsl.empty())
+        {
+            const std::string path = passPath(shader_path, composite.name);
+            if (!writeText(path, composite.glsl))
+            {
+                return fail(converter, MILKDROP_CONVERTER_IO_ERROR, "Could not open composite output for writing: " + path);
+            }
+        }
+        return MILKDROP_CONVERTER_OK;
+    });
+}
+
+milkdrop_converter_status milkdrop_converter_get_pass_graph(milkdrop_converter* converter, const char* shader_path,
+                                                            milkdrop_converter_pass_graph* graph)
+{
+    if (converter == nullptr)
+    {
+        return MILKDROP_CONVERTER_INVALID_ARGUMENT;
+    }
+    if (shader_path == nullptr || graph == nullptr || !MILKDROP_HAS_FIELD(graph, milkdrop_converter_pass_graph, outputs))
+    {
+        return fail(converter, MILKDROP_CONVERTER_INVALID_ARGUMENT, "No output path or pass graph");
+    }
+    if (!converter->converted)
+    {
+        return fail(converter, MILKDROP_CONVERTER_NO_RESULT, "Nothing has been converted");
+    }
+    return guarded(converter, [&]() {
+        NumericLocaleScope locale;
+        const std::string mainPath = shader_path;
+        RenderGraph renderGraph = buildRenderGraph(converter->report, converter->glsl, [&](const std::string& name) {
+            return name == "main" ? mainPath : passPath(mainPath, name);
+        });
+        std::string errors;
+        for (const auto& error : validateRenderGraph(renderGraph))
+        {
+            errors += (errors.empty() ? "pass graph: " : "\npass graph: ") + error;
+        }
+        if (!errors.empty())
+        {
+            return fail(converter, MILKDROP_CONVERTER_CONVERSION_ERROR, errors);
+        }
+        std::ostringstream out;
+        writeRenderGraphJson(out, renderGraph);
+        converter->graphJson = out.str();
+        converter->error.clear();
+        graph->json = converter->graphJson.c_str();
+        graph->passes = renderGraph.passes.size();
+        graph->textures = static_cast<size_t>(renderGraph.textureCount());
+        graph->outputs = renderGraph.resources.size();
+        return MILKDROP_CONVERTER_OK;
+    });
+}
+
+const char* milkdrop_converter_profile(milkdrop_converter* converter, int trace)
+{
+    if (converter == nullptr || !converter->profile)
+    {
+        return nullptr;
+    }
+    try
+    {
+        NumericLocaleScope locale;
+        std::ostringstream out;
+        if (trace != 0)
+        {
+            converter->profiler.writeChromeTrace(out);
+        }
+        else
+        {
+            converter->profiler.writeJson(out);
+        }
+        converter->profileText = out.str();
+        return converter->profileText.c_str();
+    }
+    catch (...)
+    {
+        converter->error = "Could not format the profile";
+        return nullptr;
+    }
+}
+
+int milkdrop_converter_profiling_available(void)
+{
+    return Profiler::enabled() ? 1 : 0;
+}
+
+int milkdrop_converter_self_test(void)
+{
+    try
+    {
+        NumericLocaleScope locale;
+        return runSelfTests() ? 1 : 0;
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+} // extern "C"
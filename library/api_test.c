@@ -0,0 +1,377 @@
+/*
+ * Checks the C API of libmilkdrop-converter from C.
+ *
+ * Every preset given on the command line is converted from memory on one reused handle and
+ * from its file on a fresh handle; the shaders and passes must agree. The test also checks
+ * option handling, error statuses and messages, that the output does not depend on the
+ * host's numeric locale, and that four threads converting on their own handles get the
+ * same shaders as one thread. It prints the mean in-process conversion time.
+ */
+
+#include "milkdrop-converter.h"
+
+#include <locale.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define THREADS 4
+
+typedef struct preset
+{
+    const char* path;
+    char* data;
+    size_t size;
+    char* shader; /* reference output of the reused handle */
+} preset;
+
+typedef struct worker
+{
+    preset* presets;
+    int count;
+    int mismatches;
+} worker;
+
+static int failures = 0;
+
+static void failure(const char* format, const char* detail)
+{
+    printf(" - ");
+    printf(format, detail);
+    printf("\n");
+    ++failures;
+}
+
+static char* readFile(const char* path, size_t* size)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* data = malloc((size_t)length + 1);
+    if (data != NULL && fread(data, 1, (size_t)length, file) != (size_t)length)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *size = (size_t)length;
+    return data;
+}
+
+static char* copyShader(const milkdrop_converter* converter)
+{
+    size_t size = 0;
+    const char* shader = milkdrop_converter_shader(converter, &size);
+    if (shader == NULL)
+    {
+        return NULL;
+    }
+    char* copy = malloc(size + 1);
+    memcpy(copy, shader, size + 1);
+    return copy;
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static void* convertAll(void* argument)
+{
+    worker* work = argument;
+    milkdrop_converter* converter = milkdrop_converter_create();
+    for (int round = 0; round < 2; ++round)
+    {
+        for (int i = 0; i < work->count; ++i)
+        {
+            const preset* item = &work->presets[i];
+            size_t size = 0;
+            const char* shader = NULL;
+            if (milkdrop_converter_convert(converter, item->data, item->size, item->path) == MILKDROP_CONVERTER_OK)
+            {
+                shader = milkdrop_converter_shader(converter, &size);
+            }
+            if (shader == NULL || item->shader == NULL || strcmp(shader, item->shader) != 0)
+            {
+                ++work->mismatches;
+            }
+        }
+    }
+    milkdrop_converter_destroy(converter);
+    return NULL;
+}
+
+/* Same shaders and passes on @p a and @p b. */
+static int sameResult(const milkdrop_converter* a, const milkdrop_converter* b)
+{
+    size_t sizeA = 0;
+    size_t sizeB = 0;
+    const char* shaderA = milkdrop_converter_shader(a, &sizeA);
+    const char* shaderB = milkdrop_converter_shader(b, &sizeB);
+    if (shaderA == NULL || shaderB == NULL || sizeA != sizeB || memcmp(shaderA, shaderB, sizeA) != 0 ||
+        milkdrop_converter_pass_count(a) != milkdrop_converter_pass_count(b))
+    {
+        return 0;
+    }
+    for (size_t index = 0; index < milkdrop_converter_pass_count(a); ++index)
+    {
+        milkdrop_converter_pass passA = {0};
+        milkdrop_converter_pass passB = {0};
+        passA.struct_size = sizeof(passA);
+        passB.struct_size = sizeof(passB);
+        milkdrop_converter_get_pass(a, index, &passA);
+        milkdrop_converter_get_pass(b, index, &passB);
+        if (strcmp(passA.name, passB.name) != 0 || strcmp(passA.glsl, passB.glsl) != 0 || passA.width != passB.width ||
+            passA.resolution_divisor != passB.resolution_divisor)
+        {
+            return 0;
+        }
+    }
+    milkdrop_converter_pass compositeA = {0};
+    milkdrop_converter_pass compositeB = {0};
+    compositeA.struct_size = sizeof(compositeA);
+    compositeB.struct_size = sizeof(compositeB);
+    const int hasA = milkdrop_converter_get_composite(a, &compositeA);
+    const int hasB = milkdrop_converter_get_composite(b, &compositeB);
+    return hasA == hasB && (!hasA || strcmp(compositeA.glsl, compositeB.glsl) == 0);
+}
+
+static void checkErrors(void)
+{
+    milkdrop_converter* converter = milkdrop_converter_create();
+    milkdrop_converter_options options;
+    milkdrop_converter_options_init(&options);
+    milkdrop_converter_info info = {0};
+    info.struct_size = sizeof(info);
+
+    if (milkdrop_converter_convert(NULL, "a=1", 3, NULL) != MILKDROP_CONVERTER_INVALID_ARGUMENT)
+    {
+        failure("%s", "a null handle is not an invalid argument");
+    }
+    if (milkdrop_converter_get_info(converter, &info) != MILKDROP_CONVERTER_NO_RESULT ||
+        milkdrop_converter_shader(converter, NULL) != NULL)
+    {
+        failure("%s", "a new handle reports a result");
+    }
+    const char binary[] = "[preset00]\nzoom=1\n\0\x01\x02";
+    if (milkdrop_converter_convert(converter, binary, sizeof(binary), "binary") != MILKDROP_CONVERTER_PARSE_ERROR ||
+        strstr(milkdrop_converter_error(converter), "binary") == NULL)
+    {
+        failure("binary input is not a parse error naming the preset: %s", milkdrop_converter_error(converter));
+    }
+    if (milkdrop_converter_convert(converter, "", 0, NULL) != MILKDROP_CONVERTER_PARSE_ERROR)
+    {
+        failure("%s", "empty input is not a parse error");
+    }
+    if (milkdrop_converter_convert_file(converter, "/nonexistent/preset.milk") != MILKDROP_CONVERTER_IO_ERROR)
+    {
+        failure("%s", "a missing file is not an I/O error");
+    }
+    if (milkdrop_converter_write(converter, "unused.frag") != MILKDROP_CONVERTER_NO_RESULT)
+    {
+        failure("%s", "writing without a result does not fail");
+    }
+    if (strcmp(milkdrop_converter_pass_path(converter, "out/shader.frag", "blur1"), "out/shader.blur1.frag") != 0 ||
+        strcmp(milkdrop_converter_pass_path(converter, "shader", "blur1"), "shader.blur1.frag") != 0 ||
+        milkdrop_converter_pass_path(converter, NULL, "blur1") != NULL)
+    {
+        failure("%s", "pass_path does not name the files write() uses");
+    }
+    options.struct_size = 8;
+    if (milkdrop_converter_set_options(converter, &options) != MILKDROP_CONVERTER_INVALID_ARGUMENT)
+    {
+        failure("%s", "a truncated options struct is accepted");
+    }
+    milkdrop_converter_options_init(&options);
+    options.max_cost = -1.0;
+    if (milkdrop_converter_set_options(converter, &options) != MILKDROP_CONVERTER_INVALID_ARGUMENT)
+    {
+        failure("%s", "a negative max_cost is accepted");
+    }
+    if (milkdrop_converter_convert(converter, "zoom=1\nper_frame_1=q1=bass;\n", 28, "ok") != MILKDROP_CONVERTER_OK ||
+        milkdrop_converter_error(converter)[0] != '\0')
+    {
+        failure("a valid preset after errors failed: %s", milkdrop_converter_error(converter));
+    }
+    milkdrop_converter_destroy(converter);
+}
+
+/* Code that does not compile is left out and reported on the handle, not on stderr. */
+static void checkPartial(void)
+{
+    milkdrop_converter* converter = milkdrop_converter_create();
+    const char broken[] = "zoom=1\nper_frame_1=q1 = (bass +;\nper_pixel_1=rot = rot + 0.01;\n";
+    if (milkdrop_converter_convert(converter, broken, sizeof(broken) - 1, "broken") != MILKDROP_CONVERTER_PARTIAL ||
+        milkdrop_converter_shader(converter, NULL) == NULL)
+    {
+        failure("a preset with per-frame code that does not compile is not a partial conversion: %s",
+                milkdrop_converter_error(converter));
+    }
+    const char* error = milkdrop_converter_error(converter);
+    if (strstr(error, "broken") == NULL || strstr(error, "per_frame") == NULL || strstr(error, "(bass +") == NULL)
+    {
+        failure("the partial conversion does not name the preset, block and statement: %s", error);
+    }
+    if (strstr(milkdrop_converter_warnings(converter), "(bass +") == NULL)
+    {
+        failure("the warnings do not list the code left out: %s", milkdrop_converter_warnings(converter));
+    }
+    if (milkdrop_converter_convert(converter, "zoom=1\nper_frame_1=q1=bass;\n", 28, "ok") != MILKDROP_CONVERTER_OK ||
+        milkdrop_converter_warnings(converter)[0] != '\0')
+    {
+        failure("the warnings of a partial conversion outlive it: %s", milkdrop_converter_warnings(converter));
+    }
+    milkdrop_converter_destroy(converter);
+}
+
+/* wave_geometry and max_cost reach the converter; profiling records the stages. */
+static void checkOptions(const preset* item)
+{
+    milkdrop_converter* converter = milkdrop_converter_create();
+    milkdrop_converter_options options;
+    milkdrop_converter_options_init(&options);
+    milkdrop_converter_convert(converter, item->data, item->size, item->path);
+    const size_t plainPasses = milkdrop_converter_pass_count(converter);
+
+    options.wave_geometry = 1;
+    options.max_cost = 1.0;
+    options.profile = 1;
+    milkdrop_converter_set_options(converter, &options);
+    if (milkdrop_converter_shader(converter, NULL) != NULL)
+    {
+        failure("%s", "set_options kept the last result");
+    }
+    milkdrop_converter_convert(converter, item->data, item->size, item->path);
+    milkdrop_converter_info info = {0};
+    info.struct_size = sizeof(info);
+    milkdrop_converter_get_info(converter, &info);
+    if (info.within_budget || info.wave_iteration_cap <= 0)
+    {
+        failure("max_cost 1 did not reduce the wave of %s", item->path);
+    }
+    if (info.wave_binned && milkdrop_converter_pass_count(converter) <= plainPasses)
+    {
+        failure("wave_geometry added no pass to %s", item->path);
+    }
+    const char* report = milkdrop_converter_cost_report(converter);
+    if (report == NULL || strstr(report, item->path) == NULL)
+    {
+        failure("the cost report does not name %s", item->path);
+    }
+    const char* profile = milkdrop_converter_profile(converter, 0);
+    if (profile == NULL || (milkdrop_converter_profiling_available() && strstr(profile, "\"parse\"") == NULL))
+    {
+        failure("the profile has no parse stage for %s", item->path);
+    }
+    milkdrop_converter_destroy(converter);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <preset.milk>...\n", argv[0]);
+        return 1;
+    }
+    printf("libmilkdrop-converter %s, API %d\n", milkdrop_converter_version(), milkdrop_converter_api_version());
+    if (milkdrop_converter_api_version() != MILKDROP_CONVERTER_API_VERSION)
+    {
+        failure("%s", "the library and header API versions differ");
+    }
+
+    const int count = argc - 1;
+    preset* presets = calloc((size_t)count, sizeof(preset));
+    milkdrop_converter* reused = milkdrop_converter_create();
+    double convertSeconds = 0.0;
+    for (int i = 0; i < count; ++i)
+    {
+        preset* item = &presets[i];
+        item->path = argv[i + 1];
+        item->data = readFile(item->path, &item->size);
+        if (item->data == NULL)
+        {
+            failure("could not read %s", item->path);
+            continue;
+        }
+        const double start = seconds();
+        const milkdrop_converter_status status = milkdrop_converter_convert(reused, item->data, item->size, item->path);
+        convertSeconds += seconds() - start;
+        if (status != MILKDROP_CONVERTER_OK)
+        {
+            failure("converting from memory failed: %s", milkdrop_converter_error(reused));
+            continue;
+        }
+        item->shader = copyShader(reused);
+
+        milkdrop_converter* fresh = milkdrop_converter_create();
+        if (milkdrop_converter_convert_file(fresh, item->path) != MILKDROP_CONVERTER_OK || !sameResult(reused, fresh))
+        {
+            failure("%s converts differently from its file on a new handle", item->path);
+        }
+        milkdrop_converter_destroy(fresh);
+    }
+    milkdrop_converter_destroy(reused);
+
+    checkErrors();
+    checkPartial();
+    checkOptions(&presets[0]);
+
+    /* A host with a comma decimal separator must still get "0.5", not "0,5". */
+    const char* commaLocales[] = {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "ru_RU.UTF-8"};
+    const char* locale = NULL;
+    for (size_t i = 0; i < sizeof(commaLocales) / sizeof(commaLocales[0]) && locale == NULL; ++i)
+    {
+        locale = setlocale(LC_NUMERIC, commaLocales[i]);
+    }
+    if (locale != NULL)
+    {
+        worker work = {presets, count, 0};
+        convertAll(&work);
+        if (work.mismatches > 0)
+        {
+            failure("the output changes under the %s numeric locale", locale);
+        }
+        setlocale(LC_NUMERIC, "C");
+    }
+
+    pthread_t threads[THREADS];
+    worker workers[THREADS];
+    for (int i = 0; i < THREADS; ++i)
+    {
+        workers[i] = (worker){presets, count, 0};
+        pthread_create(&threads[i], NULL, convertAll, &workers[i]);
+    }
+    for (int i = 0; i < THREADS; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        if (workers[i].mismatches > 0)
+        {
+            failure("%s", "a thread converting on its own handle got different shaders");
+        }
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        free(presets[i].data);
+        free(presets[i].shader);
+    }
+    free(presets);
+
+    if (failures > 0)
+    {
+        printf("C API regression failures: %d\n", failures);
+        return 1;
+    }
+    printf("Validated the C API on %d presets (%s locale check), %d threads; %.2f ms per in-process conversion\n", count,
+           locale != NULL ? locale : "no", THREADS, 1000.0 * convertSeconds / count);
+    return 0;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+/**
+ * @file milkdrop-converter.h
+ * @brief C API of the MilkDrop to GLSL converter, for converting presets in-process.
+ *
+ * A converter handle holds the options, the last conversion's shaders and messages, and the
+ * buffers they live in, which are reused by the next conversion. Handles are independent:
+ * separate threads may convert on separate handles at the same time, while one handle must
+ * only be used by one thread at a time. All handles share the process-wide translation
+ * cache, so statements seen in earlier presets are not translated again.
+ *
+ * Strings returned by a handle stay valid until the next convert, set_options or destroy
+ * call on it. Numbers in the generated GLSL are formatted in the "C" locale whatever the
+ * host's locale is. Structs carry their own size in @c struct_size (set by the caller), so
+ * later API versions can append fields without breaking older callers.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(MILKDROP_CONVERTER_SHARED) && defined(__GNUC__)
+#define MILKDROP_CONVERTER_EXPORT __attribute__((visibility("default")))
+#else
+#define MILKDROP_CONVERTER_EXPORT
+#endif
+
+/** Incremented when a function is added or a struct grows. */
+#define MILKDROP_CONVERTER_API_VERSION 1
+
+typedef enum milkdrop_converter_status
+{
+    MILKDROP_CONVERTER_OK = 0,
+    MILKDROP_CONVERTER_INVALID_ARGUMENT = 1, /**< A null handle or pointer, or a struct that is too small */
+    MILKDROP_CONVERTER_PARSE_ERROR = 2,      /**< The input is not a preset (binary, too large or empty) */
+    MILKDROP_CONVERTER_CONVERSION_ERROR = 3, /**< The converter produced no shader */
+    MILKDROP_CONVERTER_IO_ERROR = 4,         /**< A file could not be read or written */
+    MILKDROP_CONVERTER_NO_RESULT = 5,        /**< Nothing has been converted on the handle yet */
+    MILKDROP_CONVERTER_INTERNAL_ERROR = 6,   /**< Out of memory or an unexpected exception */
+    MILKDROP_CONVERTER_PARTIAL = 7           /**< Converted, but code that did not compile was left out; the
+                                                  result is available and milkdrop_converter_error() names the code */
+} milkdrop_converter_status;
+
+typedef struct milkdrop_converter milkdrop_converter;
+
+/** Conversion options; fill with milkdrop_converter_options_init() before changing fields. */
+typedef struct milkdrop_converter_options
+{
+    size_t struct_size;
+    double max_cost;   /**< Weighted per-pixel budget; 0 disables it (see milkdrop_converter_budget_for_frame_ms) */
+    int wave_geometry; /**< Compute wave vertices once per frame in a prepass and bin them into tiles */
+    int wave_lowres;   /**< Render wave intensity at reduced resolution and upsample it */
+    int audio_texture; /**< Sample waves from the packed iAudioTexture instead of iAudioBands */
+    int profile;       /**< Record per-stage times for milkdrop_converter_profile() */
+} milkdrop_converter_options;
+
+/** A shader pass rendered before the main shader, or the composite pass rendered after it. */
+typedef struct milkdrop_converter_pass
+{
+    size_t struct_size;
+    const char* name;       /**< File suffix, e.g. "wave_geometry" */
+    const char* sampler;    /**< Sampler uniform the pass output is bound to */
+    const char* glsl;
+    size_t glsl_size;
+    int width;              /**< Fixed target size in texels (RGBA32F), or 0 when screen-relative */
+    int height;
+    int resolution_divisor; /**< > 0: the target is iResolution / resolution_divisor on each axis */
+} milkdrop_converter_pass;
+
+/** Cost and wave limits of the last conversion. */
+typedef struct milkdrop_converter_info
+{
+    size_t struct_size;
+    double cost;            /**< Weighted static per-pixel cost, passes included */
+    int within_budget;      /**< 0 when max_cost is exceeded even by the cheapest wave variant */
+    int wave_binned;        /**< The wave geometry prepass is used */
+    int wave_iteration_cap; /**< Lowered wave loop cap, or 0 */
+} milkdrop_converter_info;
+
+/** The pass graph of the last conversion (see the --pass-graph option of the command-line tool). */
+typedef struct milkdrop_converter_pass_graph
+{
+    size_t struct_size;
+    const char* json;
+    size_t passes;
+    size_t textures; /**< Render targets after sharing */
+    size_t outputs;
+} milkdrop_converter_pass_graph;
+
+MILKDROP_CONVERTER_EXPORT int milkdrop_converter_api_version(void);
+
+/** The converter's version, "major.minor.patch". */
+MILKDROP_CONVERTER_EXPORT const char* milkdrop_converter_version(void);
+
+MILKDROP_CONVERTER_EXPORT void milkdrop_converter_options_init(milkdrop_converter_options* options);
+
+/** The weighted cost that fits in @p millis of frame time on the reference target. */
+MILKDROP_CONVERTER_EXPORT double milkdrop_converter_budget_for_frame_ms(double millis);
+
+/** A handle with default options, or NULL when out of memory. */
+MILKDROP_CONVERTER_EXPORT milkdrop_converter* milkdrop_converter_create(void);
+MILKDROP_CONVERTER_EXPORT void milkdrop_converter_destroy(milkdrop_converter* converter);
+
+/** Options used by the following conversions; also discards the last result. */
+MILKDROP_CONVERTER_EXPORT milkdrop_converter_status milkdrop_converter_set_options(milkdrop_converter* converter,
+                                                                                   const milkdrop_converter_options* options);
+
+/**
+ * Converts the .milk text in @p data. @p label names the preset in messages, the cost report
+ * and the profile, and may be NULL.
+ */
+MILKDROP_CONVERTER_EXPORT milkdrop_converter_status milkdrop_converter_convert(milkdrop_converter* converter, const char* data,
+                                                                               size_t size, const char* label);
+
+/** Reads and converts a .milk file; the path is the label. */
+MILKDROP_CONVERTER_EXPORT milkdrop_converter_status milkdrop_converter_convert_file(milkdrop_converter* converter,
+                                                                                    const char* path);
+
+/** Message of the last failed or partial call on the handle, or "" after a successful one. */
+MILKDROP_CONVERTER_EXPORT const char* milkdrop_converter_error(const milkdrop_converter* converter);
+
+/**
+ * Diagnostics of the last conversion, one per line: code left out because it did not compile,
+ * then features that fell back to their default (e.g. a preset shader that does not
+ * translate). "" when there are none. The library never prints them.
+ */
+MILKDROP_CONVERTER_EXPORT const char* milkdrop_converter_warnings(const milkdrop_converter* converter);
+
+/** The main fragment shader, or NULL before the first successful conversion. */
+MILKDROP_CONVERTER_EXPORT const char* milkdrop_converter_shader(const milkdrop_converter* converter, size_t* size);
+
+/** Prepasses the main shader samples, in render order. */
+MILKDROP_CONVERTER_EXPORT size_t milkdrop_converter_pass_count(const milkdrop_converter* converter);
+MILKDROP_CONVERTER_EXPORT milkdrop_converter_status milkdrop_converter_get_pass(const milkdrop_converter* converter, size_t index,
+                                                                                milkdrop_converter_pass* pass);
+
+/** Fills @p pass and returns 1 when the preset has a composite pass, else returns 0. */
+MILKDROP_CONVERTER_EXPORT int milkdrop_converter_get_composite(const milkdrop_converter* converter,
+                                                               milkdrop_converter_pass* pass);
+
+MILKDROP_CONVERTER_EXPORT milkdrop_converter_status milkdrop_converter_get_info(const milkdrop_converter* converter,
+                                                                                milkdrop_converter_info* info);
+
+/** The static cost breakdown printed by --cost-report, or NULL. */
+MILKDROP_CONVERTER_EXPORT const char* milkdrop_converter_cost_report(milkdrop_converter* converter);
+
+/**
+ * Writes the main shader to @p shader_path, each pass to "<stem>.<pass>.frag" and the
+ * composite pass to "<stem>.<composite>.frag", where <stem> is @p shader_path without ".frag"
+ * (see milkdrop_converter_pass_path()).
+ */
+MILKDROP_CONVERTER_EXPORT milkdrop_converter_status milkdrop_converter_write(milkdrop_converter* converter,
+                                                                             const char* shader_path);
+
+/**
+ * The file milkdrop_converter_write() writes the pass named @p pass_name to, for a main shader
+ * written to @p shader_path; NULL when an argument is NULL. Valid until the next call of this
+ * function on the handle.
+ */
+MILKDROP_CONVERTER_EXPORT const char* milkdrop_converter_pass_path(milkdrop_converter* converter, const char* shader_path,
+                                                                   const char* pass_name);
+
+/** Builds and validates the pass graph of the files milkdrop_converter_write() names. */
+MILKDROP_CONVERTER_EXPORT milkdrop_converter_status milkdrop_converter_get_pass_graph(milkdrop_converter* converter,
+                                                                                      const char* shader_path,
+                                                                                      milkdrop_converter_pass_graph* graph);
+
+/**
+ * The stage profile of the last conversion and write as JSON, or in Chrome trace format when
+ * @p trace is non-zero; NULL unless the options enabled profiling. Stages are empty when
+ * profiling was compiled out (MILKDROP_ENABLE_PROFILING=OFF).
+ */
+MILKDROP_CONVERTER_EXPORT const char* milkdrop_converter_profile(milkdrop_converter* converter, int trace);
+
+/** 1 when stage profiling was compiled in. */
+MILKDROP_CONVERTER_EXPORT int milkdrop_converter_profiling_available(void);
+
+/** Runs the converter's built-in self-tests; returns 1 when they pass. */
+MILKDROP_CONVERTER_EXPORT int milkdrop_converter_self_test(void);
+
+#ifdef __cplusplus
+}
+#endif
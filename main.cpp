@@ -0,0 +1,208 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "milkdrop-converter.h"
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <input.milk> <output.frag>\n"
+              << "       " << program << " --self-test\n\n"
+              << "Options:\n"
+              << "  --profile <report.json>       Write per-stage wall time, allocations and output size\n"
+              << "  --profile-trace <trace.json>  Write stage events in Chrome trace format\n"
+              << "  --cost-report                 Print the static per-pixel cost estimate\n"
+              << "  --max-cost <ops|Nms>          Lower wave loop caps (down to 4 samples) until the\n"
+              << "                                shader fits the budget; Nms is a frame time on the reference target\n"
+              << "  --wave-geometry               Compute wave vertices once per frame into <output>.wave_geometry.frag\n"
+              << "                                and bin them into screen tiles (<output>.wave_bins.frag)\n"
+              << "  --wave-lowres                 Render wave intensity at half resolution per axis into\n"
+              << "                                <output>.wave_field.frag and upsample it in the main shader\n"
+              << "  --audio-texture               Sample wave shapes from the packed waveform/spectrum texture\n"
+              << "                                iAudioTexture (512x2) instead of the iAudioBands levels\n"
+              << "  --pass-graph <manifest.json>  Write every pass with its inputs, output, lifetime and the\n"
+              << "                                render targets it shares with other passes\n";
+}
+
+// Accepts a weighted op count ("1500") or a reference frame time ("16ms").
+bool parseMaxCost(const std::string& text, double& maxCost) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || value <= 0.0) {
+        return false;
+    }
+    std::string suffix(end);
+    if (suffix == "ms") {
+        maxCost = milkdrop_converter_budget_for_frame_ms(value);
+        return true;
+    }
+    maxCost = value;
+    return suffix.empty();
+}
+
+// "out/preset.frag" + "wave_bins" -> "out/preset.wave_bins.frag"
+bool writeText(const std::string& path, const char* text, const char* what) {
+    std::ofstream out(path);
+    if (!out || text == nullptr) {
+        std::cerr << "Error: Could not open " << what << " output for writing: " << path << "\n";
+        return false;
+    }
+    out << text;
+    return true;
+}
+
+// Prints each line of @p text to stderr after @p prefix.
+void printLines(const char* prefix, const char* text) {
+    std::istringstream lines(text);
+    for (std::string line; std::getline(lines, line);) {
+        std::cerr << prefix << line << "\n";
+    }
+}
+
+// Prints the message of the last failed call, one "Error:" line per line.
+void printError(const milkdrop_converter* converter) {
+    printLines("Error: ", milkdrop_converter_error(converter));
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc == 2 && std::string(argv[1]) == "--self-test") {
+        if (milkdrop_converter_self_test()) {
+            std::cout << "Self-tests passed" << std::endl;
+            return 0;
+        }
+        std::cerr << "Self-tests failed" << std::endl;
+        return 1;
+    }
+
+    std::string profilePath;
+    std::string tracePath;
+    std::string graphPath;
+    bool costReport = false;
+    milkdrop_converter_options options;
+    milkdrop_converter_options_init(&options);
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--profile" || arg == "--profile-trace") && i + 1 < argc) {
+            (arg == "--profile" ? profilePath : tracePath) = argv[++i];
+        } else if (arg == "--pass-graph" && i + 1 < argc) {
+            graphPath = argv[++i];
+        } else if (arg == "--cost-report") {
+            costReport = true;
+        } else if (arg == "--wave-geometry") {
+            options.wave_geometry = 1;
+        } else if (arg == "--wave-lowres") {
+            options.wave_lowres = 1;
+        } else if (arg == "--audio-texture") {
+            options.audio_texture = 1;
+        } else if (arg == "--max-cost" && i + 1 < argc) {
+            if (!parseMaxCost(argv[++i], options.max_cost)) {
+                std::cerr << "Error: Invalid --max-cost value: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Error: Unknown or incomplete option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    const std::string& inputFile = positional[0];
+    const std::string& outputFile = positional[1];
+
+    options.profile = !profilePath.empty() || !tracePath.empty();
+    if (options.profile && !milkdrop_converter_profiling_available()) {
+        std::cerr << "Warning: profiling was disabled at build time (MILKDROP_ENABLE_PROFILING=OFF); reports will be empty.\n";
+    }
+    std::unique_ptr<milkdrop_converter, void (*)(milkdrop_converter*)> converter(milkdrop_converter_create(),
+                                                                                milkdrop_converter_destroy);
+    if (!converter || milkdrop_converter_set_options(converter.get(), &options) != MILKDROP_CONVERTER_OK) {
+        std::cerr << "Error: Could not create the converter\n";
+        return 1;
+    }
+
+    // Writes the prepasses and composite pass next to the main shader (custom waves and preset
+    // shaders add theirs without any option).
+    // A partial conversion is still written; the code it left out is listed with the warnings.
+    const milkdrop_converter_status status = milkdrop_converter_convert_file(converter.get(), inputFile.c_str());
+    if ((status != MILKDROP_CONVERTER_OK && status != MILKDROP_CONVERTER_PARTIAL) ||
+        milkdrop_converter_write(converter.get(), outputFile.c_str()) != MILKDROP_CONVERTER_OK) {
+        printError(converter.get());
+        return 1;
+    }
+    std::cout << "Successfully converted " << inputFile << " to " << outputFile << "\n";
+    printLines("Warning: ", milkdrop_converter_warnings(converter.get()));
+
+    auto passFile = [&](const char* name) {
+        return milkdrop_converter_pass_path(converter.get(), outputFile.c_str(), name);
+    };
+    milkdrop_converter_pass pass{};
+    pass.struct_size = sizeof(pass);
+    for (size_t index = 0; index < milkdrop_converter_pass_count(converter.get()); ++index) {
+        milkdrop_converter_get_pass(converter.get(), index, &pass);
+        std::cout << "  pass " << pass.name << " (";
+        if (pass.resolution_divisor > 0) {
+            std::cout << "1/" << pass.resolution_divisor << " screen";
+        } else {
+            std::cout << pass.width << "x" << pass.height;
+        }
+        std::cout << ", " << pass.sampler << ") -> " << passFile(pass.name) << "\n";
+    }
+    if (milkdrop_converter_get_composite(converter.get(), &pass)) {
+        std::cout << "  composite " << pass.name << " (screen, after the main shader) -> " << passFile(pass.name) << "\n";
+    }
+    if (!graphPath.empty()) {
+        milkdrop_converter_pass_graph graph{};
+        graph.struct_size = sizeof(graph);
+        if (milkdrop_converter_get_pass_graph(converter.get(), outputFile.c_str(), &graph) != MILKDROP_CONVERTER_OK) {
+            printError(converter.get());
+            return 1;
+        }
+        if (!writeText(graphPath, graph.json, "pass graph")) {
+            return 1;
+        }
+        std::cout << "  pass graph: " << graph.passes << " passes, " << graph.textures << " textures for " << graph.outputs
+                  << " outputs -> " << graphPath << "\n";
+    }
+    milkdrop_converter_info info{};
+    info.struct_size = sizeof(info);
+    milkdrop_converter_get_info(converter.get(), &info);
+    if (options.wave_geometry && !info.wave_binned) {
+        std::cout << "  wave geometry not used: unsupported wave mode\n";
+    }
+
+    if (costReport || options.max_cost > 0.0) {
+        std::cout << milkdrop_converter_cost_report(converter.get());
+        if (info.wave_iteration_cap > 0) {
+            std::cout << "  budget:           wave loop cap lowered to " << info.wave_iteration_cap << "\n";
+        }
+    }
+
+    if (!profilePath.empty() && !writeText(profilePath, milkdrop_converter_profile(converter.get(), 0), "profile")) {
+        return 1;
+    }
+    if (!tracePath.empty() && !writeText(tracePath, milkdrop_converter_profile(converter.get(), 1), "profile")) {
+        return 1;
+    }
+    if (status == MILKDROP_CONVERTER_PARTIAL) {
+        return 3;
+    }
+    if (!info.within_budget) {
+        std::cerr << "Warning: " << inputFile << " exceeds --max-cost " << options.max_cost
+                  << " even with the cheapest wave variant (" << info.cost << " ops)\n";
+        return 2;
+    }
+    return 0;
+}
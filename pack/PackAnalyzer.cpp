@@ -0,0 +1,176 @@
+#include "PackAnalyzer.hpp"
+
+#include "CustomShapeRenderer.hpp"
+#include "CustomWaveRenderer.hpp"
+#include "MilkdropConverter.hpp"
+#include "MotionVectorRenderer.hpp"
+#include "PostEffects.hpp"
+#include "PresetValues.hpp"
+#include "ShaderCostModel.hpp"
+#include "WaveModeRenderer.hpp"
+
+#include <tuple>
+
+namespace {
+
+/// The parts of a preset that decide which shader skeleton the converter emits.
+using BaseKey = std::tuple<int, int, int, bool, bool>; // wave mode, waves, shapes, motion vectors, post composite
+
+BaseKey baseKey(const PresetFeatures& features)
+{
+    return {features.waveSupported ? features.waveMode : -1, features.customWaves, features.customShapes,
+            features.motionVectors, features.postComposite};
+}
+
+/// Weighted cost of the shader the converter emits for a preset with no code of its own.
+float baseCost(const BaseKey& key)
+{
+    libprojectM::PresetFileParser::ValueMap values;
+    values["nwavemode"] = std::to_string(std::get<0>(key));
+    for (int index = 0; index < std::get<1>(key); ++index)
+    {
+        values["wavecode_" + std::to_string(index) + "_enabled"] = "1";
+    }
+    for (int index = 0; index < std::get<2>(key); ++index)
+    {
+        values["shapecode_" + std::to_string(index) + "_enabled"] = "1";
+    }
+    if (std::get<3>(key))
+    {
+        values["mv_a"] = "1";
+    }
+    if (std::get<4>(key))
+    {
+        values["fgammaadj"] = "2";
+    }
+    ConversionReport report;
+    translateToGLSL("", "", values, ConversionOptions(), &report);
+    return static_cast<float>(report.cost.weighted());
+}
+
+/// Cost of a block of EEL or HLSL code, charged like generated GLSL: EEL operators and
+/// intrinsics map onto the same operators and built-ins.
+double codeCost(const std::string& code)
+{
+    if (code.empty())
+    {
+        return 0.0;
+    }
+    return ShaderCostModel::analyze("void main() {\n" + code + "\n}\n").weighted();
+}
+
+int statementCount(const std::string& code)
+{
+    return code.empty() ? 0 : static_cast<int>(clean_code(code).statements.size());
+}
+
+} // namespace
+
+PackAnalyzer::PackAnalyzer(int threads)
+    : m_pool(threads)
+{
+}
+
+PresetFeatures PackAnalyzer::analyzePreset(const std::map<std::string, std::string>& presetValues)
+{
+    PresetFeatures features;
+    features.parsed = true;
+    features.rating = presetFloat(presetValues, "frating", 0.0f);
+
+    const int waveMode = presetWaveMode(presetValues);
+    features.waveMode = waveMode;
+    features.waveSupported = WaveModeRenderer::defaultIterationCap(waveMode) > 0;
+
+    const std::string perFrame = presetCode(presetValues, "per_frame_");
+    const std::string init = presetCode(presetValues, "per_frame_init_");
+    const std::string perPixel = presetCode(presetValues, "per_pixel_");
+    features.motionVectors = MotionVectorRenderer::enabled(presetValues, perFrame);
+    features.postComposite = PostEffects::parse(presetValues, perFrame).composite();
+
+    int warpVersion = 0;
+    int compositeVersion = 0;
+    presetShaderVersions(presetValues, warpVersion, compositeVersion);
+    const std::string warp = warpVersion > 0 ? presetCode(presetValues, "warp_") : std::string();
+    const std::string composite = compositeVersion > 0 ? presetCode(presetValues, "comp_") : std::string();
+    features.warpShader = !warp.empty();
+    features.compShader = !composite.empty();
+
+    std::vector<std::string> blocks = {perFrame, init, perPixel};
+    const auto waves = CustomWaveRenderer::parse(presetValues);
+    const auto shapes = CustomShapeRenderer::parse(presetValues);
+    features.customWaves = static_cast<int>(waves.size());
+    features.customShapes = static_cast<int>(shapes.size());
+    for (const auto& wave : waves)
+    {
+        for (const std::string* code : {&wave.initCode, &wave.perFrameCode, &wave.perPointCode})
+        {
+            features.customStatements += statementCount(*code);
+            blocks.push_back(*code);
+        }
+    }
+    for (const auto& shape : shapes)
+    {
+        for (const std::string* code : {&shape.initCode, &shape.perFrameCode})
+        {
+            features.customStatements += statementCount(*code);
+            blocks.push_back(*code);
+        }
+    }
+    for (const auto& code : blocks)
+    {
+        features.usesLoop = features.usesLoop || presetCodeMentions(code, "loop") || presetCodeMentions(code, "while");
+        features.usesMegabuf = features.usesMegabuf || presetCodeMentions(code, "megabuf") || presetCodeMentions(code, "gmegabuf");
+    }
+
+    features.frameStatements = statementCount(perFrame) + statementCount(init);
+    features.pixelStatements = statementCount(perPixel);
+
+    // The converter runs the per-frame and per-pixel code in every fragment.
+    const double cost = codeCost(clean_code(perFrame).text) + codeCost(clean_code(perPixel).text) + codeCost(warp) +
+                        codeCost(composite);
+    features.cost = static_cast<float>(cost);
+    return features;
+}
+
+bool PackAnalyzer::analyze(const std::string& root)
+{
+    m_presets.clear();
+    PresetSource source;
+    if (!source.open(root))
+    {
+        m_error = source.error();
+        return false;
+    }
+
+    const auto& files = source.presets();
+    m_presets.resize(files.size());
+    std::vector<std::vector<char>> buffers(static_cast<size_t>(m_pool.size()));
+    m_pool.run(static_cast<int>(files.size()), [&](int index, int worker) {
+        PresetFeatures& features = m_presets[static_cast<size_t>(index)];
+        libprojectM::PresetFileParser parser;
+        if (source.parse(static_cast<size_t>(index), parser, buffers[static_cast<size_t>(worker)]))
+        {
+            features = analyzePreset(parser.PresetValues());
+        }
+        features.path = files[static_cast<size_t>(index)];
+    });
+
+    // Generating a skeleton shader takes milliseconds, so each combination is converted
+    // once; packs share a handful of them.
+    std::map<BaseKey, float> baseCosts;
+    for (auto& features : m_presets)
+    {
+        if (!features.parsed)
+        {
+            continue;
+        }
+        const BaseKey key = baseKey(features);
+        auto it = baseCosts.find(key);
+        if (it == baseCosts.end())
+        {
+            it = baseCosts.emplace(key, baseCost(key)).first;
+        }
+        features.cost += it->second;
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "PresetSource.hpp"
+#include "WorkerPool.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief What a preset uses, read from the preset file without generating GLSL.
+ *
+ * @c cost estimates ShaderCost::weighted() of the converted main shader: the shader the
+ * converter emits for the preset's wave mode, custom wave and shape counts, motion vectors
+ * and post composite (measured once per combination), plus the per-frame, per-pixel and
+ * warp/composite shader code charged as the cost model charges GLSL.
+ */
+struct PresetFeatures
+{
+    std::string path;        //!< Relative to the scanned directory
+    bool parsed{false};      //!< False when the file could not be read; the other fields stay zero
+    int waveMode{0};         //!< nWaveMode as written (6 when missing)
+    bool waveSupported{false}; //!< WaveModeRenderer has a renderer for the mode
+    int customWaves{0};      //!< Enabled custom waves that draw points
+    int customShapes{0};     //!< Enabled custom shapes with at least one instance
+    bool motionVectors{false};
+    bool warpShader{false};  //!< A warp shader the converter translates
+    bool compShader{false};  //!< A composite shader the converter translates
+    bool postComposite{false}; //!< Echo, gamma or a filter (post_composite pass)
+    bool usesLoop{false};    //!< Any code block calls loop() or while()
+    bool usesMegabuf{false}; //!< Any code block uses megabuf or gmegabuf
+    int frameStatements{0};  //!< Per-frame and init statements
+    int pixelStatements{0};
+    int customStatements{0}; //!< Statements of custom wave and shape code
+    float cost{0.0f};
+    float rating{0.0f};      //!< fRating
+};
+
+/**
+ * @brief Scans a pack of .milk files in parallel and extracts PresetFeatures.
+ *
+ * Presets are parsed and analysed on a WorkerPool, one file per task; only the
+ * per-combination base shader costs are generated afterwards, once each, on the calling
+ * thread. Results are sorted by path, so the index does not depend on the thread count.
+ */
+class PackAnalyzer
+{
+public:
+    /// @p threads workers; 0 uses one per hardware thread.
+    explicit PackAnalyzer(int threads = 0);
+
+    /// Analyses every .milk file below @p root (recursively, case-insensitive extension), or
+    /// in the zip archive @p root (see PresetSource).
+    bool analyze(const std::string& root);
+
+    /// Features of a single parsed preset; @c cost holds only the code share until the base
+    /// cost is added (see analyze()).
+    static PresetFeatures analyzePreset(const std::map<std::string, std::string>& presetValues);
+
+    const std::vector<PresetFeatures>& presets() const { return m_presets; }
+    int threads() const { return m_pool.size(); }
+    const std::string& error() const { return m_error; }
+
+private:
+    WorkerPool m_pool;
+    std::vector<PresetFeatures> m_presets;
+    std::string m_error;
+};
@@ -0,0 +1,487 @@
+#include "PackIndex.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+namespace {
+
+constexpr char kMagic[4] = {'M', 'D', 'P', 'X'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 16;
+constexpr size_t kNameSize = 24;
+constexpr size_t kEntrySize = 40;
+
+struct ColumnSpec
+{
+    const char* name;
+    PackColumnType type;
+    std::function<double(const PresetFeatures&)> value; // unused for String columns
+};
+
+const std::vector<ColumnSpec>& columnSpecs()
+{
+    using F = const PresetFeatures&;
+    static const std::vector<ColumnSpec> specs = {
+        {"path", PackColumnType::String, nullptr},
+        {"parsed", PackColumnType::Int32, [](F f) { return f.parsed; }},
+        {"wave_mode", PackColumnType::Int32, [](F f) { return f.waveMode; }},
+        {"wave_supported", PackColumnType::Int32, [](F f) { return f.waveSupported; }},
+        {"custom_waves", PackColumnType::Int32, [](F f) { return f.customWaves; }},
+        {"custom_shapes", PackColumnType::Int32, [](F f) { return f.customShapes; }},
+        {"motion_vectors", PackColumnType::Int32, [](F f) { return f.motionVectors; }},
+        {"warp_shader", PackColumnType::Int32, [](F f) { return f.warpShader; }},
+        {"comp_shader", PackColumnType::Int32, [](F f) { return f.compShader; }},
+        {"post_composite", PackColumnType::Int32, [](F f) { return f.postComposite; }},
+        {"uses_loop", PackColumnType::Int32, [](F f) { return f.usesLoop; }},
+        {"uses_megabuf", PackColumnType::Int32, [](F f) { return f.usesMegabuf; }},
+        {"frame_statements", PackColumnType::Int32, [](F f) { return f.frameStatements; }},
+        {"pixel_statements", PackColumnType::Int32, [](F f) { return f.pixelStatements; }},
+        {"custom_statements", PackColumnType::Int32, [](F f) { return f.customStatements; }},
+        {"cost", PackColumnType::Float32, [](F f) { return f.cost; }},
+        {"rating", PackColumnType::Float32, [](F f) { return f.rating; }},
+    };
+    return specs;
+}
+
+void putU32(std::string& bytes, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        bytes.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void putU64(std::string& bytes, uint64_t value)
+{
+    putU32(bytes, static_cast<uint32_t>(value));
+    putU32(bytes, static_cast<uint32_t>(value >> 32));
+}
+
+uint32_t getU32(const unsigned char* bytes)
+{
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+uint64_t getU64(const unsigned char* bytes)
+{
+    return static_cast<uint64_t>(getU32(bytes)) | (static_cast<uint64_t>(getU32(bytes + 4)) << 32);
+}
+
+/// Encoded column data for @p spec over all rows.
+std::string encodeColumn(const ColumnSpec& spec, const std::vector<PresetFeatures>& presets)
+{
+    std::string bytes;
+    if (spec.type == PackColumnType::String)
+    {
+        uint32_t offset = 0;
+        putU32(bytes, offset);
+        for (const auto& features : presets)
+        {
+            offset += static_cast<uint32_t>(features.path.size());
+            putU32(bytes, offset);
+        }
+        for (const auto& features : presets)
+        {
+            bytes += features.path;
+        }
+        return bytes;
+    }
+    bytes.reserve(presets.size() * 4);
+    for (const auto& features : presets)
+    {
+        const double value = spec.value(features);
+        if (spec.type == PackColumnType::Float32)
+        {
+            const float single = static_cast<float>(value);
+            uint32_t bits;
+            std::memcpy(&bits, &single, sizeof(bits));
+            putU32(bytes, bits);
+        }
+        else
+        {
+            putU32(bytes, static_cast<uint32_t>(static_cast<int32_t>(value)));
+        }
+    }
+    return bytes;
+}
+
+std::string lower(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+/// Splits a query into words, numbers and operators.
+std::vector<std::string> tokenize(const std::string& text)
+{
+    std::vector<std::string> tokens;
+    size_t i = 0;
+    while (i < text.size())
+    {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        if (std::isspace(c))
+        {
+            ++i;
+        }
+        else if (std::strchr("=!<>", c))
+        {
+            const bool twoChars = i + 1 < text.size() && text[i + 1] == '=';
+            tokens.push_back(text.substr(i, twoChars ? 2 : 1));
+            i += twoChars ? 2 : 1;
+        }
+        else if (text.compare(i, 2, "&&") == 0)
+        {
+            tokens.push_back("and");
+            i += 2;
+        }
+        else
+        {
+            size_t end = i;
+            while (end < text.size() && !std::isspace(static_cast<unsigned char>(text[end])) &&
+                   !std::strchr("=!<>&", text[end]))
+            {
+                ++end;
+            }
+            if (end == i)
+            {
+                tokens.push_back(text.substr(i, 1));
+                ++end;
+            }
+            else
+            {
+                tokens.push_back(text.substr(i, end - i));
+            }
+            i = end;
+        }
+    }
+    return tokens;
+}
+
+} // namespace
+
+const std::vector<std::string>& packColumnNames()
+{
+    static const std::vector<std::string> names = [] {
+        std::vector<std::string> result;
+        for (const auto& spec : columnSpecs())
+        {
+            result.push_back(spec.name);
+        }
+        return result;
+    }();
+    return names;
+}
+
+bool PackIndexWriter::write(const std::string& path, const std::vector<PresetFeatures>& presets)
+{
+    const auto& specs = columnSpecs();
+    std::vector<std::string> columns;
+    columns.reserve(specs.size());
+    for (const auto& spec : specs)
+    {
+        columns.push_back(encodeColumn(spec, presets));
+    }
+
+    std::string header(kMagic, sizeof(kMagic));
+    putU32(header, kVersion);
+    putU32(header, static_cast<uint32_t>(presets.size()));
+    putU32(header, static_cast<uint32_t>(specs.size()));
+    uint64_t offset = kHeaderSize + kEntrySize * specs.size();
+    for (size_t i = 0; i < specs.size(); ++i)
+    {
+        std::string name(specs[i].name);
+        name.resize(kNameSize, '\0');
+        header += name;
+        putU32(header, static_cast<uint32_t>(specs[i].type));
+        putU32(header, 0);
+        putU64(header, offset);
+        offset += columns[i].size();
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        return fail("Could not open " + path + " for writing");
+    }
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+    for (const auto& column : columns)
+    {
+        file.write(column.data(), static_cast<std::streamsize>(column.size()));
+    }
+    if (!file.flush())
+    {
+        return fail("Could not write " + path);
+    }
+    return true;
+}
+
+bool PackIndexWriter::fail(const std::string& message)
+{
+    m_error = message;
+    return false;
+}
+
+bool PackCondition::matches(double columnValue) const
+{
+    switch (op)
+    {
+    case Op::Equal:
+        return columnValue == value;
+    case Op::NotEqual:
+        return columnValue != value;
+    case Op::Less:
+        return columnValue < value;
+    case Op::LessEqual:
+        return columnValue <= value;
+    case Op::Greater:
+        return columnValue > value;
+    case Op::GreaterEqual:
+        return columnValue >= value;
+    }
+    return false;
+}
+
+bool PackQuery::parse(const std::string& text)
+{
+    static const std::map<std::string, PackCondition::Op> operators = {
+        {"=", PackCondition::Op::Equal},      {"==", PackCondition::Op::Equal},
+        {"!=", PackCondition::Op::NotEqual},  {"<", PackCondition::Op::Less},
+        {"<=", PackCondition::Op::LessEqual}, {">", PackCondition::Op::Greater},
+        {">=", PackCondition::Op::GreaterEqual},
+    };
+
+    m_conditions.clear();
+    const std::vector<std::string> tokens = tokenize(text);
+    size_t i = 0;
+    while (i < tokens.size())
+    {
+        PackCondition condition;
+        if (lower(tokens[i]) == "not")
+        {
+            condition.op = PackCondition::Op::Equal;
+            ++i;
+        }
+        if (i >= tokens.size())
+        {
+            return fail("Expected a column name at the end of the query");
+        }
+        condition.column = lower(tokens[i++]);
+        if (std::find(packColumnNames().begin(), packColumnNames().end(), condition.column) == packColumnNames().end())
+        {
+            return fail("Unknown column: " + condition.column);
+        }
+        if (condition.column == "path")
+        {
+            return fail("path is not a numeric column");
+        }
+        if (i < tokens.size() && operators.count(tokens[i]))
+        {
+            if (condition.op == PackCondition::Op::Equal)
+            {
+                return fail("\"not\" takes a bare column name: not " + condition.column);
+            }
+            condition.op = operators.at(tokens[i++]);
+            if (i >= tokens.size())
+            {
+                return fail("Expected a number after " + condition.column + " " + tokens[i - 1]);
+            }
+            char* end = nullptr;
+            condition.value = std::strtod(tokens[i].c_str(), &end);
+            if (end == tokens[i].c_str() || *end != '\0')
+            {
+                return fail("Expected a number, got: " + tokens[i]);
+            }
+            ++i;
+        }
+        m_conditions.push_back(condition);
+        if (i < tokens.size())
+        {
+            if (lower(tokens[i]) != "and")
+            {
+                return fail("Expected \"and\", got: " + tokens[i]);
+            }
+            if (++i >= tokens.size())
+            {
+                return fail("Expected a condition after \"and\"");
+            }
+        }
+    }
+    return true;
+}
+
+bool PackQuery::fail(const std::string& message)
+{
+    m_error = message;
+    return false;
+}
+
+bool PackIndexReader::open(const std::string& path)
+{
+    m_directory.clear();
+    m_numbers.clear();
+    m_strings.clear();
+    m_file.close();
+    m_file.clear();
+    m_file.open(path, std::ios::binary);
+    if (!m_file)
+    {
+        return fail("Could not open " + path);
+    }
+    m_file.seekg(0, std::ios::end);
+    m_fileSize = static_cast<uint64_t>(m_file.tellg());
+
+    unsigned char header[kHeaderSize];
+    if (!readAt(0, header, sizeof(header)) || std::memcmp(header, kMagic, sizeof(kMagic)) != 0)
+    {
+        return fail(path + " is not a pack index");
+    }
+    if (getU32(header + 4) != kVersion)
+    {
+        return fail(path + " has unsupported index version " + std::to_string(getU32(header + 4)));
+    }
+    m_rowCount = getU32(header + 8);
+    const uint32_t columnCount = getU32(header + 12);
+
+    std::vector<unsigned char> entries(kEntrySize * columnCount);
+    if (!readAt(kHeaderSize, entries.data(), entries.size()))
+    {
+        return fail(path + " has a truncated column directory");
+    }
+    for (uint32_t i = 0; i < columnCount; ++i)
+    {
+        const unsigned char* entry = entries.data() + kEntrySize * i;
+        const char* name = reinterpret_cast<const char*>(entry);
+        Column column;
+        column.type = static_cast<PackColumnType>(getU32(entry + kNameSize));
+        column.offset = getU64(entry + kNameSize + 8);
+        m_directory[std::string(name, strnlen(name, kNameSize))] = column;
+    }
+    return true;
+}
+
+bool PackIndexReader::isNumeric(const std::string& name) const
+{
+    auto it = m_directory.find(name);
+    return it != m_directory.end() && it->second.type != PackColumnType::String;
+}
+
+const std::vector<double>* PackIndexReader::numbers(const std::string& name)
+{
+    auto cached = m_numbers.find(name);
+    if (cached != m_numbers.end())
+    {
+        return &cached->second;
+    }
+    auto it = m_directory.find(name);
+    if (it == m_directory.end() || it->second.type == PackColumnType::String)
+    {
+        fail("No numeric column named " + name);
+        return nullptr;
+    }
+    std::vector<unsigned char> bytes(static_cast<size_t>(m_rowCount) * 4);
+    if (!readAt(it->second.offset, bytes.data(), bytes.size()))
+    {
+        fail("Column " + name + " is truncated");
+        return nullptr;
+    }
+    std::vector<double> values(m_rowCount);
+    for (size_t row = 0; row < values.size(); ++row)
+    {
+        const uint32_t bits = getU32(bytes.data() + row * 4);
+        if (it->second.type == PackColumnType::Float32)
+        {
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            values[row] = value;
+        }
+        else
+        {
+            values[row] = static_cast<int32_t>(bits);
+        }
+    }
+    return &m_numbers.emplace(name, std::move(values)).first->second;
+}
+
+const std::vector<std::string>* PackIndexReader::strings(const std::string& name)
+{
+    auto cached = m_strings.find(name);
+    if (cached != m_strings.end())
+    {
+        return &cached->second;
+    }
+    auto it = m_directory.find(name);
+    if (it == m_directory.end() || it->second.type != PackColumnType::String)
+    {
+        fail("No string column named " + name);
+        return nullptr;
+    }
+    std::vector<unsigned char> offsets((static_cast<size_t>(m_rowCount) + 1) * 4);
+    if (!readAt(it->second.offset, offsets.data(), offsets.size()))
+    {
+        fail("Column " + name + " is truncated");
+        return nullptr;
+    }
+    std::string text(getU32(offsets.data() + static_cast<size_t>(m_rowCount) * 4), '\0');
+    if (!readAt(it->second.offset + offsets.size(), &text[0], text.size()))
+    {
+        fail("Column " + name + " is truncated");
+        return nullptr;
+    }
+    std::vector<std::string> values(m_rowCount);
+    for (size_t row = 0; row < values.size(); ++row)
+    {
+        const uint32_t begin = getU32(offsets.data() + row * 4);
+        const uint32_t end = getU32(offsets.data() + row * 4 + 4);
+        if (begin > end || end > text.size())
+        {
+            fail("Column " + name + " has invalid offsets");
+            return nullptr;
+        }
+        values[row] = text.substr(begin, end - begin);
+    }
+    return &m_strings.emplace(name, std::move(values)).first->second;
+}
+
+bool PackIndexReader::select(const PackQuery& query, std::vector<uint32_t>& rows)
+{
+    rows.resize(m_rowCount);
+    for (uint32_t row = 0; row < m_rowCount; ++row)
+    {
+        rows[row] = row;
+    }
+    for (const auto& condition : query.conditions())
+    {
+        const std::vector<double>* values = numbers(condition.column);
+        if (!values)
+        {
+            return false;
+        }
+        rows.erase(std::remove_if(rows.begin(), rows.end(),
+                                  [&](uint32_t row) { return !condition.matches((*values)[row]); }),
+                   rows.end());
+    }
+    return true;
+}
+
+bool PackIndexReader::fail(const std::string& message)
+{
+    m_error = message;
+    return false;
+}
+
+bool PackIndexReader::readAt(uint64_t offset, void* data, size_t size)
+{
+    if (offset + size > m_fileSize)
+    {
+        return false;
+    }
+    m_file.clear();
+    m_file.seekg(static_cast<std::streamoff>(offset));
+    m_file.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+    return static_cast<size_t>(m_file.gcount()) == size;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "PackAnalyzer.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Columnar index of a preset pack (.mdpx), one column per PresetFeatures field.
+ *
+ * File layout, little-endian:
+ * - Header (16 bytes): "MDPX", uint32 version, uint32 row count, uint32 column count.
+ * - Column directory, 40 bytes per column: char name[24] (zero padded), uint32 type,
+ *   uint32 reserved, uint64 byte offset of the column data from the start of the file.
+ * - Column data. Int32 and Float32 columns hold one value per row; String columns hold
+ *   row count + 1 uint32 offsets followed by the concatenated UTF-8 bytes.
+ *
+ * A query reads the directory and then only the columns it names, so filtering 50k presets
+ * on two numeric columns touches a few hundred kilobytes.
+ */
+enum class PackColumnType : uint32_t
+{
+    Int32 = 1,
+    Float32 = 2,
+    String = 3
+};
+
+/// Names of the index columns in file order: path, then the PresetFeatures fields in snake case.
+const std::vector<std::string>& packColumnNames();
+
+/** @brief Writes PresetFeatures rows as a .mdpx index. */
+class PackIndexWriter
+{
+public:
+    bool write(const std::string& path, const std::vector<PresetFeatures>& presets);
+
+    const std::string& error() const { return m_error; }
+
+private:
+    bool fail(const std::string& message);
+
+    std::string m_error;
+};
+
+/**
+ * @brief One "column op number" term of a PackQuery.
+ *
+ * Boolean columns hold 0 and 1, so "custom_shapes = 0" and "uses_loop = 1" both work; a bare
+ * column name means "column != 0" and "not column" means "column = 0".
+ */
+struct PackCondition
+{
+    enum class Op
+    {
+        Equal,
+        NotEqual,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual
+    };
+
+    std::string column;
+    Op op{Op::NotEqual};
+    double value{0.0};
+
+    bool matches(double columnValue) const;
+};
+
+/** @brief Conjunction of conditions on numeric columns, e.g. "wave_mode = 8 and cost < 27000". */
+class PackQuery
+{
+public:
+    /// Parses @p text; an empty text matches every row.
+    bool parse(const std::string& text);
+
+    const std::vector<PackCondition>& conditions() const { return m_conditions; }
+    const std::string& error() const { return m_error; }
+
+private:
+    bool fail(const std::string& message);
+
+    std::vector<PackCondition> m_conditions;
+    std::string m_error;
+};
+
+/**
+ * @brief Reads a .mdpx index, loading each column on first use.
+ */
+class PackIndexReader
+{
+public:
+    bool open(const std::string& path);
+
+    uint32_t rowCount() const { return m_rowCount; }
+    bool hasColumn(const std::string& name) const { return m_directory.count(name) != 0; }
+    bool isNumeric(const std::string& name) const;
+
+    /// Values of a numeric column as doubles; nullptr (see error()) if it is missing or unreadable.
+    const std::vector<double>* numbers(const std::string& name);
+    /// Values of a String column.
+    const std::vector<std::string>* strings(const std::string& name);
+
+    /// Rows matching every condition of @p query, ascending. Reads only the named columns.
+    bool select(const PackQuery& query, std::vector<uint32_t>& rows);
+
+    const std::string& error() const { return m_error; }
+
+private:
+    struct Column
+    {
+        PackColumnType type{PackColumnType::Int32};
+        uint64_t offset{0};
+    };
+
+    bool fail(const std::string& message);
+    bool readAt(uint64_t offset, void* data, size_t size);
+
+    std::ifstream m_file;
+    uint64_t m_fileSize{0};
+    uint32_t m_rowCount{0};
+    std::map<std::string, Column> m_directory;
+    std::map<std::string, std::vector<double>> m_numbers;
+    std::map<std::string, std::vector<std::string>> m_strings;
+    std::string m_error;
+};
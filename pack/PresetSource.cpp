@@ -0,0 +1,131 @@
+#include "PresetSource.hpp"
+
+#include "MemoryStreamBuffer.hpp"
+#include "PresetFileParser.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <istream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool isPreset(const fs::path& path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".milk";
+}
+
+} // namespace
+
+bool findPresets(const std::string& root, std::vector<std::string>& presets, std::string& error)
+{
+    presets.clear();
+    std::error_code code;
+    if (!fs::is_directory(root, code))
+    {
+        error = "Not a directory: " + root;
+        return false;
+    }
+    for (fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, code), end;
+         !code && it != end; it.increment(code))
+    {
+        if (it->is_regular_file(code) && isPreset(it->path()))
+        {
+            presets.push_back(it->path().lexically_relative(root).generic_string());
+        }
+    }
+    if (code)
+    {
+        error = "Could not list " + root + ": " + code.message();
+        return false;
+    }
+    std::sort(presets.begin(), presets.end());
+    return true;
+}
+
+bool PresetSource::open(const std::string& path)
+{
+    m_root = path;
+    m_presets.clear();
+    m_entries.clear();
+    m_archive.close();
+    m_archiveOpen = false;
+    m_error.clear();
+
+    std::error_code code;
+    if (!fs::is_regular_file(path, code))
+    {
+        return findPresets(path, m_presets, m_error);
+    }
+    if (!m_archive.open(path))
+    {
+        m_error = m_archive.error();
+        return false;
+    }
+    m_archiveOpen = true;
+
+    const auto& entries = m_archive.entries();
+    std::vector<size_t> order;
+    for (size_t entry = 0; entry < entries.size(); ++entry)
+    {
+        const std::string& name = entries[entry].name;
+        if (!name.empty() && name.back() != '/' && name.compare(0, 9, "__MACOSX/") != 0 && isPreset(name))
+        {
+            order.push_back(entry);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return entries[a].name < entries[b].name; });
+    for (size_t entry : order)
+    {
+        m_presets.push_back(entries[entry].name);
+        m_entries.push_back(entry);
+    }
+    return true;
+}
+
+bool PresetSource::read(size_t index, std::vector<char>& buffer) const
+{
+    if (m_archiveOpen)
+    {
+        std::string error;
+        return m_archive.read(m_archive.entries()[m_entries[index]], buffer, error,
+                              libprojectM::PresetFileParser::maxFileSize);
+    }
+
+    const std::string path = (fs::path(m_root) / m_presets[index]).string();
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    // The size comes first so that the buffer is never grown past the preset.
+    const bool sized = std::fseek(file, 0, SEEK_END) == 0;
+    const long size = sized ? std::ftell(file) : -1;
+    bool ok = size >= 0 && static_cast<size_t>(size) <= libprojectM::PresetFileParser::maxFileSize &&
+              std::fseek(file, 0, SEEK_SET) == 0;
+    if (ok)
+    {
+        buffer.resize(static_cast<size_t>(size));
+        ok = std::fread(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    }
+    std::fclose(file);
+    return ok;
+}
+
+bool PresetSource::parse(size_t index, libprojectM::PresetFileParser& parser, std::vector<char>& buffer) const
+{
+    if (!read(index, buffer))
+    {
+        return false;
+    }
+    MemoryStreamBuffer streamBuffer(buffer.data(), buffer.size());
+    std::istream stream(&streamBuffer);
+    return parser.Read(stream);
+}
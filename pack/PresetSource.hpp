@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ZipArchive.hpp"
+
+#include <string>
+#include <vector>
+
+namespace libprojectM {
+class PresetFileParser;
+}
+
+/// Paths of the .milk files below @p root (recursively, case-insensitive extension), relative
+/// to it with '/' separators and sorted.
+bool findPresets(const std::string& root, std::vector<std::string>& presets, std::string& error);
+
+/**
+ * @brief The presets of a pack: a directory tree, or a zip archive read without extracting it.
+ *
+ * open() lists the .milk files once, sorted, so a pack gives the same preset order whether it
+ * is extracted or not. parse() reads one preset into a buffer the caller keeps between presets
+ * (one per worker) and hands it to PresetFileParser::Read(std::istream&) through a stream
+ * over that buffer. Archives are memory-mapped and their entries inflated on demand; parse()
+ * may run on several threads at once. Archive entries below @c __MACOSX/ (resource forks that
+ * Finder adds) are not presets.
+ */
+class PresetSource
+{
+public:
+    /// Opens a directory, or a zip archive when @p path is a regular file.
+    bool open(const std::string& path);
+
+    /// Paths of the presets, relative to the directory or archive root.
+    const std::vector<std::string>& presets() const { return m_presets; }
+    bool isArchive() const { return m_archiveOpen; }
+
+    /// Replaces @p buffer with the bytes of preset @p index; fails for files larger than
+    /// PresetFileParser::maxFileSize.
+    bool read(size_t index, std::vector<char>& buffer) const;
+
+    /// Reads preset @p index through @p buffer into @p parser.
+    bool parse(size_t index, libprojectM::PresetFileParser& parser, std::vector<char>& buffer) const;
+
+    const std::string& error() const { return m_error; }
+
+private:
+    std::string m_root;
+    ZipArchive m_archive;
+    bool m_archiveOpen{false};
+    std::vector<std::string> m_presets;
+    std::vector<size_t> m_entries; //!< Archive entry of each preset
+    std::string m_error;
+};
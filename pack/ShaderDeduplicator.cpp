@@ -0,0 +1,388 @@
+#include "ShaderDeduplicator.hpp"
+
+#include "TranslationCache.hpp"
+
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+
+namespace {
+
+constexpr int kUnset = -1;
+constexpr int kConflict = -2;
+constexpr int kEdge = -3; // start or end of a shader
+
+// Smaller chunks, such as a single annotated uniform, stay inline: their include line saves
+// little and splits the shader into fragments.
+constexpr size_t kMinimumChunkBytes = 256;
+
+std::string trim(const std::string& text)
+{
+    const size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos)
+    {
+        return "";
+    }
+    return text.substr(begin, text.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+bool startsWith(const std::string& text, const char* prefix)
+{
+    return text.compare(0, std::char_traits<char>::length(prefix), prefix) == 0;
+}
+
+/// Code of @p line without comments; @p inComment carries an open block comment across lines.
+std::string stripComments(const std::string& line, bool& inComment)
+{
+    std::string code;
+    for (size_t i = 0; i < line.size(); ++i)
+    {
+        if (inComment)
+        {
+            if (line.compare(i, 2, "*/") == 0)
+            {
+                inComment = false;
+                ++i;
+            }
+        }
+        else if (line.compare(i, 2, "/*") == 0)
+        {
+            inComment = true;
+            ++i;
+        }
+        else if (line.compare(i, 2, "//") == 0)
+        {
+            break;
+        }
+        else
+        {
+            code += line[i];
+        }
+    }
+    return code;
+}
+
+/// Code that belongs to one preset, or must stay at the top of the shader itself: #version,
+/// #extension, main() and the annotated preset uniforms ("uniform float u_zoom = 1.0;").
+bool presetSpecific(const std::string& unit)
+{
+    bool inComment = false;
+    size_t start = 0;
+    while (start < unit.size())
+    {
+        size_t end = unit.find('\n', start);
+        end = end == std::string::npos ? unit.size() : end + 1;
+        const std::string code = trim(stripComments(unit.substr(start, end - start), inComment));
+        start = end;
+        if (code.empty())
+        {
+            continue;
+        }
+        return startsWith(code, "#version") || startsWith(code, "#extension") || startsWith(code, "void main") ||
+               (startsWith(code, "uniform ") && code.find('=') != std::string::npos);
+    }
+    return false;
+}
+
+std::string chunkName(const std::string& glsl)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.glsl", static_cast<unsigned long long>(TranslationCache::contentHash(glsl)));
+    return name;
+}
+
+std::string includeLine(const std::string& name)
+{
+    return std::string("#include \"") + ShaderDeduplicator::kIncludeDirectory + name + "\"\n";
+}
+
+} // namespace
+
+std::vector<std::string> ShaderDeduplicator::splitUnits(const std::string& glsl)
+{
+    std::vector<std::string> units;
+    std::string current;
+    int braces = 0;
+    int conditionals = 0;
+    bool inComment = false;
+    size_t start = 0;
+    while (start < glsl.size())
+    {
+        size_t end = glsl.find('\n', start);
+        end = end == std::string::npos ? glsl.size() : end + 1;
+        const std::string line = glsl.substr(start, end - start);
+        start = end;
+        current += line;
+
+        const std::string code = trim(stripComments(line, inComment));
+        if (code.empty())
+        {
+            continue; // comments and blank lines belong to the next unit
+        }
+        if (code[0] == '#')
+        {
+            if (startsWith(code, "#if"))
+            {
+                ++conditionals;
+            }
+            else if (startsWith(code, "#endif"))
+            {
+                --conditionals;
+            }
+        }
+        for (char c : code)
+        {
+            braces += c == '{' ? 1 : (c == '}' ? -1 : 0);
+        }
+        const char last = code.back();
+        if (braces == 0 && conditionals == 0 && !inComment && (code[0] == '#' || last == ';' || last == '}'))
+        {
+            units.push_back(std::move(current));
+            current.clear();
+        }
+    }
+    if (!current.empty())
+    {
+        units.push_back(std::move(current));
+    }
+    return units;
+}
+
+size_t ShaderDeduplicator::add(std::string glsl)
+{
+    m_input.push_back(std::move(glsl));
+    return m_input.size() - 1;
+}
+
+void ShaderDeduplicator::build()
+{
+    m_output.clear();
+    m_chunks.clear();
+    m_stats = DeduplicationStats();
+    m_stats.shaders = m_input.size();
+
+    // Number the distinct units and note, for each, the unit before and after it wherever
+    // it occurs. A unit whose neighbours always agree can be merged with them.
+    std::unordered_map<std::string, int> ids;
+    std::vector<const std::string*> units;
+    std::vector<std::vector<int>> sequences;
+    for (const auto& glsl : m_input)
+    {
+        m_stats.inputBytes += glsl.size();
+        std::vector<int> sequence;
+        for (auto& unit : splitUnits(glsl))
+        {
+            auto it = ids.emplace(std::move(unit), static_cast<int>(units.size())).first;
+            if (it->second == static_cast<int>(units.size()))
+            {
+                units.push_back(&it->first);
+            }
+            sequence.push_back(it->second);
+        }
+        m_stats.inputChunks += sequence.size();
+        sequences.push_back(std::move(sequence));
+    }
+    m_stats.uniqueInputChunks = units.size();
+
+    std::vector<int> next(units.size(), kUnset);
+    std::vector<int> previous(units.size(), kUnset);
+    auto note = [](int& slot, int neighbour) { slot = slot == kUnset || slot == neighbour ? neighbour : kConflict; };
+    for (const auto& sequence : sequences)
+    {
+        for (size_t i = 0; i < sequence.size(); ++i)
+        {
+            note(next[sequence[i]], i + 1 < sequence.size() ? sequence[i + 1] : kEdge);
+            note(previous[sequence[i]], i > 0 ? sequence[i - 1] : kEdge);
+        }
+    }
+    std::vector<bool> fixed(units.size());
+    for (size_t id = 0; id < units.size(); ++id)
+    {
+        fixed[id] = presetSpecific(*units[id]);
+    }
+    auto mergeable = [&](int first, int second) {
+        return first != second && next[first] == second && previous[second] == first && !fixed[first] && !fixed[second];
+    };
+
+    // Merge each shader's units into chunks. Merging depends only on the unit ids, so a chunk
+    // is cut the same way in every shader that contains it.
+    struct Piece
+    {
+        std::string glsl;
+        size_t units{0};
+        bool fixed{false};
+    };
+    std::vector<std::vector<size_t>> shaderPieces(sequences.size());
+    std::vector<Piece> pieces;
+    std::map<std::string, size_t> pieceIndex;
+    std::vector<size_t> references;
+    for (size_t shader = 0; shader < sequences.size(); ++shader)
+    {
+        const auto& sequence = sequences[shader];
+        for (size_t i = 0; i < sequence.size(); ++i)
+        {
+            Piece piece{*units[sequence[i]], 1, fixed[sequence[i]]};
+            while (i + 1 < sequence.size() && mergeable(sequence[i], sequence[i + 1]))
+            {
+                piece.glsl += *units[sequence[++i]];
+                ++piece.units;
+            }
+            auto it = pieceIndex.emplace(piece.glsl, pieces.size()).first;
+            if (it->second == pieces.size())
+            {
+                pieces.push_back(std::move(piece));
+                references.push_back(0);
+            }
+            ++references[it->second];
+            shaderPieces[shader].push_back(it->second);
+        }
+    }
+
+    // The helper code between two preset-specific units is usually the same for every preset
+    // with the same feature combination (wave mode, custom waves and shapes, passes). Such a
+    // run becomes one chunk when it recurs whole, so those shaders need a single include;
+    // the pieces of a run seen only once are shared one by one.
+    std::vector<std::vector<std::vector<size_t>>> shaderRuns(sequences.size());
+    std::map<std::vector<size_t>, size_t> runCounts;
+    for (size_t shader = 0; shader < sequences.size(); ++shader)
+    {
+        std::vector<size_t> run;
+        auto flush = [&]() {
+            if (!run.empty())
+            {
+                ++runCounts[run];
+                shaderRuns[shader].push_back(std::move(run));
+                run.clear();
+            }
+        };
+        for (size_t index : shaderPieces[shader])
+        {
+            if (!pieces[index].fixed)
+            {
+                run.push_back(index);
+                continue;
+            }
+            flush();
+            shaderRuns[shader].push_back({index});
+        }
+        flush();
+    }
+
+    std::map<std::vector<size_t>, size_t> segmentIndex;
+    std::vector<std::vector<size_t>> segments;
+    std::vector<size_t> segmentReferences;
+    std::vector<std::vector<size_t>> shaderSegments(sequences.size());
+    auto addSegment = [&](size_t shader, std::vector<size_t> segment) {
+        auto it = segmentIndex.emplace(std::move(segment), segments.size()).first;
+        if (it->second == segments.size())
+        {
+            segments.push_back(it->first);
+            segmentReferences.push_back(0);
+        }
+        ++segmentReferences[it->second];
+        shaderSegments[shader].push_back(it->second);
+    };
+    for (size_t shader = 0; shader < sequences.size(); ++shader)
+    {
+        for (auto& run : shaderRuns[shader])
+        {
+            if (run.size() > 1 && runCounts[run] >= 2)
+            {
+                addSegment(shader, std::move(run));
+                continue;
+            }
+            for (size_t index : run)
+            {
+                addSegment(shader, {index});
+            }
+        }
+    }
+
+    // Share a segment when it is used twice or more and is large enough.
+    std::vector<int> shared(segments.size(), -1);
+    std::vector<size_t> segmentUnits(segments.size());
+    std::map<std::string, size_t> names;
+    for (size_t segment = 0; segment < segments.size(); ++segment)
+    {
+        std::string glsl;
+        bool fixedPiece = false;
+        for (size_t index : segments[segment])
+        {
+            glsl += pieces[index].glsl;
+            segmentUnits[segment] += pieces[index].units;
+            fixedPiece = fixedPiece || pieces[index].fixed;
+        }
+        const std::string name = chunkName(glsl);
+        if (segmentReferences[segment] < 2 || fixedPiece || glsl.back() != '\n' ||
+            glsl.size() < kMinimumChunkBytes || !names.emplace(name, segment).second)
+        {
+            continue;
+        }
+        shared[segment] = static_cast<int>(m_chunks.size());
+        m_stats.sharedChunkBytes += glsl.size();
+        m_stats.outputChunks += segmentUnits[segment];
+        m_chunks.push_back({name, std::move(glsl), segmentReferences[segment]});
+    }
+    m_stats.sharedChunks = m_chunks.size();
+
+    for (const auto& indices : shaderSegments)
+    {
+        std::string glsl;
+        bool includes = false;
+        for (size_t segment : indices)
+        {
+            if (shared[segment] >= 0)
+            {
+                glsl += includeLine(m_chunks[static_cast<size_t>(shared[segment])].name);
+                includes = true;
+                ++m_stats.includeReferences;
+                continue;
+            }
+            for (size_t index : segments[segment])
+            {
+                glsl += pieces[index].glsl;
+            }
+            m_stats.outputChunks += segmentUnits[segment];
+        }
+        if (includes)
+        {
+            // The extension goes right after #version, or first when there is none.
+            const size_t version = glsl.compare(0, 8, "#version") == 0 ? glsl.find('\n') + 1 : 0;
+            glsl.insert(version, kIncludeExtension);
+        }
+        m_stats.outputShaderBytes += glsl.size();
+        m_output.push_back(std::move(glsl));
+    }
+}
+
+bool ShaderDeduplicator::expand(const std::string& glsl,
+                                const std::function<bool(const std::string&, std::string&)>& lookup,
+                                std::string& expanded)
+{
+    const std::string prefix = std::string("#include \"") + kIncludeDirectory;
+    expanded.clear();
+    size_t start = 0;
+    while (start < glsl.size())
+    {
+        size_t end = glsl.find('\n', start);
+        end = end == std::string::npos ? glsl.size() : end + 1;
+        const std::string line = glsl.substr(start, end - start);
+        start = end;
+        if (line == kIncludeExtension)
+        {
+            continue;
+        }
+        if (startsWith(line, prefix.c_str()) && line.size() > prefix.size() + 2 && line.compare(line.size() - 2, 2, "\"\n") == 0)
+        {
+            std::string chunk;
+            if (!lookup(line.substr(prefix.size(), line.size() - prefix.size() - 2), chunk))
+            {
+                return false;
+            }
+            expanded += chunk;
+            continue;
+        }
+        expanded += line;
+    }
+    return true;
+}
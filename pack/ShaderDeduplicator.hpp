@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Byte and chunk totals of a set of shaders before and after deduplication.
+ *
+ * A chunk is a top-level GLSL unit: a function, a declaration or a preprocessor block,
+ * with the comments and blank lines before it.
+ */
+struct DeduplicationStats
+{
+    size_t shaders{0};
+    size_t inputBytes{0};
+    size_t inputChunks{0};       //!< Top-level units over all shaders
+    size_t uniqueInputChunks{0}; //!< Distinct units
+    size_t outputShaderBytes{0}; //!< Rewritten shaders, include lines included
+    size_t sharedChunks{0};      //!< Include units written once
+    size_t sharedChunkBytes{0};
+    size_t outputChunks{0};      //!< Units stored afterwards: inline ones per shader, shared ones once
+    size_t includeReferences{0};
+
+    size_t outputBytes() const { return outputShaderBytes + sharedChunkBytes; }
+};
+
+/**
+ * @brief Factors the helper code that converted shaders repeat into shared include units.
+ *
+ * Every shader is split into top-level units. The #version line, the annotated preset
+ * uniforms and main() stay in the shader; the helper code between them is shared. A run of
+ * helper units that recurs whole (the preamble, the float_from_bool through *_eel helpers and
+ * the wave helper library of one feature combination) becomes one chunk; otherwise units that
+ * always follow each other in every shader are merged and shared as smaller chunks. Chunks
+ * used more than once are replaced by
+ * @code #include "/milkdrop/<hash>.glsl" @endcode, where the hash is
+ * TranslationCache::contentHash() of the chunk, and the shader gets
+ * @c GL_ARB_shading_language_include after its @c #version line. A host can register the
+ * chunks as named strings, compile them once as its own shader cache key, or inline them
+ * with expand(), which restores the original text byte for byte.
+ */
+class ShaderDeduplicator
+{
+public:
+    struct Chunk
+    {
+        std::string name; //!< "<16 hex digit hash>.glsl"
+        std::string glsl;
+        size_t references{0};
+    };
+
+    static constexpr const char* kIncludeDirectory = "/milkdrop/";
+    static constexpr const char* kIncludeExtension = "#extension GL_ARB_shading_language_include : require\n";
+
+    /// Adds a shader and returns its index in shaders().
+    size_t add(std::string glsl);
+
+    /// Chooses the shared chunks and rewrites every added shader.
+    void build();
+
+    /// The shaders as added, and as rewritten by build().
+    const std::vector<std::string>& inputs() const { return m_input; }
+    const std::vector<std::string>& shaders() const { return m_output; }
+    const std::vector<Chunk>& chunks() const { return m_chunks; }
+    const DeduplicationStats& stats() const { return m_stats; }
+
+    /// Top-level units of @p glsl; concatenated, they give back @p glsl.
+    static std::vector<std::string> splitUnits(const std::string& glsl);
+
+    /// Inlines the include lines of a rewritten shader; @p lookup returns the text of a chunk
+    /// by name, or false if it is unknown.
+    static bool expand(const std::string& glsl, const std::function<bool(const std::string&, std::string&)>& lookup,
+                       std::string& expanded);
+
+private:
+    std::vector<std::string> m_input;
+    std::vector<std::string> m_output;
+    std::vector<Chunk> m_chunks;
+    DeduplicationStats m_stats;
+};
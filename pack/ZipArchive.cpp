@@ -0,0 +1,312 @@
+#include "ZipArchive.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef MILKDROP_PACK_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+constexpr uint32_t kLocalHeader = 0x04034b50;
+constexpr uint32_t kCentralHeader = 0x02014b50;
+constexpr uint32_t kEndOfDirectory = 0x06054b50;
+constexpr uint32_t kZip64EndOfDirectory = 0x06064b50;
+constexpr uint32_t kZip64Locator = 0x07064b50;
+constexpr uint16_t kZip64Extra = 0x0001;
+
+constexpr size_t kLocalHeaderSize = 30;
+constexpr size_t kCentralHeaderSize = 46;
+constexpr size_t kEndOfDirectorySize = 22;
+constexpr size_t kZip64LocatorSize = 20;
+constexpr size_t kZip64EndOfDirectorySize = 56;
+constexpr size_t kMaxCommentSize = 0xFFFF;
+
+uint16_t getU16(const unsigned char* data)
+{
+    return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+uint32_t getU32(const unsigned char* data)
+{
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+           (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+uint64_t getU64(const unsigned char* data)
+{
+    return static_cast<uint64_t>(getU32(data)) | (static_cast<uint64_t>(getU32(data + 4)) << 32);
+}
+
+#ifdef MILKDROP_PACK_ZLIB
+/// One raw inflate stream per thread, reset between entries rather than reallocated.
+class Inflater
+{
+public:
+    Inflater()
+    {
+        std::memset(&m_stream, 0, sizeof(m_stream));
+        m_ready = inflateInit2(&m_stream, -MAX_WBITS) == Z_OK;
+    }
+
+    ~Inflater()
+    {
+        if (m_ready)
+        {
+            inflateEnd(&m_stream);
+        }
+    }
+
+    bool inflate(const unsigned char* input, uint64_t inputSize, char* output, uint64_t outputSize)
+    {
+        if (!m_ready || inputSize > UINT32_MAX || outputSize > UINT32_MAX || inflateReset(&m_stream) != Z_OK)
+        {
+            return false;
+        }
+        m_stream.next_in = const_cast<Bytef*>(input);
+        m_stream.avail_in = static_cast<uInt>(inputSize);
+        m_stream.next_out = reinterpret_cast<Bytef*>(output);
+        m_stream.avail_out = static_cast<uInt>(outputSize);
+        return ::inflate(&m_stream, Z_FINISH) == Z_STREAM_END && m_stream.avail_out == 0;
+    }
+
+private:
+    z_stream m_stream;
+    bool m_ready{false};
+};
+#endif
+
+} // namespace
+
+ZipArchive::~ZipArchive()
+{
+    close();
+}
+
+void ZipArchive::close()
+{
+    if (m_data != nullptr)
+    {
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_entries.clear();
+}
+
+bool ZipArchive::fail(const std::string& message)
+{
+    m_error = message;
+    close();
+    return false;
+}
+
+bool ZipArchive::open(const std::string& path)
+{
+    close();
+    m_error.clear();
+
+    const int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return fail("Could not open " + path);
+    }
+    struct stat status{};
+    if (fstat(file, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        ::close(file);
+        return fail("Not a regular file: " + path);
+    }
+    m_size = static_cast<size_t>(status.st_size);
+    if (m_size < kEndOfDirectorySize)
+    {
+        ::close(file);
+        return fail("Not a zip archive: " + path);
+    }
+    void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (mapping == MAP_FAILED)
+    {
+        m_size = 0;
+        return fail("Could not map " + path);
+    }
+    m_data = static_cast<const unsigned char*>(mapping);
+
+    // The end of central directory record closes the file, followed only by its comment.
+    const size_t searchStart = m_size > kEndOfDirectorySize + kMaxCommentSize ? m_size - kEndOfDirectorySize - kMaxCommentSize : 0;
+    size_t end = m_size - kEndOfDirectorySize + 1;
+    do
+    {
+        --end;
+    } while (end > searchStart && getU32(m_data + end) != kEndOfDirectory);
+    if (getU32(m_data + end) != kEndOfDirectory)
+    {
+        return fail("Not a zip archive (no end of central directory): " + path);
+    }
+    uint64_t count = getU16(m_data + end + 10);
+    uint64_t directorySize = getU32(m_data + end + 12);
+    uint64_t directoryOffset = getU32(m_data + end + 16);
+
+    if (end >= kZip64LocatorSize && getU32(m_data + end - kZip64LocatorSize) == kZip64Locator)
+    {
+        const uint64_t record = getU64(m_data + end - kZip64LocatorSize + 8);
+        if (m_size < kZip64EndOfDirectorySize || record > m_size - kZip64EndOfDirectorySize ||
+            getU32(m_data + record) != kZip64EndOfDirectory)
+        {
+            return fail("Damaged ZIP64 end of central directory: " + path);
+        }
+        count = getU64(m_data + record + 32);
+        directorySize = getU64(m_data + record + 40);
+        directoryOffset = getU64(m_data + record + 48);
+    }
+    if (directoryOffset > m_size || directorySize > m_size - directoryOffset)
+    {
+        return fail("Central directory lies outside the file: " + path);
+    }
+    if (!readDirectory(directoryOffset, directorySize, count))
+    {
+        return fail(m_error + ": " + path);
+    }
+    // Entries are read in directory order, which is the order they were written in, and their
+    // pages are only touched as they are inflated: ask for aggressive read-ahead behind them.
+    madvise(const_cast<unsigned char*>(m_data), m_size, MADV_SEQUENTIAL);
+    return true;
+}
+
+bool ZipArchive::readDirectory(uint64_t offset, uint64_t size, uint64_t count)
+{
+    m_entries.reserve(static_cast<size_t>(std::min<uint64_t>(count, size / kCentralHeaderSize)));
+    const unsigned char* record = m_data + offset;
+    const unsigned char* end = record + size;
+    for (uint64_t index = 0; index < count; ++index)
+    {
+        if (static_cast<size_t>(end - record) < kCentralHeaderSize || getU32(record) != kCentralHeader)
+        {
+            m_error = "Damaged central directory";
+            return false;
+        }
+        const size_t nameSize = getU16(record + 28);
+        const size_t extraSize = getU16(record + 30);
+        const size_t commentSize = getU16(record + 32);
+        if (static_cast<size_t>(end - record) < kCentralHeaderSize + nameSize + extraSize + commentSize)
+        {
+            m_error = "Damaged central directory";
+            return false;
+        }
+
+        Entry entry;
+        entry.flags = getU16(record + 8);
+        entry.method = getU16(record + 10);
+        entry.crc = getU32(record + 16);
+        entry.compressedSize = getU32(record + 20);
+        entry.size = getU32(record + 24);
+        entry.localHeaderOffset = getU32(record + 42);
+        entry.name.assign(reinterpret_cast<const char*>(record + kCentralHeaderSize), nameSize);
+        std::replace(entry.name.begin(), entry.name.end(), '\\', '/');
+
+        // Sizes and offsets that do not fit in 32 bits are in the ZIP64 extra field, in
+        // this order and only when the 32-bit field is saturated.
+        const unsigned char* extra = record + kCentralHeaderSize + nameSize;
+        const unsigned char* extraEnd = extra + extraSize;
+        while (extraEnd - extra >= 4)
+        {
+            const uint16_t id = getU16(extra);
+            const size_t length = getU16(extra + 2);
+            const unsigned char* field = extra + 4;
+            if (static_cast<size_t>(extraEnd - field) < length)
+            {
+                break;
+            }
+            if (id == kZip64Extra)
+            {
+                const unsigned char* fieldEnd = field + length;
+                for (uint64_t* value : {&entry.size, &entry.compressedSize, &entry.localHeaderOffset})
+                {
+                    if (*value == UINT32_MAX && fieldEnd - field >= 8)
+                    {
+                        *value = getU64(field);
+                        field += 8;
+                    }
+                }
+            }
+            extra += 4 + length;
+        }
+
+        m_entries.push_back(std::move(entry));
+        record += kCentralHeaderSize + nameSize + extraSize + commentSize;
+    }
+    return true;
+}
+
+bool ZipArchive::read(const Entry& entry, std::vector<char>& buffer, std::string& error, uint64_t maxSize) const
+{
+    if (entry.flags & 1)
+    {
+        error = entry.name + " is encrypted";
+        return false;
+    }
+    if (entry.size > maxSize)
+    {
+        error = entry.name + " is too large";
+        return false;
+    }
+    // The local header repeats the name but may carry a different extra field.
+    const uint64_t header = entry.localHeaderOffset;
+    if (header > m_size || m_size - header < kLocalHeaderSize || getU32(m_data + header) != kLocalHeader)
+    {
+        error = entry.name + ": damaged local header";
+        return false;
+    }
+    const uint64_t start = header + kLocalHeaderSize + getU16(m_data + header + 26) + getU16(m_data + header + 28);
+    if (start > m_size || entry.compressedSize > m_size - start)
+    {
+        error = entry.name + ": data lies outside the file";
+        return false;
+    }
+    const unsigned char* data = m_data + start;
+
+    buffer.resize(static_cast<size_t>(entry.size));
+    if (entry.method == 0)
+    {
+        if (entry.compressedSize != entry.size)
+        {
+            error = entry.name + ": stored size mismatch";
+            return false;
+        }
+        std::memcpy(buffer.data(), data, buffer.size());
+    }
+    else if (entry.method == 8)
+    {
+#ifdef MILKDROP_PACK_ZLIB
+        thread_local Inflater inflater;
+        if (!inflater.inflate(data, entry.compressedSize, buffer.data(), entry.size))
+        {
+            error = entry.name + ": damaged deflate data";
+            return false;
+        }
+#else
+        error = entry.name + " is deflated, which needs a build with zlib";
+        return false;
+#endif
+    }
+    else
+    {
+        error = entry.name + ": unsupported compression method " + std::to_string(entry.method);
+        return false;
+    }
+
+#ifdef MILKDROP_PACK_ZLIB
+    if (crc32(0L, reinterpret_cast<const Bytef*>(buffer.data()), static_cast<uInt>(buffer.size())) != entry.crc)
+    {
+        error = entry.name + ": CRC mismatch";
+        return false;
+    }
+#endif
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Read-only view of a zip archive, for converting preset packs without extracting them.
+ *
+ * open() memory-maps the file and parses the central directory once; read() inflates one
+ * entry into a buffer the caller keeps between entries. read() only reads the mapping, so
+ * the workers of a WorkerPool can read entries of the same archive at once, each into its
+ * own buffer. Stored and deflated entries and ZIP64 archives (more than 65535 entries) are
+ * supported; encrypted entries are not. Deflate needs zlib (MILKDROP_PACK_ZLIB).
+ */
+class ZipArchive
+{
+public:
+    struct Entry
+    {
+        std::string name;              //!< Path inside the archive, '/' separated
+        uint16_t method{0};            //!< 0 stored, 8 deflated
+        uint16_t flags{0};
+        uint32_t crc{0};
+        uint64_t compressedSize{0};
+        uint64_t size{0};
+        uint64_t localHeaderOffset{0};
+    };
+
+    ZipArchive() = default;
+    ~ZipArchive();
+
+    ZipArchive(const ZipArchive&) = delete;
+    ZipArchive& operator=(const ZipArchive&) = delete;
+
+    /// Maps @p path and reads its central directory.
+    bool open(const std::string& path);
+    void close();
+
+    /// Central directory entries in archive order, directories included.
+    const std::vector<Entry>& entries() const { return m_entries; }
+
+    /// Replaces @p buffer with the contents of @p entry and checks its CRC. Entries larger
+    /// than @p maxSize fail without being inflated.
+    bool read(const Entry& entry, std::vector<char>& buffer, std::string& error, uint64_t maxSize = UINT64_MAX) const;
+
+    const std::string& error() const { return m_error; }
+
+private:
+    bool fail(const std::string& message);
+    bool readDirectory(uint64_t offset, uint64_t size, uint64_t count);
+
+    const unsigned char* m_data{nullptr};
+    size_t m_size{0};
+    std::vector<Entry> m_entries;
+    std::string m_error;
+};
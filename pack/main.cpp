@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "PackAnalyzer.hpp"
+#include "PackIndex.hpp"
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--threads <n>] <pack-dir|pack.zip> <index.mdpx>\n"
+              << "       " << program << " --query <expr> [--columns <a,b,...>] [--count] <index.mdpx>\n\n"
+              << "The first form parses every .milk file below <pack-dir>, or in <pack.zip> without\n"
+              << "extracting it, in parallel (no GLSL is generated) and writes a columnar feature\n"
+              << "index. The second prints the paths of the indexed presets that match <expr>, a list\n"
+              << "of conditions joined by \"and\":\n"
+              << "  \"wave_mode = 8 and custom_shapes = 0 and cost < 27000\", \"uses_loop\", \"not wave_supported\"\n\n"
+              << "Options:\n"
+              << "  --threads <n>          Worker threads; 0 uses every core (default 0)\n"
+              << "  --query <expr>         Filter an index; an empty expression matches every preset\n"
+              << "  --columns <a,b,...>    Print these columns after each path, tab separated\n"
+              << "  --count                Print only the number of matches\n\n"
+              << "Columns:";
+    for (const auto& name : packColumnNames()) {
+        std::cerr << " " << name;
+    }
+    std::cerr << "\n";
+}
+
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+int buildIndex(const std::string& root, const std::string& output, int threads) {
+    const auto start = std::chrono::steady_clock::now();
+    PackAnalyzer analyzer(threads);
+    if (!analyzer.analyze(root)) {
+        std::cerr << "Error: " << analyzer.error() << "\n";
+        return 1;
+    }
+    PackIndexWriter writer;
+    if (!writer.write(output, analyzer.presets())) {
+        std::cerr << "Error: " << writer.error() << "\n";
+        return 1;
+    }
+    const double millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const auto& presets = analyzer.presets();
+    const auto failures = std::count_if(presets.begin(), presets.end(), [](const PresetFeatures& f) { return !f.parsed; });
+    for (const auto& features : presets) {
+        if (!features.parsed) {
+            std::cerr << "Warning: Could not parse " << features.path << "\n";
+        }
+    }
+    std::cout << "presets: " << presets.size() << "\n"
+              << "parse_failures: " << failures << "\n"
+              << "threads: " << analyzer.threads() << "\n"
+              << "index_ms: " << millis << "\n";
+    return 0;
+}
+
+int queryIndex(const std::string& path, const std::string& expression, const std::vector<std::string>& columns,
+               bool countOnly) {
+    PackQuery query;
+    if (!query.parse(expression)) {
+        std::cerr << "Error: " << query.error() << "\n";
+        return 1;
+    }
+    PackIndexReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Error: " << reader.error() << "\n";
+        return 1;
+    }
+    for (const auto& column : columns) {
+        if (!reader.hasColumn(column)) {
+            std::cerr << "Error: Unknown column: " << column << "\n";
+            return 1;
+        }
+    }
+    std::vector<uint32_t> rows;
+    if (!reader.select(query, rows)) {
+        std::cerr << "Error: " << reader.error() << "\n";
+        return 1;
+    }
+    std::cerr << rows.size() << " of " << reader.rowCount() << " presets match\n";
+    if (countOnly) {
+        std::cout << rows.size() << "\n";
+        return 0;
+    }
+
+    const std::vector<std::string>* paths = reader.strings("path");
+    if (!paths) {
+        std::cerr << "Error: " << reader.error() << "\n";
+        return 1;
+    }
+    for (const uint32_t row : rows) {
+        std::cout << (*paths)[row];
+        for (const auto& column : columns) {
+            std::cout << "\t";
+            if (reader.isNumeric(column)) {
+                const std::vector<double>* values = reader.numbers(column);
+                if (!values) {
+                    std::cerr << "\nError: " << reader.error() << "\n";
+                    return 1;
+                }
+                std::cout << (*values)[row];
+            } else {
+                std::cout << (*reader.strings(column))[row];
+            }
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int threads = 0;
+    bool query = false;
+    bool countOnly = false;
+    std::string expression;
+    std::vector<std::string> columns;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--query" && i + 1 < argc) {
+            query = true;
+            expression = argv[++i];
+        } else if (arg == "--columns" && i + 1 < argc) {
+            columns = splitList(argv[++i]);
+        } else if (arg == "--count") {
+            countOnly = true;
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Error: Unknown or incomplete option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (query) {
+        if (positional.size() != 1) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return queryIndex(positional[0], expression, columns, countOnly);
+    }
+    if (positional.size() != 2 || !columns.empty() || countOnly) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    return buildIndex(positional[0], positional[1], threads);
+}
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <chrono>
+#include <clocale>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "MilkdropConverter.hpp"
+#include "PresetFileParser.hpp"
+#include "PresetSource.hpp"
+#include "ShaderDeduplicator.hpp"
+#include "WorkerPool.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <pack-dir|pack.zip> <output-dir>\n\n"
+              << "Converts every .milk file below <pack-dir>, or in <pack.zip> without extracting it, in\n"
+              << "parallel and writes the shaders to <output-dir> with the same relative paths\n"
+              << "(preset.frag, preset.<pass>.frag). Helper code that several shaders share is written\n"
+              << "once to <output-dir>/milkdrop/<hash>.glsl and replaced by\n"
+              << "#include \"/milkdrop/<hash>.glsl\" (GL_ARB_shading_language_include).\n\n"
+              << "Options:\n"
+              << "  --threads <n>          Worker threads; 0 uses every core (default 0)\n"
+              << "  --no-dedupe            Write the shaders whole, for comparison\n"
+              << "  --report <file.json>   Write the byte and chunk totals before and after\n"
+              << "  --wave-geometry        Convert with the wave geometry prepass\n"
+              << "  --wave-lowres          Convert with the low-resolution wave field\n"
+              << "  --audio-texture        Convert with iAudioTexture sampling\n";
+}
+
+struct ConvertedPreset {
+    bool parsed = false;
+    std::vector<std::pair<std::string, std::string>> shaders; // relative output path, GLSL
+    std::vector<std::string> diagnostics;                     // Code left out and fallbacks, printed in order
+};
+
+// "dir/preset.milk" -> "dir/preset" + suffix + ".frag"
+std::string shaderPath(const std::string& preset, const std::string& suffix) {
+    return preset.substr(0, preset.size() - fs::path(preset).extension().string().size()) + suffix + ".frag";
+}
+
+ConvertedPreset convertPreset(const PresetSource& source, size_t index, const ConversionOptions& options,
+                              std::vector<char>& buffer) {
+    ConvertedPreset converted;
+    libprojectM::PresetFileParser parser;
+    if (!source.parse(index, parser, buffer)) {
+        return converted;
+    }
+    const std::string& preset = source.presets()[index];
+    converted.parsed = true;
+    ConversionReport report;
+    std::string glsl = translateToGLSL(parser.GetCode("per_frame_"), parser.GetCode("per_pixel_"), parser.PresetValues(),
+                                       options, &report);
+    converted.shaders.emplace_back(shaderPath(preset, ""), std::move(glsl));
+    converted.diagnostics = std::move(report.errors);
+    converted.diagnostics.insert(converted.diagnostics.end(), report.warnings.begin(), report.warnings.end());
+    for (auto& pass : report.passes) {
+        converted.shaders.emplace_back(shaderPath(preset, "." + pass.name), std::move(pass.glsl));
+    }
+    if (!report.composite.glsl.empty()) {
+        converted.shaders.emplace_back(shaderPath(preset, "." + report.composite.name), std::move(report.composite.glsl));
+    }
+    return converted;
+}
+
+bool writeFile(const fs::path& path, const std::string& text) {
+    std::error_code error;
+    fs::create_directories(path.parent_path(), error);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out || !out.write(text.data(), static_cast<std::streamsize>(text.size()))) {
+        std::cerr << "Error: Could not write " << path.string() << "\n";
+        return false;
+    }
+    return true;
+}
+
+void writeReport(std::ostream& out, const DeduplicationStats& stats, size_t presets, size_t failures, double millis) {
+    out << "{\n"
+        << "  \"presets\": " << presets << ",\n"
+        << "  \"parse_failures\": " << failures << ",\n"
+        << "  \"shaders\": " << stats.shaders << ",\n"
+        << "  \"convert_ms\": " << millis << ",\n"
+        << "  \"before\": {\"bytes\": " << stats.inputBytes << ", \"chunks\": " << stats.inputChunks
+        << ", \"unique_chunks\": " << stats.uniqueInputChunks << "},\n"
+        << "  \"after\": {\"bytes\": " << stats.outputBytes() << ", \"shader_bytes\": " << stats.outputShaderBytes
+        << ", \"shared_bytes\": " << stats.sharedChunkBytes << ", \"chunks\": " << stats.outputChunks
+        << ", \"shared_chunks\": " << stats.sharedChunks
+        << ", \"include_references\": " << stats.includeReferences << "}\n"
+        << "}\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::setlocale(LC_NUMERIC, "C");
+
+    int threads = 0;
+    bool dedupe = true;
+    std::string reportPath;
+    ConversionOptions options;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--no-dedupe") {
+            dedupe = false;
+        } else if (arg == "--report" && i + 1 < argc) {
+            reportPath = argv[++i];
+        } else if (arg == "--wave-geometry") {
+            options.waveGeometry = true;
+        } else if (arg == "--wave-lowres") {
+            options.waveLowRes = true;
+        } else if (arg == "--audio-texture") {
+            options.audioTexture = true;
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Error: Unknown or incomplete option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    const fs::path output = positional[1];
+
+    PresetSource source;
+    if (!source.open(positional[0])) {
+        std::cerr << "Error: " << source.error() << "\n";
+        return 1;
+    }
+    const std::vector<std::string>& presets = source.presets();
+
+    const auto start = std::chrono::steady_clock::now();
+    WorkerPool pool(threads);
+    std::vector<ConvertedPreset> converted(presets.size());
+    std::vector<std::vector<char>> buffers(static_cast<size_t>(pool.size()));
+    pool.run(static_cast<int>(presets.size()), [&](int index, int worker) {
+        converted[static_cast<size_t>(index)] =
+            convertPreset(source, static_cast<size_t>(index), options, buffers[static_cast<size_t>(worker)]);
+    });
+    const double millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t failures = 0;
+    std::vector<std::string> paths;
+    ShaderDeduplicator deduplicator;
+    for (size_t index = 0; index < presets.size(); ++index) {
+        if (!converted[index].parsed) {
+            std::cerr << "Warning: Could not parse " << presets[index] << "\n";
+            ++failures;
+        }
+        for (const auto& message : converted[index].diagnostics) {
+            std::cerr << "Warning: " << presets[index] << ": " << message << "\n";
+        }
+        for (auto& shader : converted[index].shaders) {
+            paths.push_back(std::move(shader.first));
+            deduplicator.add(std::move(shader.second));
+        }
+    }
+    converted.clear();
+    deduplicator.build();
+
+    // Every rewritten shader must expand back to the converter's output.
+    std::map<std::string, const std::string*> chunks;
+    for (const auto& chunk : deduplicator.chunks()) {
+        chunks[chunk.name] = &chunk.glsl;
+    }
+    auto lookup = [&](const std::string& name, std::string& glsl) {
+        auto it = chunks.find(name);
+        if (it == chunks.end()) {
+            return false;
+        }
+        glsl = *it->second;
+        return true;
+    };
+    for (size_t shader = 0; shader < paths.size(); ++shader) {
+        std::string expanded;
+        if (!ShaderDeduplicator::expand(deduplicator.shaders()[shader], lookup, expanded) ||
+            expanded != deduplicator.inputs()[shader]) {
+            std::cerr << "Error: " << paths[shader] << " does not expand back to the converted shader\n";
+            return 1;
+        }
+    }
+
+    const auto& shaders = dedupe ? deduplicator.shaders() : deduplicator.inputs();
+    for (size_t shader = 0; shader < paths.size(); ++shader) {
+        if (!writeFile(output / paths[shader], shaders[shader])) {
+            return 1;
+        }
+    }
+    if (dedupe) {
+        for (const auto& chunk : deduplicator.chunks()) {
+            if (!writeFile(output / "milkdrop" / chunk.name, chunk.glsl)) {
+                return 1;
+            }
+        }
+    }
+
+    const DeduplicationStats& stats = deduplicator.stats();
+    std::cout << "presets: " << presets.size() << " (" << failures << " parse failures), shaders: " << stats.shaders
+              << ", threads: " << pool.size() << ", convert_ms: " << millis << "\n"
+              << "before: " << stats.inputBytes << " bytes, " << stats.inputChunks << " chunks ("
+              << stats.uniqueInputChunks << " unique)\n"
+              << "after:  " << stats.outputBytes() << " bytes (" << stats.outputShaderBytes << " in shaders + "
+              << stats.sharedChunkBytes << " in " << stats.sharedChunks << " shared chunks), " << stats.outputChunks
+              << " chunks stored, " << stats.includeReferences << " include lines\n";
+    if (!dedupe) {
+        std::cout << "  --no-dedupe: wrote the shaders whole\n";
+    }
+    if (!reportPath.empty()) {
+        std::ofstream out(reportPath);
+        if (!out) {
+            std::cerr << "Error: Could not open " << reportPath << " for writing\n";
+            return 1;
+        }
+        writeReport(out, stats, presets.size(), failures, millis);
+    }
+    return 0;
+}
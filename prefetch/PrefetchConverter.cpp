@@ -0,0 +1,292 @@
+#include "PrefetchConverter.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+using ConverterHandle = std::unique_ptr<milkdrop_converter, void (*)(milkdrop_converter*)>;
+
+ConverterHandle createConverter(const milkdrop_converter_options& options)
+{
+    ConverterHandle converter(milkdrop_converter_create(), milkdrop_converter_destroy);
+    if (converter && milkdrop_converter_set_options(converter.get(), &options) != MILKDROP_CONVERTER_OK)
+    {
+        converter.reset();
+    }
+    return converter;
+}
+
+ConvertedPass copyPass(const milkdrop_converter_pass& pass)
+{
+    ConvertedPass copy;
+    copy.name = pass.name;
+    copy.sampler = pass.sampler;
+    copy.glsl.assign(pass.glsl, pass.glsl_size);
+    copy.width = pass.width;
+    copy.height = pass.height;
+    copy.resolutionDivisor = pass.resolution_divisor;
+    return copy;
+}
+
+ConvertedPresetPtr convertPreset(milkdrop_converter* converter, const std::string& path)
+{
+    auto preset = std::make_shared<ConvertedPreset>();
+    preset->path = path;
+    if (converter == nullptr)
+    {
+        preset->status = MILKDROP_CONVERTER_INTERNAL_ERROR;
+        preset->error = "Could not create the converter";
+        return preset;
+    }
+    preset->status = milkdrop_converter_convert_file(converter, path.c_str());
+    preset->error = milkdrop_converter_error(converter);
+    if (!preset->ok())
+    {
+        return preset;
+    }
+    size_t size = 0;
+    const char* shader = milkdrop_converter_shader(converter, &size);
+    preset->shader.assign(shader, size);
+    milkdrop_converter_pass pass{};
+    pass.struct_size = sizeof(pass);
+    for (size_t index = 0; index < milkdrop_converter_pass_count(converter); ++index)
+    {
+        milkdrop_converter_get_pass(converter, index, &pass);
+        preset->passes.push_back(copyPass(pass));
+    }
+    preset->hasComposite = milkdrop_converter_get_composite(converter, &pass) != 0;
+    if (preset->hasComposite)
+    {
+        preset->composite = copyPass(pass);
+    }
+    preset->info.struct_size = sizeof(preset->info);
+    milkdrop_converter_get_info(converter, &preset->info);
+    return preset;
+}
+
+} // namespace
+
+PrefetchConverter::PrefetchConverter(libprojectM::Playlist::Playlist& playlist, const Settings& settings)
+    : m_playlist(playlist)
+    , m_settings(settings)
+    , m_converter(createConverter(settings.options))
+    , m_cache(settings.cacheBytes)
+{
+    m_settings.radius = std::max(m_settings.radius, 0);
+    for (int thread = 0; thread < std::max(m_settings.threads, 1); ++thread)
+    {
+        m_threads.emplace_back(&PrefetchConverter::work, this);
+    }
+}
+
+PrefetchConverter::~PrefetchConverter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_queue.clear();
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void PrefetchConverter::update()
+{
+    const std::vector<std::string> wanted = neighbourhood();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::deque<std::string> queue;
+    for (const auto& path : wanted)
+    {
+        if (m_cache.find(path) == nullptr && m_running.count(path) == 0)
+        {
+            queue.push_back(path);
+        }
+    }
+    for (const auto& path : m_queue)
+    {
+        if (std::find(queue.begin(), queue.end(), path) == queue.end())
+        {
+            ++m_statistics.cancelled;
+        }
+    }
+    m_queue = std::move(queue);
+    const bool wake = !m_queue.empty();
+    lock.unlock();
+    if (wake)
+    {
+        m_wake.notify_all();
+    }
+}
+
+ConvertedPresetPtr PrefetchConverter::acquire(uint32_t index)
+{
+    if (index >= m_playlist.Size())
+    {
+        return nullptr;
+    }
+    const std::string path = m_playlist.Items()[index].Filename();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    ConvertedPresetPtr preset = m_cache.find(path);
+    if (preset)
+    {
+        ++m_statistics.hits;
+        return preset;
+    }
+    ++m_statistics.misses;
+    const auto start = std::chrono::steady_clock::now();
+    m_queue.erase(std::remove(m_queue.begin(), m_queue.end(), path), m_queue.end());
+    m_finished.wait(lock, [&] { return m_running.count(path) == 0; });
+    preset = m_cache.find(path);
+    if (!preset)
+    {
+        // Not started yet (or evicted right after it finished): convert it here rather than
+        // wait behind the conversions the background threads are running.
+        m_running.insert(path);
+        lock.unlock();
+        preset = convertPreset(m_converter.get(), path);
+        lock.lock();
+        m_running.erase(path);
+        m_cache.insert(preset);
+        m_finished.notify_all();
+    }
+    m_statistics.stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return preset;
+}
+
+ConvertedPresetPtr PrefetchConverter::tryAcquire(uint32_t index)
+{
+    if (index >= m_playlist.Size())
+    {
+        return nullptr;
+    }
+    const std::string path = m_playlist.Items()[index].Filename();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    ConvertedPresetPtr preset = m_cache.find(path);
+    if (preset || m_running.count(path) > 0)
+    {
+        return preset;
+    }
+    m_queue.erase(std::remove(m_queue.begin(), m_queue.end(), path), m_queue.end());
+    m_queue.push_front(path);
+    lock.unlock();
+    m_wake.notify_one();
+    return nullptr;
+}
+
+void PrefetchConverter::cancel()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_statistics.cancelled += m_queue.size();
+    m_queue.clear();
+}
+
+PrefetchConverter::Statistics PrefetchConverter::statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Statistics statistics = m_statistics;
+    statistics.evictions = m_cache.evictions();
+    statistics.queued = m_queue.size();
+    statistics.cachedPresets = m_cache.size();
+    statistics.cachedBytes = m_cache.bytes();
+    return statistics;
+}
+
+std::vector<std::string> PrefetchConverter::neighbourhood()
+{
+    std::vector<std::string> paths;
+    if (m_playlist.Empty())
+    {
+        return paths;
+    }
+    const auto& items = m_playlist.Items();
+    const auto size = static_cast<uint32_t>(items.size());
+    auto add = [&](uint32_t index) {
+        // Shuffle mode can draw Size() itself, which names no item.
+        if (index < size)
+        {
+            std::string path = items[index].Filename();
+            if (std::find(paths.begin(), paths.end(), path) == paths.end())
+            {
+                paths.push_back(std::move(path));
+            }
+        }
+    };
+    const uint32_t current = m_playlist.PresetIndex();
+    add(current);
+
+    if (!paths.empty() && paths.front() != m_position)
+    {
+        if (!m_position.empty())
+        {
+            m_trail.push_front(m_position);
+        }
+        m_position = paths.front();
+        while (m_trail.size() > static_cast<size_t>(m_settings.radius))
+        {
+            m_trail.pop_back();
+        }
+    }
+
+    std::vector<uint32_t> draws;
+    if (m_playlist.Shuffle())
+    {
+        libprojectM::Playlist::Playlist copy = m_playlist;
+        for (int distance = 1; distance <= m_settings.radius; ++distance)
+        {
+            draws.push_back(copy.NextPresetIndex());
+        }
+    }
+    for (int distance = 1; distance <= m_settings.radius; ++distance)
+    {
+        if (m_playlist.Shuffle())
+        {
+            add(draws[distance - 1]);
+        }
+        else
+        {
+            add((current + distance) % size);
+            add((current + size - distance % size) % size);
+        }
+        if (static_cast<size_t>(distance) <= m_trail.size())
+        {
+            const std::string& path = m_trail[distance - 1];
+            if (std::find(paths.begin(), paths.end(), path) == paths.end())
+            {
+                paths.push_back(path);
+            }
+        }
+    }
+    return paths;
+}
+
+void PrefetchConverter::work()
+{
+    ConverterHandle converter = createConverter(m_settings.options);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_wake.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+        if (m_stop)
+        {
+            return;
+        }
+        const std::string path = m_queue.front();
+        m_queue.pop_front();
+        m_running.insert(path);
+        lock.unlock();
+        ConvertedPresetPtr preset = convertPreset(converter.get(), path);
+        lock.lock();
+        m_running.erase(path);
+        m_cache.insert(std::move(preset));
+        ++m_statistics.prefetched;
+        m_finished.notify_all();
+    }
+}
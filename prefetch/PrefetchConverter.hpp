@@ -0,0 +1,110 @@
+#pragma once
+
+#include "PresetCache.hpp"
+
+#include "Playlist.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * @brief Converts the presets around the playlist position in the background, so that preset
+ *        switches find their shaders already converted.
+ *
+ * After every change of the playlist position the host calls update(). It predicts the
+ * @c radius items the playlist reaches next: in order, the ones ahead and behind; in shuffle
+ * mode, the indices NextPresetIndex() draws on a copy of the playlist, which draws the same
+ * random numbers as the original (and PreviousPresetIndex() draws them too). The items
+ * visited last are added for LastPresetIndex(), whose history the playlist keeps private.
+ * Those items are queued nearest first; queued conversions that left the neighbourhood are
+ * cancelled, and cached ones are marked as recently used so the neighbourhood stays cached.
+ *
+ * Background threads convert the queue through their own C API handle into a PresetCache
+ * bounded in bytes. acquire() returns the visible item: from the cache, by waiting for the
+ * thread already converting it, or by converting it at once on the calling thread, ahead of
+ * everything queued. tryAcquire() never blocks; it moves the item to the front of the queue
+ * instead. A conversion that has started runs to the end (a few milliseconds); cancel() only
+ * drops queued ones.
+ *
+ * The playlist is only read by update(), acquire() and tryAcquire(), which must be called
+ * from the thread that owns the playlist, like cancel(). The background threads only see
+ * file paths.
+ */
+class PrefetchConverter
+{
+public:
+    struct Settings
+    {
+        Settings() { milkdrop_converter_options_init(&options); }
+
+        int radius{2};                  //!< Items converted ahead of and behind the current one
+        int threads{1};                 //!< Background conversion threads (at least 1)
+        size_t cacheBytes{64u << 20};   //!< Cache capacity; a preset is roughly 10-100 KiB
+        milkdrop_converter_options options;
+    };
+
+    struct Statistics
+    {
+        uint64_t hits{0};          //!< acquire() calls answered from the cache
+        uint64_t misses{0};        //!< acquire() calls that waited for or ran the conversion
+        uint64_t prefetched{0};    //!< Conversions finished on the background threads
+        uint64_t cancelled{0};     //!< Queued conversions dropped before they started
+        uint64_t evictions{0};     //!< Cache entries dropped to stay within the capacity
+        double stallSeconds{0.0};  //!< Time acquire() spent on misses
+        size_t queued{0};
+        size_t cachedPresets{0};
+        size_t cachedBytes{0};
+    };
+
+    explicit PrefetchConverter(libprojectM::Playlist::Playlist& playlist, const Settings& settings = Settings());
+
+    /// Cancels the queue and joins the background threads.
+    ~PrefetchConverter();
+
+    PrefetchConverter(const PrefetchConverter&) = delete;
+    PrefetchConverter& operator=(const PrefetchConverter&) = delete;
+
+    /// Queues the neighbourhood of the current playlist position.
+    void update();
+
+    /// The converted playlist item @p index, blocking on a miss; null when out of range.
+    ConvertedPresetPtr acquire(uint32_t index);
+
+    /// The converted playlist item @p index if it is cached, else null after queueing it first.
+    ConvertedPresetPtr tryAcquire(uint32_t index);
+
+    /// Drops every queued conversion.
+    void cancel();
+
+    Statistics statistics() const;
+
+private:
+    /// Paths of the current item and its predicted neighbours, nearest first; also moves the
+    /// trail of visited items on when the position changed.
+    std::vector<std::string> neighbourhood();
+
+    void work();
+
+    libprojectM::Playlist::Playlist& m_playlist;
+    Settings m_settings;
+    std::unique_ptr<milkdrop_converter, void (*)(milkdrop_converter*)> m_converter; //!< For acquire()
+    std::string m_position;           //!< Current item at the last update()
+    std::deque<std::string> m_trail;  //!< Items visited before it, most recent first
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;     //!< Signals the background threads
+    std::condition_variable m_finished; //!< Signals acquire() waiting for a running conversion
+    PresetCache m_cache;
+    std::deque<std::string> m_queue;            //!< Highest priority first
+    std::unordered_set<std::string> m_running;  //!< Being converted by some thread
+    Statistics m_statistics;
+    bool m_stop{false};
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,65 @@
+#include "PresetCache.hpp"
+
+#include <iterator>
+
+namespace {
+
+size_t stringBytes(const ConvertedPass& pass)
+{
+    return pass.name.capacity() + pass.sampler.capacity() + pass.glsl.capacity();
+}
+
+} // namespace
+
+size_t ConvertedPreset::bytes() const
+{
+    size_t total = sizeof(ConvertedPreset) + path.capacity() + error.capacity() + shader.capacity() + stringBytes(composite);
+    for (const auto& pass : passes)
+    {
+        total += sizeof(ConvertedPass) + stringBytes(pass);
+    }
+    return total;
+}
+
+ConvertedPresetPtr PresetCache::find(const std::string& path)
+{
+    auto found = m_index.find(path);
+    if (found == m_index.end())
+    {
+        return nullptr;
+    }
+    m_entries.splice(m_entries.begin(), m_entries, found->second);
+    return found->second->preset;
+}
+
+void PresetCache::insert(ConvertedPresetPtr preset)
+{
+    auto found = m_index.find(preset->path);
+    if (found != m_index.end())
+    {
+        erase(found->second);
+    }
+    const size_t bytes = preset->bytes();
+    m_entries.push_front(Entry{preset, bytes});
+    m_index[preset->path] = m_entries.begin();
+    m_bytes += bytes;
+    while (m_bytes > m_capacity && m_entries.size() > 1)
+    {
+        erase(std::prev(m_entries.end()));
+        ++m_evictions;
+    }
+}
+
+void PresetCache::clear()
+{
+    m_entries.clear();
+    m_index.clear();
+    m_bytes = 0;
+}
+
+void PresetCache::erase(std::list<Entry>::iterator entry)
+{
+    m_bytes -= entry->bytes;
+    m_index.erase(entry->preset->path);
+    m_entries.erase(entry);
+}
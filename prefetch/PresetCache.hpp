@@ -0,0 +1,95 @@
+#pragma once
+
+#include "milkdrop-converter.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** @brief A prepass or the composite pass of a converted preset. */
+struct ConvertedPass
+{
+    std::string name;
+    std::string sampler;
+    std::string glsl;
+    int width{0};
+    int height{0};
+    int resolutionDivisor{0};
+};
+
+/**
+ * @brief Everything one conversion produced, copied out of the converter handle.
+ *
+ * Failed conversions are kept as well (with @c status and @c error set), so a broken preset
+ * in the playlist is not converted again on every switch.
+ */
+struct ConvertedPreset
+{
+    std::string path;
+    milkdrop_converter_status status{MILKDROP_CONVERTER_NO_RESULT};
+    std::string error;
+    std::string shader;
+    std::vector<ConvertedPass> passes;
+    bool hasComposite{false};
+    ConvertedPass composite;
+    milkdrop_converter_info info{};
+
+    /// A shader is available; a partial conversion left out code that did not compile (see @c error).
+    bool ok() const { return status == MILKDROP_CONVERTER_OK || status == MILKDROP_CONVERTER_PARTIAL; }
+
+    /// Approximate heap footprint, charged against the cache budget.
+    size_t bytes() const;
+};
+
+using ConvertedPresetPtr = std::shared_ptr<const ConvertedPreset>;
+
+/**
+ * @brief Least-recently-used cache of converted presets, bounded by their total size.
+ *
+ * Entries are shared: an evicted preset stays alive as long as the host still holds it. The
+ * cache is not synchronized; PrefetchConverter guards it with its own mutex.
+ */
+class PresetCache
+{
+public:
+    explicit PresetCache(size_t capacityBytes)
+        : m_capacity(capacityBytes)
+    {
+    }
+
+    /// The cached preset, marked as most recently used, or null.
+    ConvertedPresetPtr find(const std::string& path);
+
+    bool contains(const std::string& path) const { return m_index.count(path) > 0; }
+
+    /// Adds or replaces the entry for @p preset->path, then evicts the least recently used
+    /// entries until the cache fits its capacity again. The new entry itself is kept even
+    /// when it alone exceeds the capacity.
+    void insert(ConvertedPresetPtr preset);
+
+    void clear();
+
+    size_t size() const { return m_entries.size(); }
+    size_t bytes() const { return m_bytes; }
+    size_t capacity() const { return m_capacity; }
+    uint64_t evictions() const { return m_evictions; }
+
+private:
+    struct Entry
+    {
+        ConvertedPresetPtr preset;
+        size_t bytes{0};
+    };
+
+    void erase(std::list<Entry>::iterator entry);
+
+    size_t m_capacity{0};
+    size_t m_bytes{0};
+    uint64_t m_evictions{0};
+    std::list<Entry> m_entries; //!< Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+};
@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "PrefetchConverter.hpp"
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <preset-dir>\n\n"
+              << "Plays a simulated session over the presets below <preset-dir>: after a dwell time the\n"
+              << "playlist moves to the next item, the previous one or back through the history, and\n"
+              << "each switch takes its shaders from the prefetch cache. Prints the hit rate and the time\n"
+              << "switches stalled on conversions.\n\n"
+              << "Options:\n"
+              << "  --switches <n>       Preset switches to play (default 200)\n"
+              << "  --dwell-ms <ms>      Time spent on each preset (default 50)\n"
+              << "  --burst <n>          Every 20 switches, skip <n> presets without dwelling (default 0)\n"
+              << "  --radius <k>         Items prefetched ahead of and behind the current one (default 2)\n"
+              << "  --threads <n>        Background conversion threads (default 1)\n"
+              << "  --cache-kb <kb>      Cache capacity (default 65536)\n"
+              << "  --shuffle            Play the playlist in shuffle mode\n"
+              << "  --poll               Poll tryAcquire() every millisecond, as a host that keeps rendering\n"
+              << "                       the old preset would, instead of blocking in acquire()\n"
+              << "  --seed <n>           Seed of the navigation (default 1)\n"
+              << "  --verify             Compare every switch with a conversion on a fresh handle\n"
+              << "  --report <file.json> Write the session statistics\n";
+}
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// The cached result of @p path matches a conversion on a new handle.
+bool matchesFreshConversion(const ConvertedPreset& preset, const milkdrop_converter_options& options) {
+    std::unique_ptr<milkdrop_converter, void (*)(milkdrop_converter*)> converter(milkdrop_converter_create(),
+                                                                                milkdrop_converter_destroy);
+    milkdrop_converter_set_options(converter.get(), &options);
+    const milkdrop_converter_status status = milkdrop_converter_convert_file(converter.get(), preset.path.c_str());
+    if (status != preset.status) {
+        return false;
+    }
+    if (preset.error != milkdrop_converter_error(converter.get())) {
+        return false;
+    }
+    if (!preset.ok()) {
+        return true;
+    }
+    size_t size = 0;
+    const char* shader = milkdrop_converter_shader(converter.get(), &size);
+    if (preset.shader != std::string(shader, size) || preset.passes.size() != milkdrop_converter_pass_count(converter.get())) {
+        return false;
+    }
+    milkdrop_converter_pass pass{};
+    pass.struct_size = sizeof(pass);
+    for (size_t index = 0; index < preset.passes.size(); ++index) {
+        milkdrop_converter_get_pass(converter.get(), index, &pass);
+        if (preset.passes[index].name != pass.name || preset.passes[index].glsl != pass.glsl) {
+            return false;
+        }
+    }
+    const bool hasComposite = milkdrop_converter_get_composite(converter.get(), &pass) != 0;
+    return hasComposite == preset.hasComposite && (!hasComposite || preset.composite.glsl == pass.glsl);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int switches = 200;
+    double dwellMs = 50.0;
+    int burst = 0;
+    bool shuffle = false;
+    bool poll = false;
+    bool verify = false;
+    unsigned seed = 1;
+    std::string reportPath;
+    std::string presetDir;
+    PrefetchConverter::Settings settings;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--switches" && hasValue) {
+            switches = std::atoi(argv[++i]);
+        } else if (arg == "--dwell-ms" && hasValue) {
+            dwellMs = std::atof(argv[++i]);
+        } else if (arg == "--burst" && hasValue) {
+            burst = std::atoi(argv[++i]);
+        } else if (arg == "--radius" && hasValue) {
+            settings.radius = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            settings.threads = std::atoi(argv[++i]);
+        } else if (arg == "--cache-kb" && hasValue) {
+            settings.cacheBytes = static_cast<size_t>(std::atol(argv[++i])) * 1024;
+        } else if (arg == "--seed" && hasValue) {
+            seed = static_cast<unsigned>(std::atol(argv[++i]));
+        } else if (arg == "--report" && hasValue) {
+            reportPath = argv[++i];
+        } else if (arg == "--shuffle") {
+            shuffle = true;
+        } else if (arg == "--poll") {
+            poll = true;
+        } else if (arg == "--verify") {
+            verify = true;
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Error: Unknown or incomplete option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        } else if (presetDir.empty()) {
+            presetDir = arg;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (presetDir.empty() || switches <= 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    libprojectM::Playlist::Playlist playlist;
+    playlist.AddPath(presetDir, libprojectM::Playlist::Playlist::InsertAtEnd, true, false);
+    if (playlist.Empty()) {
+        std::cerr << "Error: No presets found in " << presetDir << "\n";
+        return 1;
+    }
+    playlist.Sort(0, playlist.Size(), libprojectM::Playlist::Playlist::SortPredicate::FullPath,
+                  libprojectM::Playlist::Playlist::SortOrder::Ascending);
+    playlist.SetShuffle(shuffle);
+
+    PrefetchConverter prefetch(playlist, settings);
+    std::mt19937 navigation(seed);
+    std::uniform_real_distribution<double> choice(0.0, 1.0);
+
+    // The preset shown at start-up is converted before the session begins.
+    prefetch.update();
+    prefetch.acquire(playlist.PresetIndex());
+    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(dwellMs));
+
+    int hits = 0;
+    int failed = 0;
+    int mismatches = 0;
+    int skipped = 0;
+    double stallTotalMs = 0.0;
+    double stallMaxMs = 0.0;
+    double updateTotalMs = 0.0;
+    int burstLeft = 0;
+    for (int switchIndex = 0; switchIndex < switches; ++switchIndex) {
+        const double action = choice(navigation);
+        uint32_t index = action < 0.75 ? playlist.NextPresetIndex()
+                       : action < 0.9  ? playlist.PreviousPresetIndex()
+                                       : playlist.LastPresetIndex();
+        if (index >= playlist.Size()) {
+            // The vendored shuffle can draw one past the end; treat it as the first item.
+            index = playlist.SetPresetIndex(0);
+            ++skipped;
+        }
+
+        auto start = Clock::now();
+        prefetch.update();
+        updateTotalMs += millisecondsSince(start);
+
+        start = Clock::now();
+        ConvertedPresetPtr preset = prefetch.tryAcquire(index);
+        const bool hit = preset != nullptr;
+        while (!preset) {
+            if (poll) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                preset = prefetch.tryAcquire(index);
+            } else {
+                preset = prefetch.acquire(index);
+            }
+        }
+        const double stallMs = hit ? 0.0 : millisecondsSince(start);
+        hits += hit ? 1 : 0;
+        stallTotalMs += stallMs;
+        stallMaxMs = std::max(stallMaxMs, stallMs);
+        failed += preset->ok() ? 0 : 1;
+        if (verify && !matchesFreshConversion(*preset, settings.options)) {
+            std::cerr << "Error: the cached result of " << preset->path << " differs from a fresh conversion\n";
+            ++mismatches;
+        }
+
+        if (burst > 0 && switchIndex % 20 == 19) {
+            burstLeft = burst;
+        }
+        if (burstLeft > 0) {
+            --burstLeft;
+        } else {
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(dwellMs));
+        }
+    }
+
+    const PrefetchConverter::Statistics statistics = prefetch.statistics();
+    const double hitRate = static_cast<double>(hits) / switches;
+    std::cout << "Played " << switches << " switches over " << playlist.Size() << " presets"
+              << (shuffle ? " (shuffle)" : "") << ": " << hits << " cache hits (" << 100.0 * hitRate << "%), stalled "
+              << stallTotalMs << " ms in total, " << stallMaxMs << " ms at most\n"
+              << "  prefetched " << statistics.prefetched << ", cancelled " << statistics.cancelled << ", evicted "
+              << statistics.evictions << "; cache " << statistics.cachedPresets << " presets, "
+              << statistics.cachedBytes / 1024 << " of " << settings.cacheBytes / 1024 << " KiB; update() "
+              << updateTotalMs / switches << " ms per switch\n";
+    if (verify) {
+        std::cout << "  verified " << switches << " switches against fresh conversions: " << mismatches << " mismatches\n";
+    }
+
+    if (!reportPath.empty()) {
+        std::ofstream report(reportPath);
+        if (!report) {
+            std::cerr << "Error: Could not open report output for writing: " << reportPath << "\n";
+            return 1;
+        }
+        report << "{\n"
+               << "  \"presets\": " << playlist.Size() << ",\n"
+               << "  \"switches\": " << switches << ",\n"
+               << "  \"hits\": " << hits << ",\n"
+               << "  \"hit_rate\": " << hitRate << ",\n"
+               << "  \"stall_ms_total\": " << stallTotalMs << ",\n"
+               << "  \"stall_ms_max\": " << stallMaxMs << ",\n"
+               << "  \"update_ms_mean\": " << updateTotalMs / switches << ",\n"
+               << "  \"failed_presets\": " << failed << ",\n"
+               << "  \"out_of_range_draws\": " << skipped << ",\n"
+               << "  \"mismatches\": " << mismatches << ",\n"
+               << "  \"acquire_hits\": " << statistics.hits << ",\n"
+               << "  \"acquire_misses\": " << statistics.misses << ",\n"
+               << "  \"prefetched\": " << statistics.prefetched << ",\n"
+               << "  \"cancelled\": " << statistics.cancelled << ",\n"
+               << "  \"evictions\": " << statistics.evictions << ",\n"
+               << "  \"cached_presets\": " << statistics.cachedPresets << ",\n"
+               << "  \"cached_bytes\": " << statistics.cachedBytes << ",\n"
+               << "  \"cache_capacity\": " << settings.cacheBytes << "\n"
+               << "}\n";
+    }
+    return mismatches > 0 ? 1 : 0;
+}
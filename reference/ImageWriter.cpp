@@ -0,0 +1,151 @@
+#include "ImageWriter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+
+namespace {
+
+bool endsWith(const std::string& text, const std::string& suffix)
+{
+    if (text.size() < suffix.size())
+    {
+        return false;
+    }
+    return std::equal(suffix.rbegin(), suffix.rend(), text.rbegin(),
+                      [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+}
+
+unsigned char level(float value)
+{
+    return static_cast<unsigned char>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+{
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> entries{};
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+        return entries;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void putU32BE(std::vector<unsigned char>& out, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        out.push_back(static_cast<unsigned char>(value >> shift));
+    }
+}
+
+void appendChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+{
+    putU32BE(out, static_cast<uint32_t>(data.size()));
+    const size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putU32BE(out, crc32(out.data() + start, out.size() - start));
+}
+
+} // namespace
+
+bool ImageWriter::supported(const std::string& path)
+{
+    return endsWith(path, ".png") || endsWith(path, ".ppm");
+}
+
+bool ImageWriter::write(const std::string& path, const std::vector<float>& rgb, int width, int height)
+{
+    if (!supported(path))
+    {
+        return fail("Unsupported image format (expected .png or .ppm): " + path);
+    }
+    const bool png = endsWith(path, ".png");
+
+    // Image rows top first; PNG rows start with a filter byte (0, none).
+    const size_t rowBytes = static_cast<size_t>(width) * 3 + (png ? 1 : 0);
+    m_bytes.assign(rowBytes * static_cast<size_t>(height), 0);
+    for (int y = 0; y < height; ++y)
+    {
+        const float* source = rgb.data() + static_cast<size_t>(height - 1 - y) * width * 3;
+        unsigned char* row = m_bytes.data() + rowBytes * y + (png ? 1 : 0);
+        for (int i = 0; i < width * 3; ++i)
+        {
+            row[i] = level(source[i]);
+        }
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        return fail("Could not open output file for writing: " + path);
+    }
+    if (!png)
+    {
+        out << "P6\n" << width << " " << height << "\n255\n";
+        out.write(reinterpret_cast<const char*>(m_bytes.data()), static_cast<std::streamsize>(m_bytes.size()));
+        return out ? true : fail("Could not write " + path);
+    }
+
+    std::vector<unsigned char> file = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::vector<unsigned char> header;
+    putU32BE(header, static_cast<uint32_t>(width));
+    putU32BE(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), {8, 2, 0, 0, 0}); // 8-bit RGB, deflate, no interlace
+    appendChunk(file, "IHDR", header);
+
+    // zlib stream of stored deflate blocks (at most 65535 bytes each) and an Adler-32.
+    std::vector<unsigned char> stream = {0x78, 0x01};
+    constexpr size_t kBlock = 65535;
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (size_t offset = 0;; offset += kBlock)
+    {
+        const size_t size = std::min(kBlock, m_bytes.size() - offset);
+        const bool last = offset + size >= m_bytes.size();
+        stream.push_back(last ? 1 : 0);
+        stream.push_back(static_cast<unsigned char>(size & 0xFF));
+        stream.push_back(static_cast<unsigned char>(size >> 8));
+        stream.push_back(static_cast<unsigned char>(~size & 0xFF));
+        stream.push_back(static_cast<unsigned char>((~size >> 8) & 0xFF));
+        stream.insert(stream.end(), m_bytes.begin() + offset, m_bytes.begin() + offset + size);
+        for (size_t i = offset; i < offset + size; ++i)
+        {
+            a = (a + m_bytes[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        if (last)
+        {
+            break;
+        }
+    }
+    putU32BE(stream, (b << 16) | a);
+    appendChunk(file, "IDAT", stream);
+    appendChunk(file, "IEND", {});
+
+    out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+    return out ? true : fail("Could not write " + path);
+}
+
+bool ImageWriter::fail(const std::string& message)
+{
+    m_error = message;
+    return false;
+}
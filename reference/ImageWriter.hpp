@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Writes float RGB frames (bottom row first) as 8-bit images.
+ *
+ * Values are clamped to [0, 1] and rounded to the nearest of 256 levels. PNG files use
+ * uncompressed deflate blocks, so no zlib is needed; the pixels match the PPM exactly.
+ */
+class ImageWriter
+{
+public:
+    /// Writes @p path as PNG or binary PPM (P6), chosen by its extension (.png or .ppm).
+    bool write(const std::string& path, const std::vector<float>& rgb, int width, int height);
+
+    /// Whether write() knows the extension of @p path.
+    static bool supported(const std::string& path);
+
+    const std::string& error() const { return m_error; }
+
+private:
+    bool fail(const std::string& message);
+
+    std::vector<unsigned char> m_bytes;
+    std::string m_error;
+};
@@ -0,0 +1,173 @@
+#include "ReferenceAudio.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+constexpr float kPi = 3.14159265f;
+
+AudioBands mix(const AudioBands& a, const AudioBands& b, float t)
+{
+    auto lerp = [t](float x, float y) { return x + (y - x) * t; };
+    AudioBands bands;
+    bands.bass = lerp(a.bass, b.bass);
+    bands.mid = lerp(a.mid, b.mid);
+    bands.treb = lerp(a.treb, b.treb);
+    bands.vol = lerp(a.vol, b.vol);
+    bands.bassAtt = lerp(a.bassAtt, b.bassAtt);
+    bands.midAtt = lerp(a.midAtt, b.midAtt);
+    bands.trebAtt = lerp(a.trebAtt, b.trebAtt);
+    bands.volAtt = lerp(a.volAtt, b.volAtt);
+    return bands;
+}
+
+} // namespace
+
+bool AudioSchedule::openSchedule(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        return fail("Could not read audio schedule " + path);
+    }
+    m_keys.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::vector<float> values;
+        float value = 0.0f;
+        while (fields >> value)
+        {
+            values.push_back(value);
+        }
+        if (values.empty() && fields.eof())
+        {
+            continue;
+        }
+        if (!fields.eof() || (values.size() != 5 && values.size() != 9))
+        {
+            return fail(path + ":" + std::to_string(lineNumber) +
+                        ": expected \"time bass mid treb vol\" with optional attenuated levels");
+        }
+        Key key;
+        key.time = values[0];
+        key.bands.bass = values[1];
+        key.bands.mid = values[2];
+        key.bands.treb = values[3];
+        key.bands.vol = values[4];
+        const bool attenuated = values.size() == 9;
+        key.bands.bassAtt = values[attenuated ? 5 : 1];
+        key.bands.midAtt = values[attenuated ? 6 : 2];
+        key.bands.trebAtt = values[attenuated ? 7 : 3];
+        key.bands.volAtt = values[attenuated ? 8 : 4];
+        if (!m_keys.empty() && key.time < m_keys.back().time)
+        {
+            return fail(path + ":" + std::to_string(lineNumber) + ": times must not decrease");
+        }
+        m_keys.push_back(key);
+    }
+    if (m_keys.empty())
+    {
+        return fail(path + " has no entries");
+    }
+    return true;
+}
+
+bool AudioSchedule::openTrack(const std::string& path)
+{
+    if (!m_track.open(path))
+    {
+        return fail(m_track.error());
+    }
+    if (m_track.header().frameCount == 0)
+    {
+        return fail(path + " has no frames");
+    }
+    m_hasTrack = true;
+    return true;
+}
+
+bool AudioSchedule::frameAt(float time, ReferenceAudioFrame& frame)
+{
+    if (!m_hasTrack)
+    {
+        frame.bands = m_keys.empty() ? m_constant : scheduledBands(time);
+        synthesize(time, frame);
+        return true;
+    }
+
+    const auto& header = m_track.header();
+    const long index = std::lround(time * header.fps) - 1;
+    const auto clamped = static_cast<uint32_t>(std::clamp(index, 0L, static_cast<long>(header.frameCount) - 1));
+    if (!m_track.read(clamped, m_record))
+    {
+        return fail(m_track.error());
+    }
+    frame.bands = m_record.bands;
+    synthesize(time, frame);
+    const size_t waveform = std::min(m_record.waveform.size() / 2, frame.waveformLeft.size());
+    for (size_t i = 0; i < waveform; ++i)
+    {
+        frame.waveformLeft[i] = m_record.waveform[i * 2];
+        frame.waveformRight[i] = m_record.waveform[i * 2 + 1];
+    }
+    const size_t spectrum = std::min(m_record.spectrum.size() / 2, frame.spectrumLeft.size());
+    for (size_t i = 0; i < spectrum; ++i)
+    {
+        frame.spectrumLeft[i] = m_record.spectrum[i * 2];
+        frame.spectrumRight[i] = m_record.spectrum[i * 2 + 1];
+    }
+    return true;
+}
+
+void AudioSchedule::synthesize(float time, ReferenceAudioFrame& frame)
+{
+    const AudioBands& bands = frame.bands;
+    const auto samples = static_cast<float>(frame.waveformLeft.size());
+    for (size_t i = 0; i < frame.waveformLeft.size(); ++i)
+    {
+        const float phase = 2.0f * kPi * static_cast<float>(i) / samples;
+        const float bass = 0.3f * bands.bass * std::sin(3.0f * phase + 4.1f * time);
+        frame.waveformLeft[i] = std::clamp(bass + 0.12f * bands.treb * std::sin(37.0f * phase + 9.7f * time), -1.0f, 1.0f);
+        frame.waveformRight[i] = std::clamp(bass + 0.12f * bands.treb * std::sin(29.0f * phase - 7.3f * time), -1.0f, 1.0f);
+    }
+    for (size_t i = 0; i < frame.spectrumLeft.size(); ++i)
+    {
+        const auto bin = static_cast<float>(i);
+        const float midOffset = (bin - 100.0f) / 60.0f;
+        const float trebOffset = (bin - 300.0f) / 150.0f;
+        const float shape = 2.0f * bands.bass * std::exp(-bin / 16.0f) + bands.mid * std::exp(-midOffset * midOffset) +
+                            0.5f * bands.treb * std::exp(-trebOffset * trebOffset) + 0.05f;
+        frame.spectrumLeft[i] = 128.0f * shape;
+        frame.spectrumRight[i] = 128.0f * shape * (1.0f + 0.1f * std::sin(0.05f * bin + time));
+    }
+}
+
+AudioBands AudioSchedule::scheduledBands(float time) const
+{
+    if (time <= m_keys.front().time)
+    {
+        return m_keys.front().bands;
+    }
+    if (time >= m_keys.back().time)
+    {
+        return m_keys.back().bands;
+    }
+    auto next = std::upper_bound(m_keys.begin(), m_keys.end(), time, [](float t, const Key& key) { return t < key.time; });
+    auto previous = next - 1;
+    const float span = next->time - previous->time;
+    return span > 0.0f ? mix(previous->bands, next->bands, (time - previous->time) / span) : next->bands;
+}
+
+bool AudioSchedule::fail(const std::string& message)
+{
+    m_error = message;
+    return false;
+}
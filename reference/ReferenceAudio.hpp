@@ -0,0 +1,72 @@
+#pragma once
+
+#include "AudioTexturePacker.hpp"
+#include "FeatureTrack.hpp"
+
+#include <array>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The audio one reference frame is rendered with.
+ *
+ * The waveform uses the iAudioTexture scale, [-1, 1] (libprojectM's PCM values / 128); the
+ * spectrum is in libprojectM's units, as in a feature track.
+ */
+struct ReferenceAudioFrame
+{
+    AudioBands bands;
+    std::array<float, AudioTexturePacker::kWaveformSamples> waveformLeft{};
+    std::array<float, AudioTexturePacker::kWaveformSamples> waveformRight{};
+    std::array<float, AudioTexturePacker::kWidth> spectrumLeft{};
+    std::array<float, AudioTexturePacker::kWidth> spectrumRight{};
+};
+
+/**
+ * @brief Deterministic audio for the reference renderer, looked up by frame time.
+ *
+ * Three sources, in order of precedence:
+ * - a feature track (.mdaf): the record at the frame time, as MilkdropRender --audio-track
+ *   picks it; tracks without waveform or spectrum rows get synthetic ones;
+ * - a band schedule: lines of "time bass mid treb vol", optionally followed by the four
+ *   attenuated levels, interpolated linearly between lines and held before the first and
+ *   after the last ("#" starts a comment);
+ * - constant bands (1.0 each unless set).
+ *
+ * Without a track the waveform and spectrum are synthesized from the bands: sines whose
+ * amplitudes follow bass and treb, and a spectrum with bass, mid and treb humps. They depend
+ * only on the time and the bands, so every run sees the same audio.
+ */
+class AudioSchedule
+{
+public:
+    void setConstant(const AudioBands& bands) { m_constant = bands; }
+
+    bool openSchedule(const std::string& path);
+    bool openTrack(const std::string& path);
+
+    /// Fills @p frame with the audio at @p time (seconds).
+    bool frameAt(float time, ReferenceAudioFrame& frame);
+
+    const std::string& error() const { return m_error; }
+
+    /// Synthetic waveform and spectrum for the bands already in @p frame, at @p time.
+    static void synthesize(float time, ReferenceAudioFrame& frame);
+
+private:
+    struct Key
+    {
+        float time{0.0f};
+        AudioBands bands;
+    };
+
+    bool fail(const std::string& message);
+    AudioBands scheduledBands(float time) const;
+
+    AudioBands m_constant;
+    std::vector<Key> m_keys;
+    FeatureTrackReader m_track;
+    FeatureFrame m_record;
+    bool m_hasTrack{false};
+    std::string m_error;
+};
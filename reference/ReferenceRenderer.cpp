@@ -0,0 +1,893 @@
+#include "ReferenceRenderer.hpp"
+
+#include "PresetValues.hpp"
+#include "ReferenceWaveform.hpp"
+
+#include "projectm-eval.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+constexpr int kQVariables = 32;
+constexpr int kTileRows = 16; // Pixel rows per warp and wave task
+
+enum class Kind
+{
+    Float,
+    Int,  // PresetFileParser::GetInt(): truncated
+    Flag, // PresetFileParser::GetBool(): on when the integer value is positive
+};
+
+struct StateVariable
+{
+    const char* name;
+    const char* key;
+    float fallback;
+    Kind kind;
+};
+
+// PerFrameContext::LoadStateVariables(): per-frame variables that start every frame at their
+// preset file value (PresetState defaults when the file has none).
+const StateVariable kStateVariables[] = {
+    {"zoom", "zoom", 1.0f, Kind::Float},
+    {"zoomexp", "fzoomexponent", 1.0f, Kind::Float},
+    {"rot", "rot", 0.0f, Kind::Float},
+    {"warp", "warp", 1.0f, Kind::Float},
+    {"cx", "cx", 0.5f, Kind::Float},
+    {"cy", "cy", 0.5f, Kind::Float},
+    {"dx", "dx", 0.0f, Kind::Float},
+    {"dy", "dy", 0.0f, Kind::Float},
+    {"sx", "sx", 1.0f, Kind::Float},
+    {"sy", "sy", 1.0f, Kind::Float},
+    {"decay", "fdecay", 0.98f, Kind::Float},
+    {"wave_a", "fwavealpha", 0.8f, Kind::Float},
+    {"wave_r", "wave_r", 1.0f, Kind::Float},
+    {"wave_g", "wave_g", 1.0f, Kind::Float},
+    {"wave_b", "wave_b", 1.0f, Kind::Float},
+    {"wave_x", "wave_x", 0.5f, Kind::Float},
+    {"wave_y", "wave_y", 0.5f, Kind::Float},
+    {"wave_mystery", "fwaveparam", 0.0f, Kind::Float},
+    {"wave_mode", "nwavemode", 0.0f, Kind::Int},
+    {"ob_size", "ob_size", 0.01f, Kind::Float},
+    {"ob_r", "ob_r", 0.0f, Kind::Float},
+    {"ob_g", "ob_g", 0.0f, Kind::Float},
+    {"ob_b", "ob_b", 0.0f, Kind::Float},
+    {"ob_a", "ob_a", 0.0f, Kind::Float},
+    {"ib_size", "ib_size", 0.01f, Kind::Float},
+    {"ib_r", "ib_r", 0.25f, Kind::Float},
+    {"ib_g", "ib_g", 0.25f, Kind::Float},
+    {"ib_b", "ib_b", 0.25f, Kind::Float},
+    {"ib_a", "ib_a", 0.0f, Kind::Float},
+    {"mv_x", "nmotionvectorsx", 12.0f, Kind::Float},
+    {"mv_y", "nmotionvectorsy", 9.0f, Kind::Float},
+    {"mv_dx", "mv_dx", 0.0f, Kind::Float},
+    {"mv_dy", "mv_dy", 0.0f, Kind::Float},
+    {"mv_l", "mv_l", 0.9f, Kind::Float},
+    {"mv_r", "mv_r", 1.0f, Kind::Float},
+    {"mv_g", "mv_g", 1.0f, Kind::Float},
+    {"mv_b", "mv_b", 1.0f, Kind::Float},
+    {"echo_zoom", "fvideoechozoom", 2.0f, Kind::Float},
+    {"echo_alpha", "fvideoechoalpha", 0.0f, Kind::Float},
+    {"echo_orient", "nvideoechoorientation", 0.0f, Kind::Int},
+    {"wave_usedots", "bwavedots", 0.0f, Kind::Flag},
+    {"wave_thick", "bwavethick", 0.0f, Kind::Flag},
+    {"wave_additive", "badditivewaves", 0.0f, Kind::Flag},
+    {"wave_brighten", "bmaximizewavecolor", 1.0f, Kind::Flag},
+    {"darken_center", "bdarkencenter", 0.0f, Kind::Flag},
+    {"gamma", "fgammaadj", 2.0f, Kind::Float},
+    {"wrap", "btexwrap", 1.0f, Kind::Flag},
+    {"invert", "binvert", 0.0f, Kind::Flag},
+    {"brighten", "bbrighten", 0.0f, Kind::Flag},
+    {"darken", "bdarken", 0.0f, Kind::Flag},
+    {"solarize", "bsolarize", 0.0f, Kind::Flag},
+    {"blur1_min", "b1n", 0.0f, Kind::Float},
+    {"blur2_min", "b2n", 0.0f, Kind::Float},
+    {"blur3_min", "b3n", 0.0f, Kind::Float},
+    {"blur1_max", "b1x", 1.0f, Kind::Float},
+    {"blur2_max", "b2x", 1.0f, Kind::Float},
+    {"blur3_max", "b3x", 1.0f, Kind::Float},
+    {"blur1_edge_darken", "b1ed", 0.25f, Kind::Float},
+};
+
+// The ten motion variables the per-pixel code may change per vertex, in Transform order.
+const char* const kTransformVariables[] = {"zoom", "zoomexp", "rot", "warp", "cx", "cy", "dx", "dy", "sx", "sy"};
+
+// Read-only inputs of both contexts, in ReadOnly order.
+const char* const kReadOnlyVariables[] = {"time",     "fps",      "frame",   "progress", "bass",    "mid",
+                                          "treb",     "bass_att", "mid_att", "treb_att", "meshx",   "meshy",
+                                          "pixelsx",  "pixelsy",  "aspectx", "aspecty"};
+constexpr size_t kReadOnlyCount = sizeof(kReadOnlyVariables) / sizeof(kReadOnlyVariables[0]);
+
+// Per-pixel code using any of these reads or writes state shared between vertices.
+const char* const kSharedState[] = {"megabuf", "gmegabuf", "freembuf", "memcpy", "memset", "rand"};
+
+std::string sharedStateUse(const std::string& code)
+{
+    for (const char* name : kSharedState)
+    {
+        if (presetCodeMentions(code, name))
+        {
+            return name;
+        }
+    }
+    for (int reg = 0; reg < 100; ++reg)
+    {
+        char name[8];
+        std::snprintf(name, sizeof(name), "reg%02d", reg);
+        if (presetCodeMentions(code, name))
+        {
+            return name;
+        }
+    }
+    return std::string();
+}
+
+float stateValue(const std::map<std::string, std::string>& presetValues, const StateVariable& variable)
+{
+    float value = presetFloat(presetValues, variable.key, variable.fallback);
+    if (variable.kind == Kind::Int)
+    {
+        value = std::trunc(value);
+    }
+    else if (variable.kind == Kind::Flag)
+    {
+        value = value >= 1.0f ? 1.0f : 0.0f;
+    }
+    return value;
+}
+
+double millisSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Transform
+{
+    std::array<float, 10> values{}; // kTransformVariables order
+
+    float zoom() const { return values[0]; }
+    float zoomExp() const { return values[1]; }
+    float rot() const { return values[2]; }
+    float warp() const { return values[3]; }
+    float cx() const { return values[4]; }
+    float cy() const { return values[5]; }
+    float dx() const { return values[6]; }
+    float dy() const { return values[7]; }
+    float sx() const { return values[8]; }
+    float sy() const { return values[9]; }
+};
+
+struct MeshVertex
+{
+    float x{0.0f}; // Clip space, y up
+    float y{0.0f};
+    float radius{0.0f};
+    float angle{0.0f};
+    float u{0.0f}; // Warped texture coordinate
+    float v{0.0f};
+};
+
+struct WarpUniforms
+{
+    float aspectX{1.0f};
+    float aspectY{1.0f};
+    float invAspectX{1.0f};
+    float invAspectY{1.0f};
+    float warpTime{0.0f};
+    float warpScaleInverse{1.0f};
+    std::array<float, 4> factors{};
+    float texelOffsetX{0.0f};
+    float texelOffsetY{0.0f};
+};
+
+// PresetWarpVertexShaderGlsl330.vert for one vertex.
+void warpVertex(MeshVertex& vertex, const Transform& t, const WarpUniforms& w)
+{
+    const float zoom2 = std::pow(t.zoom(), std::pow(t.zoomExp(), vertex.radius * 2.0f - 1.0f));
+    const float zoom2Inverse = 1.0f / zoom2;
+
+    float u = vertex.x * w.aspectX * 0.5f * zoom2Inverse + 0.5f;
+    float v = vertex.y * w.aspectY * 0.5f * zoom2Inverse + 0.5f;
+
+    u = (u - t.cx()) / t.sx() + t.cx();
+    v = (v - t.cy()) / t.sy() + t.cy();
+
+    const float x = vertex.x;
+    const float y = vertex.y;
+    const float amount = t.warp() * 0.0035f;
+    u += amount * std::sin(w.warpTime * 0.333f + w.warpScaleInverse * (x * w.factors[0] - y * w.factors[3]));
+    v += amount * std::cos(w.warpTime * 0.375f - w.warpScaleInverse * (x * w.factors[2] + y * w.factors[1]));
+    u += amount * std::cos(w.warpTime * 0.753f - w.warpScaleInverse * (x * w.factors[1] - y * w.factors[2]));
+    v += amount * std::sin(w.warpTime * 0.825f + w.warpScaleInverse * (x * w.factors[0] + y * w.factors[3]));
+
+    const float u2 = u - t.cx();
+    const float v2 = v - t.cy();
+    const float cosRotation = std::cos(t.rot());
+    const float sinRotation = std::sin(t.rot());
+    u = u2 * cosRotation - v2 * sinRotation + t.cx();
+    v = u2 * sinRotation + v2 * cosRotation + t.cy();
+
+    u -= t.dx();
+    v -= t.dy();
+
+    u = (u - 0.5f) * w.invAspectX + 0.5f;
+    v = (v - 0.5f) * w.invAspectY + 0.5f;
+
+    vertex.u = u + w.texelOffsetX;
+    vertex.v = v + w.texelOffsetY;
+}
+
+// An eval context running the per-pixel code, owned by one worker.
+struct PixelContext
+{
+    projectm_eval_context* context{nullptr};
+    projectm_eval_code* code{nullptr};
+    PRJM_EVAL_F* x{nullptr};
+    PRJM_EVAL_F* y{nullptr};
+    PRJM_EVAL_F* rad{nullptr};
+    PRJM_EVAL_F* ang{nullptr};
+    std::array<PRJM_EVAL_F*, 10> transform{};
+    std::array<PRJM_EVAL_F*, kReadOnlyCount> readOnly{};
+    std::array<PRJM_EVAL_F*, kQVariables> q{};
+};
+
+// A wave segment in window coordinates (pixels, y up); a dot when both ends are the same point.
+struct WaveSegment
+{
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+    bool dot;
+};
+
+} // namespace
+
+struct ReferenceRenderer::State
+{
+    int width{0};
+    int height{0};
+    int meshX{0};
+    int meshY{0};
+    WarpUniforms warp;
+
+    // Settings the per-frame code cannot change.
+    int waveMode{0};
+    float waveScale{1.0f};
+    float waveSmoothing{0.75f};
+    float warpAnimSpeed{1.0f};
+    float warpScale{1.0f};
+    bool modWaveAlphaByVolume{false};
+    float modWaveAlphaStart{0.75f};
+    float modWaveAlphaEnd{0.95f};
+
+    projectm_eval_mem_buffer globalMemory{nullptr};
+    PRJM_EVAL_F globalRegisters[100]{};
+
+    projectm_eval_context* frameContext{nullptr};
+    projectm_eval_code* frameCode{nullptr};
+    std::map<std::string, PRJM_EVAL_F*> frameVariables;
+    std::vector<std::pair<PRJM_EVAL_F*, float>> stateValues;
+    std::array<PRJM_EVAL_F*, kReadOnlyCount> frameReadOnly{};
+    std::array<PRJM_EVAL_F*, kQVariables> frameQ{};
+    std::array<PRJM_EVAL_F, kQVariables> qAfterInit{};
+
+    bool hasPixelCode{false};
+    std::string serialReason;
+    std::vector<PixelContext> pixelContexts;
+    std::array<PRJM_EVAL_F, kReadOnlyCount> readOnly{};
+    std::array<PRJM_EVAL_F, kQVariables> q{};
+    Transform frameTransform;
+
+    std::vector<MeshVertex> mesh;
+    std::vector<float> previous;
+    std::vector<float> current;
+    std::vector<WaveSegment> segments;
+    ReferenceFrameTimings timings;
+
+    ~State()
+    {
+        for (auto& pixel : pixelContexts)
+        {
+            if (pixel.code)
+            {
+                projectm_eval_code_destroy(pixel.code);
+            }
+            if (pixel.context)
+            {
+                projectm_eval_context_destroy(pixel.context);
+            }
+        }
+        if (frameCode)
+        {
+            projectm_eval_code_destroy(frameCode);
+        }
+        if (frameContext)
+        {
+            projectm_eval_context_destroy(frameContext);
+        }
+        if (globalMemory)
+        {
+            projectm_eval_memory_buffer_destroy(globalMemory);
+        }
+    }
+
+    float frameValue(const char* name) const
+    {
+        return static_cast<float>(*frameVariables.at(name));
+    }
+
+    // One mesh row of per-pixel code and warp coordinates on the context of @p worker.
+    void computeRow(int row, int worker, bool resetVariables)
+    {
+        PixelContext* pixel = hasPixelCode ? &pixelContexts[static_cast<size_t>(worker)] : nullptr;
+        if (pixel)
+        {
+            if (resetVariables)
+            {
+                projectm_eval_context_reset_variables(pixel->context);
+            }
+            for (size_t i = 0; i < kReadOnlyCount; ++i)
+            {
+                *pixel->readOnly[i] = readOnly[i];
+            }
+            for (int i = 0; i < kQVariables; ++i)
+            {
+                *pixel->q[i] = q[i];
+            }
+        }
+
+        Transform transform = frameTransform;
+        for (int column = 0; column <= meshX; ++column)
+        {
+            MeshVertex& vertex = mesh[static_cast<size_t>(row) * (meshX + 1) + column];
+            if (pixel)
+            {
+                *pixel->x = static_cast<PRJM_EVAL_F>(vertex.x * 0.5f * warp.aspectX + 0.5f);
+                *pixel->y = static_cast<PRJM_EVAL_F>(vertex.y * -0.5f * warp.aspectY + 0.5f);
+                *pixel->rad = static_cast<PRJM_EVAL_F>(vertex.radius);
+                *pixel->ang = static_cast<PRJM_EVAL_F>(vertex.angle);
+                for (size_t i = 0; i < transform.values.size(); ++i)
+                {
+                    *pixel->transform[i] = static_cast<PRJM_EVAL_F>(frameTransform.values[i]);
+                }
+                projectm_eval_code_execute(pixel->code);
+                for (size_t i = 0; i < transform.values.size(); ++i)
+                {
+                    transform.values[i] = static_cast<float>(*pixel->transform[i]);
+                }
+            }
+            warpVertex(vertex, transform, warp);
+        }
+    }
+};
+
+ReferenceRenderer::ReferenceRenderer(int threads)
+    : m_pool(threads)
+{
+}
+
+ReferenceRenderer::~ReferenceRenderer() = default;
+
+bool ReferenceRenderer::load(const std::map<std::string, std::string>& presetValues, int width, int height, int meshX,
+                             int meshY)
+{
+    if (width <= 0 || height <= 0 || meshX <= 0 || meshY <= 0)
+    {
+        return fail("Frame and mesh sizes must be positive");
+    }
+    m_state = std::make_unique<State>();
+    State& state = *m_state;
+    state.width = width;
+    state.height = height;
+    state.meshX = meshX;
+    state.meshY = meshY;
+
+    // ProjectM::SetWindowSize()
+    WarpUniforms& warp = state.warp;
+    warp.aspectX = height > width ? static_cast<float>(width) / static_cast<float>(height) : 1.0f;
+    warp.aspectY = width > height ? static_cast<float>(height) / static_cast<float>(width) : 1.0f;
+    warp.invAspectX = 1.0f / warp.aspectX;
+    warp.invAspectY = 1.0f / warp.aspectY;
+    warp.texelOffsetX = 0.5f / static_cast<float>(width);
+    warp.texelOffsetY = 0.5f / static_cast<float>(height);
+
+    const int waveMode = static_cast<int>(std::trunc(presetFloat(presetValues, "nwavemode", 0.0f)));
+    state.waveMode = ((waveMode % ReferenceWaveform::kModeCount) + ReferenceWaveform::kModeCount) % ReferenceWaveform::kModeCount;
+    state.waveScale = presetFloat(presetValues, "fwavescale", 1.0f);
+    state.waveSmoothing = presetFloat(presetValues, "fwavesmoothing", 0.75f);
+    state.warpAnimSpeed = presetFloat(presetValues, "fwarpanimspeed", 1.0f);
+    state.warpScale = presetFloat(presetValues, "fwarpscale", 1.0f);
+    state.modWaveAlphaByVolume = presetFloat(presetValues, "bmodwavealphabyvolume", 0.0f) >= 1.0f;
+    state.modWaveAlphaStart = presetFloat(presetValues, "fmodwavealphastart", 0.75f);
+    state.modWaveAlphaEnd = presetFloat(presetValues, "fmodwavealphaend", 0.95f);
+
+    // Per-frame context. gmegabuf and reg00-reg99 are shared with the per-pixel contexts.
+    state.globalMemory = projectm_eval_memory_buffer_create();
+    state.frameContext = projectm_eval_context_create(state.globalMemory, &state.globalRegisters);
+    if (!state.frameContext)
+    {
+        return fail("Could not create an expression context");
+    }
+    auto registerFrame = [&](const std::string& name) {
+        PRJM_EVAL_F* value = projectm_eval_context_register_variable(state.frameContext, name.c_str());
+        state.frameVariables[name] = value;
+        return value;
+    };
+    for (const auto& variable : kStateVariables)
+    {
+        state.stateValues.emplace_back(registerFrame(variable.name), stateValue(presetValues, variable));
+    }
+    // bMotionVectorsOn predates mv_a.
+    const float motionVectors = presetFloat(presetValues, "bmotionvectorson", 0.0f) >= 1.0f ? 1.0f : 0.0f;
+    state.stateValues.emplace_back(registerFrame("mv_a"), presetFloat(presetValues, "mv_a", motionVectors));
+    for (size_t i = 0; i < kReadOnlyCount; ++i)
+    {
+        state.frameReadOnly[i] = registerFrame(kReadOnlyVariables[i]);
+    }
+    for (int i = 0; i < kQVariables; ++i)
+    {
+        state.frameQ[i] = registerFrame("q" + std::to_string(i + 1));
+    }
+
+    auto compile = [&](projectm_eval_context* context, const std::string& code, const char* what) -> projectm_eval_code* {
+        projectm_eval_code* handle = projectm_eval_code_compile(context, code.c_str());
+        if (!handle)
+        {
+            int line = 0;
+            int column = 0;
+            const char* message = projectm_eval_get_error(context, &line, &column);
+            fail(std::string("Could not compile ") + what + " code: " + (message ? message : "unknown error") + " (line " +
+                 std::to_string(line) + ", column " + std::to_string(column) + ")");
+        }
+        return handle;
+    };
+
+    // PerFrameContext::EvaluateInitCode(); the state variables hold their file values.
+    for (const auto& value : state.stateValues)
+    {
+        *value.first = value.second;
+    }
+    const std::string initCode = presetCode(presetValues, "per_frame_init_");
+    if (!initCode.empty())
+    {
+        projectm_eval_code* init = compile(state.frameContext, initCode, "per-frame init");
+        if (!init)
+        {
+            return false;
+        }
+        projectm_eval_code_execute(init);
+        projectm_eval_code_destroy(init);
+    }
+    for (int i = 0; i < kQVariables; ++i)
+    {
+        state.qAfterInit[i] = *state.frameQ[i];
+    }
+
+    const std::string frameCode = presetCode(presetValues, "per_frame_");
+    if (!frameCode.empty() && !(state.frameCode = compile(state.frameContext, frameCode, "per-frame")))
+    {
+        return false;
+    }
+
+    const std::string pixelCode = presetCode(presetValues, "per_pixel_");
+    state.hasPixelCode = !pixelCode.empty();
+    if (state.hasPixelCode)
+    {
+        state.serialReason = sharedStateUse(pixelCode);
+        const int contexts = state.serialReason.empty() ? m_pool.size() : 1;
+        state.pixelContexts.resize(static_cast<size_t>(contexts));
+        for (auto& pixel : state.pixelContexts)
+        {
+            pixel.context = projectm_eval_context_create(state.globalMemory, &state.globalRegisters);
+            if (!pixel.context)
+            {
+                return fail("Could not create an expression context");
+            }
+            auto registerPixel = [&](const std::string& name) {
+                return projectm_eval_context_register_variable(pixel.context, name.c_str());
+            };
+            pixel.x = registerPixel("x");
+            pixel.y = registerPixel("y");
+            pixel.rad = registerPixel("rad");
+            pixel.ang = registerPixel("ang");
+            for (size_t i = 0; i < pixel.transform.size(); ++i)
+            {
+                pixel.transform[i] = registerPixel(kTransformVariables[i]);
+            }
+            for (size_t i = 0; i < kReadOnlyCount; ++i)
+            {
+                pixel.readOnly[i] = registerPixel(kReadOnlyVariables[i]);
+            }
+            for (int i = 0; i < kQVariables; ++i)
+            {
+                pixel.q[i] = registerPixel("q" + std::to_string(i + 1));
+            }
+            if (!(pixel.code = compile(pixel.context, pixelCode, "per-pixel")))
+            {
+                return false;
+            }
+        }
+    }
+
+    // PerPixelMesh::InitializeMesh()
+    state.mesh.resize(static_cast<size_t>(meshX + 1) * (meshY + 1));
+    for (int gridY = 0; gridY <= meshY; ++gridY)
+    {
+        for (int gridX = 0; gridX <= meshX; ++gridX)
+        {
+            MeshVertex& vertex = state.mesh[static_cast<size_t>(gridY) * (meshX + 1) + gridX];
+            vertex.x = static_cast<float>(gridX) / static_cast<float>(meshX) * 2.0f - 1.0f;
+            vertex.y = static_cast<float>(gridY) / static_cast<float>(meshY) * 2.0f - 1.0f;
+            vertex.radius = std::hypot(vertex.x * warp.aspectX, vertex.y * warp.aspectY);
+            vertex.angle = (gridY == meshY / 2 && gridX == meshX / 2) ? 0.0f
+                                                                      : std::atan2(vertex.y * warp.aspectY, vertex.x * warp.aspectX);
+        }
+    }
+
+    state.previous.assign(static_cast<size_t>(width) * height * 3, 0.0f);
+    state.current.assign(state.previous.size(), 0.0f);
+    return true;
+}
+
+void ReferenceRenderer::renderFrame(const ReferenceFrameInputs& inputs)
+{
+    State& state = *m_state;
+    const auto frameStart = std::chrono::steady_clock::now();
+
+    auto start = frameStart;
+    runPerFrame(inputs);
+    state.timings.perFrameMillis = millisSince(start);
+
+    start = std::chrono::steady_clock::now();
+    computeMesh(inputs);
+    state.timings.meshMillis = millisSince(start);
+
+    start = std::chrono::steady_clock::now();
+    warp(inputs);
+    state.timings.warpMillis = millisSince(start);
+
+    start = std::chrono::steady_clock::now();
+    drawWave(inputs);
+    state.timings.waveMillis = millisSince(start);
+
+    state.previous.swap(state.current);
+    state.timings.totalMillis = millisSince(frameStart);
+}
+
+void ReferenceRenderer::runPerFrame(const ReferenceFrameInputs& inputs)
+{
+    State& state = *m_state;
+    const AudioBands& bands = inputs.audio.bands;
+    const std::array<float, kReadOnlyCount> frameReadOnly = {
+        inputs.time, inputs.fps, static_cast<float>(inputs.frame), inputs.progress, bands.bass, bands.mid, bands.treb,
+        bands.bassAtt, bands.midAtt, bands.trebAtt, static_cast<float>(state.meshX), static_cast<float>(state.meshY),
+        static_cast<float>(state.width), static_cast<float>(state.height), state.warp.invAspectX, state.warp.invAspectY};
+    for (size_t i = 0; i < kReadOnlyCount; ++i)
+    {
+        *state.frameReadOnly[i] = frameReadOnly[i];
+        state.readOnly[i] = frameReadOnly[i];
+    }
+    // PerPixelContext::LoadStateReadOnlyVariables() passes the aspect itself, not its inverse.
+    state.readOnly[kReadOnlyCount - 2] = state.warp.aspectX;
+    state.readOnly[kReadOnlyCount - 1] = state.warp.aspectY;
+
+    for (const auto& value : state.stateValues)
+    {
+        *value.first = value.second;
+    }
+    for (int i = 0; i < kQVariables; ++i)
+    {
+        *state.frameQ[i] = state.qAfterInit[i];
+    }
+    if (state.frameCode)
+    {
+        projectm_eval_code_execute(state.frameCode);
+    }
+    for (int i = 0; i < kQVariables; ++i)
+    {
+        state.q[i] = *state.frameQ[i];
+    }
+    for (size_t i = 0; i < state.frameTransform.values.size(); ++i)
+    {
+        state.frameTransform.values[i] = state.frameValue(kTransformVariables[i]);
+    }
+}
+
+void ReferenceRenderer::computeMesh(const ReferenceFrameInputs& inputs)
+{
+    State& state = *m_state;
+
+    // PerPixelMesh::WarpedBlit() uniforms
+    WarpUniforms& warp = state.warp;
+    warp.warpTime = inputs.time * state.warpAnimSpeed;
+    warp.warpScaleInverse = 1.0f / state.warpScale;
+    warp.factors = {11.68f + 4.0f * std::cos(warp.warpTime * 1.413f + 10.0f),
+                    8.77f + 3.0f * std::cos(warp.warpTime * 1.113f + 7.0f),
+                    10.54f + 3.0f * std::cos(warp.warpTime * 1.233f + 3.0f),
+                    11.49f + 4.0f * std::cos(warp.warpTime * 0.933f + 5.0f)};
+
+    if (state.hasPixelCode && !state.serialReason.empty())
+    {
+        // Shared state: libprojectM's vertex order on a single context.
+        for (int row = 0; row <= state.meshY; ++row)
+        {
+            state.computeRow(row, 0, false);
+        }
+        return;
+    }
+    m_pool.run(state.meshY + 1, [&state](int row, int worker) { state.computeRow(row, worker, true); });
+}
+
+void ReferenceRenderer::warp(const ReferenceFrameInputs&)
+{
+    State& state = *m_state;
+    float decay = state.frameValue("decay");
+    if (decay < 0.9999f)
+    {
+        decay = std::min(decay, (32.0f - 2.0f) / 32.0f);
+    }
+    const bool wrap = state.frameValue("wrap") != 0.0f;
+    const int width = state.width;
+    const int height = state.height;
+    const int meshX = state.meshX;
+    const int meshY = state.meshY;
+    const float* source = state.previous.data();
+    float* target = state.current.data();
+
+    auto texel = [&](int x, int y) -> const float* {
+        if (wrap)
+        {
+            x = ((x % width) + width) % width;
+            y = ((y % height) + height) % height;
+        }
+        else
+        {
+            x = std::clamp(x, 0, width - 1);
+            y = std::clamp(y, 0, height - 1);
+        }
+        return source + (static_cast<size_t>(y) * width + x) * 3;
+    };
+
+    const int tiles = (height + kTileRows - 1) / kTileRows;
+    m_pool.run(tiles, [&](int tile, int) {
+        const int rowEnd = std::min(height, (tile + 1) * kTileRows);
+        for (int y = tile * kTileRows; y < rowEnd; ++y)
+        {
+            // Texture coordinates between mesh vertices, bilinear across the cell.
+            const float gridY = (static_cast<float>(y) + 0.5f) / static_cast<float>(height) * static_cast<float>(meshY);
+            const int cellY = std::min(static_cast<int>(gridY), meshY - 1);
+            const float fy = gridY - static_cast<float>(cellY);
+            const MeshVertex* below = &state.mesh[static_cast<size_t>(cellY) * (meshX + 1)];
+            const MeshVertex* above = below + meshX + 1;
+            for (int x = 0; x < width; ++x)
+            {
+                const float gridX = (static_cast<float>(x) + 0.5f) / static_cast<float>(width) * static_cast<float>(meshX);
+                const int cellX = std::min(static_cast<int>(gridX), meshX - 1);
+                const float fx = gridX - static_cast<float>(cellX);
+                const float u = (below[cellX].u * (1.0f - fx) + below[cellX + 1].u * fx) * (1.0f - fy) +
+                                (above[cellX].u * (1.0f - fx) + above[cellX + 1].u * fx) * fy;
+                const float v = (below[cellX].v * (1.0f - fx) + below[cellX + 1].v * fx) * (1.0f - fy) +
+                                (above[cellX].v * (1.0f - fx) + above[cellX + 1].v * fx) * fy;
+
+                // GL_LINEAR sampling of the previous frame.
+                const float sampleX = u * static_cast<float>(width) - 0.5f;
+                const float sampleY = v * static_cast<float>(height) - 0.5f;
+                const float floorX = std::floor(sampleX);
+                const float floorY = std::floor(sampleY);
+                const float tx = sampleX - floorX;
+                const float ty = sampleY - floorY;
+                const int x0 = static_cast<int>(floorX);
+                const int y0 = static_cast<int>(floorY);
+                const float* c00 = texel(x0, y0);
+                const float* c10 = texel(x0 + 1, y0);
+                const float* c01 = texel(x0, y0 + 1);
+                const float* c11 = texel(x0 + 1, y0 + 1);
+                float* out = target + (static_cast<size_t>(y) * width + x) * 3;
+                for (int channel = 0; channel < 3; ++channel)
+                {
+                    const float bottom = c00[channel] * (1.0f - tx) + c10[channel] * tx;
+                    const float top = c01[channel] * (1.0f - tx) + c11[channel] * tx;
+                    out[channel] = (bottom * (1.0f - ty) + top * ty) * decay;
+                }
+            }
+        }
+    });
+}
+
+void ReferenceRenderer::drawWave(const ReferenceFrameInputs& inputs)
+{
+    State& state = *m_state;
+    if (!ReferenceWaveform::supported(state.waveMode))
+    {
+        return;
+    }
+
+    WaveInputs wave;
+    wave.mode = state.waveMode;
+    wave.scale = state.waveScale;
+    wave.smoothing = state.waveSmoothing;
+    wave.mystery = state.frameValue("wave_mystery");
+    wave.x = state.frameValue("wave_x");
+    wave.y = state.frameValue("wave_y");
+    wave.time = inputs.time;
+    wave.width = state.width;
+    wave.height = state.height;
+
+    // Waveform::MaximizeColors()
+    const float alpha = ReferenceWaveform::alpha(wave, state.frameValue("wave_a"), inputs.audio.bands,
+                                                 state.modWaveAlphaByVolume, state.modWaveAlphaStart, state.modWaveAlphaEnd);
+    if (alpha <= 0.0f)
+    {
+        return;
+    }
+    std::array<float, 3> color = {state.frameValue("wave_r"), state.frameValue("wave_g"), state.frameValue("wave_b")};
+    if (state.frameValue("wave_brighten") > 0.0f)
+    {
+        const float brightest = std::max(color[0], std::max(color[1], color[2]));
+        if (brightest > 0.01f)
+        {
+            for (auto& channel : color)
+            {
+                channel /= brightest;
+            }
+        }
+    }
+    for (auto& channel : color)
+    {
+        channel = std::clamp(channel, 0.0f, 1.0f);
+    }
+    const bool additive = state.frameValue("wave_additive") != 0.0f;
+    const bool dots = state.frameValue("wave_usedots") != 0.0f;
+    const bool thick = state.frameValue("wave_thick") != 0.0f;
+    const bool loop = ReferenceWaveform::isLoop(state.waveMode);
+
+    // Waveform::Draw(): thick lines and dots are drawn four times, shifted one pixel right,
+    // up and back left in turn.
+    const float width = static_cast<float>(state.width);
+    const float height = static_cast<float>(state.height);
+    const std::array<std::array<float, 2>, 4> shifts = {{{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}}};
+    const int iterations = thick || dots ? 4 : 1;
+    state.segments.clear();
+    for (const auto& line : ReferenceWaveform::vertices(wave, inputs.audio))
+    {
+        if (line.empty())
+        {
+            continue;
+        }
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            auto window = [&](const WaveVertex& vertex) {
+                return std::array<float, 2>{(vertex.x * 0.5f + 0.5f) * width + shifts[iteration][0],
+                                            (vertex.y * 0.5f + 0.5f) * height + shifts[iteration][1]};
+            };
+            if (dots)
+            {
+                for (const auto& vertex : line)
+                {
+                    const auto p = window(vertex);
+                    state.segments.push_back({p[0], p[1], p[0], p[1], true});
+                }
+                continue;
+            }
+            const size_t count = loop ? line.size() : line.size() - 1;
+            for (size_t i = 0; i < count; ++i)
+            {
+                const auto p0 = window(line[i]);
+                const auto p1 = window(line[(i + 1) % line.size()]);
+                state.segments.push_back({p0[0], p0[1], p1[0], p1[1], false});
+            }
+        }
+    }
+
+    float* target = state.current.data();
+    const int pixelsX = state.width;
+    const int pixelsY = state.height;
+    auto blend = [&](int x, int y) {
+        float* out = target + (static_cast<size_t>(y) * pixelsX + x) * 3;
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            const float blended = additive ? out[channel] + color[channel] * alpha
+                                           : out[channel] * (1.0f - alpha) + color[channel] * alpha;
+            out[channel] = std::min(blended, 1.0f);
+        }
+    };
+
+    // Bands of rows draw every segment in order, so overlapping blends stay in draw order.
+    const int tiles = (pixelsY + kTileRows - 1) / kTileRows;
+    m_pool.run(tiles, [&](int tile, int) {
+        const int rowBegin = tile * kTileRows;
+        const int rowEnd = std::min(pixelsY, rowBegin + kTileRows);
+        for (const auto& segment : state.segments)
+        {
+            if (std::max(segment.y0, segment.y1) < static_cast<float>(rowBegin - 1) ||
+                std::min(segment.y0, segment.y1) >= static_cast<float>(rowEnd + 1))
+            {
+                continue;
+            }
+            if (segment.dot)
+            {
+                const int x = static_cast<int>(std::floor(segment.x0));
+                const int y = static_cast<int>(std::floor(segment.y0));
+                if (x >= 0 && x < pixelsX && y >= rowBegin && y < rowEnd)
+                {
+                    blend(x, y);
+                }
+                continue;
+            }
+
+            // 1 px line, stepping through the pixel centres along the major axis from the
+            // first end up to, not including, the second, as GL line strips leave shared
+            // vertices to the next segment.
+            const float dx = segment.x1 - segment.x0;
+            const float dy = segment.y1 - segment.y0;
+            const bool xMajor = std::fabs(dx) >= std::fabs(dy);
+            const float major0 = xMajor ? segment.x0 : segment.y0;
+            const float major1 = xMajor ? segment.x1 : segment.y1;
+            const float minor0 = xMajor ? segment.y0 : segment.x0;
+            const float slope = (major1 != major0) ? (xMajor ? dy / dx : dx / dy) : 0.0f;
+            const int majorLimit = xMajor ? pixelsX : pixelsY;
+            const int step = major1 >= major0 ? 1 : -1;
+            int first = step > 0 ? static_cast<int>(std::ceil(major0 - 0.5f)) : static_cast<int>(std::floor(major0 - 0.5f));
+            int last = step > 0 ? static_cast<int>(std::ceil(major1 - 0.5f)) : static_cast<int>(std::floor(major1 - 0.5f));
+            first = std::clamp(first, -1, majorLimit);
+            last = std::clamp(last, -1, majorLimit);
+            for (int major = first; major != last; major += step)
+            {
+                if (major < 0 || major >= majorLimit)
+                {
+                    continue;
+                }
+                const float minor = minor0 + (static_cast<float>(major) + 0.5f - major0) * slope;
+                const int minorPixel = static_cast<int>(std::floor(minor));
+                const int x = xMajor ? major : minorPixel;
+                const int y = xMajor ? minorPixel : major;
+                if (x >= 0 && x < pixelsX && y >= rowBegin && y < rowEnd)
+                {
+                    blend(x, y);
+                }
+            }
+        }
+    });
+}
+
+const std::vector<float>& ReferenceRenderer::pixels() const
+{
+    return m_state->previous;
+}
+
+const ReferenceFrameTimings& ReferenceRenderer::timings() const
+{
+    return m_state->timings;
+}
+
+bool ReferenceRenderer::hasPixelCode() const
+{
+    return m_state->hasPixelCode;
+}
+
+const std::string& ReferenceRenderer::serialReason() const
+{
+    return m_state->serialReason;
+}
+
+int ReferenceRenderer::waveMode() const
+{
+    return m_state->waveMode;
+}
+
+bool ReferenceRenderer::waveSupported() const
+{
+    return ReferenceWaveform::supported(m_state->waveMode);
+}
+
+bool ReferenceRenderer::fail(const std::string& message)
+{
+    m_error = message;
+    return false;
+}
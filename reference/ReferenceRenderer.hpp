@@ -0,0 +1,102 @@
+#pragma once
+
+#include "ReferenceAudio.hpp"
+#include "WorkerPool.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Values that change from frame to frame.
+ */
+struct ReferenceFrameInputs
+{
+    float time{0.0f};
+    int frame{0};
+    float fps{60.0f};
+    float progress{0.0f};
+    ReferenceAudioFrame audio;
+};
+
+/**
+ * @brief Wall time of each stage of the last renderFrame() call.
+ */
+struct ReferenceFrameTimings
+{
+    double perFrameMillis{0.0}; //!< Per-frame code
+    double meshMillis{0.0};     //!< Per-pixel code and warp texture coordinates on the mesh
+    double warpMillis{0.0};     //!< Warped, decayed copy of the previous frame
+    double waveMillis{0.0};     //!< Built-in waveform
+    double totalMillis{0.0};
+};
+
+/**
+ * @brief CPU renderer for the parts of a preset the converter reproduces in GLSL.
+ *
+ * Each frame follows libprojectM's MilkdropPreset::RenderFrame(): the per-frame code runs
+ * with the preset's state variables and the q values saved after the init code; the
+ * per-pixel code runs on every vertex of the warp mesh; the previous frame is sampled
+ * through the warped texture coordinates (bilinear, wrapped or clamped by wrap) and scaled
+ * by the decay; and the built-in waveform is drawn over it. Borders, echo, gamma, filters,
+ * motion vectors, custom waves and shapes and preset shaders are not drawn.
+ *
+ * Work is split into rows, shared out by a WorkerPool: mesh rows for the per-pixel code and
+ * bands of pixel rows for the warp and the waveform, with every band drawing the wave
+ * segments in order. Each worker has its own eval context sharing the reg00-reg99 values and
+ * gmegabuf of the per-frame code, and resets its user variables at the start of each mesh
+ * row, so the image does not depend on the thread count. Per-pixel code that uses megabuf,
+ * gmegabuf, regNN or rand() depends on the vertex order; it runs on one thread, vertex by
+ * vertex, keeping its variables from one vertex to the next as libprojectM does.
+ *
+ * Frames are float RGB, bottom row first, and stay in [0, 1].
+ */
+class ReferenceRenderer
+{
+public:
+    /// @p threads workers; 0 uses one per hardware thread.
+    explicit ReferenceRenderer(int threads = 0);
+    ~ReferenceRenderer();
+
+    ReferenceRenderer(const ReferenceRenderer&) = delete;
+    ReferenceRenderer& operator=(const ReferenceRenderer&) = delete;
+
+    /// Compiles the preset's code, runs its init code and clears the frame to black.
+    bool load(const std::map<std::string, std::string>& presetValues, int width, int height, int meshX = 48,
+              int meshY = 36);
+
+    void renderFrame(const ReferenceFrameInputs& inputs);
+
+    /// RGB pixels of the last frame, bottom row first.
+    const std::vector<float>& pixels() const;
+
+    const ReferenceFrameTimings& timings() const;
+
+    int threads() const { return m_pool.size(); }
+
+    /// Whether the preset has per-pixel code.
+    bool hasPixelCode() const;
+
+    /// Why the per-pixel code runs on one thread (the shared state it uses); empty otherwise.
+    const std::string& serialReason() const;
+
+    /// nWaveMode wrapped into libprojectM's range, and whether it is drawn.
+    int waveMode() const;
+    bool waveSupported() const;
+
+    const std::string& error() const { return m_error; }
+
+private:
+    struct State;
+
+    bool fail(const std::string& message);
+    void runPerFrame(const ReferenceFrameInputs& inputs);
+    void computeMesh(const ReferenceFrameInputs& inputs);
+    void warp(const ReferenceFrameInputs& inputs);
+    void drawWave(const ReferenceFrameInputs& inputs);
+
+    WorkerPool m_pool;
+    std::unique_ptr<State> m_state;
+    std::string m_error;
+};
@@ -0,0 +1,345 @@
+#include "ReferenceWaveform.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr int kMaxPoints = 512; // WaveformMaxPoints
+
+struct WaveMath
+{
+    std::array<float, kMaxPoints> left{};
+    std::array<float, kMaxPoints> right{};
+    float aspectX{1.0f};
+    float aspectY{1.0f};
+    float mystery{0.0f};
+    float waveX{0.0f};
+    float waveY{0.0f};
+    int samples{0};
+
+    // LineBase::ClipWaveformEdges() results
+    float edgeX{0.0f};
+    float edgeY{0.0f};
+    float distanceX{0.0f};
+    float distanceY{0.0f};
+    float perpetualDX{0.0f};
+    float perpetualDY{0.0f};
+    int sampleOffset{0};
+
+    void clipEdges(float angle);
+};
+
+void WaveMath::clipEdges(float angle)
+{
+    distanceX = std::cos(angle);
+    distanceY = std::sin(angle);
+    std::array<float, 2> edgesX{waveX * std::cos(angle + 1.57f) - distanceX * 3.0f,
+                                waveX * std::cos(angle + 1.57f) + distanceX * 3.0f};
+    std::array<float, 2> edgesY{waveX * std::sin(angle + 1.57f) - distanceY * 3.0f,
+                                waveX * std::sin(angle + 1.57f) + distanceY * 3.0f};
+    for (int i = 0; i < 2; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            float t = 0.0f;
+            bool clip = false;
+            switch (j)
+            {
+                case 0:
+                    clip = edgesX[i] > 1.1f;
+                    t = clip ? (1.1f - edgesX[1 - i]) / (edgesX[i] - edgesX[1 - i]) : 0.0f;
+                    break;
+                case 1:
+                    clip = edgesX[i] < -1.1f;
+                    t = clip ? (-1.1f - edgesX[1 - i]) / (edgesX[i] - edgesX[1 - i]) : 0.0f;
+                    break;
+                case 2:
+                    clip = edgesY[i] > 1.1f;
+                    t = clip ? (1.1f - edgesY[1 - i]) / (edgesY[i] - edgesY[1 - i]) : 0.0f;
+                    break;
+                case 3:
+                    clip = edgesY[i] < -1.1f;
+                    t = clip ? (-1.1f - edgesY[1 - i]) / (edgesY[i] - edgesY[1 - i]) : 0.0f;
+                    break;
+            }
+            if (clip)
+            {
+                const float diffX = edgesX[i] - edgesX[1 - i];
+                const float diffY = edgesY[i] - edgesY[1 - i];
+                edgesX[i] = edgesX[1 - i] + diffX * t;
+                edgesY[i] = edgesY[1 - i] + diffY * t;
+            }
+        }
+    }
+    sampleOffset = (AudioTexturePacker::kWaveformSamples - samples) / 2;
+    distanceX = (edgesX[1] - edgesX[0]) / static_cast<float>(samples);
+    distanceY = (edgesY[1] - edgesY[0]) / static_cast<float>(samples);
+    edgeX = edgesX[0];
+    edgeY = edgesY[0];
+    const float angle2 = std::atan2(distanceY, distanceX);
+    perpetualDX = std::cos(angle2 + 1.57f);
+    perpetualDY = std::sin(angle2 + 1.57f);
+}
+
+// WaveformMath::SmoothWave(): each segment gets a midpoint from a 4-tap filter.
+std::vector<WaveVertex> smoothWave(const std::vector<WaveVertex>& input)
+{
+    constexpr float c1 = -0.15f;
+    constexpr float c2 = 1.15f;
+    constexpr float c3 = 1.15f;
+    constexpr float c4 = -0.15f;
+    constexpr float inverseSum = 1.0f / (c1 + c2 + c3 + c4);
+
+    std::vector<WaveVertex> output;
+    if (input.empty())
+    {
+        return output;
+    }
+    const size_t samples = input.size();
+    output.resize(samples * 2 - 1);
+    size_t outputIndex = 0;
+    size_t indexBelow = 0;
+    size_t indexAbove2 = 1;
+    for (size_t i = 0; i + 1 < samples; ++i)
+    {
+        const size_t indexAbove = indexAbove2;
+        indexAbove2 = std::min(samples - 1, i + 2);
+        output[outputIndex] = input[i];
+        output[outputIndex + 1].x = (c1 * input[indexBelow].x + c2 * input[i].x + c3 * input[indexAbove].x +
+                                     c4 * input[indexAbove2].x) * inverseSum;
+        output[outputIndex + 1].y = (c1 * input[indexBelow].y + c2 * input[i].y + c3 * input[indexAbove].y +
+                                     c4 * input[indexAbove2].y) * inverseSum;
+        indexBelow = i;
+        outputIndex += 2;
+    }
+    output[outputIndex] = input[samples - 1];
+    return output;
+}
+
+} // namespace
+
+bool ReferenceWaveform::supported(int mode)
+{
+    return mode == 0 || (mode >= 2 && mode <= 8);
+}
+
+std::array<std::vector<WaveVertex>, 2> ReferenceWaveform::vertices(const WaveInputs& inputs, const ReferenceAudioFrame& audio)
+{
+    std::array<std::vector<WaveVertex>, 2> lines;
+    if (!supported(inputs.mode))
+    {
+        return lines;
+    }
+
+    WaveMath math;
+    // The texture waveform is libprojectM's PCM / 128, which cancels the 1/128 of the scale.
+    float scale = inputs.scale;
+    if (inputs.mode == 8)
+    {
+        std::copy(audio.spectrumLeft.begin(), audio.spectrumLeft.end(), math.left.begin());
+        std::copy(audio.spectrumRight.begin(), audio.spectrumRight.end(), math.right.begin());
+        scale /= 128.0f;
+    }
+    else
+    {
+        std::copy(audio.waveformLeft.begin(), audio.waveformLeft.end(), math.left.begin());
+        std::copy(audio.waveformRight.begin(), audio.waveformRight.end(), math.right.begin());
+    }
+    math.left[0] *= scale;
+    math.right[0] *= scale;
+    const float mix2 = inputs.smoothing;
+    const float mix1 = scale * (1.0f - mix2);
+    for (size_t i = 1; i < math.left.size(); ++i)
+    {
+        math.left[i] = math.left[i] * mix1 + math.left[i - 1] * mix2;
+        math.right[i] = math.right[i] * mix1 + math.right[i - 1] * mix2;
+    }
+
+    if (inputs.width > inputs.height)
+    {
+        math.aspectY = static_cast<float>(inputs.height) / static_cast<float>(inputs.width);
+    }
+    else
+    {
+        math.aspectX = static_cast<float>(inputs.width) / static_cast<float>(inputs.height);
+    }
+
+    math.mystery = inputs.mystery;
+    const bool normalizedMystery = inputs.mode == 0 || inputs.mode == 4;
+    if (normalizedMystery && (math.mystery < 1.0f || math.mystery > 1.0f))
+    {
+        math.mystery = math.mystery * 0.5f + 0.5f;
+        math.mystery -= std::floor(math.mystery);
+        math.mystery = std::fabs(math.mystery);
+        math.mystery = math.mystery * 2.0f - 1.0f;
+    }
+    math.waveX = 2.0f * inputs.x - 1.0f;
+    math.waveY = 2.0f * inputs.y - 1.0f;
+
+    constexpr int waveformSamples = AudioTexturePacker::kWaveformSamples;
+    std::vector<WaveVertex> wave1;
+    std::vector<WaveVertex> wave2;
+    const auto& left = math.left;
+    const auto& right = math.right;
+    switch (inputs.mode)
+    {
+        case 0: // Circle
+        {
+            math.samples = waveformSamples / 2;
+            wave1.resize(math.samples);
+            const int sampleOffset = (waveformSamples - math.samples) / 2;
+            const float inverseSamples = 1.0f / static_cast<float>(math.samples);
+            for (int i = 0; i < math.samples; ++i)
+            {
+                float radius = 0.5f + 0.4f * right[i + sampleOffset] + math.mystery;
+                const float angle = static_cast<float>(i) * inverseSamples * 6.28f + inputs.time * 0.2f;
+                if (i < math.samples / 10)
+                {
+                    float mix = static_cast<float>(i) / (static_cast<float>(math.samples) * 0.1f);
+                    mix = 0.5f - 0.5f * std::cos(mix * 3.1416f);
+                    const float radius2 = 0.5f + 0.4f * right[i + math.samples + sampleOffset] + math.mystery;
+                    radius = radius2 * (1.0f - mix) + radius * mix;
+                }
+                wave1[i].x = radius * std::cos(angle) * math.aspectY + math.waveX;
+                wave1[i].y = radius * std::sin(angle) * math.aspectX + math.waveY;
+            }
+            break;
+        }
+        case 2: // CenteredSpiro
+        case 3: // CenteredSpiro, volume alpha
+            math.samples = waveformSamples;
+            wave1.resize(math.samples);
+            for (int i = 0; i < math.samples; ++i)
+            {
+                wave1[i].x = right[i] * math.aspectY + math.waveX;
+                wave1[i].y = left[i + 32] * math.aspectX + math.waveY;
+            }
+            break;
+        case 4: // DerivativeLine
+        {
+            math.samples = waveformSamples;
+            if (math.samples > inputs.width / 3)
+            {
+                math.samples /= 3;
+            }
+            wave1.resize(math.samples);
+            const int sampleOffset = (waveformSamples - math.samples) / 2;
+            const float w1 = 0.45f + 0.5f * (math.mystery * 0.5f + 0.5f);
+            const float w2 = 1.0f - w1;
+            const float inverseSamples = 1.0f / static_cast<float>(math.samples);
+            for (int i = 0; i < math.samples; ++i)
+            {
+                wave1[i].x = -1.0f + 2.0f * (static_cast<float>(i) * inverseSamples) + math.waveX;
+                wave1[i].y = left[i + sampleOffset] * 0.47f + math.waveY;
+                wave1[i].x += right[i + 25 + sampleOffset] * 0.44f;
+                // Momentum
+                if (i > 1)
+                {
+                    wave1[i].x = wave1[i].x * w2 + w1 * (wave1[i - 1].x * 2.0f - wave1[i - 2].x);
+                    wave1[i].y = wave1[i].y * w2 + w1 * (wave1[i - 1].y * 2.0f - wave1[i - 2].y);
+                }
+            }
+            break;
+        }
+        case 5: // ExplosiveHash
+        {
+            math.samples = waveformSamples;
+            wave1.resize(math.samples);
+            const float cosineRotation = std::cos(inputs.time * 0.3f);
+            const float sineRotation = std::sin(inputs.time * 0.3f);
+            for (int i = 0; i < math.samples; ++i)
+            {
+                const float x0 = right[i] * left[i + 32] + left[i] * right[i + 32];
+                const float y0 = right[i] * right[i] - left[i + 32] * left[i + 32];
+                wave1[i].x = (x0 * cosineRotation - y0 * sineRotation) * math.aspectY + math.waveX;
+                wave1[i].y = (x0 * sineRotation + y0 * cosineRotation) * math.aspectX + math.waveY;
+            }
+            break;
+        }
+        case 6: // Line
+        case 7: // DoubleLine
+        {
+            math.samples = waveformSamples / 2;
+            if (math.samples > inputs.width / 3)
+            {
+                math.samples /= 3;
+            }
+            wave1.resize(math.samples);
+            if (inputs.mode == 6)
+            {
+                math.clipEdges(1.57f + math.mystery);
+                for (int i = 0; i < math.samples; ++i)
+                {
+                    const float offset = 0.25f * left[i + math.sampleOffset];
+                    wave1[i].x = math.edgeX + math.distanceX * static_cast<float>(i) + math.perpetualDX * offset;
+                    wave1[i].y = math.edgeY + math.distanceY * static_cast<float>(i) + math.perpetualDY * offset;
+                }
+                break;
+            }
+            wave2.resize(math.samples);
+            math.clipEdges(1.57f * math.mystery);
+            const float separation = std::pow(math.waveY * 0.5f + 0.5f, 2.0f);
+            for (int i = 0; i < math.samples; ++i)
+            {
+                const float x = math.edgeX + math.distanceX * static_cast<float>(i);
+                const float y = math.edgeY + math.distanceY * static_cast<float>(i);
+                const float offset1 = 0.25f * left[i + math.sampleOffset] + separation;
+                const float offset2 = 0.25f * right[i + math.sampleOffset] - separation;
+                wave1[i] = {x + math.perpetualDX * offset1, y + math.perpetualDY * offset1};
+                wave2[i] = {x + math.perpetualDX * offset2, y + math.perpetualDY * offset2};
+            }
+            break;
+        }
+        case 8: // SpectrumLine
+            math.samples = 256;
+            wave1.resize(math.samples);
+            math.clipEdges(1.57f * math.mystery);
+            for (int i = 0; i < math.samples; ++i)
+            {
+                const float f = 0.1f * std::log(left[i * 2] + left[i * 2 + 1]);
+                wave1[i].x = math.edgeX + math.distanceX * static_cast<float>(i) + math.perpetualDX * f;
+                wave1[i].y = math.edgeY + math.distanceY * static_cast<float>(i) + math.perpetualDY * f;
+            }
+            break;
+    }
+
+    lines[0] = smoothWave(wave1);
+    lines[1] = smoothWave(wave2);
+    return lines;
+}
+
+float ReferenceWaveform::alpha(const WaveInputs& inputs, float waveAlpha, const AudioBands& bands, bool modulateByVolume,
+                               float modulateStart, float modulateEnd)
+{
+    const int texsize = std::max(inputs.width, inputs.height);
+    float alpha = waveAlpha;
+    if (inputs.mode == 2 || inputs.mode == 5)
+    {
+        alpha *= texsize <= 256 ? 0.07f : texsize <= 512 ? 0.09f : texsize <= 1024 ? 0.11f : texsize <= 2048 ? 0.13f : 0.15f;
+    }
+    else if (inputs.mode == 3)
+    {
+        alpha *= texsize <= 256 ? 0.075f : texsize <= 512 ? 0.15f : texsize <= 1024 ? 0.22f : texsize <= 2048 ? 0.33f : 0.44f;
+        alpha *= 1.3f;
+        alpha *= std::pow(bands.treb, 2.0f);
+    }
+
+    // Waveform::ModulateOpacityByVolume() starts again from wave_a.
+    if (modulateByVolume)
+    {
+        if (bands.vol <= modulateStart)
+        {
+            alpha = 0.0f;
+        }
+        else if (bands.vol < modulateEnd)
+        {
+            alpha = waveAlpha * ((bands.vol - modulateStart) / (modulateEnd - modulateStart));
+        }
+        else
+        {
+            alpha = waveAlpha;
+        }
+    }
+    return std::clamp(alpha, 0.0f, 1.0f);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "ReferenceAudio.hpp"
+
+#include <array>
+#include <vector>
+
+/// A wave vertex in clip space, y up.
+struct WaveVertex
+{
+    float x{0.0f};
+    float y{0.0f};
+};
+
+/**
+ * @brief Per-frame values the built-in waveform is generated from.
+ */
+struct WaveInputs
+{
+    int mode{0};            //!< nWaveMode, already wrapped into [0, kModeCount)
+    float scale{1.0f};      //!< fWaveScale
+    float smoothing{0.75f}; //!< fWaveSmoothing
+    float mystery{0.0f};    //!< wave_mystery after the per-frame code
+    float x{0.5f};          //!< wave_x after the per-frame code
+    float y{0.5f};          //!< wave_y after the per-frame code
+    float time{0.0f};
+    int width{0};
+    int height{0};
+};
+
+/**
+ * @brief CPU port of libprojectM's built-in waveform vertex generation (Waveforms::*).
+ *
+ * Covers the modes the converter draws: 0 (Circle), 2 (CenteredSpiro), 3 (CenteredSpiro with
+ * volume alpha), 4 (DerivativeLine), 5 (ExplosiveHash), 6 (Line), 7 (DoubleLine) and
+ * 8 (SpectrumLine). Samples are scaled and IIR-smoothed as in WaveformMath::GetVertices(),
+ * and every line is run through the 4-tap SmoothWave() filter.
+ */
+class ReferenceWaveform
+{
+public:
+    static constexpr int kModeCount = 16; //!< WaveformMode::Count; nWaveMode wraps at this value
+
+    static bool supported(int mode);
+
+    /// Circle is drawn as a closed loop, the other modes as open strips.
+    static bool isLoop(int mode) { return mode == 0; }
+
+    /// Smoothed vertices of the one or two lines of the wave (the second is empty except
+    /// for DoubleLine).
+    static std::array<std::vector<WaveVertex>, 2> vertices(const WaveInputs& inputs, const ReferenceAudioFrame& audio);
+
+    /// Waveform::MaximizeColors() alpha: the mode's texture-size factors, the volume fade when
+    /// @p modulateByVolume, clamped to [0, 1].
+    static float alpha(const WaveInputs& inputs, float waveAlpha, const AudioBands& bands, bool modulateByVolume,
+                       float modulateStart, float modulateEnd);
+};
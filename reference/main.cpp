@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ImageWriter.hpp"
+#include "PresetFileParser.hpp"
+#include "ReferenceAudio.hpp"
+#include "ReferenceRenderer.hpp"
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <preset.milk> [output.png|output.ppm]\n\n"
+              << "Renders a preset on the CPU: per-frame and per-pixel code, warp, decay and the built-in\n"
+              << "waveform. An output name containing %d (printf style) gets every frame, numbered from 0;\n"
+              << "otherwise only the last frame is written.\n\n"
+              << "Options:\n"
+              << "  --size <WxH>                      Output size (default 512x512)\n"
+              << "  --mesh <WxH>                      Per-pixel mesh size (default 48x36)\n"
+              << "  --frames <n>                      Frames to render (default 1)\n"
+              << "  --time <seconds>                  Time of the first frame (default 0); advances by 1/fps\n"
+              << "  --fps <n>                         Frame rate (default 60)\n"
+              << "  --threads <n>                     Worker threads; 0 uses every core (default 0)\n"
+              << "  --audio <bass> <mid> <treb> <vol> Constant audio levels (default 1 each)\n"
+              << "  --audio-schedule <file>           Lines of \"time bass mid treb vol\", interpolated linearly\n"
+              << "  --audio-track <file.mdaf>         Replay a MilkdropAudioFeatures track\n"
+              << "  --timings <file.csv>              Write per-frame stage timings in milliseconds\n";
+}
+
+bool parseSize(const std::string& text, int& width, int& height) {
+    return std::sscanf(text.c_str(), "%dx%d", &width, &height) == 2 && width > 0 && height > 0;
+}
+
+std::string framePath(const std::string& pattern, int frame) {
+    const size_t at = pattern.find("%d");
+    if (at == std::string::npos) {
+        return pattern;
+    }
+    return pattern.substr(0, at) + std::to_string(frame) + pattern.substr(at + 2);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int width = 512;
+    int height = 512;
+    int meshX = 48;
+    int meshY = 36;
+    int frames = 1;
+    int threads = 0;
+    float time = 0.0f;
+    float fps = 60.0f;
+    AudioBands constantBands;
+    std::string schedulePath;
+    std::string trackPath;
+    std::string timingsPath;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) {
+            if (!parseSize(argv[++i], width, height)) {
+                std::cerr << "Error: Invalid --size value: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--mesh" && i + 1 < argc) {
+            if (!parseSize(argv[++i], meshX, meshY)) {
+                std::cerr << "Error: Invalid --mesh value: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--time" && i + 1 < argc) {
+            time = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--fps" && i + 1 < argc) {
+            fps = std::strtof(argv[++i], nullptr);
+            if (!(fps > 0.0f)) {
+                std::cerr << "Error: --fps must be positive\n";
+                return 1;
+            }
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--audio" && i + 4 < argc) {
+            float levels[4];
+            for (float& level : levels) {
+                level = std::strtof(argv[++i], nullptr);
+            }
+            constantBands.bass = constantBands.bassAtt = levels[0];
+            constantBands.mid = constantBands.midAtt = levels[1];
+            constantBands.treb = constantBands.trebAtt = levels[2];
+            constantBands.vol = constantBands.volAtt = levels[3];
+        } else if (arg == "--audio-schedule" && i + 1 < argc) {
+            schedulePath = argv[++i];
+        } else if (arg == "--audio-track" && i + 1 < argc) {
+            trackPath = argv[++i];
+        } else if (arg == "--timings" && i + 1 < argc) {
+            timingsPath = argv[++i];
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Error: Unknown or incomplete option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.empty() || positional.size() > 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!schedulePath.empty() && !trackPath.empty()) {
+        std::cerr << "Error: --audio-schedule and --audio-track are mutually exclusive\n";
+        return 1;
+    }
+    const std::string output = positional.size() == 2 ? positional[1] : std::string();
+    if (!output.empty() && !ImageWriter::supported(output)) {
+        std::cerr << "Error: Output must be a .png or .ppm file: " << output << "\n";
+        return 1;
+    }
+
+    libprojectM::PresetFileParser parser;
+    if (!parser.Read(positional[0])) {
+        std::cerr << "Error: Could not read preset " << positional[0] << "\n";
+        return 1;
+    }
+
+    AudioSchedule audio;
+    audio.setConstant(constantBands);
+    if ((!schedulePath.empty() && !audio.openSchedule(schedulePath)) || (!trackPath.empty() && !audio.openTrack(trackPath))) {
+        std::cerr << "Error: " << audio.error() << "\n";
+        return 1;
+    }
+
+    ReferenceRenderer renderer(threads);
+    if (!renderer.load(parser.PresetValues(), width, height, meshX, meshY)) {
+        std::cerr << "Error: " << renderer.error() << "\n";
+        return 1;
+    }
+    if (!renderer.waveSupported()) {
+        std::cerr << "Warning: wave mode " << renderer.waveMode() << " is not drawn by the reference renderer\n";
+    }
+
+    std::ofstream timings;
+    if (!timingsPath.empty()) {
+        timings.open(timingsPath);
+        if (!timings) {
+            std::cerr << "Error: Could not open " << timingsPath << " for writing\n";
+            return 1;
+        }
+        timings << "frame,time,per_frame_ms,mesh_ms,warp_ms,wave_ms,total_ms\n";
+    }
+
+    ImageWriter writer;
+    ReferenceFrameInputs inputs;
+    inputs.fps = fps;
+    const bool everyFrame = output.find("%d") != std::string::npos;
+    double totalMillis = 0.0;
+    for (int frame = 0; frame < frames; ++frame) {
+        inputs.time = time + static_cast<float>(frame) / fps;
+        inputs.frame = frame;
+        inputs.progress = frames > 1 ? static_cast<float>(frame) / static_cast<float>(frames - 1) : 0.0f;
+        if (!audio.frameAt(inputs.time, inputs.audio)) {
+            std::cerr << "Error: " << audio.error() << "\n";
+            return 1;
+        }
+        renderer.renderFrame(inputs);
+
+        const ReferenceFrameTimings& stages = renderer.timings();
+        totalMillis += stages.totalMillis;
+        if (timings.is_open()) {
+            timings << frame << "," << inputs.time << "," << stages.perFrameMillis << "," << stages.meshMillis << ","
+                    << stages.warpMillis << "," << stages.waveMillis << "," << stages.totalMillis << "\n";
+        }
+        if (!output.empty() && (everyFrame || frame == frames - 1) &&
+            !writer.write(framePath(output, frame), renderer.pixels(), width, height)) {
+            std::cerr << "Error: " << writer.error() << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "threads: " << renderer.threads() << "\n";
+    if (!renderer.hasPixelCode()) {
+        std::cout << "per_pixel: none\n";
+    } else if (!renderer.serialReason().empty()) {
+        std::cout << "per_pixel: serial (uses " << renderer.serialReason() << ")\n";
+    } else {
+        std::cout << "per_pixel: parallel\n";
+    }
+    std::cout << "frame_ms: " << totalMillis / frames << "\n";
+    return 0;
+}
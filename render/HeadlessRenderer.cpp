@@ -0,0 +1,370 @@
+#include "HeadlessRenderer.hpp"
+
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Layout written by AudioTexturePacker.
+constexpr int kAudioTextureWidth = 512;
+constexpr int kAudioTextureHeight = 2;
+
+// Full-screen triangle from gl_VertexID; no vertex buffers needed.
+const char* kVertexShader = R"___(#version 330 core
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)___";
+
+struct Target
+{
+    GLuint texture{0};
+    GLuint framebuffer{0};
+    int width{0};
+    int height{0};
+};
+
+struct Program
+{
+    GLuint id{0};
+    std::string sampler;
+    Target target;
+};
+
+Target createTarget(int width, int height)
+{
+    Target target;
+    target.width = width;
+    target.height = height;
+    glGenTextures(1, &target.texture);
+    glBindTexture(GL_TEXTURE_2D, target.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+    const float black[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glClearBufferfv(GL_COLOR, 0, black);
+    return target;
+}
+
+void destroyTarget(Target& target)
+{
+    glDeleteFramebuffers(1, &target.framebuffer);
+    glDeleteTextures(1, &target.texture);
+    target = Target{};
+}
+
+} // namespace
+
+struct HeadlessRenderer::State
+{
+    EGLDisplay display{EGL_NO_DISPLAY};
+    EGLContext context{EGL_NO_CONTEXT};
+    GLuint vertexShader{0};
+    GLuint vertexArray{0};
+    GLuint black{0};
+    GLuint audio{0};
+    std::vector<Program> passes;
+    Program main;
+    Program composite; //!< Optional; id 0 when the main frame is displayed as is.
+    Target feedback;   //!< Previous main frame, swapped with main.target after each frame.
+};
+
+HeadlessRenderer::HeadlessRenderer()
+    : m_state(std::make_unique<State>())
+{
+}
+
+HeadlessRenderer::~HeadlessRenderer()
+{
+    if (m_state->context != EGL_NO_CONTEXT)
+    {
+        for (auto& pass : m_state->passes)
+        {
+            glDeleteProgram(pass.id);
+            destroyTarget(pass.target);
+        }
+        glDeleteProgram(m_state->main.id);
+        destroyTarget(m_state->main.target);
+        if (m_state->composite.id)
+        {
+            glDeleteProgram(m_state->composite.id);
+            destroyTarget(m_state->composite.target);
+        }
+        destroyTarget(m_state->feedback);
+        glDeleteTextures(1, &m_state->audio);
+        eglMakeCurrent(m_state->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(m_state->display, m_state->context);
+    }
+    if (m_state->display != EGL_NO_DISPLAY)
+    {
+        eglTerminate(m_state->display);
+    }
+}
+
+bool HeadlessRenderer::fail(const std::string& message)
+{
+    m_error = message;
+    return false;
+}
+
+bool HeadlessRenderer::initialize()
+{
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (!getPlatformDisplay)
+    {
+        return fail("eglGetPlatformDisplayEXT is not available");
+    }
+    m_state->display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    EGLint major = 0;
+    EGLint minor = 0;
+    if (m_state->display == EGL_NO_DISPLAY || !eglInitialize(m_state->display, &major, &minor))
+    {
+        return fail("Could not initialize a surfaceless EGL display");
+    }
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        return fail("EGL display does not support desktop OpenGL");
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    m_state->context = eglCreateContext(m_state->display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+    if (m_state->context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(m_state->display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_state->context))
+    {
+        return fail("Could not create an OpenGL 3.3 core context");
+    }
+    m_rendererName = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+
+    m_state->vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(m_state->vertexShader, 1, &kVertexShader, nullptr);
+    glCompileShader(m_state->vertexShader);
+    glGenVertexArrays(1, &m_state->vertexArray);
+    glBindVertexArray(m_state->vertexArray);
+
+    const float black[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glGenTextures(1, &m_state->black);
+    glBindTexture(GL_TEXTURE_2D, m_state->black);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 1, 1, 0, GL_RGBA, GL_FLOAT, black);
+
+    // Shaders address texel centres, so nearest filtering reads exactly the packed values.
+    const std::vector<float> silence(kAudioTextureWidth * kAudioTextureHeight * 4, 0.0f);
+    glGenTextures(1, &m_state->audio);
+    glBindTexture(GL_TEXTURE_2D, m_state->audio);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, kAudioTextureWidth, kAudioTextureHeight, 0, GL_RGBA, GL_FLOAT,
+                 silence.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return true;
+}
+
+namespace {
+
+GLuint linkProgram(GLuint vertexShader, const std::string& source, std::string& log)
+{
+    GLuint fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    const char* text = source.c_str();
+    glShaderSource(fragment, 1, &text, nullptr);
+    glCompileShader(fragment);
+
+    GLint ok = GL_FALSE;
+    glGetShaderiv(fragment, GL_COMPILE_STATUS, &ok);
+    if (!ok)
+    {
+        char buffer[8192];
+        glGetShaderInfoLog(fragment, sizeof(buffer), nullptr, buffer);
+        log = buffer;
+        glDeleteShader(fragment);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
+    glDeleteShader(fragment);
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok)
+    {
+        char buffer[8192];
+        glGetProgramInfoLog(program, sizeof(buffer), nullptr, buffer);
+        log = buffer;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+} // namespace
+
+bool HeadlessRenderer::load(const std::string& mainShader, const std::vector<RenderPass>& passes, int width, int height,
+                            const std::string& compositeShader)
+{
+    if (m_state->context == EGL_NO_CONTEXT)
+    {
+        return fail("load() called before initialize()");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::string log;
+    for (const auto& pass : passes)
+    {
+        Program program;
+        program.sampler = pass.sampler;
+        program.id = linkProgram(m_state->vertexShader, pass.glsl, log);
+        if (!program.id)
+        {
+            return fail("Pass " + pass.sampler + " failed to compile:\n" + log);
+        }
+        int passWidth = pass.width;
+        int passHeight = pass.height;
+        if (pass.resolutionDivisor > 0)
+        {
+            passWidth = (width + pass.resolutionDivisor - 1) / pass.resolutionDivisor;
+            passHeight = (height + pass.resolutionDivisor - 1) / pass.resolutionDivisor;
+        }
+        program.target = createTarget(passWidth, passHeight);
+        m_state->passes.push_back(program);
+    }
+
+    m_state->main.id = linkProgram(m_state->vertexShader, mainShader, log);
+    if (!m_state->main.id)
+    {
+        return fail("Main shader failed to compile:\n" + log);
+    }
+    m_state->main.target = createTarget(width, height);
+    m_state->feedback = createTarget(width, height);
+    if (!compositeShader.empty())
+    {
+        m_state->composite.id = linkProgram(m_state->vertexShader, compositeShader, log);
+        if (!m_state->composite.id)
+        {
+            return fail("Composite shader failed to compile:\n" + log);
+        }
+        m_state->composite.target = createTarget(width, height);
+    }
+    glFinish();
+    m_compileMillis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+void HeadlessRenderer::renderFrame(const FrameInputs& inputs)
+{
+    if (inputs.audioTexture)
+    {
+        glBindTexture(GL_TEXTURE_2D, m_state->audio);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, kAudioTextureWidth, kAudioTextureHeight, GL_RGBA, GL_FLOAT,
+                        inputs.audioTexture);
+    }
+
+    const auto& output = m_state->main.target;
+    auto draw = [&](const Program& program) {
+        glUseProgram(program.id);
+        glBindFramebuffer(GL_FRAMEBUFFER, program.target.framebuffer);
+        glViewport(0, 0, program.target.width, program.target.height);
+
+        auto location = [&](const char* name) { return glGetUniformLocation(program.id, name); };
+        glUniform1f(location("iTime"), inputs.time);
+        glUniform2f(location("iResolution"), static_cast<float>(output.width), static_cast<float>(output.height));
+        glUniform1f(location("iFps"), inputs.fps);
+        glUniform1f(location("iFrame"), inputs.frame);
+        glUniform1f(location("iProgress"), inputs.progress);
+        glUniform4fv(location("iAudioBands"), 1, inputs.audioBands);
+        glUniform4fv(location("iAudioBandsAtt"), 1, inputs.audioBandsAtt);
+
+        GLint unit = 0;
+        for (const char* channel : {"iChannel0", "iChannel1", "iChannel2", "iChannel3"})
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, unit == 0 ? m_state->feedback.texture : m_state->black);
+            glUniform1i(location(channel), unit);
+            ++unit;
+        }
+        // Passes after this one still hold the previous frame's output.
+        for (const auto& pass : m_state->passes)
+        {
+            GLint sampler = location(pass.sampler.c_str());
+            if (&pass == &program || sampler < 0)
+            {
+                continue;
+            }
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, pass.target.texture);
+            glUniform1i(sampler, unit);
+            ++unit;
+        }
+        GLint audio = location("iAudioTexture");
+        if (audio >= 0)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, m_state->audio);
+            glUniform1i(audio, unit);
+            ++unit;
+        }
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    };
+
+    for (const auto& pass : m_state->passes)
+    {
+        draw(pass);
+    }
+    draw(m_state->main);
+    std::swap(m_state->main.target, m_state->feedback);
+    if (m_state->composite.id)
+    {
+        draw(m_state->composite);
+    }
+}
+
+void HeadlessRenderer::finish() const
+{
+    glFinish();
+}
+
+std::vector<float> HeadlessRenderer::readPixels() const
+{
+    // renderFrame() already swapped, so the last main frame lives in the feedback target.
+    const auto& target = m_state->composite.id ? m_state->composite.target : m_state->feedback;
+    std::vector<float> pixels(static_cast<size_t>(target.width) * target.height * 4);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glReadPixels(0, 0, target.width, target.height, GL_RGBA, GL_FLOAT, pixels.data());
+    return pixels;
+}
+
+std::vector<float> HeadlessRenderer::readPass(const std::string& sampler, int& width, int& height) const
+{
+    for (const auto& pass : m_state->passes)
+    {
+        if (pass.sampler != sampler)
+        {
+            continue;
+        }
+        width = pass.target.width;
+        height = pass.target.height;
+        std::vector<float> pixels(static_cast<size_t>(width) * height * 4);
+        glBindFramebuffer(GL_FRAMEBUFFER, pass.target.framebuffer);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, pixels.data());
+        return pixels;
+    }
+    width = height = 0;
+    return {};
+}
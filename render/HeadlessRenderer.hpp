@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief An auxiliary pass rendered before the main shader, bound to @c sampler.
+ *
+ * Mirrors ShaderPass: either a fixed @c width x @c height target or, when
+ * @c resolutionDivisor is positive, the output size divided on each axis.
+ */
+struct RenderPass
+{
+    std::string sampler;
+    std::string glsl;
+    int width{0};
+    int height{0};
+    int resolutionDivisor{0};
+};
+
+/**
+ * @brief Uniform values fed to every pass for one frame.
+ */
+struct FrameInputs
+{
+    float time{1.0f};
+    float frame{60.0f};
+    float fps{60.0f};
+    float progress{0.5f};
+    float audioBands[4]{0.5f, 0.3f, 0.7f, 0.4f};    //!< bass, mid, treb, vol
+    float audioBandsAtt[4]{0.5f, 0.3f, 0.7f, 0.4f};
+    const float* audioTexture{nullptr}; //!< 512x2 RGBA iAudioTexture texels, or null to keep the last upload
+};
+
+/**
+ * @brief Off-screen renderer for converted shaders on an EGL surfaceless context.
+ *
+ * Every target is RGBA32F with linear filtering. iChannel0 carries the previous
+ * frame of the main shader (black on the first frame); iChannel1-3 are black.
+ * iAudioTexture (see AudioTexturePacker) is bound for shaders that declare it and
+ * stays zero until FrameInputs::audioTexture supplies texels.
+ * All passes see the main output size as iResolution. Each program may sample any pass
+ * but itself: earlier passes hold this frame's output, later ones the previous frame's,
+ * as libprojectM's warp shader reads the blur textures of the frame before. An optional composite shader
+ * runs after the main shader and reads the frame just rendered as iChannel0; its
+ * output is displayed (readPixels()) but not fed back. Works on Mesa's llvmpipe,
+ * so it runs on machines without a GPU.
+ */
+class HeadlessRenderer
+{
+public:
+    HeadlessRenderer();
+    ~HeadlessRenderer();
+
+    HeadlessRenderer(const HeadlessRenderer&) = delete;
+    HeadlessRenderer& operator=(const HeadlessRenderer&) = delete;
+
+    /// Creates the EGL display and an OpenGL 3.3 core context.
+    bool initialize();
+
+    /// Compiles the main shader, its passes and the composite shader (when not empty) and
+    /// allocates the render targets.
+    bool load(const std::string& mainShader, const std::vector<RenderPass>& passes, int width, int height,
+              const std::string& compositeShader = std::string());
+
+    /// Renders every pass, then the main shader, swaps the feedback targets and runs the composite shader.
+    void renderFrame(const FrameInputs& inputs);
+
+    /// Blocks until the GPU is idle; use before reading timers.
+    void finish() const;
+
+    /// RGBA pixels of the last displayed frame (composite output, or the main frame without one), bottom row first.
+    std::vector<float> readPixels() const;
+
+    /// RGBA pixels of the pass bound to @p sampler, bottom row first; empty when no pass has that sampler.
+    std::vector<float> readPass(const std::string& sampler, int& width, int& height) const;
+
+    /// Wall time spent compiling and linking in the last load() call.
+    double compileMillis() const { return m_compileMillis; }
+
+    const std::string& renderer() const { return m_rendererName; }
+    const std::string& error() const { return m_error; }
+
+private:
+    struct State;
+
+    bool fail(const std::string& message);
+
+    std::unique_ptr<State> m_state;
+    std::string m_rendererName;
+    std::string m_error;
+    double m_compileMillis{0.0};
+};
@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AudioTexturePacker.hpp"
+#include "FeatureTrack.hpp"
+#include "HeadlessRenderer.hpp"
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <main.frag> [output.pfm]\n\n"
+              << "Options:\n"
+              << "  --size <WxH>                      Output size (default 512x512)\n"
+              << "  --frames <n>                      Frames to render; iChannel0 feeds back the previous frame\n"
+              << "  --time <seconds>                  iTime of the first frame (advances by 1/iFps per frame)\n"
+              << "  --audio <bass> <mid> <treb> <vol> iAudioBands and iAudioBandsAtt\n"
+              << "  --audio-signal                    Analyse a synthetic stereo signal into iAudioTexture each frame;\n"
+              << "                                    iAudioBands and iAudioBandsAtt follow its beat detection\n"
+              << "  --audio-track <file.mdaf>         Replay a MilkdropAudioFeatures track: the record at iTime sets\n"
+              << "                                    iAudioBands, iAudioBandsAtt and iAudioTexture\n"
+              << "  --pass <sampler> <file> <WxH|/N>  Prepass rendered before the main shader, in order;\n"
+              << "                                    /N is the output size divided by N on each axis\n"
+              << "  --composite <file>                Composite shader rendered after the main shader; it reads\n"
+              << "                                    the new frame as iChannel0 and its output is written\n"
+              << "  --dump-pass <sampler> <file.pfm>  Also write the last frame of the pass bound to <sampler>\n";
+}
+
+bool readFile(const std::string& path, std::string& contents) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error: Could not read " << path << "\n";
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+bool parseSize(const std::string& text, int& width, int& height) {
+    return std::sscanf(text.c_str(), "%dx%d", &width, &height) == 2 && width > 0 && height > 0;
+}
+
+// Portable float map: RGB, little-endian (negative scale), bottom row first like glReadPixels.
+bool writePfm(const std::string& path, const std::vector<float>& rgba, int width, int height) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Error: Could not open output file for writing: " << path << "\n";
+        return false;
+    }
+    out << "PF\n" << width << " " << height << "\n-1.0\n";
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+        out.write(reinterpret_cast<const char*>(&rgba[i]), 3 * sizeof(float));
+    }
+    return static_cast<bool>(out);
+}
+
+// Deterministic 44.1 kHz stereo for --audio-signal: a pulsing bass line under different
+// mid tones per channel, so waveform, spectrum and both channels all carry signal.
+class TestSignal {
+public:
+    static constexpr int kSampleRate = 44100;
+
+    void next(size_t frames, std::vector<float>& samples) {
+        const double pi = 3.141592653589793;
+        samples.resize(frames * 2);
+        for (size_t i = 0; i < frames; ++i, ++m_sample) {
+            const double t = static_cast<double>(m_sample) / kSampleRate;
+            const double bass = 0.5 * std::sin(2.0 * pi * 80.0 * t) * (0.6 + 0.4 * std::sin(2.0 * pi * 2.0 * t));
+            samples[i * 2] = static_cast<float>(bass + 0.25 * std::sin(2.0 * pi * 660.0 * t));
+            samples[i * 2 + 1] = static_cast<float>(bass + 0.25 * std::sin(2.0 * pi * 440.0 * t));
+        }
+    }
+
+private:
+    size_t m_sample{0};
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int width = 512;
+    int height = 512;
+    int frames = 1;
+    FrameInputs inputs;
+    bool audioSignal = false;
+    std::string audioTrack;
+    std::vector<RenderPass> passes;
+    std::string compositeShader;
+    std::vector<std::pair<std::string, std::string>> passDumps;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) {
+            if (!parseSize(argv[++i], width, height)) {
+                std::cerr << "Error: Invalid --size value: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--time" && i + 1 < argc) {
+            inputs.time = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--audio" && i + 4 < argc) {
+            for (int band = 0; band < 4; ++band) {
+                inputs.audioBands[band] = inputs.audioBandsAtt[band] = std::strtof(argv[++i], nullptr);
+            }
+        } else if (arg == "--audio-signal") {
+            audioSignal = true;
+        } else if (arg == "--audio-track" && i + 1 < argc) {
+            audioTrack = argv[++i];
+        } else if (arg == "--pass" && i + 3 < argc) {
+            RenderPass pass;
+            pass.sampler = argv[++i];
+            if (!readFile(argv[++i], pass.glsl)) {
+                return 1;
+            }
+            std::string size = argv[++i];
+            bool valid = size.size() > 1 && size[0] == '/'
+                ? (pass.resolutionDivisor = std::atoi(size.c_str() + 1)) > 0
+                : parseSize(size, pass.width, pass.height);
+            if (!valid) {
+                std::cerr << "Error: Invalid pass size: " << size << "\n";
+                return 1;
+            }
+            passes.push_back(std::move(pass));
+        } else if (arg == "--composite" && i + 1 < argc) {
+            if (!readFile(argv[++i], compositeShader)) {
+                return 1;
+            }
+        } else if (arg == "--dump-pass" && i + 2 < argc) {
+            passDumps.emplace_back(argv[i + 1], argv[i + 2]);
+            i += 2;
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Error: Unknown or incomplete option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.empty() || positional.size() > 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (audioSignal && !audioTrack.empty()) {
+        std::cerr << "Error: --audio-signal and --audio-track are mutually exclusive\n";
+        return 1;
+    }
+
+    std::string mainShader;
+    if (!readFile(positional[0], mainShader)) {
+        return 1;
+    }
+
+    HeadlessRenderer renderer;
+    if (!renderer.initialize() || !renderer.load(mainShader, passes, width, height, compositeShader)) {
+        std::cerr << "Error: " << renderer.error() << "\n";
+        return 1;
+    }
+
+    AudioTexturePacker packer;
+    TestSignal signal;
+    std::vector<float> samples;
+    auto analyseAudio = [&]() {
+        signal.next(static_cast<size_t>(TestSignal::kSampleRate / inputs.fps), samples);
+        packer.push(samples.data(), 2, samples.size() / 2);
+        packer.update(1.0 / inputs.fps);
+        const AudioBands& bands = packer.bands();
+        const float levels[4] = {bands.bass, bands.mid, bands.treb, bands.vol};
+        const float attenuated[4] = {bands.bassAtt, bands.midAtt, bands.trebAtt, bands.volAtt};
+        std::copy(levels, levels + 4, inputs.audioBands);
+        std::copy(attenuated, attenuated + 4, inputs.audioBandsAtt);
+        inputs.audioTexture = packer.texels();
+    };
+    if (audioSignal) {
+        // Let the loudness averages settle so the first rendered frame is representative.
+        for (int warmup = 0; warmup < 30; ++warmup) {
+            analyseAudio();
+        }
+    }
+
+    FeatureTrackReader track;
+    FeatureFrame record;
+    std::vector<float> trackTexels(AudioTexturePacker::kWidth * AudioTexturePacker::kHeight * 4);
+    auto replayAudio = [&]() -> bool {
+        const auto& header = track.header();
+        const long index = std::lround(inputs.time * header.fps) - 1;
+        const auto clamped = static_cast<uint32_t>(std::clamp(index, 0L, static_cast<long>(header.frameCount) - 1));
+        if (!track.read(clamped, record)) {
+            std::cerr << "Error: " << track.error() << "\n";
+            return false;
+        }
+        const AudioBands& bands = record.bands;
+        const float levels[4] = {bands.bass, bands.mid, bands.treb, bands.vol};
+        const float attenuated[4] = {bands.bassAtt, bands.midAtt, bands.trebAtt, bands.volAtt};
+        std::copy(levels, levels + 4, inputs.audioBands);
+        std::copy(attenuated, attenuated + 4, inputs.audioBandsAtt);
+        record.toTexels(trackTexels.data());
+        inputs.audioTexture = trackTexels.data();
+        return true;
+    };
+    if (!audioTrack.empty()) {
+        if (!track.open(audioTrack)) {
+            std::cerr << "Error: " << track.error() << "\n";
+            return 1;
+        }
+        if (track.header().frameCount == 0) {
+            std::cerr << "Error: " << audioTrack << " has no frames\n";
+            return 1;
+        }
+    }
+
+    // The first frame also pays for the driver's deferred shader compilation.
+    auto start = std::chrono::steady_clock::now();
+    double firstFrameMillis = 0.0;
+    for (int frame = 0; frame < frames; ++frame) {
+        if (audioSignal && frame > 0) {
+            analyseAudio();
+        }
+        if (!audioTrack.empty() && !replayAudio()) {
+            return 1;
+        }
+        renderer.renderFrame(inputs);
+        if (frame == 0) {
+            renderer.finish();
+            firstFrameMillis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            start = std::chrono::steady_clock::now();
+        }
+        inputs.time += 1.0f / inputs.fps;
+        inputs.frame += 1.0f;
+    }
+    renderer.finish();
+    double steadyMillis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "renderer: " << renderer.renderer() << "\n"
+              << "compile_ms: " << renderer.compileMillis() << "\n"
+              << "first_frame_ms: " << firstFrameMillis << "\n";
+    if (frames > 1) {
+        std::cout << "frame_ms: " << steadyMillis / (frames - 1) << "\n";
+    }
+
+    if (positional.size() == 2 && !writePfm(positional[1], renderer.readPixels(), width, height)) {
+        return 1;
+    }
+    for (const auto& dump : passDumps) {
+        int passWidth = 0;
+        int passHeight = 0;
+        std::vector<float> pixels = renderer.readPass(dump.first, passWidth, passHeight);
+        if (pixels.empty()) {
+            std::cerr << "Error: No pass is bound to " << dump.first << "\n";
+            return 1;
+        }
+        if (!writePfm(dump.second, pixels, passWidth, passHeight)) {
+            return 1;
+        }
+    }
+    return 0;
+}
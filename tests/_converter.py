@@ -0,0 +1,69 @@
+"""Helpers shared by the regression tests that convert presets and render the result.
+
+convert() runs MilkdropConverter with --pass-graph and reads the passes from the manifest
+instead of the printed summary, so the tests do not depend on the CLI's output format:
+- the passes listed before "main" are the prepasses, in render order, each given to
+  MilkdropRender as --pass <sampler> <shader> <size>;
+- a pass listed after "main" is the composite shader given with --composite.
+"""
+
+from __future__ import annotations
+
+import json
+import subprocess
+from dataclasses import dataclass
+from pathlib import Path
+
+
+@dataclass
+class Pass:
+    name: str
+    sampler: str
+    shader: Path
+    size: str  # "WxH", or "/N" for 1/N of the screen, as MilkdropRender --pass expects
+
+    def arguments(self) -> list[str]:
+        return ["--pass", self.sampler, str(self.shader), self.size]
+
+
+@dataclass
+class Conversion:
+    passes: list[Pass]
+    composite: Path | None
+    graph: dict
+    stdout: str
+    stderr: str
+
+
+def run(command: list[str], allowed: tuple[int, ...] = (0,)) -> subprocess.CompletedProcess:
+    result = subprocess.run(command, text=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if result.returncode not in allowed:
+        raise RuntimeError(
+            f"{' '.join(command)} exited with status {result.returncode}\n"
+            f"stdout:\n{result.stdout}\n"
+            f"stderr:\n{result.stderr}"
+        )
+    return result
+
+
+def convert(converter: Path, preset: Path, output: Path, *options: str) -> Conversion:
+    """Converts a preset; the manifest is written next to the output shader as <stem>.json."""
+    manifest = output.with_suffix(".json")
+    result = run([str(converter), *options, "--pass-graph", str(manifest), str(preset), str(output)])
+    graph = json.loads(manifest.read_text())
+
+    sizes = {resource["name"]: resource["size"] for resource in graph["resources"]}
+    names = [render_pass["name"] for render_pass in graph["passes"]]
+    main = names.index("main")
+    passes = []
+    for render_pass in graph["passes"][:main]:
+        size = sizes[render_pass["output"]]
+        passes.append(Pass(render_pass["name"], render_pass["output"], Path(render_pass["shader"]),
+                           f"/{size['divisor']}" if "divisor" in size else f"{size['width']}x{size['height']}"))
+    composite = Path(graph["passes"][main + 1]["shader"]) if main + 1 < len(names) else None
+    return Conversion(passes, composite, graph, result.stdout, result.stderr)
+
+
+def pass_arguments(passes: list[Pass]) -> list[str]:
+    """MilkdropRender --pass arguments for the prepasses, in render order."""
+    return [argument for render_pass in passes for argument in render_pass.arguments()]
@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+"""Seeded generator of synthetic .milk presets for scaling benchmarks.
+
+Every knob of a preset is set on the command line (or in a PresetSpec when imported):
+- statements: per-frame statements; the per-pixel code gets half as many;
+- depth: nesting depth of every right-hand side. Each level wraps the expression below it in
+  one operator or function whose other operands are leaves, so the size of an expression
+  grows linearly with its depth;
+- user_vars: distinct user variables the per-frame code assigns round-robin (at most one new
+  variable per statement), and as many for the per-pixel code;
+- q_vars / t_vars: q1..qN set at the end of the per-frame code and read by the per-pixel,
+  wave and shape code; t1..tN set by each custom wave's and shape's per-frame code and read by
+  its per-point code;
+- wave_mode: nWaveMode (0-8);
+- custom_waves / custom_shapes: enabled custom waves and shapes (0-4 each), with a few
+  statements of code each.
+
+The same spec and seed always give the same bytes. Leaves are builtins, variables assigned
+earlier and random constants, so different seeds give different statements, which keeps the
+converter's translation cache from serving one preset's statements to the next.
+"""
+
+from __future__ import annotations
+
+import argparse
+import random
+import sys
+from dataclasses import dataclass, replace
+from pathlib import Path
+
+MAX_CUSTOM = 4
+MAX_Q = 32
+MAX_T = 8
+
+FRAME_INPUTS = ["time", "frame", "fps", "bass", "mid", "treb", "bass_att", "mid_att", "treb_att", "progress"]
+FRAME_OUTPUTS = ["zoom", "rot", "warp", "cx", "cy", "dx", "dy", "sx", "sy", "decay", "wave_r", "wave_g", "wave_b", "wave_a"]
+PIXEL_INPUTS = ["x", "y", "rad", "ang", "time", "bass", "mid", "treb"]
+PIXEL_OUTPUTS = ["zoom", "rot", "warp", "cx", "cy", "dx", "dy", "sx", "sy"]
+POINT_INPUTS = ["sample", "value1", "value2", "time", "bass"]
+SHAPE_OUTPUTS = ["x", "y", "rad", "ang"]
+
+UNARY = ["sin", "cos", "abs", "sqr", "sign"]
+BINARY_FUNCTIONS = ["min", "max", "atan2"]
+OPERATORS = ["+", "-", "*"]
+
+
+@dataclass(frozen=True)
+class PresetSpec:
+    statements: int = 16
+    depth: int = 3
+    user_vars: int = 8
+    q_vars: int = 4
+    t_vars: int = 2
+    wave_mode: int = 2
+    custom_waves: int = 1
+    custom_shapes: int = 1
+    seed: int = 1
+
+    def validate(self) -> None:
+        if self.statements < 1 or self.depth < 0 or self.user_vars < 1:
+            raise ValueError("statements and user_vars must be at least 1, depth at least 0")
+        if not 0 <= self.q_vars <= MAX_Q or not 0 <= self.t_vars <= MAX_T:
+            raise ValueError(f"q_vars must be in 0..{MAX_Q} and t_vars in 0..{MAX_T}")
+        if not 0 <= self.wave_mode <= 8:
+            raise ValueError("wave_mode must be in 0..8")
+        if not 0 <= self.custom_waves <= MAX_CUSTOM or not 0 <= self.custom_shapes <= MAX_CUSTOM:
+            raise ValueError(f"custom_waves and custom_shapes must be in 0..{MAX_CUSTOM}")
+
+
+class _Code:
+    """Writes one block of code, tracking the variables it has assigned so far."""
+
+    def __init__(self, rng: random.Random, inputs: list[str]):
+        self.rng = rng
+        self.inputs = list(inputs)
+        self.assigned: list[str] = []
+        self.lines: list[str] = []
+
+    def constant(self) -> str:
+        return f"{self.rng.uniform(-1.0, 1.0):.4f}"
+
+    def leaf(self) -> str:
+        pick = self.rng.random()
+        if pick < 0.35 and self.assigned:
+            return self.rng.choice(self.assigned)
+        if pick < 0.7:
+            return self.rng.choice(self.inputs)
+        return self.constant()
+
+    def expression(self, depth: int) -> str:
+        if depth == 0:
+            return self.leaf()
+        inner = self.expression(depth - 1)
+        kind = self.rng.randrange(6)
+        if kind == 0:
+            return f"{self.rng.choice(UNARY)}({inner})"
+        if kind == 1:
+            return f"{self.rng.choice(BINARY_FUNCTIONS)}({inner},{self.leaf()})"
+        if kind == 2:
+            return f"if(above({inner},{self.leaf()}),{self.leaf()},{self.leaf()})"
+        if kind == 3:
+            return f"sqrt(abs({inner}))"
+        if kind == 4:
+            return f"({inner})/{self.rng.uniform(1.5, 4.0):.3f}"
+        operands = [f"({inner})", self.leaf()]
+        self.rng.shuffle(operands)
+        return operands[0] + self.rng.choice(OPERATORS) + operands[1]
+
+    def assign(self, target: str, depth: int) -> None:
+        self.lines.append(f"{target}={self.expression(depth)};")
+        if target not in self.assigned:
+            self.assigned.append(target)
+
+
+def _statements(code: _Code, count: int, depth: int, variables: list[str], outputs: list[str]) -> None:
+    """@p count statements assigning @p variables round-robin, every fourth one an output."""
+    for index in range(count):
+        if index % 4 == 3:
+            code.assign(outputs[(index // 4) % len(outputs)], depth)
+        else:
+            code.assign(variables[(index - index // 4) % len(variables)], depth)
+
+
+def _lines(prefix: str, lines: list[str]) -> list[str]:
+    return [f"{prefix}{number}={line}" for number, line in enumerate(lines, start=1)]
+
+
+def generate(spec: PresetSpec) -> str:
+    spec.validate()
+    rng = random.Random(f"{spec.seed}:{spec}")
+    q_names = [f"q{index}" for index in range(1, spec.q_vars + 1)]
+    t_names = [f"t{index}" for index in range(1, spec.t_vars + 1)]
+    small_depth = min(spec.depth, 2)
+
+    out = [
+        "[preset00]",
+        "fRating=3.000000",
+        "fGammaAdj=2.000000",
+        "fDecay=0.980000",
+        "fWaveAlpha=0.800000",
+        "fWaveScale=1.000000",
+        f"nWaveMode={spec.wave_mode}",
+        "bAdditiveWaves=0",
+        "bWaveDots=0",
+        "bMaximizeWaveColor=1",
+        "zoom=1.000000",
+        "rot=0.000000",
+        "warp=0.500000",
+        "wave_r=0.800000",
+        "wave_g=0.600000",
+        "wave_b=0.400000",
+        "wave_x=0.500000",
+        "wave_y=0.500000",
+    ]
+
+    for index in range(spec.custom_waves):
+        out += [
+            f"wavecode_{index}_enabled=1",
+            f"wavecode_{index}_samples={rng.choice([128, 256, 512])}",
+            f"wavecode_{index}_sep=0",
+            f"wavecode_{index}_bSpectrum={rng.randrange(2)}",
+            f"wavecode_{index}_bUseDots={rng.randrange(2)}",
+            f"wavecode_{index}_bDrawThick={rng.randrange(2)}",
+            f"wavecode_{index}_bAdditive={rng.randrange(2)}",
+            f"wavecode_{index}_scaling=1.000000",
+            f"wavecode_{index}_smoothing=0.500000",
+            f"wavecode_{index}_r={rng.random():.6f}",
+            f"wavecode_{index}_g={rng.random():.6f}",
+            f"wavecode_{index}_b={rng.random():.6f}",
+            f"wavecode_{index}_a=1.000000",
+        ]
+        frame = _Code(rng, FRAME_INPUTS + q_names)
+        for name in t_names:
+            frame.assign(name, small_depth)
+        point = _Code(rng, POINT_INPUTS + q_names + t_names)
+        for target in ["x", "y", "r", "a"]:
+            point.assign(target, small_depth)
+        out += _lines(f"wave_{index}_per_frame", frame.lines)
+        out += _lines(f"wave_{index}_per_point", point.lines)
+
+    for index in range(spec.custom_shapes):
+        out += [
+            f"shapecode_{index}_enabled=1",
+            f"shapecode_{index}_sides={rng.randrange(3, 9)}",
+            f"shapecode_{index}_additive={rng.randrange(2)}",
+            f"shapecode_{index}_thickOutline={rng.randrange(2)}",
+            f"shapecode_{index}_textured=0",
+            f"shapecode_{index}_num_inst={rng.choice([1, 4, 16])}",
+            f"shapecode_{index}_x={rng.random():.6f}",
+            f"shapecode_{index}_y={rng.random():.6f}",
+            f"shapecode_{index}_rad={rng.uniform(0.05, 0.3):.6f}",
+            f"shapecode_{index}_ang=0.000000",
+            f"shapecode_{index}_r={rng.random():.6f}",
+            f"shapecode_{index}_g={rng.random():.6f}",
+            f"shapecode_{index}_b={rng.random():.6f}",
+            f"shapecode_{index}_a=1.000000",
+            f"shapecode_{index}_border_a=0.000000",
+        ]
+        frame = _Code(rng, FRAME_INPUTS + ["instance"] + q_names)
+        for name in t_names:
+            frame.assign(name, small_depth)
+        for target in SHAPE_OUTPUTS:
+            frame.assign(target, small_depth)
+        out += _lines(f"shape_{index}_per_frame", frame.lines)
+
+    frame = _Code(rng, FRAME_INPUTS)
+    _statements(frame, spec.statements, spec.depth, [f"fvar{index}" for index in range(spec.user_vars)], FRAME_OUTPUTS)
+    for name in q_names:
+        frame.assign(name, spec.depth)
+    out += _lines("per_frame_", frame.lines)
+
+    pixel = _Code(rng, PIXEL_INPUTS + q_names)
+    _statements(pixel, max(1, spec.statements // 2), spec.depth, [f"pvar{index}" for index in range(spec.user_vars)],
+                PIXEL_OUTPUTS)
+    out += _lines("per_pixel_", pixel.lines)
+
+    return "\n".join(out) + "\n"
+
+
+def main(argv: list[str] | None = None) -> int:
+    defaults = PresetSpec()
+    parser = argparse.ArgumentParser(description="Write seeded synthetic .milk presets")
+    parser.add_argument("output", type=Path, help="Directory to write synthetic_<seed>.milk files to")
+    parser.add_argument("--count", type=int, default=1, help="Presets to write, with seeds seed..seed+count-1")
+    parser.add_argument("--seed", type=int, default=defaults.seed)
+    parser.add_argument("--statements", type=int, default=defaults.statements)
+    parser.add_argument("--depth", type=int, default=defaults.depth)
+    parser.add_argument("--user-vars", type=int, default=defaults.user_vars)
+    parser.add_argument("--q-vars", type=int, default=defaults.q_vars)
+    parser.add_argument("--t-vars", type=int, default=defaults.t_vars)
+    parser.add_argument("--wave-mode", type=int, default=defaults.wave_mode)
+    parser.add_argument("--custom-waves", type=int, default=defaults.custom_waves)
+    parser.add_argument("--custom-shapes", type=int, default=defaults.custom_shapes)
+    args = parser.parse_args(argv)
+
+    spec = PresetSpec(
+        statements=args.statements,
+        depth=args.depth,
+        user_vars=args.user_vars,
+        q_vars=args.q_vars,
+        t_vars=args.t_vars,
+        wave_mode=args.wave_mode,
+        custom_waves=args.custom_waves,
+        custom_shapes=args.custom_shapes,
+    )
+    try:
+        spec.validate()
+    except ValueError as error:
+        print(f"Error: {error}", file=sys.stderr)
+        return 1
+    args.output.mkdir(parents=True, exist_ok=True)
+    for seed in range(args.seed, args.seed + args.count):
+        (args.output / f"synthetic_{seed}.milk").write_text(generate(replace(spec, seed=seed)))
+    print(f"Wrote {args.count} presets to {args.output}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,12 +1,12 @@
 bamx = sin((iTime - iAudioBands.x));
 boom = sin(((mod(bamx, boom) * iAudioBands.x) * iTime));
 bom = ((rand(uv) * ((0.1 * (iTime - boom)) * (iTime - bamx))) * 2.0);
-speed = mod(sin(((speedA - speedB) * (speedB - speedA))), speedC);
-speedA = sin((((iAudioBands.x * 3.0) - speedB) * iTime));
-speedB = sin((((iAudioBands.y * 3.0) + speedC) * iTime));
-speedC = sin((((iAudioBands.z * 3.0) - speedA) * iTime));
+speed = mod(sin(((speeda - speedb) * (speedb - speeda))), speedc);
+speeda = sin((((iAudioBands.x * 3.0) - speedb) * iTime));
+speedb = sin((((iAudioBands.y * 3.0) + speedc) * iTime));
+speedc = sin((((iAudioBands.z * 3.0) - speeda) * iTime));
 shox = (cos((q3 - q8)) * speed);
-rhox = mod(sin((q5 + speedB)), speed);
+rhox = mod(sin((q5 + speedb)), speed);
 rox = ((shox - rhox) / 2.0);
 daz = ((((speed * (iTime - 1.0)) * iAudioBands.x) * 0.5) + 0.5);
 wec = sin((iTime - 1.0));
@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+"""Regression for the offline audio feature extractor (MilkdropAudioFeatures).
+
+Synthesizes WAV files with a bass tone that switches to a treble tone halfway, extracts
+feature tracks and checks the format and the analysis:
+- the header, frame count, record size and per-record times match the requested fps;
+- bass dominates the first half and the spectrum peak moves up in the second;
+- the same signal as 16-bit stereo, 24-bit stereo and 32-bit float mono gives the same
+  bands, and repeated runs are byte-identical;
+- peak memory does not grow with the file length (the reader streams in chunks).
+"""
+
+from __future__ import annotations
+
+import argparse
+import math
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+from array import array
+from pathlib import Path
+
+SAMPLE_RATE = 44100
+SWITCH_SECONDS = 3.0
+BASS_HZ = 60.0
+TREBLE_HZ = 6000.0
+HEADER = struct.Struct("<4sIfIIIII")
+BAND_VALUES = 9              # time + bass, mid, treb, vol and their _att values
+FORMAT_TOLERANCE = 1e-2      # Relative band difference allowed between sample formats
+COMPARED_BANDS = (1, 2, 5, 6)  # bass, mid, bass_att, mid_att (see compare_bands)
+SETTLE_RECORDS = 10           # Startup records where every band is a ratio of near-zero levels
+MAX_RSS_GROWTH_KB = 4 * 1024  # Peak RSS growth allowed from a 6 s file to a 120 s (21 MB) file
+
+
+def signal(seconds: float) -> list[float]:
+    samples = []
+    for i in range(int(seconds * SAMPLE_RATE)):
+        t = i / SAMPLE_RATE
+        if t % (2 * SWITCH_SECONDS) < SWITCH_SECONDS:
+            samples.append(0.6 * math.sin(2 * math.pi * BASS_HZ * t))
+        else:
+            samples.append(0.3 * math.sin(2 * math.pi * TREBLE_HZ * t))
+    return samples
+
+
+def write_wav(path: Path, samples: list[float], channels: int, bits: int, is_float: bool = False) -> None:
+    if is_float:
+        data = struct.pack(f"<{len(samples) * channels}f", *[s for s in samples for _ in range(channels)])
+    elif bits == 16:
+        data = array("h", [int(s * 32767) for s in samples for _ in range(channels)]).tobytes()
+    else:  # 24-bit
+        data = b"".join(struct.pack("<i", int(s * 8388607))[:3] for s in samples for _ in range(channels))
+    block = channels * bits // 8
+    fmt = struct.pack("<HHIIHH", 3 if is_float else 1, channels, SAMPLE_RATE, SAMPLE_RATE * block, block, bits)
+    # A LIST chunk before the data checks that unknown chunks are skipped.
+    extra = b"LIST" + struct.pack("<I", 3) + b"abc\0"
+    body = b"WAVE" + b"fmt " + struct.pack("<I", len(fmt)) + fmt + extra + b"data" + struct.pack("<I", len(data)) + data
+    path.write_bytes(b"RIFF" + struct.pack("<I", len(body)) + body)
+
+
+def extract(tool: Path, wav: Path, output: Path, *options: str) -> bytes:
+    result = subprocess.run([str(tool), *options, str(wav), str(output)], text=True,
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if result.returncode != 0:
+        raise RuntimeError(f"{tool} exited with status {result.returncode}\n{result.stderr}")
+    return output.read_bytes()
+
+
+def records(track: bytes) -> tuple[tuple, list[tuple[float, ...]]]:
+    header = HEADER.unpack_from(track)
+    _magic, _version, _fps, _rate, flags, count, waveform, spectrum = header
+    values = BAND_VALUES + (2 * waveform if flags & 1 else 0) + (2 * spectrum if flags & 2 else 0)
+    layout = struct.Struct(f"<{values}f")
+    return header, [layout.unpack_from(track, HEADER.size + i * layout.size) for i in range(count)]
+
+
+def check_track(name: str, track: bytes, fps: float, seconds: float, flags: int) -> list[str]:
+    failures = []
+    header, frames = records(track)
+    magic, version, track_fps, rate, track_flags, count, waveform, spectrum = header
+    if (magic, version, track_fps, rate, track_flags) != (b"MDAF", 1, fps, SAMPLE_RATE, flags):
+        failures.append(f"{name}: unexpected header {header}")
+    if (waveform, spectrum) != (480, 512):
+        failures.append(f"{name}: unexpected row sizes {waveform}/{spectrum}")
+    if count != int(seconds * fps):
+        failures.append(f"{name}: {count} frames, expected {int(seconds * fps)}")
+    record_bytes = 4 * (BAND_VALUES + (960 if flags & 1 else 0) + (1024 if flags & 2 else 0))
+    if len(track) != HEADER.size + count * record_bytes:
+        failures.append(f"{name}: file size {len(track)} does not match {count} records of {record_bytes} bytes")
+    for index, frame in enumerate(frames):
+        if abs(frame[0] - (index + 1) / fps) > 1e-4:
+            failures.append(f"{name}: record {index} has time {frame[0]}, expected {(index + 1) / fps}")
+            break
+    return failures
+
+
+def check_analysis(frames: list[tuple[float, ...]], fps: float) -> list[str]:
+    failures = []
+    switch = int(SWITCH_SECONDS * fps)
+    # Skip the first second of each half so the loudness averages have settled.
+    bass_half = frames[int(fps):switch]
+    treble_half = frames[switch + int(fps):2 * switch]
+    bass_first = sum(frame[1] for frame in bass_half) / len(bass_half)
+    bass_second = sum(frame[1] for frame in treble_half) / len(treble_half)
+    if not bass_first > 5 * bass_second:
+        failures.append(f"bass level {bass_first:.3f} in the bass half is not well above {bass_second:.3f}")
+
+    def spectrum_peak(frame: tuple[float, ...]) -> int:
+        left = frame[BAND_VALUES + 960::2]
+        return max(range(len(left)), key=left.__getitem__)
+
+    low_peak = spectrum_peak(bass_half[-1])
+    high_peak = spectrum_peak(treble_half[-1])
+    if not low_peak < high_peak:
+        failures.append(f"spectrum peak bin {low_peak} in the bass half is not below {high_peak} in the treble half")
+    waveform = bass_half[-1][BAND_VALUES:BAND_VALUES + 960]
+    if not 0.3 < max(abs(value) for value in waveform) <= 1.0:
+        failures.append("waveform row does not hold the normalized bass tone")
+    return failures
+
+
+def compare_bands(name: str, reference: list[tuple[float, ...]], candidate: list[tuple[float, ...]]) -> list[str]:
+    """Compares the bands that carry signal. Treble (and so vol) is silent in the bass half,
+    where its level relative to its own average only measures quantization noise."""
+    for index, (a, b) in enumerate(zip(reference, candidate)):
+        if index < SETTLE_RECORDS:
+            continue
+        for band in COMPARED_BANDS:
+            if abs(a[band] - b[band]) > FORMAT_TOLERANCE * max(1.0, abs(a[band])):
+                return [f"{name}: band {band} at record {index} differs from 16-bit stereo ({a[band]} vs {b[band]})"]
+    return []
+
+
+def peak_rss_kb(command: list[str]) -> int:
+    """Polls the child's VmHWM. getrusage() would also count the pages the child shared
+    with this process before exec. Readings taken before exec are skipped by name."""
+    name = Path(command[0]).name[:15]
+    process = subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    peak = 0
+    while process.poll() is None:
+        try:
+            status = Path(f"/proc/{process.pid}/status").read_text()
+        except OSError:
+            break
+        fields = dict(line.split(":", 1) for line in status.splitlines() if ":" in line)
+        if fields.get("Name", "").strip() == name and "VmHWM" in fields:
+            peak = max(peak, int(fields["VmHWM"].split()[0]))
+        time.sleep(0.002)
+    if process.wait() != 0:
+        raise RuntimeError(f"{' '.join(command)} exited with status {process.returncode}")
+    return peak
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Validate MilkdropAudioFeatures tracks")
+    parser.add_argument("--tool", type=Path, required=True, help="Path to MilkdropAudioFeatures executable")
+    args = parser.parse_args(argv)
+
+    failures: list[str] = []
+    seconds = 2 * SWITCH_SECONDS
+    samples = signal(seconds)
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        stereo16 = tmp_path / "stereo16.wav"
+        write_wav(stereo16, samples, channels=2, bits=16)
+
+        track = extract(args.tool, stereo16, tmp_path / "full.mdaf", "--waveform", "--spectrum")
+        failures += check_track("stereo16 60fps", track, 60.0, seconds, flags=3)
+        _, reference = records(track)
+        failures += check_analysis(reference, 60.0)
+
+        if extract(args.tool, stereo16, tmp_path / "again.mdaf", "--waveform", "--spectrum") != track:
+            failures.append("repeated extraction is not byte-identical")
+
+        compact = extract(args.tool, stereo16, tmp_path / "compact.mdaf", "--fps", "30")
+        failures += check_track("stereo16 30fps", compact, 30.0, seconds, flags=0)
+
+        for name, channels, bits, is_float in (("stereo24", 2, 24, False), ("mono float", 1, 32, True)):
+            wav = tmp_path / f"{name.replace(' ', '_')}.wav"
+            write_wav(wav, samples, channels, bits, is_float)
+            _, candidate = records(extract(args.tool, wav, tmp_path / "format.mdaf"))
+            failures += compare_bands(name, reference, candidate)
+
+        # Peak memory must not follow the input size: a 20x longer file may not add more
+        # than a few MB over the short one (the long input alone is about 21 MB).
+        long_wav = tmp_path / "long.wav"
+        period = array("h", [int(s * 32767) for s in samples for _ in range(2)]).tobytes()
+        data = period * 20
+        fmt = struct.pack("<HHIIHH", 1, 2, SAMPLE_RATE, SAMPLE_RATE * 4, 4, 16)
+        body = b"WAVE" + b"fmt " + struct.pack("<I", len(fmt)) + fmt + b"data" + struct.pack("<I", len(data)) + data
+        long_wav.write_bytes(b"RIFF" + struct.pack("<I", len(body)) + body)
+        del data, body
+        short_kb = peak_rss_kb([str(args.tool), str(stereo16), str(tmp_path / "short.mdaf")])
+        long_kb = peak_rss_kb([str(args.tool), str(long_wav), str(tmp_path / "long.mdaf")])
+        failures += check_track("long", (tmp_path / "long.mdaf").read_bytes(), 60.0, 20 * seconds, flags=0)
+        growth = long_kb - short_kb
+        if short_kb == 0 or long_kb == 0:
+            failures.append("could not sample the extractor's peak memory from /proc")
+        elif growth > MAX_RSS_GROWTH_KB:
+            failures.append(f"peak memory grew by {growth} KB for a 20x longer input")
+
+    if failures:
+        print("Audio feature track regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print("Validated MilkdropAudioFeatures tracks (formats, timing, analysis, streaming memory)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Image regression for the real waveform/spectrum input (--audio-texture).
+
+Every fixture is converted with and without --audio-texture and rendered off-screen by
+MilkdropRender with --audio-signal, which streams a synthetic stereo signal through
+AudioTexturePacker each frame. The default shaders must not reference iAudioTexture;
+the texture shaders must declare it and compile, including when combined with
+--wave-geometry and --wave-lowres. They must also draw a different wave wherever the
+band-level approximation draws one, which shows the samples are actually read from
+the texture. Fixtures without a wave (unsupported modes) are skipped, and custom waves
+are disabled so only the built-in wave is compared (regression_custom_waves.py covers
+them, including their iAudioTexture samples). Preset warp and composite shaders are
+disabled for the same reason, since they can light the whole frame.
+"""
+
+from __future__ import annotations
+
+import argparse
+import re
+import struct
+import sys
+import tempfile
+from pathlib import Path
+
+from _converter import Pass, convert, pass_arguments, run
+
+RENDER_SIZE = "256x256"
+LIT_THRESHOLD = 0.02     # Channels above this count as covered by the wave
+MIN_CHANGED = 0.05       # Share of lit channels that must change with the real waveform
+
+CUSTOM_WAVE_ENABLED = re.compile(r"^(wavecode_\d+_enabled)=1", re.MULTILINE | re.IGNORECASE)
+PRESET_VERSION = re.compile(r"^(MILKDROP_PRESET_VERSION)=\d+", re.MULTILINE | re.IGNORECASE)
+BORDER_ALPHA = re.compile(r"\b([oi]b_a)(\s*=(?!=))", re.IGNORECASE)
+SAMPLER = re.compile(r"^\s*uniform\s+sampler2D\s+iAudioTexture\s*;", re.MULTILINE)
+
+
+def render(renderer: Path, shader: Path, passes: list[Pass], output: Path) -> list[float]:
+    command = [str(renderer), "--size", RENDER_SIZE, "--audio-signal"]
+    run(command + pass_arguments(passes) + [str(shader), str(output)])
+
+    data = output.read_bytes()
+    header, dimensions, _scale, pixels = data.split(b"\n", 3)
+    if header != b"PF":
+        raise RuntimeError(f"{output} is not a colour PFM image")
+    width, height = (int(value) for value in dimensions.split())
+    count = width * height * 3
+    return list(struct.unpack(f"<{count}f", pixels[: 4 * count]))
+
+
+def sources(shader: Path, passes: list[Pass]) -> list[str]:
+    return [path.read_text() for path in [shader] + [render_pass.shader for render_pass in passes]]
+
+
+def references_texture(shader: Path, passes: list[Pass]) -> bool:
+    return any(SAMPLER.search(source) for source in sources(shader, passes))
+
+
+def draws_wave(shader: Path, passes: list[Pass]) -> bool:
+    return any("wave_sample" in source for source in sources(shader, passes))
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Validate --audio-texture shaders against the band-level wave")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--renderer", type=Path, required=True, help="Path to MilkdropRender executable")
+    parser.add_argument("--fixtures", type=Path, required=True, help="Directory of .milk fixtures")
+    args = parser.parse_args(argv)
+
+    presets = sorted(args.fixtures.glob("*.milk"))
+    if not presets:
+        print(f"No fixtures found in {args.fixtures}")
+        return 1
+
+    failures: list[str] = []
+    lit_fixtures = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        for preset in presets:
+            stem = preset.stem
+            text = preset.read_text()
+            if CUSTOM_WAVE_ENABLED.search(text) or PRESET_VERSION.search(text) or BORDER_ALPHA.search(text):
+                # MilkDrop 1 presets have no warp or composite shaders. Borders drawn over the
+                # wave would hide how much of it changes, so their alphas go to unused variables.
+                preset = tmp_path / preset.name
+                text = BORDER_ALPHA.sub(r"\1_off\2", CUSTOM_WAVE_ENABLED.sub(r"\1=0", text))
+                preset.write_text(PRESET_VERSION.sub(r"\1=100", text))
+            band_shader = tmp_path / f"{stem}.frag"
+            band_passes = convert(args.converter, preset, band_shader).passes
+            if references_texture(band_shader, band_passes):
+                failures.append(f"{stem}: default conversion references iAudioTexture")
+            if not draws_wave(band_shader, band_passes):
+                continue  # Unsupported wave modes emit no wave, so there is nothing to sample
+            band = render(args.renderer, band_shader, band_passes, tmp_path / f"{stem}.pfm")
+
+            for label, options in (("texture", []),
+                                   ("texture+geometry", ["--wave-geometry"]),
+                                   ("texture+lowres", ["--wave-lowres"])):
+                shader = tmp_path / f"{stem}.{label}.frag"
+                passes = convert(args.converter, preset, shader, "--audio-texture", *options).passes
+                if not references_texture(shader, passes):
+                    failures.append(f"{stem} ({label}): shaders do not declare iAudioTexture")
+                    continue
+                candidate = render(args.renderer, shader, passes, tmp_path / f"{stem}.{label}.pfm")
+                if label != "texture":
+                    continue
+
+                lit = [(a, b) for a, b in zip(band, candidate) if a > LIT_THRESHOLD or b > LIT_THRESHOLD]
+                if not lit:
+                    continue
+                lit_fixtures += 1
+                changed = sum(1 for a, b in lit if abs(a - b) > LIT_THRESHOLD) / len(lit)
+                if changed < MIN_CHANGED:
+                    failures.append(
+                        f"{stem}: only {changed:.2%} of lit channels changed; the wave ignores iAudioTexture")
+
+    if lit_fixtures == 0:
+        failures.append("No fixture draws a visible wave; the comparison would be vacuous")
+
+    if failures:
+        print("Audio texture regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print(f"Validated --audio-texture on {len(presets)} fixtures ({lit_fixtures} with a visible wave)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+"""Regression for the blur1-3 pyramid preset shaders sample.
+
+A preset emits two blur passes per level up to the highest level its warp or composite shader
+reads, sized 1/2, 1/4, 1/8, 1/8, 1/16 and 1/16 of the screen, and none without a blur read.
+preset_blur.milk draws hard edges in its warp shader and shows GetBlur2() in its composite
+shader, with blur bounds and edge darkening from its settings; a variant takes them from the
+per-frame code. Each rendered blur texture, and the composite output, must match a CPU
+reference of libprojectM's BlurTexture (the same taps and weights, bilinear clamp-to-edge
+fetches, safe bounds, [0, 1] remap and edge darkening) run on the dumped warp output.
+"""
+
+from __future__ import annotations
+
+import argparse
+import math
+import re
+import struct
+import sys
+import tempfile
+from pathlib import Path
+
+from _converter import Pass, convert, pass_arguments, run
+
+RENDER_WIDTH = 120
+RENDER_HEIGHT = 90
+TOLERANCE = 0.01
+
+WEIGHTS = (4.0, 3.8, 3.5, 2.9, 1.9, 1.2, 0.7, 0.3)
+DIVISORS = (2, 4, 8, 8, 16, 16)
+SAMPLERS = ("iBlur1H", "iBlur1", "iBlur2H", "iBlur2", "iBlur3H", "iBlur3")
+
+Image = tuple[int, int, list[tuple[float, float, float]]]
+
+
+def read_pfm(path: Path) -> Image:
+    data = path.read_bytes()
+    header, dimensions, _scale, pixels = data.split(b"\n", 3)
+    if header != b"PF":
+        raise RuntimeError(f"{path} is not a colour PFM image")
+    width, height = (int(value) for value in dimensions.split())
+    values = struct.unpack(f"<{width * height * 3}f", pixels[: 12 * width * height])
+    return width, height, [tuple(values[i:i + 3]) for i in range(0, len(values), 3)]
+
+
+def render(renderer: Path, shader: Path, passes: list[Pass], composite: Path | None,
+           frames: int, output: Path, dumps: dict[str, Path] | None = None) -> Image:
+    command = [str(renderer), "--size", f"{RENDER_WIDTH}x{RENDER_HEIGHT}", "--frames", str(frames)]
+    command += pass_arguments(passes)
+    if composite is not None:
+        command += ["--composite", str(composite)]
+    for sampler, path in (dumps or {}).items():
+        command += ["--dump-pass", sampler, str(path)]
+    run(command + [str(shader), str(output)])
+    return read_pfm(output)
+
+
+def sample(image: Image, u: float, v: float) -> tuple[float, float, float]:
+    """GL_LINEAR fetch with GL_CLAMP_TO_EDGE; rows are bottom first, as glReadPixels returns them."""
+    width, height, texels = image
+    x = u * width - 0.5
+    y = v * height - 0.5
+    x0 = math.floor(x)
+    y0 = math.floor(y)
+    fx = x - x0
+    fy = y - y0
+
+    def texel(column: int, row: int) -> tuple[float, float, float]:
+        return texels[min(max(row, 0), height - 1) * width + min(max(column, 0), width - 1)]
+
+    corners = ((texel(x0, y0), (1 - fx) * (1 - fy)), (texel(x0 + 1, y0), fx * (1 - fy)),
+               (texel(x0, y0 + 1), (1 - fx) * fy), (texel(x0 + 1, y0 + 1), fx * fy))
+    return tuple(sum(value[c] * weight for value, weight in corners) for c in range(3))
+
+
+def safe_bounds(bounds: list[float]) -> tuple[list[float], list[float]]:
+    """BlurTexture::GetSafeBlurMinMaxValues() with MilkDrop's midpoint split."""
+    low = bounds[0::2]
+    high = bounds[1::2]
+    for level in range(3):
+        if level > 0:
+            high[level] = min(high[level - 1], high[level])
+            low[level] = max(low[level - 1], low[level])
+        if high[level] - low[level] < 0.1:
+            average = 0.5 * (low[level] + high[level])
+            low[level] = average - 0.05
+            high[level] = average + 0.05
+    return low, high
+
+
+def reference_pass(index: int, source: Image, bounds: list[float], edge_darken: float) -> Image:
+    """One BlurTexture::Update() pass on the CPU."""
+    width = math.ceil(RENDER_WIDTH / DIVISORS[index])
+    height = math.ceil(RENDER_HEIGHT / DIVISORS[index])
+    texel_u = 1.0 / source[0]
+    texel_v = 1.0 / source[1]
+    low, high = safe_bounds(list(bounds))
+    level = index // 2
+    if level == 0:
+        range_low, range_high = low[0], high[0]
+    else:
+        span = high[level - 1] - low[level - 1]
+        range_low = (low[level] - low[level - 1]) / span
+        range_high = (high[level] - low[level - 1]) / span
+    scale = 1.0 / (range_high - range_low)
+    bias = -range_low * scale
+
+    if index % 2 == 0:
+        pairs = [(WEIGHTS[i] + WEIGHTS[i + 1], i + 2 * WEIGHTS[i + 1] / (WEIGHTS[i] + WEIGHTS[i + 1])) for i in range(0, 8, 2)]
+        divisor = 0.5 / sum(weight for weight, _ in pairs)
+    else:
+        near = sum(WEIGHTS[:4])
+        far = sum(WEIGHTS[4:])
+        pairs = [(near, 2 * (WEIGHTS[2] + WEIGHTS[3]) / near), (far, 2 + 2 * (WEIGHTS[6] + WEIGHTS[7]) / far)]
+        divisor = 1.0 / (2 * (near + far))
+
+    texels = []
+    for y in range(height):
+        for x in range(width):
+            u = (x + 0.5) / width
+            v = (y + 0.5) / height
+            blur = [0.0, 0.0, 0.0]
+            for weight, distance in pairs:
+                du, dv = (distance * texel_u, 0.0) if index % 2 == 0 else (0.0, distance * texel_v)
+                ahead = sample(source, u + du, v + dv)
+                behind = sample(source, u - du, v - dv)
+                for c in range(3):
+                    blur[c] += (ahead[c] + behind[c]) * weight
+            blur = [value * divisor for value in blur]
+            if index % 2 == 0:
+                blur = [value * scale + bias for value in blur]
+            elif index == 1:
+                edge = math.sqrt(min(min(u, v), 1.0 - max(u, v)))
+                factor = 1.0 - edge_darken + edge_darken * min(max(edge * 5.0, 0.0), 1.0)
+                blur = [value * factor for value in blur]
+            texels.append(tuple(min(max(value, 0.0), 1.0) for value in blur))
+    return width, height, texels
+
+
+def max_difference(actual: Image, expected: Image) -> float:
+    if actual[:2] != expected[:2]:
+        return math.inf
+    return max(abs(a - e) for pa, pe in zip(actual[2], expected[2]) for a, e in zip(pa, pe))
+
+
+def blur_variant(text: str, comp: str, warp: str | None = None) -> str:
+    text = text.replace("ret = GetBlur2(uv);", comp)
+    if warp is not None:
+        text = re.sub(r"    ret = float3\(step.*\);", warp, text)
+    return text
+
+
+def check_levels(args: argparse.Namespace, tmp: Path, failures: list[str]) -> None:
+    text = (args.fixtures / "preset_blur.milk").read_text()
+    cases = {
+        "none": (blur_variant(text, "ret = tex2D(sampler_main, uv).xyz;"), 0),
+        "blur1": (blur_variant(text, "ret = GetBlur1(uv);"), 1),
+        "blur2": (text, 2),
+        "blur3": (blur_variant(text, "ret = GetBlur3(uv) + tex2D(sampler_blur1, uv).xyz;"), 3),
+        "warp_blur": (blur_variant(text, "ret = tex2D(sampler_main, uv).xyz;",
+                                   "    ret = tex2D(sampler_main, uv).xyz * 0.5 + GetBlur1(uv) * 0.5;"), 1),
+    }
+    for label, (source, level) in cases.items():
+        preset = tmp / f"{label}.milk"
+        preset.write_text(source)
+        shader = tmp / f"{label}.frag"
+        conversion = convert(args.converter, preset, shader)
+        passes, composite = conversion.passes, conversion.composite
+        blur = [(render_pass.name, render_pass.sampler, render_pass.size) for render_pass in passes
+                if render_pass.sampler.startswith("iBlur")]
+        expected = [(f"blur{i // 2 + 1}" + ("_h" if i % 2 == 0 else ""), SAMPLERS[i], f"/{DIVISORS[i]}") for i in range(2 * level)]
+        if blur != expected:
+            failures.append(f"{label}: expected blur passes {expected}, got {blur}")
+        if passes and passes[0].sampler != "iPresetWarp":
+            failures.append(f"{label}: the blur passes must follow the preset_warp pass")
+        # The warp shader reads last frame's blur, so feedback runs through the pyramid.
+        image = render(args.renderer, shader, passes, composite, 3, tmp / f"{label}.pfm")
+        if any(math.isnan(value) or math.isinf(value) for texel in image[2] for value in texel):
+            failures.append(f"{label}: rendered NaN or infinite values")
+
+
+def check_reference(args: argparse.Namespace, tmp: Path, failures: list[str]) -> None:
+    text = (args.fixtures / "preset_blur.milk").read_text()
+    cases = {
+        # b1n/b1x, b2n/b2x and b1ed from the preset settings.
+        "settings": (text, [0.1, 0.9, 0.2, 0.7, 0.0, 1.0], 0.5),
+        # Per-frame bounds override them; blur2's range is too narrow and gets widened.
+        "per_frame": (text.replace("per_pixel_1=a = 0;",
+                                   "per_frame_1=blur1_min = 0.05; blur1_max = 0.8;\n"
+                                   "per_frame_2=blur2_min = 0.5; blur2_max = 0.52;\n"
+                                   "per_frame_3=blur1_edge_darken = 0.25;\n"
+                                   "per_pixel_1=a = 0;"),
+                      [0.05, 0.8, 0.5, 0.52, 0.0, 1.0], 0.25),
+    }
+    for label, (source, bounds, edge_darken) in cases.items():
+        preset = tmp / f"reference_{label}.milk"
+        preset.write_text(source)
+        shader = tmp / f"reference_{label}.frag"
+        conversion = convert(args.converter, preset, shader)
+        passes, composite = conversion.passes, conversion.composite
+        if [render_pass.sampler for render_pass in passes] != ["iPresetWarp", *SAMPLERS[:4]] or composite is None:
+            failures.append(f"{label}: expected preset_warp, blur1 and blur2 passes and a composite shader")
+            continue
+        dumps = {sampler: tmp / f"{label}_{sampler}.pfm" for sampler in ("iPresetWarp", *SAMPLERS[:4])}
+        shown = render(args.renderer, shader, passes, composite, 1, tmp / f"reference_{label}.pfm", dumps)
+
+        expected = read_pfm(dumps["iPresetWarp"])
+        for index, sampler in enumerate(SAMPLERS[:4]):
+            expected = reference_pass(index, expected, bounds, edge_darken)
+            difference = max_difference(read_pfm(dumps[sampler]), expected)
+            if difference > TOLERANCE:
+                failures.append(f"{label}: {sampler} differs from the CPU reference by {difference:.4f}")
+
+        # GetBlur2() maps the stored [0, 1] back to blur2_min..blur2_max.
+        low, high = safe_bounds(list(bounds))
+        composite_expected = (RENDER_WIDTH, RENDER_HEIGHT, [
+            tuple(min(max(value * (high[1] - low[1]) + low[1], 0.0), 1.0)
+                  for value in sample(expected, (x + 0.5) / RENDER_WIDTH, (y + 0.5) / RENDER_HEIGHT))
+            for y in range(RENDER_HEIGHT) for x in range(RENDER_WIDTH)])
+        difference = max_difference(shown, composite_expected)
+        if difference > TOLERANCE:
+            failures.append(f"{label}: GetBlur2() output differs from the CPU reference by {difference:.4f}")
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Validate the blur pyramid against a CPU reference")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--renderer", type=Path, required=True, help="Path to MilkdropRender executable")
+    parser.add_argument("--fixtures", type=Path, required=True, help="Directory of .milk fixtures")
+    args = parser.parse_args(argv)
+
+    failures: list[str] = []
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        check_levels(args, tmp_path, failures)
+        check_reference(args, tmp_path, failures)
+
+    if failures:
+        print("Blur pyramid regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print("Validated blur pass levels and sizes, and blur1/blur2 output against the CPU reference")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
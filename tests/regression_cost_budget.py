@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""Regression checks for --cost-report and --max-cost.
+
+Every fixture is converted with --cost-report and again with --max-cost, and the test
+checks that:
+- the report lists every operation class, the weighted cost and a frame-time estimate
+  consistent with it;
+- the frame-time estimates follow the measured llvmpipe costs in the glsl_perf baseline:
+  each estimate-to-cost ratio is within a factor of --max-ratio of the median, and on
+  average within --max-mean-error of it, so the model stays calibrated when its weights
+  change;
+- a preset that fits the budget is converted unchanged and exits with status 0;
+- a preset over the budget gets the largest wave loop cap that fits, written into its
+  MODE*_MAX_WAVE_ITERATIONS constant, and never drops below WAVE_MIN_WARMUP_ITERATIONS;
+- a preset that does not fit even then keeps that smallest wave, warns and exits with
+  status 2;
+- a budget given in ops is applied the same way as one given as a frame time.
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import re
+import statistics
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+REPORT_FIELDS = ["add/sub", "mul", "div/mod", "compare/logic", "built-in calls", "transcendentals",
+                 "texture fetches", "loop iterations", "weighted cost", "est. frame time"]
+FIELD = re.compile(r"^  ([a-z/. -]+):\s+(\S+)", re.MULTILINE)
+FRAME_TIME = re.compile(r"est\. frame time:\s+([0-9.]+) ms at (\d+)x(\d+), ([0-9.]+) Gop/s reference")
+BUDGET_CAP = re.compile(r"budget:\s+wave loop cap lowered to (\d+)")
+WAVE_CAP = re.compile(r"^const int MODE\w*_MAX_WAVE_ITERATIONS = (\d+);", re.MULTILINE)
+MINIMUM_CAP = re.compile(r"^const int WAVE_MIN_WARMUP_ITERATIONS = (\d+);", re.MULTILINE)
+
+
+def run(command: list[str], allowed: tuple[int, ...] = (0,)) -> subprocess.CompletedProcess:
+    result = subprocess.run(command, text=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if result.returncode not in allowed:
+        raise RuntimeError(
+            f"{' '.join(command)} exited with status {result.returncode}\n"
+            f"stdout:\n{result.stdout}\n"
+            f"stderr:\n{result.stderr}"
+        )
+    return result
+
+
+def report_fields(stdout: str) -> dict[str, str]:
+    return {name: value for name, value in FIELD.findall(stdout) if name in REPORT_FIELDS}
+
+
+def wave_caps(glsl: str) -> list[int]:
+    return [int(cap) for cap in WAVE_CAP.findall(glsl)]
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Cost report and --max-cost regression checks")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--presets", type=Path, nargs="+", required=True, help="Preset files or fixture directories")
+    parser.add_argument("--baseline", type=Path, required=True, help="glsl_perf baseline with measured llvmpipe costs")
+    parser.add_argument("--budget-ms", type=float, default=16.0, help="Frame-time budget passed to --max-cost")
+    parser.add_argument("--max-ratio", type=float, default=2.5,
+                        help="Allowed factor between a preset's estimate-to-measured ratio and the median")
+    parser.add_argument("--max-mean-error", type=float, default=0.25,
+                        help="Allowed mean relative deviation of the ratios from the median")
+    args = parser.parse_args(argv)
+
+    presets: list[Path] = []
+    for path in args.presets:
+        presets += sorted(path.glob("*.milk")) if path.is_dir() else [path]
+    measured = {name: entry["cost"] for name, entry in json.loads(args.baseline.read_text())["presets"].items()}
+
+    failures: list[str] = []
+    ratios: dict[str, float] = {}
+    fitted = lowered = over = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        for preset in presets:
+            name = preset.name
+            plain_output = tmp_path / f"{preset.stem}.frag"
+            plain = run([str(args.converter), "--cost-report", str(preset), str(plain_output)])
+            fields = report_fields(plain.stdout)
+            missing = [field for field in REPORT_FIELDS if field not in fields]
+            if missing:
+                failures.append(f"{name}: cost report lacks {', '.join(missing)}")
+                continue
+            frame = FRAME_TIME.search(plain.stdout)
+            weighted = float(fields["weighted cost"])
+            millis = float(frame.group(1)) if frame else 0.0
+            if not frame or millis <= 0.0 or weighted <= 0.0:
+                failures.append(f"{name}: no usable frame-time estimate in the cost report")
+                continue
+            if "budget:" in plain.stdout:
+                failures.append(f"{name}: --cost-report alone changed the wave budget")
+            if name in measured:
+                ratios[name] = millis / measured[name]
+
+            budgeted_output = tmp_path / f"{preset.stem}.budget.frag"
+            budgeted = run([str(args.converter), "--max-cost", f"{args.budget_ms:g}ms", str(preset), str(budgeted_output)],
+                           allowed=(0, 2))
+            budget_fields = report_fields(budgeted.stdout)
+            budget_frame = FRAME_TIME.search(budgeted.stdout)
+            cap = BUDGET_CAP.search(budgeted.stdout)
+            budget_millis = float(budget_frame.group(1)) if budget_frame else 0.0
+            if "weighted cost" not in budget_fields or not budget_frame:
+                failures.append(f"{name}: --max-cost did not print the cost report")
+                continue
+
+            if millis <= args.budget_ms:
+                fitted += 1
+                if budgeted.returncode != 0 or cap:
+                    failures.append(f"{name}: fits {args.budget_ms:g} ms ({millis} ms) but --max-cost changed it")
+                elif budgeted_output.read_text() != plain_output.read_text():
+                    failures.append(f"{name}: fits {args.budget_ms:g} ms but --max-cost changed the shader")
+                continue
+
+            caps = wave_caps(budgeted_output.read_text())
+            if not cap:
+                if budgeted.returncode != 2 or caps:
+                    failures.append(f"{name}: over budget ({millis} ms) without a lowered wave cap or status 2")
+                over += 1
+                continue
+            lowered_cap = int(cap.group(1))
+            # The budget never lowers the cap below the warm-up iterations of the wave loops.
+            warmup = MINIMUM_CAP.search(budgeted_output.read_text())
+            minimum_cap = int(warmup.group(1)) if warmup else 0
+            if not warmup:
+                failures.append(f"{name}: the lowered wave lacks WAVE_MIN_WARMUP_ITERATIONS")
+            if caps != [lowered_cap]:
+                failures.append(f"{name}: shader wave caps {caps}, expected [{lowered_cap}]")
+            if lowered_cap < minimum_cap or lowered_cap >= max(wave_caps(plain_output.read_text()), default=0):
+                failures.append(f"{name}: wave cap lowered to {lowered_cap}")
+            if budgeted.returncode == 0:
+                lowered += 1
+                if budget_millis > args.budget_ms:
+                    failures.append(f"{name}: exit status 0 at {budget_millis} ms over a {args.budget_ms:g} ms budget")
+                # The search keeps the largest cap that fits, so its own cost in ops gives the same cap.
+                ops_output = tmp_path / f"{preset.stem}.ops.frag"
+                in_ops = run([str(args.converter), "--max-cost", budget_fields["weighted cost"], str(preset),
+                              str(ops_output)], allowed=(0, 2))
+                ops_cap = BUDGET_CAP.search(in_ops.stdout)
+                if in_ops.returncode != 0 or not ops_cap or int(ops_cap.group(1)) != lowered_cap:
+                    failures.append(f"{name}: the budget in ops did not give the same cap as {args.budget_ms:g} ms")
+            else:
+                over += 1
+                if lowered_cap != minimum_cap:
+                    failures.append(f"{name}: exit status 2 with wave cap {lowered_cap}, expected {minimum_cap}")
+                if "exceeds --max-cost" not in budgeted.stderr:
+                    failures.append(f"{name}: exit status 2 without a warning")
+
+    if ratios:
+        median = statistics.median(ratios.values())
+        for name, ratio in sorted(ratios.items()):
+            if not median / args.max_ratio <= ratio <= median * args.max_ratio:
+                failures.append(f"{name}: estimate is {ratio / median:.2f}x the median ratio to the measured "
+                                f"llvmpipe cost (allowed {args.max_ratio:g}x)")
+        error = statistics.mean(abs(ratio / median - 1.0) for ratio in ratios.values())
+        if error > args.max_mean_error:
+            failures.append(f"estimates deviate from the measured llvmpipe costs by {error:.0%} on average "
+                            f"(allowed {args.max_mean_error:.0%})")
+    else:
+        failures.append(f"no preset has a measured cost in {args.baseline}")
+
+    if failures:
+        print("Cost budget regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print(f"Validated the cost budget of {len(presets)} presets at {args.budget_ms:g} ms: "
+          f"{fitted} fit, {lowered} fit with a lower wave cap, {over} over budget")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
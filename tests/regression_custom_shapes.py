@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+"""Image regression for custom shapes (shapecode_N / shape_N_init / shape_N_per_frame).
+
+Custom shapes are evaluated by the custom_shape_instances and custom_shape_bins prepasses
+and drawn by the main shader. The checks:
+- baked.milk emits both passes, one instance block per enabled shape and a single draw
+  call placed before the waves;
+- a square lands where its x/y/rad put it, runs from the centre colour to the edge
+  colour and gets its border;
+- instances take their position from per-frame code reading instance, and a user
+  variable carried from one instance to the next is replayed;
+- additive shapes add up where alpha-blended shapes mix;
+- a textured shape samples the previous frame;
+- 4 shapes x 1024 instances keep the per-pixel cost of a single instance and still render.
+"""
+
+from __future__ import annotations
+
+import argparse
+import re
+import struct
+import sys
+import tempfile
+from pathlib import Path
+
+from _converter import Pass, convert, pass_arguments, run
+
+RENDER_SIZE = 128
+LIT_THRESHOLD = 0.02  # Channels above this count as drawn
+
+WEIGHTED_COST = re.compile(r"weighted cost:\s+([0-9.]+)")
+
+HEADER = "[preset00]\nnWaveMode=0\nwave_a=0\ndecay=0\nob_a=0\n"
+
+# MilkDrop y runs top-down. With ang=0 the corners sit at 45 degrees, so rad 0.4 gives a
+# square 0.4 * cos(45) wide in uv.
+SQUARE = (0.3, 0.25, 0.4)
+
+
+def shape_block(index: int, **values: object) -> str:
+    lines = [f"shapecode_{index}_enabled=1"]
+    code = values.pop("per_frame", [])
+    for key, value in values.items():
+        lines.append(f"shapecode_{index}_{key}={value}")
+    for number, statement in enumerate(code, start=1):
+        lines.append(f"shape_{index}_per_frame{number}={statement}")
+    return "\n".join(lines) + "\n"
+
+
+def render(renderer: Path, shader: Path, passes: list[Pass], output: Path,
+           *options: str) -> list[list[tuple[float, ...]]]:
+    """Renders the preset; returns rows of RGB pixels, bottom row first (PFM order)."""
+    command = [str(renderer), "--size", f"{RENDER_SIZE}x{RENDER_SIZE}", *options]
+    run(command + pass_arguments(passes) + [str(shader), str(output)])
+
+    data = output.read_bytes()
+    header, dimensions, _scale, pixels = data.split(b"\n", 3)
+    if header != b"PF":
+        raise RuntimeError(f"{output} is not a colour PFM image")
+    width, height = (int(value) for value in dimensions.split())
+    values = struct.unpack(f"<{width * height * 3}f", pixels[: 12 * width * height])
+    return [[values[(y * width + x) * 3:(y * width + x) * 3 + 3] for x in range(width)] for y in range(height)]
+
+
+def pixel_at(image: list[list[tuple[float, ...]]], x: float, y: float) -> tuple[float, ...]:
+    """Pixel under MilkDrop position (x, y)."""
+    return image[int((1.0 - y) * RENDER_SIZE)][int(x * RENDER_SIZE)]
+
+
+def convert_and_render(converter: Path, renderer: Path, tmp: Path, name: str, preset_text: str,
+                       *options: str) -> tuple[Path, list[Pass], list[list[tuple[float, ...]]]]:
+    preset = tmp / f"{name}.milk"
+    preset.write_text(preset_text)
+    shader = tmp / f"{name}.frag"
+    passes = convert(converter, preset, shader).passes
+    return shader, passes, render(renderer, shader, passes, tmp / f"{name}.pfm", *options)
+
+
+def check_baked(converter: Path, baked: Path, tmp: Path) -> list[str]:
+    failures = []
+    shader = tmp / "baked.frag"
+    passes = convert(converter, baked, shader).passes
+    names = [render_pass.shader.name for render_pass in passes]
+    if names != ["baked.custom_shape_instances.frag", "baked.custom_shape_bins.frag"]:
+        return [f"baked.milk: unexpected passes {names}"]
+    instances = passes[0].shader.read_text()
+    blocks = re.findall(r"// shape_(\d): init code", instances)
+    if blocks != ["0", "1", "2"]:
+        failures.append(f"baked.milk: instance blocks for shapes {blocks}, expected 0, 1 and 2")
+    if "for (int cs_previous" not in instances:
+        failures.append("baked.milk: shape_0 reads k1 and poo2 before assigning them but nothing is replayed")
+    source = shader.read_text()
+    if source.count("custom_shape_draw(composedColor.rgb") != 1:
+        failures.append("baked.milk: expected one custom_shape_draw call")
+    elif source.index("custom_shape_draw(composedColor.rgb") > source.index("// Overlay waveforms."):
+        failures.append("baked.milk: shapes must be drawn before the waves")
+    return failures
+
+
+def check_square(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    failures = []
+    x, y, rad = SQUARE
+    text = HEADER + shape_block(0, sides=4, x=x, y=y, rad=rad, r=1, g=0, b=0, a=1, r2=0, g2=0, b2=1, a2=1,
+                                border_r=0, border_g=1, border_b=0, border_a=1)
+    _shader, passes, image = convert_and_render(converter, renderer, tmp, "square", text)
+    if len(passes) != 2:
+        return [f"square: expected two prepasses, got {len(passes)}"]
+
+    half = 0.5 * rad * 0.70710678
+    filled = [(px, py) for py, row in enumerate(image) for px, pixel in enumerate(row) if pixel[0] + pixel[2] > LIT_THRESHOLD]
+    expected = (2 * half * RENDER_SIZE) ** 2
+    if not 0.85 * expected <= len(filled) <= 1.15 * expected:
+        failures.append(f"square: {len(filled)} filled pixels, expected about {expected:.0f}")
+    if filled:
+        columns = [px for px, _ in filled]
+        rows = [py for _, py in filled]
+        centre = ((min(columns) + max(columns) + 1) / 2 / RENDER_SIZE, 1.0 - (min(rows) + max(rows) + 1) / 2 / RENDER_SIZE)
+        if abs(centre[0] - x) > 2.0 / RENDER_SIZE or abs(centre[1] - y) > 2.0 / RENDER_SIZE:
+            failures.append(f"square: centred at {centre}, expected ({x}, {y})")
+
+    core = pixel_at(image, x, y)
+    if not (core[0] > 0.9 and core[2] < 0.1):
+        failures.append(f"square: centre pixel {core}, expected the red centre colour")
+    rim = pixel_at(image, x + 0.9 * half, y)
+    if not (rim[2] > 0.7 and rim[0] < 0.3):
+        failures.append(f"square: pixel near the edge {rim}, expected mostly the blue edge colour")
+    border = [pixel_at(image, x + half + offset / RENDER_SIZE, y)[1] for offset in (-1, 0, 1)]
+    if max(border) < 0.5:
+        failures.append(f"square: no border around the edge (green {border})")
+    if pixel_at(image, x + half + 4.0 / RENDER_SIZE, y)[1] > LIT_THRESHOLD:
+        failures.append("square: the border reaches past the edge")
+    return failures
+
+
+def check_instances(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    """Five triangles placed by instance, and four squares placed by a carried counter."""
+    failures = []
+    text = HEADER + shape_block(0, sides=3, num_inst=5, rad=0.08, r=1, g=1, b=1, a=1, r2=1, g2=1, b2=1, a2=1,
+                                per_frame=["x = 0.1 + instance * 0.2;", "y = 0.25;"])
+    text += shape_block(1, sides=4, num_inst=4, rad=0.08, r=1, g=0, b=0, a=1, r2=1, g2=0, b2=0, a2=1,
+                        per_frame=["n = n + 1;", "x = 0.1 + n * 0.2;", "y = 0.75;"])
+    _shader, passes, image = convert_and_render(converter, renderer, tmp, "instances", text)
+    instances = passes[0].shader.read_text()
+    if instances.count("for (int cs_previous") != 1:
+        failures.append("instances: only shape 1 carries a variable between instances")
+
+    for instance in range(5):
+        centre = pixel_at(image, 0.1 + instance * 0.2, 0.25)
+        if min(centre) < 0.9:
+            failures.append(f"instances: triangle {instance} missing (centre pixel {centre})")
+    for n in range(1, 5):
+        centre = pixel_at(image, 0.1 + n * 0.2, 0.75)
+        if centre[0] < 0.9 or centre[1] > 0.1:
+            failures.append(f"instances: square {n} missing (centre pixel {centre})")
+    if max(pixel_at(image, 0.1, 0.75)) > LIT_THRESHOLD:
+        failures.append("instances: the carried counter was not advanced for the first instance")
+    return failures
+
+
+def check_blending(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    """Two identical half-transparent red squares: additive reaches 1.0, alpha blending 0.75."""
+    failures = []
+    x, y, rad = SQUARE
+    for additive, expected in ((1, 1.0), (0, 0.75)):
+        text = HEADER
+        for index in (0, 1):
+            text += shape_block(index, sides=4, x=x, y=y, rad=rad, additive=additive,
+                                r=1, g=0, b=0, a=0.5, r2=1, g2=0, b2=0, a2=0.5)
+        _shader, _passes, image = convert_and_render(converter, renderer, tmp, f"blend_{additive}", text)
+        value = pixel_at(image, x, y)[0]
+        if abs(value - expected) > 0.02:
+            failures.append(f"blend additive={additive}: overlapping shapes give {value:.3f}, expected {expected}")
+    return failures
+
+
+def check_textured(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    """The per-pixel code paints r = x; on the second frame a textured shape at x = 0.25
+    shows the previous frame around the screen centre, so its centre has r = 0.5."""
+    failures = []
+    text = HEADER + "per_pixel_1=r = x;\n"
+    for textured in (0, 1):
+        shape = shape_block(0, sides=4, x=0.25, y=0.5, rad=0.3, textured=textured,
+                            r=1, g=1, b=1, a=1, r2=1, g2=1, b2=1, a2=1)
+        _shader, _passes, image = convert_and_render(converter, renderer, tmp, f"textured_{textured}", text + shape,
+                                                     "--frames", "2")
+        centre = pixel_at(image, 0.25, 0.5)
+        if textured and (abs(centre[0] - 0.5) > 0.05 or centre[1] > 0.05):
+            failures.append(f"textured: centre pixel {centre}, expected the previous frame's (0.5, 0, 0)")
+        if not textured and min(centre) < 0.95:
+            failures.append(f"untextured: centre pixel {centre}, expected white")
+    return failures
+
+
+def check_stress(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    """4 x 1024 instances cost the same per pixel as one and still fill the screen."""
+    failures = []
+    costs = {}
+    for instances in (1, 1024):
+        text = HEADER
+        for index in range(4):
+            text += shape_block(index, sides=3 + index, num_inst=instances, rad=0.03, additive=1,
+                                r=0.2, g=0.1, b=0.05, a=1, r2=0.2, g2=0, b2=0, a2=1, border_a=0.5,
+                                per_frame=[f"x = 0.02 + 0.96 * ((instance * 7 + {13 * index}) % 64) / 63;",
+                                           "y = 0.02 + 0.96 * (floor(instance / 16) % 64) / 63;"])
+        preset = tmp / f"stress_{instances}.milk"
+        preset.write_text(text)
+        shader = tmp / f"stress_{instances}.frag"
+        match = WEIGHTED_COST.search(run([str(converter), "--cost-report", str(preset), str(shader)]).stdout)
+        costs[instances] = float(match.group(1)) if match else None
+        if instances == 1024:
+            passes = convert(converter, preset, shader).passes
+            image = render(renderer, shader, passes, tmp / "stress.pfm")
+            lit = sum(1 for row in image for pixel in row if max(pixel) > LIT_THRESHOLD)
+            if lit < 0.3 * RENDER_SIZE * RENDER_SIZE:
+                failures.append(f"stress: only {lit} pixels drawn")
+    if costs[1] is None or costs[1] != costs[1024]:
+        failures.append(f"stress: per-pixel cost {costs[1024]} with 1024 instances, {costs[1]} with one")
+    return failures
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Validate custom shape prepasses and drawing")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--renderer", type=Path, required=True, help="Path to MilkdropRender executable")
+    parser.add_argument("--baked", type=Path, required=True, help="Path to baked.milk, which enables three shapes")
+    args = parser.parse_args(argv)
+
+    failures: list[str] = []
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        failures += check_baked(args.converter, args.baked, tmp_path)
+        failures += check_square(args.converter, args.renderer, tmp_path)
+        failures += check_instances(args.converter, args.renderer, tmp_path)
+        failures += check_blending(args.converter, args.renderer, tmp_path)
+        failures += check_textured(args.converter, args.renderer, tmp_path)
+        failures += check_stress(args.converter, args.renderer, tmp_path)
+
+    if failures:
+        print("Custom shape regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print("Validated custom shapes (baked.milk, geometry, colours, border, instances, blending, texture, 4x1024 stress)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+"""Image regression for custom waveforms (wavecode_N / wave_N_per_frame / wave_N_per_point).
+
+Custom waves are evaluated by the custom_wave_points and custom_wave_bounds prepasses and
+drawn by the main shader. The checks:
+- eos.milk emits both passes and draws its wave (the image differs from the same preset
+  with the wave disabled); its point-to-point flip state is replayed, and only the
+  statements flip depends on are;
+- a synthetic horizontal line lands on the expected screen row and spans the expected
+  columns, with its height taken from a t variable set by the wave's per-frame code;
+- bDrawThick doubles the line's coverage, bUseDots draws separate dots, bAdditive adds
+  overlapping waves where alpha blending mixes them (a dense strip still blends each
+  pixel once), and bSpectrum evaluates 512 points;
+- with --audio-texture the points pass reads value1/value2 from iAudioTexture.
+"""
+
+from __future__ import annotations
+
+import argparse
+import re
+import struct
+import sys
+import tempfile
+from pathlib import Path
+
+from _converter import Pass, convert, pass_arguments, run
+
+RENDER_SIZE = 128
+LIT_THRESHOLD = 0.02      # Channels above this count as drawn
+MIN_CHANGED = 0.005       # Share of channels the eos custom wave must change
+LINE_Y = 31.5 / RENDER_SIZE  # MilkDrop y (top-down) of the synthetic line, on a pixel centre
+LINE_X = (0.1, 0.9)       # MilkDrop x range of the synthetic line
+
+DRAW_CALL = re.compile(r"custom_wave_draw\(composedColor\.rgb, [^,]+, (\d), (\d+), (true|false), (true|false), (true|false)\)")
+
+LINE_PRESET = """[preset00]
+nWaveMode=0
+wave_a=0
+decay=0
+ob_a=0
+wavecode_{index}_enabled=1
+wavecode_{index}_samples={samples}
+wavecode_{index}_bSpectrum={spectrum}
+wavecode_{index}_bUseDots={dots}
+wavecode_{index}_bDrawThick={thick}
+wavecode_{index}_bAdditive={additive}
+wavecode_{index}_r=1
+wavecode_{index}_g=0
+wavecode_{index}_b=0
+wavecode_{index}_a={alpha}
+wave_{index}_per_frame1=t1={y};
+wave_{index}_per_point1=x={x0}+{span}*sample;
+wave_{index}_per_point2=y=t1;
+"""
+
+
+def render(renderer: Path, shader: Path, passes: list[Pass], output: Path,
+           *options: str) -> list[list[tuple[float, ...]]]:
+    """Renders one frame; returns rows of RGB pixels, bottom row first (PFM order)."""
+    command = [str(renderer), "--size", f"{RENDER_SIZE}x{RENDER_SIZE}", *options]
+    run(command + pass_arguments(passes) + [str(shader), str(output)])
+
+    data = output.read_bytes()
+    header, dimensions, _scale, pixels = data.split(b"\n", 3)
+    if header != b"PF":
+        raise RuntimeError(f"{output} is not a colour PFM image")
+    width, height = (int(value) for value in dimensions.split())
+    values = struct.unpack(f"<{width * height * 3}f", pixels[: 12 * width * height])
+    return [[values[(y * width + x) * 3:(y * width + x) * 3 + 3] for x in range(width)] for y in range(height)]
+
+
+def lit_pixels(image: list[list[tuple[float, ...]]]) -> list[tuple[int, int]]:
+    return [(x, y) for y, row in enumerate(image) for x, pixel in enumerate(row) if max(pixel) > LIT_THRESHOLD]
+
+
+def line_preset(path: Path, index: int = 0, samples: int = 512, spectrum: int = 0, dots: int = 0, thick: int = 0,
+                additive: int = 0, alpha: float = 1.0, extra: str = "") -> Path:
+    path.write_text(LINE_PRESET.format(index=index, samples=samples, spectrum=spectrum, dots=dots, thick=thick,
+                                       additive=additive, alpha=alpha, y=LINE_Y, x0=LINE_X[0],
+                                       span=LINE_X[1] - LINE_X[0]) + extra)
+    return path
+
+
+def check_eos(converter: Path, renderer: Path, eos: Path, tmp: Path) -> list[str]:
+    failures = []
+    shader = tmp / "eos.frag"
+    passes = convert(converter, eos, shader).passes
+    names = {render_pass.name: render_pass for render_pass in passes}
+    for name, size in (("custom_wave_points", "512x8"), ("custom_wave_bounds", "32x4")):
+        if name not in names or names[name].size != size:
+            failures.append(f"eos: missing {name} pass of {size} (got {sorted(names)})")
+    if failures:
+        return failures
+
+    calls = DRAW_CALL.findall(shader.read_text())
+    if calls != [("0", "480", "false", "true", "true")]:
+        failures.append(f"eos: unexpected custom_wave_draw calls {calls}")
+
+    points = names["custom_wave_points"].shader.read_text()
+    replay = re.search(r"for \(int cw_point = 0; cw_point < cw_index; \+\+cw_point\) \{(.*?)\n        \}", points, re.DOTALL)
+    if not replay:
+        failures.append("eos: flip = flip + 1 carries state between points but no replay loop was emitted")
+    elif "flip" not in replay.group(1) or "scale1" in replay.group(1):
+        failures.append("eos: the replay loop does not hold exactly the statements flip depends on")
+
+    disabled = tmp / "eos_disabled.milk"
+    disabled.write_text(eos.read_text().replace("wavecode_0_enabled=1", "wavecode_0_enabled=0"))
+    off_shader = tmp / "eos_disabled.frag"
+    off_passes = convert(converter, disabled, off_shader).passes
+    if off_passes or "custom_wave_draw" in off_shader.read_text():
+        failures.append("eos: a disabled custom wave still emits passes or draw calls")
+
+    on = render(renderer, shader, passes, tmp / "eos.pfm")
+    off = render(renderer, off_shader, off_passes, tmp / "eos_disabled.pfm")
+    channels = [(a, b) for row_a, row_b in zip(on, off) for pa, pb in zip(row_a, row_b) for a, b in zip(pa, pb)]
+    changed = sum(1 for a, b in channels if abs(a - b) > LIT_THRESHOLD) / len(channels)
+    if changed < MIN_CHANGED:
+        failures.append(f"eos: the custom wave changes only {changed:.3%} of the channels")
+    return failures
+
+
+def check_line(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    failures = []
+    results = {}
+    coverage = {}
+    for label, options in (("thin", {}), ("thick", {"thick": 1}), ("dots", {"dots": 1, "samples": 24})):
+        preset = line_preset(tmp / f"line_{label}.milk", **options)
+        shader = tmp / f"line_{label}.frag"
+        passes = convert(converter, preset, shader).passes
+        if "for (int cw_point" in passes[0].shader.read_text():
+            failures.append(f"line {label}: independent points should not be replayed")
+        image = render(renderer, shader, passes, tmp / f"line_{label}.pfm")
+        results[label] = lit_pixels(image)
+        coverage[label] = sum(pixel[0] for row in image for pixel in row)
+
+    thin = results["thin"]
+    if not thin:
+        return failures + ["line: nothing was drawn"]
+    # MilkDrop y runs top-down; PFM rows run bottom-up.
+    expected_row = (1.0 - LINE_Y) * RENDER_SIZE - 0.5
+    rows = {y for _, y in thin}
+    if any(abs(y - expected_row) > 1.5 for y in rows):
+        failures.append(f"line: lit rows {sorted(rows)} are not at row {expected_row:.1f}")
+    columns = {x for x, _ in thin}
+    expected_columns = (LINE_X[1] - LINE_X[0]) * RENDER_SIZE
+    if not 0.9 * expected_columns <= len(columns) <= expected_columns + 3:
+        failures.append(f"line: {len(columns)} lit columns, expected about {expected_columns:.0f}")
+    if min(columns) < LINE_X[0] * RENDER_SIZE - 2 or max(columns) > LINE_X[1] * RENDER_SIZE + 2:
+        failures.append(f"line: columns {min(columns)}..{max(columns)} exceed the line's x range")
+
+    if not coverage["thick"] > 1.5 * coverage["thin"]:
+        failures.append(f"line: bDrawThick covers {coverage['thick']:.1f}, thin {coverage['thin']:.1f}")
+    dot_columns = {x for x, _ in results["dots"]}
+    if not results["dots"] or len(dot_columns) > 0.6 * len(columns):
+        failures.append(f"line: bUseDots lit {len(dot_columns)} columns, expected separate dots")
+    return failures
+
+
+def check_blending(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    """Two identical half-transparent red waves: additive reaches 1.0, alpha blending 0.75."""
+    failures = []
+    for additive, expected in ((1, 1.0), (0, 0.75)):
+        first = LINE_PRESET.format(index=0, samples=512, spectrum=0, dots=0, thick=0, additive=additive, alpha=0.5,
+                                   y=LINE_Y, x0=LINE_X[0], span=LINE_X[1] - LINE_X[0])
+        second = line_preset(tmp / "second.milk", index=1, additive=additive, alpha=0.5).read_text()
+        preset = tmp / f"blend_{additive}.milk"
+        preset.write_text(first + "\n".join(second.splitlines()[5:]) + "\n")
+        shader = tmp / f"blend_{additive}.frag"
+        passes = convert(converter, preset, shader).passes
+        if len(DRAW_CALL.findall(shader.read_text())) != 2:
+            failures.append(f"blend additive={additive}: expected two custom_wave_draw calls")
+            continue
+        image = render(renderer, shader, passes, tmp / f"blend_{additive}.pfm")
+        row = image[int((1.0 - LINE_Y) * RENDER_SIZE)]
+        peak = max(pixel[0] for pixel in row[RENDER_SIZE // 4:3 * RENDER_SIZE // 4])
+        if abs(peak - expected) > 0.05:
+            failures.append(f"blend additive={additive}: overlapping waves peak at {peak:.3f}, expected {expected}")
+    return failures
+
+
+def check_spectrum(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    preset = line_preset(tmp / "spectrum.milk", spectrum=1)
+    shader = tmp / "spectrum.frag"
+    passes = convert(converter, preset, shader).passes
+    calls = DRAW_CALL.findall(shader.read_text())
+    if calls != [("0", "512", "false", "false", "false")]:
+        return [f"spectrum: unexpected custom_wave_draw calls {calls}"]
+    if not lit_pixels(render(renderer, shader, passes, tmp / "spectrum.pfm")):
+        return ["spectrum: nothing was drawn"]
+    return []
+
+
+def check_audio_texture(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    """With --audio-texture, a wave that keeps y = 0.5 + value2 follows the streamed signal."""
+    preset = tmp / "audio.milk"
+    preset.write_text("\n".join(line for line in LINE_PRESET.format(
+        index=0, samples=512, spectrum=0, dots=0, thick=0, additive=0, alpha=1.0, y=LINE_Y, x0=LINE_X[0],
+        span=LINE_X[1] - LINE_X[0]).splitlines() if "y=t1" not in line) + "\n")
+    shader = tmp / "audio.frag"
+    passes = convert(converter, preset, shader, "--audio-texture").passes
+    if "uniform sampler2D iAudioTexture;" not in passes[0].shader.read_text():
+        return ["audio: the custom_wave_points pass does not declare iAudioTexture"]
+    rows = {y for _, y in lit_pixels(render(renderer, shader, passes, tmp / "audio.pfm", "--audio-signal"))}
+    if len(rows) < 4:
+        return [f"audio: the wave covers {len(rows)} rows; value2 does not follow the audio texture"]
+    return []
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Validate custom waveform prepasses and drawing")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--renderer", type=Path, required=True, help="Path to MilkdropRender executable")
+    parser.add_argument("--fixtures", type=Path, required=True, help="Directory of .milk fixtures")
+    args = parser.parse_args(argv)
+
+    failures: list[str] = []
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        failures += check_eos(args.converter, args.renderer, args.fixtures / "eos.milk", tmp_path)
+        failures += check_line(args.converter, args.renderer, tmp_path)
+        failures += check_blending(args.converter, args.renderer, tmp_path)
+        failures += check_spectrum(args.converter, args.renderer, tmp_path)
+        failures += check_audio_texture(args.converter, args.renderer, tmp_path)
+
+    if failures:
+        print("Custom wave regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print("Validated custom waves (eos.milk, line geometry, thick, dots, additive, spectrum, audio texture)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+"""Execution benchmark for converted GLSL on Mesa llvmpipe.
+
+Each preset is converted with --pass-graph and its passes, main shader and composite shader
+are run for a number of frames through MilkdropRender on a surfaceless EGL context, with
+iTime, iResolution, iAudioBands and the iChannel0 feedback ping-pong fed every frame.
+llvmpipe needs no GPU, so the numbers are comparable on every build machine. For each preset
+the script reports:
+- compile_ms: glCompileShader/glLinkProgram time for every program of the preset;
+- jit_ms: the extra time of the first frame, when llvmpipe compiles the shaders to machine
+  code (it defers that to the first draw);
+- frame_ms: the average of the later frames;
+- cost: frame_ms divided by the frame time of a shader that only copies and decays
+  iChannel0, so the cost is a ratio that carries over between machines.
+The shader cache is disabled (MESA_SHADER_CACHE_DISABLE) so every run compiles from scratch.
+Each preset is measured --repeats times, each run right after a run of the calibration shader
+that it is normalized to, so a machine that slows down during the benchmark slows both. The
+costs are the medians over the runs, the times the fastest.
+
+With --baseline, presets whose cost (or compile time relative to the calibration shader)
+grew beyond the tolerance fail the run; --update-baseline rewrites the baseline instead. A
+cost only fails once it also grew by more than --floor-ms of frame time, since the cheapest
+presets take a millisecond or two and a relative tolerance alone is within their noise.
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import os
+import re
+import statistics
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+METRIC = re.compile(r"^(renderer|compile_ms|first_frame_ms|frame_ms): (.+)$")
+
+# Copies the previous frame with a decay, the cheapest shader a converted preset can be.
+CALIBRATION_SHADER = """#version 330 core
+
+out vec4 FragColor;
+
+uniform vec2 iResolution;
+uniform sampler2D iChannel0;
+
+void main() {
+    vec2 uv = gl_FragCoord.xy / iResolution.xy;
+    FragColor = vec4(texture(iChannel0, uv).rgb * 0.98, 1.0);
+}
+"""
+
+
+def run(command: list[str], env: dict[str, str] | None = None) -> subprocess.CompletedProcess:
+    result = subprocess.run(command, text=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE, env=env)
+    if result.returncode != 0:
+        raise RuntimeError(
+            f"{' '.join(command)} exited with status {result.returncode}\n"
+            f"stdout:\n{result.stdout}\n"
+            f"stderr:\n{result.stderr}"
+        )
+    return result
+
+
+def renderer_arguments(manifest: dict) -> tuple[list[str], str]:
+    """MilkdropRender arguments for the prepasses and composite of a --pass-graph manifest,
+    and the main shader."""
+    arguments = []
+    main = None
+    for entry in manifest["passes"]:
+        if entry["name"] == "main":
+            main = entry["shader"]
+            continue
+        if main is not None:
+            arguments += ["--composite", entry["shader"]]
+            continue
+        size = next(resource["size"] for resource in manifest["resources"] if resource["name"] == entry["output"])
+        extent = f"/{size['divisor']}" if "divisor" in size else f"{size['width']}x{size['height']}"
+        arguments += ["--pass", entry["output"], entry["shader"], extent]
+    if main is None:
+        raise RuntimeError("pass graph has no main pass")
+    return arguments, main
+
+
+def render(renderer: Path, arguments: list[str], shader: str, options: argparse.Namespace,
+           env: dict[str, str]) -> dict:
+    """One MilkdropRender run."""
+    stdout = run([str(renderer), "--size", options.size, "--frames", str(options.frames), "--time", "0",
+                  *arguments, shader], env).stdout
+    values = {}
+    for line in stdout.splitlines():
+        match = METRIC.match(line)
+        if match:
+            values[match.group(1)] = match.group(2)
+    return {
+        "renderer": values["renderer"],
+        "compile_ms": float(values["compile_ms"]),
+        "jit_ms": max(0.0, float(values["first_frame_ms"]) - float(values["frame_ms"])),
+        "frame_ms": float(values["frame_ms"]),
+    }
+
+
+def keep_fastest(best: dict, sample: dict) -> dict:
+    if not best:
+        return dict(sample)
+    for key in ("compile_ms", "jit_ms", "frame_ms"):
+        best[key] = min(best[key], sample[key])
+    return best
+
+
+def measure(renderer: Path, arguments: list[str], shader: str, calibration_shader: str,
+            options: argparse.Namespace, env: dict[str, str]) -> tuple[dict, dict]:
+    """--repeats runs of @p shader, each normalized to a calibration run just before it, and the
+    calibration runs. Times are the fastest of their own, costs the median of the runs' ratios:
+    the lowest ratio would pick the run whose calibration happened to be disturbed."""
+    best: dict = {}
+    calibration: dict = {}
+    costs = []
+    compile_costs = []
+    for _ in range(options.repeats):
+        reference = render(renderer, [], calibration_shader, options, env)
+        sample = render(renderer, arguments, shader, options, env)
+        costs.append(sample["frame_ms"] / reference["frame_ms"])
+        compile_costs.append((sample["compile_ms"] + sample["jit_ms"]) / max(
+            1e-3, reference["compile_ms"] + reference["jit_ms"]))
+        best = keep_fastest(best, sample)
+        calibration = keep_fastest(calibration, reference)
+    best["cost"] = statistics.median(costs)
+    best["compile_cost"] = statistics.median(compile_costs)
+    return best, calibration
+
+
+def collect_presets(paths: list[Path]) -> list[Path]:
+    presets = []
+    for path in paths:
+        presets += sorted(path.glob("*.milk")) if path.is_dir() else [path]
+    return presets
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Benchmark converted GLSL on Mesa llvmpipe")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--renderer", type=Path, required=True, help="Path to MilkdropRender executable")
+    parser.add_argument("--presets", type=Path, nargs="+", required=True, help=".milk files or directories of them")
+    parser.add_argument("--size", default="256x256", help="Render size (default 256x256)")
+    parser.add_argument("--frames", type=int, default=20, help="Frames per run, the first one excluded from frame_ms")
+    parser.add_argument("--repeats", type=int, default=3, help="Runs per preset; the fastest is kept")
+    parser.add_argument("--lp-threads", type=int, default=1, help="llvmpipe rasterizer threads (LP_NUM_THREADS)")
+    parser.add_argument("--baseline", type=Path, help="Baseline JSON to compare against")
+    parser.add_argument("--update-baseline", action="store_true", help="Write the measured costs to --baseline")
+    parser.add_argument("--tolerance", type=float, default=0.5, help="Allowed growth of the frame cost (0.5 = +50%%)")
+    parser.add_argument("--floor-ms", type=float, default=1.0,
+                        help="Frame time a preset may always grow by, whatever --tolerance allows (default 1.0)")
+    parser.add_argument("--compile-tolerance", type=float, default=1.0,
+                        help="Allowed growth of the relative compile + JIT time (1.0 = +100%%)")
+    parser.add_argument("--json", type=Path, help="Write the measurements to this file")
+    args = parser.parse_args(argv)
+    if args.update_baseline and args.baseline is None:
+        parser.error("--update-baseline needs --baseline")
+    if args.frames < 2:
+        parser.error("--frames must be at least 2")
+
+    env = dict(os.environ)
+    env["MESA_SHADER_CACHE_DISABLE"] = "true"
+    env["LP_NUM_THREADS"] = str(args.lp_threads)
+    env.setdefault("LIBGL_ALWAYS_SOFTWARE", "1")
+    env.setdefault("GALLIUM_DRIVER", "llvmpipe")
+    settings = {"size": args.size, "frames": args.frames, "lp_threads": args.lp_threads}
+
+    results: dict[str, dict] = {}
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        calibration_shader = tmp_path / "calibration.frag"
+        calibration_shader.write_text(CALIBRATION_SHADER)
+        calibration: dict = {}
+
+        for preset in collect_presets(args.presets):
+            shader = tmp_path / f"{preset.stem}.frag"
+            manifest = tmp_path / f"{preset.stem}.json"
+            run([str(args.converter), "--pass-graph", str(manifest), str(preset), str(shader)])
+            graph = json.loads(manifest.read_text())
+            arguments, main_shader = renderer_arguments(graph)
+            sample, reference = measure(args.renderer, arguments, main_shader, str(calibration_shader), args, env)
+            del sample["renderer"]
+            sample["passes"] = len(graph["passes"])
+            sample["calibration_ms"] = reference["frame_ms"]
+            results[preset.name] = sample
+            calibration = keep_fastest(calibration, reference)
+
+    if "llvmpipe" not in calibration["renderer"]:
+        print(f"Warning: rendering on {calibration['renderer']}, not llvmpipe; costs may not match the baseline")
+    print(f"renderer: {calibration['renderer']} ({args.size}, {args.frames} frames, LP_NUM_THREADS={args.lp_threads})")
+    print(f"calibration: {calibration['frame_ms']:.3f} ms/frame, compile {calibration['compile_ms']:.2f} ms "
+          f"+ jit {calibration['jit_ms']:.2f} ms")
+
+    baseline = {}
+    if args.baseline is not None and not args.update_baseline:
+        stored = json.loads(args.baseline.read_text())
+        if stored.get("settings") != settings:
+            raise SystemExit(f"Baseline settings {stored.get('settings')} do not match this run's {settings}")
+        baseline = stored["presets"]
+
+    failures = []
+    print(f"{'preset':32s} {'passes':>6s} {'compile':>9s} {'jit':>9s} {'frame':>9s} {'cost':>7s} {'baseline':>9s}")
+    for name, sample in results.items():
+        expected = baseline.get(name)
+        status = ""
+        if baseline and expected is None:
+            status = "new"
+        elif expected is not None:
+            limit = max(expected["cost"] * (1.0 + args.tolerance),
+                        expected["cost"] + args.floor_ms / sample["calibration_ms"])
+            compile_limit = expected["compile_cost"] * (1.0 + args.compile_tolerance)
+            if sample["cost"] > limit:
+                status = "SLOWER"
+                failures.append(f"{name}: frame cost {sample['cost']:.2f} exceeds {expected['cost']:.2f} "
+                                f"+{args.tolerance:.0%} and +{args.floor_ms:g} ms ({sample['frame_ms']:.3f} ms/frame)")
+            if sample["compile_cost"] > compile_limit:
+                status = "SLOWER" if not status else status
+                failures.append(f"{name}: compile cost {sample['compile_cost']:.2f} exceeds "
+                                f"{expected['compile_cost']:.2f} +{args.compile_tolerance:.0%}")
+        stored_cost = f"{expected['cost']:.2f}" if expected else ""
+        print(f"{name:32s} {sample['passes']:6d} {sample['compile_ms']:7.2f}ms {sample['jit_ms']:7.2f}ms "
+              f"{sample['frame_ms']:7.3f}ms {sample['cost']:7.2f} {stored_cost:>9s} {status}")
+    for name in sorted(set(baseline) - set(results)):
+        print(f"{name:32s} (in the baseline, not measured)")
+
+    report = {
+        "settings": settings,
+        "renderer": calibration["renderer"],
+        "calibration": {key: calibration[key] for key in ("compile_ms", "jit_ms", "frame_ms")},
+        "presets": results,
+    }
+    if args.json is not None:
+        args.json.write_text(json.dumps(report, indent=2) + "\n")
+    if args.update_baseline:
+        stored = {
+            "description": "Relative llvmpipe cost of converted presets for tests/regression_glsl_perf.py. cost is "
+                           "ms/frame over the ms/frame of a shader that copies iChannel0; compile_cost is compile + "
+                           "first-draw JIT time over the calibration shader's. Regenerate with --update-baseline and "
+                           "justify increases in the commit message.",
+            "settings": settings,
+            "presets": {name: {"cost": round(sample["cost"], 2), "compile_cost": round(sample["compile_cost"], 2)}
+                        for name, sample in results.items()},
+        }
+        args.baseline.write_text(json.dumps(stored, indent=2) + "\n")
+        print(f"Wrote baseline for {len(results)} presets to {args.baseline}")
+        return 0
+
+    if failures:
+        print("GLSL performance regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print(f"Validated llvmpipe cost of {len(results)} presets" + (" against the baseline" if baseline else ""))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+"""Image regression for the motion vector grid (mv_* settings).
+
+Motion vectors are evaluated per grid point by the motion_vectors prepass and drawn by the
+main shader onto the previous frame. The checks:
+- che.milk (mv_a=1) emits the 64x48 pass and draws between the feedback fetch and the
+  decay, while presets with mv_a=0 and no per-frame mv_a get neither;
+- with a pure translation (dx) every grid point gets a line exactly as long as the
+  displacement times mv_l, in the mv colour, and nothing is drawn between the points;
+- mv_dx / mv_dy shift the grid, fractional mv_x stretches its spacing, and vectors
+  pointing left are found from the right-hand corners of the cell;
+- mv_a set only by per-frame code still enables the grid;
+- a 64x48 grid costs the same per pixel as a 4x3 one and still draws every point.
+"""
+
+from __future__ import annotations
+
+import argparse
+import re
+import struct
+import sys
+import tempfile
+from pathlib import Path
+
+from _converter import Pass, convert, pass_arguments, run
+
+RENDER_SIZE = 128
+LIT_THRESHOLD = 0.2  # Red above this counts as drawn
+
+WEIGHTED_COST = re.compile(r"weighted cost:\s+([0-9.]+)")
+
+# Black screen, no wave or border; the previous frame is kept as is apart from the vectors.
+HEADER = "[preset00]\nnWaveMode=0\nwave_a=0\ndecay=1\na=0\nob_a=0\nib_a=0\nmv_r=1\nmv_g=0\nmv_b=0\n"
+
+
+def render(renderer: Path, shader: Path, passes: list[Pass], output: Path) -> list[list[tuple[float, ...]]]:
+    """Renders one frame; returns rows of RGB pixels, bottom row first (PFM order)."""
+    command = [str(renderer), "--size", f"{RENDER_SIZE}x{RENDER_SIZE}"]
+    run(command + pass_arguments(passes) + [str(shader), str(output)])
+
+    data = output.read_bytes()
+    header, dimensions, _scale, pixels = data.split(b"\n", 3)
+    if header != b"PF":
+        raise RuntimeError(f"{output} is not a colour PFM image")
+    width, height = (int(value) for value in dimensions.split())
+    values = struct.unpack(f"<{width * height * 3}f", pixels[: 12 * width * height])
+    return [[values[(y * width + x) * 3:(y * width + x) * 3 + 3] for x in range(width)] for y in range(height)]
+
+
+def line_red(image: list[list[tuple[float, ...]]], u: float, v: float) -> float:
+    """Red of a horizontal 1 px line at height v, summed over the two pixel rows it is
+    smoothed across."""
+    row = int(v * RENDER_SIZE - 0.5)
+    column = min(RENDER_SIZE - 1, int(u * RENDER_SIZE))
+    return sum(image[index][column][0] for index in (row, row + 1) if 0 <= index < RENDER_SIZE)
+
+
+def grid_points(mv_x: float, mv_y: float, mv_dx: float = 0.0, mv_dy: float = 0.0) -> list[tuple[float, float]]:
+    """Start points MotionVectors::Draw() uses, in uv with y up."""
+    columns, rows = min(int(mv_x), 64), min(int(mv_y), 48)
+    divert_x = 0.0 if int(mv_x) > 64 else mv_x - int(mv_x)
+    divert_y = 0.0 if int(mv_y) > 48 else mv_y - int(mv_y)
+    points = []
+    for row in range(rows):
+        y = (row + 0.25) / (rows + divert_y + 0.25 - 1.0) - mv_dy
+        if not 0.0001 < y < 0.9999:
+            continue
+        for column in range(columns):
+            x = (column + 0.25) / (columns + divert_x + 0.25 - 1.0) + mv_dx
+            if 0.0001 < x < 0.9999:
+                points.append((x, 1.0 - y))
+    return points
+
+
+def convert_and_render(converter: Path, renderer: Path, tmp: Path, name: str,
+                       preset_text: str) -> tuple[Path, list[Pass], list[list[tuple[float, ...]]]]:
+    preset = tmp / f"{name}.milk"
+    preset.write_text(preset_text)
+    shader = tmp / f"{name}.frag"
+    passes = convert(converter, preset, shader).passes
+    return shader, passes, render(renderer, shader, passes, tmp / f"{name}.pfm")
+
+
+def check_lines(image: list[list[tuple[float, ...]]], points: list[tuple[float, float]], dx: float,
+                trail: float, label: str) -> list[str]:
+    """Each vector runs from g to g + trail on the previous frame. The pixel at q samples it
+    at q + dx, so in the output the vector of g spans g.x - dx to g.x - dx + trail."""
+    failures = []
+    missing = [point for point in points if line_red(image, point[0] - dx + 0.5 * trail, point[1]) < 0.8]
+    if missing:
+        failures.append(f"{label}: {len(missing)} of {len(points)} vectors missing, first at {missing[0]}")
+    ends = sorted((-dx, trail - dx))
+    stray = [point for point in points
+             if line_red(image, point[0] + ends[0] - 3.0 / RENDER_SIZE, point[1]) > LIT_THRESHOLD
+             or line_red(image, point[0] + ends[1] + 3.0 / RENDER_SIZE, point[1]) > LIT_THRESHOLD]
+    if stray:
+        failures.append(f"{label}: {len(stray)} vectors longer than the displacement, first at {stray[0]}")
+    lit = sum(1 for row in image for pixel in row if pixel[0] > LIT_THRESHOLD)
+    expected = 2 * len(points) * (abs(trail) * RENDER_SIZE + 1.0)
+    if lit > 2.5 * expected:
+        failures.append(f"{label}: {lit} red pixels for about {expected:.0f} on the lines")
+    return failures
+
+
+def check_fixtures(converter: Path, fixtures: Path, tmp: Path) -> list[str]:
+    failures = []
+    shader = tmp / "che.frag"
+    passes = convert(converter, fixtures / "che.milk", shader).passes
+    names = [render_pass.shader.name for render_pass in passes]
+    if names[:1] != ["che.motion_vectors.frag"] or passes[0].size != "64x48":
+        return [f"che.milk: expected a 64x48 motion_vectors pass first, got {names}"]
+    source = shader.read_text()
+    draw = source.find("motion_vector_draw(sampleUV")
+    if source.count("motion_vector_draw(sampleUV") != 1 or not source.index("texture(iChannel0, sampleUV)") < draw < source.index("feedback.rgb *= decayFactor"):
+        failures.append("che.milk: the vectors must be drawn once, onto the fetched feedback before the decay")
+    if "for (" in source[source.index("float motion_vector_coverage"):source.index("float motion_vector_draw")]:
+        failures.append("che.milk: motion_vector_coverage must not loop")
+
+    for preset in ("eos.milk", "wave_mode_0.milk"):
+        shader = tmp / preset.replace(".milk", ".frag")
+        names = [render_pass.shader.name for render_pass in convert(converter, fixtures / preset, shader).passes]
+        if any("motion_vectors" in name for name in names) or "iMotionVectors" in shader.read_text():
+            failures.append(f"{preset}: mv_a is 0, so no motion vectors should be emitted")
+    return failures
+
+
+def check_translation(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    failures = []
+    text = HEADER + "dx=0.03\nmv_a=1\nmv_x=8\nmv_y=6\nmv_l=1\n"
+    _shader, passes, image = convert_and_render(converter, renderer, tmp, "translate", text)
+    if len(passes) != 1:
+        return [f"translate: expected one prepass, got {len(passes)}"]
+    failures += check_lines(image, grid_points(8, 6), 0.03, 0.03, "translate")
+
+    # Halving mv_l halves the lines, which keep their start.
+    _shader, _passes, image = convert_and_render(converter, renderer, tmp, "half", text.replace("mv_l=1", "mv_l=0.5"))
+    failures += check_lines(image, grid_points(8, 6), 0.03, 0.015, "mv_l=0.5")
+
+    # Shifted grid with a fractional column count, and vectors pointing left.
+    shifted = text.replace("mv_x=8", "mv_x=6.5").replace("dx=0.03", "dx=-0.03") + "mv_dx=0.02\nmv_dy=-0.03\n"
+    _shader, _passes, image = convert_and_render(converter, renderer, tmp, "shifted", shifted)
+    failures += check_lines(image, grid_points(6.5, 6, 0.02, -0.03), -0.03, -0.03, "shifted")
+
+    # mv_a only set per frame.
+    per_frame = HEADER + "dx=0.03\nmv_a=0\nmv_x=8\nmv_y=6\nmv_l=1\nper_frame_1=mv_a = 1;\n"
+    _shader, passes, image = convert_and_render(converter, renderer, tmp, "per_frame", per_frame)
+    if len(passes) != 1:
+        failures.append("per_frame: mv_a assigned per frame should enable the motion vectors")
+    else:
+        failures += check_lines(image, grid_points(8, 6), 0.03, 0.03, "per_frame")
+    return failures
+
+
+def check_dense(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    """The per-pixel cost is the same for 4x3 and 64x48 grids, and the dense grid renders."""
+    failures = []
+    costs = {}
+    for columns, rows in ((4, 3), (64, 48)):
+        preset = tmp / f"grid_{columns}.milk"
+        preset.write_text(HEADER + f"dx=0.004\nmv_a=1\nmv_x={columns}\nmv_y={rows}\nmv_l=1\n")
+        shader = tmp / f"grid_{columns}.frag"
+        match = WEIGHTED_COST.search(run([str(converter), "--cost-report", str(preset), str(shader)]).stdout)
+        costs[columns] = float(match.group(1)) if match else None
+        if columns == 64:
+            image = render(renderer, shader, convert(converter, preset, shader).passes, tmp / "dense.pfm")
+            # Points are about 2 px apart; sample every fourth one.
+            missing = [point for point in grid_points(columns, rows)[::4] if line_red(image, point[0], point[1]) < 0.5]
+            if missing:
+                failures.append(f"dense: {len(missing)} sampled grid points not drawn, first at {missing[0]}")
+    if costs[4] is None or costs[4] != costs[64]:
+        failures.append(f"dense: per-pixel cost {costs[64]} for 64x48, {costs[4]} for 4x3")
+    return failures
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Validate the motion vector prepass and drawing")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--renderer", type=Path, required=True, help="Path to MilkdropRender executable")
+    parser.add_argument("--fixtures", type=Path, required=True, help="Directory of .milk fixtures")
+    args = parser.parse_args(argv)
+
+    failures: list[str] = []
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        failures += check_fixtures(args.converter, args.fixtures, tmp_path)
+        failures += check_translation(args.converter, args.renderer, tmp_path)
+        failures += check_dense(args.converter, args.renderer, tmp_path)
+
+    if failures:
+        print("Motion vector regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print("Validated motion vectors (che.milk, line length and colour, grid offsets, per-frame mv_a, 64x48 cost)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,231 @@
+#!/usr/bin/env python3
+"""Regression checks for the MilkdropPackIndex analyzer and feature index.
+
+The fixtures are copied into a pack with a nested directory, an upper-case extension, a
+synthetic preset that uses custom shapes, loop() and megabuf, and a binary file that does
+not parse. The test then checks that:
+- every .milk file is indexed, sorted by relative path, and the binary one has parsed = 0;
+- the index bytes do not depend on the thread count;
+- the .mdpx layout decodes as documented in PackIndex.hpp and known features are right;
+- queries return exactly the rows a Python filter over the decoded columns returns;
+- malformed queries and unknown columns fail with a message.
+"""
+
+from __future__ import annotations
+
+import argparse
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+SYNTHETIC_PRESET = """[preset00]
+fRating=4.5
+nWaveMode=8
+shapecode_0_enabled=1
+shapecode_0_sides=5
+shapecode_1_enabled=1
+shape_1_per_frame1=x = 0.5 + 0.1*sin(time);
+per_frame_1=zoom = 1.01;
+per_frame_2=loop(4, megabuf(0) = megabuf(0) + 1);
+per_pixel_1=rot = rot + 0.01*rad;
+"""
+
+QUERIES = [
+    "",
+    "wave_mode = 8 and custom_shapes = 0 and cost < 27000",
+    "wave_mode = 8 && custom_shapes > 0",
+    "not wave_supported",
+    "uses_loop and uses_megabuf",
+    "motion_vectors",
+    "not parsed",
+    "cost >= 20000 and cost <= 25000",
+    "warp_shader = 1 and comp_shader != 0",
+    "rating > 2",
+]
+
+BAD_QUERIES = {
+    "wave_mode =": "Expected a number",
+    "bogus = 1": "Unknown column",
+    "path = 1": "not a numeric column",
+    "wave_mode = 8 or cost < 1": "Expected \"and\"",
+    "wave_mode = eight": "Expected a number",
+}
+
+OPERATORS = {
+    "=": lambda a, b: a == b,
+    "==": lambda a, b: a == b,
+    "!=": lambda a, b: a != b,
+    "<": lambda a, b: a < b,
+    "<=": lambda a, b: a <= b,
+    ">": lambda a, b: a > b,
+    ">=": lambda a, b: a >= b,
+}
+
+
+def run(command: list[str], expect_failure: bool = False) -> subprocess.CompletedProcess:
+    result = subprocess.run(command, text=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if (result.returncode != 0) != expect_failure:
+        raise RuntimeError(
+            f"{' '.join(command)} exited with status {result.returncode}\n"
+            f"stdout:\n{result.stdout}\n"
+            f"stderr:\n{result.stderr}"
+        )
+    return result
+
+
+def decode_index(data: bytes) -> tuple[int, dict[str, list]]:
+    """Columns of a .mdpx file, read with the layout documented in PackIndex.hpp."""
+    magic, version, rows, count = struct.unpack_from("<4sIII", data, 0)
+    if magic != b"MDPX" or version != 1:
+        raise RuntimeError(f"bad index header {magic!r} version {version}")
+    columns = {}
+    for index in range(count):
+        raw_name, kind, _, offset = struct.unpack_from("<24sIIQ", data, 16 + 40 * index)
+        name = raw_name.rstrip(b"\0").decode()
+        if kind == 3:
+            offsets = struct.unpack_from(f"<{rows + 1}I", data, offset)
+            text = data[offset + 4 * (rows + 1):]
+            columns[name] = [text[offsets[row]:offsets[row + 1]].decode() for row in range(rows)]
+        else:
+            columns[name] = list(struct.unpack_from(f"<{rows}{'i' if kind == 1 else 'f'}", data, offset))
+    return rows, columns
+
+
+def python_filter(columns: dict[str, list], query: str) -> list[str]:
+    tokens = query.replace("&&", " and ").replace(">=", " >= ").replace("<=", " <= ").replace("!=", " != ").split()
+    terms = []
+    current: list[str] = []
+    for token in tokens:
+        if token == "and":
+            terms.append(current)
+            current = []
+        else:
+            current.append(token)
+    if current:
+        terms.append(current)
+    rows = range(len(columns["path"]))
+    for term in terms:
+        if term[0] == "not":
+            test = lambda value: value == 0  # noqa: E731
+            name = term[1]
+        elif len(term) == 1:
+            test = lambda value: value != 0  # noqa: E731
+            name = term[0]
+        else:
+            name, op, number = term
+            test = (lambda o, n: lambda value: OPERATORS[o](value, n))(op, float(number))
+        values = columns[name]
+        rows = [row for row in rows if test(values[row])]
+    return [columns["path"][row] for row in rows]
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="MilkdropPackIndex regression checks")
+    parser.add_argument("--indexer", type=Path, required=True, help="Path to MilkdropPackIndex executable")
+    parser.add_argument("--fixtures", type=Path, required=True, help="Directory containing .milk fixtures")
+    args = parser.parse_args(argv)
+
+    failures: list[str] = []
+    fixtures = sorted(args.fixtures.glob("*.milk"))
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        pack = tmp_path / "pack"
+        (pack / "nested").mkdir(parents=True)
+        for fixture in fixtures:
+            shutil.copy(fixture, pack / fixture.name)
+        (pack / "nested" / "Shapes.MILK").write_text(SYNTHETIC_PRESET)
+        (pack / "nested" / "binary.milk").write_bytes(b"[preset00]\nzoom=1\0\x01\x02\n")
+        (pack / "notes.txt").write_text("not a preset\n")
+        expected_paths = sorted([fixture.name for fixture in fixtures] + ["nested/Shapes.MILK", "nested/binary.milk"])
+
+        indexes = {}
+        for threads in (1, 4):
+            index = tmp_path / f"pack{threads}.mdpx"
+            result = run([str(args.indexer), "--threads", str(threads), str(pack), str(index)])
+            if f"threads: {threads}" not in result.stdout:
+                failures.append(f"--threads {threads} not reported: {result.stdout.strip()}")
+            if "parse_failures: 1" not in result.stdout or "nested/binary.milk" not in result.stderr:
+                failures.append(f"binary preset not reported as a parse failure:\n{result.stdout}{result.stderr}")
+            indexes[threads] = index.read_bytes()
+        if indexes[1] != indexes[4]:
+            failures.append("index differs between 1 and 4 threads")
+        index = tmp_path / "pack4.mdpx"
+
+        rows, columns = decode_index(indexes[4])
+        if rows != len(expected_paths) or columns["path"] != expected_paths:
+            failures.append(f"indexed paths {columns['path']} do not match {expected_paths}")
+            return report(failures)
+
+        def feature(path: str, name: str) -> float:
+            return columns[name][columns["path"].index(path)]
+
+        expectations = [
+            ("wave_mode_8.milk", "wave_mode", 8),
+            ("wave_mode_8.milk", "wave_supported", 1),
+            ("unsupported_wave_mode.milk", "wave_supported", 0),
+            ("che.milk", "motion_vectors", 1),
+            ("eos.milk", "custom_waves", 1),
+            ("preset_shaders.milk", "warp_shader", 1),
+            ("preset_shaders.milk", "comp_shader", 1),
+            ("nested/Shapes.MILK", "parsed", 1),
+            ("nested/Shapes.MILK", "custom_shapes", 2),
+            ("nested/Shapes.MILK", "uses_loop", 1),
+            ("nested/Shapes.MILK", "uses_megabuf", 1),
+            ("nested/Shapes.MILK", "frame_statements", 2),
+            ("nested/Shapes.MILK", "pixel_statements", 1),
+            ("nested/Shapes.MILK", "custom_statements", 1),
+            ("nested/binary.milk", "parsed", 0),
+            ("nested/binary.milk", "cost", 0),
+        ]
+        for path, name, expected in expectations:
+            if feature(path, name) != expected:
+                failures.append(f"{path}: {name} = {feature(path, name)}, expected {expected}")
+        if abs(feature("nested/Shapes.MILK", "rating") - 4.5) > 1e-6:
+            failures.append("Shapes.MILK rating was not read from fRating")
+        if not feature("wave_mode_8.milk", "cost") > feature("unsupported_wave_mode.milk", "cost") > 0:
+            failures.append("cost does not rank a wave mode 8 preset above the fallback preset")
+
+        for query in QUERIES:
+            result = run([str(args.indexer), "--query", query, str(index)])
+            actual = result.stdout.splitlines()
+            expected = python_filter(columns, query)
+            if actual != expected:
+                failures.append(f"query {query!r} returned {actual}, expected {expected}")
+            if f"{len(expected)} of {rows} presets match" not in result.stderr:
+                failures.append(f"query {query!r} did not report its match count: {result.stderr.strip()}")
+
+        count = run([str(args.indexer), "--query", "wave_mode = 6", "--count", str(index)]).stdout.strip()
+        if count != str(len(python_filter(columns, "wave_mode = 6"))):
+            failures.append(f"--count printed {count!r}")
+        listed = run([str(args.indexer), "--query", "custom_shapes > 0", "--columns", "custom_shapes,wave_mode",
+                      str(index)]).stdout
+        if listed != "nested/Shapes.MILK\t2\t8\n":
+            failures.append(f"--columns printed {listed!r}")
+
+        for query, message in BAD_QUERIES.items():
+            result = run([str(args.indexer), "--query", query, str(index)], expect_failure=True)
+            if message not in result.stderr:
+                failures.append(f"query {query!r} failed without {message!r}: {result.stderr.strip()}")
+        result = run([str(args.indexer), "--query", "", str(pack / "notes.txt")], expect_failure=True)
+        if "not a pack index" not in result.stderr:
+            failures.append(f"non-index file not rejected: {result.stderr.strip()}")
+
+    if not failures:
+        print(f"Validated pack index of {len(expected_paths)} presets and {len(QUERIES)} queries")
+    return report(failures)
+
+
+def report(failures: list[str]) -> int:
+    if failures:
+        print("Pack index regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""Regression checks for MilkdropPackShaders, the pack converter that shares helper code.
+
+The fixtures are converted once as a pack and once preset by preset with MilkdropConverter.
+The test checks that:
+- the pack holds the same shader files as the single conversions, and every one expands,
+  after inlining its #include lines, to exactly the converter's output;
+- --no-dedupe writes the converter's output unchanged;
+- each shared chunk is named after the FNV-1a hash of its text, used at least twice and
+  referenced through GL_ARB_shading_language_include right after #version;
+- the common preamble (float_from_bool, rand, the *_eel helpers) only lives in shared chunks;
+- the output does not depend on the thread count, and the --report totals match the files;
+- a second copy of the pack adds little more than its own preset code.
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+INCLUDE = re.compile(r'^#include "/milkdrop/([0-9a-f]{16}\.glsl)"$', re.MULTILINE)
+EXTENSION = "#extension GL_ARB_shading_language_include : require\n"
+PREAMBLE = ["float float_from_bool(bool b)", "float rand(vec2 co)", "float sigmoid_eel(", "float exec3_helper("]
+
+
+def run(command: list[str]) -> subprocess.CompletedProcess:
+    result = subprocess.run(command, text=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if result.returncode != 0:
+        raise RuntimeError(
+            f"{' '.join(command)} exited with status {result.returncode}\n"
+            f"stdout:\n{result.stdout}\n"
+            f"stderr:\n{result.stderr}"
+        )
+    return result
+
+
+def fnv1a(text: str) -> str:
+    value = 0xCBF29CE484222325
+    for byte in text.encode():
+        value = ((value ^ byte) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return f"{value:016x}"
+
+
+def read_tree(root: Path) -> dict[str, str]:
+    return {path.relative_to(root).as_posix(): path.read_text() for path in sorted(root.rglob("*")) if path.is_file()}
+
+
+def expand(shader: str, chunks: dict[str, str]) -> str:
+    return INCLUDE.sub(lambda match: chunks[match.group(1)].rstrip("\n"), shader.replace(EXTENSION, "", 1))
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="MilkdropPackShaders regression checks")
+    parser.add_argument("--packer", type=Path, required=True, help="Path to MilkdropPackShaders executable")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--fixtures", type=Path, required=True, help="Directory containing .milk fixtures")
+    args = parser.parse_args(argv)
+
+    failures: list[str] = []
+    fixtures = sorted(args.fixtures.glob("*.milk"))
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        single = tmp_path / "single"
+        single.mkdir()
+        for fixture in fixtures:
+            run([str(args.converter), str(fixture), str(single / f"{fixture.stem}.frag")])
+        expected = read_tree(single)
+
+        outputs = {}
+        reports = {}
+        for threads in (1, 4):
+            output = tmp_path / f"pack{threads}"
+            report = tmp_path / f"report{threads}.json"
+            run([str(args.packer), "--threads", str(threads), "--report", str(report), str(args.fixtures), str(output)])
+            outputs[threads] = read_tree(output)
+            reports[threads] = json.loads(report.read_text())
+        if outputs[1] != outputs[4]:
+            failures.append("pack output differs between 1 and 4 threads")
+
+        tree = outputs[4]
+        report = reports[4]
+        chunks = {name.split("/", 1)[1]: text for name, text in tree.items() if name.startswith("milkdrop/")}
+        shaders = {name: text for name, text in tree.items() if not name.startswith("milkdrop/")}
+        if sorted(shaders) != sorted(expected):
+            failures.append(f"pack files {sorted(shaders)} do not match the converter's {sorted(expected)}")
+
+        references = {name: 0 for name in chunks}
+        for name, shader in shaders.items():
+            included = INCLUDE.findall(shader)
+            for chunk in included:
+                if chunk not in chunks:
+                    failures.append(f"{name} includes missing chunk {chunk}")
+                else:
+                    references[chunk] += 1
+            has_extension = shader.startswith("#version 330 core\n" + EXTENSION)
+            if bool(included) != has_extension:
+                failures.append(f"{name}: {len(included)} includes but extension line present = {has_extension}")
+            if name in expected and all(chunk in chunks for chunk in included):
+                if expand(shader, chunks) != expected[name]:
+                    failures.append(f"{name} does not expand to the converter output")
+            for helper in PREAMBLE:
+                if helper in shader:
+                    failures.append(f"{name} still holds {helper!r} inline")
+        for name, text in chunks.items():
+            if name != f"{fnv1a(text)}.glsl":
+                failures.append(f"chunk {name} is not named after its content hash {fnv1a(text)}")
+            if references[name] < 2:
+                failures.append(f"chunk {name} is used {references[name]} time(s)")
+        if not any(PREAMBLE[0] in text for text in chunks.values()):
+            failures.append("float_from_bool is in no shared chunk")
+
+        before = sum(len(text.encode()) for text in expected.values())
+        after = sum(len(text.encode()) for text in tree.values())
+        if report["before"]["bytes"] != before or report["after"]["bytes"] != after:
+            failures.append(f"report bytes {report['before']['bytes']} -> {report['after']['bytes']} do not match "
+                            f"the files ({before} -> {after})")
+        if report["after"]["shared_chunks"] != len(chunks) or report["after"]["include_references"] != sum(references.values()):
+            failures.append(f"report chunk totals {report['after']} do not match the files")
+        if not after < 0.8 * before:
+            failures.append(f"sharing saved too little: {before} -> {after} bytes")
+        if report["presets"] != len(fixtures) or report["shaders"] != len(expected):
+            failures.append(f"report counts {report['presets']} presets, {report['shaders']} shaders")
+
+        whole = tmp_path / "whole"
+        run([str(args.packer), "--no-dedupe", str(args.fixtures), str(whole)])
+        if read_tree(whole) != expected:
+            failures.append("--no-dedupe output differs from the converter output")
+
+        doubled = tmp_path / "doubled"
+        for copy in ("a", "b"):
+            shutil.copytree(args.fixtures, doubled / copy)
+        doubled_report = tmp_path / "doubled.json"
+        run([str(args.packer), "--report", str(doubled_report), str(doubled), str(tmp_path / "doubled_out")])
+        doubled_after = json.loads(doubled_report.read_text())["after"]
+        single_after = report["after"]
+        # Helper runs that were unique now recur, so some move into new chunks; the copy should
+        # still cost little more than its own inline preset code.
+        added = doubled_after["bytes"] - single_after["bytes"]
+        if added > 1.05 * single_after["shader_bytes"]:
+            failures.append(f"a second copy of the pack added {added} bytes, more than its "
+                            f"{single_after['shader_bytes']} bytes of inline preset code")
+
+    if failures:
+        print("Pack shader regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print(f"Validated {len(expected)} pack shaders: {before} -> {after} bytes, {len(chunks)} shared chunks, "
+          f"{sum(references.values())} includes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
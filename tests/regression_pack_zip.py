@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""Regression checks for reading preset packs straight from zip archives.
+
+The fixtures are laid out as a pack (nested directories) and zipped, deflated and stored.
+The test checks that:
+- MilkdropPackShaders writes the same files from either archive, with 1 or 4 threads, as
+  from the extracted tree;
+- MilkdropPackIndex writes a byte-identical index from an archive and from the tree, also for
+  a ZIP64 archive (more than 65535 entries);
+- directory entries, non-preset files and __MACOSX/ resource forks are not presets;
+- an entry whose CRC does not match is reported as a parse failure, and a file that is not
+  an archive or whose ZIP64 record lies outside the file is an error;
+- indexing from the deflated archive is no slower than from the tree.
+"""
+
+from __future__ import annotations
+
+import argparse
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+import zipfile
+from pathlib import Path
+
+TIMING_RUNS = 3
+
+
+def run(command: list[str], expect_failure: bool = False) -> subprocess.CompletedProcess:
+    result = subprocess.run(command, text=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if (result.returncode != 0) != expect_failure:
+        raise RuntimeError(
+            f"{' '.join(command)} exited with status {result.returncode}\n"
+            f"stdout:\n{result.stdout}\n"
+            f"stderr:\n{result.stderr}"
+        )
+    return result
+
+
+def read_tree(root: Path) -> dict[str, bytes]:
+    return {path.relative_to(root).as_posix(): path.read_bytes() for path in sorted(root.rglob("*")) if path.is_file()}
+
+
+def make_pack(fixtures: list[Path], root: Path) -> None:
+    """Spreads the fixtures over nested directories, as packs are organised."""
+    for index, fixture in enumerate(fixtures):
+        target = root / ("authors" if index % 2 else "") / ("b" if index % 3 else "a") / fixture.name
+        target.parent.mkdir(parents=True, exist_ok=True)
+        shutil.copyfile(fixture, target)
+    (root / "readme.txt").write_text("not a preset\n")
+
+
+def make_archive(root: Path, archive: Path, compression: int, fillers: int = 0) -> None:
+    with zipfile.ZipFile(archive, "w", compression) as out:
+        for path in sorted(root.rglob("*")):
+            name = path.relative_to(root).as_posix()
+            if path.is_dir():
+                out.writestr(name + "/", b"")
+            else:
+                out.write(path, name)
+        out.writestr("__MACOSX/authors/._ignored.milk", b"\x00\x05\x16\x07\x00\x02\x00\x00Mac OS X")
+        for filler in range(fillers):
+            out.writestr(f"fillers/{filler}.txt", b"", zipfile.ZIP_STORED)
+
+
+def best_time(command: list[str]) -> float:
+    best = float("inf")
+    for _ in range(TIMING_RUNS):
+        start = time.perf_counter()
+        run(command)
+        best = min(best, time.perf_counter() - start)
+    return best
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Zip archive input regression checks")
+    parser.add_argument("--packer", type=Path, required=True, help="Path to MilkdropPackShaders executable")
+    parser.add_argument("--indexer", type=Path, required=True, help="Path to MilkdropPackIndex executable")
+    parser.add_argument("--fixtures", type=Path, required=True, help="Directory containing .milk fixtures")
+    args = parser.parse_args(argv)
+
+    failures: list[str] = []
+    fixtures = sorted(args.fixtures.glob("*.milk"))
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        tree = tmp_path / "pack"
+        make_pack(fixtures, tree)
+        deflated = tmp_path / "deflated.zip"
+        stored = tmp_path / "stored.zip"
+        make_archive(tree, deflated, zipfile.ZIP_DEFLATED)
+        make_archive(tree, stored, zipfile.ZIP_STORED)
+
+        run([str(args.packer), str(tree), str(tmp_path / "from_tree")])
+        expected = read_tree(tmp_path / "from_tree")
+        for archive in (deflated, stored):
+            for threads in (1, 4):
+                output = tmp_path / f"{archive.stem}{threads}"
+                result = run([str(args.packer), "--threads", str(threads), str(archive), str(output)])
+                if read_tree(output) != expected:
+                    failures.append(f"shaders from {archive.name} with {threads} thread(s) differ from the tree's")
+                if f"presets: {len(fixtures)} (0 parse failures)" not in result.stdout:
+                    failures.append(f"{archive.name}: unexpected preset count: {result.stdout.splitlines()[0]}")
+
+        tree_index = tmp_path / "tree.mdpx"
+        run([str(args.indexer), str(tree), str(tree_index)])
+        zip64 = tmp_path / "zip64.zip"
+        make_archive(tree, zip64, zipfile.ZIP_DEFLATED, fillers=0x10000)
+        for archive in (deflated, stored, zip64):
+            index = tmp_path / f"{archive.stem}.mdpx"
+            run([str(args.indexer), str(archive), str(index)])
+            if index.read_bytes() != tree_index.read_bytes():
+                failures.append(f"index from {archive.name} differs from the tree's")
+
+        # Flip one byte of a stored preset: its CRC no longer matches.
+        damaged = tmp_path / "damaged.zip"
+        data = bytearray(stored.read_bytes())
+        with zipfile.ZipFile(stored) as archive:
+            info = next(entry for entry in archive.infolist() if entry.filename.endswith(".milk"))
+        header = info.header_offset
+        start = header + 30 + int.from_bytes(data[header + 26:header + 28], "little") + \
+            int.from_bytes(data[header + 28:header + 30], "little")
+        data[start] ^= 0x20
+        damaged.write_bytes(bytes(data))
+        result = run([str(args.packer), str(damaged), str(tmp_path / "damaged")])
+        if f"presets: {len(fixtures)} (1 parse failures)" not in result.stdout or info.filename not in result.stderr:
+            failures.append(f"a CRC mismatch in {info.filename} was not reported: {result.stdout.splitlines()[0]}")
+
+        not_zip = tmp_path / "not_a_zip.zip"
+        not_zip.write_text("this is not an archive\n" * 4)
+        result = run([str(args.indexer), str(not_zip), str(tmp_path / "none.mdpx")], expect_failure=True)
+        if "Not a zip archive" not in result.stderr:
+            failures.append(f"a file that is not a zip gave: {result.stderr.strip()}")
+
+        # A ZIP64 locator pointing far past the end of a file shorter than a ZIP64 record.
+        truncated = tmp_path / "truncated_zip64.zip"
+        locator = struct.pack("<IIQI", 0x07064B50, 0, 1 << 40, 1)
+        end_record = struct.pack("<IHHHHIIH", 0x06054B50, 0, 0, 0xFFFF, 0xFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0)
+        truncated.write_bytes(locator + end_record)
+        result = run([str(args.indexer), str(truncated), str(tmp_path / "none.mdpx")], expect_failure=True)
+        if result.returncode < 0 or "Damaged ZIP64" not in result.stderr:
+            failures.append(f"a truncated ZIP64 archive gave status {result.returncode}: {result.stderr.strip()}")
+
+        # Each preset is read many times so that reading, not start-up, is measured.
+        big_tree = tmp_path / "big"
+        for copy in range(20):
+            shutil.copytree(tree, big_tree / str(copy))
+        big_zip = tmp_path / "big.zip"
+        make_archive(big_tree, big_zip, zipfile.ZIP_DEFLATED)
+        tree_time = best_time([str(args.indexer), "--threads", "1", str(big_tree), str(tmp_path / "t.mdpx")])
+        zip_time = best_time([str(args.indexer), "--threads", "1", str(big_zip), str(tmp_path / "z.mdpx")])
+        # Timing on a shared machine is noisy, so allow a small margin.
+        if zip_time > tree_time * 1.25 + 0.05:
+            failures.append(f"indexing from the archive took {zip_time:.3f} s, the tree {tree_time:.3f} s")
+
+    if failures:
+        print("Pack zip regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print(f"Validated zip input for {len(fixtures)} presets: archive {zip_time:.3f} s, tree {tree_time:.3f} s "
+          f"for {20 * len(fixtures)} presets")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""Regression for the --pass-graph manifest.
+
+Every fixture, converted with and without --wave-geometry --wave-lowres, must produce a manifest
+that lists every shader the converter wrote, with the prepasses before the main shader and at
+most the composite shader after it, and that passes an independent check: same-frame inputs
+come from earlier passes and form no cycle, last-frame inputs persist (with a second buffer
+when read after being overwritten), and resources sharing a target are never alive at once. preset_blur.milk with --wave-lowres must
+alias its transient targets, a warp shader reading blur1 must keep blur1 from the frame before,
+and the feedback loop of baked.milk must be double-buffered.
+"""
+
+from __future__ import annotations
+
+import argparse
+import re
+import sys
+import tempfile
+from pathlib import Path
+
+from _converter import convert, run
+
+
+def validate(graph: dict) -> list[str]:
+    """Checks the manifest without trusting the converter's own validator."""
+    errors = []
+    passes = graph["passes"]
+    resources = {resource["name"]: resource for resource in graph["resources"]}
+    producers = {}
+    for index, render_pass in enumerate(passes):
+        if render_pass["output"] in producers:
+            errors.append(f"{render_pass['output']} written twice")
+        producers[render_pass["output"]] = index
+        if not Path(render_pass["shader"]).is_file():
+            errors.append(f"{render_pass['name']}: shader {render_pass['shader']} was not written")
+
+    edges = {index: set() for index in range(len(passes))}
+    for index, render_pass in enumerate(passes):
+        for read in render_pass["inputs"]:
+            name = read["resource"]
+            if name not in producers:
+                if name not in graph["external_inputs"]:
+                    errors.append(f"{render_pass['name']} reads {name}, which nothing produces")
+                continue
+            resource = resources[name]
+            if read["frame"] == "previous":
+                if not resource["persistent"]:
+                    errors.append(f"{render_pass['name']} reads last frame's {name}, which does not persist")
+                elif producers[name] <= index and graph["targets"][resource["target"]]["buffers"] < 2:
+                    errors.append(f"{render_pass['name']} reads last frame's {name} after it is overwritten")
+                continue
+            if producers[name] >= index:
+                errors.append(f"{render_pass['name']} reads {name} before it is produced")
+            if not resource["lifetime"][0] <= index <= resource["lifetime"][1]:
+                errors.append(f"{render_pass['name']} reads {name} outside its lifetime")
+            edges[producers[name]].add(index)
+
+    # Depth-first search for a cycle among same-frame edges.
+    state = {}
+
+    def visit(node: int) -> bool:
+        state[node] = "open"
+        for consumer in edges[node]:
+            if state.get(consumer) == "open" or (consumer not in state and visit(consumer)):
+                return True
+        state[node] = "done"
+        return False
+
+    if any(node not in state and visit(node) for node in edges):
+        errors.append("same-frame inputs form a cycle")
+
+    by_target: dict[int, list[dict]] = {}
+    for resource in graph["resources"]:
+        target = graph["targets"][resource["target"]]
+        if target["size"] != resource["size"] or target["format"] != resource["format"]:
+            errors.append(f"{resource['name']} does not fit target {resource['target']}")
+        for other in by_target.setdefault(resource["target"], []):
+            overlap = resource["lifetime"][0] <= other["lifetime"][1] and other["lifetime"][0] <= resource["lifetime"][1]
+            if overlap or resource["persistent"] or other["persistent"]:
+                errors.append(f"{other['name']} and {resource['name']} share a target while alive")
+        by_target[resource["target"]].append(resource)
+    if graph["textures"] != sum(target["buffers"] for target in graph["targets"]):
+        errors.append("texture count does not match the targets")
+    if graph["display"] not in resources:
+        errors.append(f"displayed resource {graph['display']} is not declared")
+    return errors
+
+
+def find(graph: dict, section: str, name: str) -> dict:
+    return next(entry for entry in graph[section] if entry["name"] == name)
+
+
+def check_fixtures(args: argparse.Namespace, tmp: Path, failures: list[str]) -> None:
+    presets = sorted(args.fixtures.glob("*.milk")) + [args.baked]
+    for preset in presets:
+        for options in ((), ("--wave-geometry", "--wave-lowres")):
+            label = f"{preset.name} {' '.join(options)}".strip()
+            output = tmp / f"{preset.stem}{len(options)}.frag"
+            conversion = convert(args.converter, preset, output, *options)
+            graph = conversion.graph
+            # Every shader the converter wrote is in the manifest, and only the composite pass
+            # follows the main shader.
+            written = sorted(path.name for path in [output, *tmp.glob(f"{output.stem}.*.frag")])
+            listed = sorted(Path(render_pass["shader"]).name for render_pass in graph["passes"])
+            if listed != written:
+                failures.append(f"{label}: manifest shaders {listed} differ from the written {written}")
+            main_pass = find(graph, "passes", "main")
+            if Path(main_pass["shader"]) != output or len(conversion.passes) + (conversion.composite is not None) + 1 != len(listed):
+                failures.append(f"{label}: manifest passes {[p['name'] for p in graph['passes']]} are out of order")
+            for error in validate(graph):
+                failures.append(f"{label}: {error}")
+            if graph["textures"] > len(graph["resources"]) + 1:
+                failures.append(f"{label}: {graph['textures']} textures for {len(graph['resources'])} outputs")
+
+    # The manifest is only an extra output.
+    plain = tmp / "plain.frag"
+    run([str(args.converter), str(args.baked), str(plain)])
+    if plain.read_text() != (tmp / "baked0.frag").read_text():
+        failures.append("baked.milk: --pass-graph changed the generated shader")
+
+
+def check_aliasing(args: argparse.Namespace, tmp: Path, failures: list[str]) -> None:
+    graph = convert(args.converter, args.fixtures / "preset_blur.milk", tmp / "alias.frag", "--wave-lowres").graph
+    blur = find(graph, "resources", "iBlur1H")
+    field = find(graph, "resources", "iWaveField")
+    if blur["target"] != field["target"]:
+        failures.append("preset_blur --wave-lowres: iBlur1H and iWaveField should share their half-resolution target")
+    if find(graph, "resources", "iPresetWarp")["target"] != find(graph, "resources", "preset_comp")["target"]:
+        failures.append("preset_blur --wave-lowres: the composite output should reuse the preset_warp target")
+    if graph["textures"] >= len(graph["resources"]):
+        failures.append(f"preset_blur --wave-lowres: {graph['textures']} textures for {len(graph['resources'])} outputs, expected fewer")
+
+    text = (args.fixtures / "preset_blur.milk").read_text()
+    preset = tmp / "warp_blur.milk"
+    preset.write_text(re.sub(r"    ret = float3\(step.*\);", "    ret = GetBlur1(uv) * 0.5 + tex2D(sampler_main, uv).xyz * 0.5;", text))
+    graph = convert(args.converter, preset, tmp / "warp_blur.frag").graph
+    warp = find(graph, "passes", "preset_warp")
+    blur1 = find(graph, "resources", "iBlur1")
+    if {"resource": "iBlur1", "frame": "previous"} not in warp["inputs"] or not blur1["persistent"]:
+        failures.append("warp_blur: the warp shader must read last frame's iBlur1 and iBlur1 must persist")
+    if graph["targets"][blur1["target"]]["buffers"] != 1 or len(graph["targets"][blur1["target"]]["resources"]) != 1:
+        failures.append("warp_blur: iBlur1 is read before it is redrawn, so one unshared buffer suffices")
+
+    graph = convert(args.converter, args.baked, tmp / "feedback.frag").graph
+    main = find(graph, "passes", "main")
+    frame = find(graph, "resources", "iChannel0")
+    if {"resource": "iChannel0", "frame": "previous"} not in main["inputs"] or graph["targets"][frame["target"]]["buffers"] != 2:
+        failures.append("baked.milk: the main shader's feedback must be a double-buffered iChannel0")
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Validate --pass-graph manifests")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--fixtures", type=Path, required=True, help="Directory of .milk fixtures")
+    parser.add_argument("--baked", type=Path, required=True, help="Path to baked.milk")
+    args = parser.parse_args(argv)
+
+    failures: list[str] = []
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        check_fixtures(args, tmp_path, failures)
+        check_aliasing(args, tmp_path, failures)
+
+    if failures:
+        print("Pass graph regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print("Validated pass graph order, inputs, lifetimes and target aliasing")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
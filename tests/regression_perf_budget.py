@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Performance budget regression for the converter benchmark suite.
+
+This script runs the MilkdropConverter-Benchmark binary with JSON output and
+fails when any converter stage exceeds the per-pass budget stored in
+benchmarks/budgets.json. Budgets are deliberately generous ceilings so the
+check catches algorithmic regressions (extra passes, super-linear behaviour)
+rather than machine-to-machine noise.
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import subprocess
+from pathlib import Path
+
+TIME_UNIT_TO_NS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+class BudgetError(AssertionError):
+    """Domain specific assertion error for clearer failure output."""
+
+
+def run_benchmarks(benchmark: Path, min_time: float) -> list[dict]:
+    result = subprocess.run(
+        [str(benchmark), "--benchmark_format=json", f"--benchmark_min_time={min_time}"],
+        stdout=subprocess.PIPE,
+        stderr=subprocess.PIPE,
+        text=True,
+        check=False,
+    )
+    if result.returncode != 0:
+        raise RuntimeError(
+            f"Benchmark binary failed\nstdout:\n{result.stdout}\nstderr:\n{result.stderr}"
+        )
+    return json.loads(result.stdout)["benchmarks"]
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="Converter performance budget regression")
+    parser.add_argument("--benchmark", required=True, type=Path, help="Path to MilkdropConverter-Benchmark binary")
+    parser.add_argument("--budgets", required=True, type=Path, help="JSON file with per-benchmark budgets")
+    parser.add_argument("--min-time", type=float, default=0.05, help="Minimum seconds to run each benchmark")
+    parser.add_argument("--scale", type=float, default=1.0, help="Multiply every budget by this factor (e.g. for slow CI hosts)")
+    args = parser.parse_args()
+
+    if not args.benchmark.exists():
+        raise SystemExit(f"Benchmark binary not found: {args.benchmark}")
+
+    budgets = json.loads(args.budgets.read_text())["budgets_ns"]
+    results = {entry["name"]: entry for entry in run_benchmarks(args.benchmark, args.min_time)}
+
+    failures = []
+    for name, budget_ns in budgets.items():
+        entry = results.get(name)
+        if entry is None:
+            failures.append(f"{name}: benchmark did not run")
+            continue
+        if entry.get("error_occurred"):
+            failures.append(f"{name}: {entry.get('error_message', 'benchmark reported an error')}")
+            continue
+        measured_ns = entry["real_time"] * TIME_UNIT_TO_NS[entry.get("time_unit", "ns")]
+        limit_ns = budget_ns * args.scale
+        status = "ok" if measured_ns <= limit_ns else "OVER BUDGET"
+        print(f"{name:45s} {measured_ns / 1e6:10.3f} ms  (budget {limit_ns / 1e6:.3f} ms)  {status}")
+        if measured_ns > limit_ns:
+            failures.append(f"{name}: {measured_ns / 1e6:.3f} ms exceeds budget {limit_ns / 1e6:.3f} ms")
+
+    unbudgeted = sorted(set(results) - set(budgets))
+    for name in unbudgeted:
+        print(f"{name:45s} (no budget)")
+
+    if failures:
+        raise BudgetError("\n".join(failures))
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
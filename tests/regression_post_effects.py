@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+"""Image regression for the post effects of presets without a composite shader.
+
+The darken-centre diamond and the outer and inner borders are drawn by the main shader; video
+echo, gamma, the hue shading and the brighten/darken/solarize/invert filters by the
+post_composite pass. Each check renders a synthetic preset whose frame is a known gradient and
+compares pixels with a Python model of libprojectM's FinalComposite:
+- with everything off, neither the pass nor any border or darken-centre code is emitted;
+- gamma scales the hue-shaded frame and clamps it, and each filter maps the result as its
+  blend mode does;
+- the echo mixes in the frame zoomed about the centre and flipped by echo_orient;
+- gamma set only by per-frame code still emits the pass, with the per-frame code in it;
+- the diamond darkens the centre by 3/32 and nothing outside it;
+- the outer border covers ob_size of clip space along each edge, the inner one the next
+  ib_size, each mixed in by its alpha.
+"""
+
+from __future__ import annotations
+
+import argparse
+import math
+import re
+import struct
+import sys
+import tempfile
+from pathlib import Path
+
+from _converter import convert, run
+
+RENDER_SIZE = 64
+TOLERANCE = 0.02
+
+HUE_OFFSETS = re.compile(r"corner \* vec3\(21\.0, 13\.0, 9\.0\) \+ vec3\(([^)]*)\)")
+
+# No wave, border or motion vectors; the per-pixel code paints r = x, g = y and a constant blue.
+HEADER = "[preset00]\nnWaveMode=0\nwave_a=0\ndecay=1\nob_a=0\nib_a=0\nmv_a=0\n"
+GRADIENT = "per_pixel_1=r = x; g = y; b = 0.25; a = 1;\n"
+
+Image = list[list[tuple[float, ...]]]
+
+
+def convert_and_render(converter: Path, renderer: Path, tmp: Path, name: str,
+                       preset_text: str) -> tuple[str, str | None, Image]:
+    """Converts and renders one frame; returns the main shader, the composite shader (None
+    without one) and the output rows, bottom row first (PFM order)."""
+    preset = tmp / f"{name}.milk"
+    preset.write_text(preset_text)
+    shader = tmp / f"{name}.frag"
+    composite = convert(converter, preset, shader).composite
+
+    output = tmp / f"{name}.pfm"
+    command = [str(renderer), "--size", f"{RENDER_SIZE}x{RENDER_SIZE}", "--time", "0"]
+    if composite is not None:
+        command += ["--composite", str(composite)]
+    run(command + [str(shader), str(output)])
+
+    data = output.read_bytes()
+    header, dimensions, _scale, pixels = data.split(b"\n", 3)
+    if header != b"PF":
+        raise RuntimeError(f"{output} is not a colour PFM image")
+    width, height = (int(value) for value in dimensions.split())
+    values = struct.unpack(f"<{width * height * 3}f", pixels[: 12 * width * height])
+    image = [[values[(y * width + x) * 3:(y * width + x) * 3 + 3] for x in range(width)] for y in range(height)]
+    return shader.read_text(), composite.read_text() if composite else None, image
+
+
+def hue(composite: str, u: float, v: float, time: float = 0.0) -> tuple[float, float, float]:
+    """post_hue() of the composite shader, with its baked random offsets."""
+    offsets = [float(value) for value in HUE_OFFSETS.search(composite).group(1).split(",")]
+
+    def corner(index: float) -> list[float]:
+        shade = [0.6 + 0.3 * math.sin(time * 30.0 * rate + phase + index * step + offset)
+                 for rate, phase, step, offset in zip((0.0143, 0.0107, 0.0129), (3.0, 1.0, 6.0), (21.0, 13.0, 9.0), offsets)]
+        return [0.5 + 0.5 * value / max(shade) for value in shade]
+
+    top_left, top_right, bottom_left, bottom_right = (corner(index) for index in range(4))
+    if u <= v:
+        return tuple(bl + u * (tr - tl) + v * (tl - bl) for tl, tr, bl in zip(top_left, top_right, bottom_left))
+    return tuple(bl + u * (br - bl) + v * (tr - br) for tr, bl, br in zip(top_right, bottom_left, bottom_right))
+
+
+def gradient(u: float, v: float) -> tuple[float, float, float]:
+    """Frame painted by GRADIENT, as a GL_LINEAR fetch with GL_CLAMP_TO_EDGE sees it."""
+    half = 0.5 / RENDER_SIZE
+    return (min(max(u, half), 1.0 - half), min(max(v, half), 1.0 - half), 0.25)
+
+
+def compare(image: Image, expected, label: str, columns=range(2, RENDER_SIZE, 5)) -> list[str]:
+    """Compares every fifth pixel with expected(u, v)."""
+    worst = (0.0, None)
+    for y in columns:
+        for x in columns:
+            u, v = (x + 0.5) / RENDER_SIZE, (y + 0.5) / RENDER_SIZE
+            error = max(abs(a - b) for a, b in zip(image[y][x], expected(u, v)))
+            if error > worst[0]:
+                worst = (error, (u, v, image[y][x], expected(u, v)))
+    if worst[0] > TOLERANCE:
+        u, v, got, want = worst[1]
+        return [f"{label}: pixel at ({u:.3f}, {v:.3f}) is {tuple(round(c, 3) for c in got)}, "
+                f"expected {tuple(round(c, 3) for c in want)}"]
+    return []
+
+
+def check_disabled(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    shader, composite, _image = convert_and_render(converter, renderer, tmp, "plain", HEADER + GRADIENT)
+    failures = []
+    if composite is not None:
+        failures.append("plain: no echo, gamma or filter, so no post_composite pass should be emitted")
+    if "borderRadius" in shader or "darken_center > 0.0" in shader:
+        failures.append("plain: borders and darken centre are off, so the main shader should not draw them")
+    return failures
+
+
+def check_filters(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    filters = {
+        "gamma": ("", lambda c: c),
+        "brighten": ("bBrighten=1\n", lambda c: 1.0 - (1.0 - c) ** 2),
+        "darken": ("bDarken=1\n", lambda c: c * c),
+        "solarize": ("bSolarize=1\n", lambda c: 2.0 * c * (1.0 - c)),
+        "invert": ("bInvert=1\n", lambda c: 1.0 - c),
+    }
+    failures = []
+    for name, (setting, blend) in filters.items():
+        _shader, composite, image = convert_and_render(converter, renderer, tmp, name, HEADER + "fGammaAdj=1.8\n" + setting + GRADIENT)
+        if composite is None:
+            failures.append(f"{name}: expected a post_composite pass")
+            continue
+
+        def expected(u: float, v: float, composite=composite, blend=blend):
+            return tuple(blend(min(c * h * 1.8, 1.0)) for c, h in zip(gradient(u, v), hue(composite, u, v)))
+
+        failures += compare(image, expected, name)
+    return failures
+
+
+def check_echo(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    failures = []
+    for orientation in (1, 2, 3):
+        text = HEADER + f"fGammaAdj=0.5\nfVideoEchoAlpha=0.4\nfVideoEchoZoom=2\nnVideoEchoOrientation={orientation}\n" + GRADIENT
+        _shader, composite, image = convert_and_render(converter, renderer, tmp, f"echo_{orientation}", text)
+        if composite is None:
+            failures.append(f"echo_{orientation}: expected a post_composite pass")
+            continue
+
+        def expected(u: float, v: float, composite=composite, orientation=orientation):
+            echo_u, echo_v = 0.5 + (u - 0.5) / 2.0, 0.5 + (v - 0.5) / 2.0
+            if orientation in (1, 3):
+                echo_u = 1.0 - echo_u
+            if orientation >= 2:
+                echo_v = 1.0 - echo_v
+            # With the echo on, gamma below 1 leaves the frame as is.
+            mixed = [0.6 * c + 0.4 * e for c, e in zip(gradient(u, v), gradient(echo_u, echo_v))]
+            return tuple(min(c * h, 1.0) for c, h in zip(mixed, hue(composite, u, v)))
+
+        failures += compare(image, expected, f"echo_{orientation}")
+    return failures
+
+
+def check_per_frame(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    text = HEADER + "fGammaAdj=1\nper_frame_1=gamma = 1.5;\n" + GRADIENT
+    _shader, composite, image = convert_and_render(converter, renderer, tmp, "per_frame", text)
+    if composite is None or "u_gamma" not in composite:
+        return ["per_frame: gamma set per frame needs a post_composite pass running the per-frame code"]
+    return compare(image, lambda u, v: tuple(min(c * h * 1.5, 1.0) for c, h in zip(gradient(u, v), hue(composite, u, v))),
+                   "per_frame")
+
+
+def check_darken_center(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    text = HEADER + "bDarkenCenter=1\nper_pixel_1=r = 0.5; g = 0.5; b = 0.5; a = 1;\n"
+    _shader, composite, image = convert_and_render(converter, renderer, tmp, "darken_center", text)
+    failures = []
+    if composite is not None:
+        failures.append("darken_center: the diamond is drawn by the main shader, not a post_composite pass")
+
+    def expected(u: float, v: float):
+        offset = (abs(u - 0.5) + abs(v - 0.5)) / 0.025
+        return (0.5 * (1.0 - 3.0 / 32.0 * max(0.0, 1.0 - offset)),) * 3
+
+    centre = range(RENDER_SIZE // 2 - 2, RENDER_SIZE // 2 + 2)
+    failures += compare(image, expected, "darken_center", centre)
+    failures += compare(image, expected, "darken_center (outside)")
+    if image[RENDER_SIZE // 2][RENDER_SIZE // 2][0] > 0.49:
+        failures.append("darken_center: the centre pixel is not darkened")
+    return failures
+
+
+def check_borders(converter: Path, renderer: Path, tmp: Path) -> list[str]:
+    failures = []
+    for alpha in (1.0, 0.5):
+        text = (HEADER.replace("ob_a=0\nib_a=0\n", "") + f"ob_size=0.1\nob_r=1\nob_g=0\nob_b=0\nob_a={alpha}\n"
+                f"ib_size=0.15\nib_r=0\nib_g=1\nib_b=0\nib_a={alpha}\nper_pixel_1=r = 0; g = 0; b = 0.5; a = 1;\n")
+        _shader, composite, image = convert_and_render(converter, renderer, tmp, f"borders_{alpha}", text)
+        if composite is not None:
+            failures.append(f"borders_{alpha}: borders are drawn by the main shader, not a post_composite pass")
+
+        def expected(u: float, v: float, alpha=alpha):
+            radius = max(abs(2.0 * u - 1.0), abs(2.0 * v - 1.0))
+            if radius >= 0.9:
+                return (alpha, 0.0, 0.5 * (1.0 - alpha))
+            if radius >= 0.75:
+                return (0.0, alpha, 0.5 * (1.0 - alpha))
+            return (0.0, 0.0, 0.5)
+
+        # Skip the pixels whose centre lies on a ring edge.
+        columns = [x for x in range(RENDER_SIZE)
+                   if all(abs(abs(2.0 * (x + 0.5) / RENDER_SIZE - 1.0) - edge) > 1.0 / RENDER_SIZE for edge in (0.9, 0.75))]
+        failures += compare(image, expected, f"borders_{alpha}", columns)
+    return failures
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Validate borders, darken centre, echo, gamma and the filters")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--renderer", type=Path, required=True, help="Path to MilkdropRender executable")
+    args = parser.parse_args(argv)
+
+    failures: list[str] = []
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        failures += check_disabled(args.converter, args.renderer, tmp_path)
+        failures += check_filters(args.converter, args.renderer, tmp_path)
+        failures += check_echo(args.converter, args.renderer, tmp_path)
+        failures += check_per_frame(args.converter, args.renderer, tmp_path)
+        failures += check_darken_center(args.converter, args.renderer, tmp_path)
+        failures += check_borders(args.converter, args.renderer, tmp_path)
+
+    if failures:
+        print("Post effect regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print("Validated post effects (gamma, filters, echo orientations, per-frame gamma, darken centre, borders)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""Regression checks for playlist-aware prefetch conversion.
+
+The fixtures are copied six times into a pack of about a hundred presets, with one preset
+that does not parse. MilkdropPrefetchSession plays simulated sessions over it, and the test
+checks that:
+- with a radius of 2 and a dwell time of a few conversions, at least 95% of the switches are
+  cache hits, in order, in shuffle mode and when the host polls instead of blocking;
+- every switch gets the same shaders as a conversion on a fresh handle (--verify);
+- prefetching misses at most a fifth as often as converting on demand (radius 0), where only
+  returns to a cached preset hit;
+- skipping through presets without dwelling cancels queued conversions;
+- a cache smaller than the neighbourhood evicts and stays within its capacity;
+- the broken preset is reported as failed without ending the session, and a directory without
+  presets is an error.
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import shutil
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+SWITCHES = 100
+DWELL_MS = 20
+MIN_HIT_RATE = 0.95
+
+
+def run(command: list[str], expect_failure: bool = False) -> subprocess.CompletedProcess:
+    result = subprocess.run(command, text=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if (result.returncode != 0) != expect_failure:
+        raise RuntimeError(
+            f"{' '.join(command)} exited with status {result.returncode}\n"
+            f"stdout:\n{result.stdout}\n"
+            f"stderr:\n{result.stderr}"
+        )
+    return result
+
+
+def make_pack(fixtures: list[Path], root: Path) -> None:
+    for copy in range(6):
+        for fixture in fixtures:
+            target = root / f"set{copy}" / fixture.name
+            target.parent.mkdir(parents=True, exist_ok=True)
+            shutil.copyfile(fixture, target)
+    (root / "set2" / "broken.milk").write_bytes(b"[preset00]\nzoom=1\n\x00\x01\x02")
+
+
+def session(binary: Path, pack: Path, report: Path, *options: str) -> dict:
+    run([str(binary), str(pack), "--switches", str(SWITCHES), "--dwell-ms", str(DWELL_MS), "--report", str(report),
+         *options])
+    return json.loads(report.read_text())
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Prefetch conversion regression checks")
+    parser.add_argument("--session", type=Path, required=True, help="Path to MilkdropPrefetchSession executable")
+    parser.add_argument("--fixtures", type=Path, required=True, help="Directory containing .milk fixtures")
+    args = parser.parse_args(argv)
+
+    fixtures = sorted(args.fixtures.glob("*.milk"))
+    if not fixtures:
+        print(f"No fixtures found in {args.fixtures}", file=sys.stderr)
+        return 1
+
+    failures: list[str] = []
+    with tempfile.TemporaryDirectory() as temp_dir:
+        temp = Path(temp_dir)
+        pack = temp / "pack"
+        make_pack(fixtures, pack)
+        report = temp / "report.json"
+
+        results = {
+            "in order": session(args.session, pack, report, "--verify"),
+            "shuffle": session(args.session, pack, report, "--shuffle", "--verify"),
+            "polling": session(args.session, pack, report, "--poll"),
+        }
+        for name, result in results.items():
+            if result["hit_rate"] < MIN_HIT_RATE:
+                failures.append(f"{name}: {result['hit_rate']:.0%} cache hits, expected at least {MIN_HIT_RATE:.0%}")
+            if result["mismatches"] > 0:
+                failures.append(f"{name}: {result['mismatches']} switches differ from a fresh conversion")
+        in_order = results["in order"]
+        if in_order["presets"] != 6 * len(fixtures) + 1:
+            failures.append(f"the playlist has {in_order['presets']} presets, expected {6 * len(fixtures) + 1}")
+        if in_order["failed_presets"] == 0:
+            failures.append("the broken preset was not reported as failed")
+
+        unprefetched = session(args.session, pack, report, "--radius", "0")
+        if 5 * (1.0 - in_order["hit_rate"]) > 1.0 - unprefetched["hit_rate"]:
+            failures.append(
+                f"prefetching raised the hit rate only from {unprefetched['hit_rate']:.0%} to {in_order['hit_rate']:.0%}"
+            )
+
+        bursts = session(args.session, pack, report, "--burst", "8", "--radius", "4", "--verify")
+        if bursts["cancelled"] == 0:
+            failures.append("skipping without dwelling cancelled no queued conversion")
+        if bursts["mismatches"] > 0:
+            failures.append(f"bursts: {bursts['mismatches']} switches differ from a fresh conversion")
+
+        small = session(args.session, pack, report, "--cache-kb", "128", "--verify")
+        if small["evictions"] == 0:
+            failures.append("a 128 KiB cache evicted nothing")
+        if small["cached_bytes"] > small["cache_capacity"] and small["cached_presets"] > 1:
+            failures.append(f"the cache holds {small['cached_bytes']} bytes, over its {small['cache_capacity']} capacity")
+        if small["mismatches"] > 0:
+            failures.append(f"small cache: {small['mismatches']} switches differ from a fresh conversion")
+
+        empty = temp / "empty"
+        empty.mkdir()
+        if "No presets found" not in run([str(args.session), str(empty)], expect_failure=True).stderr:
+            failures.append("a directory without presets is not reported")
+
+    if failures:
+        print("Prefetch regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print(
+        f"Validated prefetch conversion over {in_order['presets']} presets: "
+        + ", ".join(f"{name} {result['hit_rate']:.0%}" for name, result in results.items())
+        + f" cache hits (radius 0: {unprefetched['hit_rate']:.0%}); {bursts['cancelled']} conversions cancelled in bursts, "
+        f"{small['evictions']} evictions in a 128 KiB cache"
+    )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""Regression for preset warp and composite shaders translated through hlslparser.
+
+preset_shaders.milk adds 0.25 to red in its warp shader every frame and writes x into green,
+and its composite shader inverts the picture. Rendering it for one to three frames must show
+the warp output accumulating through the feedback buffer, and the composite pass must invert
+the displayed frame without feeding back into the next one; the wave prepasses must not
+displace the preset_warp pass. preset_shaders_textures.milk reads noise, random and volume
+textures, blur levels, rotation matrices and user functions; its passes must compile and
+render, declare only the samplers each shader references and bind its 2D textures to
+iChannel1-3. A shader hlslparser rejects and a MilkDrop 1 preset must both fall back to the
+default warp without preset passes.
+"""
+
+from __future__ import annotations
+
+import argparse
+import math
+import re
+import struct
+import sys
+import tempfile
+from pathlib import Path
+
+from _converter import Pass, convert, pass_arguments, run
+
+RENDER_SIZE = "64x64"
+TOLERANCE = 0.02
+
+DEFINE = re.compile(r"^#define sampler_(\w+) (iChannel\d|iBlur\d)$", re.MULTILINE)
+UNIFORM_SAMPLER = re.compile(r"^uniform sampler(?:2D|3D) sampler_(\w+);", re.MULTILINE)
+
+
+def render(renderer: Path, shader: Path, passes: list[Pass], composite: Path | None,
+           frames: int, output: Path) -> tuple[int, int, list[float]]:
+    command = [str(renderer), "--size", RENDER_SIZE, "--frames", str(frames)]
+    command += pass_arguments(passes)
+    if composite is not None:
+        command += ["--composite", str(composite)]
+    run(command + [str(shader), str(output)])
+
+    data = output.read_bytes()
+    header, dimensions, _scale, pixels = data.split(b"\n", 3)
+    if header != b"PF":
+        raise RuntimeError(f"{output} is not a colour PFM image")
+    width, height = (int(value) for value in dimensions.split())
+    count = width * height * 3
+    return width, height, list(struct.unpack(f"<{count}f", pixels[: 4 * count]))
+
+
+def pixel(image: tuple[int, int, list[float]], x: float, y: float) -> tuple[float, float, float]:
+    width, height, values = image
+    offset = (int(y * height) * width + int(x * width)) * 3
+    return values[offset], values[offset + 1], values[offset + 2]
+
+
+def check_feedback(args: argparse.Namespace, tmp: Path, failures: list[str]) -> None:
+    preset = args.fixtures / "preset_shaders.milk"
+    shader = tmp / "feedback.frag"
+    conversion = convert(args.converter, preset, shader)
+    passes, composite = conversion.passes, conversion.composite
+    if [render_pass.sampler for render_pass in passes] != ["iPresetWarp"] or composite is None:
+        failures.append("preset_shaders: expected a preset_warp pass and a composite shader")
+        return
+
+    # The wave prepasses follow the preset warp instead of replacing it.
+    wave_passes = convert(args.converter, preset, tmp / "waves.frag", "--wave-geometry", "--wave-lowres").passes
+    if [render_pass.sampler for render_pass in wave_passes][:1] != ["iPresetWarp"] or len(wave_passes) < 2:
+        failures.append("preset_shaders: --wave-geometry --wave-lowres dropped the preset_warp pass")
+
+    for frames in (1, 2, 3):
+        image = render(args.renderer, shader, passes, None, frames, tmp / f"feedback{frames}.pfm")
+        red = pixel(image, 0.5, 0.5)[0]
+        if abs(red - 0.25 * frames) > TOLERANCE:
+            failures.append(f"preset_shaders: warp red after {frames} frames is {red:.3f}, expected {0.25 * frames:.2f}")
+        for x in (0.25, 0.75):
+            green = pixel(image, x, 0.5)[1]
+            if abs(green - x) > TOLERANCE:
+                failures.append(f"preset_shaders: warp green at x={x} is {green:.3f}, expected uv_orig.x")
+
+        shown = render(args.renderer, shader, passes, composite, frames, tmp / f"composite{frames}.pfm")
+        inverted = pixel(shown, 0.5, 0.5)[0]
+        if abs(inverted - (1.0 - 0.25 * frames)) > TOLERANCE:
+            failures.append(
+                f"preset_shaders: composite red after {frames} frames is {inverted:.3f}, expected {1.0 - 0.25 * frames:.2f}")
+
+
+def check_textures(args: argparse.Namespace, tmp: Path, failures: list[str]) -> None:
+    preset = args.fixtures / "preset_shaders_textures.milk"
+    shader = tmp / "textures.frag"
+    conversion = convert(args.converter, preset, shader)
+    passes, composite = conversion.passes, conversion.composite
+    if not passes or composite is None:
+        failures.append("preset_shaders_textures: expected a preset_warp pass and a composite shader")
+        return
+
+    warp = passes[0].shader.read_text()
+    comp = composite.read_text()
+    warp_defines = dict(DEFINE.findall(warp))
+    comp_defines = dict(DEFINE.findall(comp))
+    if "blur3" in warp_defines or comp_defines.get("blur3") != "iBlur3":
+        failures.append("preset_shaders_textures: blur3 must be bound to iBlur3 in the composite shader only")
+    if warp_defines.get("main") != "iChannel0" or warp_defines.get("fw_main") != "iChannel0":
+        failures.append("preset_shaders_textures: sampler_main and sampler_fw_main must read the feedback buffer")
+    if warp_defines.get("pw_noise_lq") != warp_defines.get("noise_lq") or warp_defines.get("noise_lq") not in ("iChannel1", "iChannel2", "iChannel3"):
+        failures.append("preset_shaders_textures: noise_lq and its pw_ form must share one of iChannel1-3")
+    if warp_defines.get("rand03") not in ("iChannel1", "iChannel2", "iChannel3") or warp_defines["rand03"] == warp_defines.get("noise_lq"):
+        failures.append("preset_shaders_textures: rand03 must have a channel of its own")
+    if "noisevol_lq" in UNIFORM_SAMPLER.findall(warp) or "noisevol_lq" not in UNIFORM_SAMPLER.findall(comp):
+        failures.append("preset_shaders_textures: only the composite shader may declare sampler_noisevol_lq")
+    if "rot_s1 = " not in warp or "rot_s1 = " in comp:
+        failures.append("preset_shaders_textures: rot_s1 must only be set where it is referenced")
+
+    image = render(args.renderer, shader, passes, composite, 3, tmp / "textures.pfm")
+    if any(math.isnan(value) or math.isinf(value) for value in image[2]):
+        failures.append("preset_shaders_textures: rendered NaN or infinite values")
+
+
+def check_fallbacks(args: argparse.Namespace, tmp: Path, failures: list[str]) -> None:
+    text = (args.fixtures / "preset_shaders.milk").read_text()
+    cases = {
+        "broken": text.replace("+ float3(q1, 0, 0);", "+ undefined_function(q1);"),
+        "milkdrop1": text.replace("MILKDROP_PRESET_VERSION=201", "MILKDROP_PRESET_VERSION=100"),
+    }
+    for label, source in cases.items():
+        preset = tmp / f"{label}.milk"
+        preset.write_text(source)
+        shader = tmp / f"{label}.frag"
+        conversion = convert(args.converter, preset, shader)
+        passes, composite = conversion.passes, conversion.composite
+        if any(render_pass.sampler == "iPresetWarp" for render_pass in passes):
+            failures.append(f"{label}: expected the default warp, got a preset_warp pass")
+        if label == "broken":
+            if "warp shader not converted" not in conversion.stderr:
+                failures.append("broken: missing the warp shader warning")
+            if composite is None:
+                failures.append("broken: the valid composite shader should still be converted")
+        elif composite is not None:
+            failures.append("milkdrop1: MilkDrop 1 presets have no composite shader")
+        render(args.renderer, shader, passes, composite, 1, tmp / f"{label}.pfm")
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Validate translated preset warp and composite shaders")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--renderer", type=Path, required=True, help="Path to MilkdropRender executable")
+    parser.add_argument("--fixtures", type=Path, required=True, help="Directory of .milk fixtures")
+    args = parser.parse_args(argv)
+
+    failures: list[str] = []
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        check_feedback(args, tmp_path, failures)
+        check_textures(args, tmp_path, failures)
+        check_fallbacks(args, tmp_path, failures)
+
+    if failures:
+        print("Preset shader regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print("Validated preset warp feedback, composite output, sampler bindings and fallbacks")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Regression test for the converter's --profile / --profile-trace reports.
+
+Converts a preset with both reports enabled and checks that every pipeline stage
+shows up in the aggregated JSON and in the Chrome trace, that allocations are
+counted and trace events carry their thread id, and that profiling does not change
+the generated shader.
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+EXPECTED_STAGES = ["parse", "clean", "compile", "generate", "user_vars", "wave", "assembly", "write"]
+
+
+def run(command: list[str]) -> None:
+    result = subprocess.run(command, text=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if result.returncode != 0:
+        raise RuntimeError(
+            f"{' '.join(command)} exited with status {result.returncode}\n"
+            f"stdout:\n{result.stdout}\n"
+            f"stderr:\n{result.stderr}"
+        )
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Validate converter profiling output")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--preset", type=Path, required=True, help="Preset to convert")
+    args = parser.parse_args(argv)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        plain = tmp_path / "plain.frag"
+        profiled = tmp_path / "profiled.frag"
+        report_path = tmp_path / "report.json"
+        trace_path = tmp_path / "trace.json"
+
+        run([str(args.converter), str(args.preset), str(plain)])
+        run([
+            str(args.converter),
+            "--profile", str(report_path),
+            "--profile-trace", str(trace_path),
+            str(args.preset),
+            str(profiled),
+        ])
+
+        if plain.read_text() != profiled.read_text():
+            print("Profiling changed the generated shader")
+            return 1
+
+        report = json.loads(report_path.read_text())
+        trace = json.loads(trace_path.read_text())
+
+    if not report.get("profiling_enabled"):
+        print("Profiling is compiled out; skipping stage checks")
+        return 0
+
+    stages = {stage["name"]: stage for stage in report["stages"]}
+    missing = [name for name in EXPECTED_STAGES if name not in stages]
+    if missing:
+        print(f"Profile report is missing stages: {', '.join(missing)}")
+        return 1
+
+    if stages["assembly"]["output_bytes"] != stages["write"]["output_bytes"]:
+        print("Assembled shader size does not match the written output size")
+        return 1
+
+    # The command-line tool compiles the allocation hooks; the library only reads them.
+    if stages["parse"]["allocations"] <= 0:
+        print("The profile counted no allocations while parsing")
+        return 1
+
+    trace_names = {event["name"] for event in trace["traceEvents"] if event.get("ph") == "X"}
+    if any(not isinstance(event.get("tid"), int) or event["tid"] < 1 for event in trace["traceEvents"]):
+        print("Chrome trace events lack the recording thread id")
+        return 1
+    missing = [name for name in EXPECTED_STAGES if name not in trace_names]
+    if missing:
+        print(f"Chrome trace is missing stages: {', '.join(missing)}")
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
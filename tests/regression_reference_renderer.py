@@ -0,0 +1,258 @@
+#!/usr/bin/env python3
+"""Regression for the multi-threaded CPU reference renderer (MilkdropReferenceRender).
+
+The reference renderer runs a preset's per-frame and per-pixel code, the warp and decay
+feedback loop and the built-in waveform on the CPU. The checks:
+- every fixture renders, and only unsupported_wave_mode.milk warns about its wave mode;
+- output is byte-identical for 1 and 4 worker threads and from one run to the next,
+  with and without per-pixel code;
+- PNG and PPM outputs hold the same pixels;
+- a per-frame dx moves the previous frame by dx per frame, and a per-pixel dx that
+  differs between the top and bottom halves moves them in opposite directions; on top of
+  that the feedback drifts half a texel left per frame, from the texel offset libprojectM
+  adds to the warp mesh;
+- the decay darkens the feedback once per frame, capped at 30/32 as in libprojectM;
+- per-pixel code that uses megabuf or rand() runs serially, other code in parallel;
+- --timings writes one row of stage timings per frame.
+"""
+
+from __future__ import annotations
+
+import argparse
+import csv
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+from pathlib import Path
+
+RENDER_SIZE = 128
+LIT_THRESHOLD = 64  # Red above this (out of 255) counts as drawn
+TEXEL_DRIFT = 0.5  # Pixels the feedback moves left per frame (libprojectM texelOffset)
+
+# Silent audio, so mode 6 is a straight vertical line through wave_x; identity warp.
+SILENT = ["--audio", "0", "0", "0", "0"]
+LINE = (
+    "[preset00]\nnWaveMode=6\nbWaveThick=0\nbWaveDots=0\nbAdditiveWaves=0\nbMaximizeWaveColor=0\n"
+    "wave_brighten=0\nwave_r=1\nwave_g=0\nwave_b=0\nwave_x=0.5\nwave_y=0.5\nfWaveScale=1\n"
+    "zoom=1\nrot=0\nwarp=0\nsx=1\nsy=1\ncx=0.5\ncy=0.5\ndx=0\ndy=0\nfDecay=1\nbTexWrap=0\n"
+    # The line is drawn on the first frame only; later frames show the feedback.
+    "per_frame_1=wave_a = if(equal(frame, 0), 1, 0);\n"
+)
+
+
+def run(command: list[str]) -> subprocess.CompletedProcess[str]:
+    result = subprocess.run(command, text=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if result.returncode != 0:
+        raise RuntimeError(
+            f"{' '.join(command)} exited with status {result.returncode}\n"
+            f"stdout:\n{result.stdout}\n"
+            f"stderr:\n{result.stderr}"
+        )
+    return result
+
+
+def render(renderer: Path, preset: Path, output: Path, *options: str) -> subprocess.CompletedProcess[str]:
+    return run([str(renderer), "--size", f"{RENDER_SIZE}x{RENDER_SIZE}", *options, str(preset), str(output)])
+
+
+def read_ppm(path: Path) -> tuple[int, int, bytes]:
+    header, dimensions, _maximum, pixels = path.read_bytes().split(b"\n", 3)
+    if header != b"P6":
+        raise RuntimeError(f"{path} is not a binary PPM image")
+    width, height = (int(value) for value in dimensions.split())
+    return width, height, pixels
+
+
+def read_png(path: Path) -> tuple[int, int, bytes]:
+    """Decodes the 8-bit RGB PNGs the renderer writes (one IDAT, filter 0 on every row)."""
+    data = path.read_bytes()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise RuntimeError(f"{path} is not a PNG image")
+    offset, width, height, stream = 8, 0, 0, b""
+    while offset < len(data):
+        (length,) = struct.unpack(">I", data[offset:offset + 4])
+        kind = data[offset + 4:offset + 8]
+        body = data[offset + 8:offset + 8 + length]
+        if zlib.crc32(kind + body) != struct.unpack(">I", data[offset + 8 + length:offset + 12 + length])[0]:
+            raise RuntimeError(f"{path}: bad CRC in {kind.decode()} chunk")
+        if kind == b"IHDR":
+            width, height = struct.unpack(">II", body[:8])
+        elif kind == b"IDAT":
+            stream += body
+        offset += 12 + length
+    raw = zlib.decompress(stream)
+    stride = width * 3 + 1
+    if any(raw[row * stride] != 0 for row in range(height)):
+        raise RuntimeError(f"{path}: unexpected PNG row filter")
+    return width, height, b"".join(raw[row * stride + 1:(row + 1) * stride] for row in range(height))
+
+
+def red_columns(pixels: bytes, rows: range) -> list[int]:
+    """Summed red of each column over the given image rows (top row first)."""
+    return [sum(pixels[(row * RENDER_SIZE + column) * 3] for row in rows) for column in range(RENDER_SIZE)]
+
+
+def line_column(pixels: bytes, rows: range) -> float:
+    """Red-weighted mean column of the lit pixels in the given rows, or -1 if none are lit."""
+    columns = red_columns(pixels, rows)
+    lit = [(column, value) for column, value in enumerate(columns) if value > LIT_THRESHOLD * len(rows) // 4]
+    total = sum(value for _column, value in lit)
+    return sum(column * value for column, value in lit) / total if total else -1.0
+
+
+def check_fixtures(renderer: Path, fixtures: Path, tmp: Path) -> list[str]:
+    failures = []
+    for preset in sorted(fixtures.glob("*.milk")):
+        result = render(renderer, preset, tmp / f"{preset.stem}.ppm", "--frames", "3", "--time", "0")
+        warned = "is not drawn by the reference renderer" in result.stderr
+        if warned != (preset.name == "unsupported_wave_mode.milk"):
+            failures.append(f"{preset.name}: unexpected wave mode warning state ({result.stderr.strip()!r})")
+        width, height, pixels = read_ppm(tmp / f"{preset.stem}.ppm")
+        if (width, height) != (RENDER_SIZE, RENDER_SIZE) or len(pixels) != RENDER_SIZE * RENDER_SIZE * 3:
+            failures.append(f"{preset.name}: wrote a {width}x{height} image")
+    return failures
+
+
+def check_determinism(renderer: Path, fixtures: Path, tmp: Path) -> list[str]:
+    failures = []
+    split = tmp / "split_determinism.milk"
+    split.write_text(LINE.replace("fDecay=1", "fDecay=0.97") + "per_pixel_1=dx = 0.01 * sin(rad * 10 + time); dy = 0.01 * cos(ang * 3);\n")
+    for preset in [fixtures / "che.milk", fixtures / "acid.milk", fixtures / "wave_mode_8.milk", fixtures / "wave_mode_0.milk", split]:
+        images = []
+        for label, threads in (("one", "1"), ("four", "4"), ("again", "4")):
+            output = tmp / f"{preset.stem}_{label}.ppm"
+            render(renderer, preset, output, "--frames", "6", "--time", "0", "--threads", threads)
+            images.append(output.read_bytes())
+        if images[0] != images[1]:
+            failures.append(f"{preset.name}: 1 and 4 threads give different images")
+        if images[1] != images[2]:
+            failures.append(f"{preset.name}: two runs with 4 threads give different images")
+        if max(images[0][15:]) == 0:
+            failures.append(f"{preset.name}: rendered a black image")
+
+    png = tmp / "che_format.png"
+    ppm = tmp / "che_format.ppm"
+    for output in (png, ppm):
+        render(renderer, fixtures / "che.milk", output, "--frames", "4", "--time", "0")
+    if read_png(png) != read_ppm(ppm):
+        failures.append("che.milk: PNG and PPM outputs differ")
+    return failures
+
+
+def check_motion(renderer: Path, tmp: Path) -> list[str]:
+    failures = []
+    rows = range(RENDER_SIZE)
+    preset = tmp / "still.milk"
+    preset.write_text(LINE)
+    render(renderer, preset, tmp / "still.ppm", *SILENT)
+    start = line_column(read_ppm(tmp / "still.ppm")[2], rows)
+    if abs(start - (RENDER_SIZE / 2 - 0.5)) > 1.0:
+        failures.append(f"still: line at column {start:.2f}, expected the centre")
+    render(renderer, preset, tmp / "drift.ppm", *SILENT, "--frames", "4")
+    column = line_column(read_ppm(tmp / "drift.ppm")[2], rows)
+    if abs(column - (start - 3 * TEXEL_DRIFT)) > 0.3:
+        failures.append(f"still: line at column {column:.2f} after three frames, expected {start - 3 * TEXEL_DRIFT:.2f}")
+
+    # The previous frame is sampled at uv - dx (libprojectM's u -= dx), so it moves right.
+    moved = tmp / "moved.milk"
+    moved.write_text(LINE.replace("dx=0\n", "dx=0.0625\n"))
+    render(renderer, moved, tmp / "moved.ppm", *SILENT, "--frames", "3")
+    column = line_column(read_ppm(tmp / "moved.ppm")[2], rows)
+    expected = start + 2 * (0.0625 * RENDER_SIZE - TEXEL_DRIFT)
+    if abs(column - expected) > 0.3:
+        failures.append(f"dx: line at column {column:.2f} after two frames, expected {expected:.2f}")
+
+    # Per-pixel dx: the top half (y < 0.5) moves right, the bottom half left.
+    split = tmp / "split.milk"
+    split.write_text(LINE + "per_pixel_1=dx = if(below(y, 0.5), 0.0625, -0.0625);\n")
+    render(renderer, split, tmp / "split.ppm", *SILENT, "--frames", "2", "--threads", "4")
+    pixels = read_ppm(tmp / "split.ppm")[2]
+    top = line_column(pixels, range(8, RENDER_SIZE // 2 - 8))
+    bottom = line_column(pixels, range(RENDER_SIZE // 2 + 8, RENDER_SIZE - 8))
+    shift = 0.0625 * RENDER_SIZE
+    expected_top = line_column(read_ppm(tmp / "still.ppm")[2], range(8, RENDER_SIZE // 2 - 8)) + shift - TEXEL_DRIFT
+    expected_bottom = line_column(read_ppm(tmp / "still.ppm")[2], range(RENDER_SIZE // 2 + 8, RENDER_SIZE - 8)) - shift - TEXEL_DRIFT
+    if abs(top - expected_top) > 0.3 or abs(bottom - expected_bottom) > 0.3:
+        failures.append(f"per-pixel dx: halves at columns {top:.2f} / {bottom:.2f}, expected "
+                        f"{expected_top:.2f} / {expected_bottom:.2f}")
+    return failures
+
+
+def check_decay(renderer: Path, tmp: Path) -> list[str]:
+    failures = []
+    energies = {}
+    # Rows away from the top and bottom edges, where clamped sampling repeats the edge row.
+    rows = range(16, RENDER_SIZE - 16)
+    for decay in ("1", "0.9", "0.98"):
+        preset = tmp / f"decay_{decay}.milk"
+        preset.write_text(LINE.replace("fDecay=1", f"fDecay={decay}"))
+        for frames in (1, 5):
+            output = tmp / f"decay_{decay}_{frames}.ppm"
+            render(renderer, preset, output, *SILENT, "--frames", str(frames))
+            energies[decay, frames] = sum(red_columns(read_ppm(output)[2], rows))
+    # 0.98 is capped at 30/32 like libprojectM does; 0.9 is used as is.
+    for decay, factor in (("1", 1.0), ("0.9", 0.9), ("0.98", 30.0 / 32.0)):
+        ratio = energies[decay, 5] / max(1, energies[decay, 1])
+        if energies[decay, 1] == 0 or abs(ratio - factor ** 4) > 0.01:
+            failures.append(f"decay={decay}: four frames scaled the line by {ratio:.3f}, expected {factor ** 4:.3f}")
+    return failures
+
+
+def check_reports(renderer: Path, fixtures: Path, tmp: Path) -> list[str]:
+    failures = []
+    cases = [
+        ("plain", "", "per_pixel: none"),
+        ("parallel", "per_pixel_1=dx = 0.01 * x;\n", "per_pixel: parallel"),
+        ("megabuf", "per_pixel_1=megabuf(0) = megabuf(0) + 1; dx = 0.001 * megabuf(0);\n", "per_pixel: serial (uses megabuf)"),
+        ("rand", "per_pixel_1=dx = 0.001 * rand(10);\n", "per_pixel: serial (uses rand)"),
+    ]
+    for name, code, expected in cases:
+        preset = tmp / f"report_{name}.milk"
+        preset.write_text(LINE + code)
+        stdout = render(renderer, preset, tmp / f"report_{name}.ppm", *SILENT, "--threads", "4").stdout
+        if expected not in stdout.splitlines():
+            failures.append(f"{name}: expected {expected!r} in output, got {stdout!r}")
+        if "threads: 4" not in stdout.splitlines():
+            failures.append(f"{name}: expected 'threads: 4' in output, got {stdout!r}")
+
+    timings = tmp / "timings.csv"
+    render(renderer, fixtures / "che.milk", tmp / "timed.ppm", "--frames", "7", "--time", "0", "--timings", str(timings))
+    with timings.open(newline="") as handle:
+        rows = list(csv.DictReader(handle))
+    if [int(row["frame"]) for row in rows] != list(range(7)):
+        failures.append(f"timings: expected frames 0-6, got {[row['frame'] for row in rows]}")
+    elif any(float(row["total_ms"]) < 0.0 or float(row["warp_ms"]) > float(row["total_ms"]) for row in rows):
+        failures.append("timings: stage times must be non-negative and within the frame total")
+    return failures
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Validate the CPU reference renderer")
+    parser.add_argument("--renderer", type=Path, required=True, help="Path to MilkdropReferenceRender executable")
+    parser.add_argument("--fixtures", type=Path, required=True, help="Directory of .milk fixtures")
+    args = parser.parse_args(argv)
+
+    failures: list[str] = []
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        failures += check_fixtures(args.renderer, args.fixtures, tmp_path)
+        failures += check_determinism(args.renderer, args.fixtures, tmp_path)
+        failures += check_motion(args.renderer, tmp_path)
+        failures += check_decay(args.renderer, tmp_path)
+        failures += check_reports(args.renderer, args.fixtures, tmp_path)
+
+    if failures:
+        print("Reference renderer regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print("Validated reference renderer (fixtures, thread-count determinism, PNG/PPM, dx and per-pixel warp, "
+          "decay cap, serial per-pixel detection, timings)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
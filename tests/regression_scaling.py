@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+"""Scaling benchmark of the converter on synthetic presets.
+
+Each dimension of generate_presets.PresetSpec is swept while the others keep their default
+values: statement count, expression depth, user variables (at 256 statements), q and t
+variables (t with four custom waves and shapes), wave mode, and custom wave and shape counts.
+For every point the script generates --repeats presets with different seeds and converts each
+one once in-process through the C API (ctypes over libmilkdrop-converter), after one warm-up
+conversion with another seed. Different seeds give different statements, so the translation
+cache does not serve them. It reports the median of:
+- ms: conversion time;
+- bytes: size of the main shader, its passes and composite pass;
+- cost: the weighted static per-pixel cost estimate (--cost-report).
+
+For each numeric dimension it fits the exponent k of metric ~ value^k over the last two points
+(the largest values, where fixed costs matter least), and fails when the time, size or cost
+of the statement, depth or variable sweeps grows with an exponent above --max-exponent. One
+preset per point also goes through the command-line converter, which must parse every
+statement. --svg draws every metric against every dimension, --json writes the numbers.
+"""
+
+from __future__ import annotations
+
+import argparse
+import ctypes
+import json
+import math
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+from dataclasses import replace
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+from generate_presets import PresetSpec, generate  # noqa: E402
+
+BASE = PresetSpec()
+
+SWEEPS = {
+    "statements": ([16, 32, 64, 128, 256, 512, 1024], {}),
+    "depth": ([1, 2, 4, 8, 16, 32, 64], {}),
+    "user_vars": ([1, 4, 16, 64, 256], {"statements": 256}),
+    "q_vars": ([0, 4, 8, 16, 32], {}),
+    "t_vars": ([0, 2, 4, 8], {"custom_waves": 4, "custom_shapes": 4}),
+    "wave_mode": (list(range(9)), {}),
+    "custom_waves": ([0, 1, 2, 3, 4], {}),
+    "custom_shapes": ([0, 1, 2, 3, 4], {}),
+}
+
+# Dimensions whose growth is checked against --max-exponent.
+GATED = ["statements", "depth", "user_vars", "q_vars"]
+METRICS = [("ms", "conversion ms"), ("bytes", "output bytes"), ("cost", "estimated cost")]
+
+
+class Info(ctypes.Structure):
+    _fields_ = [
+        ("struct_size", ctypes.c_size_t),
+        ("cost", ctypes.c_double),
+        ("within_budget", ctypes.c_int),
+        ("wave_binned", ctypes.c_int),
+        ("wave_iteration_cap", ctypes.c_int),
+    ]
+
+
+class Pass(ctypes.Structure):
+    _fields_ = [
+        ("struct_size", ctypes.c_size_t),
+        ("name", ctypes.c_char_p),
+        ("sampler", ctypes.c_char_p),
+        ("glsl", ctypes.c_void_p),
+        ("glsl_size", ctypes.c_size_t),
+        ("width", ctypes.c_int),
+        ("height", ctypes.c_int),
+        ("resolution_divisor", ctypes.c_int),
+    ]
+
+
+class Converter:
+    """One milkdrop_converter handle, reused for every conversion."""
+
+    def __init__(self, library: Path):
+        lib = ctypes.CDLL(str(library))
+        lib.milkdrop_converter_create.restype = ctypes.c_void_p
+        lib.milkdrop_converter_destroy.argtypes = [ctypes.c_void_p]
+        lib.milkdrop_converter_convert.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t, ctypes.c_char_p]
+        lib.milkdrop_converter_convert.restype = ctypes.c_int
+        lib.milkdrop_converter_error.argtypes = [ctypes.c_void_p]
+        lib.milkdrop_converter_error.restype = ctypes.c_char_p
+        lib.milkdrop_converter_shader.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_size_t)]
+        lib.milkdrop_converter_shader.restype = ctypes.c_void_p
+        lib.milkdrop_converter_pass_count.argtypes = [ctypes.c_void_p]
+        lib.milkdrop_converter_pass_count.restype = ctypes.c_size_t
+        lib.milkdrop_converter_get_pass.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(Pass)]
+        lib.milkdrop_converter_get_composite.argtypes = [ctypes.c_void_p, ctypes.POINTER(Pass)]
+        lib.milkdrop_converter_get_composite.restype = ctypes.c_int
+        lib.milkdrop_converter_get_info.argtypes = [ctypes.c_void_p, ctypes.POINTER(Info)]
+        self.lib = lib
+        self.handle = lib.milkdrop_converter_create()
+
+    def close(self) -> None:
+        self.lib.milkdrop_converter_destroy(self.handle)
+
+    def convert(self, text: str, label: str) -> dict[str, float]:
+        data = text.encode()
+        start = time.perf_counter()
+        status = self.lib.milkdrop_converter_convert(self.handle, data, len(data), label.encode())
+        elapsed = time.perf_counter() - start
+        if status != 0:
+            raise RuntimeError(f"{label}: {self.lib.milkdrop_converter_error(self.handle).decode()}")
+        size = ctypes.c_size_t()
+        self.lib.milkdrop_converter_shader(self.handle, ctypes.byref(size))
+        total = size.value
+        shader_pass = Pass(ctypes.sizeof(Pass))
+        for index in range(self.lib.milkdrop_converter_pass_count(self.handle)):
+            self.lib.milkdrop_converter_get_pass(self.handle, index, ctypes.byref(shader_pass))
+            total += shader_pass.glsl_size
+        if self.lib.milkdrop_converter_get_composite(self.handle, ctypes.byref(shader_pass)):
+            total += shader_pass.glsl_size
+        info = Info(ctypes.sizeof(Info))
+        self.lib.milkdrop_converter_get_info(self.handle, ctypes.byref(info))
+        return {"ms": 1000.0 * elapsed, "bytes": float(total), "cost": info.cost}
+
+
+def check_parses(converter: Path, spec: PresetSpec, temp: Path) -> str | None:
+    """Converts @p spec with the command-line tool; returns the problem, or None."""
+    preset = temp / "check.milk"
+    preset.write_text(generate(spec))
+    result = subprocess.run([str(converter), str(preset), str(temp / "check.frag")], text=True,
+                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if result.returncode != 0 or "Error" in result.stderr:
+        return result.stderr.strip().splitlines()[0] if result.stderr.strip() else f"exit status {result.returncode}"
+    return None
+
+
+def exponent(points: list[dict], metric: str) -> float | None:
+    """k of metric ~ value^k between the two largest values."""
+    positive = [point for point in points if point["value"] > 0 and point[metric] > 0]
+    if len(positive) < 2:
+        return None
+    low, high = positive[-2], positive[-1]
+    return math.log(high[metric] / low[metric]) / math.log(high["value"] / low["value"])
+
+
+def short(value: float) -> str:
+    if value >= 1e6:
+        return f"{value / 1e6:.3g}M"
+    if value >= 1e3:
+        return f"{value / 1e3:.3g}k"
+    return f"{value:.3g}"
+
+
+def write_svg(results: dict[str, dict], path: Path) -> None:
+    width, height, margin = 240, 150, 36
+    columns = len(METRICS)
+    parts = [
+        f'<svg xmlns="http://www.w3.org/2000/svg" width="{columns * width}" height="{len(results) * height}" '
+        f'font-family="sans-serif" font-size="10">',
+        '<rect width="100%" height="100%" fill="white"/>',
+    ]
+    for row, (dimension, result) in enumerate(results.items()):
+        points = result["points"]
+        for column, (metric, label) in enumerate(METRICS):
+            left, top = column * width + margin, row * height + 18
+            plot_w, plot_h = width - margin - 12, height - 18 - 28
+            xs = [point["value"] for point in points]
+            ys = [point[metric] for point in points]
+            x_min, x_max = min(xs), max(xs)
+            y_max = max(ys) or 1.0
+
+            def place(x: float, y: float) -> str:
+                px = left + (x - x_min) / ((x_max - x_min) or 1.0) * plot_w
+                py = top + plot_h - y / y_max * plot_h
+                return f"{px:.1f},{py:.1f}"
+
+            k = result["exponents"].get(metric)
+            title = f"{label} vs {dimension}" + (f" (k={k:.2f})" if k is not None else "")
+            parts.append(f'<text x="{left}" y="{top - 6}">{title}</text>')
+            parts.append(f'<polyline points="{left},{top} {left},{top + plot_h} {left + plot_w},{top + plot_h}" '
+                         f'fill="none" stroke="#888"/>')
+            parts.append(f'<text x="{left - 4}" y="{top + 8}" text-anchor="end">{short(y_max)}</text>')
+            parts.append(f'<text x="{left - 4}" y="{top + plot_h}" text-anchor="end">0</text>')
+            parts.append(f'<text x="{left}" y="{top + plot_h + 12}">{x_min:g}</text>')
+            parts.append(f'<text x="{left + plot_w}" y="{top + plot_h + 12}" text-anchor="end">{x_max:g}</text>')
+            line = " ".join(place(x, y) for x, y in zip(xs, ys))
+            parts.append(f'<polyline points="{line}" fill="none" stroke="#1f6fb4" stroke-width="1.5"/>')
+            for x, y in zip(xs, ys):
+                cx, cy = place(x, y).split(",")
+                parts.append(f'<circle cx="{cx}" cy="{cy}" r="2" fill="#1f6fb4"/>')
+    parts.append("</svg>")
+    path.write_text("\n".join(parts) + "\n")
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Converter scaling benchmark on synthetic presets")
+    parser.add_argument("--library", type=Path, required=True, help="Path to the libmilkdrop-converter shared library")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--repeats", type=int, default=5, help="Presets (seeds) per point")
+    parser.add_argument("--max-exponent", type=float, default=1.5,
+                        help="Largest growth exponent allowed for the statement, depth and variable sweeps")
+    parser.add_argument("--svg", type=Path, help="Write the plots")
+    parser.add_argument("--json", type=Path, help="Write the measurements")
+    args = parser.parse_args(argv)
+
+    converter = Converter(args.library)
+    failures: list[str] = []
+    results: dict[str, dict] = {}
+    with tempfile.TemporaryDirectory() as temp_dir:
+        temp = Path(temp_dir)
+        for dimension, (values, overrides) in SWEEPS.items():
+            points = []
+            print(f"{dimension:<14} {'value':>6} {'ms':>9} {'bytes':>9} {'cost':>11}")
+            for value in values:
+                spec = replace(BASE, **overrides, **{dimension: value})
+                if generate(spec) != generate(spec):
+                    failures.append(f"{dimension}={value}: the generator is not deterministic")
+                problem = check_parses(args.converter, spec, temp)
+                if problem:
+                    failures.append(f"{dimension}={value}: {problem}")
+                converter.convert(generate(replace(spec, seed=1000)), f"warmup_{dimension}_{value}")
+                samples = [converter.convert(generate(replace(spec, seed=seed)), f"{dimension}_{value}_{seed}")
+                           for seed in range(1, args.repeats + 1)]
+                point = {"value": value}
+                for metric, _ in METRICS:
+                    point[metric] = statistics.median(sample[metric] for sample in samples)
+                points.append(point)
+                print(f"{'':<14} {value:>6} {point['ms']:>9.3f} {point['bytes']:>9.0f} {point['cost']:>11.1f}")
+            exponents = {}
+            if dimension != "wave_mode":
+                for metric, label in METRICS:
+                    k = exponent(points, metric)
+                    if k is None:
+                        continue
+                    exponents[metric] = k
+                    if dimension in GATED and k > args.max_exponent:
+                        failures.append(f"{label} grows as {dimension}^{k:.2f} (limit {args.max_exponent})")
+                print(f"{'':<14} growth exponents: "
+                      + ", ".join(f"{metric} {k:.2f}" for metric, k in exponents.items()))
+            results[dimension] = {"points": points, "exponents": exponents}
+    converter.close()
+
+    if args.svg:
+        write_svg(results, args.svg)
+    if args.json:
+        args.json.write_text(json.dumps(results, indent=2) + "\n")
+
+    if failures:
+        print("Scaling regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+    print(f"Validated scaling over {sum(len(result['points']) for result in results.values())} points "
+          f"of {len(results)} dimensions ({args.repeats} presets each)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Image regression for the reduced-resolution wave field (--wave-lowres).
+
+Every fixture is converted twice, with and without --wave-lowres, and both shaders
+are rendered off-screen by MilkdropRender. The upsampled field cannot reproduce
+sub-texel detail exactly, so the check is statistical. It only looks at channels
+lit in either image (the wave covers a few percent of the screen): their mean error
+and the share of badly reconstructed channels must stay under fixed thresholds. A
+missing or misplaced wave scores an order of magnitude above them.
+Fixtures are also converted with --wave-geometry so the field pass is exercised on
+top of the binned wave.
+"""
+
+from __future__ import annotations
+
+import argparse
+import struct
+import sys
+import tempfile
+from pathlib import Path
+
+from _converter import Pass, convert, pass_arguments, run
+
+RENDER_SIZE = "512x512"
+LIT_THRESHOLD = 0.02        # Channels above this in either image are compared
+MAX_MEAN_ERROR = 0.05        # Mean absolute error over the compared channels
+OUTLIER_ERROR = 0.1          # A channel further off than this counts as an outlier
+MAX_OUTLIER_FRACTION = 0.05  # Share of compared channels allowed to be outliers
+
+
+
+def render(renderer: Path, shader: Path, passes: list[Pass], output: Path) -> list[float]:
+    command = [str(renderer), "--size", RENDER_SIZE]
+    run(command + pass_arguments(passes) + [str(shader), str(output)])
+
+    data = output.read_bytes()
+    header, dimensions, _scale, pixels = data.split(b"\n", 3)
+    if header != b"PF":
+        raise RuntimeError(f"{output} is not a colour PFM image")
+    width, height = (int(value) for value in dimensions.split())
+    count = width * height * 3
+    return list(struct.unpack(f"<{count}f", pixels[: 4 * count]))
+
+
+def compare(name: str, reference: list[float], candidate: list[float]) -> list[str]:
+    errors = [abs(a - b) for a, b in zip(reference, candidate) if a > LIT_THRESHOLD or b > LIT_THRESHOLD]
+    if not errors:
+        return []
+    mean_error = sum(errors) / len(errors)
+    outliers = sum(1 for error in errors if error > OUTLIER_ERROR) / len(errors)
+    failures = []
+    if mean_error > MAX_MEAN_ERROR:
+        failures.append(f"{name}: mean error {mean_error:.4f} over lit channels exceeds {MAX_MEAN_ERROR}")
+    if outliers > MAX_OUTLIER_FRACTION:
+        failures.append(f"{name}: {outliers:.2%} of lit channels differ by more than {OUTLIER_ERROR}")
+    return failures
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Compare --wave-lowres output against the full-resolution wave")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--renderer", type=Path, required=True, help="Path to MilkdropRender executable")
+    parser.add_argument("--fixtures", type=Path, required=True, help="Directory of .milk fixtures")
+    args = parser.parse_args(argv)
+
+    presets = sorted(args.fixtures.glob("*.milk"))
+    if not presets:
+        print(f"No fixtures found in {args.fixtures}")
+        return 1
+
+    failures: list[str] = []
+    lit_fixtures = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        for preset in presets:
+            stem = preset.stem
+            reference_passes = convert(args.converter, preset, tmp_path / f"{stem}.frag").passes
+            reference = render(args.renderer, tmp_path / f"{stem}.frag", reference_passes, tmp_path / f"{stem}.pfm")
+            if any(value > LIT_THRESHOLD for value in reference):
+                lit_fixtures += 1
+
+            for label, options in (("lowres", ["--wave-lowres"]),
+                                   ("lowres+geometry", ["--wave-lowres", "--wave-geometry"])):
+                shader = tmp_path / f"{stem}.{label}.frag"
+                passes = convert(args.converter, preset, shader, *options).passes
+                if not any(render_pass.sampler == "iWaveField" for render_pass in passes):
+                    failures.append(f"{stem} ({label}): converter did not emit the wave_field pass")
+                    continue
+                candidate = render(args.renderer, shader, passes, tmp_path / f"{stem}.{label}.pfm")
+                failures += compare(f"{stem} ({label})", reference, candidate)
+
+    if lit_fixtures == 0:
+        failures.append("No fixture draws a visible wave; the comparison would be vacuous")
+
+    if failures:
+        print("Low-resolution wave regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print(f"Validated --wave-lowres on {len(presets)} fixtures ({lit_fixtures} with a visible wave)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -138,9 +138,9 @@ def expect_whitespace_insensitive(fragment: str, snippet: str, preset_name: str,
         )
 
 
-def run_converter(converter: Path, preset: Path, output: Path) -> None:
+def run_converter(converter: Path, preset: Path, output: Path, *options: str) -> None:
     result = subprocess.run(
-        [str(converter), str(preset), str(output)],
+        [str(converter), *options, str(preset), str(output)],
         stdout=subprocess.PIPE,
         stderr=subprocess.PIPE,
         text=True,
@@ -229,6 +229,38 @@ def validate_fixture(converter: Path, fixtures_dir: Path, preset_name: str) -> N
         )
 
 
+def validate_wave_geometry(converter: Path, fixtures_dir: Path, preset_name: str) -> None:
+    """--wave-geometry must emit both prepasses and route the wave through the tile bins."""
+    expectations = build_expectations(preset_name)
+    with tempfile.TemporaryDirectory() as tmp:
+        output_path = Path(tmp) / "wave.frag"
+        run_converter(converter, fixtures_dir / preset_name, output_path, "--wave-geometry")
+        fragment = output_path.read_text()
+        geometry_path = Path(tmp) / "wave.wave_geometry.frag"
+        bins_path = Path(tmp) / "wave.wave_bins.frag"
+        if not geometry_path.exists() or not bins_path.exists():
+            raise AssertionError(f"Wave geometry passes not written for {preset_name}")
+        geometry = geometry_path.read_text()
+        bins = bins_path.read_text()
+
+    binned_call = expectations["call"].replace("draw_wave(", "draw_wave_binned(")
+    expect_whitespace_insensitive(fragment, binned_call, preset_name, "binned call pattern")
+    for sampler in ("uniform sampler2D iWaveGeometry;", "uniform sampler2D iWaveBins;"):
+        if sampler not in fragment:
+            raise AssertionError(f"Expected '{sampler}' in binned GLSL for {preset_name}")
+
+    geometry_call = expectations["call"].replace("draw_wave(pixelUV", "wave_geometry_texel(int(gl_FragCoord.x)")
+    expect_whitespace_insensitive(geometry, "FragColor = " + geometry_call, preset_name, "geometry pass output")
+    if "uniform sampler2D iWaveGeometry;" not in bins or "wave_primitive_bounds(" not in bins:
+        raise AssertionError(f"Bin pass for {preset_name} does not read the geometry texture")
+
+    for label, source in (("main", fragment), ("geometry", geometry), ("bins", bins)):
+        if not source.startswith("#version 330 core"):
+            raise AssertionError(f"{label} shader for {preset_name} must start with #version 330 core")
+        if source.count("{") != source.count("}"):
+            raise AssertionError(f"{label} shader for {preset_name} has mismatched braces")
+
+
 def main() -> int:
     parser = argparse.ArgumentParser(description="Wave mode regression tests")
     parser.add_argument("--converter", required=True, type=Path, help="Path to MilkdropConverter binary")
@@ -242,6 +274,7 @@ def main() -> int:
 
     for preset_name in sorted(WAVE_FIXTURES):
         validate_fixture(args.converter, args.fixtures, preset_name)
+        validate_wave_geometry(args.converter, args.fixtures, preset_name)
 
     return 0
 
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Regression checks for the conversion-time specialization of the wave helpers.
+
+A wave fixture is converted once for every nWaveMode (0-8), with and without
+--wave-geometry, and the test checks in every shader the converter writes that:
+- no wave_select_* call with a literal mode is left, as the specializer resolves those;
+- exactly the vertex function of the preset's mode is defined (none for the unsupported
+  mode 1), so other modes' code is removed;
+- every wave helper or draw function the code calls is defined, including helpers only
+  reached through another kept helper, and every defined helper is called, so nothing
+  unreachable is kept;
+- the shaders still compile and render through MilkdropRender on llvmpipe.
+"""
+
+from __future__ import annotations
+
+import argparse
+import re
+import sys
+import tempfile
+from pathlib import Path
+
+from _converter import convert, pass_arguments, run
+
+DEFINITION = re.compile(r"^(?:float|int|bool|void|[iu]?vec[234]) ((?:wave|draw)_\w+)\(", re.MULTILINE)
+COMMENT = re.compile(r"//[^\n]*|/\*.*?\*/", re.DOTALL)
+CALL = re.compile(r"\b((?:wave|draw)_\w+)\s*\(")
+LITERAL_SELECTOR = re.compile(r"\bwave_select_\w+\(\s*-?[0-9.]+\s*\)")
+VERTEX = re.compile(r"^vec2 (wave_mode\w*_vertex)\(", re.MULTILINE)
+# Entry points the rest of the shader calls into.
+ROOTS = {"draw_wave", "draw_wave_binned", "wave_geometry_texel", "wave_sample_field"}
+EXPECTED_VERTEX = {0: "wave_mode0_vertex", 2: "wave_mode2_vertex", 3: "wave_mode3_vertex", 4: "wave_mode_line_vertex",
+                   5: "wave_mode5_vertex", 6: "wave_mode6_vertex", 7: "wave_mode7_vertex", 8: "wave_mode8_vertex"}
+
+
+def check_shader(name: str, glsl: str, mode: int) -> list[str]:
+    failures = []
+    glsl = COMMENT.sub("", glsl)
+    for call in LITERAL_SELECTOR.findall(glsl):
+        failures.append(f"{name}: mode selector left unresolved: {call}")
+    defined = set(DEFINITION.findall(glsl))
+    if not defined:
+        return failures
+    vertices = set(VERTEX.findall(glsl))
+    expected = {EXPECTED_VERTEX[mode]} if mode in EXPECTED_VERTEX else set()
+    if vertices and vertices != expected:
+        failures.append(f"{name}: vertex functions {sorted(vertices)}, expected {sorted(expected)}")
+    # Calls from inside each definition's own header do not count as uses.
+    called = {match.group(1) for match in CALL.finditer(DEFINITION.sub("", glsl))}
+    for function in sorted(called - defined):
+        failures.append(f"{name}: calls {function}() without defining it")
+    for function in sorted(defined - called - ROOTS):
+        failures.append(f"{name}: keeps {function}(), which nothing calls")
+    return failures
+
+
+def main(argv: list[str] | None = None) -> int:
+    parser = argparse.ArgumentParser(description="Wave helper specialization regression checks")
+    parser.add_argument("--converter", type=Path, required=True, help="Path to MilkdropConverter executable")
+    parser.add_argument("--renderer", type=Path, required=True, help="Path to MilkdropRender executable")
+    parser.add_argument("--preset", type=Path, required=True, help="Wave fixture whose nWaveMode is varied")
+    args = parser.parse_args(argv)
+
+    source = args.preset.read_text()
+    failures: list[str] = []
+    shaders = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp_path = Path(tmp)
+        for mode in range(9):
+            preset = tmp_path / f"mode{mode}.milk"
+            preset.write_text(re.sub(r"^nWaveMode=.*$", f"nWaveMode={mode}", source, flags=re.MULTILINE))
+            for variant, options in (("pixel", []), ("geometry", ["--wave-geometry"])):
+                output = tmp_path / f"mode{mode}_{variant}.frag"
+                passes = convert(args.converter, preset, output, *options).passes
+                for shader in [output] + [render_pass.shader for render_pass in passes]:
+                    failures += check_shader(f"mode {mode} {variant} {shader.name}", shader.read_text(), mode)
+                    shaders += 1
+                command = [str(args.renderer), "--size", "64x64", "--frames", "2", *pass_arguments(passes)]
+                try:
+                    run(command + [str(output)])
+                except RuntimeError as error:
+                    failures.append(f"mode {mode} {variant}: does not render: {error}")
+
+    if failures:
+        print("Wave specialization regression failures:")
+        for failure in failures:
+            print(f" - {failure}")
+        return 1
+
+    print(f"Validated wave specialization of {shaders} shaders over 9 wave modes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())